@@ -30,3 +30,19 @@ endif((CMAKE_COMPILER_IS_GNUCXX OR IS_ICPC) AND NOT MINGW)
 
 # no prefix needed for python modules
 set(CMAKE_SHARED_MODULE_PREFIX "")
+
+# tracing spans (RBX_TRACE) are compiled out unless enabled
+option(ROBOWFLEX_TRACING "Record tracing spans of hot paths" OFF)
+if(ROBOWFLEX_TRACING)
+  add_definitions(-DROBOWFLEX_TRACING)
+endif()
+
+# counting heap allocations replaces the global operator new and delete, so it is opt-in
+option(ROBOWFLEX_ALLOCATION_COUNTING "Count heap allocations for profiling" OFF)
+if(ROBOWFLEX_ALLOCATION_COUNTING)
+  add_definitions(-DROBOWFLEX_ALLOCATION_COUNTING)
+endif()
+
+# log messages below this level (0 debug, 1 info, 2 warn, 3 error, 4 fatal) are compiled out
+set(ROBOWFLEX_LOG_MIN_LEVEL "0" CACHE STRING "Lowest level of log messages that is compiled in")
+add_definitions(-DROBOWFLEX_LOG_MIN_LEVEL=${ROBOWFLEX_LOG_MIN_LEVEL})
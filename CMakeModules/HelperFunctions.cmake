@@ -8,6 +8,17 @@ macro(add_test_script test_name)
   endif()
 endmacro(add_test_script)
 
+# Adds a micro-benchmark (in a source file under the `bench` directory) to the
+# list of executables to compile, if Google Benchmark is available. Adds the
+# name to the list `BENCHMARKS`.
+macro(add_benchmark_script benchmark_name)
+  if(benchmark_FOUND)
+    list(APPEND BENCHMARKS bench_${benchmark_name})
+    add_executable(bench_${benchmark_name} bench/${benchmark_name}.cpp)
+    target_link_libraries(bench_${benchmark_name} ${LIBRARY_NAME} ${catkin_LIBRARIES} benchmark::benchmark)
+  endif()
+endmacro(add_benchmark_script)
+
 # Install tests added via `add_test` to the install directory.
 macro(install_tests)
   install(TARGETS
@@ -0,0 +1,266 @@
+/* Author: Zachary Kingston */
+
+#include <benchmark/benchmark.h>
+
+#include <robowflex_library/detail/fetch.h>
+#include <robowflex_library/detail/ur5.h>
+#include <robowflex_library/io.h>
+#include <robowflex_library/pool.h>
+#include <robowflex_library/robot.h>
+#include <robowflex_library/scene.h>
+#include <robowflex_library/trajectory.h>
+#include <robowflex_library/util.h>
+
+using namespace robowflex;
+
+/* \file core.cpp
+ * Micro-benchmarks of the core operations of the library, on the bundled UR5
+ * and Fetch robots and scenes. Unlike the benchmarking scripts, each operation
+ * is timed in isolation over many repetitions, so small regressions show up.
+ *
+ * Results are written in a machine-readable format with the Google Benchmark
+ * flags, e.g.,
+ *      `bench_core --benchmark_out=core.json --benchmark_out_format=json`
+ * Use `--benchmark_filter=<regex>` to run a subset of the benchmarks.
+ */
+
+namespace
+{
+    const std::string UR5_GROUP = "manipulator";
+    const std::vector<double> UR5_START = {0.0677, -0.8235, 0.9860, -0.1624, 0.0678, 0.0};
+    const std::vector<double> UR5_GOAL = {-0.39, -0.69, -2.12, 2.82, -0.39, 0};
+    const std::string UR5_SCENE = "package://robowflex_library/yaml/test.yml";
+
+    const std::string FETCH_GROUP = "arm_with_torso";
+    const std::vector<double> FETCH_START = {0.05, 1.32, 1.40, -0.2, 1.72, 0.0, 1.66, 0.0};
+    const std::vector<double> FETCH_GOAL = {0.265, 0.501, 1.281, -2.272, 2.243, -2.774, 0.976, -2.007};
+    const std::string FETCH_SCENE = "package://robowflex_library/yaml/test_fetch.yml";
+
+    /** \brief A robot, scene, and path between two configurations, shared by all benchmarks.
+     */
+    struct Fixture
+    {
+        RobotPtr robot;
+        SceneConstPtr scene;
+        std::string group;
+        std::string scene_file;
+        robot_state::RobotStatePtr start;
+        TrajectoryPtr path;
+    };
+
+    Fixture makeFixture(const RobotPtr &robot, const std::string &group, const std::vector<double> &start,
+                        const std::vector<double> &goal, const std::string &scene_file)
+    {
+        Fixture fixture;
+        fixture.robot = robot;
+        fixture.group = group;
+        fixture.scene_file = scene_file;
+
+        auto scene = std::make_shared<Scene>(robot);
+        if (not scene->fromYAMLFile(scene_file))
+            throw Exception(1, "Failed to load benchmark scene " + scene_file);
+        fixture.scene = scene;
+
+        robot->setGroupState(group, start);
+        fixture.start = std::make_shared<robot_state::RobotState>(*robot->getScratchStateConst());
+
+        fixture.path = std::make_shared<Trajectory>(robot, group);
+        fixture.path->addSuffixWaypoint(*fixture.start);
+
+        robot->setGroupState(group, goal);
+        fixture.path->addSuffixWaypoint(*robot->getScratchStateConst());
+        fixture.path->interpolate(100);
+
+        return fixture;
+    }
+
+    const Fixture &getUR5()
+    {
+        static const Fixture fixture = [] {
+            auto ur5 = std::make_shared<UR5Robot>();
+            ur5->initialize();
+            return makeFixture(ur5, UR5_GROUP, UR5_START, UR5_GOAL, UR5_SCENE);
+        }();
+
+        return fixture;
+    }
+
+    const Fixture &getFetch()
+    {
+        static const Fixture fixture = [] {
+            auto fetch = std::make_shared<FetchRobot>();
+            fetch->initialize();
+            return makeFixture(fetch, FETCH_GROUP, FETCH_START, FETCH_GOAL, FETCH_SCENE);
+        }();
+
+        return fixture;
+    }
+
+    template <const Fixture &(*F)()>
+    void checkCollision(benchmark::State &state)
+    {
+        const auto &fixture = F();
+        for (auto _ : state)
+            benchmark::DoNotOptimize(fixture.scene->checkCollision(*fixture.start));
+    }
+
+    template <const Fixture &(*F)()>
+    void distanceToCollision(benchmark::State &state)
+    {
+        const auto &fixture = F();
+        for (auto _ : state)
+            benchmark::DoNotOptimize(fixture.scene->distanceToCollision(*fixture.start));
+    }
+
+    template <const Fixture &(*F)()>
+    void setFromIK(benchmark::State &state)
+    {
+        const auto &fixture = F();
+        const auto &tip = fixture.robot->getSolverTipFrames(fixture.group);
+        if (tip.empty())
+        {
+            state.SkipWithError("No IK solver for group");
+            return;
+        }
+
+        const RobotPose goal = fixture.start->getGlobalLinkTransform(tip[0]);
+        const Robot::IKQuery query(fixture.group, goal);
+
+        robot_state::RobotState scratch(*fixture.start);
+        std::size_t solved = 0;
+        for (auto _ : state)
+        {
+            state.PauseTiming();
+            scratch = *fixture.start;
+            scratch.setToRandomPositions(scratch.getJointModelGroup(fixture.group));
+            state.ResumeTiming();
+
+            solved += fixture.robot->setFromIK(query, scratch);
+        }
+
+        state.counters["success"] = benchmark::Counter(solved, benchmark::Counter::kAvgIterations);
+    }
+
+    template <const Fixture &(*F)()>
+    void getLength(benchmark::State &state)
+    {
+        const auto &fixture = F();
+        for (auto _ : state)
+            benchmark::DoNotOptimize(fixture.path->getLength());
+    }
+
+    template <const Fixture &(*F)()>
+    void getSmoothness(benchmark::State &state)
+    {
+        const auto &fixture = F();
+        for (auto _ : state)
+            benchmark::DoNotOptimize(fixture.path->getSmoothness());
+    }
+
+    template <const Fixture &(*F)()>
+    void getClearance(benchmark::State &state)
+    {
+        const auto &fixture = F();
+        for (auto _ : state)
+            benchmark::DoNotOptimize(fixture.path->getClearance(fixture.scene));
+    }
+
+    template <const Fixture &(*F)()>
+    void fromYAMLFile(benchmark::State &state)
+    {
+        const auto &fixture = F();
+        for (auto _ : state)
+        {
+            Scene scene(fixture.robot);
+            benchmark::DoNotOptimize(scene.fromYAMLFile(fixture.scene_file));
+        }
+    }
+
+    template <const Fixture &(*F)()>
+    void getMessageMD5(benchmark::State &state)
+    {
+        auto msg = F().scene->getMessage();
+        for (auto _ : state)
+            benchmark::DoNotOptimize(IO::getMessageMD5(msg));
+    }
+
+    template <const Fixture &(*F)()>
+    void getMessageHash(benchmark::State &state)
+    {
+        const auto &msg = F().scene->getMessage();
+        for (auto _ : state)
+            benchmark::DoNotOptimize(IO::getMessageHash(msg));
+    }
+
+    template <const Fixture &(*F)()>
+    void getSceneMessage(benchmark::State &state)
+    {
+        const auto &fixture = F();
+        for (auto _ : state)
+            benchmark::DoNotOptimize(fixture.scene->getMessageConst());
+    }
+
+    template <const Fixture &(*F)()>
+    void getSceneMessageHash(benchmark::State &state)
+    {
+        const auto &fixture = F();
+        for (auto _ : state)
+            benchmark::DoNotOptimize(fixture.scene->getMessageHash());
+    }
+
+    void submit(benchmark::State &state, Pool::Scheduler scheduler)
+    {
+        const std::size_t n = state.range(0);
+        Pool pool(std::thread::hardware_concurrency(), scheduler);
+
+        std::vector<std::shared_ptr<Pool::Job<std::size_t>>> jobs(n);
+        for (auto _ : state)
+        {
+            for (std::size_t i = 0; i < n; ++i)
+                jobs[i] = pool.submit(make_function([i] { return 2 * i; }));
+
+            for (const auto &job : jobs)
+                benchmark::DoNotOptimize(job->get());
+        }
+
+        state.SetItemsProcessed(state.iterations() * n);
+    }
+}  // namespace
+
+BENCHMARK_TEMPLATE(checkCollision, getUR5);
+BENCHMARK_TEMPLATE(checkCollision, getFetch);
+BENCHMARK_TEMPLATE(distanceToCollision, getUR5);
+BENCHMARK_TEMPLATE(distanceToCollision, getFetch);
+BENCHMARK_TEMPLATE(setFromIK, getUR5);
+BENCHMARK_TEMPLATE(setFromIK, getFetch);
+
+BENCHMARK_TEMPLATE(getLength, getUR5);
+BENCHMARK_TEMPLATE(getLength, getFetch);
+BENCHMARK_TEMPLATE(getSmoothness, getUR5);
+BENCHMARK_TEMPLATE(getSmoothness, getFetch);
+BENCHMARK_TEMPLATE(getClearance, getUR5);
+BENCHMARK_TEMPLATE(getClearance, getFetch);
+
+BENCHMARK_TEMPLATE(fromYAMLFile, getUR5);
+BENCHMARK_TEMPLATE(fromYAMLFile, getFetch);
+BENCHMARK_TEMPLATE(getMessageMD5, getFetch);
+BENCHMARK_TEMPLATE(getMessageHash, getFetch);
+BENCHMARK_TEMPLATE(getSceneMessage, getFetch);
+BENCHMARK_TEMPLATE(getSceneMessageHash, getFetch);
+
+BENCHMARK_CAPTURE(submit, shared, Pool::Scheduler::SHARED)->Arg(1000)->UseRealTime();
+BENCHMARK_CAPTURE(submit, stealing, Pool::Scheduler::STEALING)->Arg(1000)->UseRealTime();
+
+int main(int argc, char **argv)
+{
+    // Parse benchmark flags first, so ROS only sees the remaining arguments.
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+
+    // Startup ROS
+    ROS ros(argc, argv);
+
+    benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
@@ -0,0 +1,47 @@
+/* Author: Zachary Kingston */
+
+#ifndef ROBOWFLEX_ALLOCATION_
+#define ROBOWFLEX_ALLOCATION_
+
+#include <cstddef>
+
+namespace robowflex
+{
+    /** \brief Counting of the heap allocations made by a thread, to find where time goes to the
+     *  allocator.
+     *
+     *  Allocations are counted by replacing the global `operator new` and `operator delete`, which is
+     *  only compiled in if Robowflex is compiled with `ROBOWFLEX_ALLOCATION_COUNTING` (the CMake option of
+     *  the same name). Only allocations made through `new` on the counting thread are counted, not
+     *  `malloc()` calls of C libraries or allocations of other threads. Sizes are the usable sizes of the
+     *  blocks returned by the allocator, so they include its rounding.
+     */
+    namespace allocation
+    {
+        /** \brief Allocations counted by a thread.
+         */
+        struct Counts
+        {
+            std::size_t allocations{0};  ///< Number of allocations.
+            std::size_t bytes{0};        ///< Total bytes allocated.
+            std::size_t peak{0};         ///< Peak of bytes allocated and not yet freed by the thread.
+        };
+
+        /** \brief Check if allocation counting is compiled in.
+         *  \return True if allocations can be counted.
+         */
+        bool isAvailable();
+
+        /** \brief Start counting the allocations of the calling thread, discarding any previous counts.
+         *  Does nothing if allocation counting is not compiled in.
+         */
+        void start();
+
+        /** \brief Stop counting the allocations of the calling thread.
+         *  \return The allocations since start(). Zero if allocation counting is not compiled in.
+         */
+        Counts stop();
+    }  // namespace allocation
+}  // namespace robowflex
+
+#endif
@@ -0,0 +1,123 @@
+/* Author: Zachary Kingston */
+
+#ifndef ROBOWFLEX_BATCH_FK_
+#define ROBOWFLEX_BATCH_FK_
+
+#include <string>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <moveit/robot_model/joint_model.h>
+#include <moveit/robot_state/robot_state.h>
+
+#include <robowflex_library/adapter.h>
+#include <robowflex_library/class_forward.h>
+
+namespace robowflex
+{
+    /** \cond IGNORE */
+    ROBOWFLEX_CLASS_FORWARD(Robot);
+    ROBOWFLEX_CLASS_FORWARD(BatchFK);
+    /** \endcond */
+
+    /** \class robowflex::BatchFKPtr
+        \brief A shared pointer wrapper for robowflex::BatchFK. */
+
+    /** \class robowflex::BatchFKConstPtr
+        \brief A const shared pointer wrapper for robowflex::BatchFK. */
+
+    /** \brief Computes the poses of a set of links for many configurations of a group at once.
+     *
+     *  On construction, the kinematic chains from the root of the robot to each selected link are
+     * precomputed. Links that do not depend on the group's joints are fixed to their pose in a reference
+     * state, and the transforms of joints outside of the group are folded into the constant joint origins.
+     * Poses are then computed for all configurations together, in a structure-of-arrays layout where each
+     * element of a transform is a column over all configurations, so each step of a chain is a handful of
+     * vectorized array operations. Revolute and prismatic joints (and mimics of them) are computed in
+     * closed form; other joints fall back to computing each configuration separately.
+     */
+    class BatchFK
+    {
+    public:
+        /** \brief Transforms of a link, one row per configuration. The first nine columns are the rotation in
+         * column-major order, and the last three are the translation.
+         */
+        using Transforms = Eigen::Array<double, Eigen::Dynamic, 12>;
+
+        /** \brief Constructor.
+         *  \param[in] robot Robot to compute poses of.
+         *  \param[in] group Group whose configurations are given.
+         *  \param[in] links Links to compute poses of.
+         *  \param[in] reference State that joints outside of \a group are taken from. If nullptr, uses the
+         * robot's scratch state.
+         */
+        BatchFK(const Robot &robot, const std::string &group, const std::vector<std::string> &links,
+                const robot_state::RobotState *reference = nullptr);
+
+        /** \brief Get the number of variables of the group, i.e., the columns of configurations to compute.
+         *  \return The number of variables.
+         */
+        std::size_t getVariableCount() const;
+
+        /** \brief Get the links computed, in order.
+         *  \return The links.
+         */
+        const std::vector<std::string> &getLinks() const;
+
+        /** \brief Compute the poses of the links for many configurations.
+         *  \param[in] positions Configurations of the group, one per row, with variables in the order of
+         * the group.
+         *  \param[out] transforms Transforms of each link, in the order of getLinks().
+         */
+        void compute(const Eigen::Ref<const Eigen::MatrixXd> &positions,
+                     std::vector<Transforms> &transforms) const;
+
+        /** \brief Get one pose out of a set of transforms.
+         *  \param[in] transforms Transforms of a link.
+         *  \param[in] index Row of the pose.
+         *  \return The pose.
+         */
+        static RobotPose getPose(const Transforms &transforms, Eigen::Index index);
+
+    private:
+        /** \brief Type of transform for a joint along a chain.
+         */
+        enum class Type
+        {
+            FIXED,      ///< Constant transform.
+            REVOLUTE,   ///< Rotation about an axis by a variable.
+            PRISMATIC,  ///< Translation along an axis by a variable.
+            GENERAL     ///< Any other joint, computed per configuration.
+        };
+
+        /** \brief A link along the chains.
+         */
+        struct Stage
+        {
+            ROBOWFLEX_EIGEN;
+
+            int parent{-1};          ///< Index of the stage of the parent link, or -1 for the root.
+            bool varying{false};     ///< If true, the pose depends on the group's configuration.
+            RobotPose pose;          ///< Pose of the link, if it does not vary.
+            RobotPose origin;        ///< Joint origin, composed with the joint's transform if it is fixed.
+            Type type{Type::FIXED};  ///< Type of the joint transform.
+
+            Eigen::Vector3d axis{Eigen::Vector3d::UnitZ()};  ///< Axis of a revolute or prismatic joint.
+            int column{-1};                                  ///< Column of the joint's variable.
+            double factor{1.};                               ///< Mimic factor of the variable.
+            double offset{0.};                               ///< Mimic offset of the variable.
+
+            const robot_model::JointModel *joint{nullptr};  ///< Joint, for general transforms.
+            std::vector<int> columns;                       ///< Column of each joint variable, or -1.
+            std::vector<double> values;                     ///< Reference values of joint variables.
+        };
+
+        std::size_t variables_;                                       ///< Number of group variables.
+        std::vector<std::string> links_;                              ///< Links computed.
+        std::vector<Stage, Eigen::aligned_allocator<Stage>> stages_;  ///< Stages, parents first.
+        std::vector<std::size_t> outputs_;                            ///< Stage of each link computed.
+    };
+}  // namespace robowflex
+
+#endif
@@ -9,6 +9,8 @@
 #include <tuple>
 #include <map>
 #include <fstream>
+#include <functional>
+#include <thread>
 
 #include <boost/variant.hpp>
 
@@ -17,12 +19,16 @@
 #include <moveit/planning_interface/planning_response.h>
 
 #include <robowflex_library/class_forward.h>
+#include <robowflex_library/compact_trajectory.h>
 #include <robowflex_library/io/bag.h>
 #include <robowflex_library/planning.h>
+#include <robowflex_library/pool.h>
+#include <robowflex_library/trajectory.h>
 
 namespace robowflex
 {
     /** \cond IGNORE */
+    ROBOWFLEX_CLASS_FORWARD(Pool);
     ROBOWFLEX_CLASS_FORWARD(Scene);
     ROBOWFLEX_CLASS_FORWARD(Trajectory);
     ROBOWFLEX_CLASS_FORWARD(MotionRequestBuilder);
@@ -86,6 +92,32 @@ namespace robowflex
         bool success;                                     ///< Was the plan successful?
         TrajectoryPtr trajectory;                         ///< The resulting trajectory, if available.
 
+        /** \brief Compact form of \a trajectory, set instead of it by compact(). */
+        CompactTrajectoryPtr compact_trajectory;
+
+        /** \brief Compact form of the response's trajectory, set instead of it by compact(). */
+        CompactTrajectoryPtr compact_response_trajectory;
+
+        /** \brief Replace the trajectory and the response's trajectory with their compact forms, freeing
+         *  their robot states. Does nothing for trajectories that are already compact.
+         */
+        void compact();
+
+        /** \brief Get the resulting trajectory, building it from its compact form if needed.
+         *  \return The trajectory, or nullptr if not available.
+         */
+        TrajectoryPtr getTrajectory() const;
+
+        /** \brief Get the compact form of the resulting trajectory, compacting it if needed.
+         *  \return The compact trajectory, or nullptr if not available.
+         */
+        CompactTrajectoryPtr getCompactTrajectory() const;
+
+        /** \brief Get the response's trajectory, building it from its compact form if needed.
+         *  \return The response's trajectory, or nullptr if not available.
+         */
+        robot_trajectory::RobotTrajectoryPtr getResponseTrajectory() const;
+
         /** \} */
 
         /** \name Timing
@@ -103,6 +135,7 @@ namespace robowflex
         std::string hostname;    ///< Hostname of the machine the plan was run on.
         std::size_t process_id;  ///< Process ID of the process the profiler was run in.
         std::size_t thread_id;   ///< Thread ID of profiler execution.
+        int cpu_id;              ///< CPU the plan finished on, or -1 if unknown.
 
         /** \} */
 
@@ -113,6 +146,30 @@ namespace robowflex
         std::vector<std::map<std::string, std::string>> progress;  ///< Planner progress data.
         std::map<std::string, PlannerMetric> metrics;              ///< Map of metric name to value.
 
+        /** \brief Metrics that are the same for every run of a query, e.g., the planner name. These are
+         *  computed once and shared between runs, rather than copied into \a metrics for every run.
+         */
+        std::shared_ptr<const std::map<std::string, PlannerMetric>> constant_metrics;
+
+        /** \brief Get the value of a metric, either from \a metrics or \a constant_metrics.
+         *  \param[in] name Name of the metric.
+         *  \return The metric value, or nullptr if the metric does not exist.
+         */
+        const PlannerMetric *getMetric(const std::string &name) const;
+
+        /** \brief Get the value of a metric as a number. `time` and `success` are the planning time and
+         *  success of the run.
+         *  \param[in] name Name of the metric.
+         *  \param[out] value The value of the metric.
+         *  \return True if the run has a finite numeric value for the metric, false otherwise.
+         */
+        bool getMetricValue(const std::string &name, double &value) const;
+
+        /** \brief Get all metrics of this run, both from \a metrics and \a constant_metrics.
+         *  \return Map of metric name to value.
+         */
+        std::map<std::string, PlannerMetric> getAllMetrics() const;
+
         /** \brief Retrieves the time series data of a planner progress property for a given X-,Y- pair of
          * progress properties. Will ignore a point if either value is non-finite.
          *  \param[in] xprop The property for the first coordinate.
@@ -146,6 +203,7 @@ namespace robowflex
         double time;                      ///< Total computation time for entire dataset.
         boost::posix_time::ptime start;   ///< Start time of dataset computation.
         boost::posix_time::ptime finish;  ///< End time for dataset computation.
+        double wait_time{0.};  ///< Total time workers waited for trials and for space in the result queue.
 
         /** \} */
 
@@ -158,6 +216,10 @@ namespace robowflex
         bool run_till_timeout;  ///< If true, planners were run to solve the problem as many times as possible
                                 ///< until time ran out.
         std::size_t threads;    ///< Threads used for dataset computation.
+        std::size_t shard{0};   ///< Index of the shard of the experiment this dataset contains.
+        std::size_t shards{1};  ///< Total number of shards the experiment was split into.
+        std::size_t warmup_trials{0};  ///< Unrecorded trials run for each query before recorded trials.
+        bool cold{false};              ///< If true, planner caches were cleared before every trial.
 
         /** \} */
 
@@ -187,9 +249,33 @@ namespace robowflex
          */
         std::vector<PlanDataPtr> getFlatData() const;
 
+        /** \brief Time parameterize the trajectories of all successful runs in parallel on \a pool.
+         *  Adds the `parameterization_time`, `parameterization_success`, and `trajectory_duration` metrics
+         *  to each run with a trajectory, as done by Profiler::Options::parameterize.
+         *  \param[in] pool Thread pool to parameterize trajectories with.
+         *  \param[in] method Time parameterization algorithm to use.
+         *  \param[in] max_velocity Scaling factor for the velocity limits of the joints.
+         *  \param[in] max_acceleration Scaling factor for the acceleration limits of the joints.
+         */
+        void computeTimeParameterization(const Pool &pool, Trajectory::TimeParameterization method,
+                                         double max_velocity = 1., double max_acceleration = 1.);
+
+        /** \brief Merge the data of another dataset, e.g., another shard of the same experiment, into this
+         *  one. Data points are appended under their query names, timing is extended to span both datasets,
+         *  and computation time and threads are summed.
+         *  \param[in] other Dataset to merge into this one.
+         */
+        void merge(const PlanDataSet &other);
+
         /** \} */
     };
 
+    /** \brief Merge a set of datasets, e.g., the shards of an experiment, into a single dataset.
+     *  \param[in] datasets Datasets to merge. The first dataset is used for the experiment parameters.
+     *  \return The merged dataset, or nullptr if \a datasets is empty.
+     */
+    PlanDataSetPtr mergeDataSets(const std::vector<PlanDataSetPtr> &datasets);
+
     /** \cond IGNORE */
     ROBOWFLEX_CLASS_FORWARD(Profiler);
     /** \endcond */
@@ -222,6 +308,23 @@ namespace robowflex
             bool progress{true};           ///< If true, captures planner progress properties (if they exist).
             bool progress_at_least_once{true};  ///< If true, will always run the progress loop at least once.
             double progress_update_rate{0.1};   ///< Update rate for progress callbacks.
+            bool compute_metrics{true};  ///< If false, profilePlan() does not compute metrics. Metrics can
+                                         ///< be computed later with computeMetrics().
+            bool shortcut{false};        ///< If true, shortcuts trajectories before computing metrics, and
+                                         ///< reports the time taken.
+            Trajectory::ShortcutOptions shortcut_options;  ///< Options for shortcutting.
+            bool parameterize{false};    ///< If true, time parameterizes trajectories before computing
+                                         ///< metrics, and reports the time taken.
+            Trajectory::TimeParameterization parameterization{
+                Trajectory::TimeParameterization::TIME_OPTIMAL};  ///< Time parameterization to use.
+            bool isolate{false};         ///< If true, plans in a forked child process, so a crash or leak
+                                         ///< only affects that run, and records the resources it used.
+            double kill_time{60.};       ///< Seconds past the allowed planning time after which an
+                                         ///< isolated run is killed and recorded as failed.
+            bool counters{false};        ///< If true, records performance counters of the planning
+                                         ///< thread and the threads it starts (see profilePlan()).
+            bool allocations{false};     ///< If true, counts heap allocations of the planning thread
+                                         ///< while planning and computing metrics (see profilePlan()).
         };
 
         /** \brief Type for callback function that returns a metric over the results of a planning query.
@@ -273,6 +376,29 @@ namespace robowflex
                                            const planning_interface::MotionPlanRequest &request)>;
 
         /** \brief Profiling a single plan using a \a planner.
+         *
+         *  If Options::isolate is true, the plan is made in a child process forked from this one. The run
+         * is sent back to the parent, with the peak resident memory in MB, CPU time in seconds, and minor
+         * and major page faults of the child as the `process_peak_rss`, `process_cpu_time`,
+         * `process_minor_faults` and `process_major_faults` metrics. If the child crashes, exits early, or
+         * is killed after Options::kill_time, the run is marked as failed, with the `process_crashed`
+         * metric set and the signal that ended the child, if any, in `process_signal`. Metric and progress
+         * callbacks are called in the child, so their side effects are not seen by the caller. Only the
+         * calling thread exists in the child, so planners that wait on threads of their own pools hang
+         * until they are killed.
+         *
+         *  If Options::counters is true, the Linux performance counters of the plan are recorded in the
+         * `perf_cycles`, `perf_instructions`, `perf_cache_misses`, `perf_branch_misses` and
+         * `perf_context_switches` metrics. Hardware events only count user space, and are scaled if the
+         * kernel had to multiplex them. The counters include the calling thread and the threads it starts
+         * that exit before the plan returns, but not threads of pools that already exist. Counters that
+         * are unavailable, e.g., due to `perf_event_paranoid` or in a virtual machine, are left out.
+         *
+         *  If Options::allocations is true, the heap allocations of the calling thread are counted (see
+         * allocation::start()), while planning in the `alloc_plan_count`, `alloc_plan_bytes` and
+         * `alloc_plan_peak_bytes` metrics, and while computing metrics in the `alloc_metrics_count`,
+         * `alloc_metrics_bytes` and `alloc_metrics_peak_bytes` metrics. Allocations are only counted if
+         * Robowflex is compiled with `ROBOWFLEX_ALLOCATION_COUNTING`, and otherwise the metrics are left out.
          *  \param[in] planner Planner to profile.
          *  \param[in] scene Scene to plan in.
          *  \param[in] request Planning request to profile.
@@ -286,6 +412,16 @@ namespace robowflex
                          const Options &options,                                //
                          PlanData &result) const;
 
+        /** \brief Compute the built-in and callback metrics of a profiled run. Called by profilePlan(),
+         *  unless Options::compute_metrics is false. If Options::shortcut is true, the trajectory is first
+         *  shortcut on the shared executor (see Planner::getExecutor()). If Options::parameterize is true,
+         *  the trajectory is then time parameterized. The time taken by each stage is reported in the
+         *  `shortcut_time`, `parameterization_time` and `metrics_time` metrics.
+         *  \param[in] options The options for profiling.
+         *  \param[in,out] result The results of profiling. Metrics are added to this run.
+         */
+        void computeMetrics(const Options &options, PlanData &result) const;
+
         /** \brief Add a callback function to compute a metric at the end of planning.
          *  \param[in] name Name of the metric.
          *  \param[in] metric Function to use for callback.
@@ -308,7 +444,32 @@ namespace robowflex
          */
         void addProgressCallbackAllocator(const ProgressCallbackAllocator &allocator);
 
+        /** \brief Compute the built-in metrics that only depend on the planner and request, and so are the
+         *  same for every run of a query, e.g., the planner name and the hostname. Computed by
+         *  profilePlan() for a run unless it already has PlanData::constant_metrics.
+         *  \param[in] planner Planner used.
+         *  \param[in] request Planning request.
+         *  \param[out] metrics Map to add metrics to.
+         */
+        void computeConstantMetrics(const PlannerPtr &planner,                             //
+                                    const planning_interface::MotionPlanRequest &request,  //
+                                    std::map<std::string, PlannerMetric> &metrics) const;
+
     private:
+        /** \brief Profile a single plan in a forked child process. See profilePlan().
+         *  \param[in] planner Planner to profile.
+         *  \param[in] scene Scene to plan in.
+         *  \param[in] request Planning request to profile.
+         *  \param[in] options The options for profiling.
+         *  \param[out] result The results of profiling.
+         *  \return True if planning succeeded, false on failure.
+         */
+        bool profilePlanIsolated(const PlannerPtr &planner,                             //
+                                 const SceneConstPtr &scene,                            //
+                                 const planning_interface::MotionPlanRequest &request,  //
+                                 const Options &options,                                //
+                                 PlanData &result) const;
+
         /** \brief Compute the built-in metrics according to the provided bitmask \a options.
          *  \param[in] options Bitmask of which built-in metrics to compute.
          *  \param[in] scene Scene used for planning and metric computation.
@@ -334,6 +495,16 @@ namespace robowflex
                                                                            ///< function allocators.
     };
 
+    /** \cond IGNORE */
+    ROBOWFLEX_CLASS_FORWARD(PlanDataStreamOutputter);
+    /** \endcond */
+
+    /** \class robowflex::PlanDataStreamOutputterPtr
+        \brief A shared pointer wrapper for robowflex::PlanDataStreamOutputter. */
+
+    /** \class robowflex::PlanDataStreamOutputterConstPtr
+        \brief A const shared pointer wrapper for robowflex::PlanDataStreamOutputter. */
+
     /** \cond IGNORE */
     ROBOWFLEX_CLASS_FORWARD(Experiment);
     /** \endcond */
@@ -434,6 +605,111 @@ namespace robowflex
          */
         void overridePlanningTime();
 
+        /** \brief Set the maximum number of completed runs that can wait to be added to the dataset.
+         *  Worker threads block when this many results are waiting, so that a slow post-query callback
+         *  limits memory use rather than stalling planning on a lock.
+         *  \param[in] size Capacity of the result queue. If 0, uses twice the number of threads.
+         */
+        void setResultQueueSize(std::size_t size);
+
+        /** \brief Only run one shard of this experiment, so the experiment can be split across processes or
+         *  hosts. The (query, trial) pairs of the experiment are enumerated in order and dealt out
+         *  round-robin to \a count shards, so every process with the same queries computes the same split.
+         *  The resulting datasets can be combined with mergeDataSets().
+         *  \param[in] index Index of the shard to run, in [0, \a count).
+         *  \param[in] count Total number of shards.
+         */
+        void setShard(std::size_t index, std::size_t count);
+
+        /** \brief Compute run metrics on a separate pool of \a n_threads threads, so planning threads can
+         *  move on to the next trial as soon as a plan is made. The post-run callback is called once a
+         *  run's metrics are computed. By default, metrics are computed on the planning thread.
+         *  \param[in] n_threads Number of threads to compute metrics with. If 0, computes metrics on the
+         *  planning threads.
+         */
+        void setMetricThreads(std::size_t n_threads);
+
+        /** \brief Hand out trials by expected time rather than in order. Expected times are learned from
+         *  the completed runs of each query, starting from the allowed planning time, and the free thread
+         *  always takes the trial expected to take longest, so all threads finish at about the same time.
+         *  With run till timeout, each re-run of a trial is scheduled on its own, so a thread does not stay
+         *  on one query until its time runs out. By default, trials are run in order.
+         *  \param[in] adaptive If true, schedule trials by expected time.
+         */
+        void setAdaptiveScheduling(bool adaptive);
+
+        /** \brief Set the placement of benchmarking threads on CPUs, to keep timing stable across runs on
+         *  machines with many cores or NUMA nodes. The CPU each run finished on is recorded as the
+         *  `machine_cpu_id` metric. By default, threads are not pinned.
+         *  \param[in] affinity Placement of the benchmarking threads.
+         */
+        void setAffinity(const Pool::Affinity &affinity);
+
+        /** \brief Run unrecorded warm-up trials of each query before any recorded trial, so one-time costs
+         *  (e.g., creating planning contexts, initializing kinematics plugins, loading meshes) do not land
+         *  in the statistics. Warm-up trials are run on the benchmarking threads, without callbacks or
+         *  metrics, and are not part of the dataset. Note that with Profiler::Options::isolate, warm-up
+         *  trials run in child processes, and so do not warm up the benchmarking process.
+         *  \param[in] n Number of warm-up trials per query.
+         */
+        void setWarmupTrials(std::size_t n);
+
+        /** \brief Clear caches before every trial, so every trial pays the one-time costs of the first.
+         *  Clears the planner's caches (see Planner::clearCaches()), e.g., planning contexts and cached
+         *  results, and the IK cache of the planner's robot, if any. In cold mode, planners must not be
+         *  shared between trials that run at the same time.
+         *  \param[in] cold If true, runs every trial cold.
+         */
+        void setColdTrials(bool cold);
+
+        /** \brief Set a wall-clock budget for the whole experiment. Trials (or with run till timeout,
+         *  re-runs) that are not expected to finish within the remaining budget are not started, and are
+         *  missing from the dataset. Running trials are never cut short.
+         *  \param[in] budget Budget in seconds. If 0, there is no budget.
+         */
+        void setTimeBudget(double budget);
+
+        /** \brief Run a varying number of trials per query, stopping once the confidence interval of the
+         *  mean of \a metric is tight enough. Each query runs at least \a min_trials trials and at most
+         *  \a max_trials, which replaces the experiment's trial count. A few extra trials may run while
+         *  earlier ones are finishing. With shards, each shard stops on its own trials.
+         *  \param[in] metric Metric to watch. Either `time`, `success`, or a numeric run metric, e.g.,
+         *  `length`. Runs without the metric are ignored. If empty, adaptive trials are disabled.
+         *  \param[in] width Target half-width of the confidence interval, in units of the metric.
+         *  \param[in] min_trials Minimum number of trials per query. At least 2.
+         *  \param[in] max_trials Maximum number of trials per query.
+         *  \param[in] confidence Confidence level of the interval.
+         */
+        void setAdaptiveTrials(const std::string &metric, double width, std::size_t min_trials,
+                               std::size_t max_trials, double confidence = 0.95);
+
+        /** \brief Add an outputter that each run is written to as soon as it completes.
+         *  \param[in] outputter Outputter to add.
+         */
+        void addStreamOutputter(const PlanDataStreamOutputterPtr &outputter);
+
+        /** \brief Set whether the trajectory, response trajectory, and progress of runs are kept in the
+         *  dataset after they have been streamed. Metrics are always kept. By default, everything is kept.
+         *  Only has an effect if a stream outputter has been added.
+         *  \param[in] retain If false, bulky run data is freed after it is streamed.
+         */
+        void setRetainStreamedData(bool retain);
+
+        /** \brief Set whether the trajectories of runs are compacted once each run is complete, with
+         *  PlanData::compact(). Compact trajectories store only the positions of the planning group, so
+         *  datasets with many runs take far less memory. Full trajectories are rebuilt by outputters when
+         *  needed. By default, trajectories are not compacted.
+         *  \param[in] compact If true, trajectories of runs are compacted.
+         */
+        void setCompactTrajectories(bool compact);
+
+        /** \brief Export the tracing spans recorded while benchmarking to a Chrome trace file (see
+         *  log::trace::exportChromeTrace()). Spans are only recorded if Robowflex is compiled with
+         *  `ROBOWFLEX_TRACING`. Spans recorded before the benchmark are discarded.
+         *  \param[in] filename File to write the trace to. If empty, no trace is written.
+         */
+        void setTraceFile(const std::string &filename);
+
         /** \} */
 
         /** \name Callback Functions
@@ -474,6 +750,9 @@ namespace robowflex
         /** \} */
 
         /** \brief Run benchmarking on this experiment.
+         *  Runs are profiled on a robowflex::Pool of \a n_threads workers. Completed runs are handed to the
+         *  calling thread through a bounded queue, which adds them to the dataset and calls the post-query
+         *  callback, so a slow callback does not hold up planning.
          *  Note that, for some planners, multiple threads cannot be used without polluting the dataset, due
          *  to reuse of underlying datastructures between queries, e.g., the robowflex_ompl planner.
          *  \param[in] n_threads Number of threads to use for benchmarking.
@@ -491,6 +770,23 @@ namespace robowflex
                                              ///< thread.
         bool override_planning_time_{true};  ///< If true, will override request planning time with global
                                              ///< allowed time.
+        std::size_t result_queue_size_{0};   ///< Capacity of completed run queue. 0 for automatic.
+        std::size_t shard_{0};               ///< Shard of the experiment to run.
+        std::size_t shards_{1};              ///< Number of shards the experiment is split into.
+        bool retain_streamed_{true};         ///< If true, streamed runs keep their trajectories.
+        bool compact_trajectories_{false};   ///< If true, run trajectories are compacted.
+        std::string trace_file_;             ///< File to export tracing spans to. Empty for none.
+        std::size_t metric_threads_{0};      ///< Threads for computing metrics. 0 for planning threads.
+        bool adaptive_scheduling_{false};    ///< If true, trials are scheduled by expected time.
+        Pool::Affinity affinity_;            ///< Placement of benchmarking threads.
+        std::size_t warmup_trials_{0};       ///< Unrecorded warm-up trials per query.
+        bool cold_{false};                   ///< If true, caches are cleared before every trial.
+        double time_budget_{0.};             ///< Wall-clock budget of the experiment. 0 for none.
+        std::string adaptive_metric_;        ///< Metric for adaptive trials. Empty if disabled.
+        double adaptive_width_{0.};          ///< Target confidence interval half-width.
+        double adaptive_confidence_{0.95};   ///< Confidence level of the interval.
+        std::size_t min_trials_{0};          ///< Minimum number of adaptive trials.
+        std::size_t max_trials_{0};          ///< Maximum number of adaptive trials.
 
         Profiler::Options options_;           ///< Options for profiler.
         Profiler profiler_;                   ///< Profiler to use for extracting data.
@@ -499,6 +795,85 @@ namespace robowflex
         PreRunCallback pre_callback_;          ///< Pre-run callback.
         PostRunCallback post_callback_;        ///< Post-run callback.
         PostQueryCallback complete_callback_;  ///< Post-run callback with dataset.
+
+        std::vector<PlanDataStreamOutputterPtr> streams_;  ///< Outputters each run is streamed to.
+    };
+
+    /** \brief Measures how an experiment scales with the number of benchmarking threads.
+     *
+     *  The same experiment is benchmarked at each thread count in turn, e.g., 1, 2, 4, ..., N. For each
+     *  count, the throughput of runs, the speedup and efficiency relative to the first count, the inflation
+     *  of the mean planning time of a run, and the time workers waited on shared state are reported. A
+     *  factory can be given instead of an experiment, so planners that depend on the thread count, e.g., a
+     *  PoolPlanner of the same size, are rebuilt for each count.
+     */
+    class ThreadScaling
+    {
+    public:
+        /** \brief Results of benchmarking at one thread count.
+         */
+        struct Level
+        {
+            std::size_t threads;  ///< Number of threads.
+            std::size_t runs;     ///< Number of completed runs.
+            double time;          ///< Wall-clock time of the experiment, in seconds.
+            double throughput;    ///< Completed runs per second.
+            double speedup;       ///< Throughput relative to the first level.
+            double efficiency;    ///< Speedup divided by the relative number of threads.
+            double run_time;      ///< Mean planning time of a run, in seconds.
+            double inflation;     ///< Mean planning time relative to the first level.
+            double wait;          ///< Mean time waited on the scheduler and result queue per run, in seconds.
+        };
+
+        /** \brief A factory that creates the experiment to benchmark with a number of threads.
+         *  \param[in] threads Number of threads the experiment will be benchmarked with.
+         *  \return The experiment.
+         */
+        using ExperimentFactory = std::function<ExperimentPtr(std::size_t threads)>;
+
+        /** \brief Constructor. Benchmarks the same experiment at each thread count.
+         *  \param[in] experiment Experiment to benchmark.
+         */
+        ThreadScaling(const ExperimentPtr &experiment);
+
+        /** \brief Constructor. Benchmarks a new experiment from \a factory at each thread count.
+         *  \param[in] factory Factory of experiments.
+         */
+        ThreadScaling(const ExperimentFactory &factory);
+
+        /** \brief Get powers of two up to and including \a max threads, e.g., 1, 2, 4, 6 for 6 threads.
+         *  \param[in] max Maximum number of threads.
+         *  \return The thread counts.
+         */
+        static std::vector<std::size_t>
+        getThreadCounts(std::size_t max = std::thread::hardware_concurrency());
+
+        /** \brief Benchmark the experiment at each thread count, in order.
+         *  \param[in] threads Thread counts to benchmark with. The first count is the baseline.
+         *  \return The results at each thread count.
+         */
+        const std::vector<Level> &run(const std::vector<std::size_t> &threads = getThreadCounts());
+
+        /** \brief Get the results of the last run().
+         *  \return The results at each thread count.
+         */
+        const std::vector<Level> &getLevels() const;
+
+        /** \brief Get the datasets computed by the last run(), one per thread count.
+         *  \return The datasets.
+         */
+        const std::vector<PlanDataSetPtr> &getDataSets() const;
+
+        /** \brief Write the results of the last run() as a CSV file, one row per thread count.
+         *  \param[in] filename File to write to.
+         *  \return True on success, false on failure.
+         */
+        bool toCSVFile(const std::string &filename) const;
+
+    private:
+        ExperimentFactory factory_;             ///< Factory of experiments.
+        std::vector<Level> levels_;             ///< Results at each thread count.
+        std::vector<PlanDataSetPtr> datasets_;  ///< Datasets at each thread count.
     };
 
     /** \brief An abstract class for outputting benchmark results.
@@ -517,6 +892,64 @@ namespace robowflex
         virtual void dump(const PlanDataSet &results) = 0;
     };
 
+    /** \brief An abstract class for writing out runs one at a time, as they are completed by
+     *  robowflex::Experiment, rather than holding all of them until the dataset is complete.
+     */
+    class PlanDataStreamOutputter
+    {
+    public:
+        /** \brief Virtual destructor for cleaning up resources.
+         */
+        virtual ~PlanDataStreamOutputter() = default;
+
+        /** \brief Called before any runs of \a dataset are streamed.
+         *  \param[in] dataset The dataset being computed. Contains no data yet.
+         */
+        virtual void begin(const PlanDataSet &dataset);
+
+        /** \brief Write out a single completed run. Must be implemented by child classes.
+         *  \param[in] dataset The dataset being computed.
+         *  \param[in] query_name Name of the query the run is for.
+         *  \param[in] run The completed run.
+         */
+        virtual void stream(const PlanDataSet &dataset, const std::string &query_name,
+                            const PlanData &run) = 0;
+
+        /** \brief Called after all runs of \a dataset have been streamed.
+         *  \param[in] dataset The completed dataset.
+         */
+        virtual void end(const PlanDataSet &dataset);
+    };
+
+    /** \brief A stream outputter that appends each run as one line of JSON to a file (JSON Lines).
+     *  Each line contains the experiment name, the query name, the run name, time, success, all metrics,
+     *  and the progress properties of the run. The file is flushed after each run.
+     */
+    class JSONLPlanDataStreamOutputter : public PlanDataStreamOutputter
+    {
+    public:
+        /** \brief Constructor.
+         *  \param[in] file Filename to save results to.
+         */
+        JSONLPlanDataStreamOutputter(const std::string &file);
+
+        /** \brief Destructor. Closes \a outfile_.
+         */
+        ~JSONLPlanDataStreamOutputter() override;
+
+        /** \brief Appends \a run to \a outfile_, and opens \a outfile_ if not already done so.
+         *  \param[in] dataset The dataset being computed.
+         *  \param[in] query_name Name of the query the run is for.
+         *  \param[in] run The completed run.
+         */
+        void stream(const PlanDataSet &dataset, const std::string &query_name, const PlanData &run) override;
+
+    private:
+        bool is_init_{false};     ///< Have we initialized the outputter (on first result)?
+        const std::string file_;  ///< Filename to open.
+        std::ofstream outfile_;   ///< Output stream.
+    };
+
     /** \brief A benchmark outputter for storing data in a single JSON file.
      */
     class JSONPlanDataSetOutputter : public PlanDataSetOutputter
@@ -543,6 +976,8 @@ namespace robowflex
     };
 
     /** \brief Benchmark outputter that saves each trajectory from each run to a rosbag file.
+     *  For large benchmarks, prefer the `trajectories` group of robowflex::HDF5PlanDataSetOutputter, which
+     *  stores only the joint positions and timing, compressed.
      */
     class TrajectoryPlanDataSetOutputter : public PlanDataSetOutputter
     {
@@ -564,6 +999,40 @@ namespace robowflex
         IO::Bag bag_;             ///< Rosbag handler.
     };
 
+    /** \brief Benchmark outputter that saves results into a columnar HDF5 file.
+     *  Each dumped dataset is a group named after the dataset, containing a group for each query. Each
+     *  query group has a typed column for the time and success of each run, a `metrics` group with one
+     *  column per metric, and a `progress` group with one column per progress property. Progress columns
+     *  are the concatenation of the samples of all runs, where the samples of run `i` are the range
+     *  [`offsets[i]`, `offsets[i + 1]`). String metrics are stored as integer codes into the `categories`
+     *  attribute of their column, so files can also be read with robowflex::IO::HDF5File. If enabled, a
+     *  `trajectories` group stores the trajectory of each run in the same way, as the rows of a `positions`
+     *  matrix (one column per joint in the `joints` attribute) and a `time` column of time from start.
+     */
+    class HDF5PlanDataSetOutputter : public PlanDataSetOutputter
+    {
+    public:
+        /** \brief Constructor.
+         *  \param[in] file Filename to save results to. Overwritten on the first dump.
+         *  \param[in] trajectories If true, also saves the trajectory of each run.
+         *  \param[in] compression Deflate level from 1 to 9 for all columns. If 0, columns are stored
+         *  uncompressed and contiguously, so they can be memory mapped by robowflex::IO::HDF5File.
+         */
+        HDF5PlanDataSetOutputter(const std::string &file, bool trajectories = true,
+                                 unsigned int compression = 4);
+
+        /** \brief Dumps \a results into a new group in \a file_, and creates \a file_ if not already done so.
+         *  \param[in] results Results to dump to file.
+         */
+        void dump(const PlanDataSet &results) override;
+
+    private:
+        bool is_init_{false};              ///< Have we initialized the outputter (on first result)?
+        const std::string file_;           ///< Filename to open.
+        const bool trajectories_;          ///< If true, saves trajectories.
+        const unsigned int compression_;   ///< Deflate level of columns.
+    };
+
     /** \brief Benchmark outputter that saves results into OMPL benchmarking log files. If
      * `ompl_benchmark_statistics.py` is available in your PATH variable, the results are also compiled into a
      * database file.
@@ -582,7 +1051,8 @@ namespace robowflex
         ~OMPLPlanDataSetOutputter() override;
 
         /** \brief Dumps \a results into a OMPL benchmarking log file in \a prefix_ named after the request \a
-         *  name_.
+         *  name_. If \a results is a shard of an experiment, the shard is also included in the filename, so
+         *  shards can be combined by passing all log files to `ompl_benchmark_statistics.py`.
          *  \param[in] results Results to dump to file.
          */
         void dump(const PlanDataSet &results) override;
@@ -16,6 +16,7 @@ namespace robowflex
     /** \cond IGNORE */
     ROBOWFLEX_CLASS_FORWARD(Scene);
     ROBOWFLEX_CLASS_FORWARD(Planner);
+    ROBOWFLEX_CLASS_FORWARD(Pool);
     /** \endcond */
 
     /** \cond IGNORE */
@@ -59,6 +60,21 @@ namespace robowflex
          */
         MotionRequestBuilder(const MotionRequestBuilder &other);
 
+        /** \brief Destructor.
+         */
+        ~MotionRequestBuilder();
+
+        /** \brief Get a cheap fingerprint of a request owned by a live builder, without serializing it.
+         * The fingerprint is the builder's ID key, whose version is incremented by every change made through
+         * the builder. Note that getRequest() and getPathConstraints() also increment the version, as the
+         * returned reference may be modified.
+         *  \param[in] request Request to fingerprint. Must be a builder's own request, as returned by
+         * getRequestConst(); copies are not tracked.
+         *  \param[out] key The fingerprint of the request.
+         *  \return True if \a request belongs to a live builder, false otherwise.
+         */
+        static bool getFingerprint(const planning_interface::MotionPlanRequest &request, ID::Key &key);
+
         /** \brief Clone this request.
          *  \return A copy of this request.
          */
@@ -277,6 +293,27 @@ namespace robowflex
         void precomputeGoalConfigurations(std::size_t n_samples, const ScenePtr &scene,
                                           const ConfigurationValidityCallback &callback = {});
 
+        /** \brief Override the goals of this motion request with goal configurations precomputed in
+         * parallel (from the specified regions).
+         *
+         *  Each thread of \a pool (and the calling thread) samples with its own constraint samplers and
+         * random number generator. Sampling stops once \a n_samples configurations are found, or once the
+         * attempt or time budget runs out. The goals are replaced by the configurations found, even if there
+         * are fewer than \a n_samples. The order of the goals depends on scheduling.
+         *
+         *  \param[in] n_samples Number of samples to precompute.
+         *  \param[in] scene Scene to collision check against.
+         *  \param[in] pool Thread pool to sample on.
+         *  \param[in] max_attempts Maximum number of sampling attempts, across all threads.
+         *  \param[in] timeout If positive, maximum time in seconds to sample for.
+         *  \param[in] callback If provided, will only keep samples that are valid according to callback.
+         *  Must be thread-safe.
+         *  \return True if \a n_samples configurations were found, false otherwise.
+         */
+        bool precomputeGoalConfigurations(std::size_t n_samples, const ScenePtr &scene, const Pool &pool,
+                                          std::size_t max_attempts, double timeout = 0.,
+                                          const ConfigurationValidityCallback &callback = {});
+
         /** \brief Clears all goals.
          */
         void clearGoals();
@@ -358,6 +395,18 @@ namespace robowflex
         void setWorkspaceBounds(const Eigen::Ref<const Eigen::VectorXd> &min,
                                 const Eigen::Ref<const Eigen::VectorXd> &max);
 
+        /** \brief Create a snapshot of a scene with only the collision objects relevant to this request:
+         * those whose bounding boxes intersect the workspace bounds and are within reach of the planning
+         * group from the start configuration. The reach is a conservative bound from the group's joint
+         * offsets, prismatic joint limits, and link geometry. Groups with planar or floating joints are
+         * only cropped to the workspace bounds.
+         *  \param[in] scene Scene to crop.
+         *  \param[in] padding Distance to grow the workspace bounds and reach by, e.g., to allow for
+         * attached objects.
+         *  \return The cropped scene.
+         */
+        ScenePtr cropScene(const SceneConstPtr &scene, double padding = 0.) const;
+
         /** \brief Swap the start and goal configurations.
          * This is only possible when a single joint goal is specified, otherwise an error is raised.
          *  \return True upon success, False otherwise.
@@ -419,13 +468,15 @@ namespace robowflex
         /** \name IO
             \{ */
 
-        /** \brief Serialize the motion planning request to a YAML file \a file.
+        /** \brief Serialize the motion planning request to a YAML file \a file. Files with a `.bin`
+         * extension use the binary format of IO::messageToBinaryFile() instead.
          *  \param[in] file The name of the file to serialize the request to.
          *  \return True on success, false on failure.
          */
         bool toYAMLFile(const std::string &file) const;
 
-        /** \brief Load a planning request from a YAML file \a file.
+        /** \brief Load a planning request from a YAML file \a file, or a binary file if \a file has a
+         * `.bin` extension.
          *  \param[in] file The name of the file to load the request from.
          *  \return True on success, false on failure.
          */
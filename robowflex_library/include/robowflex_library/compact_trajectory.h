@@ -0,0 +1,150 @@
+/* Author: Zachary Kingston */
+
+#ifndef ROBOWFLEX_COMPACT_TRAJECTORY_
+#define ROBOWFLEX_COMPACT_TRAJECTORY_
+
+#include <string>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <moveit/robot_state/robot_state.h>
+#include <moveit/robot_trajectory/robot_trajectory.h>
+
+#include <robowflex_library/class_forward.h>
+
+namespace robowflex
+{
+    /** \cond IGNORE */
+    ROBOWFLEX_CLASS_FORWARD(Trajectory);
+    ROBOWFLEX_CLASS_FORWARD(CompactTrajectory);
+    /** \endcond */
+
+    /** \class robowflex::CompactTrajectoryPtr
+        \brief A shared pointer wrapper for robowflex::CompactTrajectory. */
+
+    /** \class robowflex::CompactTrajectoryConstPtr
+        \brief A const shared pointer wrapper for robowflex::CompactTrajectory. */
+
+    /** \brief A compact, read-only form of a trajectory, for keeping many trajectories in memory.
+     *
+     *  A robot_trajectory::RobotTrajectory stores a full robot state for each waypoint, with every variable
+     *  of the robot and its link transforms. Instead, this stores a single reference state, the positions
+     *  (and velocities and accelerations, if every waypoint has them) of the group's variables as one
+     *  contiguous matrix with a row per waypoint, and the waypoint durations. Conversion is lossless: all
+     *  other variables are taken from the reference state, and if any of them changes along the trajectory,
+     *  every variable of the robot is stored instead. Attached bodies are those of the first waypoint.
+     */
+    class CompactTrajectory
+    {
+    public:
+        /** \brief Constructor.
+         *  \param[in] trajectory Trajectory to compact.
+         */
+        explicit CompactTrajectory(const robot_trajectory::RobotTrajectory &trajectory);
+
+        /** \brief Constructor.
+         *  \param[in] trajectory Trajectory to compact.
+         */
+        explicit CompactTrajectory(const Trajectory &trajectory);
+
+        /** \brief Build the full trajectory, with a robot state for each waypoint.
+         *  \return The full trajectory.
+         */
+        robot_trajectory::RobotTrajectoryPtr toRobotTrajectory() const;
+
+        /** \brief Build the full trajectory, with a robot state for each waypoint.
+         *  \return The full trajectory.
+         */
+        TrajectoryPtr toTrajectory() const;
+
+        /** \brief Get the robot model of the trajectory.
+         *  \return The robot model.
+         */
+        const robot_model::RobotModelConstPtr &getRobotModel() const;
+
+        /** \brief Get the name of the group of the trajectory. Empty if the trajectory has no group.
+         *  \return The group name.
+         */
+        const std::string &getGroupName() const;
+
+        /** \brief Get the state that variables which are not stored are taken from. Null if the trajectory
+         *  has no waypoints.
+         *  \return The reference state.
+         */
+        const robot_state::RobotStateConstPtr &getReferenceState() const;
+
+        /** \brief Get the number of waypoints.
+         *  \return The number of waypoints.
+         */
+        std::size_t getNumWaypoints() const;
+
+        /** \brief Get the names of the stored variables, in the order of the columns of getPositions().
+         *  \return The variable names.
+         */
+        std::vector<std::string> getVariableNames() const;
+
+        /** \brief Get the positions of the stored variables, one row per waypoint.
+         *  \return The positions.
+         */
+        const Eigen::MatrixXd &getPositions() const;
+
+        /** \brief Get the velocities of the stored variables, one row per waypoint. Empty if not every
+         *  waypoint has velocities.
+         *  \return The velocities.
+         */
+        const Eigen::MatrixXd &getVelocities() const;
+
+        /** \brief Get the accelerations of the stored variables, one row per waypoint. Empty if not every
+         *  waypoint has accelerations.
+         *  \return The accelerations.
+         */
+        const Eigen::MatrixXd &getAccelerations() const;
+
+        /** \brief Get the duration of each waypoint from the previous one.
+         *  \return The durations.
+         */
+        const std::vector<double> &getDurations() const;
+
+        /** \brief Get the duration of each waypoint from the start of the trajectory.
+         *  \return The durations from start.
+         */
+        std::vector<double> getDurationsFromStart() const;
+
+        /** \brief Get the names of the joints reported by Trajectory::getJointNames() for the full
+         *  trajectory.
+         *  \return The joint names.
+         */
+        std::vector<std::string> getJointNames() const;
+
+        /** \brief Get the same matrix as Trajectory::getJointMatrix() for the full trajectory, without
+         *  building it.
+         *  \return The trajectory as a waypoints x joints matrix.
+         */
+        Eigen::MatrixXd getJointMatrix() const;
+
+        /** \brief Get the approximate number of bytes used by this trajectory, not counting the reference
+         *  state.
+         *  \return The number of bytes used.
+         */
+        std::size_t getMemoryUsage() const;
+
+    private:
+        /** \brief Get the columns of the joints reported by getJointNames().
+         *  \return The columns of the joints in the stored variables.
+         */
+        std::vector<std::size_t> getJointColumns() const;
+
+        robot_model::RobotModelConstPtr model_;      ///< Robot model of the trajectory.
+        std::string group_;                          ///< Group of the trajectory.
+        robot_state::RobotStateConstPtr reference_;  ///< State that other variables are taken from.
+        std::vector<std::size_t> variables_;         ///< Indices of the stored variables.
+
+        Eigen::MatrixXd positions_;      ///< Positions of the stored variables.
+        Eigen::MatrixXd velocities_;     ///< Velocities of the stored variables, if any.
+        Eigen::MatrixXd accelerations_;  ///< Accelerations of the stored variables, if any.
+        std::vector<double> durations_;  ///< Duration of each waypoint from the previous.
+    };
+}  // namespace robowflex
+
+#endif
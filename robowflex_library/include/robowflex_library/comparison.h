@@ -0,0 +1,106 @@
+/* Author: Zachary Kingston */
+
+#ifndef ROBOWFLEX_COMPARISON_
+#define ROBOWFLEX_COMPARISON_
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <robowflex_library/benchmarking.h>
+
+namespace robowflex
+{
+    /** \brief Load the datasets of a file written by JSONPlanDataSetOutputter. Runs are grouped back into
+     *  their queries by name, and keep their time, success, and metrics. As JSON does not preserve metric
+     *  types, numeric metrics are loaded as doubles, and other values as strings.
+     *  \param[in] file File to load.
+     *  \return The datasets in the file, in order. Empty on failure.
+     */
+    std::vector<PlanDataSetPtr> loadJSONDataSets(const std::string &file);
+
+    /** \brief A statistical comparison of two datasets of the same queries, e.g., from two builds of a
+     *  planner, to catch performance regressions.
+     *
+     *  Queries are matched by name (PlanDataSet::query_names). For each query, every compared metric is
+     *  summarized by its median with a bootstrap confidence interval, and the two samples are compared
+     *  with a two-sided Mann-Whitney U test. Success is summarized by the success rate instead. A metric
+     *  regresses if its median grows by more than a tolerance, and the success rate regresses if it drops
+     *  by more than a tolerance, in both cases only if the test is significant.
+     */
+    class DataSetComparison
+    {
+    public:
+        /** \brief Options for comparing datasets.
+         */
+        struct Options
+        {
+            std::vector<std::string> metrics{"time"};  ///< Metrics to compare, where larger is worse.
+
+            double alpha{0.05};            ///< Significance level of the tests.
+            double confidence{0.95};       ///< Confidence level of the bootstrap intervals.
+            std::size_t resamples{1000};   ///< Number of bootstrap resamples.
+            double tolerance{0.05};        ///< Relative growth of a median that is a regression.
+            double success_tolerance{0.};  ///< Drop in success rate that is a regression.
+            unsigned int seed{0};          ///< Seed of the bootstrap, so comparisons are reproducible.
+        };
+
+        /** \brief Comparison of one metric of one query.
+         */
+        struct Result
+        {
+            std::string query;   ///< Name of the query.
+            std::string metric;  ///< Name of the metric, or `success`.
+            std::size_t base_n;  ///< Number of values in the base dataset.
+            std::size_t test_n;  ///< Number of values in the test dataset.
+            double base;         ///< Median of the base values, or success rate.
+            double test;         ///< Median of the test values, or success rate.
+            double base_lower;   ///< Lower bound of the confidence interval of \a base.
+            double base_upper;   ///< Upper bound of the confidence interval of \a base.
+            double test_lower;   ///< Lower bound of the confidence interval of \a test.
+            double test_upper;   ///< Upper bound of the confidence interval of \a test.
+            double change;       ///< Relative change of the median, or change of the success rate.
+            double p_value;      ///< Two-sided p-value of the Mann-Whitney U test.
+            bool regression;     ///< If true, the test dataset is significantly worse.
+        };
+
+        /** \brief Constructor. Compares the datasets with the default options.
+         *  \param[in] base Reference dataset.
+         *  \param[in] test Dataset to check against \a base.
+         */
+        DataSetComparison(const PlanDataSet &base, const PlanDataSet &test);
+
+        /** \brief Constructor. Compares the datasets.
+         *  \param[in] base Reference dataset.
+         *  \param[in] test Dataset to check against \a base.
+         *  \param[in] options Options for comparing.
+         */
+        DataSetComparison(const PlanDataSet &base, const PlanDataSet &test, const Options &options);
+
+        /** \brief Get the results of the comparison, by query and then by metric.
+         *  \return The results.
+         */
+        const std::vector<Result> &getResults() const;
+
+        /** \brief Check if any metric of any query regressed.
+         *  \return True if there is a regression.
+         */
+        bool hasRegression() const;
+
+        /** \brief Print a table of the results.
+         *  \param[out] out Stream to print to.
+         */
+        void print(std::ostream &out) const;
+
+        /** \brief Write the results to a CSV file.
+         *  \param[in] filename File to write to.
+         *  \return True on success.
+         */
+        bool toCSVFile(const std::string &filename) const;
+
+    private:
+        std::vector<Result> results_;  ///< Results of the comparison.
+    };
+}  // namespace robowflex
+
+#endif
@@ -0,0 +1,171 @@
+/* Author: Zachary Kingston */
+
+#ifndef ROBOWFLEX_DATASET_
+#define ROBOWFLEX_DATASET_
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <robowflex_library/benchmarking.h>
+#include <robowflex_library/class_forward.h>
+#include <robowflex_library/io/archive.h>
+#include <robowflex_library/pool.h>
+
+namespace robowflex
+{
+    /** \cond IGNORE */
+    ROBOWFLEX_CLASS_FORWARD(Planner);
+    ROBOWFLEX_CLASS_FORWARD(Dataset);
+    /** \endcond */
+
+    /** \class robowflex::DatasetPtr
+        \brief A shared pointer wrapper for robowflex::Dataset. */
+
+    /** \class robowflex::DatasetConstPtr
+        \brief A const shared pointer wrapper for robowflex::Dataset. */
+
+    /** \brief A dataset of planning queries stored as pairs of scene and request files.
+     *
+     *  Files are found by directory or glob with findFiles(), and paired up by sorted order with
+     * addEntries(). Alternatively, scenes and requests can be entries of a packed IO::Archive, added with
+     * addArchive(), which avoids opening a file per query. Queries are then either loaded all at once in
+     * parallel on a Pool with load() or addToExperiment(), or streamed with prefetch(), which loads queries
+     * ahead in the background while earlier ones are used.
+     */
+    class Dataset
+    {
+    public:
+        /** \brief The files of a single query.
+         */
+        struct Entry
+        {
+            std::string name;             ///< Name of the query.
+            std::string scene;            ///< Scene file, or entry of \a archive.
+            std::string request;          ///< Request file, or entry of \a archive.
+            IO::ArchiveConstPtr archive;  ///< If set, the archive holding the scene and request.
+        };
+
+        /** \cond IGNORE */
+        ROBOWFLEX_CLASS_FORWARD(Prefetcher);
+        /** \endcond */
+
+        /** \brief Loads queries of a dataset in the background, a bounded number ahead of use.
+         */
+        class Prefetcher
+        {
+        public:
+            /** \brief Constructor. Starts loading the first queries.
+             *  \param[in] dataset Dataset to load queries from.
+             *  \param[in] pool Pool to load queries on.
+             *  \param[in] ahead Maximum number of queries to load ahead. If 0, uses the pool's thread count.
+             */
+            Prefetcher(const DatasetConstPtr &dataset, const PoolPtr &pool, std::size_t ahead = 0);
+
+            /** \brief Destructor. Cancels queries that have not started loading.
+             */
+            ~Prefetcher();
+
+            // non-copyable
+            Prefetcher(Prefetcher const &) = delete;
+            void operator=(Prefetcher const &) = delete;
+
+            /** \brief Get the next successfully loaded query, in dataset order. Blocks until it is loaded,
+             * and starts loading further queries. Entries that fail to load are skipped.
+             *  \param[out] query The next query.
+             *  \return True if there was a next query, false if the dataset is exhausted.
+             */
+            bool next(PlanningQuery &query);
+
+        private:
+            /** \brief Submit loading jobs until \a ahead_ are in flight or all entries are submitted.
+             */
+            void fill();
+
+            DatasetConstPtr dataset_;                                     ///< Dataset to load.
+            PoolPtr pool_;                                                ///< Pool to load on.
+            std::size_t ahead_;                                           ///< Number of queries to load ahead.
+            std::size_t submitted_{0};                                    ///< Number of entries submitted.
+            std::deque<std::shared_ptr<Pool::Job<PlanningQuery>>> jobs_;  ///< Jobs in flight, in order.
+        };
+
+        /** \brief Constructor.
+         *  \param[in] planner Planner to use for all queries. Scenes are created for its robot.
+         *  \param[in] group Planning group of the requests.
+         */
+        Dataset(const PlannerPtr &planner, const std::string &group);
+
+        /** \brief Finds files by directory or glob.
+         *  \param[in] pattern Either a directory, in which case all files in it are returned, or a path
+         * whose last element may contain `*`, `?`, and `[]` wildcards, e.g.,
+         * `package://robowflex_library/yaml/fetch_scenes/scene*.yaml`.
+         *  \return The matching files, in sorted order.
+         */
+        static std::vector<std::string> findFiles(const std::string &pattern);
+
+        /** \brief Adds an entry to the dataset.
+         *  \param[in] entry Entry to add.
+         */
+        void addEntry(const Entry &entry);
+
+        /** \brief Adds entries by pairing up the files of two patterns (see findFiles()) in sorted order.
+         *  \param[in] scenes Pattern of the scene files.
+         *  \param[in] requests Pattern of the request files.
+         *  \param[in] name Name to give each query.
+         *  \return True if both patterns matched the same, non-zero number of files, false otherwise. No
+         * entries are added on failure.
+         */
+        bool addEntries(const std::string &scenes, const std::string &requests, const std::string &name);
+
+        /** \brief Adds entries by pairing up the `scene/` and `request/` entries of an archive, as written
+         * by the `pack_dataset` script, in sorted order. Only the index of the archive is read, and queries
+         * are read from its mapping when loaded.
+         *  \param[in] file Archive file.
+         *  \param[in] name Name to give each query.
+         *  \return True if the archive has the same, non-zero number of scenes and requests, false
+         * otherwise. No entries are added on failure.
+         */
+        bool addArchive(const std::string &file, const std::string &name);
+
+        /** \brief Get the entries of the dataset.
+         *  \return The entries.
+         */
+        const std::vector<Entry> &getEntries() const;
+
+        /** \brief Loads the query of a single entry.
+         *  \param[in] entry Entry to load.
+         *  \param[out] query The loaded query.
+         *  \return True on success, false on failure.
+         */
+        bool loadQuery(const Entry &entry, PlanningQuery &query) const;
+
+        /** \brief Loads the queries of all entries in parallel. Entries that fail to load are skipped.
+         *  \param[in] pool Pool to load queries on.
+         *  \return The loaded queries, in dataset order.
+         */
+        std::vector<PlanningQuery> load(const Pool &pool) const;
+
+        /** \brief Loads the queries of all entries in parallel and adds them to an experiment.
+         *  \param[in] experiment Experiment to add queries to.
+         *  \param[in] pool Pool to load queries on.
+         *  \return The number of queries added.
+         */
+        std::size_t addToExperiment(Experiment &experiment, const Pool &pool) const;
+
+        /** \brief Creates a prefetcher that streams the queries of a dataset.
+         *  \param[in] dataset Dataset to stream. Shared with the prefetcher, so it outlives loading jobs.
+         *  \param[in] pool Pool to load queries on.
+         *  \param[in] ahead Maximum number of queries to load ahead. If 0, uses the pool's thread count.
+         *  \return The prefetcher.
+         */
+        static PrefetcherPtr prefetch(const DatasetConstPtr &dataset, const PoolPtr &pool,
+                                      std::size_t ahead = 0);
+
+    private:
+        PlannerPtr planner_;          ///< Planner for all queries.
+        std::string group_;           ///< Planning group of the requests.
+        std::vector<Entry> entries_;  ///< Entries of the dataset.
+    };
+}  // namespace robowflex
+
+#endif
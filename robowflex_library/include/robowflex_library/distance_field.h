@@ -0,0 +1,110 @@
+/* Author: Zachary Kingston */
+
+#ifndef ROBOWFLEX_DISTANCE_FIELD_
+#define ROBOWFLEX_DISTANCE_FIELD_
+
+#include <map>
+#include <mutex>
+#include <memory>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <geometric_shapes/shapes.h>
+
+#include <moveit/distance_field/propagation_distance_field.h>
+#include <moveit/robot_state/robot_state.h>
+
+#include <robowflex_library/adapter.h>
+#include <robowflex_library/class_forward.h>
+
+namespace robowflex
+{
+    /** \cond IGNORE */
+    ROBOWFLEX_CLASS_FORWARD(Scene);
+    ROBOWFLEX_CLASS_FORWARD(DistanceField);
+    /** \endcond */
+
+    /** \class robowflex::DistanceFieldPtr
+        \brief A shared pointer wrapper for robowflex::DistanceField. */
+
+    /** \class robowflex::DistanceFieldConstPtr
+        \brief A const shared pointer wrapper for robowflex::DistanceField. */
+
+    /** \brief A voxelized signed distance field of the collision objects in a scene, built on _MoveIt!_'s
+     * distance_field::PropagationDistanceField.
+     *
+     *  The field covers the bounding box of the scene's collision objects, padded by the maximum distance.
+     * Robot clearance is approximated by the bounding sphere of each collision shape of the robot (and its
+     * attached bodies), so lookups are constant time per shape. Distances are accurate to about the
+     * resolution, and are capped at the maximum distance. The field is a snapshot: it does not update when
+     * the scene changes. Use Scene::getDistanceField() to get a field that is rebuilt as needed.
+     */
+    class DistanceField
+    {
+    public:
+        /** \brief Constructor. Builds the field from the collision objects of \a scene.
+         *  \param[in] scene Scene to build the field from.
+         *  \param[in] resolution Size of a voxel.
+         *  \param[in] max_distance Maximum distance to compute; also the padding around the objects.
+         */
+        DistanceField(const Scene &scene, double resolution, double max_distance);
+
+        /** \brief Get the signed distance from a point to the nearest collision object.
+         *  \param[in] point Point in the scene's planning frame.
+         *  \return The distance, negative inside objects. Points outside the field return the maximum
+         *  distance.
+         */
+        double getDistance(const Eigen::Vector3d &point) const;
+
+        /** \brief Get the approximate distance between a robot state and the nearest collision object, using
+         * the bounding spheres of the robot's collision shapes and attached bodies.
+         *  \param[in] state State of the robot. Collision body transforms must be up to date.
+         *  \return The distance, negative if in collision.
+         */
+        double getDistance(const robot_state::RobotState &state) const;
+
+        /** \brief Get the resolution of the field.
+         *  \return The resolution.
+         */
+        double getResolution() const;
+
+        /** \brief Get the maximum distance of the field.
+         *  \return The maximum distance.
+         */
+        double getMaxDistance() const;
+
+    private:
+        /** \brief A bounding sphere of a collision shape.
+         */
+        struct Sphere
+        {
+            Eigen::Vector3d center;  ///< Center of the sphere in the shape's frame.
+            double radius;           ///< Radius of the sphere.
+        };
+
+        /** \brief Get the bounding sphere of a shape, computing it if it is not yet cached.
+         *  \param[in] shape Shape to get the bounding sphere of.
+         *  \return The bounding sphere.
+         */
+        Sphere getSphere(const shapes::ShapeConstPtr &shape) const;
+
+        /** \brief Compute the clearance of a set of shapes.
+         *  \param[in] shapes Shapes to check.
+         *  \param[in] poses Global poses of the shapes.
+         *  \return The minimum distance of any shape's bounding sphere.
+         */
+        double getShapesDistance(const std::vector<shapes::ShapeConstPtr> &shapes,
+                                 const RobotPoseVector &poses) const;
+
+        const double resolution_;    ///< Resolution of the field.
+        const double max_distance_;  ///< Maximum distance of the field.
+
+        std::shared_ptr<distance_field::PropagationDistanceField> field_;  ///< Underlying field.
+
+        mutable std::mutex mutex_;                                 ///< Sphere cache mutex.
+        mutable std::map<shapes::ShapeConstPtr, Sphere> spheres_;  ///< Cached bounding spheres.
+    };
+}  // namespace robowflex
+
+#endif
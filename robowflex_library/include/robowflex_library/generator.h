@@ -0,0 +1,167 @@
+/* Author: Zachary Kingston */
+
+#ifndef ROBOWFLEX_GENERATOR_
+#define ROBOWFLEX_GENERATOR_
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <robowflex_library/adapter.h>
+#include <robowflex_library/class_forward.h>
+#include <robowflex_library/pool.h>
+
+namespace robowflex
+{
+    /** \cond IGNORE */
+    ROBOWFLEX_CLASS_FORWARD(Scene);
+    ROBOWFLEX_CLASS_FORWARD(MotionRequestBuilder);
+    /** \endcond */
+
+    /** \brief Generates randomized planning queries from a template scene and request, in parallel.
+     *
+     *  Each query is generated from a deep copy of the template scene and a clone of the template
+     * request. Objects registered with addObjectPerturbation() are moved by a uniformly sampled offset
+     * about their template pose, the scene callback is called to further randomize the scene, the start
+     * state is checked for collision, the request callback is called to set up the request (e.g., sample
+     * goals), and finally goal configurations are precomputed if Options::goal_samples is set. Any step
+     * that fails rejects the attempt, and the query is retried from the templates, up to
+     * Options::max_attempts times.
+     *
+     *  Query \e i samples from the RNG stream `Options::stream + i` (see RNG::setStream()) for all of its
+     * attempts, so the scenes generated for a given master seed do not depend on the number of threads or
+     * on scheduling. Note that goal configurations are drawn by MoveIt's constraint samplers, which use
+     * their own random number generators.
+     */
+    class QueryGenerator
+    {
+    public:
+        /** \brief Options for generation.
+         */
+        struct Options
+        {
+            std::size_t max_attempts{100};   ///< Attempts per query before it is dropped.
+            std::size_t stream{1000};        ///< RNG stream of the first query.
+            bool check_start{true};          ///< Reject scenes where the start state is in collision.
+            std::size_t goal_samples{0};     ///< If non-zero, goal configurations to precompute.
+            std::size_t goal_attempts{500};  ///< Sampling attempts for the goal configurations.
+            std::size_t ahead{0};            ///< Queries held ahead of the output. If 0, four per thread.
+        };
+
+        /** \brief A generated query.
+         */
+        struct Query
+        {
+            std::size_t index;                ///< Index of the query.
+            std::size_t attempts;             ///< Attempts taken to generate the query.
+            ScenePtr scene;                   ///< Generated scene.
+            MotionRequestBuilderPtr request;  ///< Generated request.
+        };
+
+        /** \brief Callback to randomize a scene. Returns false to reject the scene. Must be thread-safe.
+         */
+        using SceneCallback = std::function<bool(const ScenePtr &scene)>;
+
+        /** \brief Callback to set up a request in its generated scene. Returns false to reject the query.
+         * Must be thread-safe.
+         */
+        using RequestCallback =
+            std::function<bool(const ScenePtr &scene, const MotionRequestBuilderPtr &request)>;
+
+        /** \brief Callback for generated queries, called on the thread calling generate(), in index order.
+         */
+        using QueryCallback = std::function<void(const Query &query)>;
+
+        /** \brief Constructor, with the default options.
+         *  \param[in] scene Template scene.
+         *  \param[in] request Template request.
+         */
+        QueryGenerator(const SceneConstPtr &scene, const MotionRequestBuilderConstPtr &request);
+
+        /** \brief Constructor.
+         *  \param[in] scene Template scene.
+         *  \param[in] request Template request.
+         *  \param[in] options Options for generation.
+         */
+        QueryGenerator(const SceneConstPtr &scene, const MotionRequestBuilderConstPtr &request,
+                       const Options &options);
+
+        /** \brief Randomize the pose of an object in every query, by a pose sampled with
+         * TF::samplePoseUniform() about the object's pose in the template scene.
+         *  \param[in] name Name of the object.
+         *  \param[in] pos_bounds Bounds of the position offset.
+         *  \param[in] orn_bounds Bounds of the orientation offset.
+         */
+        void addObjectPerturbation(const std::string &name, const Eigen::Vector3d &pos_bounds,
+                                   const Eigen::Vector3d &orn_bounds);
+
+        /** \brief Set the callback to randomize scenes with, after objects are perturbed.
+         *  \param[in] callback Callback to use.
+         */
+        void setSceneCallback(const SceneCallback &callback);
+
+        /** \brief Set the callback to set up requests with, once the scene is generated.
+         *  \param[in] callback Callback to use.
+         */
+        void setRequestCallback(const RequestCallback &callback);
+
+        /** \brief Generate a single query. Used by generate(), and can be used to regenerate a query.
+         *  \param[in] index Index of the query.
+         *  \param[out] query The generated query.
+         *  \return True on success, false if every attempt was rejected.
+         */
+        bool generateQuery(std::size_t index, Query &query) const;
+
+        /** \brief Generate queries in parallel, streaming them to a callback in index order as they are
+         * done. Only Options::ahead queries are held at a time, so large sets can be generated without
+         * keeping them in memory.
+         *  \param[in] n Number of queries to generate.
+         *  \param[in] pool Pool to generate on.
+         *  \param[in] callback Callback for each generated query. Queries that failed are skipped.
+         *  \return The number of queries generated.
+         */
+        std::size_t generate(std::size_t n, const Pool &pool, const QueryCallback &callback) const;
+
+        /** \brief Generate queries in parallel and write them to a directory, as
+         * `<directory>/<name>_scene_<index>.yaml` and `<directory>/<name>_request_<index>.yaml`. The files
+         * can be loaded back with Dataset::addEntries().
+         *  \param[in] n Number of queries to generate.
+         *  \param[in] pool Pool to generate on.
+         *  \param[in] directory Directory to write to.
+         *  \param[in] name Prefix of the file names.
+         *  \return The number of queries written.
+         */
+        std::size_t generateToDirectory(std::size_t n, const Pool &pool, const std::string &directory,
+                                        const std::string &name = "query") const;
+
+    private:
+        /** \brief An object to perturb.
+         */
+        struct Perturbation
+        {
+            ROBOWFLEX_EIGEN;
+
+            std::string name;            ///< Name of the object.
+            RobotPose pose;              ///< Pose in the template scene.
+            Eigen::Vector3d pos_bounds;  ///< Bounds of the position offset.
+            Eigen::Vector3d orn_bounds;  ///< Bounds of the orientation offset.
+        };
+
+        /** \brief Make a single attempt at generating a query.
+         *  \param[out] query Query to generate into.
+         *  \return True on success, false if the attempt was rejected.
+         */
+        bool attempt(Query &query) const;
+
+        SceneConstPtr scene_;                   ///< Template scene.
+        MotionRequestBuilderConstPtr request_;  ///< Template request.
+        const Options options_;                 ///< Options for generation.
+        SceneCallback scene_callback_;          ///< Callback to randomize scenes.
+        RequestCallback request_callback_;      ///< Callback to set up requests.
+        const Pool serial_{0};                  ///< Pool without workers, to sample goals serially.
+
+        std::vector<Perturbation, Eigen::aligned_allocator<Perturbation>> perturbations_;  ///< Objects.
+    };
+}  // namespace robowflex
+
+#endif
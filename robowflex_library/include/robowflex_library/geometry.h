@@ -97,6 +97,8 @@ namespace robowflex
         static GeometryPtr makeSolidPrimitive(const shape_msgs::SolidPrimitive &msg);
 
         /** \brief Create a mesh from resource file.
+         *  Meshes are shared through a process-wide cache keyed by the resolved resource, its modification
+         * time, and the scale, so each unique asset is only loaded once while it is in use.
          *  \param[in] resource The resource to load for the mesh.
          *  \param[in] scale The scale of the mesh.
          *  \return The created mesh.
@@ -109,6 +111,27 @@ namespace robowflex
          */
         static GeometryPtr makeMesh(const EigenSTL::vector_Vector3d &vertices);
 
+        /** \brief Create geometry from a MoveIt shape.
+         *  Meshes are shared through a process-wide cache keyed by their contents, so identical meshes
+         * (e.g., many instances of one asset across scenes) share one shape and body.
+         *  \param[in] shape Shape to construct geometry from.
+         *  \return The created geometry.
+         */
+        static GeometryPtr makeShape(const shapes::Shape &shape);
+
+        /** \brief Get the convex hull of a mesh, as a mesh.
+         *  Hulls are kept in a process-wide cache keyed by a hash of the mesh's contents, so each is only
+         * computed once, and can be shared by MoveIt and Tesseract collision objects.
+         *  \param[in] mesh Mesh to get the hull of.
+         *  \return The convex hull, or nullptr if the mesh has no hull (e.g., it is flat).
+         */
+        static shapes::ShapeConstPtr getConvexHull(const shapes::Mesh &mesh);
+
+        /** \brief Clears the cache of shared meshes used by makeMesh() and makeShape(), and the cache of
+         * convex hulls used by getConvexHull(). Geometry that is still in use is unaffected.
+         */
+        static void clearCache();
+
         /** \brief Constructor.
          *  Builds and loads the specified geometry.
          *  \param[in] type Type of the geometry to create.
@@ -148,12 +171,29 @@ namespace robowflex
          */
         bool contains(const Eigen::Vector3d &point) const;
 
-        /** \brief Tries to sample a point in the geometry.
-         *  \param[in] attempts Number of attempts to sample.
+        /** \brief Checks which of a set of points the geometry contains.
+         *  \param[in] points The points to check, one per column, in the geometry's frame.
+         *  \return For each point, true if the geometry contains the point, false otherwise.
+         */
+        Eigen::Array<bool, Eigen::Dynamic, 1>
+        contains(const Eigen::Ref<const Eigen::Matrix3Xd> &points) const;
+
+        /** \brief Tries to sample a point uniformly in the geometry. Primitives and meshes are sampled
+         * directly, which always succeeds. Rejection sampling is only used for meshes without a usable
+         * convex hull.
+         *  \param[in] attempts Number of attempts to sample, if rejection sampling.
          *  \return The sampled point and true, or the 0 vector and false on failure.
          */
         std::pair<bool, Eigen::Vector3d> sample(const unsigned int attempts = 50) const;
 
+        /** \brief Samples a set of points uniformly in the geometry. See sample().
+         *  \param[out] points Sampled points, one per column. The number of columns is the number of
+         * points to sample.
+         *  \param[in] attempts Number of attempts to sample each point, if rejection sampling.
+         *  \return True if all points were sampled, false otherwise.
+         */
+        bool sample(Eigen::Ref<Eigen::Matrix3Xd> points, const unsigned int attempts = 50) const;
+
         /** \brief Checks if the geometry is a mesh geometry.
          *  \return True if the \a type_ is a mesh (ShapeType::MESH).
          */
@@ -179,6 +219,12 @@ namespace robowflex
          */
         const bodies::BodyPtr &getBody() const;
 
+        /** \brief Gets the convex hull of mesh geometry, from the cache used by getConvexHull(const
+         * shapes::Mesh &). The hull is taken from the body of the geometry, so it is not recomputed.
+         *  \return The convex hull, or nullptr if the geometry is not a mesh or has no hull.
+         */
+        shapes::ShapeConstPtr getConvexHull() const;
+
         /** \brief Gets the type of the geometry.
          *  \return The type of geometry.
          */
@@ -216,12 +262,21 @@ namespace robowflex
          */
         bodies::Body *loadBody() const;
 
+        /** \brief Prepares direct sampling of a mesh, by splitting its convex hull into tetrahedra
+         * around its center.
+         */
+        void loadSampler();
+
         ShapeType::Type type_{ShapeType::Type::BOX};           ///< Geometry Type.
         Eigen::Vector3d dimensions_{Eigen::Vector3d::Ones()};  ///< Dimensions to scale geometry.
         EigenSTL::vector_Vector3d vertices_{{}};               ///< Vertices of the primitive
         std::string resource_{""};                             ///< Resource locator for MESH types.
         shapes::ShapePtr shape_{nullptr};                      ///< Loaded shape.
         bodies::BodyPtr body_{nullptr};                        ///< Body operation.
+
+        EigenSTL::vector_Vector3d tetrahedra_;  ///< Vertices of mesh tetrahedra, three per tetrahedron.
+        Eigen::Vector3d center_;                ///< Shared vertex of all mesh tetrahedra.
+        std::vector<double> volumes_;           ///< Cumulative volume of mesh tetrahedra.
     };
 }  // namespace robowflex
 
@@ -4,6 +4,7 @@
 #define ROBOWFLEX_ID_
 
 #include <atomic>
+#include <cstdint>
 #include <string>
 
 #include <robowflex_library/class_forward.h>
@@ -22,13 +23,17 @@ namespace robowflex
 
     /** \brief Adds functionality to uniquely ID a specific class as well as the "version" of that class,
      * managed by an incrementing counter.
+     *
+     *  IDs are integers from a process-wide counter, so creating and comparing them is cheap. The string
+     * form of an ID, which is also unique across processes, is only made on demand by getID().
      */
     class ID
     {
     public:
-        /** \brief A snapshot of the state of an ID. Can be compared against another ID.
+        /** \brief A snapshot of the state of an ID, as the numeric ID and version. Can be compared against
+         * another ID.
          */
-        using Key = std::pair<std::string, std::size_t>;
+        using Key = std::pair<std::uint64_t, std::size_t>;
 
         /** \brief Get a null key for initialization.
          *  \return The null key.
@@ -39,10 +44,16 @@ namespace robowflex
          */
         ID();
 
-        /** \brief Get the unique ID for this object.
+        /** \brief Get the unique ID for this object as a string, unique across processes.
          *  \return The unique ID.
          */
-        const std::string &getID() const;
+        std::string getID() const;
+
+        /** \brief Get the unique ID for this object as a number, unique within this process. Never 0,
+         * which is the ID of the null key.
+         *  \return The unique ID.
+         */
+        std::uint64_t getNumericID() const;
 
         /** \brief Get the current version of this object.
          *  \return The version number.
@@ -72,7 +83,7 @@ namespace robowflex
         void incrementVersion();
 
     private:
-        const std::string id_;        ///< Unique object ID
+        const std::uint64_t id_;      ///< Unique object ID
         std::atomic_size_t version_;  ///< Version number.
     };
 
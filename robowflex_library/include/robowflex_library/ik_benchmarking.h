@@ -0,0 +1,154 @@
+/* Author: Zachary Kingston */
+
+#ifndef ROBOWFLEX_IK_BENCHMARKING_
+#define ROBOWFLEX_IK_BENCHMARKING_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <robowflex_library/adapter.h>
+#include <robowflex_library/benchmarking.h>
+#include <robowflex_library/class_forward.h>
+#include <robowflex_library/constants.h>
+
+namespace robowflex
+{
+    /** \cond IGNORE */
+    ROBOWFLEX_CLASS_FORWARD(Robot);
+    ROBOWFLEX_CLASS_FORWARD(Scene);
+    ROBOWFLEX_CLASS_FORWARD(IKExperiment);
+    /** \endcond */
+
+    /** \class robowflex::IKExperimentPtr
+        \brief A shared pointer wrapper for robowflex::IKExperiment. */
+
+    /** \class robowflex::IKExperimentConstPtr
+        \brief A const shared pointer wrapper for robowflex::IKExperiment. */
+
+    /** \brief Benchmarks the throughput and quality of IK solvers, e.g., to pick a kinematics plugin (KDL,
+     * TRAC-IK, IKFast, ...) for a robot.
+     *
+     *  Reachable targets are generated by forward kinematics of random configurations of the group, so
+     * every target has a solution. Every added kinematics configuration then solves the same targets with
+     * Robot::setFromIK(), on a chosen number of threads at once. As the solvers of a robot are fixed once
+     * it is loaded, each configuration is a robot loaded from the same description with a different
+     * kinematics file, e.g., with Robot::initialize(), which passes it to Robot::initializeKinematics().
+     *
+     *  Results are returned as a PlanDataSet with one query per configuration and one run per target, so
+     * they can be written with any PlanDataSetOutputter. The time of a run is its IK solve time, and its
+     * success whether IK succeeded. Each run also has the `ik_target` index, and, for solved targets, the
+     * `ik_position_error` and `ik_orientation_error` of the tip from the target (in meters and radians),
+     * and the `ik_joint_distance` of the solution from the seed state. Solve rates and latency percentiles
+     * of each configuration are summarized by getSummaries().
+     */
+    class IKExperiment
+    {
+    public:
+        /** \brief Options for the experiment.
+         */
+        struct Options
+        {
+            std::size_t targets{1000};                               ///< Number of targets to solve.
+            std::size_t threads{1};                                  ///< Number of threads solving at once.
+            double timeout{0.05};                                    ///< Timeout of each IK solve.
+            std::size_t attempts{1};                                 ///< IK attempts per target.
+            double radius{constants::ik_tolerance};                  ///< Position tolerance of targets.
+            Eigen::Vector3d tolerance{constants::ik_vec_tolerance};  ///< Orientation tolerances.
+            bool random_seed{true};                                  ///< Solve from random seed states.
+            unsigned int seed{0};                                    ///< Seed of targets and seed states.
+            std::size_t max_samples{100};                            ///< Samples tried per target.
+        };
+
+        /** \brief Summary of the runs of one kinematics configuration.
+         */
+        struct Summary
+        {
+            std::size_t runs{0};           ///< Number of targets solved for.
+            std::size_t solved{0};         ///< Number of targets solved.
+            double solve_rate{0.};         ///< Fraction of targets solved.
+            double throughput{0.};         ///< Targets attempted per second of wall-clock time.
+            double latency_mean{0.};       ///< Mean solve time, in seconds.
+            double latency_p50{0.};        ///< Median solve time, in seconds.
+            double latency_p90{0.};        ///< 90th percentile solve time, in seconds.
+            double latency_p99{0.};        ///< 99th percentile solve time, in seconds.
+            double position_error{0.};     ///< Mean position error of solutions.
+            double orientation_error{0.};  ///< Mean orientation error of solutions.
+            double joint_distance{0.};     ///< Mean distance of solutions from their seed states.
+        };
+
+        /** \brief Constructor.
+         *  \param[in] name Name of the experiment.
+         *  \param[in] group Group to solve IK for.
+         *  \param[in] tip Tip link of the targets. If empty, the solver tip frame of the group.
+         *  \param[in] options Options for the experiment.
+         */
+        IKExperiment(const std::string &name, const std::string &group, const std::string &tip,
+                     const Options &options);
+
+        /** \brief Add a kinematics configuration to benchmark.
+         *  \param[in] name Name of the configuration, used as the query name of its runs.
+         *  \param[in] robot Robot loaded with the configuration's kinematics file.
+         */
+        void addKinematics(const std::string &name, const RobotPtr &robot);
+
+        /** \brief Set a scene to collision check against. Targets whose configurations are in collision
+         *  are resampled, and IK is collision-aware.
+         *  \param[in] scene Scene to use.
+         */
+        void setScene(const SceneConstPtr &scene);
+
+        /** \brief Generate the targets, from the first configuration's robot. Called by benchmark() if
+         *  there are none yet.
+         *  \return True on success, false if a target could not be sampled.
+         */
+        bool generateTargets();
+
+        /** \brief Get the target poses of the tip.
+         *  \return The targets.
+         */
+        const RobotPoseVector &getTargets() const;
+
+        /** \brief Run the experiment. Configurations are benchmarked one after another.
+         *  \return The results, or nullptr on failure.
+         */
+        PlanDataSetPtr benchmark();
+
+        /** \brief Get the summaries of the last benchmark(), by configuration name.
+         *  \return The summaries.
+         */
+        const std::map<std::string, Summary> &getSummaries() const;
+
+        /** \brief Summarize the runs of a configuration.
+         *  \param[in] runs Runs to summarize.
+         *  \param[in] time Wall-clock time taken by the runs, in seconds.
+         *  \return The summary.
+         */
+        static Summary summarize(const std::vector<PlanDataPtr> &runs, double time);
+
+        /** \brief Write the summaries of the last benchmark() as a CSV file, one row per configuration.
+         *  \param[in] filename File to write to.
+         *  \return True on success, false on failure.
+         */
+        bool toCSVFile(const std::string &filename) const;
+
+    private:
+        /** \brief Solve all targets with one configuration.
+         *  \param[in] name Name of the configuration.
+         *  \param[in] robot Robot of the configuration.
+         *  \param[out] dataset Dataset to add runs to.
+         */
+        void benchmarkKinematics(const std::string &name, const RobotPtr &robot, PlanDataSet &dataset);
+
+        const std::string name_;                                    ///< Name of the experiment.
+        const std::string group_;                                   ///< Group to solve IK for.
+        std::string tip_;                                           ///< Tip link of the targets.
+        const Options options_;                                     ///< Options for the experiment.
+        SceneConstPtr scene_;                                       ///< Scene to check against.
+        std::vector<std::pair<std::string, RobotPtr>> kinematics_;  ///< Configurations to benchmark.
+        RobotPoseVector targets_;                                   ///< Target poses of the tip.
+        std::map<std::string, Summary> summaries_;                  ///< Summaries of the last run.
+    };
+}  // namespace robowflex
+
+#endif
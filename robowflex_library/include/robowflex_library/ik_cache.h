@@ -0,0 +1,127 @@
+/* Author: Zachary Kingston */
+
+#ifndef ROBOWFLEX_IK_CACHE_
+#define ROBOWFLEX_IK_CACHE_
+
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <robowflex_library/class_forward.h>
+#include <robowflex_library/robot.h>
+
+namespace robowflex
+{
+    /** \cond IGNORE */
+    ROBOWFLEX_CLASS_FORWARD(IKCache);
+    /** \endcond */
+
+    /** \class robowflex::IKCachePtr
+        \brief A shared pointer wrapper for robowflex::IKCache. */
+
+    /** \class robowflex::IKCacheConstPtr
+        \brief A const shared pointer wrapper for robowflex::IKCache. */
+
+    /** \brief A least-recently-used cache of IK solutions, keyed by the group, tips, and quantized target
+     * poses of a Robot::IKQuery.
+     *
+     *  Each key holds a small number of solutions (the joint positions of the query's group), most recent
+     * first. Attach a cache to a robot with Robot::setIKCache(). Robot::setFromIK() then tries cached
+     * solutions before running the solver, and adds new solutions to the cache. Cached solutions are
+     * always validated against the query, so the quantization only needs to be fine enough to give good
+     * seeds. The cache is thread-safe.
+     */
+    class IKCache
+    {
+    public:
+        /** \brief Constructor.
+         *  \param[in] position_resolution Resolution to quantize target positions to.
+         *  \param[in] orientation_resolution Resolution to quantize target orientation quaternions to.
+         *  \param[in] capacity Maximum number of keys to store before evicting the least recently used.
+         *  \param[in] seeds Maximum number of solutions to store per key.
+         */
+        IKCache(double position_resolution = 1e-3, double orientation_resolution = 1e-2,
+                std::size_t capacity = 1000, std::size_t seeds = 4);
+
+        /** \brief Get the cached solutions for a query, most recent first. Marks the key as recently used.
+         *  \param[in] query Query to get solutions for. Tips must be filled in.
+         *  \param[out] seeds Cached solutions for the query.
+         *  \return True if there are cached solutions for the query, false otherwise.
+         */
+        bool lookup(const Robot::IKQuery &query, std::vector<std::vector<double>> &seeds) const;
+
+        /** \brief Add a solution for a query to the cache.
+         *  \param[in] query Query that was solved. Tips must be filled in.
+         *  \param[in] state State that solves the query.
+         */
+        void insert(const Robot::IKQuery &query, const robot_state::RobotState &state);
+
+        /** \brief Remove all entries from the cache.
+         */
+        void clear();
+
+        /** \brief Get the number of keys in the cache.
+         *  \return The number of keys.
+         */
+        std::size_t size() const;
+
+        /** \brief Get the number of lookups that found cached solutions.
+         *  \return The number of hits.
+         */
+        std::size_t getHits() const;
+
+        /** \brief Get the number of lookups that found no cached solutions.
+         *  \return The number of misses.
+         */
+        std::size_t getMisses() const;
+
+        /** \brief Save the cache to a YAML file.
+         *  \param[in] filename File to save to.
+         *  \return True on success, false on failure.
+         */
+        bool save(const std::string &filename) const;
+
+        /** \brief Load entries from a YAML file saved with save(), adding them to the cache. The file must
+         * have been saved with the same resolutions.
+         *  \param[in] filename File to load from.
+         *  \return True on success, false on failure.
+         */
+        bool load(const std::string &filename);
+
+    private:
+        /** \brief A cache entry.
+         */
+        struct Entry
+        {
+            std::string key;                         ///< Key of the entry.
+            std::vector<std::vector<double>> seeds;  ///< Solutions, most recent first.
+        };
+
+        /** \brief Compute the key for a query.
+         *  \param[in] query Query to get key for.
+         *  \return The key.
+         */
+        std::string getKey(const Robot::IKQuery &query) const;
+
+        /** \brief Add a solution to a key. Assumes the mutex is held.
+         *  \param[in] key Key to add to.
+         *  \param[in] seed Solution to add.
+         */
+        void insertKey(const std::string &key, const std::vector<double> &seed);
+
+        const double position_resolution_;     ///< Position quantization resolution.
+        const double orientation_resolution_;  ///< Orientation quantization resolution.
+        const std::size_t capacity_;           ///< Maximum number of keys.
+        const std::size_t seeds_;              ///< Maximum number of solutions per key.
+
+        mutable std::mutex mutex_;                                           ///< Cache mutex.
+        mutable std::list<Entry> entries_;                                   ///< Entries, by use.
+        std::unordered_map<std::string, std::list<Entry>::iterator> index_;  ///< Key to entry.
+        mutable std::size_t hits_{0};                                        ///< Lookup hits.
+        mutable std::size_t misses_{0};                                      ///< Lookup misses.
+    };
+}  // namespace robowflex
+
+#endif
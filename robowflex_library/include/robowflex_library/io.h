@@ -3,6 +3,7 @@
 #ifndef ROBOWFLEX_IO_
 #define ROBOWFLEX_IO_
 
+#include <memory>   // for std::shared_ptr
 #include <string>   // for std::string
 #include <utility>  // for std::pair
 #include <fstream>  // for std::ofstream
@@ -10,6 +11,7 @@
 #include <boost/date_time.hpp>  // for date operations
 
 #include <ros/message_traits.h>  // for message operations
+#include <ros/serialization.h>   // for message serialization
 
 #include <yaml-cpp/yaml.h>  // for YAML parsing
 
@@ -26,6 +28,7 @@ namespace robowflex
 
         /** \brief Resolves `package://` URLs to their canonical form.
          *  The path does not need to exist, but the package does. Can be used to write new files in packages.
+         *  Package locations are cached for the life of the process.
          *  \param[in] path Path to resolve.
          *  \return The canonical path, or "" on failure.
          */
@@ -38,11 +41,17 @@ namespace robowflex
         std::set<std::string> findPackageURIs(const std::string &string);
 
         /** \brief Resolves `package://` URLs and relative file paths to their canonical form.
+         *  Resolved paths are cached for the life of the process. Cached paths are still checked to exist.
          *  \param[in] path Path to resolve.
          *  \return The canonical path, or "" on failure.
          */
         std::string resolvePath(const std::string &path);
 
+        /** \brief Clears the caches of resolvePackage() and resolvePath(), e.g., after packages or
+         * symlinks have moved.
+         */
+        void clearPathCache();
+
         /** \brief Resolves `package://` URLs to get the directory this path is in.
          *  \param[in] path Path to get the parent of.
          *  \return The directory that this path is contained in, or "" on failure.
@@ -63,18 +72,78 @@ namespace robowflex
          */
         std::string loadXMLToString(const std::string &path);
 
-        /** \brief Loads a .xacro file to a string.
+        /** \brief Loads a .xacro file to a string. The file is expanded in-process with expandXacro() if
+         * possible, falling back to the xacro tool otherwise. Expansions are cached for the life of the
+         * process, and reused until the modification time of any file they read changes.
          *  \param[in] path File to load.
          *  \return The loaded file, or "" on failure (file does not exist or .xacro is malformed).
          */
         std::string loadXacroToString(const std::string &path);
 
+        /** \brief Gets the files a .xacro file includes, directly or indirectly.
+         *  \param[in] path File to get the dependencies of.
+         *  \return The canonical paths of the included files, not including \a path itself.
+         */
+        std::vector<std::string> getXacroDependencies(const std::string &path);
+
         /** \brief Loads a file to a string.
          *  \param[in] path File to load.
          *  \return The loaded file, or "" on failure (file does not exist).
          */
         std::string loadFileToString(const std::string &path);
 
+        /** \brief A read-only memory mapping of a file. Avoids copying large files, such as meshes, into
+         * memory before parsing them.
+         */
+        class MappedFile
+        {
+        public:
+            /** \brief Constructor. Maps the file at \a path.
+             *  \param[in] path Canonical path of the file to map.
+             */
+            MappedFile(const std::string &path);
+
+            /** \brief Destructor. Unmaps the file.
+             */
+            ~MappedFile();
+
+            MappedFile(const MappedFile &) = delete;
+            MappedFile &operator=(const MappedFile &) = delete;
+
+            /** \brief Returns true if the file was mapped.
+             *  \return True if the file was mapped, false otherwise.
+             */
+            bool isOpen() const;
+
+            /** \brief Get the contents of the file.
+             *  \return The contents of the file. Not null-terminated.
+             */
+            const char *data() const;
+
+            /** \brief Get the size of the file.
+             *  \return The size of the file in bytes.
+             */
+            std::size_t size() const;
+
+        private:
+            const char *data_{nullptr};  ///< Mapped contents.
+            std::size_t size_{0};        ///< Size of the mapping.
+            bool open_{false};           ///< Whether the file is mapped.
+        };
+
+        /** \brief Maps a file into memory, as a zero-copy alternative to loadFileToString().
+         *  \param[in] path File to map.
+         *  \return The mapped file, or nullptr on failure (file does not exist or could not be mapped).
+         */
+        std::shared_ptr<const MappedFile> mapFile(const std::string &path);
+
+        /** \brief Computes a 64-bit FNV-1a hash of a string. Unlike std::hash, the hash is stable across
+         * runs and platforms, so it can be used to key on-disk caches.
+         *  \param[in] string String to hash.
+         *  \return The hash as a hexadecimal string.
+         */
+        std::string hashString(const std::string &string);
+
         /** \brief Runs a command \a cmd and returns stdout as a string.
          *  \param[in] cmd Command to run.
          *  \return Contents of stdout from \a cmd, or "" on failure.
@@ -197,6 +266,74 @@ namespace robowflex
             return result.first;
         }
 
+        /** \brief Checks if a file should use the binary message format, rather than YAML. Binary files
+         * are recognized by their extension, `.bin`.
+         *  \param[in] file File to check.
+         *  \return True if \a file is a binary message file.
+         */
+        bool isBinaryFile(const std::string &file);
+
+        /** \brief Write serialized message data to a binary message file. The file has a small versioned
+         * header with the message's MD5 sum, followed by the data.
+         *  \param[in] file File to write.
+         *  \param[in] md5 MD5 sum of the message type.
+         *  \param[in] data Serialized message.
+         *  \return True on success, false on failure.
+         */
+        bool writeBinaryFile(const std::string &file, const std::string &md5,
+                             const std::vector<uint8_t> &data);
+
+        /** \brief Read serialized message data from a binary message file.
+         *  \param[in] file File to read.
+         *  \param[in] md5 Expected MD5 sum of the message type.
+         *  \param[out] data Serialized message.
+         *  \return True on success, false on failure (including a version or message type mismatch).
+         */
+        bool readBinaryFile(const std::string &file, const std::string &md5, std::vector<uint8_t> &data);
+
+        /** \brief Dump a ROS message to a binary file, using ROS serialization. Much faster to save and
+         * load than YAML for large messages, such as scenes with meshes or octomaps.
+         *  \param[in] msg Message to dump.
+         *  \param[in] file File to dump message to.
+         *  \tparam T Type of the message.
+         *  \return True on success, false on failure.
+         */
+        template <typename T>
+        bool messageToBinaryFile(const T &msg, const std::string &file)
+        {
+            std::vector<uint8_t> data(ros::serialization::serializationLength(msg));
+            ros::serialization::OStream stream(data.data(), data.size());
+            ros::serialization::serialize(stream, msg);
+
+            return writeBinaryFile(file, ros::message_traits::md5sum<T>(msg), data);
+        }
+
+        /** \brief Load a ROS message from a binary file written by messageToBinaryFile().
+         *  \param[out] msg Message to load into.
+         *  \param[in] file File to load message from.
+         *  \tparam T Type of the message.
+         *  \return True on success, false on failure.
+         */
+        template <typename T>
+        bool binaryFileToMessage(T &msg, const std::string &file)
+        {
+            std::vector<uint8_t> data;
+            if (not readBinaryFile(file, ros::message_traits::md5sum<T>(msg), data))
+                return false;
+
+            try
+            {
+                ros::serialization::IStream stream(data.data(), data.size());
+                ros::serialization::deserialize(stream, msg);
+            }
+            catch (const ros::Exception &)
+            {
+                return false;
+            }
+
+            return true;
+        }
+
         /** \brief Compute MD5 hash of message.
          *  \param[in] msg Message to hash.
          *  \tparam T Type of the message.
@@ -207,6 +344,29 @@ namespace robowflex
         {
             return ros::message_traits::md5sum<T>(msg);
         }
+
+        /** \brief Compute a non-cryptographic hash of data.
+         *  \param[in] data Data to hash.
+         *  \return The hash of the data, as a hex string.
+         */
+        std::string getHash(const std::vector<uint8_t> &data);
+
+        /** \brief Compute a hash of the contents of a message from its serialization. Unlike
+         * getMessageMD5(), which only depends on the type of the message, two messages have the same hash
+         * only if their contents are likely equal.
+         *  \param[in] msg Message to hash.
+         *  \tparam T Type of the message.
+         *  \return The hash of the message.
+         */
+        template <typename T>
+        std::string getMessageHash(const T &msg)
+        {
+            std::vector<uint8_t> data(ros::serialization::serializationLength(msg));
+            ros::serialization::OStream stream(data.data(), data.size());
+            ros::serialization::serialize(stream, msg);
+
+            return getHash(data);
+        }
     }  // namespace IO
 }  // namespace robowflex
 
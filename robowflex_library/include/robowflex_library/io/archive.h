@@ -0,0 +1,203 @@
+/* Author: Zachary Kingston */
+
+#ifndef ROBOWFLEX_IO_ARCHIVE_
+#define ROBOWFLEX_IO_ARCHIVE_
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <ros/serialization.h>
+
+#include <robowflex_library/class_forward.h>
+#include <robowflex_library/io.h>
+
+namespace robowflex
+{
+    namespace IO
+    {
+        /** \cond IGNORE */
+        ROBOWFLEX_CLASS_FORWARD(Archive);
+        /** \endcond */
+
+        /** \class robowflex::IO::ArchivePtr
+            \brief A shared pointer wrapper for robowflex::IO::Archive. */
+
+        /** \class robowflex::IO::ArchiveConstPtr
+            \brief A const shared pointer wrapper for robowflex::IO::Archive. */
+
+        /** \brief A packed archive of named entries, e.g., the scenes, requests, trajectories, and robot
+         * configuration files of a dataset, in a single file.
+         *
+         *  The file starts with a versioned header and an index of the entries, giving the name, message
+         * type MD5 sum, offset, and size of each, followed by the data of the entries. Messages are stored
+         * with ROS serialization, and other files as their raw bytes, with an empty MD5 sum. Opening an
+         * archive memory maps the file and only reads the index, so entries are read on demand, and only
+         * the pages of entries that are used are ever read from disk. Archives are written with
+         * ArchiveWriter.
+         */
+        class Archive
+        {
+        public:
+            /** \brief Constructor. Maps the archive and reads its index.
+             *  \param[in] file Archive file to open.
+             */
+            Archive(const std::string &file);
+
+            /** \brief Returns true if the archive was opened.
+             *  \return True if the archive was opened, false otherwise.
+             */
+            bool isOpen() const;
+
+            /** \brief Get the names of all entries, in the order they were added.
+             *  \return The names of the entries.
+             */
+            const std::vector<std::string> &getNames() const;
+
+            /** \brief Get the names of the entries that start with a prefix, in the order they were added.
+             *  \param[in] prefix Prefix of the names, e.g., `scene/`.
+             *  \return The names of the matching entries.
+             */
+            std::vector<std::string> getNames(const std::string &prefix) const;
+
+            /** \brief Returns true if there is an entry with a name.
+             *  \param[in] name Name of the entry.
+             *  \return True if the entry exists.
+             */
+            bool hasEntry(const std::string &name) const;
+
+            /** \brief Get the MD5 sum of the message type of an entry.
+             *  \param[in] name Name of the entry.
+             *  \return The MD5 sum, empty for raw files or missing entries.
+             */
+            std::string getMD5(const std::string &name) const;
+
+            /** \brief Get the data of an entry, without copying it.
+             *  \param[in] name Name of the entry.
+             *  \param[out] data Start of the data, within the mapping of the archive.
+             *  \param[out] size Size of the data in bytes.
+             *  \return True on success, false if the entry does not exist.
+             */
+            bool getData(const std::string &name, const uint8_t *&data, std::size_t &size) const;
+
+            /** \brief Get the contents of a raw file entry.
+             *  \param[in] name Name of the entry.
+             *  \param[out] contents Contents of the file.
+             *  \return True on success, false if the entry does not exist.
+             */
+            bool getFile(const std::string &name, std::string &contents) const;
+
+            /** \brief Load a message entry.
+             *  \param[in] name Name of the entry.
+             *  \param[out] msg Message to load into.
+             *  \tparam T Type of the message.
+             *  \return True on success, false if the entry does not exist or is of another type.
+             */
+            template <typename T>
+            bool getMessage(const std::string &name, T &msg) const
+            {
+                const uint8_t *data;
+                std::size_t size;
+                if (not getData(name, data, size) or not checkMD5(name, ros::message_traits::md5sum<T>(msg)))
+                    return false;
+
+                try
+                {
+                    // Deserialization only reads the stream.
+                    ros::serialization::IStream stream(const_cast<uint8_t *>(data), size);
+                    ros::serialization::deserialize(stream, msg);
+                }
+                catch (const ros::Exception &)
+                {
+                    return false;
+                }
+
+                return true;
+            }
+
+        private:
+            /** \brief An entry of the index.
+             */
+            struct Entry
+            {
+                std::string md5;  ///< MD5 sum of the message type, empty for raw files.
+                uint64_t offset;  ///< Offset of the data from the start of the file.
+                uint64_t size;    ///< Size of the data.
+            };
+
+            /** \brief Check that an entry has the expected message type, reporting an error if not.
+             *  \param[in] name Name of the entry.
+             *  \param[in] md5 Expected MD5 sum.
+             *  \return True if the MD5 sums match.
+             */
+            bool checkMD5(const std::string &name, const std::string &md5) const;
+
+            const std::string file_;                    ///< Archive file.
+            std::shared_ptr<const MappedFile> mapped_;  ///< Mapping of the archive.
+            std::vector<std::string> names_;            ///< Names of the entries, in order.
+            std::map<std::string, Entry> index_;        ///< Entries by name.
+        };
+
+        /** \brief Builds and writes an archive readable by Archive. Entries are kept in memory until
+         * written.
+         */
+        class ArchiveWriter
+        {
+        public:
+            /** \brief Add a message entry. Replaces any entry with the same name.
+             *  \param[in] name Name of the entry.
+             *  \param[in] msg Message to add.
+             *  \tparam T Type of the message.
+             */
+            template <typename T>
+            void addMessage(const std::string &name, const T &msg)
+            {
+                std::vector<uint8_t> data(ros::serialization::serializationLength(msg));
+                ros::serialization::OStream stream(data.data(), data.size());
+                ros::serialization::serialize(stream, msg);
+
+                addData(name, ros::message_traits::md5sum<T>(msg), std::move(data));
+            }
+
+            /** \brief Add a raw file entry. Replaces any entry with the same name.
+             *  \param[in] name Name of the entry.
+             *  \param[in] contents Contents of the file.
+             */
+            void addFile(const std::string &name, const std::string &contents);
+
+            /** \brief Add an entry of serialized data. Replaces any entry with the same name.
+             *  \param[in] name Name of the entry.
+             *  \param[in] md5 MD5 sum of the message type, empty for raw files.
+             *  \param[in] data Data of the entry.
+             */
+            void addData(const std::string &name, const std::string &md5, std::vector<uint8_t> data);
+
+            /** \brief Get the number of entries added.
+             *  \return The number of entries.
+             */
+            std::size_t getCount() const;
+
+            /** \brief Write the archive.
+             *  \param[in] file File to write to.
+             *  \return True on success, false on failure.
+             */
+            bool write(const std::string &file) const;
+
+        private:
+            /** \brief An entry to write.
+             */
+            struct Entry
+            {
+                std::string name;           ///< Name of the entry.
+                std::string md5;            ///< MD5 sum of the message type, empty for raw files.
+                std::vector<uint8_t> data;  ///< Data of the entry.
+            };
+
+            std::vector<Entry> entries_;  ///< Entries, in order.
+        };
+    }  // namespace IO
+}  // namespace robowflex
+
+#endif
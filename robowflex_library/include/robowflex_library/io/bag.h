@@ -3,7 +3,11 @@
 #ifndef ROBOWFLEX_IO_BAG_
 #define ROBOWFLEX_IO_BAG_
 
+#include <functional>
+#include <limits>
+
 #include <robowflex_library/macros.h>
+#include <robowflex_library/pool.h>
 
 // clang-format off
 ROBOWFLEX_PUSH_DISABLE_GCC_WARNING(-Wcast-qual)
@@ -30,6 +34,24 @@ namespace robowflex
                 WRITE  ///< Write-only
             };
 
+            /** \brief Which messages to read from a bag.
+             */
+            struct Filter
+            {
+                ros::Time begin{ros::TIME_MIN};                              ///< Earliest time to read.
+                ros::Time end{ros::TIME_MAX};                                ///< Latest time to read.
+                std::size_t first{0};                                        ///< First index to read.
+                std::size_t count{std::numeric_limits<std::size_t>::max()};  ///< Maximum messages to read.
+            };
+
+            /** \brief Callback for streamed messages.
+             *  The arguments are the index of the message (counting only messages of type \a T on the
+             * requested topics), the time it was recorded, and the message. Returns true to continue, false
+             * to stop reading.
+             */
+            template <typename T>
+            using MessageCallback = std::function<bool(std::size_t, const ros::Time &, const T &)>;
+
             /** \brief Constructor.
              *  \param[in] file File to open or create.
              *  \param[in] mode Mode to open file in.
@@ -67,22 +89,138 @@ namespace robowflex
             std::vector<T> getMessages(const std::vector<std::string> &topics)
             {
                 std::vector<T> msgs;
+                streamMessages<T>(topics, [&](std::size_t, const ros::Time &, const T &msg) {
+                    msgs.emplace_back(msg);
+                    return true;
+                });
 
-                if (mode_ != READ)
-                    return msgs;
+                return msgs;
+            }
 
-                rosbag::View view(bag_, rosbag::TopicQuery(topics));
-                for (auto &msg : view)
-                {
+            /** \brief Reads messages of type \a T from a list of topics one at a time, in bag order, so
+             *  only the current message is in memory.
+             *  \param[in] topics List of topics to load messages from.
+             *  \param[in] callback Callback for each message read.
+             *  \param[in] filter Which messages to read.
+             *  \tparam T type of messages to load from topics.
+             *  \return The number of messages passed to \a callback.
+             */
+            template <typename T>
+            std::size_t streamMessages(const std::vector<std::string> &topics,
+                                       const MessageCallback<T> &callback, const Filter &filter = Filter())
+            {
+                std::size_t n = 0;
+                visit<T>(topics, filter, [&](std::size_t index, const rosbag::MessageInstance &msg) {
                     typename T::ConstPtr ptr = msg.instantiate<T>();
-                    if (ptr != nullptr)
-                        msgs.emplace_back(*ptr);
-                }
+                    ++n;
+                    return callback(index, msg.getTime(), *ptr);
+                });
 
-                return msgs;
+                return n;
+            }
+
+            /** \brief Reads messages of type \a T from a list of topics in chunks, deserializing each
+             *  chunk in parallel on \a pool. Messages are still passed to \a callback in bag order, from the
+             *  calling thread, and at most \a chunk messages are in memory at once.
+             *  \param[in] topics List of topics to load messages from.
+             *  \param[in] callback Callback for each message read.
+             *  \param[in] filter Which messages to read.
+             *  \param[in] pool Pool to deserialize messages on.
+             *  \param[in] chunk Number of messages to read before deserializing them.
+             *  \tparam T type of messages to load from topics.
+             *  \return The number of messages passed to \a callback.
+             */
+            template <typename T>
+            std::size_t streamMessages(const std::vector<std::string> &topics,
+                                       const MessageCallback<T> &callback, const Filter &filter,
+                                       const Pool &pool, std::size_t chunk = 64)
+            {
+                chunk = std::max<std::size_t>(chunk, 1);
+
+                std::vector<std::size_t> indices;
+                std::vector<ros::Time> times;
+                std::vector<std::vector<uint8_t>> buffers;
+                std::vector<T> msgs;
+
+                std::size_t n = 0;
+                bool stopped = false;
+
+                // Deserialize the buffered messages in parallel, then hand them out in order.
+                const auto flush = [&] {
+                    msgs.resize(buffers.size());
+                    pool.parallelFor(0, buffers.size(), [&](std::size_t i) {
+                        ros::serialization::IStream stream(buffers[i].data(), buffers[i].size());
+                        ros::serialization::deserialize(stream, msgs[i]);
+                    });
+
+                    for (std::size_t i = 0; i < msgs.size() and not stopped; ++i)
+                    {
+                        ++n;
+                        stopped = not callback(indices[i], times[i], msgs[i]);
+                    }
+
+                    indices.clear();
+                    times.clear();
+                    buffers.clear();
+                    msgs.clear();
+                };
+
+                // Reading from the bag is sequential, so only the raw bytes are copied out here.
+                visit<T>(topics, filter, [&](std::size_t index, const rosbag::MessageInstance &msg) {
+                    std::vector<uint8_t> buffer(msg.size());
+                    ros::serialization::OStream stream(buffer.data(), buffer.size());
+                    msg.write(stream);
+
+                    indices.emplace_back(index);
+                    times.emplace_back(msg.getTime());
+                    buffers.emplace_back(std::move(buffer));
+
+                    if (buffers.size() >= chunk)
+                        flush();
+
+                    return not stopped;
+                });
+
+                if (not stopped)
+                    flush();
+
+                return n;
             }
 
         private:
+            /** \brief Visits the messages of type \a T on \a topics allowed by \a filter, without
+             *  deserializing them.
+             *  \param[in] topics List of topics to visit messages on.
+             *  \param[in] filter Which messages to visit.
+             *  \param[in] visitor Called with the index and message instance. Returns false to stop.
+             *  \tparam T type of messages to visit.
+             */
+            template <typename T>
+            void visit(const std::vector<std::string> &topics, const Filter &filter,
+                       const std::function<bool(std::size_t, const rosbag::MessageInstance &)> &visitor)
+            {
+                if (mode_ != READ or filter.count == 0)
+                    return;
+
+                rosbag::View view(bag_, rosbag::TopicQuery(topics), filter.begin, filter.end);
+
+                std::size_t index = 0;
+                for (const auto &msg : view)
+                {
+                    if (not msg.isType<T>())
+                        continue;
+
+                    // Skipped messages are never deserialized.
+                    if (index >= filter.first)
+                    {
+                        if (not visitor(index, msg) or index - filter.first + 1 >= filter.count)
+                            return;
+                    }
+
+                    ++index;
+                }
+            }
+
             const Mode mode_;         ///< Mode to open file in.
             const std::string file_;  ///< File opened.
             rosbag::Bag bag_;         ///< `rosbag` opened.
@@ -3,12 +3,17 @@
 #ifndef ROBOWFLEX_IO_ROBOTBROADCASTER_
 #define ROBOWFLEX_IO_ROBOTBROADCASTER_
 
+#include <mutex>
 #include <thread>
 
 #include <robowflex_library/class_forward.h>
 #include <robowflex_library/adapter.h>
 #include <tf2_ros/transform_broadcaster.h>
 
+#include <moveit/robot_model/link_model.h>
+#include <sensor_msgs/JointState.h>
+#include <tf2_msgs/TFMessage.h>
+
 namespace robowflex
 {
     /** \cond IGNORE */
@@ -18,7 +23,12 @@ namespace robowflex
 
     namespace IO
     {
-        /** \brief Helper class to broadcast transform information on TF and joint states
+        /** \brief Helper class to broadcast transform information on TF and joint states.
+         *
+         *  Transforms of links attached by fixed joints and added static transforms are latched on
+         * /tf_static, and only sent again when the static transforms change. Each tick, the transforms of
+         * links that moved since the last tick are sent on /tf as a single message, and all are re-sent once
+         * per refresh period so listeners do not lose unchanged links.
          */
         class RobotBroadcaster
         {
@@ -57,11 +67,20 @@ namespace robowflex
              */
             void removeStaticTransform(const std::string &name);
 
+            /** \brief Sets how often all link transforms are sent, including those that have not moved.
+             *  \param[in] period Period in seconds between full updates.
+             */
+            void setRefreshPeriod(double period);
+
         private:
             /** \brief Send out the TF and joint information.
              */
             void update();
 
+            /** \brief Send out the static transforms, if they have changed.
+             */
+            void updateStatic();
+
             RobotConstPtr robot_;                  ///< Robot being published.
             const std::string base_;               ///< Base frame to use.
             bool active_{false};                   ///< Is thread active?
@@ -71,6 +90,17 @@ namespace robowflex
             ros::NodeHandle nh_;                   ///< Handle for publishing.
             tf2_ros::TransformBroadcaster tf2br_;  ///< TF2 broadcaster
             ros::Publisher state_pub_;             ///< State publisher.
+            ros::Publisher static_pub_;            ///< Latched static transform publisher.
+
+            double refresh_{1.};                                       ///< Period between full updates.
+            ros::WallTime last_refresh_;                               ///< Time of the last full update.
+            std::vector<const moveit::core::LinkModel *> links_;       ///< Links with moving transforms.
+            RobotPoseVector poses_;                                    ///< Last transforms sent of links.
+            std::vector<geometry_msgs::TransformStamped> transforms_;  ///< Messages for each link.
+            std::vector<geometry_msgs::TransformStamped> changed_;     ///< Messages of moved links.
+            std::vector<geometry_msgs::TransformStamped> fixed_;       ///< Messages for fixed links.
+            tf2_msgs::TFMessage static_msg_;                           ///< Static transform message.
+            sensor_msgs::JointState joint_msg_;                        ///< Joint state message.
 
             /** \brief Information for a static transform.
              */
@@ -82,6 +112,8 @@ namespace robowflex
             };
 
             std::map<std::string, StaticTransform> static_;  ///< Static transforms.
+            bool static_changed_{true};                      ///< Have static transforms changed?
+            std::mutex static_mutex_;                        ///< Lock for static transforms.
         };
     }  // namespace IO
 }  // namespace robowflex
@@ -3,6 +3,7 @@
 #ifndef ROBOWFLEX_IO_COLORMAP_
 #define ROBOWFLEX_IO_COLORMAP_
 
+#include <Eigen/Core>
 #include <Eigen/Geometry>
 
 namespace robowflex
@@ -45,6 +46,49 @@ namespace robowflex
          */
         void grayscale(double s, Eigen::Ref<Eigen::Vector4d> color);
 
+        /** \name Array Colormaps
+         *  Map arrays of scalars at once, by linear interpolation into a precomputed table of the
+         * colormap. Scalars are clamped to [0, 1]. Each row of the output is an RGBA color with alpha 1.
+            \{ */
+
+        /** \brief Maps scalars in [0, 1] to the Viridis colormap.
+         *  \param[in] s Scalars to map.
+         *  \param[out] colors Output colors, one row per scalar.
+         */
+        void viridis(const Eigen::Ref<const Eigen::ArrayXd> &s, Eigen::ArrayX4f &colors);
+
+        /** \brief Maps scalars in [0, 1] to the Cool-Warm colormap.
+         *  \param[in] s Scalars to map.
+         *  \param[out] colors Output colors, one row per scalar.
+         */
+        void coolwarm(const Eigen::Ref<const Eigen::ArrayXd> &s, Eigen::ArrayX4f &colors);
+
+        /** \brief Maps scalars in [0, 1] to the Extended Kindlmann colormap.
+         *  \param[in] s Scalars to map.
+         *  \param[out] colors Output colors, one row per scalar.
+         */
+        void extKindlmann(const Eigen::Ref<const Eigen::ArrayXd> &s, Eigen::ArrayX4f &colors);
+
+        /** \brief Maps scalars in [0, 1] to the Plasma colormap.
+         *  \param[in] s Scalars to map.
+         *  \param[out] colors Output colors, one row per scalar.
+         */
+        void plasma(const Eigen::Ref<const Eigen::ArrayXd> &s, Eigen::ArrayX4f &colors);
+
+        /** \brief Maps scalars in [0, 1] to the Turbo colormap.
+         *  \param[in] s Scalars to map.
+         *  \param[out] colors Output colors, one row per scalar.
+         */
+        void turbo(const Eigen::Ref<const Eigen::ArrayXd> &s, Eigen::ArrayX4f &colors);
+
+        /** \brief Maps scalars in [0, 1] to greyscale.
+         *  \param[in] s Scalars to map.
+         *  \param[out] colors Output colors, one row per scalar.
+         */
+        void grayscale(const Eigen::Ref<const Eigen::ArrayXd> &s, Eigen::ArrayX4f &colors);
+
+        /** \} */
+
         /** \brief Maps an RGB color to a greyscale color based on luminosity.
          *  \param[in,out] color Color to convert.
          */
@@ -60,6 +60,7 @@ namespace robowflex
             struct TimeSeriesOptions : PlottingOptions
             {
                 std::map<std::string, Series> points;  ///< Map of names to time series data.
+                bool binary{true};                     ///< Send points as binary rather than text data.
             };
 
             /** \brief Plot timeseries data.
@@ -74,6 +75,11 @@ namespace robowflex
                 bool outliers{true};
                 bool sorted{true};
                 std::map<std::string, Values> values;  ///< Map of names to data.
+
+                /** \brief If true, quartiles, whiskers, and outliers are computed here and only they are sent
+                 * to GNUPlot, rather than every value. Much faster for large data sets.
+                 */
+                bool aggregate{true};
             };
 
             /** \brief Plot box data.
@@ -84,6 +90,11 @@ namespace robowflex
             /** \} */
 
         private:
+            /** \brief Plot box data from statistics computed over the data.
+             *  \param[in] options Plotting options.
+             */
+            void boxplotAggregate(const BoxPlotOptions &options);
+
             class Instance
             {
             public:
@@ -96,6 +107,7 @@ namespace robowflex
 
                 void write(const std::string &line);
                 void writeline(const std::string &line);
+                void writeBinary(const void *data, std::size_t size);
                 void flush();
 
                 /** \} */
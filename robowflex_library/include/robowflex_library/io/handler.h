@@ -3,7 +3,11 @@
 #ifndef ROBOWFLEX_IO_HANDLER_
 #define ROBOWFLEX_IO_HANDLER_
 
+#include <map>     // for std::map
+#include <memory>  // for std::shared_ptr
+#include <mutex>   // for std::mutex
 #include <string>  // for std::string
+#include <vector>  // for std::vector
 
 #include <yaml-cpp/yaml.h>  // for YAML::Node
 
@@ -14,6 +18,12 @@ namespace robowflex
     namespace IO
     {
         /** \brief ROS parameter server handler to handle namespacing and automatic parameter deletion.
+         *
+         *  Parameters set through a handler are kept in an in-process store, shared with the handlers
+         *  derived from it, and read back from there without a round trip to the ROS master. Parameters
+         *  are also pushed to the ROS master for _MoveIt!_ plugins that read them there, unless pushing is
+         *  disabled with setPushToMaster() before the handler is created. Without pushing, no ROS master is
+         *  needed, and Robot and the OMPL planners configure _MoveIt!_ from the store directly.
          */
         class Handler
         {
@@ -52,17 +62,20 @@ namespace robowflex
             template <typename T>
             void setParam(const std::string &key, const T &value)
             {
-                nh_.setParam(key, value);
+                setValue(key, toXmlRpc(value));
+                if (push_)
+                    nh_.setParam(key, value);
+
                 params_.emplace_back(key);
             }
 
-            /** \brief Checks if the parameter server has \a key.
+            /** \brief Checks if the parameter server has \a key, either as a parameter or a namespace.
              *  \param[in] key Key to check.
              *  \return True if \a key exists, false otherwise.
              */
             bool hasParam(const std::string &key) const;
 
-            /** \brief Gets a parameter from the parameter server.
+            /** \brief Gets a parameter from the parameter server, from the in-process store if set there.
              *  \param[in] key Key of parameter.
              *  \param[out] value Value to store.
              *  \tparam T Type of the \a value.
@@ -70,9 +83,30 @@ namespace robowflex
             template <typename T>
             bool getParam(const std::string &key, T &value) const
             {
-                return nh_.getParam(key, value);
+                XmlRpc::XmlRpcValue stored;
+                if (getValue(key, stored))
+                    return fromXmlRpc(stored, value);
+
+                return push_ and nh_.getParam(key, value);
             }
 
+            /** \brief Gets all parameters in the in-process store under a namespace.
+             *  \param[in] prefix Namespace to get the parameters of. If empty, gets all parameters.
+             *  \return Map of keys relative to \a prefix to parameter values.
+             */
+            std::map<std::string, XmlRpc::XmlRpcValue> getParams(const std::string &prefix) const;
+
+            /** \brief Returns true if parameters are pushed to the ROS master.
+             *  \return True if parameters are pushed to the ROS master.
+             */
+            bool pushesToMaster() const;
+
+            /** \brief Set whether handlers created afterwards push their parameters to the ROS master.
+             *  Derived handlers always push if their parent does. By default, parameters are pushed.
+             *  \param[in] push If true, parameters are pushed to the ROS master.
+             */
+            static void setPushToMaster(bool push);
+
             /** \brief Gets the node handle.
              *  \return The node handle.
              */
@@ -89,12 +123,115 @@ namespace robowflex
             const std::string &getNamespace() const;
 
         private:
+            /** \brief In-process parameters of a handler and the handlers derived from it.
+             */
+            struct Store
+            {
+                std::mutex mutex;                                   ///< Guards the parameters.
+                std::map<std::string, XmlRpc::XmlRpcValue> values;  ///< Parameters by full key.
+            };
+
+            /** \brief Set a parameter in the in-process store.
+             *  \param[in] key Key relative to the handler.
+             *  \param[in] value Value to store.
+             */
+            void setValue(const std::string &key, const XmlRpc::XmlRpcValue &value);
+
+            /** \brief Get a parameter from the in-process store. Namespaces are returned as structs.
+             *  \param[in] key Key relative to the handler.
+             *  \param[out] value Stored value.
+             *  \return True if \a key is in the store, false otherwise.
+             */
+            bool getValue(const std::string &key, XmlRpc::XmlRpcValue &value) const;
+
+            /** \brief Get the key of a parameter in the store.
+             *  \param[in] key Key relative to the handler.
+             *  \return The key in the store.
+             */
+            std::string getStoreKey(const std::string &key) const;
+
+            /** \name Parameter Value Conversion
+                \{ */
+
+            static XmlRpc::XmlRpcValue toXmlRpc(const XmlRpc::XmlRpcValue &value);
+            static XmlRpc::XmlRpcValue toXmlRpc(bool value);
+            static XmlRpc::XmlRpcValue toXmlRpc(int value);
+            static XmlRpc::XmlRpcValue toXmlRpc(double value);
+            static XmlRpc::XmlRpcValue toXmlRpc(const std::string &value);
+            static XmlRpc::XmlRpcValue toXmlRpc(const char *value);
+
+            template <typename T>
+            static XmlRpc::XmlRpcValue toXmlRpc(const std::vector<T> &values)
+            {
+                XmlRpc::XmlRpcValue array;
+                array.setSize(values.size());
+                for (std::size_t i = 0; i < values.size(); ++i)
+                    array[i] = toXmlRpc(values[i]);
+
+                return array;
+            }
+
+            template <typename T>
+            static XmlRpc::XmlRpcValue toXmlRpc(const std::map<std::string, T> &values)
+            {
+                XmlRpc::XmlRpcValue map;
+                for (const auto &pair : values)
+                    map[pair.first] = toXmlRpc(pair.second);
+
+                return map;
+            }
+
+            static bool fromXmlRpc(const XmlRpc::XmlRpcValue &stored, XmlRpc::XmlRpcValue &value);
+            static bool fromXmlRpc(const XmlRpc::XmlRpcValue &stored, bool &value);
+            static bool fromXmlRpc(const XmlRpc::XmlRpcValue &stored, int &value);
+            static bool fromXmlRpc(const XmlRpc::XmlRpcValue &stored, double &value);
+            static bool fromXmlRpc(const XmlRpc::XmlRpcValue &stored, float &value);
+            static bool fromXmlRpc(const XmlRpc::XmlRpcValue &stored, std::string &value);
+
+            template <typename T>
+            static bool fromXmlRpc(const XmlRpc::XmlRpcValue &stored, std::vector<T> &values)
+            {
+                if (stored.getType() != XmlRpc::XmlRpcValue::TypeArray)
+                    return false;
+
+                XmlRpc::XmlRpcValue copy(stored);
+                std::vector<T> read(copy.size());
+                for (int i = 0; i < copy.size(); ++i)
+                    if (not fromXmlRpc(copy[i], read[i]))
+                        return false;
+
+                values = read;
+                return true;
+            }
+
+            template <typename T>
+            static bool fromXmlRpc(const XmlRpc::XmlRpcValue &stored, std::map<std::string, T> &values)
+            {
+                if (stored.getType() != XmlRpc::XmlRpcValue::TypeStruct)
+                    return false;
+
+                XmlRpc::XmlRpcValue copy(stored);
+                std::map<std::string, T> read;
+                for (auto it = copy.begin(); it != copy.end(); ++it)
+                    if (not fromXmlRpc(it->second, read[it->first]))
+                        return false;
+
+                values = read;
+                return true;
+            }
+
+            /** \} */
+
             static const std::string UUID;  ///< UUID of handler.
 
             const std::string name_;       ///< Name of handler.
             const std::string namespace_;  ///< Full namespace of handler.
             ros::NodeHandle nh_;           ///< ROS node handle.
 
+            std::shared_ptr<Store> store_;  ///< In-process parameters, shared with derived handlers.
+            const std::string prefix_;      ///< Prefix of this handler's keys in the store.
+            const bool push_;               ///< If true, parameters are also pushed to the ROS master.
+
             std::vector<std::string> params_;  ///< Set parameter keys.
         };
     }  // namespace IO
@@ -6,9 +6,13 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <atomic>
+#include <mutex>
 
 #include <boost/variant.hpp>
 
+#include <Eigen/Core>
+
 #include <H5Cpp.h>
 
 #include <robowflex_library/class_forward.h>
@@ -19,6 +23,8 @@ namespace robowflex
     {
         /** \cond IGNORE */
         ROBOWFLEX_CLASS_FORWARD(HDF5Data)
+        ROBOWFLEX_CLASS_FORWARD(HDF5Writer)
+        ROBOWFLEX_CLASS_FORWARD(MappedFile)
         /** \endcond */
 
         /** \class robowflex::HDF5DataPtr
@@ -27,23 +33,39 @@ namespace robowflex
         /** \class robowflex::HDF5DataConstPtr
             \brief A const shared pointer wrapper for robowflex::IO::HDF5Data. */
 
+        /** \class robowflex::HDF5WriterPtr
+            \brief A shared pointer wrapper for robowflex::IO::HDF5Writer. */
+
+        /** \class robowflex::HDF5WriterConstPtr
+            \brief A const shared pointer wrapper for robowflex::IO::HDF5Writer. */
+
         /** \brief A container class for HDF5 DataSets loaded by an HDF5File.
+         *
+         *  Only the DataSet's metadata is read on construction. The full data is read on first access
+         * through getData() or get(), or, if a mapping of the file is given and the DataSet is stored
+         * contiguously and uncompressed in the native type, pointed to directly in the mapping without any
+         * copy. Ranges of rows can be read with read() without loading the whole DataSet.
          */
         class HDF5Data
         {
         public:
-            /** \brief Constructor. Loads reads DataSet from file.
+            /** \brief Constructor. Opens the DataSet in the file.
              *  \param[in] location Location to read data from.
              *  \param[in] name Name of object to read.
+             *  \param[in] mapping Optional memory mapping of the whole file, used for contiguous data.
              *  \tparam H5 type to read.
              */
             template <typename T>
-            HDF5Data(const T &location, const std::string &name);
+            HDF5Data(const T &location, const std::string &name, const MappedFileConstPtr &mapping = nullptr);
 
             /** \brief Destructor. Cleans up all read data.
              */
             ~HDF5Data();
 
+            // non-copyable
+            HDF5Data(HDF5Data const &) = delete;
+            void operator=(HDF5Data const &) = delete;
+
             /** \brief Gets the dimensions of the data. Can be used to create the array necessary to store
              *  results.
              *  \return The dimensions of the data.
@@ -51,10 +73,32 @@ namespace robowflex
             const std::vector<hsize_t> getDims() const;
 
             /** \brief Get a pointer to the underlying data array. It is of size type[dim0][dim1]...
+             *  Reads the data on first call.
              *  \return A pointer to the data array.
              */
             const void *getData() const;
 
+            /** \brief Returns true if the full data has been read (or mapped).
+             *  \return True if the data is loaded, false otherwise.
+             */
+            bool isLoaded() const;
+
+            /** \brief Returns true if the data points directly into a memory mapping of the file.
+             *  \return True if the data is mapped, false otherwise.
+             */
+            bool isMapped() const;
+
+            /** \brief Read a range of rows (indices along the first dimension) through a hyperslab
+             * selection, without loading the whole DataSet. If the data is already loaded, copies from
+             * memory instead.
+             *  \param[in] begin First row to read.
+             *  \param[in] count Number of rows to read. Clamped to the number of rows after \a begin.
+             *  \tparam T The type of the data, either int or double.
+             *  \return The rows, flattened in row-major order.
+             */
+            template <typename T>
+            std::vector<T> read(hsize_t begin, hsize_t count) const;
+
             /** \brief Get a string describing the data.
              *  \return A string describing the data.
              */
@@ -74,6 +118,16 @@ namespace robowflex
              */
             std::tuple<H5::PredType, unsigned int, std::string> getDataProperties() const;
 
+            /** \brief Reads the full data, if it has not been read yet.
+             */
+            void load() const;
+
+            /** \brief Points the data into \a mapping_, if the DataSet is stored contiguously in the
+             * native type.
+             *  \return True if the data was mapped, false otherwise.
+             */
+            bool map();
+
             const H5::DataSet dataset_;  ///< Dataset being read from.
             const H5::DataSpace space_;  ///< Size of the dataset.
 
@@ -81,7 +135,10 @@ namespace robowflex
             const int rank_;          ///< Rank of the dataset.
             const hsize_t *dims_;     ///< Dimensions of the dataset (rank_ dimensions)
 
-            const void *data_;  ///< Data itself.
+            MappedFileConstPtr mapping_;         ///< Mapping of the file, if the data is mapped.
+            mutable std::once_flag once_;                      ///< Flag for reading the data.
+            mutable std::atomic<const void *> data_{nullptr};  ///< Data itself, set once it is loaded.
+            mutable bool owned_{false};  ///< Whether \a data_ was allocated (rather than mapped).
         };
 
         /** \brief An HDF5 File loaded into memory.
@@ -97,10 +154,13 @@ namespace robowflex
              */
             typedef std::map<std::string, Node> NodeMap;
 
-            /** \brief Constructor. Opens \a filename.
+            /** \brief Constructor. Opens \a filename and the DataSets within it. DataSets are only read
+             * when accessed.
              *  \param[in] filename File to open.
+             *  \param[in] mapped If true, the file is memory mapped, and contiguous DataSets point directly
+             * into the mapping rather than being read.
              */
-            HDF5File(const std::string &filename);
+            HDF5File(const std::string &filename, bool mapped = false);
 
             /** \brief Get the dataset under the set of keys. Each key is applied successively.
              *  \param[in] keys The keys for the dataset to access.
@@ -130,8 +190,110 @@ namespace robowflex
             template <typename T>
             void loadData(Node &node, const T &location, const std::string &name);
 
-            const H5::H5File file_;  ///< The loaded HDF5 file.
-            Node data_;              ///< A recursive map of loaded data.
+            const H5::H5File file_;       ///< The loaded HDF5 file.
+            MappedFileConstPtr mapping_;  ///< Mapping of the file, if mapped.
+            Node data_;                   ///< A recursive map of loaded data.
+        };
+
+        /** \brief Writes typed DataSets and attributes into an HDF5 file, readable by HDF5File.
+         *
+         *  DataSets are addressed by keys like in HDF5File::getData(), where all but the last key are
+         * groups, which are created as needed. DataSets are chunked along their first dimension and
+         * compressed, unless compression is disabled, in which case they are stored contiguously and can be
+         * memory mapped when read (see HDF5File).
+         */
+        class HDF5Writer
+        {
+        public:
+            /** \brief Options for how DataSets are stored.
+             */
+            struct Options
+            {
+                hsize_t chunk{4096};          ///< Maximum number of rows in each chunk.
+                unsigned int compression{4};  ///< Deflate level from 1 to 9. 0 disables compression.
+            };
+
+            /** \brief Constructor. Opens or creates \a filename for writing, with the default options.
+             *  \param[in] filename File to open.
+             *  \param[in] append If true, an existing file is opened for appending, otherwise it is
+             * overwritten.
+             */
+            HDF5Writer(const std::string &filename, bool append = false);
+
+            /** \brief Constructor. Opens or creates \a filename for writing.
+             *  \param[in] filename File to open.
+             *  \param[in] append If true, an existing file is opened for appending, otherwise it is
+             * overwritten.
+             *  \param[in] options Options for storing DataSets.
+             */
+            HDF5Writer(const std::string &filename, bool append, const Options &options);
+
+            /** \brief Returns true if an object exists under the set of keys.
+             *  \param[in] keys The keys of the object.
+             *  \return True if the object exists, false otherwise.
+             */
+            bool exists(const std::vector<std::string> &keys) const;
+
+            /** \brief Gets the group under the set of keys, creating it and any parents as needed.
+             *  \param[in] keys The keys of the group.
+             *  \return The group.
+             */
+            H5::Group getGroup(const std::vector<std::string> &keys);
+
+            /** \brief Writes an array as a new DataSet.
+             *  \param[in] keys The keys of the DataSet. The last key is the DataSet name.
+             *  \param[in] data The data, of size type[dim0][dim1]..., in row-major order.
+             *  \param[in] dims The dimensions of the data.
+             *  \tparam T The type of the data, one of uint8_t, int, uint64_t, or double.
+             *  \return The DataSet written.
+             */
+            template <typename T>
+            H5::DataSet write(const std::vector<std::string> &keys, const T *data,
+                              const std::vector<hsize_t> &dims);
+
+            /** \brief Writes a vector as a new one-dimensional DataSet.
+             *  \param[in] keys The keys of the DataSet. The last key is the DataSet name.
+             *  \param[in] values The values to write.
+             *  \tparam T The type of the data, one of uint8_t, int, uint64_t, or double.
+             *  \return The DataSet written.
+             */
+            template <typename T>
+            H5::DataSet write(const std::vector<std::string> &keys, const std::vector<T> &values)
+            {
+                return write(keys, values.data(), {values.size()});
+            }
+
+            /** \brief Writes a matrix as a new two-dimensional DataSet, with the same rows and columns.
+             *  \param[in] keys The keys of the DataSet. The last key is the DataSet name.
+             *  \param[in] matrix The matrix to write.
+             *  \return The DataSet written.
+             */
+            H5::DataSet write(const std::vector<std::string> &keys, const Eigen::MatrixXd &matrix);
+
+            /** \brief Writes a scalar attribute on an object.
+             *  \param[in] object Object to write the attribute on.
+             *  \param[in] name Name of the attribute.
+             *  \param[in] value Value of the attribute.
+             *  \tparam T The type of the data, one of uint8_t, int, uint64_t, or double.
+             */
+            template <typename T>
+            static void writeAttribute(H5::H5Object &object, const std::string &name, const T &value);
+
+            /** \brief Writes an array of strings as an attribute on an object.
+             *  \param[in] object Object to write the attribute on.
+             *  \param[in] name Name of the attribute.
+             *  \param[in] values Values of the attribute.
+             */
+            static void writeAttribute(H5::H5Object &object, const std::string &name,
+                                       const std::vector<std::string> &values);
+
+            /** \brief Flushes all written data to disk.
+             */
+            void flush();
+
+        private:
+            const Options options_;  ///< Options for storing DataSets.
+            H5::H5File file_;        ///< The opened HDF5 file.
         };
     }  // namespace IO
 }  // namespace robowflex
@@ -98,6 +98,18 @@ namespace robowflex
              */
             using BaseLoaderPtr = std::shared_ptr<BaseLoader>;
 
+            /** \brief A cached class loader, created once on first use.
+             */
+            struct Entry
+            {
+                std::once_flag once;   ///< Flag for creating the loader.
+                BaseLoaderPtr loader;  ///< The loader.
+            };
+
+            /** \brief A shared pointer to a cached class loader.
+             */
+            using EntryPtr = std::shared_ptr<Entry>;
+
             /** \brief Constructor
              */
             PluginManager()
@@ -106,7 +118,8 @@ namespace robowflex
 
             /** \brief Gets the plugin loader for a plugin type \a T.
              *  Grabs the loader from cached loaders if available, otherwise creates the plugin loader and
-             * caches it.
+             * caches it. The manager's mutex is only held to find the cache entry, so creating a loader
+             * (which crawls the package path) does not block loading plugins of other types.
              *  \param[in] package ROS package that exports class \a T.
              *  \tparam T The type of plugin loader to get.
              *  \return A plugin loader that loads plugins of type \a T.
@@ -114,30 +127,31 @@ namespace robowflex
             template <typename T>
             LoaderPtr<T> getLoader(const std::string &package)
             {
-                std::unique_lock<std::mutex> lock(mutex_);
-
                 // Need to possibly demangle type name...
                 const std::string &type = ROBOWFLEX_DEMANGLE(typeid(T).name());
                 auto key = std::make_pair(package, type);
 
-                LoaderPtr<T> loader;
-
-                auto cached = loaders_.find(key);
-                if (cached != loaders_.end())
-                    loader = std::dynamic_pointer_cast<Loader<T>>(cached->second);
-                else
+                EntryPtr entry;
                 {
-                    RBX_INFO("Creating Class Loader for type `%s` from package `%s`!", type, package);
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    auto &cached = loaders_[key];
+                    if (not cached)
+                        cached = std::make_shared<Entry>();
 
-                    loader.reset(new pluginlib::ClassLoader<T>(package, type));
-                    loaders_[key] = std::static_pointer_cast<BaseLoader>(loader);
+                    entry = cached;
                 }
 
-                return loader;
+                // Concurrent requests for the same loader wait here until it has been created.
+                std::call_once(entry->once, [&] {
+                    RBX_INFO("Creating Class Loader for type `%s` from package `%s`!", type, package);
+                    entry->loader = std::make_shared<Loader<T>>(package, type);
+                });
+
+                return std::dynamic_pointer_cast<Loader<T>>(entry->loader);
             }
 
-            std::mutex mutex_;                                                      ///< Class loading mutex
-            std::map<std::pair<std::string, std::string>, BaseLoaderPtr> loaders_;  ///< Cached loaders
+            std::mutex mutex_;                                                 ///< Class loading mutex
+            std::map<std::pair<std::string, std::string>, EntryPtr> loaders_;  ///< Cached loaders
         };
     }  // namespace IO
 }  // namespace robowflex
@@ -3,12 +3,16 @@
 #ifndef ROBOWFLEX_IO_VISUALIZATION_
 #define ROBOWFLEX_IO_VISUALIZATION_
 
+#include <atomic>
+
 #include <moveit/planning_interface/planning_interface.h>
 
 #include <robowflex_library/class_forward.h>
+#include <robowflex_library/id.h>
 #include <robowflex_library/io/colormap.h>
 #include <robowflex_library/tf.h>
 #include <sensor_msgs/PointCloud2.h>
+#include <visualization_msgs/MarkerArray.h>
 
 namespace robowflex
 {
@@ -46,6 +50,39 @@ namespace robowflex
              */
             RVIZHelper(const RobotConstPtr &robot, const std::string &name = "robowflex");
 
+            /** \name Publishing
+             *  \{ */
+
+            /** \brief How updates are published when no one is subscribed.
+             */
+            enum PublishMode
+            {
+                BLOCK,  ///< Wait until there is a subscriber, then publish. The default.
+                DROP,   ///< Drop updates if there is no subscriber. Never blocks.
+                LATCH   ///< Publish on latched topics, so the last update reaches later subscribers.
+            };
+
+            /** \brief Sets how updates are published. Modes other than BLOCK never wait for subscribers, and
+             * so are safe to leave on in headless nodes. Re-advertises all topics.
+             *  \param[in] mode Mode to publish with.
+             */
+            void setPublishMode(PublishMode mode);
+
+            /** \brief Get how updates are published.
+             *  \return The publish mode.
+             */
+            PublishMode getPublishMode() const;
+
+            /** \brief Sets whether updateScene() only sends what changed since the last scene published, if
+             * it was a previous version of the same scene (see Scene::getDiffMessage()). A full scene is
+             * still sent whenever a new subscriber connects. Note that in LATCH mode the latched message
+             * may then be a diff for subscribers that connect between updates.
+             *  \param[in] diffs Whether to send scene diffs.
+             */
+            void setSceneDiffs(bool diffs);
+
+            /** \} */
+
             /** \name Trajectories
              *  \{ */
 
@@ -124,6 +161,15 @@ namespace robowflex
              */
             void updatePCD(const sensor_msgs::PointCloud2 &msg);
 
+            /** \brief Updates the pointcloud being visualized from colored points, e.g., colored by the
+             * array colormaps in color.
+             *  \param[in] points Points of the pointcloud, one per column.
+             *  \param[in] colors Color of each point, one RGBA color per row. Alpha is ignored.
+             *  \param[in] frame Frame of the points. If empty, uses the model frame of the robot.
+             */
+            void updatePCD(const Eigen::Ref<const Eigen::Matrix3Xd> &points,
+                           const Eigen::Ref<const Eigen::ArrayX4f> &colors, const std::string &frame = "");
+
             /** \} */
 
             /** \name Markers
@@ -193,6 +239,22 @@ namespace robowflex
                                const std::string &base_frame, const RobotPose &pose, double height,
                                const Eigen::Vector4d &color = color::WHITE);
 
+            /** \brief Add a set of points as a single marker, drawn as spheres or points. Much cheaper to
+             * store and send than a marker per point. If a marker of this name already exists, its points
+             * and colors are replaced, and only it is sent on the next updateMarkers().
+             *  \param[in] name Name of the marker.
+             *  \param[in] points Points to add, one per column.
+             *  \param[in] colors Color of each point, one RGBA color per row (e.g., from the array colormaps
+             * in color).
+             *  \param[in] scale Diameter of each point.
+             *  \param[in] spheres If true, draws points as spheres (SPHERE_LIST), otherwise as squares
+             * (POINTS).
+             *  \param[in] base_frame Base frame of the points.
+             */
+            void addPointsMarker(const std::string &name, const Eigen::Ref<const Eigen::Matrix3Xd> &points,
+                                 const Eigen::Ref<const Eigen::ArrayX4f> &colors, double scale,
+                                 bool spheres = true, const std::string &base_frame = "map");
+
             /** \brief Add a set of lines as markers.
              *  \param[in] name Name of the marker.
              *  \param[in] points Pair-wise list of points to add as lines. (eg., 0-1, 2-3, ...)
@@ -227,13 +289,26 @@ namespace robowflex
 
             /** \brief Displays the managed list of markers.
              *  Keeps track of whether markers have already been displayed and simply need an update, and
-             * removes markers removed by removeMarker().
+             * removes markers removed by removeMarker(). Only markers that changed since the last update are
+             * sent, unless a new subscriber has connected.
              */
             void updateMarkers();
 
             /** \} */
 
         private:
+            /** \brief Advertises all topics with the current publish mode.
+             */
+            void advertise();
+
+            /** \brief Checks whether to publish on a topic according to the publish mode, waiting for
+             * subscribers in BLOCK mode.
+             *  \param[in] pub Publisher to check.
+             *  \param[in] name Name of the topic for logging.
+             *  \return True if the update should be published, false if it should be dropped.
+             */
+            bool isReady(const ros::Publisher &pub, const std::string &name) const;
+
             /** \brief Fills a marker in with some common default information.
              *  \param[out] marker Marker to fill.
              *  \param[in] base_frame Base frame of the pose of the marker.
@@ -253,7 +328,22 @@ namespace robowflex
             ros::Publisher pcd_pub_;         ///< Pointcloud publisher.
             ros::Publisher state_pub_;       ///< State publisher.
 
-            std::multimap<std::string, visualization_msgs::Marker> markers_;  ///< Markers to publish.
+            PublishMode mode_{BLOCK};              ///< How updates are published.
+            bool diffs_{false};                    ///< Whether to send scene diffs.
+            ID::Key scene_key_{ID::getNullKey()};  ///< Key of the last scene published.
+            std::atomic<bool> scene_full_{true};   ///< Whether the next scene must be sent in full.
+
+            /** \brief A marker managed by the helper.
+             */
+            struct ManagedMarker
+            {
+                visualization_msgs::Marker marker;  ///< The marker.
+                bool changed{true};                 ///< Has the marker changed since it was last sent?
+            };
+
+            std::multimap<std::string, ManagedMarker> markers_;  ///< Markers to publish.
+            visualization_msgs::MarkerArray marker_msg_;         ///< Message reused to send markers.
+            std::atomic<bool> markers_full_{true};               ///< Whether all markers must be sent next.
         };
     }  // namespace IO
 
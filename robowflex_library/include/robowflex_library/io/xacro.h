@@ -0,0 +1,32 @@
+/* Author: Zachary Kingston */
+
+#ifndef ROBOWFLEX_IO_XACRO_
+#define ROBOWFLEX_IO_XACRO_
+
+#include <string>
+#include <vector>
+
+namespace robowflex
+{
+    namespace IO
+    {
+        /** \brief Expands a .xacro file in-process, without starting the Python xacro tool.
+         *
+         *  Supports the commonly used subset of xacro: properties (including block properties), args,
+         * includes, macros with default, inherited (`^`), and block (`*`) parameters, `xacro:if`,
+         * `xacro:unless`, `xacro:insert_block`, the `$(find)`, `$(arg)`, `$(env)`, `$(optenv)`, and
+         * `$(dirname)` substitutions, and `${}` expressions with arithmetic, comparisons, boolean logic,
+         * string literals, and the usual math functions and constants. Anything else (e.g., namespaced
+         * includes, `xacro:element`, or arbitrary Python) is reported as unsupported, so the caller can fall
+         * back to the xacro tool. Property values and macro arguments are read as literals like xacro does,
+         * so single-quoted text such as `''` is unquoted, and only integer or numeric text becomes a number.
+         *  \param[in] path Path of the file to expand.
+         *  \param[out] result The expanded XML.
+         *  \param[out] files Canonical paths of every file read, including \a path.
+         *  \return True on success, false if the file could not be read or uses unsupported features.
+         */
+        bool expandXacro(const std::string &path, std::string &result, std::vector<std::string> &files);
+    }  // namespace IO
+}  // namespace robowflex
+
+#endif
@@ -63,21 +63,33 @@ namespace robowflex
          */
         YAML::Node toNode(const moveit_msgs::RobotState &msg);
 
-        /** \brief Loads a planning scene from a YAML file.
+        /** \brief Loads a planning scene from a YAML file, or a binary file if \a file has a `.bin`
+         * extension.
          *  \param[out] msg Message to load into.
          *  \param[in] file File to load.
          *  \return True on success, false on failure.
          */
         bool fromYAMLFile(moveit_msgs::PlanningScene &msg, const std::string &file);
 
-        /** \brief Loads a motion planning request from a YAML file.
+        /** \brief Saves a planning scene to a YAML file.
+         *  \param[in] msg Message to save.
+         *  \param[in] file File to save to.
+         *  \param[in] sidecar If true, octomap data is written as compressed binary sidecar files next to
+         * \a file (named `<stem>.octomap.<n>.z`) that the YAML references, rather than as hex in the YAML.
+         *  \return True on success, false on failure.
+         */
+        bool toYAMLFile(const moveit_msgs::PlanningScene &msg, const std::string &file, bool sidecar);
+
+        /** \brief Loads a motion planning request from a YAML file, or a binary file if \a file has a `.bin`
+         * extension.
          *  \param[out] msg Message to load into.
          *  \param[in] file File to load.
          *  \return True on success, false on failure.
          */
         bool fromYAMLFile(moveit_msgs::MotionPlanRequest &msg, const std::string &file);
 
-        /** \brief Loads a robot state from a YAML file.
+        /** \brief Loads a robot state from a YAML file, or a binary file if \a file has a `.bin`
+         * extension.
          *  \param[out] msg Message to load into.
          *  \param[in] file File to load.
          *  \return True on success, false on failure.
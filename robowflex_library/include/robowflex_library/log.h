@@ -3,6 +3,12 @@
 #ifndef ROBOWFLEX_LOGGING_
 #define ROBOWFLEX_LOGGING_
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
 #include <boost/format.hpp>
 #include <ros/console.h>
 
@@ -22,6 +28,15 @@
  *
  *  Currently, all logging is done through rosconsole. It is good practice to use the defined
  *  macros here for abstraction purpose.
+ *
+ *  By default, messages are formatted and output on the calling thread. With log::setAsync(),
+ *  messages at enabled levels are formatted on the calling thread, queued without locking in a buffer
+ *  of that thread, and output by a background thread. Messages below ROBOWFLEX_LOG_MIN_LEVEL are
+ *  compiled out, and messages on hot paths can be rate limited with the *_THROTTLE variants.
+ *
+ *  Hot paths can also be traced with RBX_TRACE, which times the enclosing scope. Spans are only
+ *  recorded if Robowflex is compiled with `ROBOWFLEX_TRACING` (the CMake option of the same name), and
+ *  are otherwise compiled out. Recorded spans are exported with log::trace::exportChromeTrace().
  */
 
 namespace robowflex
@@ -82,16 +97,199 @@ namespace robowflex
         /** \brief Show all logging messages debug and above.
          */
         void showUpToDebug();
+
+        /** \brief Enable or disable asynchronous output of messages. When enabled, messages are output by
+         *  a background thread, and messages are filtered by the level set with the showUpTo*()
+         *  functions, initially the level of the ROS logger. Fatal messages are always output
+         *  synchronously. Disabling outputs all pending messages first.
+         *  \param[in] async If true, output messages asynchronously.
+         *  \param[in] capacity Number of messages each thread can have pending. When the buffer is full,
+         *  messages are dropped, and the number of dropped messages is reported.
+         *  \param[in] period Time in seconds between outputs by the background thread.
+         */
+        void setAsync(bool async, std::size_t capacity = 1024, double period = 0.05);
+
+        /** \brief Check if messages are output asynchronously.
+         *  \return True if messages are output asynchronously.
+         */
+        bool isAsync();
+
+        /** \brief Check if asynchronous messages at a level are output.
+         *  \param[in] level Level to check.
+         *  \return True if messages at \a level are output.
+         */
+        bool isEnabled(ros::console::Level level);
+
+        /** \brief Queue a formatted message for asynchronous output. Use through the RBX_* macros.
+         *  \param[in] level Level of the message.
+         *  \param[in] message Formatted message.
+         */
+        void push(ros::console::Level level, std::string message);
+
+        /** \brief Output all pending asynchronous messages on the calling thread.
+         */
+        void flush();
+
+        /** \brief Limits how often a message is output. Use through the RBX_*_THROTTLE macros.
+         */
+        class RateLimiter
+        {
+        public:
+            /** \brief Constructor.
+             *  \param[in] period Minimum time between messages in seconds.
+             */
+            RateLimiter(double period);
+
+            /** \brief Check if a message can be output now.
+             *  \param[out] suppressed Number of messages suppressed since the last one that was output.
+             *  \return True if the message can be output.
+             */
+            bool allow(std::size_t &suppressed);
+
+            /** \brief Get a suffix that reports suppressed messages.
+             *  \param[in] suppressed Number of suppressed messages.
+             *  \return The suffix, or an empty string if no messages were suppressed.
+             */
+            static std::string getSuffix(std::size_t suppressed);
+
+        private:
+            const int64_t period_;                    ///< Minimum time between messages in nanoseconds.
+            std::atomic<int64_t> last_;               ///< Time of the last message in nanoseconds.
+            std::atomic<std::size_t> suppressed_{0};  ///< Messages suppressed since the last one.
+        };
+
+        /** \brief Tracing of timed spans. Each thread records spans into a ring buffer of its own, so
+         *  recording never waits on other threads, and only the latest spans are kept.
+         */
+        namespace trace
+        {
+            using Clock = std::chrono::steady_clock;
+
+            /** \brief A completed span.
+             */
+            struct Span
+            {
+                const char *name;          ///< Name of the span. Must be a string literal.
+                Clock::time_point start;   ///< Start time of the span.
+                Clock::time_point finish;  ///< Finish time of the span.
+                std::size_t thread;        ///< Index of the thread that recorded the span.
+            };
+
+            /** \brief Record a completed span into the calling thread's buffer.
+             *  \param[in] name Name of the span. Must be a string literal, or otherwise outlive the trace.
+             *  \param[in] start Start time of the span.
+             *  \param[in] finish Finish time of the span.
+             */
+            void record(const char *name, Clock::time_point start, Clock::time_point finish);
+
+            /** \brief Set the number of spans kept per thread. Only applies to threads that have not
+             *  recorded a span yet.
+             *  \param[in] capacity Number of spans per thread. Default is 65536.
+             */
+            void setCapacity(std::size_t capacity);
+
+            /** \brief Get the spans recorded by all threads, in order of their start time.
+             *  \return The recorded spans.
+             */
+            std::vector<Span> getSpans();
+
+            /** \brief Discard all recorded spans.
+             */
+            void clear();
+
+            /** \brief Export all recorded spans in the Chrome trace event format, which can be opened
+             *  with Perfetto (https://ui.perfetto.dev) or `chrome://tracing`.
+             *  \param[in] filename File to write to.
+             *  \return True on success, false on failure.
+             */
+            bool exportChromeTrace(const std::string &filename);
+
+            /** \brief Records a span for the lifetime of this object. Use through RBX_TRACE.
+             */
+            class Scope
+            {
+            public:
+                /** \brief Constructor. Starts the span.
+                 *  \param[in] name Name of the span. Must be a string literal.
+                 */
+                Scope(const char *name) : name_(name), start_(Clock::now())
+                {
+                }
+
+                /** \brief Destructor. Records the span.
+                 */
+                ~Scope()
+                {
+                    record(name_, start_, Clock::now());
+                }
+
+                // non-copyable
+                Scope(Scope const &) = delete;
+                void operator=(Scope const &) = delete;
+
+            private:
+                const char *name_;         ///< Name of the span.
+                Clock::time_point start_;  ///< Start time of the span.
+            };
+        }  // namespace trace
     }  // namespace log
 }  // namespace robowflex
 
+/** \def ROBOWFLEX_LOG_MIN_LEVEL
+ *  \brief Messages below this level are compiled out, including the cost of formatting them. 0 for
+ *  DEBUG, 1 for INFO, 2 for WARN, 3 for ERROR, and 4 for FATAL. Set with the CMake option of the same
+ *  name. Default is 0, which keeps all messages.
+ */
+#ifndef ROBOWFLEX_LOG_MIN_LEVEL
+#define ROBOWFLEX_LOG_MIN_LEVEL 0
+#endif
+
+/** \cond IGNORE */
+#define RBX_LOG_(level, stream, fmt, ...)                                                                    \
+    do                                                                                                       \
+    {                                                                                                        \
+        if (robowflex::log::isAsync())                                                                       \
+        {                                                                                                    \
+            if (robowflex::log::isEnabled(level))                                                            \
+                robowflex::log::push(level, robowflex::log::format(fmt, ##__VA_ARGS__));                     \
+        }                                                                                                    \
+        else                                                                                                 \
+            stream(robowflex::log::format(fmt, ##__VA_ARGS__).c_str());                                      \
+    } while (false)
+
+#define RBX_THROTTLE_(log, period, fmt, ...)                                                                 \
+    do                                                                                                       \
+    {                                                                                                        \
+        static robowflex::log::RateLimiter rbx_limiter_(period);                                             \
+        std::size_t rbx_suppressed_;                                                                         \
+        if (rbx_limiter_.allow(rbx_suppressed_))                                                             \
+            log("%1%%2%", robowflex::log::format(fmt, ##__VA_ARGS__),                                        \
+                robowflex::log::RateLimiter::getSuffix(rbx_suppressed_));                                    \
+    } while (false)
+
+#define RBX_DISABLED_(...)                                                                                   \
+    do                                                                                                       \
+    {                                                                                                        \
+    } while (false)
+/** \endcond */
+
 /**
  * \def RBX_FATAL
- * \brief Output a fatal logging message.
+ * \brief Output a fatal logging message. Always synchronous, after flushing pending asynchronous
+ * messages.
  * \param[in] fmt Format string (see boost::format specification)
  * \param[in] ... Format arguments.
  */
-#define RBX_FATAL(fmt, ...) ROS_FATAL_STREAM(robowflex::log::format(fmt, ##__VA_ARGS__).c_str())
+#if ROBOWFLEX_LOG_MIN_LEVEL <= 4
+#define RBX_FATAL(fmt, ...)                                                                                  \
+    do                                                                                                       \
+    {                                                                                                        \
+        robowflex::log::flush();                                                                             \
+        ROS_FATAL_STREAM(robowflex::log::format(fmt, ##__VA_ARGS__).c_str());                                \
+    } while (false)
+#else
+#define RBX_FATAL RBX_DISABLED_
+#endif
 
 /**
  * \def RBX_ERROR
@@ -99,7 +297,11 @@ namespace robowflex
  * \param[in] fmt Format string (see boost::format specification)
  * \param[in] ... Format arguments.
  */
-#define RBX_ERROR(fmt, ...) ROS_ERROR_STREAM(robowflex::log::format(fmt, ##__VA_ARGS__).c_str())
+#if ROBOWFLEX_LOG_MIN_LEVEL <= 3
+#define RBX_ERROR(fmt, ...) RBX_LOG_(ros::console::levels::Error, ROS_ERROR_STREAM, fmt, ##__VA_ARGS__)
+#else
+#define RBX_ERROR RBX_DISABLED_
+#endif
 
 /**
  * \def RBX_WARN
@@ -107,7 +309,11 @@ namespace robowflex
  * \param[in] fmt Format string (see boost::format specification)
  * \param[in] ... Format arguments.
  */
-#define RBX_WARN(fmt, ...) ROS_WARN_STREAM(robowflex::log::format(fmt, ##__VA_ARGS__).c_str())
+#if ROBOWFLEX_LOG_MIN_LEVEL <= 2
+#define RBX_WARN(fmt, ...) RBX_LOG_(ros::console::levels::Warn, ROS_WARN_STREAM, fmt, ##__VA_ARGS__)
+#else
+#define RBX_WARN RBX_DISABLED_
+#endif
 
 /**
  * \def RBX_INFO
@@ -115,7 +321,11 @@ namespace robowflex
  * \param[in] fmt Format string (see boost::format specification)
  * \param[in] ... Format arguments.
  */
-#define RBX_INFO(fmt, ...) ROS_INFO_STREAM(robowflex::log::format(fmt, ##__VA_ARGS__).c_str())
+#if ROBOWFLEX_LOG_MIN_LEVEL <= 1
+#define RBX_INFO(fmt, ...) RBX_LOG_(ros::console::levels::Info, ROS_INFO_STREAM, fmt, ##__VA_ARGS__)
+#else
+#define RBX_INFO RBX_DISABLED_
+#endif
 
 /**
  * \def RBX_DEBUG
@@ -123,6 +333,63 @@ namespace robowflex
  * \param[in] fmt Format string (see boost::format specification)
  * \param[in] ... Format arguments.
  */
-#define RBX_DEBUG(fmt, ...) ROS_DEBUG_STREAM(robowflex::log::format(fmt, ##__VA_ARGS__).c_str())
+#if ROBOWFLEX_LOG_MIN_LEVEL <= 0
+#define RBX_DEBUG(fmt, ...) RBX_LOG_(ros::console::levels::Debug, ROS_DEBUG_STREAM, fmt, ##__VA_ARGS__)
+#else
+#define RBX_DEBUG RBX_DISABLED_
+#endif
+
+/**
+ * \def RBX_ERROR_THROTTLE
+ * \brief Output a error logging message at most once every \a period seconds. The next message that is
+ * output reports how many were suppressed.
+ * \param[in] period Minimum time between messages in seconds.
+ * \param[in] fmt Format string (see boost::format specification)
+ * \param[in] ... Format arguments.
+ */
+#define RBX_ERROR_THROTTLE(period, fmt, ...) RBX_THROTTLE_(RBX_ERROR, period, fmt, ##__VA_ARGS__)
+
+/**
+ * \def RBX_WARN_THROTTLE
+ * \brief Output a warning logging message at most once every \a period seconds. See RBX_ERROR_THROTTLE.
+ * \param[in] period Minimum time between messages in seconds.
+ * \param[in] fmt Format string (see boost::format specification)
+ * \param[in] ... Format arguments.
+ */
+#define RBX_WARN_THROTTLE(period, fmt, ...) RBX_THROTTLE_(RBX_WARN, period, fmt, ##__VA_ARGS__)
+
+/**
+ * \def RBX_INFO_THROTTLE
+ * \brief Output a info logging message at most once every \a period seconds. See RBX_ERROR_THROTTLE.
+ * \param[in] period Minimum time between messages in seconds.
+ * \param[in] fmt Format string (see boost::format specification)
+ * \param[in] ... Format arguments.
+ */
+#define RBX_INFO_THROTTLE(period, fmt, ...) RBX_THROTTLE_(RBX_INFO, period, fmt, ##__VA_ARGS__)
+
+/**
+ * \def RBX_DEBUG_THROTTLE
+ * \brief Output a debug logging message at most once every \a period seconds. See RBX_ERROR_THROTTLE.
+ * \param[in] period Minimum time between messages in seconds.
+ * \param[in] fmt Format string (see boost::format specification)
+ * \param[in] ... Format arguments.
+ */
+#define RBX_DEBUG_THROTTLE(period, fmt, ...) RBX_THROTTLE_(RBX_DEBUG, period, fmt, ##__VA_ARGS__)
+
+/** \cond IGNORE */
+#define RBX_TRACE_CONCAT_(a, b) a##b
+#define RBX_TRACE_CONCAT(a, b) RBX_TRACE_CONCAT_(a, b)
+/** \endcond */
+
+/**
+ * \def RBX_TRACE
+ * \brief Trace the enclosing scope as a span. Compiled out unless `ROBOWFLEX_TRACING` is defined.
+ * \param[in] name Name of the span. Must be a string literal.
+ */
+#ifdef ROBOWFLEX_TRACING
+#define RBX_TRACE(name) robowflex::log::trace::Scope RBX_TRACE_CONCAT(rbx_trace_, __LINE__)(name)
+#else
+#define RBX_TRACE(name)
+#endif
 
 #endif
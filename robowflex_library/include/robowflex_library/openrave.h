@@ -3,8 +3,14 @@
 
 #include <moveit_msgs/PlanningScene.h>
 
+#include <robowflex_library/class_forward.h>
+
 namespace robowflex
 {
+    /** \cond IGNORE */
+    ROBOWFLEX_CLASS_FORWARD(Pool);
+    /** \endcond */
+
     namespace openrave
     {
         /** \brief Loads a planning_scene from an OpenRAVE Environment XML
@@ -18,6 +24,26 @@ namespace robowflex
          */
         bool fromXMLFile(moveit_msgs::PlanningScene &planning_scene, const std::string &file,
                          const std::string &model_dir);
+
+        /** \brief Loads a planning_scene from an OpenRAVE Environment XML, loading meshes in parallel and
+         * caching the converted scene on disk.
+         *
+         *  Each mesh file is loaded once, through the shared geometry cache of Geometry::makeMesh(), however
+         * many bodies reference it. If \a cache_directory is set, the converted scene is stored there in the
+         * binary format of IO::messageToBinaryFile(), keyed by a hash of the contents of \a file. An entry
+         * is only used if every file the scene was converted from (included KinBody files and meshes) is
+         * unchanged.
+         *  \param[out] planning_scene The output MoveIt message that will be filled with the planning scene
+         *  contents.
+         *  \param[in] file The path to the OpenRAVE environment XML.
+         *  \param[in] model_dir The path to the models directory, which should contain files referenced by
+         * the passed in file.
+         *  \param[in] pool Thread pool to load meshes on.
+         *  \param[in] cache_directory Directory to store converted scenes in. If empty, disables the cache.
+         *  \return True on success, false on failure.
+         */
+        bool fromXMLFile(moveit_msgs::PlanningScene &planning_scene, const std::string &file,
+                         const std::string &model_dir, const Pool &pool, const std::string &cache_directory);
     }  // namespace openrave
 }  // namespace robowflex
 
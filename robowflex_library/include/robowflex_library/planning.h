@@ -3,7 +3,11 @@
 #ifndef ROBOWFLEX_PLANNER_
 #define ROBOWFLEX_PLANNER_
 
+#include <deque>
+#include <list>
+
 #include <moveit/planning_pipeline/planning_pipeline.h>
+#include <moveit/planning_request_adapter/planning_request_adapter.h>
 
 #include <robowflex_library/class_forward.h>
 #include <robowflex_library/constants.h>
@@ -16,6 +20,7 @@ namespace robowflex
 {
     /** \cond IGNORE */
     ROBOWFLEX_CLASS_FORWARD(Geometry);
+    ROBOWFLEX_CLASS_FORWARD(Trajectory);
     /** \endcond */
 
     /** \cond IGNORE */
@@ -37,6 +42,17 @@ namespace robowflex
          */
         using ProgressProperty = std::function<std::string()>;
 
+        /** \brief A job that computes a motion plan asynchronously.
+         */
+        using PlanJobPtr = std::shared_ptr<Pool::Job<planning_interface::MotionPlanResponse>>;
+
+        /** \brief A function called with each improving solution found by an anytime plan, see
+         * planAnytime(). Takes the response containing the solution, whose trajectory is not time
+         * parameterized, and the cost of the solution in the planner's own measure.
+         */
+        using SolutionCallback =
+            std::function<void(const planning_interface::MotionPlanResponse &response, double cost)>;
+
         /** \brief Constructor.
          *  Takes in a \a robot description and an optional namespace \a name.
          *  If \a name is specified, planner parameters are namespaced under the namespace of \a robot.
@@ -58,6 +74,42 @@ namespace robowflex
         virtual planning_interface::MotionPlanResponse
         plan(const SceneConstPtr &scene, const planning_interface::MotionPlanRequest &request) = 0;
 
+        /** \brief Plan a motion given a \a request and a \a scene asynchronously.
+         *  By default, plan() is called on the shared executor (see getExecutor()). As most planners are not
+         *  thread-safe, asynchronous requests to the same planner are executed one at a time; use a
+         *  robowflex::PoolPlanner to service requests in parallel. The planner must outlive the job.
+         *  \param[in] scene A planning scene for the same \a robot_ to compute the plan in.
+         *  \param[in] request The motion planning request to solve.
+         *  \return A job that will contain the response. Canceling the job only prevents it from starting,
+         *  use terminate() to stop a running plan.
+         */
+        virtual PlanJobPtr planAsync(const SceneConstPtr &scene,
+                                     const planning_interface::MotionPlanRequest &request);
+
+        /** \brief Plan a motion given a \a request and a \a scene, reporting solutions as they are found
+         *  while the planner keeps optimizing. Each solution reported is cheaper than the ones before it,
+         *  so a caller can start executing the first and switch to better ones. The callback is called
+         *  from planning threads, one call at a time, and should return quickly. By default, plans with
+         *  plan() and reports its solution, if any, at the end with its path length as cost.
+         *  \param[in] scene A planning scene for the same \a robot_ to compute the plan in.
+         *  \param[in] request The motion planning request to solve.
+         *  \param[in] callback Function to call with each improving solution.
+         *  \return The final motion planning response generated by the planner.
+         */
+        virtual planning_interface::MotionPlanResponse
+        planAnytime(const SceneConstPtr &scene, const planning_interface::MotionPlanRequest &request,
+                    const SolutionCallback &callback);
+
+        /** \brief Request the planner to stop any plan currently in progress, if the planner supports it.
+         *  \return True if termination was requested, false if the planner does not support it.
+         */
+        virtual bool terminate();
+
+        /** \brief Get the thread pool shared by all planners for asynchronous planning.
+         *  \return The shared executor.
+         */
+        static Pool &getExecutor();
+
         /** \brief Return all planner configurations offered by this planner.
          *  Any of the configurations returned can be set as the planner for a motion planning query sent to
          *  plan().
@@ -73,6 +125,17 @@ namespace robowflex
         virtual std::map<std::string, ProgressProperty> getProgressProperties(
             const SceneConstPtr &scene, const planning_interface::MotionPlanRequest &request) const;
 
+        /** \brief Retrieve metrics of the last plan computed by this planner, e.g., the time taken by each
+         * stage of planning. These are added to the metrics of a profiled run, see robowflex::PlanData.
+         *  \return Map of metric name to value.
+         */
+        virtual std::map<std::string, double> getLastPlanMetrics() const;
+
+        /** \brief Clear the caches this planner keeps between plans (e.g., planning contexts or cached
+         * results), so the next plan pays the same one-time costs as the first. Does nothing by default.
+         */
+        virtual void clearCaches();
+
         /** \brief Return the robot for this planner.
          *  \return Get the robot associated with the planner.
          */
@@ -93,10 +156,21 @@ namespace robowflex
         RobotPtr robot_;          ///< The robot to plan for.
         IO::Handler handler_;     ///< The parameter handler for the planner.
         const std::string name_;  ///< Namespace for the planner.
+
+    private:
+        /** \brief Queue the next waiting asynchronous request on the executor, once the previous one is
+         *  done or skipped.
+         */
+        void nextAsync();
+
+        std::mutex async_mutex_;                                ///< Guards the asynchronous request queue.
+        std::deque<std::shared_ptr<Pool::Joblet>> async_queue_;  ///< Requests waiting on the one queued.
+        bool async_busy_{false};                                ///< Whether a request is on the executor.
     };
 
     /** \brief A thread pool of planners \a P to service requests in a multi-threaded environment
-     *  simultaneously.
+     *  simultaneously. Each worker thread of the pool owns one planner instance, so no planner checkout is
+     *  needed when servicing a request.
      */
     class PoolPlanner : public Planner
     {
@@ -111,13 +185,23 @@ namespace robowflex
         PoolPlanner(const RobotPtr &robot, unsigned int n = std::thread::hardware_concurrency(),
                     const std::string &name = "");
 
+        /** \brief Constructor, with the pool's worker threads pinned to CPUs.
+         *  \param[in] robot The robot to plan for.
+         *  \param[in] n The number of threads to use.
+         *  \param[in] affinity Placement of the worker threads on CPUs.
+         *  \param[in] name Optional namespace for planner.
+         */
+        PoolPlanner(const RobotPtr &robot, unsigned int n, const Pool::Affinity &affinity,
+                    const std::string &name = "");
+
         // non-copyable
         PoolPlanner(PoolPlanner const &) = delete;
         void operator=(PoolPlanner const &) = delete;
 
         /** \brief Initialize the planner pool.
          *  Forwards template arguments \a Args to the initializer of the templated planner \a P. Assumes that
-         *  the constructor of the planner takes \a robot_ and \a name_.
+         *  the constructor of the planner takes \a robot_ and \a name_. One planner is created for each
+         *  worker thread of the pool.
          *  \param[in] args Arguments to initializer of planner \a P.
          *  \tparam P The robowflex::Planner to pool.
          *  \tparam Args Argument types to initializer of planner \a P.
@@ -133,12 +217,26 @@ namespace robowflex
                 if (!planner->initialize(std::forward<Args>(args)...))
                     return false;
 
-                planners_.emplace(std::move(planner));
+                planners_.emplace_back(std::move(planner));
             }
 
             return true;
         }
 
+        /** \brief A function that creates and initializes the planner with index \a index in the pool.
+         *  Returns nullptr on failure.
+         */
+        using PlannerAllocator = std::function<PlannerPtr(unsigned int index)>;
+
+        /** \brief Initialize the planner pool with planners created by \a allocator, one for each worker
+         *  thread of the pool. The allocator is called on the worker threads, so planners are built
+         *  concurrently and \a allocator must be thread-safe. Where possible, each planner is built on the
+         *  worker that uses it, so with pinned workers its memory is on the worker's NUMA node.
+         *  \param[in] allocator Function to create each planner.
+         *  \return True on success, false on failure.
+         */
+        bool initialize(const PlannerAllocator &allocator);
+
         /** \brief Submit a motion planning request job to the queue.
          *  \param[in] scene Planning scene to plane for.
          *  \param[in] request Motion plan request to service.
@@ -147,6 +245,23 @@ namespace robowflex
         std::shared_ptr<Pool::Job<planning_interface::MotionPlanResponse>>
         submit(const SceneConstPtr &scene, const planning_interface::MotionPlanRequest &request);
 
+        /** \brief Plan a motion asynchronously on this planner's own thread pool. Equivalent to submit().
+         *  \param[in] scene A planning scene for the same \a robot_ to compute the plan in.
+         *  \param[in] request The motion planning request to solve.
+         *  \return Job that will service the planning request.
+         */
+        PlanJobPtr planAsync(const SceneConstPtr &scene,
+                             const planning_interface::MotionPlanRequest &request) override;
+
+        /** \brief Requests termination of all pooled planners.
+         *  \return True if any of the pooled planners accepted the request.
+         */
+        bool terminate() override;
+
+        /** \brief Clear the caches of all pooled planners.
+         */
+        void clearCaches() override;
+
         /** \brief Plan a motion given a \a request and a \a scene.
          *  Forwards the planning request onto the thread pool to be executed. Blocks until complete and
          *  returns result.
@@ -162,9 +277,296 @@ namespace robowflex
     private:
         Pool pool_;  ///< Thread pool
 
-        std::queue<PlannerPtr> planners_;  ///< Motion planners
-        std::mutex mutex_;                 ///< Planner mutex
-        std::condition_variable cv_;       ///< Planner condition variable
+        std::vector<PlannerPtr> planners_;  ///< Motion planners, indexed by pool worker.
+    };
+
+    /** \cond IGNORE */
+    ROBOWFLEX_CLASS_FORWARD(PortfolioPlanner);
+    /** \endcond */
+
+    /** \class robowflex::PortfolioPlannerPtr
+        \brief A shared pointer wrapper for robowflex::PortfolioPlanner. */
+
+    /** \class robowflex::PortfolioPlannerConstPtr
+        \brief A const shared pointer wrapper for robowflex::PortfolioPlanner. */
+
+    /** \brief A portfolio of planners that race on the same request at once, to reduce the variance of
+     *  planning time. Members are either different planners (e.g., OMPL, CHOMP, and TrajOpt) or instances
+     *  of the same planner with different configurations. Each member runs on the portfolio's own thread
+     *  pool, and members that are not needed for the result are stopped with Planner::terminate().
+     */
+    class PortfolioPlanner : public Planner
+    {
+    public:
+        /** \brief How the result of the portfolio is chosen.
+         */
+        enum Mode
+        {
+            FIRST,  ///< Return the first successful solution.
+            BEST    ///< Return the shortest successful solution found within the allowed planning time.
+        };
+
+        /** \brief Constructor.
+         *  \param[in] robot The robot to plan for.
+         *  \param[in] n The number of members that can run at once. By default uses maximum available on
+         *  the machine.
+         *  \param[in] name Optional namespace for planner.
+         */
+        PortfolioPlanner(const RobotPtr &robot, unsigned int n = std::thread::hardware_concurrency(),
+                         const std::string &name = "");
+
+        /** \brief Destructor. Waits for members that are still stopping.
+         */
+        ~PortfolioPlanner();
+
+        // non-copyable
+        PortfolioPlanner(PortfolioPlanner const &) = delete;
+        void operator=(PortfolioPlanner const &) = delete;
+
+        /** \brief Adds a member planner to the portfolio. Members must not be shared with other
+         *  portfolios, as they are used from the portfolio's threads.
+         *  \param[in] planner The planner to add.
+         *  \param[in] config Planner configuration to use for the member. If empty, the configuration of
+         *  the request is used.
+         */
+        void addPlanner(const PlannerPtr &planner, const std::string &config = "");
+
+        /** \brief Initialize a member planner \a P for each of a set of planner configurations.
+         *  Forwards template arguments \a Args to the initializer of the templated planner \a P. Assumes that
+         *  the constructor of the planner takes \a robot_ and \a name_.
+         *  \param[in] configs Planner configurations to race. If empty, all configurations from
+         *  getPlannerConfigs() of the first planner created are used.
+         *  \param[in] args Arguments to initializer of planner \a P.
+         *  \tparam P The robowflex::Planner to race.
+         *  \tparam Args Argument types to initializer of planner \a P.
+         *  \return True on success, false on failure.
+         */
+        template <typename P, typename... Args>
+        bool initialize(const std::vector<std::string> &configs, Args &&... args)
+        {
+            std::vector<std::string> names = configs;
+            for (std::size_t i = 0; i == 0 or i < names.size(); ++i)
+            {
+                auto planner = std::make_shared<P>(robot_, name_);
+
+                if (!planner->initialize(std::forward<Args>(args)...))
+                    return false;
+
+                if (names.empty())
+                    names = planner->getPlannerConfigs();
+
+                if (names.empty())
+                    return false;
+
+                addPlanner(planner, names[i]);
+            }
+
+            return true;
+        }
+
+        /** \brief Sets how the result of the portfolio is chosen.
+         *  \param[in] mode The mode to use.
+         */
+        void setMode(Mode mode);
+
+        /** \brief Get the index of the member that produced the last result.
+         *  \return The index of the member in order of addition, or -1 if no member succeeded.
+         */
+        int getLastWinner() const;
+
+        /** \brief Plan a motion given a \a request and a \a scene.
+         *  Runs all members at once and blocks until a result is chosen, see setMode(). Members still
+         *  running are then terminated and briefly waited on; those that take longer to stop are waited on
+         *  before the next plan.
+         *  \param[in] scene A planning scene for the same \a robot_ to compute the plan in.
+         *  \param[in] request The motion planning request to solve.
+         *  \return The motion planning response of the chosen member, or the last failure otherwise.
+         */
+        planning_interface::MotionPlanResponse
+        plan(const SceneConstPtr &scene, const planning_interface::MotionPlanRequest &request) override;
+
+        /** \brief Requests termination of all members.
+         *  \return True if any of the members accepted the request.
+         */
+        bool terminate() override;
+
+        /** \brief Clear the caches of all members.
+         */
+        void clearCaches() override;
+
+        /** \brief Calls preRun() of every member with its configuration.
+         *  \param[in] scene Scene to plan for.
+         *  \param[in] request Planning request.
+         */
+        void preRun(const SceneConstPtr &scene,
+                    const planning_interface::MotionPlanRequest &request) override;
+
+        std::vector<std::string> getPlannerConfigs() const override;
+
+    private:
+        /** \brief A member of the portfolio.
+         */
+        struct Member
+        {
+            PlannerPtr planner;  ///< The planner.
+            std::string config;  ///< Planner configuration to use, or empty for the request's.
+        };
+
+        /** \brief Get the request for a member.
+         *  \param[in] member The member to get the request for.
+         *  \param[in] request The request to the portfolio.
+         *  \return The request, with the member's planner configuration.
+         */
+        static planning_interface::MotionPlanRequest
+        getMemberRequest(const Member &member, const planning_interface::MotionPlanRequest &request);
+
+        /** \brief Waits for all member jobs of the last plan to finish.
+         */
+        void waitForMembers();
+
+        Pool pool_;                     ///< Thread pool members run on.
+        Mode mode_{FIRST};              ///< How the result is chosen.
+        std::vector<Member> members_;   ///< Members of the portfolio.
+        std::vector<PlanJobPtr> jobs_;  ///< Member jobs of the last plan.
+        std::atomic<int> winner_{-1};   ///< Index of the member that produced the last result.
+    };
+
+    /** \cond IGNORE */
+    ROBOWFLEX_CLASS_FORWARD(CachingPlanner);
+    /** \endcond */
+
+    /** \class robowflex::CachingPlannerPtr
+        \brief A shared pointer wrapper for robowflex::CachingPlanner. */
+
+    /** \class robowflex::CachingPlannerConstPtr
+        \brief A const shared pointer wrapper for robowflex::CachingPlanner. */
+
+    /** \brief A planner that caches the successful results of another planner, for queries that repeat
+     *  exactly. Results are keyed on the version of the scene and the request. On a hit, the stored
+     *  response is returned after checking that its trajectory is still collision free. On a miss, the
+     *  wrapped planner is used and its result stored. The least recently used results are evicted once the
+     *  cache is full.
+     *
+     *  By default, scenes and requests are identified by their IDs within this process (for requests of a
+     *  robowflex::MotionRequestBuilder) or hashes of their contents otherwise. A persistent cache always
+     *  uses content hashes, so it can be saved and loaded across processes.
+     */
+    class CachingPlanner : public Planner
+    {
+    public:
+        /** \brief Constructor.
+         *  \param[in] planner The planner to cache results of.
+         *  \param[in] capacity Maximum number of results to cache.
+         *  \param[in] persistent Whether to key results on contents, so they can be saved and loaded.
+         *  \param[in] name Optional namespace for planner.
+         */
+        CachingPlanner(const PlannerPtr &planner, std::size_t capacity = 64, bool persistent = false,
+                       const std::string &name = "");
+
+        // non-copyable
+        CachingPlanner(CachingPlanner const &) = delete;
+        void operator=(CachingPlanner const &) = delete;
+
+        /** \brief Plan a motion given a \a request and a \a scene, using a cached result if possible.
+         *  \param[in] scene A planning scene for the same \a robot_ to compute the plan in.
+         *  \param[in] request The motion planning request to solve.
+         *  \return The motion planning response, either cached or generated by the wrapped planner.
+         */
+        planning_interface::MotionPlanResponse
+        plan(const SceneConstPtr &scene, const planning_interface::MotionPlanRequest &request) override;
+
+        /** \brief Terminates the current plan of the wrapped planner.
+         *  \return True if termination was requested.
+         */
+        bool terminate() override;
+
+        /** \brief Remove all cached results, see clear(), and clear the caches of the wrapped planner.
+         */
+        void clearCaches() override;
+
+        std::vector<std::string> getPlannerConfigs() const override;
+
+        std::map<std::string, ProgressProperty> getProgressProperties(
+            const SceneConstPtr &scene, const planning_interface::MotionPlanRequest &request) const override;
+
+        /** \brief Retrieve metrics of the last plan. These are the metrics of the wrapped planner on a
+         * miss, together with `cache_hit` (1 on a hit, 0 otherwise) and `cache_hit_rate`.
+         *  \return Map of metric name to value.
+         */
+        std::map<std::string, double> getLastPlanMetrics() const override;
+
+        void preRun(const SceneConstPtr &scene,
+                    const planning_interface::MotionPlanRequest &request) override;
+
+        /** \brief Set the maximum number of results to cache, evicting the least recently used if needed.
+         *  \param[in] capacity Maximum number of results to cache.
+         */
+        void setCapacity(std::size_t capacity);
+
+        /** \brief Remove all cached results and reset the hit statistics.
+         */
+        void clear();
+
+        /** \brief Get the number of plans answered from the cache.
+         *  \return The number of hits.
+         */
+        std::size_t getHits() const;
+
+        /** \brief Get the number of plans not answered from the cache.
+         *  \return The number of misses.
+         */
+        std::size_t getMisses() const;
+
+        /** \brief Get the fraction of plans answered from the cache.
+         *  \return The hit rate, 0 if nothing was planned yet.
+         */
+        double getHitRate() const;
+
+        /** \brief Save the cached results to a bag file. Only persistent caches can be saved.
+         *  \param[in] filename File to save to.
+         *  \return True on success, false on failure.
+         */
+        bool save(const std::string &filename) const;
+
+        /** \brief Load cached results from a bag file written by save(). Only persistent caches can be
+         * loaded into.
+         *  \param[in] filename File to load from.
+         *  \return True on success, false on failure.
+         */
+        bool load(const std::string &filename);
+
+    private:
+        /** \brief Get the key of a query.
+         *  \param[in] scene Scene of the query.
+         *  \param[in] request Request of the query.
+         *  \return The key of the query.
+         */
+        std::string getKey(const SceneConstPtr &scene, const planning_interface::MotionPlanRequest &request);
+
+        /** \brief Insert a result into the cache as the most recently used, evicting if needed.
+         *  \param[in] key Key of the result.
+         *  \param[in] response Response to store.
+         */
+        void insert(const std::string &key, const planning_interface::MotionPlanResponse &response);
+
+        /** \brief A cached result.
+         */
+        struct Entry
+        {
+            std::string key;                                  ///< Key of the query.
+            planning_interface::MotionPlanResponse response;  ///< Stored response.
+        };
+
+        PlannerPtr planner_;    ///< Wrapped planner.
+        std::size_t capacity_;  ///< Maximum number of results to cache.
+        bool persistent_;       ///< Whether keys are content hashes.
+
+        mutable std::mutex mutex_;                                 ///< Guards the cache.
+        std::list<Entry> entries_;                                 ///< Results, most recently used first.
+        std::map<std::string, std::list<Entry>::iterator> index_;  ///< Results by key.
+        std::size_t hits_{0};                                      ///< Number of hits.
+        std::size_t misses_{0};                                    ///< Number of misses.
+        std::map<std::string, double> metrics_;                    ///< Metrics of the last plan.
     };
 
     /** \cond IGNORE */
@@ -193,7 +595,8 @@ namespace robowflex
         void operator=(SimpleCartesianPlanner const &) = delete;
 
         /** \brief Plan a Cartesian motion (interpolation) given a \a request and a \a scene from a \a start
-         * configuration. The scene, attempts, and timeout are used from \a request.
+         * configuration. The scene, attempts, and timeout are used from \a request. If a pool
+         * is set with setPool(), attempts are run in parallel on it.
          *  \param[in] start Starting state.
          *  \param[in] request The desired end-effector pose.
          *  \return The motion planning response generated by the planner.
@@ -201,6 +604,19 @@ namespace robowflex
         planning_interface::MotionPlanResponse plan(const robot_state::RobotState &start,
                                                     const Robot::IKQuery &request);
 
+        /** \brief Plan a Cartesian motion (interpolation) given a \a request and a \a scene from a \a start
+         * configuration, running attempts in parallel on a \a pool. The earliest successful attempt is
+         * returned, and later attempts stop once one succeeds. The scene, attempts, and timeout are used
+         * from \a request. If the request has no attempt limit, attempts are run in rounds of the pool's
+         * thread count until success or timeout.
+         *  \param[in] start Starting state.
+         *  \param[in] request The desired end-effector pose.
+         *  \param[in] pool Pool to run attempts on.
+         *  \return The motion planning response generated by the planner.
+         */
+        planning_interface::MotionPlanResponse plan(const robot_state::RobotState &start,
+                                                    const Robot::IKQuery &request, const Pool &pool);
+
         /** \brief Plan a motion given a \a request and a \a scene.
          *  \param[in] scene A planning scene for the same \a robot_ to compute the plan in.
          *  \param[in] request The motion planning request to solve.
@@ -209,6 +625,12 @@ namespace robowflex
         planning_interface::MotionPlanResponse
         plan(const SceneConstPtr &scene, const planning_interface::MotionPlanRequest &request) override;
 
+        /** \brief Set a pool to run attempts on in parallel, see plan(). If null, attempts are run
+         * serially.
+         *  \param[in] pool Pool to use.
+         */
+        void setPool(const PoolPtr &pool);
+
         /** \brief Set the maximum step size allowed by the planner between output waypoints.
          *  \param[in] position The new step size for the position of the end-effector.
          *  \param[in] rotation The new step size for the rotation of the end-effector.
@@ -222,15 +644,87 @@ namespace robowflex
          */
         void setJumpThreshold(double prismatic, double revolute);
 
+        /** \brief Use an adaptive step size instead of MoveIt's fixed step interpolation. The path is
+         * first interpolated in segments \a factor times the maximum step, using IK seeded from the last
+         * waypoint. A segment is kept if it satisfies the jump threshold and the joint-space motion
+         * across it stays valid and within a step of the Cartesian line. Otherwise, it is bisected, down
+         * to the maximum step size. Long, easy motions then need far fewer IK calls.
+         *  \param[in] adaptive Whether to use an adaptive step.
+         *  \param[in] factor Size of the initial segments, as a multiple of the maximum step.
+         */
+        void setAdaptiveStep(bool adaptive, unsigned int factor = 16);
+
         std::vector<std::string> getPlannerConfigs() const override;
 
     private:
+        /** \brief Compute a single attempt of a Cartesian path.
+         *  \param[in] start Starting state.
+         *  \param[in] jmg Joint model group to plan for.
+         *  \param[in] lm Link to move along the path.
+         *  \param[in] pose Goal pose of \a lm.
+         *  \param[in] gsvcf Validity callback of states, may be empty.
+         *  \param[out] traj Waypoints of the path, computed up to failure.
+         *  \return True if the whole path was computed.
+         */
+        bool computeAttempt(const robot_state::RobotState &start, const robot_model::JointModelGroup *jmg,
+                            const robot_model::LinkModel *lm, const RobotPose &pose,
+                            const moveit::core::GroupStateValidityCallbackFn &gsvcf,
+                            std::vector<robot_state::RobotStatePtr> &traj) const;
+
+        /** \brief Adaptively interpolate a segment of a Cartesian path, bisecting it if needed.
+         *  \param[in] from State at the start of the segment.
+         *  \param[in] from_pose Pose of \a lm at the start of the segment.
+         *  \param[in] to_pose Pose of \a lm at the end of the segment.
+         *  \param[in] jmg Joint model group to plan for.
+         *  \param[in] lm Link to move along the path.
+         *  \param[in] gsvcf Validity callback of states, may be empty.
+         *  \param[in] depth Number of bisections still allowed.
+         *  \param[out] traj Waypoints to append to, excluding \a from.
+         *  \return True if the segment was interpolated.
+         */
+        bool interpolateSegment(const robot_state::RobotState &from, const RobotPose &from_pose,
+                                const RobotPose &to_pose, const robot_model::JointModelGroup *jmg,
+                                const robot_model::LinkModel *lm,
+                                const moveit::core::GroupStateValidityCallbackFn &gsvcf, unsigned int depth,
+                                std::vector<robot_state::RobotStatePtr> &traj) const;
+
+        /** \brief Checks if the joint-space motion between two waypoints is acceptable.
+         *  \param[in] from State at the start of the segment.
+         *  \param[in] to State at the end of the segment.
+         *  \param[in] from_pose Pose of \a lm at the start of the segment.
+         *  \param[in] to_pose Pose of \a lm at the end of the segment.
+         *  \param[in] jmg Joint model group to plan for.
+         *  \param[in] lm Link to move along the path.
+         *  \param[in] gsvcf Validity callback of states, may be empty.
+         *  \return True if the motion satisfies the jump threshold, and its intermediate states are valid
+         * and close to the Cartesian line.
+         */
+        bool isSegmentValid(const robot_state::RobotState &from, const robot_state::RobotState &to,
+                            const RobotPose &from_pose, const RobotPose &to_pose,
+                            const robot_model::JointModelGroup *jmg, const robot_model::LinkModel *lm,
+                            const moveit::core::GroupStateValidityCallbackFn &gsvcf) const;
+
+        /** \brief Builds the response of a plan.
+         *  \param[in] group Planning group of the plan.
+         *  \param[in] traj Waypoints of the path.
+         *  \param[in] success Whether the path was found.
+         *  \param[in] time Time taken to plan.
+         *  \return The response.
+         */
+        planning_interface::MotionPlanResponse
+        getResponse(const std::string &group, const std::vector<robot_state::RobotStatePtr> &traj,
+                    bool success, double time) const;
+
         double max_step_pos_{constants::cart_pos_step_size};  ///< Max EE step size for position in meters.
         double max_step_rot_{constants::cart_rot_step_size};  ///< Max EE step size for rotation in radians.
         double jump_threshold_pri_{constants::cart_pos_jump_tol};  ///< Max jump for prismatic joints in
                                                                    ///< meters.
         double jump_threshold_rev_{constants::cart_rot_jump_tol};  ///< Max jump for revolute joints in
                                                                    ///< radians.
+
+        bool adaptive_{false};     ///< Whether to use an adaptive step.
+        unsigned int factor_{16};  ///< Initial segment size of the adaptive step, in max steps.
+        PoolPtr pool_;             ///< Pool to run attempts on, if any.
     };
 
     /** \cond IGNORE */
@@ -257,7 +751,9 @@ namespace robowflex
         void operator=(PipelinePlanner const &) = delete;
 
         /** \brief Plan a motion given a \a request and a \a scene.
-         *  Uses the planning pipeline's generatePlan() method, which goes through planning adapters.
+         *  Goes through the planning adapters of the pipeline as its generatePlan() method does, timing
+         * each stage and reusing planning contexts where possible (see setContextCacheCapacity()). If the
+         * adapters cannot be loaded, generatePlan() is used directly.
          *  \param[in] scene A planning scene for the same \a robot_ to compute the plan in.
          *  \param[in] request The motion planning request to solve.
          *  \return The motion planning response generated by the planner.
@@ -265,6 +761,33 @@ namespace robowflex
         planning_interface::MotionPlanResponse
         plan(const SceneConstPtr &scene, const planning_interface::MotionPlanRequest &request) override;
 
+        /** \brief Terminates the current plan of the planning pipeline.
+         *  \return True if the pipeline is loaded and termination was requested.
+         */
+        bool terminate() override;
+
+        /** \brief Clear all cached planning contexts, see clearContextCache().
+         */
+        void clearCaches() override;
+
+        /** \brief Set the number of planning contexts to keep for reuse. Contexts are reused for planning
+         * on the same version of a scene with the same request. If 0, contexts are not reused.
+         *  \param[in] capacity Number of contexts to cache.
+         */
+        void setContextCacheCapacity(std::size_t capacity);
+
+        /** \brief Clear all cached planning contexts.
+         */
+        void clearContextCache();
+
+        /** \brief Retrieve the time taken by each stage of the last plan, in seconds. Each adapter of the
+         * pipeline is reported as `pipeline_<adapter>_time`, excluding the time of the stages it calls.
+         * The planner itself is reported as `pipeline_planner_time`, and checking the solution path as
+         * `pipeline_check_time`.
+         *  \return Map of stage metric name to time.
+         */
+        std::map<std::string, double> getLastPlanMetrics() const override;
+
         /** \brief Retrieve planning context and dynamically cast to desired type from planning pipeline.
          *  \param[in] scene A planning scene for the same \a robot_ to compute the plan in.
          *  \param[in] request The motion planning request to solve.
@@ -284,6 +807,60 @@ namespace robowflex
 
     protected:
         planning_pipeline::PlanningPipelinePtr pipeline_;  ///< Loaded planning pipeline plugin.
+
+    private:
+        /** \brief Loads the adapters of the pipeline, if not already loaded for it.
+         *  \return True if all adapters were loaded, false otherwise.
+         */
+        bool loadAdapters();
+
+        /** \brief Call an adapter of the pipeline, which in turn calls the next stage.
+         *  \param[in] index Index of the adapter. If past the last adapter, calls the planner.
+         *  \param[in] scene Scene the plan was requested in.
+         *  \param[in] ps Planning scene to plan in, as given by the previous stage.
+         *  \param[in] request Request to plan, as given by the previous stage.
+         *  \param[out] response Response of the plan.
+         *  \param[out] added Indices of states added by each adapter.
+         *  \param[out] times Time taken by each stage, including the stages it calls.
+         *  \return True if planning was successful.
+         */
+        bool callStage(std::size_t index, const SceneConstPtr &scene,
+                       const planning_scene::PlanningSceneConstPtr &ps,
+                       const planning_interface::MotionPlanRequest &request,
+                       planning_interface::MotionPlanResponse &response,
+                       std::vector<std::vector<std::size_t>> &added, std::vector<double> &times);
+
+        /** \brief Solve a request with a planning context, reusing a cached one if possible.
+         *  \param[in] scene Scene the plan was requested in.
+         *  \param[in] ps Planning scene to plan in.
+         *  \param[in] request Request to plan.
+         *  \param[out] response Response of the plan.
+         *  \return True if planning was successful.
+         */
+        bool solve(const SceneConstPtr &scene, const planning_scene::PlanningSceneConstPtr &ps,
+                   const planning_interface::MotionPlanRequest &request,
+                   planning_interface::MotionPlanResponse &response);
+
+        /** \brief A cached planning context.
+         */
+        struct CachedContext
+        {
+            ID::Key scene;                                   ///< Key of the scene.
+            std::string request;                             ///< Fingerprint of the request.
+            planning_interface::PlanningContextPtr context;  ///< The context.
+        };
+
+        planning_pipeline::PlanningPipelinePtr loaded_;  ///< Pipeline the adapters were loaded for.
+
+        std::vector<planning_request_adapter::PlanningRequestAdapterConstPtr> adapters_;  ///< Adapters.
+        std::vector<std::string> stages_;                                                 ///< Stage names.
+
+        std::size_t capacity_{4};            ///< Number of contexts to cache.
+        std::list<CachedContext> contexts_;  ///< Cached contexts, most recently used first.
+
+        std::mutex mutex_;                                ///< Protects the running context.
+        planning_interface::PlanningContextPtr running_;  ///< Context currently planning, if any.
+        std::map<std::string, double> metrics_;           ///< Stage times of the last plan.
     };
 
     /** \brief OMPL specific planners and features.
@@ -295,6 +872,15 @@ namespace robowflex
         bool loadOMPLConfig(IO::Handler &handler, const std::string &config_file,
                             std::vector<std::string> &configs);
 
+        /** \brief Reads the OMPL planner configurations of every group of a robot from the in-process
+         *  parameters of \a handler, the same way _MoveIt!_'s OMPL interface reads them from the ROS master.
+         *  \param[in] handler Handler the OMPL configuration was loaded into.
+         *  \param[in] model Robot model to read the configurations of the groups of.
+         *  \return The planner configurations.
+         */
+        planning_interface::PlannerConfigurationMap
+        getPlannerConfigurations(const IO::Handler &handler, const robot_model::RobotModelConstPtr &model);
+
         /** \brief Settings descriptor for settings provided by the default \a MoveIt! OMPL planning pipeline.
          */
         class Settings
@@ -490,6 +1076,102 @@ namespace robowflex
             std::vector<std::string> configs_;  ///< Planning configurations loaded from \a config_file.
         };
 
+        /** \cond IGNORE */
+        ROBOWFLEX_CLASS_FORWARD(CHOMPWarmStartPlanner);
+        /** \endcond */
+
+        /** \class robowflex::opt::CHOMPWarmStartPlannerPtr
+            \brief A shared pointer wrapper for robowflex::opt::CHOMPWarmStartPlanner. */
+
+        /** \class robowflex::opt::CHOMPWarmStartPlannerConstPtr
+            \brief A const shared pointer wrapper for robowflex::opt::CHOMPWarmStartPlanner. */
+
+        /** \brief A CHOMP planner that optimizes from a given seed trajectory, e.g., a quick OMPL solution,
+         * rather than a straight line. Several restarts from perturbed copies of the seed are optimized in
+         * parallel, and the shortest solution is returned. CHOMP is run through its optimizer adapter, which
+         * refines the trajectory planned by the stage before it.
+         */
+        class CHOMPWarmStartPlanner : public Planner
+        {
+        public:
+            /** \brief Constructor.
+             *  \param[in] robot The robot to plan for.
+             *  \param[in] n The number of restarts that can run at once. By default uses maximum available
+             *  on the machine.
+             *  \param[in] name Optional namespace for planner.
+             */
+            CHOMPWarmStartPlanner(const RobotPtr &robot, unsigned int n = std::thread::hardware_concurrency(),
+                                  const std::string &name = "");
+
+            // non-copyable
+            CHOMPWarmStartPlanner(CHOMPWarmStartPlanner const &) = delete;
+            void operator=(CHOMPWarmStartPlanner const &) = delete;
+
+            /** \brief Initialize the planner. Parameters are set on the parameter server from \a settings,
+             * except that trajectories are always initialized from the seed.
+             *  \param[in] settings Planner settings.
+             *  \param[in] adapter CHOMP optimizer adapter plugin to load.
+             *  \return True upon success, false on failure.
+             */
+            bool initialize(const CHOMPSettings &settings = CHOMPSettings(),
+                            const std::string &adapter = DEFAULT_ADAPTER);
+
+            /** \brief Set the trajectory to seed optimization from. It should start and end at the start and
+             * goal of the requests to plan. If null, a straight line in joint space is used, which requires a
+             * joint goal.
+             *  \param[in] seed The seed trajectory.
+             */
+            void setSeed(const TrajectoryConstPtr &seed);
+
+            /** \brief Set the number of restarts to optimize. The first restart uses the seed as is, the
+             * others perturb its interior waypoints by a smooth random offset of each joint.
+             *  \param[in] restarts Number of restarts.
+             *  \param[in] noise Maximum offset of a joint, in its units.
+             *  \param[in] seed Seed of the random perturbations.
+             */
+            void setRestarts(std::size_t restarts, double noise = 0.1, unsigned int seed = 0);
+
+            /** \brief Plan a motion given a \a request and a \a scene. Restarts that have not started once
+             * the allowed planning time of the request has passed are skipped.
+             *  \param[in] scene A planning scene for the same \a robot_ to compute the plan in.
+             *  \param[in] request The motion planning request to solve.
+             *  \return The shortest solution of the restarts.
+             */
+            planning_interface::MotionPlanResponse
+            plan(const SceneConstPtr &scene, const planning_interface::MotionPlanRequest &request) override;
+
+            /** \brief Skips restarts of the current plan that have not started yet. Running restarts cannot
+             * be stopped.
+             *  \return True.
+             */
+            bool terminate() override;
+
+            std::vector<std::string> getPlannerConfigs() const override;
+
+            static const std::string DEFAULT_ADAPTER;  ///< The default CHOMP optimizer adapter.
+
+        private:
+            /** \brief Get the trajectory to seed a request from.
+             *  \param[in] scene Scene of the request.
+             *  \param[in] request The request.
+             *  \return The seed trajectory, or nullptr if none could be made.
+             */
+            TrajectoryPtr getSeedTrajectory(const SceneConstPtr &scene,
+                                            const planning_interface::MotionPlanRequest &request) const;
+
+            Pool pool_;                           ///< Thread pool restarts run on.
+            std::string adapter_name_;            ///< Name of the optimizer adapter.
+            TrajectoryConstPtr seed_;             ///< Seed trajectory, if any.
+            std::size_t restarts_;                ///< Number of restarts.
+            double noise_{0.1};                   ///< Maximum perturbation of a joint.
+            unsigned int random_seed_{0};         ///< Seed of the perturbations.
+            std::atomic<bool> terminate_{false};  ///< Whether to skip remaining restarts.
+
+            /** \brief Optimizer adapters, one per restart, as each restart runs in its own thread.
+             */
+            std::vector<planning_request_adapter::PlanningRequestAdapterConstPtr> adapters_;
+        };
+
         /** \cond IGNORE */
         ROBOWFLEX_CLASS_FORWARD(TrajOptPipelinePlanner);
         /** \endcond */
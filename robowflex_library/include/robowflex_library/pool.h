@@ -3,12 +3,22 @@
 #ifndef ROBOWFLEX_POOL_
 #define ROBOWFLEX_POOL_
 
-#include <memory>      // for std::shared_ptr
-#include <thread>      // for std::thread
-#include <future>      // for std::future / std::promise
-#include <functional>  // for std::function
-#include <vector>      // for std::vector
-#include <queue>       // for std::queue
+#include <memory>              // for std::shared_ptr
+#include <thread>              // for std::thread
+#include <future>              // for std::future / std::promise
+#include <functional>          // for std::function
+#include <vector>              // for std::vector
+#include <array>               // for std::array
+#include <chrono>              // for std::chrono
+#include <cstdint>             // for uint64_t
+#include <queue>               // for std::queue
+#include <deque>               // for std::deque
+#include <atomic>              // for std::atomic
+#include <mutex>               // for std::mutex
+#include <condition_variable>  // for std::condition_variable
+#include <exception>           // for std::exception_ptr
+#include <iterator>            // for std::begin / std::end
+#include <type_traits>         // for std::decay
 
 namespace robowflex
 {
@@ -90,15 +100,86 @@ namespace robowflex
     /** \brief A thread pool that can execute arbitrary functions asynchronously.
      *  Functions with arguments to be executed are put in the queue through submit(). This returns a
      *  Pool::Job that can be used to retrieve the result or cancel the job if the result is no longer needed.
+     *  Jobs are either pulled from a single shared queue, or distributed over per-worker deques with idle
+     *  workers stealing from busy ones (see Pool::Scheduler).
      */
     class Pool
     {
     public:
+        /** \brief Scheduling strategy used to distribute jobs to the worker threads.
+         */
+        enum class Scheduler
+        {
+            SHARED,   ///< All workers pull from a single, shared FIFO queue.
+            STEALING  ///< Each worker has its own deque, and idle workers steal jobs from others.
+        };
+
+        /** \brief Priority lanes for jobs. Workers always take jobs from the highest non-empty lane.
+         */
+        enum class Priority
+        {
+            HIGH = 0,    ///< Latency-critical jobs.
+            NORMAL = 1,  ///< Default priority.
+            LOW = 2      ///< Background jobs.
+        };
+
+        static constexpr std::size_t PRIORITIES = 3;  ///< Number of priority lanes.
+
+        /** \brief Placement of worker threads on CPUs. Only CPUs the process is allowed to run on are used.
+         *  Pinned workers also allocate memory they first touch on their CPU's NUMA node, so objects built
+         *  on a worker (e.g., per-worker planners) are local to it.
+         */
+        struct Affinity
+        {
+            /** \brief Policy for assigning workers to CPUs.
+             */
+            enum class Policy
+            {
+                NONE,     ///< Workers are not pinned, and are placed by the OS.
+                COMPACT,  ///< Workers fill the CPUs of one NUMA node before moving to the next.
+                SCATTER,  ///< Workers are dealt out round-robin over NUMA nodes.
+                LIST      ///< Workers are pinned to the CPUs in \a cpus, in order.
+            };
+
+            Policy policy{Policy::NONE};     ///< Policy for assigning workers to CPUs.
+            std::vector<unsigned int> cpus;  ///< CPUs for Policy::LIST. Reused from the start if there are
+                                             ///< more workers than CPUs.
+        };
+
+        /** \brief Clock used for job deadlines and wait times.
+         */
+        using Clock = std::chrono::steady_clock;
+
+        /** \brief Scheduling options for a submitted job.
+         */
+        struct JobOptions
+        {
+            Priority priority{Priority::NORMAL};  ///< Priority lane of the job.
+            double deadline{0.};  ///< If positive, time in seconds after submission by which the job must
+                                  ///< start. Jobs that are still queued after their deadline are dropped.
+        };
+
+        /** \brief Statistics about jobs that have passed through the pool.
+         */
+        struct Stats
+        {
+            std::array<std::size_t, PRIORITIES> depth;  ///< Jobs currently queued in each priority lane.
+            std::size_t executed;                       ///< Jobs that have started execution.
+            std::size_t dropped;                        ///< Jobs dropped because their deadline passed.
+            std::size_t canceled;                       ///< Jobs skipped because they were canceled.
+            double average_wait;  ///< Average time between submission and start of execution, in seconds.
+            double max_wait;      ///< Maximum time between submission and start of execution, in seconds.
+        };
+
         /** \brief Interface class for Pool::Job so template parameters are not needed for the queue.
          */
         class Joblet
         {
         public:
+            /** \brief Virtual destructor.
+             */
+            virtual ~Joblet() = default;
+
             /** \brief Execute the underlying function.
              */
             virtual void execute() = 0;
@@ -112,8 +193,33 @@ namespace robowflex
              */
             bool isCancled() const;
 
+            /** \brief Checks if this job was dropped by the pool because it missed its deadline.
+             *  \return True if the job expired, false otherwise.
+             */
+            bool isExpired() const;
+
+            /** \brief Get the priority lane of this job.
+             *  \return The priority of the job.
+             */
+            Priority getPriority() const;
+
         protected:
-            bool canceled{false};  ///< Whether the job is cancled or not.
+            /** \brief Called when the pool skips this job without executing it (canceled or expired).
+             *  Implementations should release any waiters on the job's result.
+             */
+            virtual void abandon()
+            {
+            }
+
+            std::atomic<bool> canceled{false};  ///< Whether the job is cancled or not.
+            std::atomic<bool> expired{false};   ///< Whether the job missed its deadline.
+
+        private:
+            friend class Pool;
+
+            Priority priority_{Priority::NORMAL};  ///< Priority lane.
+            Clock::time_point submitted_;          ///< Time of submission.
+            Clock::time_point deadline_{Clock::time_point::max()};  ///< Latest allowed start time.
         };
 
         /** \brief A job that returns \a RT.
@@ -142,8 +248,9 @@ namespace robowflex
             }
 
             /** \brief Blocking call to retrieve the result of the function.
-             *  Note that if the job was canceled it is not guaranteed that this function will return, as the
-             *  job might never be executed.
+             *  If the job is skipped by the pool because it was canceled or missed its deadline, this throws
+             *  std::future_error. Note that if the job was canceled it is not guaranteed that this function
+             *  will return while the job is still queued.
              *  \return The result of the job.
              */
             RT get()
@@ -174,16 +281,134 @@ namespace robowflex
                 return future_.wait_for(std::chrono::duration<double>(time)) == std::future_status::ready;
             }
 
+        protected:
+            /** \brief Releases the job's future with a broken promise.
+             */
+            void abandon() override
+            {
+                task_ = std::packaged_task<RT()>();
+            }
+
         private:
             std::function<RT()> function_;   ///< Bound function to execute.
             std::packaged_task<RT()> task_;  ///< Task of function.
             std::future<RT> future_;         ///< Future of function result.
         };
 
-        /** \brief Constructor.
+        /** \brief A batch of indexed work items that is executed in chunks by the pool's workers.
+         *  The same batch is queued once per participating worker, and each execution claims chunks of the
+         *  index range until none are left. This avoids allocating a job per item.
+         */
+        class Batch : public Joblet
+        {
+        public:
+            /** \brief Constructor.
+             *  \param[in] function Function called for every index in [\a begin, \a end).
+             *  \param[in] begin First index of the range.
+             *  \param[in] end One past the last index of the range.
+             *  \param[in] grain Number of indices per chunk. Must be positive.
+             */
+            Batch(const std::function<void(std::size_t)> &function, std::size_t begin, std::size_t end,
+                  std::size_t grain);
+
+            /** \brief Claims and executes chunks of the batch until none are left or the batch is canceled.
+             */
+            void execute() override;
+
+            /** \brief Blocking call until the whole batch has been executed. Rethrows the first exception
+             *  thrown by any item in the batch.
+             *  Note that if the batch was canceled it is not guaranteed that this function will return.
+             */
+            void get() const;
+
+            /** \brief Waits until the whole batch is complete.
+             */
+            void wait() const;
+
+            /** \brief Returns true if the batch is done, false otherwise.
+             *  \return True if batch is done, false otherwise.
+             */
+            bool isDone() const;
+
+            /** \brief Waits for a number of seconds to see if the batch completes.
+             *  \return True if batch is complete, false otherwise.
+             */
+            bool waitFor(double time) const;
+
+            /** \brief Get the number of chunks the batch was split into.
+             *  \return The number of chunks.
+             */
+            std::size_t getChunkCount() const;
+
+        protected:
+            /** \brief Releases waiters on the batch with a broken promise, unless it already completed.
+             */
+            void abandon() override;
+
+        private:
+            std::function<void(std::size_t)> function_;  ///< Function to call per index.
+            const std::size_t begin_;                     ///< First index.
+            const std::size_t end_;                       ///< One past last index.
+            const std::size_t grain_;                     ///< Indices per chunk.
+            const std::size_t chunks_;                    ///< Total number of chunks.
+
+            std::atomic<std::size_t> next_{0};      ///< Next unclaimed chunk.
+            std::atomic<std::size_t> finished_{0};  ///< Number of finished chunks.
+            std::atomic<bool> released_{false};     ///< Has the promise been fulfilled or abandoned?
+
+            std::mutex mutex_;                 ///< Mutex for first exception.
+            std::exception_ptr exception_;     ///< First exception thrown by an item.
+            std::promise<void> promise_;       ///< Completion promise.
+            std::shared_future<void> future_;  ///< Completion future.
+        };
+
+        /** \brief A batch of work items that each return \a RT, collected in input order.
+         *  \tparam RT Return type of function to be executed. Results are written concurrently into a
+         *  std::vector, so \a RT must be default constructible and cannot be bool.
+         */
+        template <typename RT>
+        class BatchJob : public Batch
+        {
+            static_assert(not std::is_same<RT, bool>::value,
+                          "std::vector<bool> cannot be written concurrently, use another result type.");
+
+        public:
+            /** \brief Constructor.
+             *  \param[in] function Function called for every index in [0, \a size).
+             *  \param[in] size Number of items.
+             *  \param[in] grain Number of items per chunk. Must be positive.
+             */
+            BatchJob(const std::function<RT(std::size_t)> &function, std::size_t size, std::size_t grain)
+              : Batch([this, function](std::size_t i) { results_[i] = function(i); }, 0, size, grain)
+              , results_(size)
+            {
+            }
+
+            /** \brief Blocking call to retrieve the results of the batch, in input order.
+             *  \return The results of the batch.
+             */
+            const std::vector<RT> &get() const
+            {
+                Batch::get();
+                return results_;
+            }
+
+        private:
+            std::vector<RT> results_;  ///< Results of every item.
+        };
+
+        /** \brief Constructor. Workers are not pinned.
          *  \param[in] n The number of threads to use. By default uses available hardware threads.
+         *  \param[in] scheduler The scheduling strategy to use for distributing jobs.
          */
-        Pool(unsigned int n = std::thread::hardware_concurrency());
+        Pool(unsigned int n = std::thread::hardware_concurrency(), Scheduler scheduler = Scheduler::SHARED);
+
+        /** \brief Constructor.
+         *  \param[in] n The number of threads to use.
+         *  \param[in] scheduler The scheduling strategy to use for distributing jobs.
+         *  \param[in] affinity Placement of the worker threads on CPUs.
+         */
+        Pool(unsigned int n, Scheduler scheduler, const Affinity &affinity);
 
         /** \brief Destructor.
          *  Cancels all threads and joins them.
@@ -195,6 +420,39 @@ namespace robowflex
          */
         unsigned int getThreadCount() const;
 
+        /** \brief Get the scheduling strategy used by this pool.
+         *  \return The scheduling strategy.
+         */
+        Scheduler getScheduler() const;
+
+        /** \brief Get the index of the calling thread within this pool.
+         *  \return The index of the worker thread in [0, getThreadCount()), or -1 if the calling thread is not
+         *  a worker of this pool.
+         */
+        int getWorkerIndex() const;
+
+        /** \brief Get the CPU a worker thread is pinned to.
+         *  \param[in] index Index of the worker thread.
+         *  \return The CPU of the worker, or -1 if it is not pinned.
+         */
+        int getWorkerCPU(unsigned int index) const;
+
+        /** \brief Get the CPU the calling thread is currently running on.
+         *  \return The CPU, or -1 if it cannot be determined.
+         */
+        static int getCurrentCPU();
+
+        /** \brief Get the NUMA node of a CPU.
+         *  \param[in] cpu The CPU.
+         *  \return The NUMA node of the CPU. 0 if the machine does not report NUMA nodes.
+         */
+        static unsigned int getNode(unsigned int cpu);
+
+        /** \brief Get statistics about queued and executed jobs.
+         *  \return The current statistics.
+         */
+        Stats getStats() const;
+
         /** \brief Submit a function with arguments to be processed by the thread pool.
          *  Submitted functions must be wrapped with robowflex::make_function() or be a std::function type so
          *  argument template deduction works.
@@ -207,32 +465,185 @@ namespace robowflex
          */
         template <typename RT, typename... Args>
         std::shared_ptr<Job<RT>> submit(const std::function<RT(Args...)> &&function, Args &&... args) const
+        {
+            return submit(JobOptions(), std::forward<const std::function<RT(Args...)>>(function),
+                          std::forward<Args>(args)...);
+        }
+
+        /** \brief Submit a function with arguments to be processed by the thread pool in a specific
+         *  priority lane and with an optional deadline.
+         *  \param[in] options Scheduling options for the job.
+         *  \param[in] function Function to execute.
+         *  \param[in] args Arguments to the function.
+         *  \tparam RT Return type of function.
+         *  \tparam Args Types of the arguments to the function.
+         *  \return A job that contains information about the submitted function. If the job is not started
+         *  before its deadline, it is dropped and marked as expired.
+         */
+        template <typename RT, typename... Args>
+        std::shared_ptr<Job<RT>> submit(const JobOptions &options, const std::function<RT(Args...)> &&function,
+                                        Args &&... args) const
         {
             auto job = std::make_shared<Job<RT>>(std::forward<const std::function<RT(Args...)>>(function),
                                                  std::forward<Args>(args)...);
+            prepare(*job, options);
+            enqueue(job);
 
-            {
-                std::unique_lock<std::mutex> lock(mutex_);
-                jobs_.emplace(job);
+            return job;
+        }
 
-                cv_.notify_one();
-            }
+        /** \brief Queue a job that was constructed by the caller rather than by submit(), e.g., a subclass
+         *  of Pool::Job that is held back until the jobs it must follow are done. The job is queued with the
+         *  default scheduling options, and is skipped as usual if it is canceled before it starts.
+         *  \param[in] job Job to queue.
+         */
+        void submitJob(const std::shared_ptr<Joblet> &job) const;
+
+        /** \brief Submit a function to be called for every index in [\a begin, \a end).
+         *  Indices are split into chunks of \a grain items, and the chunks are queued at once.
+         *  \param[in] begin First index of the range.
+         *  \param[in] end One past the last index of the range.
+         *  \param[in] function Function to call per index.
+         *  \param[in] grain Number of indices per chunk. If 0, a chunk size is picked from the thread count.
+         *  \return A single handle for the whole batch.
+         */
+        std::shared_ptr<Batch> submitFor(std::size_t begin, std::size_t end,
+                                         const std::function<void(std::size_t)> &function,
+                                         std::size_t grain = 0) const;
+
+        /** \brief Call a function for every index in [\a begin, \a end), and block until all are done.
+         *  The calling thread also executes chunks of the batch, so this is safe to call from within a job.
+         *  \param[in] begin First index of the range.
+         *  \param[in] end One past the last index of the range.
+         *  \param[in] function Function to call per index.
+         *  \param[in] grain Number of indices per chunk. If 0, a chunk size is picked from the thread count.
+         */
+        void parallelFor(std::size_t begin, std::size_t end, const std::function<void(std::size_t)> &function,
+                         std::size_t grain = 0) const;
+
+        /** \brief Submit a function to be called on every element of a random-access \a range. The range
+         *  must remain valid until the batch completes.
+         *  \param[in] range Range of elements to process.
+         *  \param[in] function Function to call on every element.
+         *  \param[in] grain Number of elements per chunk. If 0, a chunk size is picked from the thread count.
+         *  \tparam Range Type of the range.
+         *  \tparam F Type of the function.
+         *  \return A single handle for the whole batch, which contains the results in range order.
+         */
+        template <typename Range, typename F,
+                  typename RT = typename std::decay<decltype(
+                      std::declval<F>()(*std::begin(std::declval<const Range &>())))>::type>
+        std::shared_ptr<BatchJob<RT>> submitBatch(const Range &range, F &&function, std::size_t grain = 0) const
+        {
+            const auto first = std::begin(range);
+            const std::size_t size = std::distance(first, std::end(range));
 
-            return job;
+            std::function<RT(std::size_t)> item = [first, function](std::size_t i) { return function(first[i]); };
+            auto batch = std::make_shared<BatchJob<RT>>(item, size, getGrain(size, grain));
+            prepare(*batch, JobOptions());
+            enqueue(batch, getBatchCopies(*batch));
+
+            return batch;
         }
 
         /** \brief Background thread process.
          *  Executes jobs submitted from submit().
+         *  \param[in] index Index of the worker thread running this process.
          */
-        void run();
+        void run(unsigned int index);
 
     private:
-        bool active_{false};                  ///< Is thread pool active?
+        /** \brief Per-worker job deque used by the work-stealing scheduler.
+         */
+        struct Worker
+        {
+            std::mutex mutex;                                                   ///< Deque mutex.
+            std::array<std::deque<std::shared_ptr<Joblet>>, PRIORITIES> jobs;  ///< Jobs per priority lane.
+        };
+
+        /** \brief Set the scheduling information of a job before it is queued.
+         *  \param[in,out] job Job to prepare.
+         *  \param[in] options Scheduling options.
+         */
+        void prepare(Joblet &job, const JobOptions &options) const;
+
+        /** \brief Check whether a dequeued job should run, and update statistics. Jobs that are canceled or
+         *  past their deadline are abandoned.
+         *  \param[in] job Job that was dequeued.
+         *  \return True if the job should be executed.
+         */
+        bool admit(Joblet &job);
+
+        /** \brief Add a job to the pool according to the scheduling strategy.
+         *  \param[in] job Job to add.
+         */
+        void enqueue(const std::shared_ptr<Joblet> &job) const;
+
+        /** \brief Add multiple references to the same job to the pool, taking each queue lock once.
+         *  \param[in] job Job to add.
+         *  \param[in] copies Number of times to add the job.
+         */
+        void enqueue(const std::shared_ptr<Joblet> &job, std::size_t copies) const;
+
+        /** \brief Get the chunk size for a batch.
+         *  \param[in] size Number of items in the batch.
+         *  \param[in] grain Requested chunk size. If 0, computed from the thread count.
+         *  \return The chunk size to use.
+         */
+        std::size_t getGrain(std::size_t size, std::size_t grain) const;
+
+        /** \brief Get the number of workers that should participate in a batch.
+         *  \param[in] batch The batch.
+         *  \return The number of times to queue the batch.
+         */
+        std::size_t getBatchCopies(const Batch &batch) const;
+
+        /** \brief Wake up a worker, if any are waiting for jobs.
+         */
+        void notify() const;
+
+        /** \brief Retrieve the next job for a worker from the shared queue. Blocks until a job is available.
+         *  \return The next job to execute, or nullptr if the pool is shutting down.
+         */
+        std::shared_ptr<Joblet> dequeueShared();
+
+        /** \brief Retrieve the next job for a worker, first from its own deque and then by stealing from
+         *  other workers' deques. Blocks until a job is available.
+         *  \param[in] index Index of the worker.
+         *  \return The next job to execute, or nullptr if the pool is shutting down.
+         */
+        std::shared_ptr<Joblet> dequeueStealing(unsigned int index);
+
+        /** \brief Attempt to take a job from a lane of a worker's deque.
+         *  \param[in] index Index of the worker to take from.
+         *  \param[in] lane Priority lane to take from.
+         *  \param[in] owner If true, takes from the back of the deque (the owner's end). Otherwise, takes
+         *  from the front.
+         *  \return A job, or nullptr if no job was available.
+         */
+        std::shared_ptr<Joblet> tryTake(unsigned int index, std::size_t lane, bool owner);
+
+        const Scheduler scheduler_;           ///< Scheduling strategy.
+        std::vector<int> cpus_;               ///< CPU of each worker, or -1 if not pinned.
+        std::atomic<bool> active_{false};     ///< Is thread pool active?
         mutable std::mutex mutex_;            ///< Job queue mutex.
         mutable std::condition_variable cv_;  ///< Job queue condition variable.
 
         std::vector<std::thread> threads_;                  ///< Threads.
-        mutable std::queue<std::shared_ptr<Joblet>> jobs_;  ///< Jobs to execute.
+        mutable std::array<std::queue<std::shared_ptr<Joblet>>, PRIORITIES> jobs_;  ///< Jobs to execute per
+                                                                                    ///< lane (shared scheduler).
+
+        mutable std::vector<std::unique_ptr<Worker>> workers_;  ///< Worker deques (stealing scheduler).
+        mutable std::atomic<std::size_t> pending_{0};           ///< Jobs queued in worker deques.
+        mutable std::atomic<std::size_t> sleeping_{0};          ///< Workers waiting for jobs.
+        mutable std::atomic<std::size_t> next_{0};              ///< Round-robin index for external submits.
+
+        mutable std::array<std::atomic<std::size_t>, PRIORITIES> depth_;  ///< Queued jobs per lane.
+        std::atomic<std::size_t> executed_{0};                            ///< Executed jobs.
+        std::atomic<std::size_t> dropped_{0};                             ///< Expired jobs.
+        std::atomic<std::size_t> skipped_{0};                             ///< Canceled jobs.
+        std::atomic<uint64_t> wait_total_{0};                             ///< Total wait in nanoseconds.
+        std::atomic<uint64_t> wait_max_{0};                               ///< Maximum wait in nanoseconds.
     };
 }  // namespace robowflex
 
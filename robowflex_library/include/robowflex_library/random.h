@@ -11,14 +11,41 @@
 namespace robowflex
 {
     /** \brief Collection of methods relating to random sampling
+     *
+     *  Each thread samples from its own random stream, so these functions are thread-safe. A thread's
+     * generator is seeded from the master seed and the thread's stream ID. By default, threads are given
+     * stream IDs in the order they first sample; use setStream() to make sampling across threads
+     * reproducible.
      */
     namespace RNG
     {
-        /** \brief Set the random seed of the underlying generator.
-         *  \param[in] seed Seed to set in generator.
+        /** \brief Set the master random seed. Every thread's generator is reseeded from this seed and its
+         * stream ID before it next samples.
+         *  \param[in] seed Seed to set.
          */
         void setSeed(unsigned int seed);
 
+        /** \brief Get the master random seed.
+         *  \return The master seed.
+         */
+        unsigned int getSeed();
+
+        /** \brief Set the stream ID of the calling thread, and reseed its generator from the master seed and
+         * \a stream.
+         *  \param[in] stream Stream ID to use.
+         */
+        void setStream(std::size_t stream);
+
+        /** \brief Get the stream ID of the calling thread.
+         *  \return The stream ID.
+         */
+        std::size_t getStream();
+
+        /** \brief Get the random generator of the calling thread. Not to be shared with other threads.
+         *  \return The generator.
+         */
+        std::mt19937 &getGenerator();
+
         /** \brief Generate a random real in  [0,1).
          *  \return Sampled number.
          */
@@ -97,6 +124,15 @@ namespace robowflex
          */
         Eigen::Vector3d uniformVec(const Eigen::Vector3d &bounds);
 
+        /** \brief Fill each column of \a samples with a uniform real vector within given bounds:
+         * [\a lbound, \a ubound)
+         *  \param[out] samples Matrix to fill, with one sample per column.
+         *  \param[in] lbound Lower bound vector of uniform distribution, one entry per row of \a samples.
+         *  \param[in] ubound Upper bound vector of uniform distribution, one entry per row of \a samples.
+         */
+        void uniformVec(Eigen::Ref<Eigen::MatrixXd> samples, const Eigen::VectorXd &lbound,
+                        const Eigen::VectorXd &ubound);
+
         /** \brief Generate a random real vector using a normal distribution with given \a mean and \e
          * standard deviation
          *  \param[in] mean Mean vector of the normal distribution.
@@ -112,6 +148,15 @@ namespace robowflex
          */
         Eigen::Vector3d gaussianVec(const Eigen::Vector3d &stddev);
 
+        /** \brief Fill each column of \a samples with a random real vector using a normal distribution with
+         * given \a mean and \e standard deviation.
+         *  \param[out] samples Matrix to fill, with one sample per column.
+         *  \param[in] mean Mean vector of the normal distribution, one entry per row of \a samples.
+         *  \param[in] stddev Standard deviation vector (diagonal covariance), one per row of \a samples.
+         */
+        void gaussianVec(Eigen::Ref<Eigen::MatrixXd> samples, const Eigen::VectorXd &mean,
+                         const Eigen::VectorXd &stddev);
+
         /** \brief Choose a random element between \a start and \a end.
          *  \param[in] start Start iterator.
          *  \param[in] end End iterator.
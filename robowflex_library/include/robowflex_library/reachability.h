@@ -0,0 +1,141 @@
+/* Author: Zachary Kingston */
+
+#ifndef ROBOWFLEX_REACHABILITY_
+#define ROBOWFLEX_REACHABILITY_
+
+#include <array>
+#include <string>
+#include <vector>
+
+#include <robowflex_library/adapter.h>
+#include <robowflex_library/class_forward.h>
+#include <robowflex_library/robot.h>
+
+namespace robowflex
+{
+    /** \cond IGNORE */
+    ROBOWFLEX_CLASS_FORWARD(Pool);
+    ROBOWFLEX_CLASS_FORWARD(ReachabilityMap);
+    /** \endcond */
+
+    /** \class robowflex::ReachabilityMapPtr
+        \brief A shared pointer wrapper for robowflex::ReachabilityMap. */
+
+    /** \class robowflex::ReachabilityMapConstPtr
+        \brief A const shared pointer wrapper for robowflex::ReachabilityMap. */
+
+    /** \brief A precomputed map of where the tip of a group can reach, for quickly rejecting infeasible
+     * pose goals and seeding IK.
+     *
+     *  The workspace is split into voxels. When the map is built, orientations are sampled at the center of
+     * each voxel and solved with Robot::setFromIKBatch(). Attempts and successes are counted per voxel and
+     * per approach direction (the z-axis of the tip), binned on the faces of a cube, and a few solutions are
+     * kept per voxel as seeds. Lookups are constant time. Poses are in the robot's model frame, for the
+     * robot's scratch state at the time the map was built. Maps can be saved to and loaded from HDF5 files.
+     */
+    class ReachabilityMap
+    {
+    public:
+        /** \brief Options for building a map.
+         */
+        struct Options
+        {
+            double resolution{0.05};       ///< Edge length of the voxels.
+            std::size_t orientations{32};  ///< Number of orientations sampled per voxel.
+            std::size_t seeds{4};          ///< Maximum number of solutions stored per voxel.
+            std::size_t batch{4096};       ///< Number of IK queries solved at once.
+        };
+
+        /** \brief Constructor.
+         *  \param[in] robot Robot to build the map for.
+         *  \param[in] group Group whose tip the map is built for. Must have an IK solver.
+         */
+        ReachabilityMap(const RobotConstPtr &robot, const std::string &group);
+
+        /** \brief Build the map over a box of the workspace, replacing any previous contents.
+         *  \param[in] lower Lower corner of the box.
+         *  \param[in] upper Upper corner of the box.
+         *  \param[in] pool Thread pool to solve IK on.
+         *  \param[in] options Options for building.
+         *  \return True on success, false on failure.
+         */
+        bool build(const Eigen::Vector3d &lower, const Eigen::Vector3d &upper, const Pool &pool,
+                   const Options &options);
+
+        /** \brief Build the map over a box of the workspace with the default options. See build().
+         *  \param[in] lower Lower corner of the box.
+         *  \param[in] upper Upper corner of the box.
+         *  \param[in] pool Thread pool to solve IK on.
+         *  \return True on success, false on failure.
+         */
+        bool build(const Eigen::Vector3d &lower, const Eigen::Vector3d &upper, const Pool &pool);
+
+        /** \brief Get the fraction of IK attempts that succeeded near a pose, in the bin of its approach
+         * direction. If no attempts fell in that bin, uses all attempts in the voxel.
+         *  \param[in] pose Pose of the tip to check.
+         *  \return The fraction of successful attempts, or 0 if the pose is outside of the map.
+         */
+        double getDensity(const RobotPose &pose) const;
+
+        /** \brief Checks if a pose is likely reachable, i.e., if its density is above \a threshold.
+         *  \param[in] pose Pose of the tip to check.
+         *  \param[in] threshold Density a pose must exceed.
+         *  \return True if the pose is likely reachable, false otherwise.
+         */
+        bool isLikelyReachable(const RobotPose &pose, double threshold = 0.) const;
+
+        /** \brief Get the stored solutions of the voxel containing a position.
+         *  \param[in] position Position of the tip.
+         *  \param[out] seeds Joint positions of the group that reached into the voxel.
+         *  \return True if there were stored solutions, false otherwise.
+         */
+        bool getSeeds(const Eigen::Vector3d &position, std::vector<std::vector<double>> &seeds) const;
+
+        /** \brief Solves an IK query, first seeding the solver from the stored solutions of the voxel
+         * containing the query's first target. If no seed leads to a solution, the query is solved as is.
+         *  \param[in] query Query to solve.
+         *  \param[in,out] state State to set from IK. Retains its initial value on failure.
+         *  \return True on success, false on failure.
+         */
+        bool setFromIK(const Robot::IKQuery &query, robot_state::RobotState &state) const;
+
+        /** \brief Save the map to an HDF5 file.
+         *  \param[in] filename File to save to.
+         *  \return True on success, false on failure.
+         */
+        bool save(const std::string &filename) const;
+
+        /** \brief Load a map from an HDF5 file saved with save(), replacing the current contents.
+         *  \param[in] filename File to load from.
+         *  \return True on success, false on failure.
+         */
+        bool load(const std::string &filename);
+
+    private:
+        /** \brief Get the index of the voxel containing a position.
+         *  \param[in] position Position to get the voxel of.
+         *  \return The index of the voxel, or -1 if the position is outside of the map.
+         */
+        long getVoxel(const Eigen::Vector3d &position) const;
+
+        /** \brief Get the center of a voxel.
+         *  \param[in] voxel Index of the voxel.
+         *  \return The center of the voxel.
+         */
+        Eigen::Vector3d getCenter(std::size_t voxel) const;
+
+        RobotConstPtr robot_;  ///< Robot of the map.
+        std::string group_;    ///< Group of the map.
+
+        Eigen::Vector3d lower_{Eigen::Vector3d::Zero()};  ///< Lower corner of the map.
+        double resolution_{0.};                           ///< Edge length of the voxels.
+        std::array<int, 3> dims_{{0, 0, 0}};              ///< Number of voxels along each axis.
+
+        std::vector<int> attempts_;               ///< IK attempts per voxel and direction bin.
+        std::vector<int> successes_;              ///< IK successes per voxel and direction bin.
+        std::vector<std::vector<double>> seeds_;  ///< Stored solutions per voxel, concatenated.
+        std::size_t variables_{0};                ///< Number of variables of the group.
+    };
+}  // namespace robowflex
+
+#endif
@@ -6,6 +6,7 @@
 #include <string>  // for std::string
 #include <vector>  // for std::vector
 #include <map>     // for std::map
+#include <mutex>   // for std::mutex
 
 #include <Eigen/Core>
 #include <Eigen/Geometry>
@@ -26,6 +27,7 @@
 
 #include <robowflex_library/class_forward.h>
 #include <robowflex_library/adapter.h>
+#include <robowflex_library/batch_fk.h>
 #include <robowflex_library/constants.h>
 #include <robowflex_library/io/handler.h>
 
@@ -34,6 +36,8 @@ namespace robowflex
     /** \cond IGNORE */
     ROBOWFLEX_CLASS_FORWARD(Scene);
     ROBOWFLEX_CLASS_FORWARD(Geometry);
+    ROBOWFLEX_CLASS_FORWARD(Pool);
+    ROBOWFLEX_CLASS_FORWARD(IKCache);
     /** \endcond */
 
     /** \cond IGNORE */
@@ -176,6 +180,16 @@ namespace robowflex
          */
         void setKinematicsPostProcessFunction(const PostProcessYAMLFunction &function);
 
+        /** \brief Cache the processed robot description on disk, so later initializations with the same
+         * files skip .xacro expansion, post-processing, and the second model load after post-processing.
+         * Used by initialize() with a URDF and SRDF. Entries are keyed by the input file paths and \a tag,
+         * and are only used if the contents of the inputs and every file they include are unchanged.
+         * Post-process functions cannot be hashed, so \a tag must change whenever they do.
+         *  \param[in] directory Directory to store cache entries in. If empty, disables the cache.
+         *  \param[in] tag Tag identifying the post-process functions in use.
+         */
+        void setModelCache(const std::string &directory, const std::string &tag = "");
+
         /** \brief Adds a planar virtual joint through the SRDF to the loaded robot with name \a name. This
          * joint will have three degrees of freedom: <name>/x, <name>/y, and <name>/theta. Will apply this
          * joint between the world and the root frame.
@@ -198,6 +212,19 @@ namespace robowflex
          */
         bool loadKinematics(const std::string &group, bool load_subgroups = true);
 
+        /** \brief Creates a lightweight view of this robot, which shares the loaded robot model, URDF and
+         * SRDF, and kinematics solver allocators, but has its own scratch state and IO handler namespace
+         * \a name. The description and YAML files loaded through this robot are copied to the view's
+         * namespace, so planners can be created against the view. Useful for running many planners or
+         * robots in one process without reloading the model for each.
+         *
+         *  The shared model must be treated as immutable: loading kinematics through any view affects all
+         * of them, and the view cannot be re-initialized. The robot must be initialized first.
+         *  \param[in] name The name of the view. Used to namespace information under.
+         *  \return The view, or nullptr if this robot is not initialized.
+         */
+        RobotPtr makeView(const std::string &name) const;
+
         /** \} */
 
         /** \name Getters and Setters
@@ -278,6 +305,83 @@ namespace robowflex
          */
         robot_model::RobotStatePtr allocState() const;
 
+        /** \brief A robot state borrowed from a pool of states kept by each thread, which returns the state
+         * to the pool of the thread that destroys it. Use leases for short-lived states on hot paths,
+         * instead of allocating position and transform buffers for each call. States given to other owners
+         * (e.g., shared through get()) are not returned to the pool.
+         */
+        class StateLease
+        {
+        public:
+            /** \brief Constructor. Empty lease.
+             */
+            StateLease() = default;
+
+            /** \brief Constructor. Leases a state of \a model. The contents of the state are those left by
+             * its previous lease, without any attached bodies.
+             *  \param[in] model Robot model of the state.
+             */
+            explicit StateLease(const robot_model::RobotModelConstPtr &model);
+
+            /** \brief Destructor. Returns the state to the pool.
+             */
+            ~StateLease();
+
+            // non-copyable
+            StateLease(StateLease const &) = delete;
+            void operator=(StateLease const &) = delete;
+
+            /** \brief Move constructor.
+             *  \param[in] other Lease to take the state of.
+             */
+            StateLease(StateLease &&other) noexcept;
+
+            /** \brief Move assignment. Returns the current state, if any.
+             *  \param[in] other Lease to take the state of.
+             *  \return This lease.
+             */
+            StateLease &operator=(StateLease &&other) noexcept;
+
+            /** \brief Get the leased state.
+             *  \return The state.
+             */
+            robot_state::RobotState &operator*() const;
+
+            /** \brief Get the leased state.
+             *  \return The state.
+             */
+            robot_state::RobotState *operator->() const;
+
+            /** \brief Get the leased state as a shared pointer.
+             *  \return The state.
+             */
+            const robot_state::RobotStatePtr &get() const;
+
+            /** \brief Returns true if the lease holds a state.
+             *  \return True if the lease holds a state.
+             */
+            explicit operator bool() const;
+
+            /** \brief Return the state to the pool of the calling thread, emptying the lease.
+             */
+            void release();
+
+        private:
+            robot_state::RobotStatePtr state_;  ///< Leased state.
+        };
+
+        /** \brief Lease a state from the pool of the calling thread, set to default values. See
+         * allocState().
+         *  \return The leased state.
+         */
+        StateLease leaseState() const;
+
+        /** \brief Lease a state from the pool of the calling thread, set to the current scratch state. See
+         * cloneScratchState().
+         *  \return The leased state.
+         */
+        StateLease leaseScratchState() const;
+
         /** \brief Sets the scratch state from a vector of joint positions (all must be specified)
          *  \param[in] positions Joint positions to set.
          */
@@ -305,7 +409,8 @@ namespace robowflex
          */
         void setState(const moveit_msgs::RobotState &state);
 
-        /** \brief Sets the scratch state from a robot state message saved to a YAML file.
+        /** \brief Sets the scratch state from a robot state message saved to a YAML file, or a binary
+         * file if \a file has a `.bin` extension.
          *  \param[in] file The YAML file to load.
          */
         void setStateFromYAMLFile(const std::string &file);
@@ -357,6 +462,20 @@ namespace robowflex
          */
         const RobotPose getRelativeLinkTF(const std::string &base, const std::string &target) const;
 
+        /** \brief Compute the poses of links for many configurations of a group at once, with the rest of
+         * the robot at the scratch state. To reuse the precomputed kinematic chains across calls, use a
+         * robowflex::BatchFK directly.
+         *  \param[in] group Group whose configurations are given.
+         *  \param[in] positions Configurations of the group, one per row, in the order of the group's
+         * variables.
+         *  \param[in] links Links to compute poses of.
+         *  \param[out] transforms Transforms of each link, one row per configuration (see
+         * BatchFK::Transforms).
+         */
+        void getLinkTFs(const std::string &group, const Eigen::Ref<const Eigen::MatrixXd> &positions,
+                        const std::vector<std::string> &links,
+                        std::vector<BatchFK::Transforms> &transforms) const;
+
         /** \} */
 
         /** \name Inverse Kinematics
@@ -411,12 +530,19 @@ namespace robowflex
                                         ///< validity reported by the solver.
             double valid_distance{0.};  ///< If positive and validate = true, will return success if result is
                                         ///< within distance of kinematic constraint set.
+            bool group_collision{false};  ///< If true, only collision check the links moved by the group,
+                                          ///< as in Scene::checkGroupCollision(). The rest of the state
+                                          ///< must be known to be collision free.
 
             std::vector<Metric> metrics;  ///< Metrics used to evaluate configurations. If metrics are added,
                                           ///< solver will use all allotted resources to search for the best
                                           ///< configuration. If there are multiple metrics, metric values
                                           ///< will be added together.
 
+            std::size_t solutions{0};  ///< For parallel IK with metrics, stop after this many valid
+                                       ///< solutions. If 0, all attempts are used.
+            unsigned int seed{0};      ///< Seed for random restarts in parallel IK.
+
             /** \} */
 
             /** \brief Constructor. Empty for fine control.
@@ -641,6 +767,14 @@ namespace robowflex
              */
             bool sampleRegions(RobotPoseVector &poses) const;
 
+            /** \brief Sample \a count sets of desired end-effector poses for each region. Orientations are
+             * sampled in batch.
+             *  \param[out] poses The sampled poses, one set per sample.
+             *  \param[in] count Number of sets of poses to sample.
+             *  \return True if every region was sampled successfully, false otherwise.
+             */
+            bool sampleRegions(std::vector<RobotPoseVector> &poses, std::size_t count) const;
+
             /** \} */
 
             /** \name Other Functions
@@ -653,7 +787,10 @@ namespace robowflex
              */
             void getMessage(const std::string &base_frame, moveit_msgs::Constraints &msg) const;
 
-            /** \brief Get this IK query as a kinematic constraint set.
+            /** \brief Get this IK query as a kinematic constraint set. The set is cached, and shared with
+             * copies of this query. It is rebuilt only if the robot, tips, regions, region poses,
+             * orientations, or tolerances of the query have changed since it was built. Regions are compared
+             * by pointer.
              *  \param[in] robot Robot this IK query is for.
              *  \return The IK query as a set of kinematic constraints.
              */
@@ -668,6 +805,23 @@ namespace robowflex
                                   const kinematic_constraints::ConstraintEvaluationResult &result) const;
 
             /** \} */
+
+        private:
+            /** \brief The constraint set last built by getAsConstraints(), and the targets it was built for.
+             */
+            struct ConstraintCache
+            {
+                std::mutex mutex;                                              ///< Cache mutex.
+                robot_model::RobotModelConstPtr model;                         ///< Robot model of the set.
+                std::vector<std::string> tips;                                 ///< Tips of the set.
+                std::vector<GeometryConstPtr> regions;                         ///< Regions of the set.
+                RobotPoseVector region_poses;                                  ///< Region poses of the set.
+                std::vector<Eigen::Quaterniond> orientations;                  ///< Orientations of the set.
+                EigenSTL::vector_Vector3d tolerances;                          ///< Tolerances of the set.
+                kinematic_constraints::KinematicConstraintSetPtr constraints;  ///< Cached set.
+            };
+
+            std::shared_ptr<ConstraintCache> cache_{std::make_shared<ConstraintCache>()};  ///< Cache.
         };
 
         /** \brief Sets a group of the scratch state from an IK query. If the IK query fails the scratch state
@@ -685,6 +839,37 @@ namespace robowflex
          */
         bool setFromIK(const IKQuery &query, robot_state::RobotState &state) const;
 
+        /** \brief Sets a robot state from an IK query, running the query's attempts in parallel on \a pool.
+         *  Each attempt solves from its own copy of \a state, or from random positions seeded by
+         *  IKQuery::seed and the attempt index if IKQuery::random_restart is set. Region targets for all
+         *  attempts are sampled up front on the calling thread. Without metrics, attempts stop once a valid
+         *  solution is found; with metrics, once IKQuery::solutions valid solutions are found. The solution
+         *  returned is always the one the lowest-indexed attempts produced, so results do not depend on
+         *  scheduling. Requires a thread-safe kinematics solver. If the IK query fails, \a state retains its
+         *  initial value.
+         *  \param[in] query Query for inverse kinematics. See Robot::IKQuery documentation for more.
+         *  \param[out] state Robot state to set from IK.
+         *  \param[in] pool Thread pool to run attempts on.
+         *  \return True on success, false on failure.
+         */
+        bool setFromIK(const IKQuery &query, robot_state::RobotState &state, const Pool &pool) const;
+
+        /** \brief Solves many IK queries in parallel on \a pool.
+         *  Queries are split into contiguous chunks, one per thread of \a pool plus the calling thread.
+         *  Within a chunk, queries are solved in order, each seeded from the previous solution whose target
+         *  is nearest to its own. Tip frames, group lookups, and scene validity callbacks are shared between
+         *  queries. Region targets are sampled up front on the calling thread, and random restarts are
+         *  seeded by IKQuery::seed. Requires a thread-safe kinematics solver.
+         *  \param[in] queries Queries for inverse kinematics. See Robot::IKQuery documentation for more.
+         *  \param[in,out] states Solutions, one per query. Resized to the number of queries. A state
+         *  present on input seeds its query instead of a previous solution. Failed queries are set to
+         *  nullptr.
+         *  \param[in] pool Thread pool to solve queries on.
+         *  \return The number of queries solved.
+         */
+        std::size_t setFromIKBatch(const std::vector<IKQuery> &queries,
+                                   std::vector<robot_state::RobotStatePtr> &states, const Pool &pool) const;
+
         /** \brief Validates that a state satisfies an IK query's request poses.
          *  \param[in] query The query to validate.
          *  \param[in] state The state to validate against the query.
@@ -711,12 +896,25 @@ namespace robowflex
          */
         std::string getSolverBaseFrame(const std::string &group) const;
 
+        /** \brief Set a cache of IK solutions to use in setFromIK() and setFromIKBatch(). Before solving, a
+         * query's cached solutions are validated against it, and a valid one is used directly. Otherwise,
+         * the most recent cached solution seeds the solver. New solutions are added to the cache.
+         *  \param[in] cache Cache to use. If nullptr, caching is disabled.
+         */
+        void setIKCache(const IKCachePtr &cache);
+
+        /** \brief Get the cache of IK solutions, if one is set.
+         *  \return The IK cache, or nullptr if none is set.
+         */
+        const IKCachePtr &getIKCache() const;
+
         /** \} */
 
         /** \name IO
             \{ */
 
-        /** \brief Dumps the current configuration of the robot as a YAML file.
+        /** \brief Dumps the current configuration of the robot as a YAML file. Files with a `.bin`
+         * extension use the binary format of IO::messageToBinaryFile() instead.
          *  \param[in] file File to write to.
          *  \return True on success, false on failure.
          */
@@ -734,7 +932,8 @@ namespace robowflex
          */
         bool dumpTransforms(const std::string &filename) const;
 
-        /** \brief Dumps the tranforms of all links of a robot through a robot trajectory to a file.
+        /** \brief Dumps the tranforms of all links of a robot through a robot trajectory to a file. Files
+         * with a `.bin` extension use a compact binary format instead of YAML (see the overload below).
          *  \param[in] path Path to output.
          *  \param[in] filename Filename to output to.
          *  \param[in] fps The transforms (frames) per second used to interpolate the given path.
@@ -744,6 +943,26 @@ namespace robowflex
         bool dumpPathTransforms(const robot_trajectory::RobotTrajectory &path, const std::string &filename,
                                 double fps = 30, double threshold = 0.0) const;
 
+        /** \brief Dumps the tranforms of all links of a robot through a robot trajectory to a binary file,
+         * computing frames in parallel. The file holds, in little-endian order:
+         *  - the magic `RBXT`, a uint32 version, uint32 number of frames, uint32 number of links, and the
+         *    float64 fps,
+         *  - the name of each link, as a uint32 length followed by its characters,
+         *  - a float32 array of the time in seconds since the previous frame, one per frame,
+         *  - a float32 array of shape frames x links x 7 of the global pose of every link in every frame,
+         *    as `x y z qx qy qz qw`.
+         *
+         *  The arrays can be loaded directly as NumPy arrays, e.g., by `robowflex_visualization`.
+         *  \param[in] path Path to output.
+         *  \param[in] filename Filename to output to.
+         *  \param[in] pool Pool to compute frames on.
+         *  \param[in] fps The transforms (frames) per second used to interpolate the given path.
+         *  \param[in] threshold The minimum distance between states before transforms are output.
+         *  \return True on success, false on failure.
+         */
+        bool dumpPathTransforms(const robot_trajectory::RobotTrajectory &path, const std::string &filename,
+                                const Pool &pool, double fps = 30, double threshold = 0.0) const;
+
         /** \brief Dumps the current scratch configuration of the robot to a YAML file compatible with a
          * scene.
          *  \param[in] filename Filename to output to.
@@ -780,6 +999,38 @@ namespace robowflex
          */
         void loadRobotModel(const std::string &description);
 
+        /** \brief Applies the joint limits in the in-process parameters of the handler to the model, as the
+         * robot model loader does from the ROS master.
+         */
+        void loadInProcessJointLimits();
+
+        /** \brief Creates kinematics solver allocators from the in-process parameters of the handler, for
+         * each group with a kinematics solver.
+         *  \param[out] groups Groups with a kinematics solver.
+         *  \param[out] timeout Default IK timeout of each group.
+         *  \param[out] allocators Solver allocator of each group.
+         */
+        void loadInProcessKinematics(std::vector<std::string> &groups, std::map<std::string, double> &timeout,
+                                     std::map<std::string, robot_model::SolverAllocatorFn> &allocators);
+
+        /** \brief Get the model cache entry for a set of input files.
+         *  \param[in] files Input files. Empty names are ignored.
+         *  \return The filename of the cache entry.
+         */
+        std::string getModelCacheFile(const std::vector<std::string> &files) const;
+
+        /** \brief Load the processed URDF, SRDF, and YAML files from a model cache entry, if it is current.
+         *  \param[in] entry Cache entry to load.
+         *  \return True if the entry was loaded, false if it does not exist or is stale.
+         */
+        bool loadModelCache(const std::string &entry);
+
+        /** \brief Save the processed URDF, SRDF, and loaded YAML files to a model cache entry.
+         *  \param[in] entry Cache entry to save.
+         *  \param[in] files Input files the entry was built from. Empty names are ignored.
+         */
+        void saveModelCache(const std::string &entry, const std::vector<std::string> &files) const;
+
         /** \brief Updates a loaded XML string based on an XML post-process function. Called after initial,
          * unmodified robot is loaded.
          *  \param[in,out] string Input XML string.
@@ -789,6 +1040,16 @@ namespace robowflex
 
         /** \} */
 
+        /** \brief Check the IK cache for a query.
+         *  \param[in] query Query to check. Tips must be filled in.
+         *  \param[in,out] state If a cached solution satisfies \a query, set to that solution. Otherwise, if
+         *  \a seed is true, set to the most recent cached solution.
+         *  \param[in] seed Whether to seed \a state if no cached solution satisfies \a query.
+         *  \return True if a cached solution satisfies \a query, false otherwise. Always false for queries
+         *  with metrics, as their solutions must be searched for.
+         */
+        bool checkIKCache(const IKQuery &query, robot_state::RobotState &state, bool seed) const;
+
         const std::string name_;  ///< Robot name.
         IO::Handler handler_;     ///< IO handler (namespaced with \a name_)
 
@@ -800,12 +1061,21 @@ namespace robowflex
         PostProcessYAMLFunction limits_function_;      ///< Limits YAML post-processing function.
         PostProcessYAMLFunction kinematics_function_;  ///< Kinematics plugin YAML post-processing function.
 
+        std::string cache_directory_;             ///< Directory of the model cache, empty if disabled.
+        std::string cache_tag_;                   ///< Tag of the post-process functions for the model cache.
+        bool processed_{false};                   ///< If true, the URDF and SRDF are already post-processed.
+        std::map<std::string, YAML::Node> yaml_;  ///< Processed YAML files loaded, by parameter name.
+
         std::shared_ptr<robot_model_loader::RobotModelLoader> loader_;    ///< Robot model loader.
         robot_model::RobotModelPtr model_;                                ///< Loaded robot model.
         std::map<std::string, robot_model::SolverAllocatorFn> imap_;      ///< Kinematic solver allocator map.
         kinematics_plugin_loader::KinematicsPluginLoaderPtr kinematics_;  ///< Kinematic plugin loader.
 
+        /** \brief Kinematic plugin loaders of each group, if loaded from in-process parameters. */
+        std::map<std::string, kinematics_plugin_loader::KinematicsPluginLoaderPtr> group_kinematics_;
+
         robot_state::RobotStatePtr scratch_;  ///< Scratch robot state.
+        IKCachePtr ik_cache_;                 ///< Cache of IK solutions, if set.
     };
 
     /** \cond IGNORE */
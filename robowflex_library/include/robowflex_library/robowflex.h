@@ -18,6 +18,7 @@ namespace robowflex
 #include <robowflex_library/yaml.h>
 
 #include <robowflex_library/io.h>
+#include <robowflex_library/io/archive.h>
 #include <robowflex_library/io/bag.h>
 #include <robowflex_library/io/handler.h>
 #include <robowflex_library/io/visualization.h>
@@ -28,10 +29,18 @@ namespace robowflex
 #include <robowflex_library/geometry.h>
 #include <robowflex_library/tf.h>
 #include <robowflex_library/scene.h>
+#include <robowflex_library/distance_field.h>
+#include <robowflex_library/sphere_model.h>
 #include <robowflex_library/robot.h>
+#include <robowflex_library/ik_cache.h>
 #include <robowflex_library/planning.h>
 #include <robowflex_library/builder.h>
+#include <robowflex_library/allocation.h>
 #include <robowflex_library/benchmarking.h>
+#include <robowflex_library/ik_benchmarking.h>
+#include <robowflex_library/dataset.h>
+#include <robowflex_library/generator.h>
+#include <robowflex_library/comparison.h>
 #include <robowflex_library/openrave.h>
 #include <robowflex_library/path.h>
 
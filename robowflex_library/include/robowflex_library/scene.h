@@ -3,12 +3,18 @@
 #ifndef ROBOWFLEX_SCENE_
 #define ROBOWFLEX_SCENE_
 
+#include <deque>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include <Eigen/Core>
 #include <Eigen/Geometry>
 
 #include <moveit_msgs/PlanningScene.h>
+#include <sensor_msgs/PointCloud2.h>
+
+#include <octomap/OcTree.h>
 
 #include <moveit/collision_detection/collision_matrix.h>  // for collision_detection::AllowedCollisionMatrix
 #include <moveit/planning_scene/planning_scene.h>         // for planning_scene::PlanningScene
@@ -23,10 +29,14 @@ namespace robowflex
     /** \cond IGNORE */
     ROBOWFLEX_CLASS_FORWARD(Robot);
     ROBOWFLEX_CLASS_FORWARD(Geometry);
+    ROBOWFLEX_CLASS_FORWARD(Pool);
+    ROBOWFLEX_CLASS_FORWARD(DistanceField);
+    ROBOWFLEX_CLASS_FORWARD(SphereModel);
     /** \endcond */
 
     /** \cond IGNORE */
     ROBOWFLEX_CLASS_FORWARD(Scene);
+    ROBOWFLEX_CLASS_FORWARD(StateValidityChecker);
     /** \endcond */
 
     /** \class robowflex::ScenePtr
@@ -72,6 +82,76 @@ namespace robowflex
          */
         ScenePtr deepCopy() const;
 
+        /** \brief Create a copy-on-write snapshot of this scene, using _MoveIt!_'s PlanningScene::diff().
+         *  The snapshot shares this scene's collision world, robot state, and allowed collision matrix until
+         * it changes them, so creating one does not copy any geometry. Changes made to the snapshot (e.g.,
+         * moveObjectLocal(), attachObject()) only affect the snapshot. Many snapshots of one scene can be
+         * changed and used concurrently, but this scene must not be changed while its snapshots are in use.
+         *  \return The snapshot.
+         */
+        ScenePtr snapshot() const;
+
+        /** \brief Check if this scene is a snapshot of another scene and still depends on it.
+         *  \return True if this scene is a snapshot, false otherwise.
+         */
+        bool isSnapshot() const;
+
+        /** \brief Get the changes this snapshot has made to its parent scene.
+         *  \return The planning scene diff message. Empty if this scene is not a snapshot.
+         */
+        moveit_msgs::PlanningScene getSnapshotDiff() const;
+
+        /** \brief Make this snapshot independent of its parent scene, copying everything it still shares.
+         * Afterwards, the parent may be changed freely. Does nothing if this scene is not a snapshot.
+         */
+        void decoupleSnapshot();
+
+        /** \name Change Tracking
+            \{ */
+
+        /** \brief A change made to the scene, as recorded in the scene's change log.
+         */
+        struct Change
+        {
+            /** \brief Type of change.
+             */
+            enum Type
+            {
+                ADDED,     ///< A collision object was added.
+                REMOVED,   ///< A collision object was removed.
+                MOVED,     ///< A collision object was moved.
+                ATTACHED,  ///< An object was attached to a robot state.
+                DETACHED,  ///< An object was detached from a robot state.
+                STATE,     ///< The current robot state was accessed for modification.
+                ACM        ///< The allowed collision matrix was accessed for modification.
+            };
+
+            Type type;            ///< Type of change.
+            std::string name;     ///< Name of the object changed, if any.
+            std::size_t version;  ///< Version of the scene after the change.
+        };
+
+        /** \brief Get the changes made to the scene after a version of this scene, so consumers can update
+         * incrementally rather than rebuilding. Changes that cannot be described as a Change (e.g., using a
+         * message, or accessing the planning scene directly) clear the log.
+         *  \param[in] version Version of this scene to get changes since, e.g., from getVersion().
+         *  \param[out] changes Changes since \a version, oldest first.
+         *  \return True if the log covers all changes since \a version, false if the consumer must rebuild.
+         */
+        bool getChanges(std::size_t version, std::vector<Change> &changes) const;
+
+        /** \brief Get a diff message with only the parts of the scene changed after a version of this scene,
+         * e.g., to send to a display that already has that version. Changed objects are re-sent whole or
+         * removed, and the robot state and allowed collision matrix are only included if they changed.
+         *  \param[in] version Version of this scene to get the diff since.
+         *  \param[out] msg Diff message to fill.
+         *  \return True if \a msg describes all changes since \a version, false if the full message must be
+         * used instead (see getChanges()).
+         */
+        bool getDiffMessage(std::size_t version, moveit_msgs::PlanningScene &msg) const;
+
+        /** \} */
+
         /** \name Getters and Setters
             \{ */
 
@@ -85,11 +165,30 @@ namespace robowflex
          */
         planning_scene::PlanningScenePtr &getScene();
 
-        /** \brief Get the message that describes the current planning scene.
+        /** \brief Get the message that describes the current planning scene. The message is cached for each
+         * version of the scene, so repeated calls on an unchanged scene only copy it.
          *  \return The planning scene message.
          */
         moveit_msgs::PlanningScene getMessage() const;
 
+        /** \brief Get the cached message that describes the current planning scene, without copying it. The
+         * message is shared with other callers and stays valid, but out of date, after the scene changes.
+         *  \return The planning scene message.
+         */
+        std::shared_ptr<const moveit_msgs::PlanningScene> getMessageConst() const;
+
+        /** \brief Get the serialization of the message that describes the current planning scene, cached
+         * for each version of the scene like the message.
+         *  \return The serialized planning scene message.
+         */
+        std::shared_ptr<const std::vector<uint8_t>> getSerializedMessage() const;
+
+        /** \brief Get a hash of the contents of the message that describes the current planning scene, as
+         * IO::getMessageHash() would compute, cached for each version of the scene like the message.
+         *  \return The hash of the planning scene message.
+         */
+        std::string getMessageHash() const;
+
         /** \brief Get a reference to the current robot state in the planning scene.
          *  \return The planning scene robot.
          */
@@ -118,6 +217,64 @@ namespace robowflex
 
         /** \} */
 
+        /** \name Octomap Integration
+            \{ */
+
+        /** \brief Options for integrating point clouds into the scene's octomap.
+         */
+        struct PointCloudOptions
+        {
+            double resolution{0.02};  ///< Resolution of the octomap, if the scene does not have one yet.
+            double voxel{0.};         ///< Edge length of the downsampling grid. If 0, the octomap resolution.
+            double max_range{-1.};    ///< Maximum range of rays, or negative if unlimited. Further points
+                                      ///< only clear space.
+            std::size_t batch{1024};  ///< Number of rays cast by a thread at once.
+            unsigned int threads{0};  ///< Number of threads to cast rays on. If 0, uses all available.
+        };
+
+        /** \brief Integrate a point cloud into the scene's octomap, creating the octomap if needed.
+         *  The cloud is downsampled to the centroids of a voxel grid, then a ray is cast from \a origin to
+         * each point, batches of rays on separate threads. Cells along rays are updated as free, and cells
+         * at endpoints as occupied, in one pass over the octree. Only the octomap object of the collision
+         * world is replaced, and the octree is updated in place unless another scene (e.g., a snapshot)
+         * shares it, in which case it is copied first.
+         *  \param[in] points Points of the cloud, in the frame of the scene's octomap (the planning frame).
+         *  \param[in] origin Origin of the sensor, in the same frame.
+         *  \param[in] options Options for integration.
+         *  \return True on success, false on failure.
+         */
+        bool integratePointCloud(const Eigen::Ref<const Eigen::Matrix3Xd> &points,
+                                 const Eigen::Vector3d &origin, const PointCloudOptions &options);
+
+        /** \brief Integrate a point cloud into the scene's octomap with the default options. See
+         * integratePointCloud().
+         *  \param[in] points Points of the cloud, in the frame of the scene's octomap (the planning frame).
+         *  \param[in] origin Origin of the sensor, in the same frame.
+         *  \return True on success, false on failure.
+         */
+        bool integratePointCloud(const Eigen::Ref<const Eigen::Matrix3Xd> &points,
+                                 const Eigen::Vector3d &origin);
+
+        /** \brief Integrate a point cloud message into the scene's octomap, creating the octomap if needed.
+         *  Points that are not finite are skipped. See integratePointCloud().
+         *  \param[in] cloud Cloud with \a x, \a y, and \a z float fields, in the sensor's frame.
+         *  \param[in] sensor Pose of the sensor in the frame of the scene's octomap (the planning frame).
+         *  \param[in] options Options for integration.
+         *  \return True on success, false on failure.
+         */
+        bool integratePointCloud(const sensor_msgs::PointCloud2 &cloud, const RobotPose &sensor,
+                                 const PointCloudOptions &options);
+
+        /** \brief Integrate a point cloud message into the scene's octomap with the default options. See
+         * integratePointCloud().
+         *  \param[in] cloud Cloud with \a x, \a y, and \a z float fields, in the sensor's frame.
+         *  \param[in] sensor Pose of the sensor in the frame of the scene's octomap (the planning frame).
+         *  \return True on success, false on failure.
+         */
+        bool integratePointCloud(const sensor_msgs::PointCloud2 &cloud, const RobotPose &sensor);
+
+        /** \} */
+
         /** \name Collision Object Management
             \{ */
 
@@ -206,6 +363,38 @@ namespace robowflex
          */
         bool setCollisionDetector(const std::string &detector_name) const;
 
+        /** \brief Get the names of the collision detector plugins that can be used with
+         * setCollisionDetector().
+         *  \return The names of the declared collision detector plugins.
+         */
+        std::vector<std::string> getCollisionDetectors() const;
+
+        /** \brief Timing of a collision detector, measured by benchmarkCollisionDetectors().
+         */
+        struct DetectorTiming
+        {
+            std::string detector;          ///< Name of the collision detector.
+            std::vector<double> check;     ///< Percentiles of checkCollision() time, in seconds.
+            std::vector<double> distance;  ///< Percentiles of distanceToCollision() time, in seconds.
+            double total;                  ///< Total time of all queries, in seconds.
+        };
+
+        /** \brief Time collision checking and distance queries of a fixed set of random states against
+         * each collision detector. States are sampled from the master seed (see RNG::getSeed()), so every
+         * detector sees the same states. Afterwards, the scene's collision detector is restored, unless
+         * \a select is true, in which case the detector with the lowest total time is used.
+         *  \param[in] n_states Number of random states to query.
+         *  \param[in] percentiles Percentiles to report, in [0, 1].
+         *  \param[in] select If true, use the fastest detector.
+         *  \param[in] detectors Detectors to benchmark. If empty, uses getCollisionDetectors().
+         *  \return The timing of each detector that could be loaded.
+         */
+        std::vector<DetectorTiming>
+        benchmarkCollisionDetectors(std::size_t n_states = 1000,
+                                    const std::vector<double> &percentiles = {0.5, 0.9, 0.99},
+                                    bool select = false,
+                                    const std::vector<std::string> &detectors = {}) const;
+
         /** \brief Attach the named collision object \a name to the default end-effector of the given robot \a
          *  state. Only works if there is one end-effector in the system. Uses all end-effector links as
          *  allowed touch links.
@@ -264,6 +453,64 @@ namespace robowflex
 
         /** \} */
 
+        /** \name Spatial Queries
+            \{ */
+
+        /** \brief Get the axis-aligned bounding box of a collision object, over all of its shapes.
+         *  \param[in] name Name of the object.
+         *  \return The bounding box. Empty if the object does not exist.
+         */
+        Eigen::AlignedBox3d getObjectAABB(const std::string &name) const;
+
+        /** \brief Get the collision objects whose bounding boxes intersect a box. Queries use a bounding
+         * volume hierarchy over the objects' bounding boxes, which is built lazily and updated from the
+         * change log when the scene changes.
+         *  \param[in] box Box in the planning frame.
+         *  \return The names of the objects.
+         */
+        std::vector<std::string> getObjectsInBox(const Eigen::AlignedBox3d &box) const;
+
+        /** \brief Get the collision objects whose bounding boxes are within a distance of a point.
+         *  \param[in] center Point in the planning frame.
+         *  \param[in] radius Distance from the point.
+         *  \return The names of the objects.
+         */
+        std::vector<std::string> getObjectsInRadius(const Eigen::Vector3d &center, double radius) const;
+
+        /** \brief Get the collision objects whose bounding boxes are within a distance of the bounding box of
+         * a robot link's collision geometry.
+         *  \param[in] state State of the robot. Link transforms must be up to date.
+         *  \param[in] link Name of the link.
+         *  \param[in] radius Distance from the link.
+         *  \return The names of the objects. Empty if the link has no collision geometry.
+         */
+        std::vector<std::string> getObjectsNearLink(const robot_state::RobotState &state,
+                                                    const std::string &link, double radius) const;
+
+        /** \brief Create a snapshot() of this scene that only contains the collision objects whose bounding
+         * boxes intersect a box. Useful to prune collision checking to a region of interest.
+         *  \param[in] box Box in the planning frame.
+         *  \return The cropped snapshot.
+         */
+        ScenePtr crop(const Eigen::AlignedBox3d &box) const;
+
+        /** \brief Create a snapshot() of this scene that only contains the collision objects whose bounding
+         * boxes intersect a request's workspace bounds.
+         *  \param[in] workspace Workspace bounds. An empty frame is taken as the planning frame.
+         *  \param[in] padding Distance to grow the workspace bounds by.
+         *  \return The cropped snapshot.
+         */
+        ScenePtr cropToWorkspace(const moveit_msgs::WorkspaceParameters &workspace,
+                                 double padding = 0.) const;
+
+        /** \brief Create a snapshot() of this scene that only contains the given collision objects.
+         *  \param[in] objects Names of the objects to keep.
+         *  \return The cropped snapshot.
+         */
+        ScenePtr cropToObjects(const std::vector<std::string> &objects) const;
+
+        /** \} */
+
         /** \name Checking Collisions
             \{ */
 
@@ -276,12 +523,66 @@ namespace robowflex
         checkCollision(const robot_state::RobotState &state,
                        const collision_detection::CollisionRequest &request = {}) const;
 
+        /** \brief Check if the links moved by a group are in collision, against the world and against the
+         * rest of the robot. Collisions between links that the group does not move are not checked. Pairs of
+         * moved links that are rigidly connected, and so are either always or never in collision, are
+         * skipped if they are not in collision in the default state (see getGroupACM()).
+         *  \param[in] state State to check for collision.
+         *  \param[in] group Group whose moved links are checked.
+         *  \param[in] request Optional request parameters for collision checking.
+         *  \return The collision result.
+         */
+        collision_detection::CollisionResult
+        checkGroupCollision(const robot_state::RobotState &state, const std::string &group,
+                            const collision_detection::CollisionRequest &request = {}) const;
+
+        /** \brief Get the allowed collision matrix used by checkGroupCollision(). This is the scene's allowed
+         * collision matrix, plus the pairs of links moved by \a group that are rigidly connected and not in
+         * collision in the default state. These pairs are computed once per group; the matrix is rebuilt
+         * when the scene changes.
+         *  \param[in] group Group to get the matrix for.
+         *  \return The allowed collision matrix.
+         */
+        std::shared_ptr<const collision_detection::AllowedCollisionMatrix>
+        getGroupACM(const std::string &group) const;
+
         /** \brief Get the distance to collision for a robot state.
          *  \param[in] state State to get distance to collision for.
          *  \return The distance of the state to collision.
          */
         double distanceToCollision(const robot_state::RobotState &state) const;
 
+        /** \brief Use a signed distance field of the scene's collision objects for clearance queries made
+         * through getClearance(). The field is built lazily, and rebuilt whenever the scene changes.
+         *  \param[in] resolution Voxel size of the field. If zero, disables the field.
+         *  \param[in] max_distance Maximum distance computed by the field.
+         */
+        void useDistanceField(double resolution, double max_distance = 0.5);
+
+        /** \brief Get the signed distance field for the current version of the scene, building it if
+         * needed.
+         *  \return The distance field, or nullptr if not enabled with useDistanceField().
+         */
+        DistanceFieldConstPtr getDistanceField() const;
+
+        /** \brief Get the clearance of a robot state from collision. If a distance field is enabled with
+         * useDistanceField(), uses the field's approximation of the robot, or the spheres of the sphere
+         * model if one is set with useSphereModel() (see SphereModel::getDistance()). Otherwise, uses
+         * distanceToCollision().
+         *  \param[in] state State to get clearance for.
+         *  \return The clearance of the state.
+         */
+        double getClearance(const robot_state::RobotState &state) const;
+
+        /** \brief Get the clearance of many robot states from collision in parallel, as in getClearance().
+         * The distance field is fetched once for all states.
+         *  \param[in] states States to get clearance for. Collision body transforms must be up to date.
+         *  \param[in] pool Thread pool to run queries on.
+         *  \return The clearance of each state.
+         */
+        std::vector<double> getClearances(const std::vector<robot_state::RobotStateConstPtr> &states,
+                                          const Pool &pool) const;
+
         /** \brief Get the distance to collision to a specific object.
          *  \param[in] state State of the robot.
          *  \param[in] object Object to check against.
@@ -310,6 +611,26 @@ namespace robowflex
          */
         void clearACM(collision_detection::AllowedCollisionMatrix &acm) const;
 
+        /** \brief Get the distance to collision to specific objects for many robot states in parallel. The
+         * ACMs used for each object are cached until the scene changes.
+         *  \param[in] queries Pairs of robot states and the objects to check them against.
+         *  \param[in] pool Thread pool to run queries on.
+         *  \return The distance for each query. On error (e.g., an unknown object), returns NaN.
+         */
+        std::vector<double>
+        distanceToObjects(const std::vector<std::pair<robot_state::RobotStateConstPtr, std::string>> &queries,
+                          const Pool &pool) const;
+
+        /** \brief Get the distance to collision between many pairs of collision objects in the scene in
+         * parallel.
+         *  \param[in] pairs Pairs of objects to check.
+         *  \param[in] pool Thread pool to run queries on.
+         *  \return The distance for each pair. On error (e.g., an unknown object), returns NaN.
+         */
+        std::vector<double>
+        distancesBetweenObjects(const std::vector<std::pair<std::string, std::string>> &pairs,
+                                const Pool &pool) const;
+
         /** \brief Get the group state validity callback function that uses this scene.
          *  \param[in] verbose If true, will have verbose collision output.
          *  \return The group state validity function. This function will return true if there is no
@@ -317,24 +638,72 @@ namespace robowflex
          */
         moveit::core::GroupStateValidityCallbackFn getGSVCF(bool verbose) const;
 
+        /** \brief Use a sphere approximation of the robot as a conservative broad phase in validity
+         * checkers from getValidityChecker(). States whose spheres are clear of the world (see
+         * SphereModel::isClear()) are only checked exactly for self-collision.
+         *  \param[in] model Sphere model of the scene's robot. If nullptr, disables the broad phase.
+         */
+        void useSphereModel(const SphereModelConstPtr &model);
+
+        /** \brief Get the sphere model used as a broad phase by validity checkers.
+         *  \return The sphere model, or nullptr if not enabled with useSphereModel().
+         */
+        const SphereModelConstPtr &getSphereModel() const;
+
+        /** \brief Get a reusable collision checker for this scene, to use in tight loops (e.g., IK,
+         * constraint samplers, trajectory validation) rather than checkCollision().
+         *  \param[in] verbose If true, will have verbose collision output.
+         *  \param[in] group_only If true, the group state validity callback only checks the links moved by
+         * the group being set, as in checkGroupCollision().
+         *  \return The checker.
+         */
+        StateValidityCheckerPtr getValidityChecker(bool verbose = false, bool group_only = false) const;
+
+        /** \brief Check if many robot states are free of collision in parallel, with one validity checker
+         * from getValidityChecker() (and so with the sphere model as a broad phase, if one is set).
+         *  \param[in] states States to check. Collision body transforms must be up to date.
+         *  \param[in] pool Thread pool to run checks on.
+         *  \param[in] group If not empty, only checks the links moved by this group, as in
+         * checkGroupCollision().
+         *  \return For each state, true if it is not in collision, false otherwise.
+         */
+        std::vector<bool> areValid(const std::vector<robot_state::RobotStateConstPtr> &states,
+                                   const Pool &pool, const std::string &group = "") const;
+
         /** \} */
 
         /** \name IO
             \{ */
 
-        /** \brief Serialize the current planning scene to a YAML file.
+        /** \brief Serialize the current planning scene to a YAML file. Files with a `.bin` extension use
+         * the binary format of IO::messageToBinaryFile() instead.
          *  \param[in] file File to serialize planning scene to.
+         *  \param[in] octomap_sidecar If true, octomap data is stored in compressed binary sidecar files
+         * next to \a file, rather than as hex in the YAML. Ignored for binary files.
          *  \return True on success, false on failure.
          */
-        bool toYAMLFile(const std::string &file) const;
+        bool toYAMLFile(const std::string &file, bool octomap_sidecar = false) const;
 
-        /** \brief Load a planning scene from a YAML file.
+        /** \brief Load a planning scene from a YAML file, or a binary file if \a file has a `.bin`
+         * extension.
          *  \param[in] file File to load planning scene from.
          *  \return True on success, false on failure.
          */
         bool fromYAMLFile(const std::string &file);
         bool fromOpenRAVEXMLFile(const std::string &file, std::string models_dir = "");
 
+        /** \brief Load a planning scene from an OpenRAVE environment XML file, loading meshes in parallel
+         * and caching the converted scene. See openrave::fromXMLFile().
+         *  \param[in] file OpenRAVE environment XML file to load.
+         *  \param[in] pool Thread pool to load meshes on.
+         *  \param[in] cache_directory Directory to cache converted scenes in. If empty, disables the cache.
+         *  \param[in] models_dir Directory of the files referenced by \a file. If empty, the directory of
+         * \a file.
+         *  \return True on success, false on failure.
+         */
+        bool fromOpenRAVEXMLFile(const std::string &file, const Pool &pool,
+                                 const std::string &cache_directory, std::string models_dir = "");
+
         /** \} */
 
     private:
@@ -347,8 +716,131 @@ namespace robowflex
          */
         void fixCollisionObjectFrame(moveit_msgs::PlanningScene &msg);
 
+        /** \brief Add a change at the current version to the change log.
+         *  \param[in] type Type of change.
+         *  \param[in] name Name of the object changed, if any.
+         */
+        void recordChange(Change::Type type, const std::string &name = "");
+
+        /** \brief Clear the change log, for changes that cannot be recorded.
+         */
+        void resetChanges();
+
+        /** \brief Cached message and serialization of the scene.
+         */
+        struct MessageCache;
+
+        /** \brief Bring the message cache up to date with the scene. The message cache's mutex must be held.
+         *  \param[in] serialize If true, also serializes the message if it is not yet serialized.
+         */
+        void updateMessageCache(bool serialize) const;
+
+        /** \brief Cached ACMs for distance queries.
+         */
+        struct DistanceCache;
+
+        /** \brief Get the cached ACM that only allows distance to \a object to be computed, building it if
+         * needed. The distance cache's mutex must be held.
+         *  \param[in] object Object to get ACM for.
+         *  \return The ACM.
+         */
+        std::shared_ptr<const collision_detection::AllowedCollisionMatrix>
+        getObjectACM(const std::string &object) const;
+
+        /** \brief Spatial index of the collision objects.
+         */
+        struct ObjectIndex;
+
+        /** \brief Bring the object index up to date with the scene. The object index's mutex must be held.
+         */
+        void updateObjectIndex() const;
+
+        /** \brief Get the cached ACM that disables all distances, building it if needed. The distance cache's
+         * mutex must be held.
+         *  \return The ACM.
+         */
+        std::shared_ptr<const collision_detection::AllowedCollisionMatrix> getClearedACM() const;
+
         CollisionPluginLoaderPtr loader_;  ///< Plugin loader that sets collision detectors for the scene.
         planning_scene::PlanningScenePtr scene_;  ///< Underlying planning scene.
+
+        std::deque<Change> changes_;    ///< Log of recent changes.
+        std::size_t changes_start_{0};  ///< Version after which the change log is complete.
+
+        std::shared_ptr<MessageCache> message_cache_;    ///< Cached message of the scene.
+        std::shared_ptr<DistanceCache> distance_cache_;  ///< Cached ACMs for distance queries.
+        std::shared_ptr<ObjectIndex> object_index_;      ///< Spatial index of collision objects.
+
+        double field_resolution_{0.};     ///< Resolution of the distance field, zero if disabled.
+        double field_max_distance_{0.5};  ///< Maximum distance of the distance field.
+
+        std::shared_ptr<octomap::OcTree> octree_;  ///< Octree of the octomap point clouds are integrated in.
+        SphereModelConstPtr sphere_model_;         ///< Broad phase of validity checkers, if any.
+    };
+
+    /** \class robowflex::StateValidityCheckerPtr
+        \brief A shared pointer wrapper for robowflex::StateValidityChecker. */
+
+    /** \class robowflex::StateValidityCheckerConstPtr
+        \brief A const shared pointer wrapper for robowflex::StateValidityChecker. */
+
+    /** \brief A reusable collision checker for a scene.
+     *
+     *  Unlike Scene::checkCollision(), the collision request is built once, and the collision result is
+     * kept per thread and cleared between checks, so checks do not allocate. As a group state validity
+     * callback, only the transforms below the group being set are updated, as _MoveIt!_ tracks which
+     * transforms are dirty. A checker can be used from many threads at once. The scene must outlive the
+     * checker, and must not be changed while it is in use.
+     */
+    class StateValidityChecker
+    {
+    public:
+        /** \brief Constructor. Uses the scene's sphere model as a broad phase, if it has one, with the
+         * distance field of the scene's current version at each check.
+         *  \param[in] scene Scene to check against.
+         *  \param[in] verbose If true, will have verbose collision output.
+         *  \param[in] group_only If true, only the links moved by the group being set are checked when used
+         * as a group state validity callback.
+         */
+        StateValidityChecker(const Scene &scene, bool verbose = false, bool group_only = false);
+
+        /** \brief Check if a robot state is free of collision.
+         *  \param[in] state State to check. Collision body transforms must be up to date.
+         *  \param[in] jmg If not null, only checks the links moved by this group, as in
+         * Scene::checkGroupCollision().
+         *  \return True if the state is not in collision, false otherwise.
+         */
+        bool isValid(const robot_state::RobotState &state,
+                     const moveit::core::JointModelGroup *jmg = nullptr) const;
+
+        /** \brief Set a group's positions in a state, and check if the state is free of collision. Has the
+         * signature of a _MoveIt!_ group state validity callback.
+         *  \param[in,out] state State to set and check.
+         *  \param[in] jmg Group to set.
+         *  \param[in] values Positions of the group.
+         *  \return True if the state is not in collision, false otherwise.
+         */
+        bool operator()(robot_state::RobotState *state, const moveit::core::JointModelGroup *jmg,
+                        const double *values) const;
+
+        /** \brief Get a group state validity callback that copies this checker.
+         *  \return The group state validity callback.
+         */
+        moveit::core::GroupStateValidityCallbackFn getGSVCF() const;
+
+    private:
+        /** \brief Check a state for collision.
+         *  \param[in] state State to check.
+         *  \param[in] jmg Group to restrict checking to, if not null.
+         *  \return True if the state is not in collision, false otherwise.
+         */
+        bool check(const robot_state::RobotState &state, const moveit::core::JointModelGroup *jmg) const;
+
+        const Scene *scene_;     ///< Scene to check against.
+        const bool verbose_;     ///< Verbose collision output.
+        const bool group_only_;  ///< Only check the group being set.
+
+        SphereModelConstPtr spheres_;  ///< Conservative broad phase against the world, if any.
     };
 }  // namespace robowflex
 
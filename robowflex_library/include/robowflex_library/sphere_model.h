@@ -0,0 +1,165 @@
+/* Author: Zachary Kingston */
+
+#ifndef ROBOWFLEX_SPHERE_MODEL_
+#define ROBOWFLEX_SPHERE_MODEL_
+
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <geometric_shapes/shapes.h>
+
+#include <moveit/robot_model/robot_model.h>
+#include <moveit/robot_state/robot_state.h>
+
+#include <robowflex_library/adapter.h>
+#include <robowflex_library/class_forward.h>
+
+namespace robowflex
+{
+    /** \cond IGNORE */
+    ROBOWFLEX_CLASS_FORWARD(Scene);
+    ROBOWFLEX_CLASS_FORWARD(DistanceField);
+    ROBOWFLEX_CLASS_FORWARD(SphereModel);
+    /** \endcond */
+
+    /** \class robowflex::SphereModelPtr
+        \brief A shared pointer wrapper for robowflex::SphereModel. */
+
+    /** \class robowflex::SphereModelConstPtr
+        \brief A const shared pointer wrapper for robowflex::SphereModel. */
+
+    /** \brief A conservative approximation of a robot's collision geometry by spheres, for quickly ruling
+     * out collisions with the world.
+     *
+     *  Spheres are generated for each link from its collision geometry (i.e., the URDF's). Spheres are
+     * exact, boxes and meshes are covered by the spheres circumscribing the cells of a grid (for meshes, the
+     * cells that triangles pass through), cylinders by a sphere per slice along their axis, and other
+     * shapes by their bounding sphere. Every point of the geometry is inside a sphere, so if no sphere
+     * touches a collision object, the geometry does not either. States that fail the check may still be
+     * valid, and need an exact check.
+     */
+    class SphereModel
+    {
+    public:
+        /** \brief Options for generating spheres.
+         */
+        struct Options
+        {
+            double resolution{0.08};  ///< Edge length of the cells of the grids covering shapes.
+            double padding{0.};       ///< Padding added to the radius of every sphere.
+        };
+
+        /** \brief A sphere, in the frame of a link or shape.
+         */
+        struct Sphere
+        {
+            Eigen::Vector3d center;  ///< Center of the sphere.
+            double radius;           ///< Radius of the sphere.
+        };
+
+        /** \brief Constructor. Generates spheres for every link with collision geometry, with the default
+         * options.
+         *  \param[in] model Robot model to generate spheres for.
+         */
+        SphereModel(const robot_model::RobotModelConstPtr &model);
+
+        /** \brief Constructor. Generates spheres for every link with collision geometry.
+         *  \param[in] model Robot model to generate spheres for.
+         *  \param[in] options Options for generating spheres.
+         */
+        SphereModel(const robot_model::RobotModelConstPtr &model, const Options &options);
+
+        /** \brief Get the robot model of the spheres.
+         *  \return The robot model.
+         */
+        const robot_model::RobotModelConstPtr &getRobotModel() const;
+
+        /** \brief Get the spheres of a link, in the link's frame.
+         *  \param[in] link Link to get the spheres of.
+         *  \return The spheres. Empty if the link has no collision geometry.
+         */
+        const std::vector<Sphere> &getSpheres(const robot_model::LinkModel *link) const;
+
+        /** \brief Get the total number of spheres of all links.
+         *  \return The number of spheres.
+         */
+        std::size_t getSphereCount() const;
+
+        /** \brief Get the spheres of a state, in the planning frame, including spheres covering attached
+         * bodies.
+         *  \param[in] state State of the robot. Collision body transforms must be up to date.
+         *  \param[in] jmg If not null, only get the spheres of the links moved by this group, and of the
+         * bodies attached to them.
+         *  \return The spheres.
+         */
+        std::vector<Sphere> getSpheres(const robot_state::RobotState &state,
+                                       const moveit::core::JointModelGroup *jmg = nullptr) const;
+
+        /** \brief Conservatively check if a state is clear of the collision objects of a scene. If the scene
+         * has a distance field (Scene::useDistanceField()) and no octomap, spheres are checked against the
+         * field, with the field's resolution as a margin. Otherwise, spheres are checked against the
+         * bounding boxes of the scene's objects. Collisions of the robot with itself are not checked.
+         *  \param[in] scene Scene to check against.
+         *  \param[in] state State of the robot. Collision body transforms must be up to date.
+         *  \param[in] jmg If not null, only checks the links moved by this group, and the bodies attached to
+         * them.
+         *  \return True if the state is certainly clear of the world, false if it needs an exact check.
+         */
+        bool isClear(const Scene &scene, const robot_state::RobotState &state,
+                     const moveit::core::JointModelGroup *jmg = nullptr) const;
+
+        /** \brief Conservatively check if a state is clear of the collision objects of a scene, with the
+         * scene's distance field already fetched, for checking many states against an unchanging scene.
+         * See isClear().
+         *  \param[in] scene Scene to check against.
+         *  \param[in] field Distance field of \a scene from Scene::getDistanceField(), or nullptr if none.
+         *  \param[in] state State of the robot. Collision body transforms must be up to date.
+         *  \param[in] jmg If not null, only checks the links moved by this group, and the bodies attached to
+         * them.
+         *  \return True if the state is certainly clear of the world, false if it needs an exact check.
+         */
+        bool isClear(const Scene &scene, const DistanceField *field, const robot_state::RobotState &state,
+                     const moveit::core::JointModelGroup *jmg = nullptr) const;
+
+        /** \brief Get the approximate distance between a state and the nearest collision object of a
+         * distance field, as the smallest clearance of any sphere. As the spheres enclose the robot, this is
+         * a lower bound on the field's distance to the robot's geometry.
+         *  \param[in] field Distance field to check against.
+         *  \param[in] state State of the robot. Collision body transforms must be up to date.
+         *  \param[in] jmg If not null, only checks the links moved by this group, and the bodies attached to
+         * them.
+         *  \return The distance, negative if a sphere is in collision.
+         */
+        double getDistance(const DistanceField &field, const robot_state::RobotState &state,
+                           const moveit::core::JointModelGroup *jmg = nullptr) const;
+
+        /** \brief Generate spheres covering a shape, in the shape's frame.
+         *  \param[in] shape Shape to cover.
+         *  \param[in] options Options for generating spheres.
+         *  \return The spheres.
+         */
+        static std::vector<Sphere> coverShape(const shapes::Shape &shape, const Options &options);
+
+    private:
+        /** \brief Get the spheres of a shape attached to the robot, generating them if they are not yet
+         * cached.
+         *  \param[in] shape Shape to get the spheres of.
+         *  \return The spheres.
+         */
+        const std::vector<Sphere> &getAttachedSpheres(const shapes::ShapeConstPtr &shape) const;
+
+        robot_model::RobotModelConstPtr model_;  ///< Robot model of the spheres.
+        const Options options_;                  ///< Options spheres were generated with.
+
+        std::vector<std::vector<Sphere>> links_;  ///< Spheres of each link, indexed by link.
+        std::size_t count_{0};                    ///< Total number of spheres of the links.
+
+        mutable std::mutex mutex_;                                                ///< Attached cache mutex.
+        mutable std::map<shapes::ShapeConstPtr, std::vector<Sphere>> attached_;  ///< Attached spheres.
+    };
+}  // namespace robowflex
+
+#endif
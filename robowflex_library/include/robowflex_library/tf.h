@@ -233,6 +233,61 @@ namespace robowflex
          */
         RobotPose samplePoseGaussian(const Eigen::Vector3d &pos_stddev, const Eigen::Vector3d &orn_bounds);
 
+        /** \name Batch Sampling
+         *  Batch versions of the sampling functions above. Samples are stored one per column, with
+         * quaternions stored by coefficients (x, y, z, w).
+            \{ */
+
+        /** \brief Sample orientations from a given \a orientation with XYZ Euler angle \a tolerances.
+         *  \param[in] orientation The desired mean orientation.
+         *  \param[in] tolerances XYZ Euler angle tolerances about orientation.
+         *  \param[out] quaternions The sampled orientations, one per column.
+         */
+        void sampleOrientations(const Eigen::Quaterniond &orientation, const Eigen::Vector3d &tolerances,
+                                Eigen::Ref<Eigen::Matrix4Xd> quaternions);
+
+        /** \brief Sample orientations uniformly within the XYZ Euler angle \a tolerances.
+         *  \param[in] tolerances XYZ Euler angle tolerances about orientation.
+         *  \param[out] quaternions The sampled orientations, one per column.
+         */
+        void sampleOrientationsUniform(const Eigen::Vector3d &tolerances,
+                                       Eigen::Ref<Eigen::Matrix4Xd> quaternions);
+
+        /** \brief Sample positions within the given \a bounds using a uniform distribution.
+         *  \param[in] bounds The desired position bounds.
+         *  \param[out] positions The sampled positions, one per column.
+         */
+        void samplePositionsUniform(const Eigen::Vector3d &bounds, Eigen::Ref<Eigen::Matrix3Xd> positions);
+
+        /** \brief Sample positions from a gaussian distribution with mean zero and given standard deviation.
+         *  \param[in] stddev The desired standard deviation for the position.
+         *  \param[out] positions The sampled positions, one per column.
+         */
+        void samplePositionsGaussian(const Eigen::Vector3d &stddev, Eigen::Ref<Eigen::Matrix3Xd> positions);
+
+        /** \brief Sample poses within the given position, orientation bounds.
+         *  \param[in] pos_bounds The desired position bounds.
+         *  \param[in] orn_bounds The desired orientation bounds.
+         *  \param[out] positions The sampled positions, one per column.
+         *  \param[out] quaternions The sampled orientations, one per column.
+         */
+        void samplePosesUniform(const Eigen::Vector3d &pos_bounds, const Eigen::Vector3d &orn_bounds,
+                                Eigen::Ref<Eigen::Matrix3Xd> positions,
+                                Eigen::Ref<Eigen::Matrix4Xd> quaternions);
+
+        /** \brief Sample poses with gaussian sampling for the position with given standard deviations and
+         *  uniform sampling for the orientation within the given bounds.
+         *  \param[in] pos_stddev The desired position standard deviations.
+         *  \param[in] orn_bounds The desired orientation bounds.
+         *  \param[out] positions The sampled positions, one per column.
+         *  \param[out] quaternions The sampled orientations, one per column.
+         */
+        void samplePosesGaussian(const Eigen::Vector3d &pos_stddev, const Eigen::Vector3d &orn_bounds,
+                                 Eigen::Ref<Eigen::Matrix3Xd> positions,
+                                 Eigen::Ref<Eigen::Matrix4Xd> quaternions);
+
+        /** \} */
+
         /** \brief Decode a message as a transform.
          *  \param[in] tf Transform message.
          *  \return The transform.
@@ -3,9 +3,13 @@
 #ifndef ROBOWFLEX_TRAJECTORY_
 #define ROBOWFLEX_TRAJECTORY_
 
+#include <cstdint>
+#include <limits>
 #include <tuple>
 #include <functional>
 
+#include <Eigen/Core>
+
 #include <moveit/robot_state/robot_state.h>
 #include <moveit/robot_trajectory/robot_trajectory.h>
 #include <moveit_msgs/RobotTrajectory.h>
@@ -15,6 +19,7 @@
 namespace robowflex
 {
     /** \cond IGNORE */
+    ROBOWFLEX_CLASS_FORWARD(Pool);
     ROBOWFLEX_CLASS_FORWARD(Robot);
     ROBOWFLEX_CLASS_FORWARD(Scene);
     /** \endcond */
@@ -42,6 +47,50 @@ namespace robowflex
     class Trajectory
     {
     public:
+        /** \brief Bitmask options to select what metrics to compute with computeMetrics().
+         */
+        enum Metric
+        {
+            LENGTH = 1 << 0,      ///< Length of the path, getLength().
+            SMOOTHNESS = 1 << 1,  ///< Smoothness of the path, getSmoothness().
+            CORRECT = 1 << 2,     ///< Is the path collision free, isCollisionFree().
+            CLEARANCE = 1 << 3,   ///< Clearance of the path, getClearance().
+        };
+
+        /** \brief Algorithms used to time parameterize a path.
+         */
+        enum class TimeParameterization
+        {
+            ITERATIVE_PARABOLIC,  ///< MoveIt's iterative parabolic time parameterization.
+            TIME_OPTIMAL,         ///< MoveIt's time-optimal trajectory generation (TOTG). Resamples the path.
+            TRAPEZOIDAL,          ///< Rest-to-rest trapezoidal velocity profile on each segment. Fast, but
+                                  ///< stops at every waypoint.
+        };
+
+        /** \brief Options for shortcutting a path with shortcut().
+         */
+        struct ShortcutOptions
+        {
+            double time{1.};              ///< Maximum wall time to spend shortcutting, in seconds.
+            std::size_t iterations{100};  ///< Maximum number of rounds of shortcutting.
+            std::size_t candidates{0};    ///< Shortcuts evaluated per round. If 0, one per thread.
+            double resolution{0.05};      ///< Maximum distance between collision checks along a shortcut.
+            unsigned int seed{0};         ///< Seed for candidate selection.
+        };
+
+        /** \brief Metrics of a path computed by computeMetrics(). Metrics that were not requested are left
+         *  at their default value.
+         */
+        struct Metrics
+        {
+            double length{0.};                                         ///< Length of the path.
+            double smoothness{0.};                                     ///< Smoothness of the path.
+            bool correct{true};                                        ///< Is the path collision free?
+            double clearance{0.};                                      ///< Average clearance.
+            double min_clearance{std::numeric_limits<double>::max()};  ///< Minimum clearance.
+            double max_clearance{0.};                                  ///< Maximum clearance.
+        };
+
         /** \brief Constructor for an empty trajectory.
          *  \param[in] robot Robot to construct trajectory for.
          *  \param[in] group Planning group of the trajectory.
@@ -75,13 +124,15 @@ namespace robowflex
         void useMessage(const robot_state::RobotState &reference_state,
                         const trajectory_msgs::JointTrajectory &msg);
 
-        /** \brief Dump a trajectory to a file.
+        /** \brief Dump a trajectory to a file. Files with a `.bin` extension use the binary format of
+         * IO::messageToBinaryFile(), other files use YAML.
          *  \param[in] filename Trajectory filename.
          *  \return True on success.
          */
         bool toYAMLFile(const std::string &filename) const;
 
-        /** \brief Load a trajectory from a YAML file.
+        /** \brief Load a trajectory from a YAML file, or a binary file if \a filename has a `.bin`
+         * extension.
          *  \param[in] reference_state A full state that contains the values for all the joints.
          *  \param[in] filename Trajectory filename.
          *  \return True on success.
@@ -98,7 +149,8 @@ namespace robowflex
          */
         const robot_trajectory::RobotTrajectoryPtr &getTrajectoryConst() const;
 
-        /** \brief Get a reference to the trajectory.
+        /** \brief Get a reference to the trajectory. As the trajectory may be modified through this
+         *  reference, this invalidates the cached joint matrix, see getJointMatrix().
          *  \return The trajectory.
          */
         robot_trajectory::RobotTrajectoryPtr &getTrajectory();
@@ -147,6 +199,26 @@ namespace robowflex
         static bool computeTimeParameterization(robot_trajectory::RobotTrajectory &trajectory,
                                                 double max_velocity = 1., double max_acceleration = 1.);
 
+        /** \brief Computes the time parameterization of a path with a specific algorithm.
+         *  \param[in] method Time parameterization algorithm to use.
+         *  \param[in] max_velocity Scaling factor for the velocity limits of the joints, in (0, 1].
+         *  \param[in] max_acceleration Scaling factor for the acceleration limits of the joints, in (0, 1].
+         *  \return True on success, false on failure.
+         */
+        bool computeTimeParameterization(TimeParameterization method, double max_velocity = 1.,
+                                         double max_acceleration = 1.);
+
+        /** \brief Computes the time parameterization of a path with a specific algorithm.
+         *  \param[in] trajectory to compute time parameterization.
+         *  \param[in] method Time parameterization algorithm to use.
+         *  \param[in] max_velocity Scaling factor for the velocity limits of the joints, in (0, 1].
+         *  \param[in] max_acceleration Scaling factor for the acceleration limits of the joints, in (0, 1].
+         *  \return True on success, false on failure.
+         */
+        static bool computeTimeParameterization(robot_trajectory::RobotTrajectory &trajectory,
+                                                TimeParameterization method, double max_velocity = 1.,
+                                                double max_acceleration = 1.);
+
         /** \brief Insert a number of states in a path so that the path is made up of exactly count states.
          * States are inserted uniformly (more states on longer segments). Changes are performed only if a
          * path has less than count states.
@@ -154,6 +226,25 @@ namespace robowflex
          */
         void interpolate(unsigned int count);
 
+        /** \brief Shortcut a path by randomized shortcutting. Each round, a number of random pairs of
+         *  waypoints are picked, and the straight-line motion between each pair is collision checked in
+         *  parallel on \a pool. The valid shortcuts that shorten the path the most, and do not overlap, are
+         *  applied by removing the waypoints in between. Timing information is reset, so the path should be
+         *  time parameterized afterwards.
+         *  \param[in] scene Scene to collision check shortcuts in.
+         *  \param[in] pool Thread pool to evaluate shortcuts with. The calling thread also evaluates them.
+         *  \param[in] options Options for shortcutting.
+         *  \return How much shorter the path is.
+         */
+        double shortcut(const SceneConstPtr &scene, const Pool &pool, const ShortcutOptions &options);
+
+        /** \brief Shortcut a path by randomized shortcutting, using the default ShortcutOptions.
+         *  \param[in] scene Scene to collision check shortcuts in.
+         *  \param[in] pool Thread pool to evaluate shortcuts with.
+         *  \return How much shorter the path is.
+         */
+        double shortcut(const SceneConstPtr &scene, const Pool &pool);
+
         /** \brief Converts a trajectory into a vector of position vectors. The values are in the same order
          * as reported by getJointNames(), which is consistent within MoveIt.
          * \return The trajectory in vector form.
@@ -166,6 +257,14 @@ namespace robowflex
          */
         std::vector<std::string> getJointNames() const;
 
+        /** \brief Get the positions of the trajectory as a dense matrix, one row per waypoint and one column
+         *  per joint, in the same order as getJointNames(). The matrix is read directly from the waypoints
+         *  without building a trajectory message, and is cached until the trajectory is modified through
+         *  this class (including any call to getTrajectory()). The returned reference is valid until then.
+         *  \return The trajectory as a waypoints x joints matrix.
+         */
+        const Eigen::MatrixXd &getJointMatrix() const;
+
         /** \brief Adds a specified part of a trajectory to the end of the current trajectory. The default,
          *  when \a start_index or \a end_index are ommitted, is to add the whole trajectory.
          *  \param[in] source The trajectory containing the part to append to the end of current trajectory.
@@ -194,12 +293,41 @@ namespace robowflex
          */
         bool isCollisionFree(const SceneConstPtr &scene) const;
 
+        /** \brief Checks if a path is collision free, checking waypoints in parallel on \a pool. Each
+         *  thread checks a copy of the waypoints, and checking stops on the first invalid waypoint found.
+         *  \param[in] scene Scene to collision check the path with.
+         *  \param[in] pool Thread pool to check waypoints with. The calling thread also checks waypoints.
+         *  \return True if the path is collision free in the scene.
+         */
+        bool isCollisionFree(const SceneConstPtr &scene, const Pool &pool) const;
+
+        /** \brief Checks if the continuous motion along a path is collision free, not just its waypoints.
+         *  Each segment is checked by conservative advancement: from a collision-free state, the path is
+         *  advanced by as much as the robot can move without travelling further than its clearance to the
+         *  scene, as computed by the scene's collision detector. How far the robot can move is bounded by
+         *  the change in each joint, with revolute joints scaled by the maximum extent of the robot. So
+         *  sparse paths are validated without interpolating them first. Self-collisions are checked only
+         *  at the states visited along each segment.
+         *  \param[in] scene Scene to collision check the path with.
+         *  \param[in] tolerance Clearance below which a state is considered to be in collision.
+         *  \return True if the path is collision free in the scene.
+         */
+        bool isCollisionFreeContinuous(const SceneConstPtr &scene, double tolerance = 1e-3) const;
+
         /** \brief Get the average, minimum, and maximum clearance of a path.
          *  \param[in] scene Scene to compute clearance to.
          *  \return In order, the average, minimum, and maximum clearance of a path to a scene.
          */
         std::tuple<double, double, double> getClearance(const SceneConstPtr &scene) const;
 
+        /** \brief Get the average, minimum, and maximum clearance of a path, computing the clearance of
+         *  waypoints in parallel on \a pool. Each thread uses a copy of the waypoints.
+         *  \param[in] scene Scene to compute clearance to.
+         *  \param[in] pool Thread pool to compute clearance with. The calling thread also computes clearance.
+         *  \return In order, the average, minimum, and maximum clearance of a path to a scene.
+         */
+        std::tuple<double, double, double> getClearance(const SceneConstPtr &scene, const Pool &pool) const;
+
         /** \brief Get the smoothness of a path relative to some metric.
          *  See internal function documentation for details.
          *  \param[in] metric An optional metric to use to compute the length of the path segments.
@@ -207,6 +335,19 @@ namespace robowflex
          */
         double getSmoothness(const PathMetric &metric = {}) const;
 
+        /** \brief Compute a set of metrics of a path in a single pass over its waypoints. Distances between
+         *  waypoints are computed once, and shared between the length and smoothness computation. Collision
+         *  and clearance queries are made in the same pass. Results are the same as computing each metric
+         *  with its own function.
+         *  \param[in] mask Bitmask of the metrics to compute, see Metric.
+         *  \param[in] scene Scene to compute collision and clearance metrics with. Required for CORRECT
+         *  and CLEARANCE.
+         *  \param[in] metric An optional metric to use to compute the length of the path segments.
+         *  \return The computed metrics.
+         */
+        Metrics computeMetrics(uint32_t mask, const SceneConstPtr &scene = nullptr,
+                               const PathMetric &metric = {}) const;
+
         /** \brief Returns the joint positions from the last state in a planned trajectory in \a response.
          *  \return A map of joint name to joint position of the last state in \a response.
          */
@@ -215,7 +356,104 @@ namespace robowflex
         /** \} */
 
     protected:
+        /** \brief Mark the trajectory as modified, invalidating cached data.
+         */
+        void invalidate();
+
         robot_trajectory::RobotTrajectoryPtr trajectory_;
+
+    private:
+        /** \cond IGNORE */
+        struct JointMatrix;
+        /** \endcond */
+
+        std::shared_ptr<JointMatrix> matrix_;  ///< Cached joint matrix, shared with copies of this class.
+    };
+
+    /** \cond IGNORE */
+    ROBOWFLEX_CLASS_FORWARD(ResampledTrajectory);
+    /** \endcond */
+
+    /** \class robowflex::ResampledTrajectoryPtr
+        \brief A shared pointer wrapper for robowflex::ResampledTrajectory. */
+
+    /** \class robowflex::ResampledTrajectoryConstPtr
+        \brief A const shared pointer wrapper for robowflex::ResampledTrajectory. */
+
+    /** \brief A lazy, densely resampled view of a trajectory.
+     *
+     *  The view has the same waypoints as Trajectory::interpolate() would insert into the trajectory, but
+     *  computes each interpolated state on demand from the sparse waypoints of the source trajectory,
+     *  instead of storing them. So dense trajectories can be checked, measured, and exported without
+     *  allocating a robot state for every waypoint. The view shares the waypoints of the source; modifying
+     *  the source afterwards invalidates the view.
+     */
+    class ResampledTrajectory
+    {
+    public:
+        /** \brief A callback for each waypoint of the view.
+         *  \param[in] index Index of the waypoint.
+         *  \param[in] state State of the waypoint, only valid for the duration of the call.
+         *  \return True to continue to the next waypoint, false to stop.
+         */
+        using WayPointCallback = std::function<bool(std::size_t index, const robot_state::RobotState &state)>;
+
+        /** \brief Constructor.
+         *  \param[in] trajectory Trajectory to resample.
+         *  \param[in] count Approximate number of waypoints, as for Trajectory::interpolate().
+         */
+        ResampledTrajectory(const Trajectory &trajectory, unsigned int count);
+
+        /** \brief Get the number of waypoints of the view.
+         *  \return The number of waypoints.
+         */
+        std::size_t getNumWaypoints() const;
+
+        /** \brief Compute a waypoint of the view.
+         *  \param[in] index Index of the waypoint.
+         *  \param[out] state State to set to the waypoint. Transforms are updated.
+         */
+        void getWayPoint(std::size_t index, robot_state::RobotState &state) const;
+
+        /** \brief Compute each waypoint of the view in order, into a single reused state.
+         *  \param[in] callback Callback for each waypoint.
+         *  \return True if every waypoint was visited, false if the callback stopped early.
+         */
+        bool forEachWayPoint(const WayPointCallback &callback) const;
+
+        /** \brief Get the length of the resampled path. See Trajectory::getLength().
+         *  \param[in] metric An optional metric to use to compute the length of the path.
+         *  \return Length of the path according to the metric.
+         */
+        double getLength(const PathMetric &metric = {}) const;
+
+        /** \brief Checks if every waypoint of the resampled path is collision free. See
+         *  Trajectory::isCollisionFree().
+         *  \param[in] scene Scene to collision check the path with.
+         *  \return True if the path is collision free in the scene.
+         */
+        bool isCollisionFree(const SceneConstPtr &scene) const;
+
+        /** \brief Get the positions of the resampled path as a dense matrix, with the same columns as
+         *  Trajectory::getJointMatrix().
+         *  \return The path as a waypoints x joints matrix.
+         */
+        Eigen::MatrixXd getJointMatrix() const;
+
+        /** \brief Build the resampled trajectory, with durations as set by Trajectory::interpolate().
+         *  \return The resampled trajectory.
+         */
+        TrajectoryPtr toTrajectory() const;
+
+    private:
+        /** \brief Get the segment and interpolation parameter of a waypoint.
+         *  \param[in] index Index of the waypoint.
+         *  \return The index of the first waypoint of the segment in the source, and the parameter along it.
+         */
+        std::pair<std::size_t, double> getSegment(std::size_t index) const;
+
+        robot_trajectory::RobotTrajectoryConstPtr source_;  ///< Source trajectory.
+        std::vector<std::size_t> offsets_;                  ///< View index of each source waypoint.
     };
 }  // namespace robowflex
 
@@ -0,0 +1,65 @@
+/* Author: Zachary Kingston */
+
+#include <iostream>
+
+#include <robowflex_library/comparison.h>
+#include <robowflex_library/log.h>
+
+using namespace robowflex;
+
+/* \file compare_datasets.cpp
+ * Compares two benchmark results files written by JSONPlanDataSetOutputter,
+ * e.g., from two builds of a planner, and reports the median and success rate
+ * of each query with bootstrap confidence intervals and Mann-Whitney tests.
+ * Experiments are matched by name, and queries by query name. Extra arguments
+ * are the metrics to compare, `time` by default. Exits with 1 if any metric of
+ * any query significantly regressed, so it can be used to gate changes, and
+ * with 2 if the files could not be compared.
+ *
+ * Usage: compare_datasets <base.json> <test.json> [metric ...]
+ */
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " <base.json> <test.json> [metric ...]" << std::endl;
+        return 2;
+    }
+
+    const auto &base = loadJSONDataSets(argv[1]);
+    const auto &test = loadJSONDataSets(argv[2]);
+    if (base.empty() or test.empty())
+        return 2;
+
+    DataSetComparison::Options options;
+    if (argc > 3)
+        options.metrics.assign(argv + 3, argv + argc);
+
+    bool compared = false;
+    bool regression = false;
+    for (const auto &dataset : base)
+    {
+        for (const auto &other : test)
+        {
+            if (other->name != dataset->name)
+                continue;
+
+            std::cout << "Experiment " << dataset->name << std::endl;
+
+            DataSetComparison comparison(*dataset, *other, options);
+            comparison.print(std::cout);
+
+            compared = true;
+            regression |= comparison.hasRegression();
+        }
+    }
+
+    if (not compared)
+    {
+        RBX_ERROR("No experiments with the same name in `%s` and `%s`", argv[1], argv[2]);
+        return 2;
+    }
+
+    return (regression) ? 1 : 0;
+}
@@ -0,0 +1,162 @@
+/* Author: Zachary Kingston */
+
+#include <iostream>
+
+#include <boost/filesystem.hpp>
+
+#include <robowflex_library/dataset.h>
+#include <robowflex_library/io.h>
+#include <robowflex_library/io/archive.h>
+#include <robowflex_library/io/yaml.h>
+#include <robowflex_library/log.h>
+#include <robowflex_library/pool.h>
+#include <robowflex_library/yaml.h>
+
+using namespace robowflex;
+
+/* \file pack_dataset.cpp
+ * Packs the loose files of a dataset into a single archive, which Dataset can
+ * load queries from with addArchive() without opening a file per query. Each
+ * extra argument is `<kind>=<pattern>`, where the pattern is a directory or
+ * glob as for Dataset::findFiles(), and the kind is one of `scene`, `request`,
+ * `trajectory`, or `config`. Scenes, requests, and trajectories are converted
+ * from YAML (or binary) files to messages, and configs (e.g., URDF, SRDF, and
+ * YAML configuration files) are stored as they are. Entries are named
+ * `<kind>/<file name>`. Files are read in parallel.
+ *
+ * Usage: pack_dataset <archive> <kind>=<pattern> [<kind>=<pattern> ...]
+ *
+ * For example:
+ *   pack_dataset fetch.rbx 'scene=package://robowflex_resources/fetch/scenes/scene*.yaml' \
+ *                          'request=package://robowflex_resources/fetch/scenes/request*.yaml'
+ */
+
+namespace
+{
+    /** \brief Load a message from a file, and serialize it. */
+    template <typename T>
+    bool loadMessage(const std::string &file, std::string &md5, std::vector<uint8_t> &data)
+    {
+        T msg;
+        if (not IO::fromYAMLFile(msg, file))
+            return false;
+
+        data.resize(ros::serialization::serializationLength(msg));
+        ros::serialization::OStream stream(data.data(), data.size());
+        ros::serialization::serialize(stream, msg);
+
+        md5 = ros::message_traits::md5sum<T>(msg);
+        return true;
+    }
+
+    /** \brief Load a trajectory from a YAML file, and serialize it. */
+    bool loadTrajectory(const std::string &file, std::string &md5, std::vector<uint8_t> &data)
+    {
+        const auto &yaml = IO::loadFileToYAML(file);
+        if (not yaml.first)
+            return false;
+
+        const auto &msg = yaml.second.as<moveit_msgs::RobotTrajectory>();
+        data.resize(ros::serialization::serializationLength(msg));
+        ros::serialization::OStream stream(data.data(), data.size());
+        ros::serialization::serialize(stream, msg);
+
+        md5 = ros::message_traits::md5sum<moveit_msgs::RobotTrajectory>(msg);
+        return true;
+    }
+
+    /** \brief Load a file as it is. */
+    bool loadConfig(const std::string &file, std::string &md5, std::vector<uint8_t> &data)
+    {
+        const auto &mapped = IO::mapFile(file);
+        if (not mapped)
+            return false;
+
+        data.assign(mapped->data(), mapped->data() + mapped->size());
+        md5.clear();
+        return true;
+    }
+}  // namespace
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " <archive> <kind>=<pattern> [<kind>=<pattern> ...]"
+                  << std::endl;
+        return 1;
+    }
+
+    using Loader = bool (*)(const std::string &, std::string &, std::vector<uint8_t> &);
+
+    struct File
+    {
+        std::string name;           ///< Name of the entry.
+        std::string path;           ///< File to load.
+        Loader loader;              ///< Function to load the file with.
+        std::string md5;            ///< MD5 sum of the loaded message.
+        std::vector<uint8_t> data;  ///< Loaded data.
+        bool loaded;                ///< Whether the file was loaded.
+    };
+
+    std::vector<File> files;
+    for (int i = 2; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const auto split = arg.find('=');
+        const std::string kind = arg.substr(0, split);
+
+        Loader loader = nullptr;
+        if (kind == "scene")
+            loader = loadMessage<moveit_msgs::PlanningScene>;
+        else if (kind == "request")
+            loader = loadMessage<moveit_msgs::MotionPlanRequest>;
+        else if (kind == "trajectory")
+            loader = loadTrajectory;
+        else if (kind == "config")
+            loader = loadConfig;
+
+        if (split == std::string::npos or not loader)
+        {
+            RBX_ERROR("Invalid argument `%s`, expected <scene|request|trajectory|config>=<pattern>", arg);
+            return 1;
+        }
+
+        const auto &paths = Dataset::findFiles(arg.substr(split + 1));
+        if (paths.empty())
+            RBX_WARN("No files found for `%s`", arg);
+
+        for (const auto &path : paths)
+        {
+            const auto &filename = boost::filesystem::path(path).filename().string();
+            files.push_back({kind + "/" + filename, path, loader, "", {}, false});
+        }
+    }
+
+    // Reading files dominates packing, especially on network filesystems, so they are read in parallel.
+    Pool pool;
+    pool.parallelFor(0, files.size(),
+                     [&](std::size_t i) {
+                         auto &file = files[i];
+                         file.loaded = file.loader(file.path, file.md5, file.data);
+                     },
+                     1);
+
+    IO::ArchiveWriter writer;
+    for (auto &file : files)
+    {
+        if (not file.loaded)
+        {
+            RBX_ERROR("Failed to load `%s`!", file.path);
+            return 1;
+        }
+
+        writer.addData(file.name, file.md5, std::move(file.data));
+    }
+
+    if (not writer.write(argv[1]))
+        return 1;
+
+    RBX_INFO("Packed %d entries into `%s`", writer.getCount(), argv[1]);
+    return 0;
+}
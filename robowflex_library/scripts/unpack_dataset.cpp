@@ -0,0 +1,98 @@
+/* Author: Zachary Kingston */
+
+#include <fstream>
+#include <iostream>
+
+#include <boost/filesystem.hpp>
+
+#include <robowflex_library/io.h>
+#include <robowflex_library/io/archive.h>
+#include <robowflex_library/io/yaml.h>
+#include <robowflex_library/log.h>
+#include <robowflex_library/yaml.h>
+
+using namespace robowflex;
+
+/* \file unpack_dataset.cpp
+ * Unpacks an archive written by pack_dataset back into loose files, with each
+ * entry `<kind>/<file name>` written to `<directory>/<kind>/<file name>`.
+ * Scenes, requests, and trajectories are converted back to YAML (or binary
+ * files, for `.bin` names), and configs are written as they are.
+ *
+ * Usage: unpack_dataset <archive> <directory>
+ */
+
+namespace
+{
+    /** \brief Write a message entry to a YAML or binary file. */
+    template <typename T>
+    bool unpackMessage(const IO::Archive &archive, const std::string &name, const std::string &file)
+    {
+        T msg;
+        if (not archive.getMessage(name, msg))
+            return false;
+
+        if (IO::isBinaryFile(file))
+            return IO::messageToBinaryFile(msg, file);
+
+        return IO::YAMLToFile(IO::toNode(msg), file);
+    }
+
+    /** \brief Write a raw file entry. */
+    bool unpackFile(const IO::Archive &archive, const std::string &name, const std::string &file)
+    {
+        std::string contents;
+        if (not archive.getFile(name, contents))
+            return false;
+
+        std::ofstream out;
+        IO::createFile(out, file);
+        out << contents;
+
+        return static_cast<bool>(out);
+    }
+}  // namespace
+
+int main(int argc, char **argv)
+{
+    if (argc != 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " <archive> <directory>" << std::endl;
+        return 1;
+    }
+
+    IO::Archive archive(argv[1]);
+    if (not archive.isOpen())
+        return 1;
+
+    const std::string scene_md5 = ros::message_traits::MD5Sum<moveit_msgs::PlanningScene>::value();
+    const std::string request_md5 = ros::message_traits::MD5Sum<moveit_msgs::MotionPlanRequest>::value();
+    const std::string trajectory_md5 = ros::message_traits::MD5Sum<moveit_msgs::RobotTrajectory>::value();
+
+    for (const auto &name : archive.getNames())
+    {
+        const auto &file = (boost::filesystem::path(argv[2]) / name).string();
+        const auto &md5 = archive.getMD5(name);
+
+        bool success = false;
+        if (md5.empty())
+            success = unpackFile(archive, name, file);
+        else if (md5 == scene_md5)
+            success = unpackMessage<moveit_msgs::PlanningScene>(archive, name, file);
+        else if (md5 == request_md5)
+            success = unpackMessage<moveit_msgs::MotionPlanRequest>(archive, name, file);
+        else if (md5 == trajectory_md5)
+            success = unpackMessage<moveit_msgs::RobotTrajectory>(archive, name, file);
+        else
+            RBX_ERROR("Entry `%s` has an unknown message type (MD5 %s)", name, md5);
+
+        if (not success)
+        {
+            RBX_ERROR("Failed to unpack `%s`!", name);
+            return 1;
+        }
+    }
+
+    RBX_INFO("Unpacked %d entries into `%s`", archive.getNames().size(), argv[2]);
+    return 0;
+}
@@ -0,0 +1,64 @@
+/* Author: Zachary Kingston */
+
+#include <robowflex_library/benchmarking.h>
+#include <robowflex_library/ik_benchmarking.h>
+#include <robowflex_library/log.h>
+#include <robowflex_library/robot.h>
+#include <robowflex_library/util.h>
+
+using namespace robowflex;
+
+/* \file ur5_ik_benchmark.cpp
+ * Compares IK solvers for the UR5's manipulator. Each argument is a kinematics
+ * configuration, given as `<name>=<kinematics.yaml>`, e.g.,
+ * `kdl=package://robowflex_resources/ur/config/ur5/kinematics.yaml`. All
+ * configurations solve the same reachable targets, on four threads. Runs are
+ * written to `ur5_ik.json` and a summary per configuration to `ur5_ik.csv`.
+ */
+
+static const std::string URDF{"package://robowflex_resources/ur/robots/ur5_robotiq_robot_limited.urdf.xacro"};
+static const std::string SRDF{"package://robowflex_resources/ur/config/ur5/ur5_robotiq85.srdf.xacro"};
+static const std::string LIMITS{"package://robowflex_resources/ur/config/ur5/joint_limits.yaml"};
+
+int main(int argc, char **argv)
+{
+    // Startup ROS
+    ROS ros(argc, argv);
+
+    IKExperiment::Options options;
+    options.targets = 1000;
+    options.threads = 4;
+
+    IKExperiment experiment("ur5_ik", "manipulator", "ee_link", options);
+
+    // Load a UR5 for each kinematics configuration.
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const auto split = arg.find('=');
+        if (split == std::string::npos)
+        {
+            RBX_ERROR("Argument `%s` is not of the form <name>=<kinematics.yaml>", arg);
+            return 1;
+        }
+
+        const auto &name = arg.substr(0, split);
+        auto ur5 = std::make_shared<Robot>("ur5_" + name);
+        if (not ur5->initialize(URDF, SRDF, LIMITS, arg.substr(split + 1)) or
+            not ur5->loadKinematics("manipulator"))
+            return 1;
+
+        experiment.addKinematics(name, ur5);
+    }
+
+    auto dataset = experiment.benchmark();
+    if (not dataset)
+        return 1;
+
+    JSONPlanDataSetOutputter output("ur5_ik.json");
+    output.dump(*dataset);
+
+    experiment.toCSVFile("ur5_ik.csv");
+
+    return 0;
+}
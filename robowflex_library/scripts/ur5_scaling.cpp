@@ -0,0 +1,54 @@
+/* Author: Zachary Kingston */
+
+#include <robowflex_library/benchmarking.h>
+#include <robowflex_library/builder.h>
+#include <robowflex_library/detail/ur5.h>
+#include <robowflex_library/planning.h>
+#include <robowflex_library/scene.h>
+#include <robowflex_library/util.h>
+
+using namespace robowflex;
+
+/* \file ur5_scaling.cpp
+ * Measures how benchmarking with the UR5 scales with the number of threads.
+ * For each thread count, a PoolPlanner of the same size is created so each
+ * benchmarking thread has its own planner. The speedup and efficiency at each
+ * thread count are written to `ur5_scaling.csv`.
+ */
+
+int main(int argc, char **argv)
+{
+    // Startup ROS
+    ROS ros(argc, argv);
+
+    // Create the default UR5 robot.
+    auto ur5 = std::make_shared<UR5Robot>();
+    ur5->initialize();
+
+    // Create an empty scene.
+    auto scene = std::make_shared<Scene>(ur5);
+
+    // Create a new experiment for each thread count, with a pool of planners of the same size.
+    ThreadScaling scaling([&](std::size_t threads) {
+        auto planner = std::make_shared<PoolPlanner>(ur5, threads);
+        planner->initialize<OMPL::UR5OMPLPipelinePlanner>();
+
+        MotionRequestBuilderPtr request(new MotionRequestBuilder(planner, "manipulator"));
+        request->setStartConfiguration({0.0677, -0.8235, 0.9860, -0.1624, 0.0678, 0.0});
+        request->setGoalConfiguration({-0.39, -0.69, -2.12, 2.82, -0.39, 0});
+
+        Profiler::Options options;
+        auto experiment = std::make_shared<Experiment>("ur5_scaling",  // Name of experiment
+                                                       options,        // Options for internal profiler
+                                                       5.0,            // Timeout allowed for ALL queries
+                                                       100);           // Number of trials
+
+        experiment->addQuery("joint", scene, planner, request);
+        return experiment;
+    });
+
+    scaling.run();
+    scaling.toCSVFile("ur5_scaling.csv");
+
+    return 0;
+}
@@ -58,7 +58,7 @@ int main(int argc, char **argv)
     JSONPlanDataSetOutputter json_output("test_log.json");
     json_output.dump(*dataset);
 
-    TrajectoryPlanDataSetOutputter traj_output("test_log.bag");
+    HDF5PlanDataSetOutputter traj_output("test_log.h5");
     traj_output.dump(*dataset);
 
     return 0;
@@ -0,0 +1,158 @@
+/* Author: Zachary Kingston */
+
+#include <robowflex_library/allocation.h>
+
+#ifdef ROBOWFLEX_ALLOCATION_COUNTING
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+#include <malloc.h>
+
+namespace
+{
+    /** \brief Allocations of a thread. Trivial, so it needs no initialization on first use from inside
+     *  the allocator.
+     */
+    struct ThreadCounts
+    {
+        bool active;              ///< If true, allocations of the thread are counted.
+        std::size_t allocations;  ///< Number of allocations.
+        std::size_t bytes;        ///< Total bytes allocated.
+        long long current;        ///< Bytes allocated minus bytes freed, negative if older blocks are freed.
+        long long peak;           ///< Peak of \a current.
+    };
+
+    thread_local ThreadCounts counts;
+
+    /** \brief Allocate a block with malloc(), counting it if the thread is counting. */
+    void *allocate(std::size_t size)
+    {
+        void *ptr = std::malloc((size) ? size : 1);
+        if (ptr and counts.active)
+        {
+            const std::size_t usable = malloc_usable_size(ptr);
+            ++counts.allocations;
+            counts.bytes += usable;
+            counts.current += usable;
+            counts.peak = std::max(counts.peak, counts.current);
+        }
+
+        return ptr;
+    }
+
+    /** \brief Allocate a block, calling the new handler until it succeeds, as `operator new` must. */
+    void *allocateOrThrow(std::size_t size)
+    {
+        while (true)
+        {
+            if (void *ptr = allocate(size))
+                return ptr;
+
+            auto handler = std::get_new_handler();
+            if (not handler)
+                throw std::bad_alloc();
+
+            handler();
+        }
+    }
+
+    /** \brief Free a block allocated by allocate(). */
+    void deallocate(void *ptr)
+    {
+        if (ptr and counts.active)
+            counts.current -= malloc_usable_size(ptr);
+
+        std::free(ptr);
+    }
+}  // namespace
+
+void *operator new(std::size_t size)
+{
+    return allocateOrThrow(size);
+}
+
+void *operator new[](std::size_t size)
+{
+    return allocateOrThrow(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+    return allocate(size);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept
+{
+    return allocate(size);
+}
+
+void operator delete(void *ptr) noexcept
+{
+    deallocate(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+    deallocate(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept
+{
+    deallocate(ptr);
+}
+
+void operator delete[](void *ptr, std::size_t) noexcept
+{
+    deallocate(ptr);
+}
+
+void operator delete(void *ptr, const std::nothrow_t &) noexcept
+{
+    deallocate(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept
+{
+    deallocate(ptr);
+}
+
+bool robowflex::allocation::isAvailable()
+{
+    return true;
+}
+
+void robowflex::allocation::start()
+{
+    counts = ThreadCounts{true, 0, 0, 0, 0};
+}
+
+robowflex::allocation::Counts robowflex::allocation::stop()
+{
+    counts.active = false;
+
+    Counts result;
+    result.allocations = counts.allocations;
+    result.bytes = counts.bytes;
+    result.peak = static_cast<std::size_t>(std::max(counts.peak, 0LL));
+    return result;
+}
+
+#else
+
+bool robowflex::allocation::isAvailable()
+{
+    return false;
+}
+
+void robowflex::allocation::start()
+{
+}
+
+robowflex::allocation::Counts robowflex::allocation::stop()
+{
+    return {};
+}
+
+#endif
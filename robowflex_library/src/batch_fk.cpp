@@ -0,0 +1,300 @@
+/* Author: Zachary Kingston */
+
+#include <moveit/robot_model/prismatic_joint_model.h>
+#include <moveit/robot_model/revolute_joint_model.h>
+
+#include <robowflex_library/batch_fk.h>
+#include <robowflex_library/log.h>
+#include <robowflex_library/robot.h>
+#include <robowflex_library/util.h>
+
+using namespace robowflex;
+
+namespace
+{
+    /** \brief Element of the rotation of a constant transform. */
+    double rotation(const RobotPose &pose, int r, int c)
+    {
+        return pose.linear()(r, c);
+    }
+
+    /** \brief Element of the rotation of a varying transform. */
+    auto rotation(const BatchFK::Transforms &transforms, int r, int c) -> decltype(transforms.col(0))
+    {
+        return transforms.col(c * 3 + r);
+    }
+
+    /** \brief Element of the translation of a constant transform. */
+    double translation(const RobotPose &pose, int r)
+    {
+        return pose.translation()[r];
+    }
+
+    /** \brief Element of the translation of a varying transform. */
+    auto translation(const BatchFK::Transforms &transforms, int r) -> decltype(transforms.col(0))
+    {
+        return transforms.col(9 + r);
+    }
+
+    /** \brief Compose two transforms, at least one of which varies, into \a out. \a out must not alias
+     * either transform. */
+    template <typename A, typename B>
+    void multiply(const A &a, const B &b, BatchFK::Transforms &out)
+    {
+        for (int c = 0; c < 3; ++c)
+            for (int r = 0; r < 3; ++r)
+                out.col(c * 3 + r) = rotation(a, r, 0) * rotation(b, 0, c) +  //
+                                     rotation(a, r, 1) * rotation(b, 1, c) +  //
+                                     rotation(a, r, 2) * rotation(b, 2, c);
+
+        for (int r = 0; r < 3; ++r)
+            out.col(9 + r) = rotation(a, r, 0) * translation(b, 0) +  //
+                             rotation(a, r, 1) * translation(b, 1) +  //
+                             rotation(a, r, 2) * translation(b, 2) + translation(a, r);
+    }
+
+    /** \brief Set every row of \a out to a constant transform. */
+    void broadcast(const RobotPose &pose, BatchFK::Transforms &out)
+    {
+        for (int c = 0; c < 3; ++c)
+            for (int r = 0; r < 3; ++r)
+                out.col(c * 3 + r).setConstant(pose.linear()(r, c));
+
+        for (int r = 0; r < 3; ++r)
+            out.col(9 + r).setConstant(pose.translation()[r]);
+    }
+}  // namespace
+
+///
+/// BatchFK
+///
+
+BatchFK::BatchFK(const Robot &robot, const std::string &group, const std::vector<std::string> &links,
+                 const robot_state::RobotState *reference)
+  : links_(links)
+{
+    const auto &model = robot.getModelConst();
+    const auto *jmg = model->getJointModelGroup(group);
+    if (not jmg)
+        throw Exception(1, log::format("Group `%1%` does not exist in robot!", group));
+
+    robot_state::RobotState state((reference) ? *reference : *robot.getScratchStateConst());
+    state.update(true);
+
+    // Map model variables to columns of the configurations.
+    variables_ = jmg->getVariableCount();
+    std::vector<int> columns(model->getVariableCount(), -1);
+    const auto &indices = jmg->getVariableIndexList();
+    for (std::size_t i = 0; i < indices.size(); ++i)
+        columns[indices[i]] = i;
+
+    // Mark every link along the chains to the requested links.
+    const auto &all = model->getLinkModels();
+    std::vector<char> needed(all.size(), false);
+    for (const auto &name : links_)
+    {
+        const auto *link = model->getLinkModel(name);
+        if (not link)
+            throw Exception(1, log::format("Link `%1%` does not exist in robot!", name));
+
+        for (; link and not needed[link->getLinkIndex()]; link = link->getParentLinkModel())
+            needed[link->getLinkIndex()] = true;
+    }
+
+    // Links are ordered parents first, so stages are as well.
+    std::vector<int> stage_of(all.size(), -1);
+    for (const auto *link : all)
+    {
+        if (not needed[link->getLinkIndex()])
+            continue;
+
+        Stage stage;
+        const auto *parent = link->getParentLinkModel();
+        if (parent)
+            stage.parent = stage_of[parent->getLinkIndex()];
+
+        const auto *joint = link->getParentJointModel();
+        const auto *source = (joint->getMimic()) ? joint->getMimic() : joint;
+
+        bool moved = false;
+        for (std::size_t i = 0; i < source->getVariableCount(); ++i)
+            moved |= columns[source->getFirstVariableIndex() + i] >= 0;
+
+        stage.varying = moved or (stage.parent >= 0 and stages_[stage.parent].varying);
+        stage.pose = state.getGlobalLinkTransform(link);
+        stage.origin = link->getJointOriginTransform();
+
+        if (not moved)
+            stage.origin = stage.origin * state.getJointTransform(joint);
+
+        else if (joint->getType() == robot_model::JointModel::REVOLUTE or
+                 joint->getType() == robot_model::JointModel::PRISMATIC)
+        {
+            stage.type = (joint->getType() == robot_model::JointModel::REVOLUTE) ? Type::REVOLUTE :
+                                                                                     Type::PRISMATIC;
+            stage.axis = (stage.type == Type::REVOLUTE) ?
+                             static_cast<const moveit::core::RevoluteJointModel *>(joint)->getAxis() :
+                             static_cast<const moveit::core::PrismaticJointModel *>(joint)->getAxis();
+            stage.column = columns[source->getFirstVariableIndex()];
+
+            if (joint->getMimic())
+            {
+                stage.factor = joint->getMimicFactor();
+                stage.offset = joint->getMimicOffset();
+            }
+        }
+        else
+        {
+            // Mimics of multi-variable joints are rare enough to not be worth a closed form.
+            if (joint->getMimic())
+                throw Exception(1, log::format("Cannot batch mimic joint `%1%`!", joint->getName()));
+
+            stage.type = Type::GENERAL;
+            stage.joint = joint;
+            for (std::size_t i = 0; i < joint->getVariableCount(); ++i)
+            {
+                stage.columns.emplace_back(columns[joint->getFirstVariableIndex() + i]);
+                stage.values.emplace_back(state.getVariablePosition(joint->getFirstVariableIndex() + i));
+            }
+        }
+
+        stage_of[link->getLinkIndex()] = stages_.size();
+        stages_.emplace_back(stage);
+    }
+
+    for (const auto &name : links_)
+        outputs_.emplace_back(stage_of[model->getLinkModel(name)->getLinkIndex()]);
+}
+
+std::size_t BatchFK::getVariableCount() const
+{
+    return variables_;
+}
+
+const std::vector<std::string> &BatchFK::getLinks() const
+{
+    return links_;
+}
+
+void BatchFK::compute(const Eigen::Ref<const Eigen::MatrixXd> &positions,
+                      std::vector<Transforms> &transforms) const
+{
+    if (std::size_t(positions.cols()) != variables_)
+        throw Exception(1, log::format("Expected %1% variables per configuration, got %2%!", variables_,
+                                       positions.cols()));
+
+    const Eigen::Index n = positions.rows();
+
+    // Only varying stages are stored, indexed by stage.
+    std::vector<Transforms> poses(stages_.size());
+    Transforms local(n, 12);
+    Transforms fixed(n, 12);
+
+    for (std::size_t i = 0; i < stages_.size(); ++i)
+    {
+        const auto &stage = stages_[i];
+        if (not stage.varying)
+            continue;
+
+        auto &pose = poses[i];
+        pose.resize(n, 12);
+
+        const bool parent_varying = stage.parent >= 0 and stages_[stage.parent].varying;
+        const RobotPose &parent = (stage.parent >= 0) ? stages_[stage.parent].pose : RobotPose::Identity();
+        const RobotPose before = (parent_varying) ? stage.origin : parent * stage.origin;
+
+        // The varying part of the joint's transform.
+        switch (stage.type)
+        {
+            case Type::FIXED:
+                multiply(poses[stage.parent], stage.origin, pose);
+                continue;
+
+            case Type::REVOLUTE:
+            {
+                const Eigen::ArrayXd q = stage.factor * positions.col(stage.column).array() + stage.offset;
+                const Eigen::ArrayXd c = q.cos();
+                const Eigen::ArrayXd s = q.sin();
+                const Eigen::ArrayXd v = 1 - c;
+                const auto &a = stage.axis;
+
+                // Rodrigues' formula, R = cI + s[a]x + (1 - c)aa^T.
+                local.col(0) = c + v * a[0] * a[0];
+                local.col(1) = v * a[0] * a[1] + s * a[2];
+                local.col(2) = v * a[0] * a[2] - s * a[1];
+                local.col(3) = v * a[0] * a[1] - s * a[2];
+                local.col(4) = c + v * a[1] * a[1];
+                local.col(5) = v * a[1] * a[2] + s * a[0];
+                local.col(6) = v * a[0] * a[2] + s * a[1];
+                local.col(7) = v * a[1] * a[2] - s * a[0];
+                local.col(8) = c + v * a[2] * a[2];
+                local.rightCols<3>().setZero();
+                break;
+            }
+
+            case Type::PRISMATIC:
+            {
+                const Eigen::ArrayXd q = stage.factor * positions.col(stage.column).array() + stage.offset;
+                broadcast(RobotPose::Identity(), local);
+                for (int r = 0; r < 3; ++r)
+                    local.col(9 + r) = q * stage.axis[r];
+                break;
+            }
+
+            case Type::GENERAL:
+            {
+                std::vector<double> values(stage.values);
+                RobotPose tf;
+                for (Eigen::Index k = 0; k < n; ++k)
+                {
+                    for (std::size_t j = 0; j < values.size(); ++j)
+                        if (stage.columns[j] >= 0)
+                            values[j] = positions(k, stage.columns[j]);
+
+                    stage.joint->computeTransform(values.data(), tf);
+                    for (int c = 0; c < 3; ++c)
+                        for (int r = 0; r < 3; ++r)
+                            local(k, c * 3 + r) = tf.linear()(r, c);
+
+                    for (int r = 0; r < 3; ++r)
+                        local(k, 9 + r) = tf.translation()[r];
+                }
+                break;
+            }
+        }
+
+        if (parent_varying)
+        {
+            multiply(poses[stage.parent], before, fixed);
+            multiply(fixed, local, pose);
+        }
+        else
+            multiply(before, local, pose);
+    }
+
+    transforms.resize(outputs_.size());
+    for (std::size_t i = 0; i < outputs_.size(); ++i)
+    {
+        const auto &stage = stages_[outputs_[i]];
+        if (stage.varying)
+            transforms[i] = poses[outputs_[i]];
+        else
+        {
+            transforms[i].resize(n, 12);
+            broadcast(stage.pose, transforms[i]);
+        }
+    }
+}
+
+RobotPose BatchFK::getPose(const Transforms &transforms, Eigen::Index index)
+{
+    RobotPose pose = RobotPose::Identity();
+    for (int c = 0; c < 3; ++c)
+        for (int r = 0; r < 3; ++r)
+            pose.linear()(r, c) = transforms(index, c * 3 + r);
+
+    for (int r = 0; r < 3; ++r)
+        pose.translation()[r] = transforms(index, 9 + r);
+
+    return pose;
+}
@@ -1,20 +1,49 @@
 /* Author: Zachary Kingston, Bryce Willey */
 
+#include <algorithm>
+#include <deque>
 #include <queue>
+#include <atomic>
+#include <condition_variable>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+
+#include <cerrno>
+#include <cstring>
+
+#include <linux/perf_event.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 #include <boost/lexical_cast.hpp>
+#include <boost/math/distributions/students_t.hpp>
 #include <utility>
 
+#include <moveit/robot_state/conversions.h>
 #include <moveit/version.h>
 
 #include <robowflex_library/macros.h>
 #include <robowflex_library/util.h>
+#include <robowflex_library/allocation.h>
 #include <robowflex_library/benchmarking.h>
 #include <robowflex_library/builder.h>
+#include <robowflex_library/ik_cache.h>
 #include <robowflex_library/io.h>
+#include <robowflex_library/io/hdf5.h>
 #include <robowflex_library/io/yaml.h>
 #include <robowflex_library/log.h>
 #include <robowflex_library/planning.h>
+#include <robowflex_library/pool.h>
+#include <robowflex_library/robot.h>
 #include <robowflex_library/scene.h>
 #include <robowflex_library/trajectory.h>
 
@@ -65,6 +94,566 @@ std::string robowflex::toMetricString(const PlannerMetric &metric)
     return boost::apply_visitor(toMetricStringVisitor(), metric);
 }
 
+namespace
+{
+    /** \brief A blocking, bounded multi-producer queue used to hand results from workers to a consumer.
+     */
+    template <typename T>
+    class BoundedQueue
+    {
+    public:
+        BoundedQueue(std::size_t capacity) : capacity_(std::max<std::size_t>(1, capacity))
+        {
+        }
+
+        /** \brief Add an item, blocking while the queue is full. */
+        void push(T item)
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            not_full_.wait(lock, [&] { return queue_.size() < capacity_ or closed_; });
+
+            queue_.emplace(std::move(item));
+            not_empty_.notify_one();
+        }
+
+        /** \brief Take an item, blocking while the queue is empty. Returns false once the queue is closed
+         * and drained. */
+        bool pop(T &item)
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            not_empty_.wait(lock, [&] { return not queue_.empty() or closed_; });
+
+            if (queue_.empty())
+                return false;
+
+            item = std::move(queue_.front());
+            queue_.pop();
+            not_full_.notify_one();
+
+            return true;
+        }
+
+        /** \brief Close the queue, waking up the consumer once all items have been taken. */
+        void close()
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            closed_ = true;
+
+            not_empty_.notify_all();
+            not_full_.notify_all();
+        }
+
+    private:
+        const std::size_t capacity_;
+        bool closed_{false};
+        std::queue<T> queue_;
+        std::mutex mutex_;
+        std::condition_variable not_empty_;
+        std::condition_variable not_full_;
+    };
+
+    /** \brief A single timer thread that periodically samples the progress of all concurrently profiled
+     *  runs. Runs register a sampling callback for the duration of their plan, and are removed without
+     *  waiting for the next tick. Samples are taken one at a time, so expensive callbacks delay others.
+     */
+    class ProgressSampler
+    {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        /** \brief A registered sampling callback. */
+        struct Entry
+        {
+            std::mutex mutex;                ///< Held while sampling.
+            std::function<void()> callback;  ///< Sampling callback.
+            Clock::duration period;          ///< Time between samples.
+            bool done{false};                ///< If true, the run has finished and is no longer sampled.
+            std::size_t samples{0};          ///< Number of samples taken.
+        };
+
+        using EntryPtr = std::shared_ptr<Entry>;
+
+        /** \brief Get the sampler shared by all profilers. */
+        static ProgressSampler &get()
+        {
+            if (auto *sampler = getForked())
+                return *sampler;
+
+            static ProgressSampler sampler;
+            return sampler;
+        }
+
+        /** \brief Give a forked child process a sampler of its own. The sampling thread is not inherited by
+         *  the child, and the parent's sampler may have been locked at the fork, so it is abandoned. */
+        static void atFork()
+        {
+            getForked() = new ProgressSampler;
+        }
+
+        ~ProgressSampler()
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                active_ = false;
+            }
+
+            cv_.notify_all();
+            thread_.join();
+        }
+
+        /** \brief Start sampling \a callback every \a period seconds. The first sample is taken after one
+         *  \a period. */
+        EntryPtr add(double period, const std::function<void()> &callback)
+        {
+            auto entry = std::make_shared<Entry>();
+            entry->callback = callback;
+            entry->period = std::chrono::duration_cast<Clock::duration>(  //
+                std::chrono::duration<double>(std::max(period, 1e-3)));
+
+            std::unique_lock<std::mutex> lock(mutex_);
+            queue_.emplace(Clock::now() + entry->period, entry);
+            if (queue_.top().entry == entry)
+                cv_.notify_one();
+
+            return entry;
+        }
+
+        /** \brief Stop sampling \a entry. If \a at_least_once is true and no sample has been taken, a
+         *  sample is taken on the calling thread. Once this returns, the callback is never called again. */
+        void remove(const EntryPtr &entry, bool at_least_once)
+        {
+            std::unique_lock<std::mutex> lock(entry->mutex);
+            entry->done = true;
+
+            if (at_least_once and entry->samples == 0)
+                entry->callback();
+
+            entry->callback = nullptr;
+        }
+
+    private:
+        ProgressSampler() : thread_([this] { run(); })
+        {
+        }
+
+        static ProgressSampler *&getForked()
+        {
+            static ProgressSampler *sampler = nullptr;
+            return sampler;
+        }
+
+        /** \brief An entry waiting for its next sample. */
+        struct Scheduled
+        {
+            Scheduled(Clock::time_point time, EntryPtr entry) : time(time), entry(std::move(entry))
+            {
+            }
+
+            bool operator>(const Scheduled &other) const
+            {
+                return time > other.time;
+            }
+
+            Clock::time_point time;  ///< Time of the next sample.
+            EntryPtr entry;          ///< Entry to sample.
+        };
+
+        void run()
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (active_)
+            {
+                if (queue_.empty())
+                {
+                    cv_.wait(lock);
+                    continue;
+                }
+
+                const auto time = queue_.top().time;
+                if (Clock::now() < time)
+                {
+                    cv_.wait_until(lock, time);
+                    continue;
+                }
+
+                auto next = queue_.top();
+                queue_.pop();
+                lock.unlock();
+
+                bool done;
+                {
+                    std::unique_lock<std::mutex> entry_lock(next.entry->mutex);
+                    done = next.entry->done;
+                    if (not done)
+                    {
+                        next.entry->callback();
+                        next.entry->samples++;
+                    }
+                }
+
+                // Don't try to catch up on missed samples if a callback is slow.
+                next.time = std::max(next.time + next.entry->period, Clock::now());
+
+                lock.lock();
+                if (not done)
+                    queue_.emplace(std::move(next));
+            }
+        }
+
+        /** \brief Entries ordered by time of their next sample. */
+        std::priority_queue<Scheduled, std::vector<Scheduled>, std::greater<Scheduled>> queue_;
+
+        std::mutex mutex_;            ///< Queue mutex.
+        std::condition_variable cv_;  ///< Wakes the sampler on new entries or shutdown.
+        bool active_{true};           ///< If false, the sampler is shutting down.
+        std::thread thread_;          ///< Sampling thread.
+    };
+
+    /** \brief Performance counters of the calling thread and the threads it starts, read with
+     *  perf_event_open(). Events that cannot be opened are left out.
+     */
+    class PerfCounters
+    {
+    public:
+        PerfCounters()
+        {
+            struct Event
+            {
+                const char *name;  ///< Name of the metric.
+                uint32_t type;     ///< Type of the event.
+                uint64_t config;   ///< Event of the type.
+            };
+
+            static const Event events[] = {
+                {"perf_cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+                {"perf_instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+                {"perf_cache_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+                {"perf_branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+                {"perf_context_switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+            };
+
+            for (const auto &event : events)
+            {
+                perf_event_attr attr;
+                std::memset(&attr, 0, sizeof(attr));
+                attr.size = sizeof(attr);
+                attr.type = event.type;
+                attr.config = event.config;
+                attr.disabled = 1;
+                attr.inherit = 1;
+                attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+                // Context switches happen in the kernel, so only hardware events are limited to user space.
+                attr.exclude_kernel = (event.type == PERF_TYPE_HARDWARE);
+                attr.exclude_hv = 1;
+
+                const int fd = ::syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+                if (fd >= 0)
+                    counters_.emplace_back(event.name, fd);
+                else
+                {
+                    static std::atomic<bool> warned(false);
+                    if (not warned.exchange(true))
+                        RBX_WARN("Performance counter `%s` is unavailable: %s", event.name,
+                                 std::strerror(errno));
+                }
+            }
+        }
+
+        ~PerfCounters()
+        {
+            for (const auto &counter : counters_)
+                ::close(counter.second);
+        }
+
+        // non-copyable
+        PerfCounters(PerfCounters const &) = delete;
+        void operator=(PerfCounters const &) = delete;
+
+        /** \brief Reset and start all counters. */
+        void start()
+        {
+            for (const auto &counter : counters_)
+            {
+                ::ioctl(counter.second, PERF_EVENT_IOC_RESET, 0);
+                ::ioctl(counter.second, PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+
+        /** \brief Stop all counters and add their values to \a metrics. */
+        void stop(std::map<std::string, PlannerMetric> &metrics)
+        {
+            for (const auto &counter : counters_)
+                ::ioctl(counter.second, PERF_EVENT_IOC_DISABLE, 0);
+
+            for (const auto &counter : counters_)
+            {
+                // Value, time enabled, and time running.
+                uint64_t values[3];
+                if (::read(counter.second, values, sizeof(values)) != sizeof(values))
+                    continue;
+
+                // Scale up counts if the kernel multiplexed the counter with others.
+                const double scale = (values[2] > 0) ? double(values[1]) / values[2] : 0.;
+                metrics[counter.first] = std::size_t(values[0] * scale);
+            }
+        }
+
+    private:
+        std::vector<std::pair<std::string, int>> counters_;  ///< Metric name and file of each counter.
+    };
+
+    /** \brief Start counting allocations of the calling thread for a stage, if counting is compiled in.
+     *  \return True if allocations are being counted.
+     */
+    bool startAllocations()
+    {
+        if (allocation::isAvailable())
+        {
+            allocation::start();
+            return true;
+        }
+
+        static std::atomic<bool> warned(false);
+        if (not warned.exchange(true))
+            RBX_WARN("Allocation counting is unavailable, compile with ROBOWFLEX_ALLOCATION_COUNTING");
+
+        return false;
+    }
+
+    /** \brief Stop counting allocations of a stage, and add them to \a metrics as
+     *  `alloc_<stage>_count`, `alloc_<stage>_bytes` and `alloc_<stage>_peak_bytes`.
+     */
+    void stopAllocations(const std::string &stage, std::map<std::string, PlannerMetric> &metrics)
+    {
+        const auto &counts = allocation::stop();
+        metrics["alloc_" + stage + "_count"] = counts.allocations;
+        metrics["alloc_" + stage + "_bytes"] = counts.bytes;
+        metrics["alloc_" + stage + "_peak_bytes"] = counts.peak;
+    }
+
+    /** \brief Hands out the trials of an experiment to worker threads. In order, trials are handed out
+     *  as they were added. Otherwise, the trial with the longest expected time is handed out first, with
+     *  expected times learned from the completed runs of each query. Trials that are not expected to fit
+     *  in the remaining time budget are skipped, as are the optional trials of a query once the confidence
+     *  interval of its watched metric is tight enough.
+     */
+    class TrialScheduler
+    {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        /** \brief A trial, or with run till timeout, the remainder of a trial. */
+        struct Item
+        {
+            std::size_t todo;              ///< Index of the trial.
+            std::size_t query;             ///< Index of the trial's query.
+            std::size_t trial;             ///< Trial number within the query.
+            double time_remaining;         ///< Planning time left for the trial.
+            std::size_t timeout_trial{0};  ///< Number of times the trial has been run so far.
+        };
+
+        TrialScheduler(std::size_t queries, bool adaptive, double budget)
+          : adaptive_(adaptive)
+          , budget_(budget)
+          , start_(Clock::now())
+          , pending_((adaptive) ? queries : 1)
+          , started_(queries, 0)
+          , estimates_(queries, 0.)
+          , runs_(queries, 0)
+          , values_(queries)
+        {
+        }
+
+        /** \brief Only run trials numbered \a min_trials and above while the half-width of the confidence
+         *  interval of the mean of the values of a query is above \a width. */
+        void setStopping(std::size_t min_trials, double width, double confidence)
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            stopping_ = true;
+            min_trials_ = std::max<std::size_t>(2, min_trials);
+            width_ = width;
+            confidence_ = confidence;
+        }
+
+        /** \brief Add a trial to be handed out. */
+        void add(const Item &item)
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            push(item);
+        }
+
+        /** \brief Take the next trial, blocking while running trials may still add their remainder.
+         *  Returns false once there are no trials left. */
+        bool next(Item &item)
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (true)
+            {
+                cv_.wait(lock, [&] { return size_ > 0 or running_ == 0; });
+                if (size_ == 0)
+                    return false;
+
+                auto &queue = select();
+                item = queue.front();
+                queue.pop_front();
+                --size_;
+
+                // Elapsed time only grows, so a trial that does not fit now is dropped.
+                if (budget_ > 0. and getElapsed() + getExpectedTime(item) > budget_)
+                {
+                    ++skipped_;
+                    continue;
+                }
+
+                if (stopping_ and item.timeout_trial == 0 and item.trial >= min_trials_ and
+                    isConverged(item.query))
+                {
+                    ++stopped_;
+                    continue;
+                }
+
+                ++started_[item.query];
+                ++running_;
+                return true;
+            }
+        }
+
+        /** \brief Record that a run of a query took \a time seconds. */
+        void record(std::size_t query, double time)
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            estimates_[query] += (time - estimates_[query]) / ++runs_[query];
+        }
+
+        /** \brief Add a value of the watched metric for a query. */
+        void addValue(std::size_t query, double value)
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            auto &values = values_[query];
+            const double delta = value - values.mean;
+            values.mean += delta / ++values.n;
+            values.m2 += delta * (value - values.mean);
+        }
+
+        /** \brief Mark a trial taken with next() as done. If \a remainder is given, it is handed out
+         *  again. */
+        void finish(const Item *remainder = nullptr)
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (remainder)
+                push(*remainder);
+
+            --running_;
+            cv_.notify_all();
+        }
+
+        /** \brief Get the number of trials skipped so far for lack of time. */
+        std::size_t getSkipped() const
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            return skipped_;
+        }
+
+        /** \brief Get the number of trials not run because their query had converged. */
+        std::size_t getStopped() const
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            return stopped_;
+        }
+
+    private:
+        void push(const Item &item)
+        {
+            pending_[(adaptive_) ? item.query : 0].emplace_back(item);
+            ++size_;
+            cv_.notify_one();
+        }
+
+        /** \brief Statistics of the values of a query, updated with Welford's method. */
+        struct Values
+        {
+            std::size_t n{0};  ///< Number of values.
+            double mean{0.};   ///< Mean of the values.
+            double m2{0.};     ///< Sum of squared differences from the mean.
+        };
+
+        /** \brief Check if the half-width of the Student's t confidence interval of a query's mean is
+         *  within the target. */
+        bool isConverged(std::size_t query) const
+        {
+            const auto &values = values_[query];
+            if (values.n < min_trials_)
+                return false;
+
+            const boost::math::students_t distribution(double(values.n - 1));
+            const double t = boost::math::quantile(distribution, 0.5 + confidence_ / 2.);
+            const double deviation = std::sqrt(values.m2 / (values.n - 1));
+
+            return t * deviation / std::sqrt(double(values.n)) <= width_;
+        }
+
+        double getElapsed() const
+        {
+            return std::chrono::duration<double>(Clock::now() - start_).count();
+        }
+
+        /** \brief Until a run of a query is complete, its allowed time is used as a pessimistic guess, so
+         *  unknown queries are tried early. */
+        double getExpectedTime(const Item &item) const
+        {
+            if (runs_[item.query] == 0)
+                return item.time_remaining;
+
+            return std::min(estimates_[item.query], item.time_remaining);
+        }
+
+        /** \brief Select the queue to take the next trial from. Expected times of trials of the same query
+         *  are equal, so only the front of each queue is considered. Ties go to the query with the fewest
+         *  started trials, so queries are interleaved. */
+        std::deque<Item> &select()
+        {
+            std::deque<Item> *best = nullptr;
+            double best_time = 0.;
+            for (auto &queue : pending_)
+            {
+                if (queue.empty())
+                    continue;
+
+                const double time = getExpectedTime(queue.front());
+                if (not best or time > best_time or
+                    (time == best_time and started_[queue.front().query] < started_[best->front().query]))
+                {
+                    best = &queue;
+                    best_time = time;
+                }
+            }
+
+            return *best;
+        }
+
+        const bool adaptive_;                    ///< If true, schedule by expected time.
+        const double budget_;                    ///< Wall-clock budget. 0 for none.
+        const Clock::time_point start_;          ///< Time the scheduler was created.
+        std::vector<std::deque<Item>> pending_;  ///< Pending trials, per query if adaptive.
+        std::vector<std::size_t> started_;       ///< Number of trials started per query.
+        std::vector<double> estimates_;          ///< Mean time of a run per query.
+        std::vector<std::size_t> runs_;          ///< Number of completed runs per query.
+        std::vector<Values> values_;             ///< Values of the watched metric per query.
+        bool stopping_{false};                   ///< If true, stop queries once they converge.
+        std::size_t min_trials_{0};              ///< Trials always run per query.
+        double width_{0.};                       ///< Target confidence interval half-width.
+        double confidence_{0.};                  ///< Confidence level of the interval.
+        std::size_t size_{0};                    ///< Number of pending trials.
+        std::size_t running_{0};                 ///< Number of trials taken but not finished.
+        std::size_t skipped_{0};                 ///< Number of trials skipped for lack of time.
+        std::size_t stopped_{0};                 ///< Number of trials skipped after convergence.
+
+        mutable std::mutex mutex_;    ///< Scheduler mutex.
+        std::condition_variable cv_;  ///< Wakes workers on new trials or the last trial finishing.
+    };
+}  // namespace
+
 ///
 /// PlanningQuery
 ///
@@ -81,6 +670,105 @@ PlanningQuery::PlanningQuery(const std::string &name,     //
 /// PlanData
 ///
 
+void PlanData::compact()
+{
+    if (trajectory)
+    {
+        compact_trajectory = std::make_shared<CompactTrajectory>(*trajectory);
+        trajectory.reset();
+    }
+
+    if (response.trajectory_)
+    {
+        compact_response_trajectory = std::make_shared<CompactTrajectory>(*response.trajectory_);
+        response.trajectory_.reset();
+    }
+}
+
+TrajectoryPtr PlanData::getTrajectory() const
+{
+    if (trajectory)
+        return trajectory;
+
+    return (compact_trajectory) ? compact_trajectory->toTrajectory() : nullptr;
+}
+
+CompactTrajectoryPtr PlanData::getCompactTrajectory() const
+{
+    if (compact_trajectory)
+        return compact_trajectory;
+
+    return (trajectory) ? std::make_shared<CompactTrajectory>(*trajectory) : nullptr;
+}
+
+robot_trajectory::RobotTrajectoryPtr PlanData::getResponseTrajectory() const
+{
+    if (response.trajectory_)
+        return response.trajectory_;
+
+    return (compact_response_trajectory) ? compact_response_trajectory->toRobotTrajectory() : nullptr;
+}
+
+const PlannerMetric *PlanData::getMetric(const std::string &name) const
+{
+    auto it = metrics.find(name);
+    if (it != metrics.end())
+        return &it->second;
+
+    if (constant_metrics)
+    {
+        auto cit = constant_metrics->find(name);
+        if (cit != constant_metrics->end())
+            return &cit->second;
+    }
+
+    return nullptr;
+}
+
+bool PlanData::getMetricValue(const std::string &name, double &value) const
+{
+    if (name == "time")
+        value = time;
+    else if (name == "success")
+        value = success;
+    else
+    {
+        const auto *metric = getMetric(name);
+        if (not metric)
+            return false;
+
+        // Keep in sync with the order of types in PlannerMetric.
+        switch (metric->which())
+        {
+            case 0:
+                value = boost::get<bool>(*metric);
+                break;
+            case 1:
+                value = boost::get<double>(*metric);
+                break;
+            case 2:
+                value = boost::get<int>(*metric);
+                break;
+            case 3:
+                value = boost::get<std::size_t>(*metric);
+                break;
+            default:
+                return false;
+        }
+    }
+
+    return std::isfinite(value);
+}
+
+std::map<std::string, PlannerMetric> PlanData::getAllMetrics() const
+{
+    auto all = metrics;
+    if (constant_metrics)
+        all.insert(constant_metrics->begin(), constant_metrics->end());
+
+    return all;
+}
+
 std::vector<std::pair<double, double>> PlanData::getProgressPropertiesAsPoints(const std::string &xprop,
                                                                                const std::string &yprop) const
 {
@@ -130,6 +818,75 @@ std::vector<PlanDataPtr> PlanDataSet::getFlatData() const
     return r;
 }
 
+void PlanDataSet::merge(const PlanDataSet &other)
+{
+    for (const auto &name : other.query_names)
+        if (std::find(query_names.begin(), query_names.end(), name) == query_names.end())
+            query_names.emplace_back(name);
+
+    for (const auto &query : other.data)
+        for (const auto &run : query.second)
+            addDataPoint(query.first, run);
+
+    queries.insert(queries.end(), other.queries.begin(), other.queries.end());
+
+    start = std::min(start, other.start);
+    finish = std::max(finish, other.finish);
+    time += other.time;
+    wait_time += other.wait_time;
+    threads += other.threads;
+}
+
+namespace
+{
+    /** \brief Time parameterize the trajectory of \a run and report the time taken. */
+    void parameterizeRun(PlanData &run, Trajectory::TimeParameterization method, double max_velocity,
+                         double max_acceleration)
+    {
+        // Compact trajectories are rebuilt for parameterization, and compacted again after.
+        const auto trajectory = run.getTrajectory();
+        if (not trajectory)
+            return;
+
+        const auto start = IO::getDate();
+        const bool success = trajectory->computeTimeParameterization(method, max_velocity, max_acceleration);
+
+        run.metrics["parameterization_time"] = IO::getSeconds(start, IO::getDate());
+        run.metrics["parameterization_success"] = success;
+        run.metrics["trajectory_duration"] =
+            (success) ? trajectory->getTrajectoryConst()->getWayPointDurationFromStart(
+                            trajectory->getNumWaypoints() - 1) :
+                        0.;
+
+        if (not run.trajectory)
+            run.compact_trajectory = std::make_shared<CompactTrajectory>(*trajectory);
+    }
+}  // namespace
+
+void PlanDataSet::computeTimeParameterization(const Pool &pool, Trajectory::TimeParameterization method,
+                                              double max_velocity, double max_acceleration)
+{
+    const auto runs = getFlatData();
+    pool.parallelFor(0, runs.size(), [&](std::size_t i) {
+        parameterizeRun(*runs[i], method, max_velocity, max_acceleration);
+    });
+}
+
+PlanDataSetPtr robowflex::mergeDataSets(const std::vector<PlanDataSetPtr> &datasets)
+{
+    if (datasets.empty())
+        return nullptr;
+
+    auto merged = std::make_shared<PlanDataSet>(*datasets[0]);
+    merged->shard = 0;
+    merged->shards = 1;
+
+    for (std::size_t i = 1; i < datasets.size(); ++i)
+        merged->merge(*datasets[i]);
+
+    return merged;
+}
+
 ///
 /// Profiler
 ///
@@ -140,9 +897,12 @@ bool Profiler::profilePlan(const PlannerPtr &planner,
                            const Options &options,                                //
                            PlanData &result) const
 {
-    bool complete = false;
-    std::mutex mutex;
-    std::shared_ptr<std::thread> progress_thread;
+    if (options.isolate)
+        return profilePlanIsolated(planner, scene, request, options, result);
+
+    RBX_TRACE("Profiler::profilePlan");
+
+    ProgressSampler::EntryPtr progress;
 
     result.query.scene = scene;
     result.query.planner = planner;
@@ -178,68 +938,580 @@ bool Profiler::profilePlan(const PlannerPtr &planner,
             result.property_names.emplace_back("time REAL");
         }
 
-        progress_thread.reset(new std::thread([&] {
-            bool at_least_once = options.progress_at_least_once;
-            while (true)
+        // Sample progress on the shared sampler thread while planning
+        progress = ProgressSampler::get().add(options.progress_update_rate, [&] {
+            if (have_prog)
+            {
+                std::map<std::string, std::string> data;
+
+                // Add time stamp
+                double time = IO::getSeconds(result.start, IO::getDate());
+                data["time REAL"] = std::to_string(time);
+
+                // Compute properties
+                for (const auto &property : prog_props)
+                    data[property.first] = property.second();
+
+                result.progress.emplace_back(data);
+            }
+
+            for (const auto &callback : prog_call)
+                callback(planner, scene, request, result);
+        });
+    }
+
+    std::unique_ptr<PerfCounters> counters;
+    if (options.counters)
+        counters.reset(new PerfCounters());
+
+    // Plan
+    bool allocations = false;
+    try
+    {
+        RBX_TRACE("Planner::plan");
+        if (counters)
+            counters->start();
+
+        if (options.allocations)
+            allocations = startAllocations();
+
+        result.response = planner->plan(scene, request);
+
+        if (allocations)
+            stopAllocations("plan", result.metrics);
+
+        if (counters)
+            counters->stop(result.metrics);
+    }
+    catch (...)
+    {
+        if (allocations)
+            allocation::stop();
+
+        if (progress)
+            ProgressSampler::get().remove(progress, false);
+        throw;
+    }
+
+    // Stop sampling progress
+    if (progress)
+        ProgressSampler::get().remove(progress, options.progress_at_least_once);
+
+    // Metrics reported by the planner itself, e.g., the time taken by each stage.
+    for (const auto &metric : planner->getLastPlanMetrics())
+        result.metrics[metric.first] = metric.second;
+
+    // Compute metrics and fill out results
+    result.finish = IO::getDate();
+    result.time = IO::getSeconds(result.start, result.finish);
+    result.success = result.response.error_code_.val == moveit_msgs::MoveItErrorCodes::SUCCESS;
+
+    if (result.success)
+        result.trajectory = std::make_shared<Trajectory>(*result.response.trajectory_);
+
+    static const std::string hostname = IO::getHostname();
+    result.hostname = hostname;
+    result.process_id = IO::getProcessID();
+    result.thread_id = IO::getThreadID();
+    result.cpu_id = Pool::getCurrentCPU();
+
+    if (options.compute_metrics)
+        computeMetrics(options, result);
+
+    return result.success;
+}
+
+namespace
+{
+    /** \brief Writes runs into a byte buffer, to send them from an isolated child process to its parent.
+     */
+    class RunWriter
+    {
+    public:
+        template <typename T>
+        void write(const T &value)
+        {
+            buffer.append(reinterpret_cast<const char *>(&value), sizeof(T));
+        }
+
+        void write(const std::string &value)
+        {
+            write(value.size());
+            buffer.append(value);
+        }
+
+        template <typename M>
+        void writeMessage(const M &msg)
+        {
+            std::string data(ros::serialization::serializationLength(msg), '\0');
+            ros::serialization::OStream stream(reinterpret_cast<uint8_t *>(&data[0]), data.size());
+            ros::serialization::serialize(stream, msg);
+
+            write(data);
+        }
+
+        void writeMetric(const PlannerMetric &metric)
+        {
+            // Keep in sync with the order of types in PlannerMetric.
+            write(metric.which());
+            switch (metric.which())
             {
-                // Sleep until the next update
-                IO::threadSleep(options.progress_update_rate);
+                case 0:
+                    write(boost::get<bool>(metric));
+                    break;
+                case 1:
+                    write(boost::get<double>(metric));
+                    break;
+                case 2:
+                    write(boost::get<int>(metric));
+                    break;
+                case 3:
+                    write(boost::get<std::size_t>(metric));
+                    break;
+                default:
+                    write(boost::get<std::string>(metric));
+                    break;
+            }
+        }
+
+        void writeTrajectory(const robot_trajectory::RobotTrajectoryPtr &trajectory)
+        {
+            write(bool(trajectory));
+            if (trajectory)
+            {
+                moveit_msgs::RobotTrajectory msg;
+                trajectory->getRobotTrajectoryMsg(msg);
+
+                write(trajectory->getGroupName());
+                writeMessage(msg);
+            }
+        }
+
+        std::string buffer;  ///< Written bytes.
+    };
+
+    /** \brief Reads runs written by a RunWriter. All reads fail once the buffer is exhausted, e.g., if the
+     *  child process crashed while sending a run.
+     */
+    class RunReader
+    {
+    public:
+        RunReader(const std::string &buffer) : buffer_(buffer)
+        {
+        }
+
+        template <typename T>
+        bool read(T &value)
+        {
+            if (buffer_.size() - offset_ < sizeof(T))
+                return false;
+
+            std::memcpy(&value, buffer_.data() + offset_, sizeof(T));
+            offset_ += sizeof(T);
+            return true;
+        }
+
+        bool read(std::string &value)
+        {
+            std::size_t size;
+            if (not read(size) or buffer_.size() - offset_ < size)
+                return false;
+
+            value = buffer_.substr(offset_, size);
+            offset_ += size;
+            return true;
+        }
+
+        template <typename M>
+        bool readMessage(M &msg)
+        {
+            std::string data;
+            if (not read(data))
+                return false;
+
+            try
+            {
+                ros::serialization::IStream stream(reinterpret_cast<uint8_t *>(&data[0]), data.size());
+                ros::serialization::deserialize(stream, msg);
+            }
+            catch (const ros::Exception &)
+            {
+                return false;
+            }
+
+            return true;
+        }
+
+        bool readMetric(PlannerMetric &metric)
+        {
+            int which;
+            if (not read(which))
+                return false;
+
+            switch (which)
+            {
+                case 0:
+                    return readAs<bool>(metric);
+                case 1:
+                    return readAs<double>(metric);
+                case 2:
+                    return readAs<int>(metric);
+                case 3:
+                    return readAs<std::size_t>(metric);
+                case 4:
+                    return readAs<std::string>(metric);
+                default:
+                    return false;
+            }
+        }
+
+        bool readTrajectory(const RobotConstPtr &robot, const robot_state::RobotState &reference,
+                            robot_trajectory::RobotTrajectoryPtr &trajectory)
+        {
+            bool present;
+            if (not read(present))
+                return false;
+
+            trajectory.reset();
+            if (not present)
+                return true;
+
+            std::string group;
+            moveit_msgs::RobotTrajectory msg;
+            if (not read(group) or not readMessage(msg))
+                return false;
+
+            Trajectory result(robot, group);
+            result.useMessage(reference, msg);
+            trajectory = result.getTrajectory();
+            return true;
+        }
+
+    private:
+        template <typename T>
+        bool readAs(PlannerMetric &metric)
+        {
+            T value;
+            if (not read(value))
+                return false;
+
+            metric = value;
+            return true;
+        }
+
+        const std::string &buffer_;  ///< Bytes to read.
+        std::size_t offset_{0};      ///< Offset of the next read.
+    };
+
+    /** \brief Write the parts of a run computed by the profiler. The query is known to the parent. */
+    std::string encodeRun(const PlanData &run)
+    {
+        RunWriter writer;
+        writer.write(run.success);
+        writer.write(run.time);
+        writer.write(boost::posix_time::to_iso_string(run.start));
+        writer.write(boost::posix_time::to_iso_string(run.finish));
+        writer.write(run.hostname);
+        writer.write(run.process_id);
+        writer.write(run.thread_id);
+        writer.write(run.cpu_id);
+
+        writer.write(run.property_names.size());
+        for (const auto &name : run.property_names)
+            writer.write(name);
+
+        writer.write(run.progress.size());
+        for (const auto &point : run.progress)
+        {
+            writer.write(point.size());
+            for (const auto &value : point)
+            {
+                writer.write(value.first);
+                writer.write(value.second);
+            }
+        }
+
+        writer.write(run.metrics.size());
+        for (const auto &metric : run.metrics)
+        {
+            writer.write(metric.first);
+            writer.writeMetric(metric.second);
+        }
+
+        writer.write(run.response.error_code_.val);
+        writer.write(run.response.planning_time_);
+        const auto &trajectory = run.getTrajectory();
+        writer.writeTrajectory(run.getResponseTrajectory());
+        writer.writeTrajectory((trajectory) ? trajectory->getTrajectory() : nullptr);
+
+        return writer.buffer;
+    }
+
+    /** \brief Read a run written by encodeRun() into \a run, whose query must already be set. */
+    bool decodeRun(const std::string &buffer, PlanData &run)
+    {
+        RunReader reader(buffer);
+
+        std::string start, finish;
+        if (not reader.read(run.success) or not reader.read(run.time) or not reader.read(start) or
+            not reader.read(finish) or not reader.read(run.hostname) or not reader.read(run.process_id) or
+            not reader.read(run.thread_id) or not reader.read(run.cpu_id))
+            return false;
+
+        run.start = boost::posix_time::from_iso_string(start);
+        run.finish = boost::posix_time::from_iso_string(finish);
+
+        std::size_t size;
+        if (not reader.read(size))
+            return false;
+
+        run.property_names.resize(size);
+        for (auto &name : run.property_names)
+            if (not reader.read(name))
+                return false;
+
+        if (not reader.read(size))
+            return false;
+
+        run.progress.resize(size);
+        for (auto &point : run.progress)
+        {
+            if (not reader.read(size))
+                return false;
+
+            for (std::size_t i = 0; i < size; ++i)
+            {
+                std::string key, value;
+                if (not reader.read(key) or not reader.read(value))
+                    return false;
+
+                point.emplace(key, value);
+            }
+        }
+
+        if (not reader.read(size))
+            return false;
+
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            std::string name;
+            PlannerMetric metric;
+            if (not reader.read(name) or not reader.readMetric(metric))
+                return false;
+
+            run.metrics[name] = metric;
+        }
+
+        // Trajectories are rebuilt from the start state of the request.
+        const auto &robot = run.query.planner->getRobot();
+        robot_state::RobotState reference = run.query.scene->getCurrentStateConst();
+        moveit::core::robotStateMsgToRobotState(run.query.request.start_state, reference);
+
+        robot_trajectory::RobotTrajectoryPtr trajectory;
+        if (not reader.read(run.response.error_code_.val) or not reader.read(run.response.planning_time_) or
+            not reader.readTrajectory(robot, reference, run.response.trajectory_) or
+            not reader.readTrajectory(robot, reference, trajectory))
+            return false;
+
+        run.trajectory = (trajectory) ? std::make_shared<Trajectory>(trajectory) : nullptr;
+        return true;
+    }
+
+    /** \brief Write all of \a buffer to \a fd. */
+    bool writeAll(int fd, const std::string &buffer)
+    {
+        std::size_t offset = 0;
+        while (offset < buffer.size())
+        {
+            const ssize_t written = ::write(fd, buffer.data() + offset, buffer.size() - offset);
+            if (written < 0 and errno == EINTR)
+                continue;
+
+            if (written <= 0)
+                return false;
+
+            offset += written;
+        }
+
+        return true;
+    }
+
+    /** \brief Read from \a fd until the end of file, or until \a deadline. Returns false on timeout. */
+    bool readAll(int fd, std::string &buffer, std::chrono::steady_clock::time_point deadline)
+    {
+        char chunk[4096];
+        while (true)
+        {
+            const auto remaining = deadline - std::chrono::steady_clock::now();
+            const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(remaining).count();
+            if (ms <= 0)
+                return false;
+
+            pollfd poller{fd, POLLIN, 0};
+            const int timeout = (int)std::min<long long>(ms, std::numeric_limits<int>::max());
+            const int ready = ::poll(&poller, 1, timeout);
+            if (ready < 0 and errno == EINTR)
+                continue;
+
+            if (ready == 0)
+                return false;
+
+            const ssize_t n = (ready > 0) ? ::read(fd, chunk, sizeof(chunk)) : -1;
+            if (n < 0 and errno == EINTR)
+                continue;
+
+            // End of file, or an error, which is treated the same as the child crashing.
+            if (n <= 0)
+                return true;
+
+            buffer.append(chunk, n);
+        }
+    }
+}  // namespace
+
+bool Profiler::profilePlanIsolated(const PlannerPtr &planner,                             //
+                                   const SceneConstPtr &scene,                            //
+                                   const planning_interface::MotionPlanRequest &request,  //
+                                   const Options &options,                                //
+                                   PlanData &result) const
+{
+    result.query.scene = scene;
+    result.query.planner = planner;
+    result.query.request = request;
+
+    auto child_options = options;
+    child_options.isolate = false;
+
+    int fds[2];
+    if (::pipe(fds) != 0)
+    {
+        RBX_WARN("Failed to create pipe for isolated run: %s, running in process", std::strerror(errno));
+        return profilePlan(planner, scene, request, child_options, result);
+    }
+
+    const double kill_time = request.allowed_planning_time + options.kill_time;
+
+    result.start = IO::getDate();
+    const auto deadline = std::chrono::steady_clock::now() +
+                          std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                              std::chrono::duration<double>(kill_time));
+
+    const pid_t pid = ::fork();
+    if (pid < 0)
+    {
+        ::close(fds[0]);
+        ::close(fds[1]);
 
-                std::unique_lock<std::mutex> lock(mutex);
-                if (not at_least_once and complete)
-                    return;
+        RBX_WARN("Failed to fork for isolated run: %s, running in process", std::strerror(errno));
+        return profilePlan(planner, scene, request, child_options, result);
+    }
 
-                if (have_prog)
-                {
-                    std::map<std::string, std::string> data;
+    if (pid == 0)
+    {
+        // Child. Exit without running destructors, which would wait on threads that were not forked.
+        ::close(fds[0]);
+        ProgressSampler::atFork();
 
-                    // Add time stamp
-                    double time = IO::getSeconds(result.start, IO::getDate());
-                    data["time REAL"] = std::to_string(time);
+        int status = 1;
+        try
+        {
+            PlanData run;
+            profilePlan(planner, scene, request, child_options, run);
+            if (writeAll(fds[1], encodeRun(run)))
+                status = 0;
+        }
+        catch (...)
+        {
+        }
 
-                    // Compute properties
-                    for (const auto &property : prog_props)
-                        data[property.first] = property.second();
+        ::_exit(status);
+    }
 
-                    result.progress.emplace_back(data);
-                }
+    ::close(fds[1]);
 
-                for (const auto &callback : prog_call)
-                    callback(planner, scene, request, result);
+    std::string buffer;
+    const bool finished = readAll(fds[0], buffer, deadline);
+    if (not finished)
+        ::kill(pid, SIGKILL);
 
-                at_least_once = false;
-            }
-        }));
-    }
+    ::close(fds[0]);
 
-    // Plan
-    result.response = planner->plan(scene, request);
+    int status = 0;
+    struct rusage usage;
+    while (::wait4(pid, &status, 0, &usage) < 0 and errno == EINTR)
+        ;
 
-    // Notify planner progress thread
+    const bool exited = finished and WIFEXITED(status) and WEXITSTATUS(status) == 0;
+    if (not exited or not decodeRun(buffer, result))
     {
-        std::unique_lock<std::mutex> lock(mutex);
-        complete = true;
+        if (not finished)
+            RBX_ERROR("Isolated run of `%s` was killed after %s seconds", planner->getName(), kill_time);
+        else if (WIFSIGNALED(status))
+            RBX_ERROR("Isolated run of `%s` crashed with signal %s", planner->getName(), WTERMSIG(status));
+        else
+            RBX_ERROR("Isolated run of `%s` failed with status %s", planner->getName(), WEXITSTATUS(status));
+
+        result.finish = IO::getDate();
+        result.time = IO::getSeconds(result.start, result.finish);
+        result.success = false;
+        result.trajectory.reset();
+        result.response = planning_interface::MotionPlanResponse();
+        result.response.error_code_.val = moveit_msgs::MoveItErrorCodes::FAILURE;
+        result.property_names.clear();
+        result.progress.clear();
+        result.metrics.clear();
+
+        static const std::string hostname = IO::getHostname();
+        result.hostname = hostname;
+        result.process_id = pid;
+        result.thread_id = 0;
+        result.cpu_id = -1;
+
+        // Failed runs get the same metrics as any other failure.
+        if (options.compute_metrics)
+            computeMetrics(options, result);
+
+        result.metrics["process_crashed"] = true;
     }
+    else
+        result.metrics["process_crashed"] = false;
 
-    // Compute metrics and fill out results
-    result.finish = IO::getDate();
-    result.time = IO::getSeconds(result.start, result.finish);
-    result.success = result.response.error_code_.val == moveit_msgs::MoveItErrorCodes::SUCCESS;
+    result.metrics["process_signal"] = (WIFSIGNALED(status)) ? WTERMSIG(status) : 0;
+    result.metrics["process_peak_rss"] = usage.ru_maxrss / 1024.;
+    result.metrics["process_cpu_time"] = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec * 1e-6 +  //
+                                         usage.ru_stime.tv_sec + usage.ru_stime.tv_usec * 1e-6;
+    result.metrics["process_minor_faults"] = (std::size_t)usage.ru_minflt;
+    result.metrics["process_major_faults"] = (std::size_t)usage.ru_majflt;
 
-    if (result.success)
-        result.trajectory = std::make_shared<Trajectory>(*result.response.trajectory_);
+    return result.success;
+}
 
-    result.hostname = IO::getHostname();
-    result.process_id = IO::getProcessID();
-    result.thread_id = IO::getThreadID();
+void Profiler::computeMetrics(const Options &options, PlanData &result) const
+{
+    RBX_TRACE("Profiler::computeMetrics");
 
-    computeBuiltinMetrics(options.metrics, scene, result);
-    computeCallbackMetrics(planner, scene, request, result);
+    const bool allocations = options.allocations and startAllocations();
 
-    if (progress_thread)
-        progress_thread->join();
+    if (options.shortcut and result.trajectory)
+    {
+        const auto start = IO::getDate();
+        const double saving =
+            result.trajectory->shortcut(result.query.scene, Planner::getExecutor(), options.shortcut_options);
 
-    return result.success;
+        result.metrics["shortcut_time"] = IO::getSeconds(start, IO::getDate());
+        result.metrics["shortcut_length_saved"] = saving;
+    }
+
+    if (options.parameterize)
+        parameterizeRun(result, options.parameterization, 1., 1.);
+
+    const auto start = IO::getDate();
+    computeBuiltinMetrics(options.metrics, result.query.scene, result);
+    computeCallbackMetrics(result.query.planner, result.query.scene, result.query.request, result);
+    result.metrics["metrics_time"] = IO::getSeconds(start, IO::getDate());
+
+    if (allocations)
+        stopAllocations("metrics", result.metrics);
 }
 
 void Profiler::addMetricCallback(const std::string &name, const ComputeMetricCallback &metric)
@@ -267,29 +1539,53 @@ void Profiler::computeBuiltinMetrics(uint32_t options, const SceneConstPtr &scen
     if (options & Metrics::WAYPOINTS)
         run.metrics["waypoints"] = run.success ? int(run.trajectory->getNumWaypoints()) : int(0);
 
+    // Compute all trajectory metrics in one pass.
+    uint32_t mask = 0;
+    mask |= (options & Metrics::LENGTH) ? Trajectory::LENGTH : 0;
+    mask |= (options & Metrics::CORRECT) ? Trajectory::CORRECT : 0;
+    mask |= (options & Metrics::CLEARANCE) ? Trajectory::CLEARANCE : 0;
+    mask |= (options & Metrics::SMOOTHNESS) ? Trajectory::SMOOTHNESS : 0;
+
+    Trajectory::Metrics metrics;
+    if (run.success and mask)
+        metrics = run.trajectory->computeMetrics(mask, scene);
+
     if (options & Metrics::LENGTH)
-        run.metrics["length"] = run.success ? run.trajectory->getLength() : 0.0;
+        run.metrics["length"] = run.success ? metrics.length : 0.0;
 
     if (options & Metrics::CORRECT)
-        run.metrics["correct"] = run.success ? run.trajectory->isCollisionFree(scene) : false;
+        run.metrics["correct"] = run.success ? metrics.correct : false;
 
     if (options & Metrics::CLEARANCE)
-        run.metrics["clearance"] = run.success ? std::get<0>(run.trajectory->getClearance(scene)) : 0.0;
+        run.metrics["clearance"] = run.success ? metrics.clearance : 0.0;
 
     if (options & Metrics::SMOOTHNESS)
-        run.metrics["smoothness"] = run.success ? run.trajectory->getSmoothness() : 0.0;
-
-    run.metrics["robowflex_planner_name"] = run.query.planner->getName();
-    run.metrics["robowflex_robot_name"] = run.query.planner->getRobot()->getName();
+        run.metrics["smoothness"] = run.success ? metrics.smoothness : 0.0;
 
-    run.metrics["request_planner_type"] = std::string(ROBOWFLEX_DEMANGLE(typeid(*run.query.planner).name()));
-    run.metrics["request_planner_id"] = run.query.request.planner_id;
-    run.metrics["request_group_name"] = run.query.request.group_name;
-    run.metrics["request_num_planning_attempts"] = run.query.request.num_planning_attempts;
+    if (not run.constant_metrics)
+        computeConstantMetrics(run.query.planner, run.query.request, run.metrics);
 
-    run.metrics["machine_hostname"] = run.hostname;
     run.metrics["machine_thread_id"] = run.thread_id;
-    run.metrics["machine_process_id"] = run.process_id;
+    run.metrics["machine_cpu_id"] = run.cpu_id;
+}
+
+void Profiler::computeConstantMetrics(const PlannerPtr &planner,                             //
+                                      const planning_interface::MotionPlanRequest &request,  //
+                                      std::map<std::string, PlannerMetric> &metrics) const
+{
+    static const std::string hostname = IO::getHostname();
+    static const std::size_t process_id = IO::getProcessID();
+
+    metrics["robowflex_planner_name"] = planner->getName();
+    metrics["robowflex_robot_name"] = planner->getRobot()->getName();
+
+    metrics["request_planner_type"] = std::string(ROBOWFLEX_DEMANGLE(typeid(*planner).name()));
+    metrics["request_planner_id"] = request.planner_id;
+    metrics["request_group_name"] = request.group_name;
+    metrics["request_num_planning_attempts"] = request.num_planning_attempts;
+
+    metrics["machine_hostname"] = hostname;
+    metrics["machine_process_id"] = process_id;
 }
 
 void Profiler::computeCallbackMetrics(const PlannerPtr &planner,                             //
@@ -340,189 +1636,695 @@ Profiler::Options &Experiment::getOptions()
     return options_;
 }
 
-Profiler &Experiment::getProfiler()
-{
-    return profiler_;
-}
+Profiler &Experiment::getProfiler()
+{
+    return profiler_;
+}
+
+const Profiler &Experiment::getProfilerConst() const
+{
+    return profiler_;
+}
+
+const std::vector<PlanningQuery> &Experiment::getQueries() const
+{
+    return queries_;
+}
+
+void Experiment::enableMultipleRequests()
+{
+    enforce_single_thread_ = false;
+}
+
+void Experiment::overridePlanningTime()
+{
+    override_planning_time_ = false;
+}
+
+void Experiment::setResultQueueSize(std::size_t size)
+{
+    result_queue_size_ = size;
+}
+
+void Experiment::setShard(std::size_t index, std::size_t count)
+{
+    if (count == 0 or index >= count)
+        throw Exception(1, log::format("Invalid shard %1% of %2%!", index, count));
+
+    shard_ = index;
+    shards_ = count;
+}
+
+void Experiment::setMetricThreads(std::size_t n_threads)
+{
+    metric_threads_ = n_threads;
+}
+
+void Experiment::setAdaptiveScheduling(bool adaptive)
+{
+    adaptive_scheduling_ = adaptive;
+}
+
+void Experiment::setAffinity(const Pool::Affinity &affinity)
+{
+    affinity_ = affinity;
+}
+
+void Experiment::setWarmupTrials(std::size_t n)
+{
+    warmup_trials_ = n;
+}
+
+void Experiment::setColdTrials(bool cold)
+{
+    cold_ = cold;
+}
+
+void Experiment::setTimeBudget(double budget)
+{
+    time_budget_ = budget;
+}
+
+void Experiment::setAdaptiveTrials(const std::string &metric, double width, std::size_t min_trials,
+                                   std::size_t max_trials, double confidence)
+{
+    if (min_trials < 2 or max_trials < min_trials or width <= 0. or confidence <= 0. or confidence >= 1.)
+        throw Exception(1, log::format("Invalid adaptive trials of %1% to %2% trials!", min_trials,
+                                       max_trials));
+
+    adaptive_metric_ = metric;
+    adaptive_width_ = width;
+    adaptive_confidence_ = confidence;
+    min_trials_ = min_trials;
+    max_trials_ = max_trials;
+}
+
+void Experiment::addStreamOutputter(const PlanDataStreamOutputterPtr &outputter)
+{
+    streams_.emplace_back(outputter);
+}
+
+void Experiment::setTraceFile(const std::string &filename)
+{
+    trace_file_ = filename;
+}
+
+void Experiment::setRetainStreamedData(bool retain)
+{
+    retain_streamed_ = retain;
+}
+
+void Experiment::setCompactTrajectories(bool compact)
+{
+    compact_trajectories_ = compact;
+}
+
+void Experiment::setPreRunCallback(const PreRunCallback &callback)
+{
+    pre_callback_ = callback;
+}
+
+void Experiment::setPostRunCallback(const PostRunCallback &callback)
+{
+    post_callback_ = callback;
+}
+
+void Experiment::setPostQueryCallback(const PostQueryCallback &callback)
+{
+    complete_callback_ = callback;
+}
+
+PlanDataSetPtr Experiment::benchmark(std::size_t n_threads) const
+{
+    // With adaptive trials, the trial count is an upper bound.
+    const bool adaptive_trials = not adaptive_metric_.empty();
+    const std::size_t trials = (adaptive_trials) ? max_trials_ : trials_;
+
+    if (not trace_file_.empty())
+        log::trace::clear();
+
+    // Setup dataset to return
+    auto dataset = std::make_shared<PlanDataSet>();
+    dataset->name = name_;
+    dataset->start = IO::getDate();
+    dataset->allowed_time = allowed_time_;
+    dataset->trials = trials;
+    dataset->enforced_single_thread = enforce_single_thread_;
+    dataset->run_till_timeout = timeout_;
+    dataset->threads = n_threads;
+    dataset->shard = shard_;
+    dataset->shards = shards_;
+    dataset->warmup_trials = warmup_trials_;
+    dataset->cold = cold_;
+    dataset->queries = queries_;
+
+    struct ThreadInfo
+    {
+        ThreadInfo() = default;
+        ThreadInfo(const PlanningQuery *query, std::size_t trial, std::size_t index)
+          : query(query), trial(trial), index(index)
+        {
+        }
+
+        const PlanningQuery *query;
+        std::size_t trial;
+        std::size_t index;
+    };
+
+    std::vector<ThreadInfo> todo;
+
+    for (std::size_t i = 0; i < queries_.size(); ++i)
+    {
+        const auto &query = queries_[i];
+
+        // Check if this name is unique, if so, add it to dataset list.
+        const auto &it = std::find(dataset->query_names.begin(), dataset->query_names.end(), query.name);
+        if (it == dataset->query_names.end())
+            dataset->query_names.emplace_back(query.name);
+
+        for (std::size_t j = 0; j < trials; ++j)
+        {
+            // Deal out (query, trial) pairs to shards in order, so the split is the same in every process.
+            const std::size_t item = i * trials + j;
+            if (item % shards_ == shard_)
+                todo.emplace_back(&query, j, i);
+        }
+    }
+
+    // Metrics that are the same for every run of a query are computed once.
+    std::vector<std::shared_ptr<const std::map<std::string, PlannerMetric>>> constants;
+    for (const auto &query : queries_)
+    {
+        planning_interface::MotionPlanRequest request = query.request;
+        if (enforce_single_thread_)
+            request.num_planning_attempts = 1;
+
+        auto metrics = std::make_shared<std::map<std::string, PlannerMetric>>();
+        profiler_.computeConstantMetrics(query.planner, request, *metrics);
+        metrics->emplace("query_shard", (int)shard_);
+
+        constants.emplace_back(std::move(metrics));
+    }
+
+    if (shards_ > 1)
+        RBX_INFO("Running shard %1% of %2%: %3% of %4% trials", shard_, shards_, todo.size(),
+                 queries_.size() * trials);
+
+    // Completed runs are passed from the workers to this thread for aggregation.
+    using Result = std::pair<PlanDataPtr, const PlanningQuery *>;
+    BoundedQueue<Result> results((result_queue_size_) ? result_queue_size_ : 2 * n_threads);
+
+    std::atomic<std::size_t> outstanding(0);
+    std::atomic<std::size_t> completed_queries(0);
+
+    // Time spent by workers blocked on shared state, in nanoseconds.
+    std::atomic<std::uint64_t> waited(0);
+    const auto wait = [&](const std::chrono::steady_clock::time_point &start) {
+        waited += std::chrono::duration_cast<std::chrono::nanoseconds>(  //
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+    };
+    const std::size_t total_queries = todo.size();
+
+    // Close the result queue once the last trial or metric job is finished, even if it throws.
+    struct Finish
+    {
+        std::atomic<std::size_t> &outstanding;
+        BoundedQueue<Result> &results;
+        ~Finish()
+        {
+            if (--outstanding == 0)
+                results.close();
+        }
+    };
+
+    // Optional stage that computes metrics for runs off of the planning threads.
+    std::unique_ptr<Pool> metric_pool;
+    std::mutex metric_mutex;
+    std::vector<std::shared_ptr<Pool::Job<void>>> metric_jobs;
+
+    auto profiler_options = options_;
+    if (metric_threads_ > 0)
+    {
+        metric_pool.reset(new Pool(metric_threads_));
+        profiler_options.compute_metrics = false;
+    }
+
+    TrialScheduler scheduler(queries_.size(), adaptive_scheduling_, time_budget_);
+    if (adaptive_trials)
+        scheduler.setStopping(min_trials_, adaptive_width_, adaptive_confidence_);
+
+    const auto finish_run = [&](const PlanDataPtr &data, const PlanningQuery *query) {
+        if (metric_pool and options_.compute_metrics)
+            profiler_.computeMetrics(options_, *data);
+
+        double value;
+        if (adaptive_trials and data->getMetricValue(adaptive_metric_, value))
+            scheduler.addValue(query - queries_.data(), value);
+
+        if (post_callback_)
+            post_callback_(*data, *query);
+
+        if (compact_trajectories_)
+            data->compact();
+
+        const auto start = std::chrono::steady_clock::now();
+        results.push(Result(data, query));
+        wait(start);
+    };
+
+    // Runs a trial once with \a time_remaining seconds of planning time. Returns the planning time used.
+    const auto run = [&](const ThreadInfo &info, double time_remaining, std::size_t timeout_trial) {
+        planning_interface::MotionPlanRequest request = info.query->request;
+        request.allowed_planning_time = time_remaining;
+
+        if (enforce_single_thread_)
+            request.num_planning_attempts = 1;
+
+        // In cold mode, every trial pays the one-time costs of the first.
+        if (cold_)
+        {
+            info.query->planner->clearCaches();
+            if (const auto &cache = info.query->planner->getRobot()->getIKCache())
+                cache->clear();
+        }
+
+        // Call pre-run callbacks
+        info.query->planner->preRun(info.query->scene, request);
+
+        if (pre_callback_)
+            pre_callback_(*info.query);
+
+        // Profile query
+        auto data = std::make_shared<PlanData>();
+        data->constant_metrics = constants[info.index];
+        profiler_.profilePlan(info.query->planner,  //
+                              info.query->scene,    //
+                              request,              //
+                              profiler_options,     //
+                              *data);
+
+        // Add experiment specific metrics
+        data->metrics.emplace("query_trial", (int)info.trial);
+        data->metrics.emplace("query_index", (int)info.index);
+        data->metrics.emplace("query_timeout_trial", (int)timeout_trial);
+        data->metrics.emplace("query_start_time", IO::getSeconds(dataset->start, data->start));
+        data->metrics.emplace("query_finish_time", IO::getSeconds(dataset->start, data->finish));
+
+        data->query.name = log::format("%1%:%2%:%3%", info.query->name, info.trial, info.index);
+
+        if (timeout_)
+            data->query.name = data->query.name + log::format(":%4%", timeout_trial);
+
+        const double time = data->time;
+        if (metric_pool)
+        {
+            ++outstanding;
+            auto job = metric_pool->submit(make_function([&, data, query = info.query] {
+                Finish finish{outstanding, results};
+                finish_run(data, query);
+            }));
+
+            std::unique_lock<std::mutex> lock(metric_mutex);
+            metric_jobs.emplace_back(job);
+        }
+        else
+            finish_run(data, info.query);
+
+        return time;
+    };
+
+    for (std::size_t i = 0; i < todo.size(); ++i)
+    {
+        const auto &info = todo[i];
+
+        // If override, use global time. Else use query time.
+        const double time =
+            (override_planning_time_) ? allowed_time_ : info.query->request.allowed_planning_time;
+        scheduler.add({i, info.index, info.trial, time});
+    }
+
+    // Each worker takes trials from the scheduler until there are none left.
+    const auto work = [&](std::size_t /*worker*/) {
+        Finish finish{outstanding, results};
+        std::size_t id = IO::getThreadID();
+
+        TrialScheduler::Item item;
+        while (true)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            const bool next = scheduler.next(item);
+            wait(start);
+
+            if (not next)
+                break;
+
+            const auto &info = todo[item.todo];
+            if (item.timeout_trial == 0)
+                RBX_INFO("[Thread %1%] Running Query %3% `%2%` Trial [%4%/%5%]",  //
+                         id, info.query->name, info.index, info.trial + 1, trials);
+
+            try
+            {
+                // In order, a worker stays on a trial until its time runs out. Otherwise, the remainder
+                // is handed back to the scheduler after each run.
+                do
+                {
+                    const auto start = TrialScheduler::Clock::now();
+                    const double time = run(info, item.time_remaining, item.timeout_trial);
+                    const std::chrono::duration<double> wall = TrialScheduler::Clock::now() - start;
+                    scheduler.record(item.query, wall.count());
+
+                    if (timeout_)
+                    {
+                        item.time_remaining -= time;
+                        RBX_INFO(                                                                           //
+                            "[Thread %1%] Running Query %3% `%2%` till timeout, %4% seconds remaining...",  //
+                            id, info.query->name, info.index, item.time_remaining);
+                        item.timeout_trial++;
+                    }
+                    else
+                        item.time_remaining = 0;
+                } while (item.time_remaining > 0. and not adaptive_scheduling_);
+            }
+            catch (...)
+            {
+                scheduler.finish();
+                throw;
+            }
+
+            if (item.time_remaining > 0.)
+            {
+                scheduler.finish(&item);
+                continue;
+            }
+
+            scheduler.finish();
+            RBX_INFO("[Thread %1%] Completed Query %3% `%2%` Trial [%4%/%5%] Total: [%6%/%7%]",  //
+                     id, info.query->name, info.index,                                           //
+                     info.trial + 1, trials,                                                     //
+                     ++completed_queries, total_queries);
+        }
+    };
+
+    const std::size_t workers = std::min(std::max<std::size_t>(1, n_threads), todo.size());
+    outstanding += workers;
+
+    Pool pool(std::max<std::size_t>(1, n_threads), Pool::Scheduler::SHARED, affinity_);
+
+    // Warm-up trials are run on the benchmarking threads before any recorded trial, and discarded.
+    if (warmup_trials_ > 0)
+    {
+        RBX_INFO("Running %1% warm-up trials for each of %2% queries", warmup_trials_, queries_.size());
+
+        auto warmup_options = options_;
+        warmup_options.compute_metrics = false;
+        warmup_options.progress = false;
+
+        pool.parallelFor(
+            0, queries_.size() * warmup_trials_,
+            [&](std::size_t i) {
+                const auto &query = queries_[i / warmup_trials_];
+
+                planning_interface::MotionPlanRequest request = query.request;
+                if (override_planning_time_)
+                    request.allowed_planning_time = allowed_time_;
+                if (enforce_single_thread_)
+                    request.num_planning_attempts = 1;
+
+                query.planner->preRun(query.scene, request);
+
+                PlanData data;
+                profiler_.profilePlan(query.planner, query.scene, request, warmup_options, data);
+            },
+            1);
+    }
+
+    auto batch = pool.submitFor(0, workers, work, 1);
+
+    if (workers == 0)
+        results.close();
+
+    for (const auto &stream : streams_)
+        stream->begin(*dataset);
+
+    // Aggregate results as they complete.
+    Result result;
+    while (results.pop(result))
+    {
+        auto &data = result.first;
+        const auto &query_name = result.second->name;
+
+        for (const auto &stream : streams_)
+            stream->stream(*dataset, query_name, *data);
+
+        if (not streams_.empty() and not retain_streamed_)
+        {
+            data->trajectory.reset();
+            data->response.trajectory_.reset();
+            data->compact_trajectory.reset();
+            data->compact_response_trajectory.reset();
+            data->progress.clear();
+            data->progress.shrink_to_fit();
+        }
+
+        dataset->addDataPoint(query_name, data);
+
+        if (complete_callback_)
+            complete_callback_(dataset, *result.second);
+    }
+
+    batch->get();
+    for (const auto &job : metric_jobs)
+        job->get();
+
+    if (const std::size_t skipped = scheduler.getSkipped())
+        RBX_WARN("Time budget of %1% seconds reached, skipped %2% of %3% trials", time_budget_, skipped,
+                 total_queries);
 
-const Profiler &Experiment::getProfilerConst() const
-{
-    return profiler_;
-}
+    if (const std::size_t stopped = scheduler.getStopped())
+        RBX_INFO("Confidence intervals of `%1%` converged, skipped %2% of %3% trials", adaptive_metric_,
+                 stopped, total_queries);
 
-const std::vector<PlanningQuery> &Experiment::getQueries() const
-{
-    return queries_;
-}
+    dataset->finish = IO::getDate();
+    dataset->time = IO::getSeconds(dataset->start, dataset->finish);
+    dataset->wait_time = waited * 1e-9;
 
-void Experiment::enableMultipleRequests()
-{
-    enforce_single_thread_ = false;
-}
+    if (not trace_file_.empty())
+        log::trace::exportChromeTrace(trace_file_);
 
-void Experiment::overridePlanningTime()
-{
-    override_planning_time_ = false;
+    for (const auto &stream : streams_)
+        stream->end(*dataset);
+
+    return dataset;
 }
 
-void Experiment::setPreRunCallback(const PreRunCallback &callback)
+///
+/// ThreadScaling
+///
+
+ThreadScaling::ThreadScaling(const ExperimentPtr &experiment)
+  : ThreadScaling([experiment](std::size_t /*threads*/) { return experiment; })
 {
-    pre_callback_ = callback;
 }
 
-void Experiment::setPostRunCallback(const PostRunCallback &callback)
+ThreadScaling::ThreadScaling(const ExperimentFactory &factory) : factory_(factory)
 {
-    post_callback_ = callback;
 }
 
-void Experiment::setPostQueryCallback(const PostQueryCallback &callback)
+std::vector<std::size_t> ThreadScaling::getThreadCounts(std::size_t max)
 {
-    complete_callback_ = callback;
+    std::vector<std::size_t> threads;
+    for (std::size_t n = 1; n < max; n *= 2)
+        threads.emplace_back(n);
+
+    threads.emplace_back(std::max<std::size_t>(1, max));
+    return threads;
 }
 
-PlanDataSetPtr Experiment::benchmark(std::size_t n_threads) const
+const std::vector<ThreadScaling::Level> &ThreadScaling::run(const std::vector<std::size_t> &threads)
 {
-    // Setup dataset to return
-    auto dataset = std::make_shared<PlanDataSet>();
-    dataset->name = name_;
-    dataset->start = IO::getDate();
-    dataset->allowed_time = allowed_time_;
-    dataset->trials = trials_;
-    dataset->enforced_single_thread = enforce_single_thread_;
-    dataset->run_till_timeout = timeout_;
-    dataset->threads = n_threads;
-    dataset->queries = queries_;
+    levels_.clear();
+    datasets_.clear();
 
-    struct ThreadInfo
+    for (const auto &n : threads)
     {
-        ThreadInfo() = default;
-        ThreadInfo(const PlanningQuery *query, std::size_t trial, std::size_t index)
-          : query(query), trial(trial), index(index)
-        {
-        }
+        RBX_INFO("Benchmarking scaling with %1% threads", n);
 
-        const PlanningQuery *query;
-        std::size_t trial;
-        std::size_t index;
-    };
+        const auto &experiment = factory_(n);
+        const auto &dataset = experiment->benchmark(n);
 
-    std::queue<ThreadInfo> todo;
-    std::mutex mutex;
+        Level level;
+        level.threads = n;
+        level.time = dataset->time;
 
-    for (std::size_t i = 0; i < queries_.size(); ++i)
-    {
-        const auto &query = queries_[i];
+        const auto &runs = dataset->getFlatData();
+        level.runs = runs.size();
 
-        // Check if this name is unique, if so, add it to dataset list.
-        const auto &it = std::find(dataset->query_names.begin(), dataset->query_names.end(), query.name);
-        if (it == dataset->query_names.end())
-            dataset->query_names.emplace_back(query.name);
+        double total = 0;
+        for (const auto &run : runs)
+            total += run->time;
+
+        level.throughput = (level.time > 0) ? level.runs / level.time : 0.;
+        level.run_time = (level.runs) ? total / level.runs : 0.;
+        level.wait = (level.runs) ? dataset->wait_time / level.runs : 0.;
+
+        // Relative to the first level, which is the baseline.
+        const Level &base = (levels_.empty()) ? level : levels_.front();
+        level.speedup = (base.throughput > 0) ? level.throughput / base.throughput : 0.;
+        level.efficiency = level.speedup * base.threads / n;
+        level.inflation = (base.run_time > 0) ? level.run_time / base.run_time : 0.;
+
+        RBX_INFO("%1% threads: %2% runs/s, speedup %3%, efficiency %4%, run time inflation %5%, "
+                 "wait %6%s per run",
+                 n, level.throughput, level.speedup, level.efficiency, level.inflation, level.wait);
 
-        for (std::size_t j = 0; j < trials_; ++j)
-            todo.emplace(&query, j, i);
+        levels_.emplace_back(level);
+        datasets_.emplace_back(dataset);
     }
 
-    std::vector<std::shared_ptr<std::thread>> threads;
-    std::size_t completed_queries = 0;
-    std::size_t total_queries = todo.size();
+    return levels_;
+}
 
-    for (std::size_t i = 0; i < n_threads; ++i)
-        threads.emplace_back(std::make_shared<std::thread>([&]() {
-            std::size_t id = IO::getThreadID();
-            while (true)
-            {
-                ThreadInfo info;
+const std::vector<ThreadScaling::Level> &ThreadScaling::getLevels() const
+{
+    return levels_;
+}
 
-                {
-                    std::unique_lock<std::mutex> lock(mutex);
-                    if (todo.empty())  // All done, exit.
-                        return;
+const std::vector<PlanDataSetPtr> &ThreadScaling::getDataSets() const
+{
+    return datasets_;
+}
 
-                    info = todo.front();
-                    todo.pop();
-                }
+bool ThreadScaling::toCSVFile(const std::string &filename) const
+{
+    std::ofstream out;
+    IO::createFile(out, filename);
+    if (not out.is_open())
+    {
+        RBX_ERROR("Failed to open %s for writing", filename);
+        return false;
+    }
 
-                RBX_INFO("[Thread %1%] Running Query %3% `%2%` Trial [%4%/%5%]",  //
-                         id, info.query->name, info.index, info.trial + 1, trials_);
+    out << "threads,runs,time,throughput,speedup,efficiency,run_time,inflation,wait" << std::endl;
+    for (const auto &level : levels_)
+        out << level.threads << "," << level.runs << "," << level.time << "," << level.throughput << ","
+            << level.speedup << "," << level.efficiency << "," << level.run_time << "," << level.inflation
+            << "," << level.wait << std::endl;
 
-                // If override, use global time. Else use query time.
-                double time_remaining =
-                    (override_planning_time_) ? allowed_time_ : info.query->request.allowed_planning_time;
+    out.close();
+    return true;
+}
 
-                std::size_t timeout_trial = 0;
-                while (time_remaining > 0.)
-                {
-                    planning_interface::MotionPlanRequest request = info.query->request;
-                    request.allowed_planning_time = time_remaining;
+///
+/// PlanDataStreamOutputter
+///
 
-                    if (enforce_single_thread_)
-                        request.num_planning_attempts = 1;
+void PlanDataStreamOutputter::begin(const PlanDataSet & /*dataset*/)
+{
+}
 
-                    // Call pre-run callbacks
-                    info.query->planner->preRun(info.query->scene, request);
+void PlanDataStreamOutputter::end(const PlanDataSet & /*dataset*/)
+{
+}
 
-                    if (pre_callback_)
-                        pre_callback_(*info.query);
+///
+/// JSONLPlanDataStreamOutputter
+///
 
-                    // Profile query
-                    auto data = std::make_shared<PlanData>();
-                    profiler_.profilePlan(info.query->planner,  //
-                                          info.query->scene,    //
-                                          request,              //
-                                          options_,             //
-                                          *data);
+namespace
+{
+    /** \brief Quote and escape \a value as a JSON string. */
+    std::string toJSONString(const std::string &value)
+    {
+        std::string out = "\"";
+        for (const char c : value)
+        {
+            switch (c)
+            {
+                case '"':
+                    out += "\\\"";
+                    break;
+                case '\\':
+                    out += "\\\\";
+                    break;
+                case '\n':
+                    out += "\\n";
+                    break;
+                case '\t':
+                    out += "\\t";
+                    break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20)
+                        out += log::format("\\u%04x", (int)c);
+                    else
+                        out += c;
+            }
+        }
 
-                    // Add experiment specific metrics
-                    data->metrics.emplace("query_trial", (int)info.trial);
-                    data->metrics.emplace("query_index", (int)info.index);
-                    data->metrics.emplace("query_timeout_trial", (int)timeout_trial);
-                    data->metrics.emplace("query_start_time", IO::getSeconds(dataset->start, data->start));
-                    data->metrics.emplace("query_finish_time", IO::getSeconds(dataset->start, data->finish));
+        return out + "\"";
+    }
 
-                    data->query.name = log::format("%1%:%2%:%3%", info.query->name, info.trial, info.index);
+    /** \brief Convert a planner metric into a JSON value. */
+    std::string toJSONMetric(const PlannerMetric &metric)
+    {
+        if (const auto *value = boost::get<std::string>(&metric))
+            return toJSONString(*value);
 
-                    if (timeout_)
-                        data->query.name = data->query.name + log::format(":%4%", timeout_trial);
+        if (const auto *value = boost::get<bool>(&metric))
+            return (*value) ? "true" : "false";
 
-                    if (post_callback_)
-                        post_callback_(*data, *info.query);
+        return toMetricString(metric);
+    }
+}  // namespace
 
-                    {
-                        std::unique_lock<std::mutex> lock(mutex);
+JSONLPlanDataStreamOutputter::JSONLPlanDataStreamOutputter(const std::string &file) : file_(file)
+{
+}
 
-                        dataset->addDataPoint(info.query->name, data);
-                        completed_queries++;
+JSONLPlanDataStreamOutputter::~JSONLPlanDataStreamOutputter()
+{
+    outfile_.close();
+}
 
-                        if (complete_callback_)
-                            complete_callback_(dataset, *info.query);
-                    }
+void JSONLPlanDataStreamOutputter::stream(const PlanDataSet &dataset, const std::string &query_name,
+                                          const PlanData &run)
+{
+    if (not is_init_)
+    {
+        IO::createFile(outfile_, file_);
+        is_init_ = true;
+    }
 
-                    if (timeout_)
-                    {
-                        time_remaining -= data->time;
-                        RBX_INFO(                                                                           //
-                            "[Thread %1%] Running Query %3% `%2%` till timeout, %4% seconds remaining...",  //
-                            id, info.query->name, info.index, time_remaining);
-                        timeout_trial++;
-                    }
-                    else
-                        time_remaining = 0;
-                }
+    outfile_ << "{";
+    outfile_ << "\"experiment\":" << toJSONString(dataset.name) << ",";
+    outfile_ << "\"query\":" << toJSONString(query_name) << ",";
+    outfile_ << "\"name\":" << toJSONString("run_" + run.query.name) << ",";
+    outfile_ << "\"time\":" << run.time << ",";
+    outfile_ << "\"success\":" << ((run.success) ? "true" : "false");
 
-                RBX_INFO("[Thread %1%] Completed Query %3% `%2%` Trial [%4%/%5%] Total: [%6%/%7%]",  //
-                         id, info.query->name, info.index,                                           //
-                         info.trial + 1, trials_,                                                    //
-                         completed_queries, total_queries);
-            }
-        }));
+    for (const auto &metric : run.getAllMetrics())
+        outfile_ << "," << toJSONString(metric.first) << ":" << toJSONMetric(metric.second);
 
-    for (const auto &thread : threads)
-        thread->join();
+    outfile_ << ",\"progress\":[";
+    for (std::size_t i = 0; i < run.progress.size(); ++i)
+    {
+        if (i != 0)
+            outfile_ << ",";
 
-    dataset->finish = IO::getDate();
-    dataset->time = IO::getSeconds(dataset->start, dataset->finish);
+        outfile_ << "{";
+        bool first = true;
+        for (const auto &property : run.progress[i])
+        {
+            if (not first)
+                outfile_ << ",";
 
-    return dataset;
+            outfile_ << toJSONString(property.first) << ":" << toJSONString(property.second);
+            first = false;
+        }
+        outfile_ << "}";
+    }
+    outfile_ << "]}" << std::endl;
 }
 
 ///
@@ -565,7 +2367,7 @@ void JSONPlanDataSetOutputter::dump(const PlanDataSet &results)
         outfile_ << "\"time\":" << run->time << ",";
         outfile_ << "\"success\":" << run->success;
 
-        for (const auto &metric : run->metrics)
+        for (const auto &metric : run->getAllMetrics())
             outfile_ << ",\"" << metric.first << "\":" << toMetricString(metric.second);
 
         outfile_ << "}";
@@ -591,9 +2393,323 @@ void TrajectoryPlanDataSetOutputter::dump(const PlanDataSet &results)
 {
     const std::string &name = results.name;
 
+    // Compact trajectories are rebuilt one at a time, as they are written.
     for (const auto &data : results.getFlatData())
-        if (data->trajectory)
-            bag_.addMessage(name, data->trajectory->getMessage());
+        if (const auto &trajectory = data->getTrajectory())
+            bag_.addMessage(name, trajectory->getMessage());
+}
+
+///
+/// HDF5PlanDataSetOutputter
+///
+
+namespace
+{
+    /** \brief Replace characters that cannot be used in HDF5 object names. */
+    std::string toHDF5Name(std::string name)
+    {
+        std::replace(name.begin(), name.end(), '/', '_');
+        if (name.empty() or name == ".")
+            name = "_";
+
+        return name;
+    }
+
+    /** \brief Append \a name to the \a group keys. */
+    std::vector<std::string> toKeys(std::vector<std::string> group, const std::string &name)
+    {
+        group.emplace_back(toHDF5Name(name));
+        return group;
+    }
+
+    /** \brief Write a metric column for \a runs, typed after the first value found for \a name. Runs
+     *  without the metric, or with a value of another type, get a missing value (NaN, 0, or -1 for
+     *  strings). */
+    void writeMetricColumn(IO::HDF5Writer &writer, const std::vector<std::string> &group,
+                           const std::string &name, const std::vector<PlanDataPtr> &runs, int which)
+    {
+        const auto get = [&](const PlanDataPtr &run) -> const PlannerMetric * {
+            const auto *metric = run->getMetric(name);
+            if (not metric or metric->which() != which)
+                return nullptr;
+
+            return metric;
+        };
+
+        const auto &keys = toKeys(group, name);
+
+        // Keep in sync with the order of types in PlannerMetric.
+        switch (which)
+        {
+            case 0:
+            {
+                std::vector<uint8_t> values;
+                for (const auto &run : runs)
+                {
+                    const auto *value = get(run);
+                    values.emplace_back((value) ? boost::get<bool>(*value) : 0);
+                }
+
+                writer.write(keys, values);
+                break;
+            }
+            case 1:
+            {
+                std::vector<double> values;
+                for (const auto &run : runs)
+                {
+                    const auto *value = get(run);
+                    values.emplace_back((value) ? boost::get<double>(*value) :
+                                                  std::numeric_limits<double>::quiet_NaN());
+                }
+
+                writer.write(keys, values);
+                break;
+            }
+            case 2:
+            {
+                std::vector<int> values;
+                for (const auto &run : runs)
+                {
+                    const auto *value = get(run);
+                    values.emplace_back((value) ? boost::get<int>(*value) : 0);
+                }
+
+                writer.write(keys, values);
+                break;
+            }
+            case 3:
+            {
+                std::vector<uint64_t> values;
+                for (const auto &run : runs)
+                {
+                    const auto *value = get(run);
+                    values.emplace_back((value) ? boost::get<std::size_t>(*value) : 0);
+                }
+
+                writer.write(keys, values);
+                break;
+            }
+            case 4:
+            {
+                // Dictionary encode strings, as they are mostly repeated across runs.
+                std::map<std::string, int> codes;
+                std::vector<std::string> categories;
+                std::vector<int> values;
+                for (const auto &run : runs)
+                {
+                    const auto *value = get(run);
+                    if (not value)
+                    {
+                        values.emplace_back(-1);
+                        continue;
+                    }
+
+                    const auto &string = boost::get<std::string>(*value);
+                    auto it = codes.find(string);
+                    if (it == codes.end())
+                    {
+                        it = codes.emplace(string, (int)categories.size()).first;
+                        categories.emplace_back(string);
+                    }
+
+                    values.emplace_back(it->second);
+                }
+
+                auto dataset = writer.write(keys, values);
+                IO::HDF5Writer::writeAttribute(dataset, "categories", categories);
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    /** \brief Write the trajectories of \a runs as one matrix of waypoints, with the joints of the first
+     *  trajectory as columns. Runs without a trajectory, or whose trajectory has other joints, have no
+     *  waypoints. */
+    void writeTrajectories(IO::HDF5Writer &writer, const std::vector<std::string> &group,
+                           const std::vector<PlanDataPtr> &runs)
+    {
+        // Positions are read from compact trajectories, so full trajectories are never rebuilt.
+        std::vector<CompactTrajectoryPtr> trajectories;
+        for (const auto &run : runs)
+            trajectories.emplace_back(run->getCompactTrajectory());
+
+        std::vector<std::string> joints;
+        for (const auto &trajectory : trajectories)
+            if (trajectory and trajectory->getNumWaypoints() > 0)
+            {
+                joints = trajectory->getJointNames();
+                break;
+            }
+
+        if (joints.empty())
+            return;
+
+        std::vector<uint64_t> offsets{0};
+        for (const auto &trajectory : trajectories)
+        {
+            const bool valid = trajectory and trajectory->getJointNames() == joints;
+            offsets.emplace_back(offsets.back() + ((valid) ? trajectory->getNumWaypoints() : 0));
+        }
+
+        Eigen::MatrixXd positions(offsets.back(), joints.size());
+        std::vector<double> times;
+        times.reserve(offsets.back());
+
+        for (std::size_t i = 0; i < runs.size(); ++i)
+        {
+            const uint64_t n = offsets[i + 1] - offsets[i];
+            if (n == 0)
+                continue;
+
+            const auto &trajectory = trajectories[i];
+            positions.middleRows(offsets[i], n) = trajectory->getJointMatrix();
+
+            const auto &durations = trajectory->getDurationsFromStart();
+            times.insert(times.end(), durations.begin(), durations.end());
+        }
+
+        auto trajectory_group = writer.getGroup(group);
+        IO::HDF5Writer::writeAttribute(trajectory_group, "joints", joints);
+
+        writer.write(toKeys(group, "offsets"), offsets);
+        writer.write(toKeys(group, "positions"), positions);
+        writer.write(toKeys(group, "time"), times);
+    }
+
+    /** \brief Write the runs of one query into \a group. */
+    void writeQuery(IO::HDF5Writer &writer, const std::vector<std::string> &group,
+                    const std::vector<PlanDataPtr> &runs, bool trajectories)
+    {
+        std::vector<double> times;
+        std::vector<uint8_t> successes;
+        for (const auto &run : runs)
+        {
+            times.emplace_back(run->time);
+            successes.emplace_back(run->success);
+        }
+
+        writer.write(toKeys(group, "time"), times);
+        writer.write(toKeys(group, "success"), successes);
+
+        // Find all metrics and their type, in case some runs are missing metrics.
+        std::map<std::string, int> metrics;
+        for (const auto &run : runs)
+        {
+            for (const auto &metric : run->metrics)
+                metrics.emplace(metric.first, metric.second.which());
+
+            if (run->constant_metrics)
+                for (const auto &metric : *run->constant_metrics)
+                    metrics.emplace(metric.first, metric.second.which());
+        }
+
+        const auto &metric_group = toKeys(group, "metrics");
+        writer.getGroup(metric_group);
+        for (const auto &metric : metrics)
+            writeMetricColumn(writer, metric_group, metric.first, runs, metric.second);
+
+        if (trajectories)
+            writeTrajectories(writer, toKeys(group, "trajectories"), runs);
+
+        std::vector<std::string> properties;
+        for (const auto &run : runs)
+            for (const auto &property : run->property_names)
+                if (std::find(properties.begin(), properties.end(), property) == properties.end())
+                    properties.emplace_back(property);
+
+        if (properties.empty())
+            return;
+
+        const auto &progress_group = toKeys(group, "progress");
+
+        std::vector<uint64_t> offsets{0};
+        for (const auto &run : runs)
+            offsets.emplace_back(offsets.back() + run->progress.size());
+
+        writer.write(toKeys(progress_group, "offsets"), offsets);
+
+        // Progress properties are recorded as strings, convert back into numbers.
+        for (const auto &property : properties)
+        {
+            std::vector<double> values;
+            values.reserve(offsets.back());
+
+            for (const auto &run : runs)
+                for (const auto &point : run->progress)
+                {
+                    double value = std::numeric_limits<double>::quiet_NaN();
+
+                    auto it = point.find(property);
+                    if (it != point.end())
+                    {
+                        char *end = nullptr;
+                        const double parsed = std::strtod(it->second.c_str(), &end);
+                        if (end != it->second.c_str())
+                            value = parsed;
+                    }
+
+                    values.emplace_back(value);
+                }
+
+            writer.write(toKeys(progress_group, property), values);
+        }
+    }
+}  // namespace
+
+HDF5PlanDataSetOutputter::HDF5PlanDataSetOutputter(const std::string &file, bool trajectories,
+                                                   unsigned int compression)
+  : file_(file), trajectories_(trajectories), compression_(compression)
+{
+}
+
+void HDF5PlanDataSetOutputter::dump(const PlanDataSet &results)
+{
+    const std::string name = toHDF5Name(results.name);
+
+    try
+    {
+        IO::HDF5Writer::Options options;
+        options.compression = compression_;
+
+        IO::HDF5Writer writer(file_, is_init_, options);
+        is_init_ = true;
+
+        if (writer.exists({name}))
+            throw Exception(1, log::format("Dataset `%1%` already exists in `%2%`!", name, file_));
+
+        auto group = writer.getGroup({name});
+
+        IO::HDF5Writer::writeAttribute(group, "time", results.time);
+        IO::HDF5Writer::writeAttribute(group, "allowed_time", results.allowed_time);
+        IO::HDF5Writer::writeAttribute(group, "trials", (uint64_t)results.trials);
+        IO::HDF5Writer::writeAttribute(group, "threads", (uint64_t)results.threads);
+        IO::HDF5Writer::writeAttribute(group, "shard", (uint64_t)results.shard);
+        IO::HDF5Writer::writeAttribute(group, "shards", (uint64_t)results.shards);
+        IO::HDF5Writer::writeAttribute(group, "warmup_trials", (uint64_t)results.warmup_trials);
+        IO::HDF5Writer::writeAttribute(group, "cold", (uint64_t)results.cold);
+        IO::HDF5Writer::writeAttribute(group, "start", {boost::posix_time::to_simple_string(results.start)});
+        IO::HDF5Writer::writeAttribute(group, "finish",
+                                       {boost::posix_time::to_simple_string(results.finish)});
+        IO::HDF5Writer::writeAttribute(group, "queries", results.query_names);
+
+        for (const auto &query_name : results.query_names)
+        {
+            auto it = results.data.find(query_name);
+            if (it == results.data.end())
+                continue;
+
+            writeQuery(writer, {name, toHDF5Name(query_name)}, it->second, trajectories_);
+        }
+
+        writer.flush();
+    }
+    catch (const H5::Exception &e)
+    {
+        throw Exception(1, log::format("Failed to write HDF5 results: %1%", e.getDetailMsg()));
+    }
 }
 
 ///
@@ -611,7 +2727,11 @@ OMPLPlanDataSetOutputter::~OMPLPlanDataSetOutputter()
 void OMPLPlanDataSetOutputter::dump(const PlanDataSet &results)
 {
     std::ofstream out;
-    IO::createFile(out, log::format("%1%_%2%.log", prefix_, results.name));
+    if (results.shards > 1)
+        IO::createFile(out, log::format("%1%_%2%_shard%3%of%4%.log", prefix_, results.name, results.shard,
+                                        results.shards));
+    else
+        IO::createFile(out, log::format("%1%_%2%.log", prefix_, results.name));
 
     out << "MoveIt! version " << MOVEIT_VERSION << std::endl;  // version
     out << "Experiment " << results.name << std::endl;         // experiment
@@ -619,6 +2739,8 @@ void OMPLPlanDataSetOutputter::dump(const PlanDataSet &results)
     out << "Starting at " << results.start << std::endl;       // date
 
     out << "<<<|" << std::endl;
+    out << "Warm-up trials: " << results.warmup_trials << std::endl;
+    out << "Cold trials: " << ((results.cold) ? "true" : "false") << std::endl;
     out << "|>>>" << std::endl;
 
     // random seed (fake)
@@ -650,12 +2772,13 @@ void OMPLPlanDataSetOutputter::dump(const PlanDataSet &results)
         out << name << std::endl;  // planner_name
         out << "0 common properties" << std::endl;
 
-        out << (runs[0]->metrics.size() + 2) << " properties for each run" << std::endl;  // run_properties
+        const auto metrics = runs[0]->getAllMetrics();
+        out << (metrics.size() + 2) << " properties for each run" << std::endl;  // run_properties
         out << "time REAL" << std::endl;
         out << "success BOOLEAN" << std::endl;
 
         std::vector<std::reference_wrapper<const std::string>> keys;
-        for (const auto &metric : runs[0]->metrics)
+        for (const auto &metric : metrics)
         {
             class ToString : public boost::static_visitor<const std::string>
             {
@@ -700,7 +2823,7 @@ void OMPLPlanDataSetOutputter::dump(const PlanDataSet &results)
                 << run->success << "; ";
 
             for (const auto &key : keys)
-                out << toMetricString(run->metrics.find(key)->second) << "; ";
+                out << toMetricString(*run->getMetric(key)) << "; ";
 
             out << std::endl;
         }
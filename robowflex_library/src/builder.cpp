@@ -1,5 +1,13 @@
 /* Author: Zachary Kingston */
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <mutex>
+#include <random>
+#include <unordered_map>
+
 #include <moveit/constraint_samplers/constraint_sampler.h>
 #include <moveit/constraint_samplers/constraint_sampler_manager.h>
 #include <moveit/constraint_samplers/default_constraint_samplers.h>
@@ -14,6 +22,7 @@
 #include <robowflex_library/io/yaml.h>
 #include <robowflex_library/log.h>
 #include <robowflex_library/planning.h>
+#include <robowflex_library/pool.h>
 #include <robowflex_library/robot.h>
 #include <robowflex_library/scene.h>
 #include <robowflex_library/tf.h>
@@ -21,11 +30,24 @@
 
 using namespace robowflex;
 
+namespace
+{
+    // Requests of live builders, so they can be fingerprinted by their builder's ID.
+    std::mutex FINGERPRINT_MUTEX;
+    std::unordered_map<const planning_interface::MotionPlanRequest *, const MotionRequestBuilder *>
+        FINGERPRINTS;
+}  // namespace
+
 // Typical name for RRTConnect configuration in MoveIt
 const std::string MotionRequestBuilder::DEFAULT_CONFIG = "RRTConnectkConfigDefault";
 
 MotionRequestBuilder::MotionRequestBuilder(const RobotConstPtr &robot) : robot_(robot)
 {
+    {
+        std::lock_guard<std::mutex> lock(FINGERPRINT_MUTEX);
+        FINGERPRINTS[&request_] = this;
+    }
+
     initialize();
 
     robot_state::RobotState start_state(robot_->getModelConst());
@@ -59,12 +81,31 @@ MotionRequestBuilder::MotionRequestBuilder(const MotionRequestBuilder &other)
   : MotionRequestBuilder(other.getRobot())
 {
     request_ = other.getRequestConst();
+    incrementVersion();
 
     const auto &planner = other.getPlanner();
     if (planner)
         setPlanner(planner);
 }
 
+MotionRequestBuilder::~MotionRequestBuilder()
+{
+    std::lock_guard<std::mutex> lock(FINGERPRINT_MUTEX);
+    FINGERPRINTS.erase(&request_);
+}
+
+bool MotionRequestBuilder::getFingerprint(const planning_interface::MotionPlanRequest &request,
+                                          ID::Key &key)
+{
+    std::lock_guard<std::mutex> lock(FINGERPRINT_MUTEX);
+    auto it = FINGERPRINTS.find(&request);
+    if (it == FINGERPRINTS.end())
+        return false;
+
+    key = it->second->getKey();
+    return true;
+}
+
 MotionRequestBuilderPtr MotionRequestBuilder::clone() const
 {
     return std::make_shared<MotionRequestBuilder>(*this);
@@ -77,6 +118,7 @@ void MotionRequestBuilder::initialize()
     setWorkspaceBounds(Eigen::Vector3d::Constant(-constants::default_workspace_bound),
                        Eigen::Vector3d::Constant(constants::default_workspace_bound));
     request_.allowed_planning_time = constants::default_allowed_planning_time;
+    incrementVersion();
 }
 
 void MotionRequestBuilder::setPlanner(const PlannerConstPtr &planner)
@@ -103,6 +145,7 @@ void MotionRequestBuilder::setPlanningGroup(const std::string &group_name)
         jmg_ = robot_->getModelConst()->getJointModelGroup(group_name_);
 
         request_.group_name = group_name_;
+        incrementVersion();
     }
     else
     {
@@ -117,6 +160,7 @@ bool MotionRequestBuilder::setConfig(const std::string &requested_config)
     {
         RBX_INFO("No planner set! Using requested config `%s`", requested_config);
         request_.planner_id = requested_config;
+        incrementVersion();
         return true;
     }
 
@@ -163,6 +207,41 @@ void MotionRequestBuilder::setWorkspaceBounds(const Eigen::Ref<const Eigen::Vect
     setWorkspaceBounds(wp);
 }
 
+ScenePtr MotionRequestBuilder::cropScene(const SceneConstPtr &scene, double padding) const
+{
+    const auto &cropped = scene->cropToWorkspace(request_.workspace_parameters, padding);
+    if (not jmg_)
+        return cropped;
+
+    const auto &roots = jmg_->getJointRoots();
+    if (roots.size() != 1 or not roots[0]->getParentLinkModel())
+        return cropped;
+
+    // Bound the distance from the root joint's parent link to any point on the links the group moves.
+    double reach = 0;
+    double radius = 0;
+    for (const auto &link : jmg_->getUpdatedLinkModels())
+    {
+        const auto &joint = link->getParentJointModel();
+        if (joint->getType() == robot_model::JointModel::PLANAR or
+            joint->getType() == robot_model::JointModel::FLOATING)
+            return cropped;
+
+        reach += link->getJointOriginTransform().translation().norm();
+        if (joint->getType() == robot_model::JointModel::PRISMATIC)
+            for (const auto &bounds : joint->getVariableBounds())
+                reach += std::max(std::abs(bounds.min_position_), std::abs(bounds.max_position_));
+
+        radius = std::max(radius, link->getCenteredBoundingBoxOffset().norm() +
+                                      link->getShapeExtentsAtOrigin().norm() / 2.);
+    }
+
+    const auto &start = getStartConfiguration();
+    const Eigen::Vector3d base = start->getGlobalLinkTransform(roots[0]->getParentLinkModel()).translation();
+
+    return cropped->cropToObjects(cropped->getObjectsInRadius(base, reach + radius + padding));
+}
+
 bool MotionRequestBuilder::swapStartWithGoal()
 {
     if (request_.goal_constraints.size() != 1)
@@ -439,6 +518,75 @@ void MotionRequestBuilder::precomputeGoalConfigurations(std::size_t n_samples, c
     }
 }
 
+bool MotionRequestBuilder::precomputeGoalConfigurations(std::size_t n_samples, const ScenePtr &scene,
+                                                        const Pool &pool, std::size_t max_attempts,
+                                                        double timeout,
+                                                        const ConfigurationValidityCallback &callback)
+{
+    const auto goals = request_.goal_constraints;
+    const auto deadline = std::chrono::steady_clock::now() +
+                          std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                              std::chrono::duration<double>(timeout));
+
+    std::atomic<std::size_t> attempts(0);
+    std::atomic<std::size_t> found(0);
+    std::mutex mutex;
+    std::vector<robot_state::RobotState> samples;
+
+    const std::size_t jobs = pool.getThreadCount() + 1;
+    pool.parallelFor(
+        0, jobs,
+        [&](std::size_t job) {
+            // Samplers are not thread-safe, so each job allocates its own.
+            constraint_samplers::ConstraintSamplerManager manager;
+            std::vector<constraint_samplers::ConstraintSamplerPtr> samplers;
+            for (const auto &goal : goals)
+            {
+                auto sampler = manager.selectSampler(scene->getSceneConst(), group_name_, goal);
+                if (sampler)
+                {
+                    sampler->setGroupStateValidityCallback(scene->getGSVCF(false));
+                    samplers.emplace_back(sampler);
+                }
+            }
+
+            if (samplers.empty())
+                return;
+
+            std::mt19937 generator(job);
+            std::uniform_int_distribution<std::size_t> distribution(0, samplers.size() - 1);
+
+            robot_state::RobotState state = *robot_->getScratchStateConst();
+            while (found < n_samples and attempts++ < max_attempts)
+            {
+                if (timeout > 0. and std::chrono::steady_clock::now() > deadline)
+                    break;
+
+                const auto &sampler = samplers[distribution(generator)];
+                if (not sampler->sample(state) or (callback and not callback(state)))
+                    continue;
+
+                std::unique_lock<std::mutex> lock(mutex);
+                if (samples.size() < n_samples)
+                {
+                    samples.emplace_back(state);
+                    found = samples.size();
+                }
+            }
+        },
+        1);
+
+    clearGoals();
+    for (const auto &sample : samples)
+        addGoalConfiguration(sample);
+
+    if (samples.size() < n_samples)
+        RBX_WARN("Only precomputed %1% of %2% goal configurations in %3% attempts.", samples.size(),
+                 n_samples, std::min<std::size_t>(attempts, max_attempts));
+
+    return samples.size() == n_samples;
+}
+
 void MotionRequestBuilder::clearGoals()
 {
     incrementVersion();
@@ -542,6 +690,9 @@ const planning_interface::MotionPlanRequest &MotionRequestBuilder::getRequestCon
 
 bool MotionRequestBuilder::toYAMLFile(const std::string &file) const
 {
+    if (IO::isBinaryFile(file))
+        return IO::messageToBinaryFile(request_, file);
+
     return IO::YAMLToFile(IO::toNode(request_), file);
 }
 
@@ -0,0 +1,239 @@
+/* Author: Zachary Kingston */
+
+#include <numeric>
+
+#include <robowflex_library/compact_trajectory.h>
+#include <robowflex_library/trajectory.h>
+
+using namespace robowflex;
+
+namespace
+{
+    /** \brief Checks if the values of the variables not in \a stored are the same in two arrays. */
+    bool sameOthers(const double *a, const double *b, const std::vector<char> &stored)
+    {
+        for (std::size_t i = 0; i < stored.size(); ++i)
+            if (not stored[i] and a[i] != b[i])
+                return false;
+
+        return true;
+    }
+
+    /** \brief Copy the values of \a variables from \a values into row \a row of \a matrix. */
+    void copyRow(const double *values, const std::vector<std::size_t> &variables, std::size_t row,
+                 Eigen::MatrixXd &matrix)
+    {
+        for (std::size_t j = 0; j < variables.size(); ++j)
+            matrix(row, j) = values[variables[j]];
+    }
+}  // namespace
+
+///
+/// CompactTrajectory
+///
+
+CompactTrajectory::CompactTrajectory(const robot_trajectory::RobotTrajectory &trajectory)
+  : model_(trajectory.getRobotModel()), group_(trajectory.getGroupName())
+{
+    const std::size_t n = trajectory.getWayPointCount();
+    const std::size_t count = model_->getVariableCount();
+
+    bool velocities = n > 0;
+    bool accelerations = n > 0;
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        velocities &= trajectory.getWayPoint(i).hasVelocities();
+        accelerations &= trajectory.getWayPoint(i).hasAccelerations();
+    }
+
+    // Store the group's variables, unless some other variable changes along the trajectory.
+    const auto *jmg = trajectory.getGroup();
+    std::vector<char> stored(count, jmg == nullptr);
+    if (jmg)
+        for (const int index : jmg->getVariableIndexList())
+            stored[index] = true;
+
+    if (n > 0)
+    {
+        const auto &first = trajectory.getWayPoint(0);
+        for (std::size_t i = 1; i < n; ++i)
+        {
+            const auto &state = trajectory.getWayPoint(i);
+            if (not sameOthers(first.getVariablePositions(), state.getVariablePositions(), stored) or
+                (velocities and
+                 not sameOthers(first.getVariableVelocities(), state.getVariableVelocities(), stored)) or
+                (accelerations and
+                 not sameOthers(first.getVariableAccelerations(), state.getVariableAccelerations(), stored)))
+            {
+                stored.assign(count, true);
+                break;
+            }
+        }
+
+        reference_ = std::make_shared<const robot_state::RobotState>(first);
+    }
+
+    for (std::size_t i = 0; i < count; ++i)
+        if (stored[i])
+            variables_.emplace_back(i);
+
+    positions_.resize(n, variables_.size());
+    if (velocities)
+        velocities_.resize(n, variables_.size());
+    if (accelerations)
+        accelerations_.resize(n, variables_.size());
+
+    durations_.reserve(n);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        const auto &state = trajectory.getWayPoint(i);
+        copyRow(state.getVariablePositions(), variables_, i, positions_);
+        if (velocities)
+            copyRow(state.getVariableVelocities(), variables_, i, velocities_);
+        if (accelerations)
+            copyRow(state.getVariableAccelerations(), variables_, i, accelerations_);
+
+        durations_.emplace_back(trajectory.getWayPointDurationFromPrevious(i));
+    }
+}
+
+CompactTrajectory::CompactTrajectory(const Trajectory &trajectory)
+  : CompactTrajectory(*trajectory.getTrajectoryConst())
+{
+}
+
+robot_trajectory::RobotTrajectoryPtr CompactTrajectory::toRobotTrajectory() const
+{
+    auto trajectory = std::make_shared<robot_trajectory::RobotTrajectory>(model_, group_);
+    if (not reference_)
+        return trajectory;
+
+    const bool velocities = velocities_.size() > 0;
+    const bool accelerations = accelerations_.size() > 0;
+
+    for (std::size_t i = 0; i < getNumWaypoints(); ++i)
+    {
+        auto state = std::make_shared<robot_state::RobotState>(*reference_);
+        for (std::size_t j = 0; j < variables_.size(); ++j)
+        {
+            state->setVariablePosition(variables_[j], positions_(i, j));
+            if (velocities)
+                state->setVariableVelocity(variables_[j], velocities_(i, j));
+            if (accelerations)
+                state->setVariableAcceleration(variables_[j], accelerations_(i, j));
+        }
+
+        state->update(true);
+        trajectory->addSuffixWayPoint(state, durations_[i]);
+    }
+
+    return trajectory;
+}
+
+TrajectoryPtr CompactTrajectory::toTrajectory() const
+{
+    return std::make_shared<Trajectory>(toRobotTrajectory());
+}
+
+const robot_model::RobotModelConstPtr &CompactTrajectory::getRobotModel() const
+{
+    return model_;
+}
+
+const std::string &CompactTrajectory::getGroupName() const
+{
+    return group_;
+}
+
+const robot_state::RobotStateConstPtr &CompactTrajectory::getReferenceState() const
+{
+    return reference_;
+}
+
+std::size_t CompactTrajectory::getNumWaypoints() const
+{
+    return durations_.size();
+}
+
+std::vector<std::string> CompactTrajectory::getVariableNames() const
+{
+    const auto &names = model_->getVariableNames();
+
+    std::vector<std::string> variables;
+    for (const auto index : variables_)
+        variables.emplace_back(names[index]);
+
+    return variables;
+}
+
+const Eigen::MatrixXd &CompactTrajectory::getPositions() const
+{
+    return positions_;
+}
+
+const Eigen::MatrixXd &CompactTrajectory::getVelocities() const
+{
+    return velocities_;
+}
+
+const Eigen::MatrixXd &CompactTrajectory::getAccelerations() const
+{
+    return accelerations_;
+}
+
+const std::vector<double> &CompactTrajectory::getDurations() const
+{
+    return durations_;
+}
+
+std::vector<double> CompactTrajectory::getDurationsFromStart() const
+{
+    std::vector<double> times(durations_.size());
+    std::partial_sum(durations_.begin(), durations_.end(), times.begin());
+
+    return times;
+}
+
+std::vector<std::string> CompactTrajectory::getJointNames() const
+{
+    const auto *group = (group_.empty()) ? nullptr : model_->getJointModelGroup(group_);
+    const auto &joints = (group) ? group->getActiveJointModels() : model_->getActiveJointModels();
+
+    std::vector<std::string> names;
+    for (const auto *joint : joints)
+        if (joint->getVariableCount() == 1)
+            names.emplace_back(joint->getName());
+
+    return names;
+}
+
+Eigen::MatrixXd CompactTrajectory::getJointMatrix() const
+{
+    const auto &columns = getJointColumns();
+
+    Eigen::MatrixXd matrix(positions_.rows(), columns.size());
+    for (std::size_t j = 0; j < columns.size(); ++j)
+        matrix.col(j) = positions_.col(columns[j]);
+
+    return matrix;
+}
+
+std::size_t CompactTrajectory::getMemoryUsage() const
+{
+    return sizeof(*this) +                                                                      //
+           sizeof(double) * (positions_.size() + velocities_.size() + accelerations_.size()) +  //
+           sizeof(double) * durations_.capacity() + sizeof(std::size_t) * variables_.capacity();
+}
+
+std::vector<std::size_t> CompactTrajectory::getJointColumns() const
+{
+    std::vector<long> column_of(model_->getVariableCount(), -1);
+    for (std::size_t j = 0; j < variables_.size(); ++j)
+        column_of[variables_[j]] = j;
+
+    std::vector<std::size_t> columns;
+    for (const auto &name : getJointNames())
+        columns.emplace_back(column_of[model_->getJointModel(name)->getFirstVariableIndex()]);
+
+    return columns;
+}
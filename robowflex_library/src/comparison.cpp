@@ -0,0 +1,365 @@
+/* Author: Zachary Kingston */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <tuple>
+
+#include <boost/lexical_cast.hpp>
+
+#include <robowflex_library/comparison.h>
+#include <robowflex_library/io.h>
+#include <robowflex_library/log.h>
+
+using namespace robowflex;
+
+namespace
+{
+    /** \brief Convert a value loaded from JSON into a metric. Numbers become doubles, and anything else is
+     *  kept as a string. */
+    PlannerMetric toMetric(const std::string &value)
+    {
+        if (value == "true" or value == "false")
+            return value == "true";
+
+        try
+        {
+            return boost::lexical_cast<double>(value);
+        }
+        catch (const boost::bad_lexical_cast &)
+        {
+            return value;
+        }
+    }
+
+    /** \brief Check if \a name ends with \a suffix. */
+    bool endsWith(const std::string &name, const std::string &suffix)
+    {
+        return name.size() >= suffix.size() and
+               name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+
+    /** \brief Recover the query name of a run from its name, `run_<query>:<trial>:<index>`, with the
+     *  timeout trial appended when running till timeout. */
+    std::string getQueryName(const PlanData &run)
+    {
+        std::string name = run.query.name;
+        if (name.compare(0, 4, "run_") == 0)
+            name = name.substr(4);
+
+        double trial, index, timeout;
+        if (not run.getMetricValue("query_trial", trial) or not run.getMetricValue("query_index", index))
+            return name;
+
+        const std::string suffix = log::format(":%1%:%2%", (int)trial, (int)index);
+        if (run.getMetricValue("query_timeout_trial", timeout))
+        {
+            const std::string full = suffix + log::format(":%1%", (int)timeout);
+            if (endsWith(name, full))
+                return name.substr(0, name.size() - full.size());
+        }
+
+        if (endsWith(name, suffix))
+            return name.substr(0, name.size() - suffix.size());
+
+        return name;
+    }
+
+    /** \brief Get the finite values of a metric over the runs of a query. */
+    std::vector<double> getValues(const PlanDataSet &dataset, const std::string &query,
+                                  const std::string &metric)
+    {
+        std::vector<double> values;
+
+        auto it = dataset.data.find(query);
+        if (it == dataset.data.end())
+            return values;
+
+        for (const auto &run : it->second)
+        {
+            double value;
+            if (run->getMetricValue(metric, value))
+                values.emplace_back(value);
+        }
+
+        return values;
+    }
+
+    /** \brief Median of a set of values. */
+    double getMedian(std::vector<double> values)
+    {
+        const std::size_t half = values.size() / 2;
+        std::nth_element(values.begin(), values.begin() + half, values.end());
+        const double upper = values[half];
+        if (values.size() % 2)
+            return upper;
+
+        return (*std::max_element(values.begin(), values.begin() + half) + upper) / 2.;
+    }
+
+    /** \brief Mean of a set of values. */
+    double getMean(std::vector<double> values)
+    {
+        return std::accumulate(values.begin(), values.end(), 0.) / values.size();
+    }
+
+    /** \brief Percentile bootstrap confidence interval of a statistic. */
+    std::pair<double, double> getInterval(const std::vector<double> &values,
+                                          double (*statistic)(std::vector<double>),
+                                          const DataSetComparison::Options &options, std::mt19937 &generator)
+    {
+        std::uniform_int_distribution<std::size_t> pick(0, values.size() - 1);
+
+        std::vector<double> estimates(options.resamples);
+        std::vector<double> sample(values.size());
+        for (auto &estimate : estimates)
+        {
+            for (auto &value : sample)
+                value = values[pick(generator)];
+
+            estimate = statistic(sample);
+        }
+
+        std::sort(estimates.begin(), estimates.end());
+        const auto &at = [&](double p) {
+            const auto index = static_cast<std::size_t>(p * (estimates.size() - 1) + 0.5);
+            return estimates[index];
+        };
+
+        return {at((1. - options.confidence) / 2.), at((1. + options.confidence) / 2.)};
+    }
+
+    /** \brief Two-sided p-value of the Mann-Whitney U test, with the normal approximation corrected for
+     *  ties and continuity. */
+    double getMannWhitneyP(const std::vector<double> &a, const std::vector<double> &b)
+    {
+        const std::size_t n1 = a.size();
+        const std::size_t n2 = b.size();
+        const std::size_t n = n1 + n2;
+
+        std::vector<std::pair<double, bool>> all;
+        all.reserve(n);
+        for (const auto &value : a)
+            all.emplace_back(value, true);
+        for (const auto &value : b)
+            all.emplace_back(value, false);
+
+        std::sort(all.begin(), all.end(),
+                  [](const std::pair<double, bool> &x, const std::pair<double, bool> &y) {
+                      return x.first < y.first;
+                  });
+
+        // Tied values share the average of their ranks.
+        double rank_a = 0.;
+        double ties = 0.;
+        for (std::size_t i = 0; i < n;)
+        {
+            std::size_t j = i;
+            while (j < n and all[j].first == all[i].first)
+                ++j;
+
+            const double rank = (i + j + 1) / 2.;
+            for (std::size_t k = i; k < j; ++k)
+                if (all[k].second)
+                    rank_a += rank;
+
+            const double t = j - i;
+            ties += t * t * t - t;
+            i = j;
+        }
+
+        const double u = rank_a - n1 * (n1 + 1) / 2.;
+        const double mean = n1 * n2 / 2.;
+        const double variance = n1 * n2 / 12. * ((n + 1) - ties / (double(n) * (n - 1)));
+        if (variance <= 0.)
+            return 1.;
+
+        const double z = std::max(0., std::abs(u - mean) - 0.5) / std::sqrt(variance);
+        return std::erfc(z / std::sqrt(2.));
+    }
+
+    /** \brief Compare the values of a metric of a query. If \a rate is true, the values are successes,
+     *  summarized by their mean. */
+    DataSetComparison::Result compare(const std::string &query, const std::string &metric,
+                                      const std::vector<double> &base, const std::vector<double> &test,
+                                      bool rate, const DataSetComparison::Options &options)
+    {
+        const double nan = std::numeric_limits<double>::quiet_NaN();
+
+        DataSetComparison::Result result{query, metric, base.size(), test.size(),  //
+                                         nan,   nan,    nan,         nan,          //
+                                         nan,   nan,    nan,         1.,           //
+                                         false};
+
+        if (base.empty() or test.empty())
+        {
+            RBX_WARN("Query `%1%` has no values of `%2%` in both datasets", query, metric);
+            return result;
+        }
+
+        const auto statistic = (rate) ? getMean : getMedian;
+
+        std::mt19937 generator(options.seed);
+
+        result.base = statistic(base);
+        result.test = statistic(test);
+        std::tie(result.base_lower, result.base_upper) = getInterval(base, statistic, options, generator);
+        std::tie(result.test_lower, result.test_upper) = getInterval(test, statistic, options, generator);
+
+        if (rate)
+            result.change = result.test - result.base;
+        else if (result.base != 0.)
+            result.change = (result.test - result.base) / std::abs(result.base);
+        else
+            result.change = (result.test > 0.) ? std::numeric_limits<double>::infinity() : 0.;
+
+        result.p_value = getMannWhitneyP(base, test);
+
+        const bool worse =
+            (rate) ? -result.change > options.success_tolerance : result.change > options.tolerance;
+        result.regression = worse and result.p_value < options.alpha;
+
+        return result;
+    }
+}  // namespace
+
+std::vector<PlanDataSetPtr> robowflex::loadJSONDataSets(const std::string &file)
+{
+    const auto &yaml = IO::loadFileToYAML(file);
+    if (not yaml.first or not yaml.second.IsMap())
+    {
+        RBX_ERROR("Failed to load datasets from `%s`", file);
+        return {};
+    }
+
+    std::vector<PlanDataSetPtr> datasets;
+    for (const auto &experiment : yaml.second)
+    {
+        auto dataset = std::make_shared<PlanDataSet>();
+        dataset->name = experiment.first.as<std::string>();
+
+        for (const auto &node : experiment.second)
+        {
+            auto run = std::make_shared<PlanData>();
+            for (const auto &entry : node)
+            {
+                const auto &key = entry.first.as<std::string>();
+                const auto &value = entry.second.as<std::string>();
+
+                if (key == "name")
+                    run->query.name = value;
+                else if (key == "time")
+                    run->time = std::strtod(value.c_str(), nullptr);
+                else if (key == "success")
+                    run->success = value == "1" or value == "true";
+                else
+                    run->metrics[key] = toMetric(value);
+            }
+
+            const auto &query = getQueryName(*run);
+            const auto &names = dataset->query_names;
+            if (std::find(names.begin(), names.end(), query) == names.end())
+                dataset->query_names.emplace_back(query);
+
+            dataset->addDataPoint(query, run);
+        }
+
+        datasets.emplace_back(dataset);
+    }
+
+    return datasets;
+}
+
+///
+/// DataSetComparison
+///
+
+DataSetComparison::DataSetComparison(const PlanDataSet &base, const PlanDataSet &test)
+  : DataSetComparison(base, test, Options())
+{
+}
+
+DataSetComparison::DataSetComparison(const PlanDataSet &base, const PlanDataSet &test, const Options &options)
+{
+    const auto &names = test.query_names;
+    for (const auto &query : names)
+        if (std::find(base.query_names.begin(), base.query_names.end(), query) == base.query_names.end())
+            RBX_WARN("Query `%1%` is not in the base dataset, skipping", query);
+
+    for (const auto &query : base.query_names)
+    {
+        if (std::find(names.begin(), names.end(), query) == names.end())
+        {
+            RBX_WARN("Query `%1%` is not in the test dataset, skipping", query);
+            continue;
+        }
+
+        results_.emplace_back(compare(query, "success",                 //
+                                      getValues(base, query, "success"),  //
+                                      getValues(test, query, "success"),  //
+                                      true, options));
+
+        for (const auto &metric : options.metrics)
+            results_.emplace_back(compare(query, metric,                 //
+                                          getValues(base, query, metric),  //
+                                          getValues(test, query, metric),  //
+                                          false, options));
+    }
+}
+
+const std::vector<DataSetComparison::Result> &DataSetComparison::getResults() const
+{
+    return results_;
+}
+
+bool DataSetComparison::hasRegression() const
+{
+    return std::any_of(results_.begin(), results_.end(),
+                       [](const Result &result) { return result.regression; });
+}
+
+void DataSetComparison::print(std::ostream &out) const
+{
+    out << log::format("%-30s %-20s %-28s %-28s %10s %10s", "query", "metric", "base [interval]",
+                       "test [interval]", "change", "p")
+        << std::endl;
+
+    for (const auto &result : results_)
+    {
+        const auto &base =
+            log::format("%.4g [%.4g, %.4g]", result.base, result.base_lower, result.base_upper);
+        const auto &test =
+            log::format("%.4g [%.4g, %.4g]", result.test, result.test_lower, result.test_upper);
+
+        out << log::format("%-30s %-20s %-28s %-28s %10.4g %10.4g%s", result.query, result.metric, base,
+                           test, result.change, result.p_value, (result.regression) ? "  REGRESSION" : "")
+            << std::endl;
+    }
+}
+
+bool DataSetComparison::toCSVFile(const std::string &filename) const
+{
+    std::ofstream out;
+    IO::createFile(out, filename);
+    if (not out.is_open())
+    {
+        RBX_ERROR("Failed to open %s for writing", filename);
+        return false;
+    }
+
+    out << "query,metric,base_n,test_n,base,base_lower,base_upper,test,test_lower,test_upper,change,p_value,"
+           "regression"
+        << std::endl;
+    for (const auto &result : results_)
+        out << result.query << "," << result.metric << "," << result.base_n << "," << result.test_n << ","
+            << result.base << "," << result.base_lower << "," << result.base_upper << ","  //
+            << result.test << "," << result.test_lower << "," << result.test_upper << ","  //
+            << result.change << "," << result.p_value << "," << result.regression << std::endl;
+
+    out.close();
+    return true;
+}
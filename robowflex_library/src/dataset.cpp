@@ -0,0 +1,238 @@
+/* Author: Zachary Kingston */
+
+#include <algorithm>
+
+#include <fnmatch.h>
+
+#include <boost/filesystem.hpp>
+
+#include <robowflex_library/builder.h>
+#include <robowflex_library/dataset.h>
+#include <robowflex_library/io.h>
+#include <robowflex_library/log.h>
+#include <robowflex_library/planning.h>
+#include <robowflex_library/scene.h>
+
+using namespace robowflex;
+
+///
+/// Dataset
+///
+
+Dataset::Dataset(const PlannerPtr &planner, const std::string &group) : planner_(planner), group_(group)
+{
+}
+
+std::vector<std::string> Dataset::findFiles(const std::string &pattern)
+{
+    std::vector<std::string> files;
+
+    // A directory matches all files within it.
+    const auto &listed = IO::listDirectory(pattern);
+    if (listed.first)
+        files = listed.second;
+    else
+    {
+        const boost::filesystem::path path(IO::resolvePackage(pattern));
+        const std::string glob = path.filename().string();
+
+        const auto &parent = IO::listDirectory(path.parent_path().string());
+        if (not parent.first)
+        {
+            RBX_ERROR("Cannot list files for pattern `%s`", pattern);
+            return {};
+        }
+
+        for (const auto &file : parent.second)
+            if (fnmatch(glob.c_str(), boost::filesystem::path(file).filename().c_str(), 0) == 0)
+                files.emplace_back(file);
+    }
+
+    const auto is_not_file = [](const std::string &file) {
+        return not boost::filesystem::is_regular_file(file);
+    };
+    files.erase(std::remove_if(files.begin(), files.end(), is_not_file), files.end());
+
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+void Dataset::addEntry(const Entry &entry)
+{
+    entries_.emplace_back(entry);
+}
+
+bool Dataset::addEntries(const std::string &scenes, const std::string &requests, const std::string &name)
+{
+    const auto &scene_files = findFiles(scenes);
+    const auto &request_files = findFiles(requests);
+
+    if (scene_files.empty() or scene_files.size() != request_files.size())
+    {
+        RBX_ERROR("Found %d scene files for `%s` and %d request files for `%s`, cannot pair them up!",
+                  scene_files.size(), scenes, request_files.size(), requests);
+        return false;
+    }
+
+    for (std::size_t i = 0; i < scene_files.size(); ++i)
+        entries_.push_back({name, scene_files[i], request_files[i]});
+
+    return true;
+}
+
+bool Dataset::addArchive(const std::string &file, const std::string &name)
+{
+    auto archive = std::make_shared<const IO::Archive>(file);
+    if (not archive->isOpen())
+        return false;
+
+    auto scenes = archive->getNames("scene/");
+    auto requests = archive->getNames("request/");
+    std::sort(scenes.begin(), scenes.end());
+    std::sort(requests.begin(), requests.end());
+
+    if (scenes.empty() or scenes.size() != requests.size())
+    {
+        RBX_ERROR("Found %d scenes and %d requests in `%s`, cannot pair them up!", scenes.size(),
+                  requests.size(), file);
+        return false;
+    }
+
+    for (std::size_t i = 0; i < scenes.size(); ++i)
+        entries_.push_back({name, scenes[i], requests[i], archive});
+
+    return true;
+}
+
+const std::vector<Dataset::Entry> &Dataset::getEntries() const
+{
+    return entries_;
+}
+
+bool Dataset::loadQuery(const Entry &entry, PlanningQuery &query) const
+{
+    auto scene = std::make_shared<Scene>(planner_->getRobot());
+    auto request = std::make_shared<MotionRequestBuilder>(planner_, group_);
+
+    if (entry.archive)
+    {
+        moveit_msgs::PlanningScene scene_msg;
+        if (not entry.archive->getMessage(entry.scene, scene_msg))
+        {
+            RBX_ERROR("Failed to read entry: %s for scene", entry.scene);
+            return false;
+        }
+
+        moveit_msgs::MotionPlanRequest request_msg;
+        if (not entry.archive->getMessage(entry.request, request_msg))
+        {
+            RBX_ERROR("Failed to read entry: %s for request", entry.request);
+            return false;
+        }
+
+        scene->useMessage(scene_msg);
+        request->getRequest() = request_msg;
+        request->setPlanningGroup(request_msg.group_name);
+    }
+    else
+    {
+        if (not scene->fromYAMLFile(entry.scene))
+        {
+            RBX_ERROR("Failed to read file: %s for scene", entry.scene);
+            return false;
+        }
+
+        if (not request->fromYAMLFile(entry.request))
+        {
+            RBX_ERROR("Failed to read file: %s for request", entry.request);
+            return false;
+        }
+    }
+
+    query = PlanningQuery(entry.name, scene, planner_, request->getRequestConst());
+    return true;
+}
+
+std::vector<PlanningQuery> Dataset::load(const Pool &pool) const
+{
+    std::vector<PlanningQuery> queries(entries_.size());
+    std::vector<char> loaded(entries_.size(), false);
+
+    // Each file is large enough to be its own chunk.
+    pool.parallelFor(0, entries_.size(),
+                     [&](std::size_t i) { loaded[i] = loadQuery(entries_[i], queries[i]); }, 1);
+
+    std::vector<PlanningQuery> result;
+    result.reserve(entries_.size());
+    for (std::size_t i = 0; i < entries_.size(); ++i)
+        if (loaded[i])
+            result.emplace_back(std::move(queries[i]));
+
+    return result;
+}
+
+std::size_t Dataset::addToExperiment(Experiment &experiment, const Pool &pool) const
+{
+    const auto &queries = load(pool);
+    for (const auto &query : queries)
+        experiment.addQuery(query.name, query.scene, query.planner, query.request);
+
+    return queries.size();
+}
+
+Dataset::PrefetcherPtr Dataset::prefetch(const DatasetConstPtr &dataset, const PoolPtr &pool,
+                                          std::size_t ahead)
+{
+    return std::make_shared<Prefetcher>(dataset, pool, ahead);
+}
+
+///
+/// Dataset::Prefetcher
+///
+
+Dataset::Prefetcher::Prefetcher(const DatasetConstPtr &dataset, const PoolPtr &pool, std::size_t ahead)
+  : dataset_(dataset), pool_(pool), ahead_((ahead) ? ahead : pool->getThreadCount())
+{
+    fill();
+}
+
+Dataset::Prefetcher::~Prefetcher()
+{
+    for (const auto &job : jobs_)
+        job->cancel();
+}
+
+bool Dataset::Prefetcher::next(PlanningQuery &query)
+{
+    while (not jobs_.empty())
+    {
+        auto job = jobs_.front();
+        jobs_.pop_front();
+        fill();
+
+        // Failed entries are returned without a scene.
+        query = job->get();
+        if (query.scene)
+            return true;
+    }
+
+    return false;
+}
+
+void Dataset::Prefetcher::fill()
+{
+    const auto &entries = dataset_->getEntries();
+    while (jobs_.size() < ahead_ and submitted_ < entries.size())
+    {
+        // Jobs hold their own reference to the dataset, so they are safe to outlive the prefetcher.
+        const auto dataset = dataset_;
+        const auto entry = entries[submitted_++];
+
+        jobs_.emplace_back(pool_->submit(make_function([dataset, entry]() {
+            // On failure, the query is left without a scene.
+            PlanningQuery query;
+            dataset->loadQuery(entry, query);
+            return query;
+        })));
+    }
+}
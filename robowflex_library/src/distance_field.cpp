@@ -0,0 +1,141 @@
+/* Author: Zachary Kingston */
+
+#include <algorithm>
+#include <limits>
+
+#include <geometric_shapes/shape_operations.h>
+
+#include <robowflex_library/distance_field.h>
+#include <robowflex_library/log.h>
+#include <robowflex_library/macros.h>
+#include <robowflex_library/scene.h>
+#include <robowflex_library/tf.h>
+
+using namespace robowflex;
+
+DistanceField::DistanceField(const Scene &scene, double resolution, double max_distance)
+  : resolution_(resolution), max_distance_(max_distance)
+{
+    const auto &world = scene.getSceneConst()->getWorld();
+
+    // Collect the global poses of every shape, and the box around their bounding spheres.
+    std::vector<shapes::ShapeConstPtr> shapes;
+    RobotPoseVector poses;
+    Eigen::Vector3d lower = Eigen::Vector3d::Constant(std::numeric_limits<double>::infinity());
+    Eigen::Vector3d upper = -lower;
+
+    for (const auto &name : world->getObjectIds())
+    {
+        const auto &obj = world->getObject(name);
+        for (std::size_t i = 0; i < obj->shapes_.size(); ++i)
+        {
+            const auto &shape = obj->shapes_[i];
+            if (shape->type == shapes::OCTREE)
+            {
+                RBX_WARN("Octomap `%s` is not added to the distance field.", name);
+                continue;
+            }
+
+#if ROBOWFLEX_MOVEIT_VERSION >= ROBOWFLEX_MOVEIT_VERSION_COMPUTE(1, 1, 6)
+            const RobotPose pose = obj->pose_ * obj->shape_poses_[i];
+#else
+            const RobotPose pose = obj->shape_poses_[i];
+#endif
+
+            const auto &sphere = getSphere(shape);
+            const Eigen::Vector3d center = pose * sphere.center;
+            lower = lower.cwiseMin(center - Eigen::Vector3d::Constant(sphere.radius));
+            upper = upper.cwiseMax(center + Eigen::Vector3d::Constant(sphere.radius));
+
+            shapes.emplace_back(shape);
+            poses.emplace_back(pose);
+        }
+    }
+
+    if (shapes.empty())
+        return;
+
+    lower -= Eigen::Vector3d::Constant(max_distance_);
+    upper += Eigen::Vector3d::Constant(max_distance_);
+    const Eigen::Vector3d size = upper - lower;
+
+    field_ = std::make_shared<distance_field::PropagationDistanceField>(  //
+        size[0], size[1], size[2], resolution_, lower[0], lower[1], lower[2], max_distance_, true);
+
+    for (std::size_t i = 0; i < shapes.size(); ++i)
+#if ROBOWFLEX_AT_LEAST_MELODIC
+        field_->addShapeToField(shapes[i].get(), poses[i]);
+#else
+        field_->addShapeToField(shapes[i].get(), TF::poseEigenToMsg(poses[i]));
+#endif
+}
+
+double DistanceField::getDistance(const Eigen::Vector3d &point) const
+{
+    if (not field_)
+        return max_distance_;
+
+    return field_->getDistance(point[0], point[1], point[2]);
+}
+
+double DistanceField::getDistance(const robot_state::RobotState &state) const
+{
+    double distance = max_distance_;
+
+    for (const auto &link : state.getRobotModel()->getLinkModelsWithCollisionGeometry())
+    {
+        const auto &origins = link->getCollisionOriginTransforms();
+        const auto &pose = state.getGlobalLinkTransform(link);
+
+        RobotPoseVector poses(origins.size());
+        for (std::size_t i = 0; i < origins.size(); ++i)
+            poses[i] = pose * origins[i];
+
+        distance = std::min(distance, getShapesDistance(link->getShapes(), poses));
+    }
+
+    std::vector<const robot_state::AttachedBody *> bodies;
+    state.getAttachedBodies(bodies);
+    for (const auto &body : bodies)
+        distance = std::min(distance, getShapesDistance(body->getShapes(),  //
+                                                        body->getGlobalCollisionBodyTransforms()));
+
+    return distance;
+}
+
+double DistanceField::getResolution() const
+{
+    return resolution_;
+}
+
+double DistanceField::getMaxDistance() const
+{
+    return max_distance_;
+}
+
+DistanceField::Sphere DistanceField::getSphere(const shapes::ShapeConstPtr &shape) const
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto it = spheres_.find(shape);
+    if (it != spheres_.end())
+        return it->second;
+
+    Sphere sphere;
+    shapes::computeShapeBoundingSphere(shape.get(), sphere.center, sphere.radius);
+    spheres_.emplace(shape, sphere);
+
+    return sphere;
+}
+
+double DistanceField::getShapesDistance(const std::vector<shapes::ShapeConstPtr> &shapes,
+                                        const RobotPoseVector &poses) const
+{
+    double distance = max_distance_;
+    for (std::size_t i = 0; i < shapes.size(); ++i)
+    {
+        const auto &sphere = getSphere(shapes[i]);
+        distance = std::min(distance, getDistance(poses[i] * sphere.center) - sphere.radius);
+    }
+
+    return distance;
+}
@@ -0,0 +1,176 @@
+/* Author: Zachary Kingston */
+
+#include <deque>
+
+#include <robowflex_library/builder.h>
+#include <robowflex_library/generator.h>
+#include <robowflex_library/io.h>
+#include <robowflex_library/log.h>
+#include <robowflex_library/random.h>
+#include <robowflex_library/scene.h>
+#include <robowflex_library/tf.h>
+
+using namespace robowflex;
+
+///
+/// QueryGenerator
+///
+
+QueryGenerator::QueryGenerator(const SceneConstPtr &scene, const MotionRequestBuilderConstPtr &request)
+  : QueryGenerator(scene, request, Options())
+{
+}
+
+QueryGenerator::QueryGenerator(const SceneConstPtr &scene, const MotionRequestBuilderConstPtr &request,
+                               const Options &options)
+  : scene_(scene), request_(request), options_(options)
+{
+}
+
+void QueryGenerator::addObjectPerturbation(const std::string &name, const Eigen::Vector3d &pos_bounds,
+                                           const Eigen::Vector3d &orn_bounds)
+{
+    Perturbation perturbation;
+    perturbation.name = name;
+    perturbation.pose = scene_->getObjectPose(name);
+    perturbation.pos_bounds = pos_bounds;
+    perturbation.orn_bounds = orn_bounds;
+
+    perturbations_.emplace_back(perturbation);
+}
+
+void QueryGenerator::setSceneCallback(const SceneCallback &callback)
+{
+    scene_callback_ = callback;
+}
+
+void QueryGenerator::setRequestCallback(const RequestCallback &callback)
+{
+    request_callback_ = callback;
+}
+
+bool QueryGenerator::generateQuery(std::size_t index, Query &query) const
+{
+    // Every attempt of a query draws from the query's own stream, wherever it runs.
+    const std::size_t stream = RNG::getStream();
+    RNG::setStream(options_.stream + index);
+
+    query.index = index;
+    query.attempts = 0;
+
+    bool success = false;
+    while (not success and query.attempts < options_.max_attempts)
+    {
+        ++query.attempts;
+        success = attempt(query);
+    }
+
+    RNG::setStream(stream);
+
+    if (not success)
+    {
+        RBX_WARN("Query %d rejected after %d attempts", index, query.attempts);
+        query.scene.reset();
+        query.request.reset();
+    }
+
+    return success;
+}
+
+bool QueryGenerator::attempt(Query &query) const
+{
+    query.scene = scene_->deepCopy();
+    query.request = request_->clone();
+
+    for (const auto &perturbation : perturbations_)
+    {
+        // The offset is applied in the object's frame, about its template pose.
+        const auto &offset = TF::samplePoseUniform(perturbation.pos_bounds, perturbation.orn_bounds);
+        const RobotPose transform = perturbation.pose * offset * perturbation.pose.inverse();
+        if (not query.scene->moveObjectGlobal(perturbation.name, transform))
+            return false;
+    }
+
+    if (scene_callback_ and not scene_callback_(query.scene))
+        return false;
+
+    // Reject colliding scenes before spending time on the request.
+    if (options_.check_start)
+    {
+        const auto &start = query.request->getStartConfiguration();
+        if (query.scene->checkCollision(*start).collision)
+            return false;
+    }
+
+    if (request_callback_ and not request_callback_(query.scene, query.request))
+        return false;
+
+    if (options_.goal_samples > 0 and
+        not query.request->precomputeGoalConfigurations(options_.goal_samples, query.scene, serial_,
+                                                        options_.goal_attempts))
+        return false;
+
+    return true;
+}
+
+std::size_t QueryGenerator::generate(std::size_t n, const Pool &pool, const QueryCallback &callback) const
+{
+    const std::size_t ahead = (options_.ahead) ? options_.ahead : 4 * pool.getThreadCount();
+
+    // Queries are generated out of order, but only a window of them is held while waiting on the next.
+    std::deque<std::shared_ptr<Pool::Job<std::shared_ptr<Query>>>> jobs;
+    std::size_t submitted = 0;
+    std::size_t generated = 0;
+
+    const auto &fill = [&] {
+        while (jobs.size() < std::max<std::size_t>(ahead, 1) and submitted < n)
+        {
+            const std::size_t index = submitted++;
+            jobs.emplace_back(pool.submit(make_function([this, index]() {
+                auto query = std::make_shared<Query>();
+                if (not generateQuery(index, *query))
+                    query.reset();
+
+                return query;
+            })));
+        }
+    };
+
+    fill();
+    while (not jobs.empty())
+    {
+        auto job = jobs.front();
+        jobs.pop_front();
+        fill();
+
+        const auto &query = job->get();
+        if (not query)
+            continue;
+
+        callback(*query);
+        ++generated;
+    }
+
+    return generated;
+}
+
+std::size_t QueryGenerator::generateToDirectory(std::size_t n, const Pool &pool, const std::string &directory,
+                                                const std::string &name) const
+{
+    std::size_t written = 0;
+    generate(n, pool, [&](const Query &query) {
+        // Indices are zero-padded so the files pair up in sorted order.
+        const auto &scene = log::format("%1%/%2%_scene_%3$06d.yaml", directory, name, query.index);
+        const auto &request = log::format("%1%/%2%_request_%3$06d.yaml", directory, name, query.index);
+
+        if (not query.scene->toYAMLFile(scene) or not query.request->toYAMLFile(request))
+        {
+            RBX_ERROR("Failed to write query %d to `%s`", query.index, directory);
+            return;
+        }
+
+        ++written;
+    });
+
+    return written;
+}
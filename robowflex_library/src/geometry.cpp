@@ -1,13 +1,122 @@
 /* Author: Zachary Kingston, Constantinos Chamzas */
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <sstream>
+
+#include <boost/filesystem.hpp>
+
+#include <geometric_shapes/mesh_operations.h>
 #include <geometric_shapes/shape_operations.h>
 
+#include <robowflex_library/constants.h>
 #include <robowflex_library/geometry.h>
 #include <robowflex_library/io.h>
+#include <robowflex_library/random.h>
 #include <robowflex_library/util.h>
 
 using namespace robowflex;
 
+namespace
+{
+    std::mutex CACHE_MUTEX;                                ///< Mutex for the geometry cache.
+    std::map<std::string, std::weak_ptr<Geometry>> CACHE;  ///< Shared geometry, by key.
+
+    /** \brief Get geometry from the cache, if it is still in use.
+     */
+    GeometryPtr getCached(const std::string &key)
+    {
+        std::unique_lock<std::mutex> lock(CACHE_MUTEX);
+        auto it = CACHE.find(key);
+        if (it == CACHE.end())
+            return nullptr;
+
+        auto geometry = it->second.lock();
+        if (not geometry)
+            CACHE.erase(it);
+
+        return geometry;
+    }
+
+    /** \brief Add geometry to the cache. Newly unused entries are pruned along the way.
+     */
+    void addCached(const std::string &key, const GeometryPtr &geometry)
+    {
+        std::unique_lock<std::mutex> lock(CACHE_MUTEX);
+        for (auto it = CACHE.begin(); it != CACHE.end();)
+            if (it->second.expired())
+                it = CACHE.erase(it);
+            else
+                ++it;
+
+        CACHE[key] = geometry;
+    }
+
+    /** \brief Add bytes to a 64-bit FNV-1a hash.
+     */
+    void hashBytes(uint64_t &hash, const void *data, std::size_t size)
+    {
+        const auto *bytes = static_cast<const unsigned char *>(data);
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ULL;
+        }
+    }
+
+    /** \brief Get a key for a mesh from a hash of its contents.
+     */
+    std::string getMeshKey(const shapes::Mesh &mesh)
+    {
+        uint64_t hash = 14695981039346656037ULL;
+        hashBytes(hash, mesh.vertices, 3 * mesh.vertex_count * sizeof(double));
+        hashBytes(hash, mesh.triangles, 3 * mesh.triangle_count * sizeof(unsigned int));
+
+        std::ostringstream key;
+        key << "mesh:" << std::hex << hash << ":" << mesh.vertex_count << ":" << mesh.triangle_count;
+        return key.str();
+    }
+
+    std::mutex HULL_MUTEX;                                ///< Mutex for the convex hull cache.
+    std::map<std::string, shapes::ShapeConstPtr> HULLS;  ///< Convex hulls, by key of their mesh.
+
+    /** \brief Get the convex hull of a mesh from the cache, or build and cache it from a convex body of
+     * the mesh.
+     */
+    shapes::ShapeConstPtr getHull(const std::string &key,
+                                  const std::function<const bodies::ConvexMesh *()> &body)
+    {
+        {
+            std::unique_lock<std::mutex> lock(HULL_MUTEX);
+            auto it = HULLS.find(key);
+            if (it != HULLS.end())
+                return it->second;
+        }
+
+        // Computed outside the lock, so different meshes can be hulled in parallel.
+        shapes::ShapeConstPtr hull;
+        const auto *mesh = body();
+        if (mesh and mesh->getTriangles().size() >= 3)
+            hull.reset(shapes::createMeshFromVertices(mesh->getScaledVertices(), mesh->getTriangles()));
+
+        std::unique_lock<std::mutex> lock(HULL_MUTEX);
+        return HULLS.emplace(key, hull).first->second;
+    }
+
+    /** \brief Checks if two meshes have the same vertices and triangles.
+     */
+    bool isSameMesh(const shapes::Mesh &a, const shapes::Mesh &b)
+    {
+        return a.vertex_count == b.vertex_count and a.triangle_count == b.triangle_count and
+               std::memcmp(a.vertices, b.vertices, 3 * a.vertex_count * sizeof(double)) == 0 and
+               std::memcmp(a.triangles, b.triangles, 3 * a.triangle_count * sizeof(unsigned int)) == 0;
+    }
+}  // namespace
+
 const unsigned int Geometry::ShapeType::MAX = (unsigned int)Geometry::ShapeType::MESH + 1;
 const std::vector<std::string> Geometry::ShapeType::STRINGS({"box", "sphere", "cylinder", "cone", "mesh"});
 
@@ -90,7 +199,27 @@ GeometryPtr Geometry::makeSolidPrimitive(const shape_msgs::SolidPrimitive &msg)
 
 GeometryPtr Geometry::makeMesh(const std::string &resource, const Eigen::Vector3d &scale)
 {
-    return std::make_shared<Geometry>(ShapeType::MESH, scale, resource);
+    const auto &path = IO::resolvePath(resource);
+    if (path.empty())
+        return std::make_shared<Geometry>(ShapeType::MESH, scale, resource);
+
+    boost::system::error_code ec;
+    const auto time = boost::filesystem::last_write_time(path, ec);
+
+    std::ostringstream key;
+    key.precision(17);
+    key << "file:" << path << ":" << ((ec) ? -1 : time) << ":" << scale[0] << "," << scale[1] << ","
+        << scale[2];
+
+    auto geometry = getCached(key.str());
+    if (not geometry)
+    {
+        // Loaded outside the lock, so different assets can load in parallel.
+        geometry = std::make_shared<Geometry>(ShapeType::MESH, scale, path);
+        addCached(key.str(), geometry);
+    }
+
+    return geometry;
 }
 
 GeometryPtr Geometry::makeMesh(const EigenSTL::vector_Vector3d &vertices)
@@ -98,6 +227,44 @@ GeometryPtr Geometry::makeMesh(const EigenSTL::vector_Vector3d &vertices)
     return std::make_shared<Geometry>(ShapeType::MESH, Eigen::Vector3d::Ones(), "", vertices);
 }
 
+GeometryPtr Geometry::makeShape(const shapes::Shape &shape)
+{
+    if (shape.type != shapes::ShapeType::MESH)
+        return std::make_shared<Geometry>(shape);
+
+    const auto &mesh = static_cast<const shapes::Mesh &>(shape);
+    const auto &key = getMeshKey(mesh);
+
+    // Meshes with the same hash are compared in full, so collisions only cost a reload.
+    auto geometry = getCached(key);
+    if (geometry and isSameMesh(mesh, static_cast<const shapes::Mesh &>(*geometry->getShape())))
+        return geometry;
+
+    geometry = std::make_shared<Geometry>(shape);
+    addCached(key, geometry);
+    return geometry;
+}
+
+shapes::ShapeConstPtr Geometry::getConvexHull(const shapes::Mesh &mesh)
+{
+    std::unique_ptr<bodies::ConvexMesh> body;
+    return getHull(getMeshKey(mesh), [&] {
+        body.reset(new bodies::ConvexMesh(&mesh));
+        return body.get();
+    });
+}
+
+void Geometry::clearCache()
+{
+    {
+        std::unique_lock<std::mutex> lock(CACHE_MUTEX);
+        CACHE.clear();
+    }
+
+    std::unique_lock<std::mutex> lock(HULL_MUTEX);
+    HULLS.clear();
+}
+
 Geometry::Geometry(ShapeType::Type type, const Eigen::Vector3d &dimensions, const std::string &resource,
                    const EigenSTL::vector_Vector3d &vertices)
   : type_(type)
@@ -107,6 +274,7 @@ Geometry::Geometry(ShapeType::Type type, const Eigen::Vector3d &dimensions, cons
   , shape_(loadShape())
   , body_(loadBody())
 {
+    loadSampler();
 }
 
 Geometry::Geometry(const shapes::Shape &shape)
@@ -157,6 +325,7 @@ Geometry::Geometry(const shapes::Shape &shape)
     }
 
     body_.reset(loadBody());
+    loadSampler();
 }
 
 Geometry::Geometry(const shape_msgs::SolidPrimitive &msg) : Geometry(*shapes::constructShapeFromMsg(msg))
@@ -189,7 +358,22 @@ shapes::Shape *Geometry::loadShape() const
 
         case ShapeType::MESH:
             if (!resource_.empty() && vertices_.empty())
-                return shapes::createMeshFromResource("file://" + resource_, dimensions_);
+            {
+                // Parse the mesh straight from a mapping of the file, rather than copying it in first.
+                const auto &file = IO::mapFile(resource_);
+                if (!file)
+                    return nullptr;
+
+                std::string hint;
+                const auto pos = resource_.find_last_of('.');
+                if (pos != std::string::npos)
+                {
+                    hint = resource_.substr(pos + 1);
+                    std::transform(hint.begin(), hint.end(), hint.begin(), ::tolower);
+                }
+
+                return shapes::createMeshFromBinary(file->data(), file->size(), dimensions_, hint);
+            }
             else if (resource_.empty() && !vertices_.empty())
                 return shapes::createMeshFromVertices(vertices_);
             else
@@ -232,22 +416,199 @@ bodies::Body *Geometry::loadBody() const
     return nullptr;
 }
 
+void Geometry::loadSampler()
+{
+    const auto *mesh = dynamic_cast<const bodies::ConvexMesh *>(body_.get());
+    if (not mesh)
+        return;
+
+    const auto &vertices = mesh->getScaledVertices();
+    const auto &triangles = mesh->getTriangles();
+    if (vertices.empty() or triangles.size() < 3)
+        return;
+
+    // The hull is convex, so it is covered by the tetrahedra between its faces and any interior point.
+    center_ = Eigen::Vector3d::Zero();
+    for (const auto &vertex : vertices)
+        center_ += vertex;
+    center_ /= vertices.size();
+
+    double total = 0;
+    for (std::size_t i = 0; i + 2 < triangles.size(); i += 3)
+    {
+        const auto &a = vertices[triangles[i]];
+        const auto &b = vertices[triangles[i + 1]];
+        const auto &c = vertices[triangles[i + 2]];
+
+        total += std::abs((a - center_).dot((b - center_).cross(c - center_))) / 6.;
+        volumes_.emplace_back(total);
+
+        tetrahedra_.emplace_back(a);
+        tetrahedra_.emplace_back(b);
+        tetrahedra_.emplace_back(c);
+    }
+
+    if (total <= 0)
+    {
+        tetrahedra_.clear();
+        volumes_.clear();
+    }
+}
+
 bool Geometry::contains(const Eigen::Vector3d &point) const
 {
+    if (type_ == ShapeType::CONE)
+        return contains(Eigen::Matrix3Xd(point))[0];
+
     return body_->containsPoint(point[0], point[1], point[2]);
 }
 
+Eigen::Array<bool, Eigen::Dynamic, 1>
+Geometry::contains(const Eigen::Ref<const Eigen::Matrix3Xd> &points) const
+{
+    const auto &x = points.row(0).transpose().array();
+    const auto &y = points.row(1).transpose().array();
+    const auto &z = points.row(2).transpose().array();
+
+    const auto &d = dimensions_;
+    switch (type_)
+    {
+        case ShapeType::BOX:
+            return x.abs() <= d[0] / 2 and y.abs() <= d[1] / 2 and z.abs() <= d[2] / 2;
+
+        case ShapeType::SPHERE:
+            return points.colwise().squaredNorm().transpose().array() <= d[0] * d[0];
+
+        case ShapeType::CYLINDER:
+            return z.abs() <= d[1] / 2 and (x.square() + y.square()) <= d[0] * d[0];
+
+        case ShapeType::CONE:
+        {
+            // The apex is at +length / 2, and the base at -length / 2.
+            const Eigen::ArrayXd radius = d[0] * (d[1] / 2 - z) / d[1];
+            return z.abs() <= d[1] / 2 and (x.square() + y.square()) <= radius.square();
+        }
+
+        case ShapeType::MESH:
+        default:
+        {
+            Eigen::Array<bool, Eigen::Dynamic, 1> result(points.cols());
+            for (Eigen::Index i = 0; i < points.cols(); ++i)
+                result[i] = body_->containsPoint(points(0, i), points(1, i), points(2, i));
+
+            return result;
+        }
+    }
+}
+
 std::pair<bool, Eigen::Vector3d> Geometry::sample(const unsigned int attempts) const
 {
-    bool success;
-    Eigen::Vector3d point;
-    random_numbers::RandomNumberGenerator rng;
+    Eigen::Matrix3Xd point(3, 1);
+    const bool success = sample(point, attempts);
 
-    if (!(success = body_->samplePointInside(rng, attempts, point)))
-        point = Eigen::Vector3d{0, 0, 0};
+    return std::make_pair(success, point.col(0));
+}
 
-    return std::make_pair(success, point);
+bool Geometry::sample(Eigen::Ref<Eigen::Matrix3Xd> points, const unsigned int attempts) const
+{
+    const auto &d = dimensions_;
+    bool success = true;
+
+    for (Eigen::Index i = 0; i < points.cols(); ++i)
+    {
+        auto point = points.col(i);
+        switch (type_)
+        {
+            case ShapeType::BOX:
+                point = RNG::uniformVec(d / 2);
+                break;
+
+            case ShapeType::SPHERE:
+            {
+                // Uniform direction, with radius distributed as the cube root for uniform volume.
+                Eigen::Vector3d direction = RNG::gaussianVec(Eigen::Vector3d::Ones());
+                while (direction.squaredNorm() < constants::eps)
+                    direction = RNG::gaussianVec(Eigen::Vector3d::Ones());
+
+                point = direction.normalized() * d[0] * std::cbrt(RNG::uniform01());
+                break;
+            }
+
+            case ShapeType::CYLINDER:
+            {
+                const double r = d[0] * std::sqrt(RNG::uniform01());
+                const double theta = RNG::uniformReal(-constants::pi, constants::pi);
+                point = Eigen::Vector3d{r * std::cos(theta), r * std::sin(theta),
+                                        RNG::uniformReal(-d[1] / 2, d[1] / 2)};
+                break;
+            }
+
+            case ShapeType::CONE:
+            {
+                // Cross sections grow with the square of the distance from the apex.
+                const double t = std::cbrt(RNG::uniform01());
+                const double r = d[0] * t * std::sqrt(RNG::uniform01());
+                const double theta = RNG::uniformReal(-constants::pi, constants::pi);
+                point = Eigen::Vector3d{r * std::cos(theta), r * std::sin(theta), d[1] / 2 - t * d[1]};
+                break;
+            }
+
+            case ShapeType::MESH:
+            default:
+            {
+                if (volumes_.empty())
+                {
+                    random_numbers::RandomNumberGenerator rng;
+                    Eigen::Vector3d sampled;
+                    if (body_->samplePointInside(rng, attempts, sampled))
+                        point = sampled;
+                    else
+                    {
+                        point = Eigen::Vector3d::Zero();
+                        success = false;
+                    }
+
+                    break;
+                }
+
+                // Pick a tetrahedron by volume, then a point uniformly within it.
+                const double pick = RNG::uniformReal(0, volumes_.back());
+                const std::size_t j = std::min<std::size_t>(
+                    std::upper_bound(volumes_.begin(), volumes_.end(), pick) - volumes_.begin(),
+                    volumes_.size() - 1);
+
+                double s = RNG::uniform01();
+                double t = RNG::uniform01();
+                double u = RNG::uniform01();
+                if (s + t > 1)
+                {
+                    s = 1 - s;
+                    t = 1 - t;
+                }
+
+                if (t + u > 1)
+                {
+                    const double v = u;
+                    u = 1 - s - t;
+                    t = 1 - v;
+                }
+                else if (s + t + u > 1)
+                {
+                    const double v = u;
+                    u = s + t + u - 1;
+                    s = 1 - t - v;
+                }
+
+                point = center_ + s * (tetrahedra_[3 * j] - center_) +
+                        t * (tetrahedra_[3 * j + 1] - center_) + u * (tetrahedra_[3 * j + 2] - center_);
+                break;
+            }
+        }
+    }
+
+    return success;
 }
+
 bool Geometry::isMesh() const
 {
     return type_ == ShapeType::MESH;
@@ -281,6 +642,16 @@ const bodies::BodyPtr &Geometry::getBody() const
     return body_;
 }
 
+shapes::ShapeConstPtr Geometry::getConvexHull() const
+{
+    if (type_ != ShapeType::MESH or not shape_)
+        return nullptr;
+
+    // The body of a mesh is its convex hull, so it is reused instead of hulling the mesh again.
+    return getHull(getMeshKey(static_cast<const shapes::Mesh &>(*shape_)),
+                   [this] { return dynamic_cast<const bodies::ConvexMesh *>(body_.get()); });
+}
+
 Geometry::ShapeType::Type Geometry::getType() const
 {
     return type_;
@@ -1,15 +1,26 @@
 /* Author: Zachary Kingston */
 
 #include <robowflex_library/id.h>
-#include <robowflex_library/io.h>
+#include <robowflex_library/io/handler.h>
 
 using namespace robowflex;
 
-ID::ID() : id_(IO::generateUUID()), version_(0)
+namespace
 {
+    std::atomic<std::uint64_t> NEXT_ID{1};  ///< Next numeric ID. 0 is reserved for the null key.
+}  // namespace
+
+ID::ID() : id_(NEXT_ID++), version_(0)
+{
+}
+
+std::string ID::getID() const
+{
+    // The process UUID makes the string form unique across processes.
+    return IO::Handler::UUID + "-" + std::to_string(id_);
 }
 
-const std::string &ID::getID() const
+std::uint64_t ID::getNumericID() const
 {
     return id_;
 }
@@ -21,22 +32,22 @@ std::size_t ID::getVersion() const
 
 ID::Key ID::getKey() const
 {
-    return {getID(), getVersion()};
+    return {id_, getVersion()};
 }
 
 ID::Key ID::getNullKey()
 {
-    return {"NULL", 0};
+    return {0, 0};
 }
 
 bool ID::operator==(const ID &b) const
 {
-    return getID() == b.getID() and getVersion() == b.getVersion();
+    return id_ == b.id_ and getVersion() == b.getVersion();
 }
 
 bool ID::operator==(const ID::Key &b) const
 {
-    return getID() == b.first and getVersion() == b.second;
+    return id_ == b.first and getVersion() == b.second;
 }
 
 void ID::incrementVersion()
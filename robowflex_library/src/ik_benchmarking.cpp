@@ -0,0 +1,309 @@
+/* Author: Zachary Kingston */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <limits>
+
+#include <random_numbers/random_numbers.h>
+
+#include <robowflex_library/ik_benchmarking.h>
+#include <robowflex_library/io.h>
+#include <robowflex_library/log.h>
+#include <robowflex_library/pool.h>
+#include <robowflex_library/robot.h>
+#include <robowflex_library/scene.h>
+
+using namespace robowflex;
+
+///
+/// IKExperiment
+///
+
+IKExperiment::IKExperiment(const std::string &name, const std::string &group, const std::string &tip,
+                           const Options &options)
+  : name_(name), group_(group), tip_(tip), options_(options)
+{
+}
+
+void IKExperiment::addKinematics(const std::string &name, const RobotPtr &robot)
+{
+    kinematics_.emplace_back(name, robot);
+}
+
+void IKExperiment::setScene(const SceneConstPtr &scene)
+{
+    scene_ = scene;
+    targets_.clear();
+}
+
+bool IKExperiment::generateTargets()
+{
+    targets_.clear();
+
+    if (kinematics_.empty())
+    {
+        RBX_ERROR("No kinematics configurations to generate targets for!");
+        return false;
+    }
+
+    const auto &robot = kinematics_.front().second;
+    const auto &jmg = robot->getModelConst()->getJointModelGroup(group_);
+    if (not jmg)
+    {
+        RBX_ERROR("No group `%s` to generate targets for!", group_);
+        return false;
+    }
+
+    if (tip_.empty())
+    {
+        const auto &tips = robot->getSolverTipFrames(group_);
+        if (tips.empty())
+        {
+            RBX_ERROR("Group `%s` has no solver tip frame!", group_);
+            return false;
+        }
+
+        tip_ = tips[0];
+    }
+
+    random_numbers::RandomNumberGenerator rng(options_.seed);
+    robot_state::RobotState state = *robot->getScratchStateConst();
+
+    targets_.reserve(options_.targets);
+    while (targets_.size() < options_.targets)
+    {
+        // Targets are poses of random configurations, so every target is reachable.
+        bool found = false;
+        for (std::size_t i = 0; i < options_.max_samples and not found; ++i)
+        {
+            state.setToRandomPositions(jmg, rng);
+            state.update();
+
+            found = not scene_ or not scene_->checkCollision(state).collision;
+        }
+
+        if (not found)
+        {
+            RBX_ERROR("Failed to sample a collision-free target after %d samples!", options_.max_samples);
+            targets_.clear();
+            return false;
+        }
+
+        targets_.emplace_back(state.getGlobalLinkTransform(tip_));
+    }
+
+    return true;
+}
+
+const RobotPoseVector &IKExperiment::getTargets() const
+{
+    return targets_;
+}
+
+PlanDataSetPtr IKExperiment::benchmark()
+{
+    if (targets_.empty() and not generateTargets())
+        return nullptr;
+
+    auto dataset = std::make_shared<PlanDataSet>();
+    dataset->name = name_;
+    dataset->allowed_time = options_.timeout;
+    dataset->trials = targets_.size();
+    dataset->enforced_single_thread = false;
+    dataset->run_till_timeout = false;
+    dataset->threads = std::max<std::size_t>(options_.threads, 1);
+    dataset->start = IO::getDate();
+
+    summaries_.clear();
+
+    const auto start = std::chrono::steady_clock::now();
+    for (const auto &pair : kinematics_)
+    {
+        const auto kinematics_start = std::chrono::steady_clock::now();
+        benchmarkKinematics(pair.first, pair.second, *dataset);
+        const double time =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - kinematics_start).count();
+
+        const auto &summary = summarize(dataset->data[pair.first], time);
+        summaries_[pair.first] = summary;
+
+        RBX_INFO("IK `%s`: %d/%d solved, p50 %.5fs, p99 %.5fs, %.1f targets/s", pair.first, summary.solved,
+                 summary.runs, summary.latency_p50, summary.latency_p99, summary.throughput);
+    }
+
+    dataset->time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    dataset->finish = IO::getDate();
+
+    return dataset;
+}
+
+void IKExperiment::benchmarkKinematics(const std::string &name, const RobotPtr &robot, PlanDataSet &dataset)
+{
+    PlanningQuery query;
+    query.name = name;
+    query.scene = scene_;
+    query.request.group_name = group_;
+
+    dataset.query_names.emplace_back(name);
+    dataset.queries.emplace_back(query);
+
+    const auto &jmg = robot->getModelConst()->getJointModelGroup(group_);
+    const auto &initial = *robot->getScratchStateConst();
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+
+    std::vector<PlanDataPtr> runs(targets_.size());
+
+    // The calling thread also solves targets, so the pool has one thread fewer.
+    const Pool pool(std::max<std::size_t>(options_.threads, 1) - 1);
+    pool.parallelFor(
+        0, targets_.size(),
+        [&](std::size_t i) {
+            const auto &target = targets_[i];
+
+            robot_state::RobotState state = initial;
+            if (options_.random_seed)
+            {
+                // Seed states depend only on the target, so every configuration solves from the same seeds.
+                random_numbers::RandomNumberGenerator rng(options_.seed + i + 1);
+                state.setToRandomPositions(jmg, rng);
+                state.update();
+            }
+
+            const robot_state::RobotState seed = state;
+
+            Robot::IKQuery ik(group_, target, options_.radius, options_.tolerance);
+            ik.tips = {tip_};
+            ik.scene = scene_;
+            ik.attempts = options_.attempts;
+            ik.timeout = options_.timeout;
+            ik.random_restart = options_.random_seed;
+
+            auto run = std::make_shared<PlanData>();
+            run->query = query;
+            run->start = IO::getDate();
+
+            const auto solve_start = std::chrono::steady_clock::now();
+            run->success = robot->setFromIK(ik, state);
+            run->time = std::chrono::duration<double>(std::chrono::steady_clock::now() - solve_start).count();
+
+            run->finish = IO::getDate();
+            run->process_id = IO::getProcessID();
+            run->thread_id = IO::getThreadID();
+            run->cpu_id = Pool::getCurrentCPU();
+
+            run->metrics["ik_target"] = i;
+            run->metrics["ik_position_error"] = nan;
+            run->metrics["ik_orientation_error"] = nan;
+            run->metrics["ik_joint_distance"] = nan;
+
+            if (run->success)
+            {
+                state.update();
+                const auto &pose = state.getGlobalLinkTransform(tip_);
+                const Eigen::AngleAxisd rotation(target.rotation().transpose() * pose.rotation());
+
+                run->metrics["ik_position_error"] = (pose.translation() - target.translation()).norm();
+                run->metrics["ik_orientation_error"] = std::fabs(rotation.angle());
+                run->metrics["ik_joint_distance"] = state.distance(seed, jmg);
+            }
+
+            runs[i] = run;
+        },
+        1);
+
+    static const std::string hostname = IO::getHostname();
+    for (const auto &run : runs)
+    {
+        run->hostname = hostname;
+        dataset.addDataPoint(name, run);
+    }
+}
+
+const std::map<std::string, IKExperiment::Summary> &IKExperiment::getSummaries() const
+{
+    return summaries_;
+}
+
+IKExperiment::Summary IKExperiment::summarize(const std::vector<PlanDataPtr> &runs, double time)
+{
+    Summary summary;
+    summary.runs = runs.size();
+    if (runs.empty())
+        return summary;
+
+    std::vector<double> latencies;
+    latencies.reserve(runs.size());
+    for (const auto &run : runs)
+    {
+        latencies.emplace_back(run->time);
+        summary.latency_mean += run->time;
+
+        if (not run->success)
+            continue;
+
+        ++summary.solved;
+
+        double value;
+        if (run->getMetricValue("ik_position_error", value))
+            summary.position_error += value;
+        if (run->getMetricValue("ik_orientation_error", value))
+            summary.orientation_error += value;
+        if (run->getMetricValue("ik_joint_distance", value))
+            summary.joint_distance += value;
+    }
+
+    summary.solve_rate = double(summary.solved) / summary.runs;
+    summary.throughput = (time > 0) ? summary.runs / time : 0.;
+    summary.latency_mean /= summary.runs;
+
+    if (summary.solved)
+    {
+        summary.position_error /= summary.solved;
+        summary.orientation_error /= summary.solved;
+        summary.joint_distance /= summary.solved;
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    const auto &at = [&](double p) {
+        return latencies[static_cast<std::size_t>(p * (latencies.size() - 1) + 0.5)];
+    };
+
+    summary.latency_p50 = at(0.5);
+    summary.latency_p90 = at(0.9);
+    summary.latency_p99 = at(0.99);
+
+    return summary;
+}
+
+bool IKExperiment::toCSVFile(const std::string &filename) const
+{
+    std::ofstream out;
+    IO::createFile(out, filename);
+    if (not out.is_open())
+    {
+        RBX_ERROR("Failed to open %s for writing", filename);
+        return false;
+    }
+
+    out << "kinematics,runs,solved,solve_rate,throughput,latency_mean,latency_p50,latency_p90,latency_p99,"
+           "position_error,orientation_error,joint_distance"
+        << std::endl;
+
+    for (const auto &pair : kinematics_)
+    {
+        auto it = summaries_.find(pair.first);
+        if (it == summaries_.end())
+            continue;
+
+        const auto &summary = it->second;
+        out << pair.first << "," << summary.runs << "," << summary.solved << "," << summary.solve_rate << ","
+            << summary.throughput << "," << summary.latency_mean << "," << summary.latency_p50 << ","
+            << summary.latency_p90 << "," << summary.latency_p99 << "," << summary.position_error << ","
+            << summary.orientation_error << "," << summary.joint_distance << std::endl;
+    }
+
+    out.close();
+    return true;
+}
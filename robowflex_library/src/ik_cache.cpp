@@ -0,0 +1,199 @@
+/* Author: Zachary Kingston */
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+#include <robowflex_library/ik_cache.h>
+#include <robowflex_library/io.h>
+#include <robowflex_library/io/yaml.h>
+#include <robowflex_library/log.h>
+
+using namespace robowflex;
+
+IKCache::IKCache(double position_resolution, double orientation_resolution, std::size_t capacity,
+                 std::size_t seeds)
+  : position_resolution_(position_resolution)
+  , orientation_resolution_(orientation_resolution)
+  , capacity_(capacity)
+  , seeds_(seeds)
+{
+}
+
+bool IKCache::lookup(const Robot::IKQuery &query, std::vector<std::vector<double>> &seeds) const
+{
+    const auto &key = getKey(query);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto it = index_.find(key);
+    if (it == index_.end())
+    {
+        ++misses_;
+        return false;
+    }
+
+    ++hits_;
+    entries_.splice(entries_.begin(), entries_, it->second);
+    seeds = it->second->seeds;
+    return true;
+}
+
+void IKCache::insert(const Robot::IKQuery &query, const robot_state::RobotState &state)
+{
+    std::vector<double> seed;
+    state.copyJointGroupPositions(query.group, seed);
+
+    const auto &key = getKey(query);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    insertKey(key, seed);
+}
+
+void IKCache::insertKey(const std::string &key, const std::vector<double> &seed)
+{
+    auto it = index_.find(key);
+    if (it == index_.end())
+    {
+        entries_.push_front(Entry{key, {}});
+        it = index_.emplace(key, entries_.begin()).first;
+    }
+    else
+        entries_.splice(entries_.begin(), entries_, it->second);
+
+    auto &seeds = it->second->seeds;
+
+    // Drop a stored copy of this solution, so it moves to the front.
+    auto sit = std::find(seeds.begin(), seeds.end(), seed);
+    if (sit != seeds.end())
+        seeds.erase(sit);
+
+    seeds.insert(seeds.begin(), seed);
+    if (seeds.size() > seeds_)
+        seeds.resize(seeds_);
+
+    while (entries_.size() > capacity_)
+    {
+        index_.erase(entries_.back().key);
+        entries_.pop_back();
+    }
+}
+
+void IKCache::clear()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    entries_.clear();
+    index_.clear();
+}
+
+std::size_t IKCache::size() const
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    return entries_.size();
+}
+
+std::size_t IKCache::getHits() const
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    return hits_;
+}
+
+std::size_t IKCache::getMisses() const
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    return misses_;
+}
+
+bool IKCache::save(const std::string &filename) const
+{
+    YAML::Node node;
+    node["position_resolution"] = position_resolution_;
+    node["orientation_resolution"] = orientation_resolution_;
+
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (const auto &entry : entries_)
+        {
+            YAML::Node e;
+            e["key"] = entry.key;
+            e["seeds"] = entry.seeds;
+            node["entries"].push_back(e);
+        }
+    }
+
+    return IO::YAMLToFile(node, filename);
+}
+
+bool IKCache::load(const std::string &filename)
+{
+    const auto &yaml = IO::loadFileToYAML(filename);
+    if (not yaml.first)
+    {
+        RBX_ERROR("Failed to load IK cache from `%s`.", filename);
+        return false;
+    }
+
+    const auto &node = yaml.second;
+
+    try
+    {
+        if (node["position_resolution"].as<double>() != position_resolution_ or
+            node["orientation_resolution"].as<double>() != orientation_resolution_)
+        {
+            RBX_ERROR("IK cache `%s` was saved with different resolutions!", filename);
+            return false;
+        }
+
+        if (not IO::isNode(node["entries"]))
+            return true;
+
+        // Entries are saved most recent first, so add them in reverse to keep their order.
+        const auto &entries = node["entries"];
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (std::size_t i = entries.size(); i > 0; --i)
+        {
+            const auto &key = entries[i - 1]["key"].as<std::string>();
+            const auto &seeds = entries[i - 1]["seeds"].as<std::vector<std::vector<double>>>();
+
+            for (auto it = seeds.rbegin(); it != seeds.rend(); ++it)
+                insertKey(key, *it);
+        }
+    }
+    catch (const YAML::Exception &e)
+    {
+        RBX_ERROR("Failed to parse IK cache `%s`: %s", filename, e.what());
+        return false;
+    }
+
+    return true;
+}
+
+std::string IKCache::getKey(const Robot::IKQuery &query) const
+{
+    std::stringstream ss;
+    ss << query.group;
+
+    for (std::size_t i = 0; i < query.tips.size(); ++i)
+    {
+        ss << ";" << query.tips[i];
+
+        if (i < query.region_poses.size())
+        {
+            const auto &p = query.region_poses[i].translation();
+            for (std::size_t j = 0; j < 3; ++j)
+                ss << "," << std::lround(p[j] / position_resolution_);
+        }
+
+        if (i < query.orientations.size())
+        {
+            // q and -q are the same rotation, so pick the one with non-negative w.
+            auto q = query.orientations[i].normalized();
+            if (q.w() < 0)
+                q.coeffs() *= -1;
+
+            for (std::size_t j = 0; j < 4; ++j)
+                ss << "," << std::lround(q.coeffs()[j] / orientation_resolution_);
+        }
+    }
+
+    return ss.str();
+}
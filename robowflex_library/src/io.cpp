@@ -1,10 +1,22 @@
 /* Author: Zachary Kingston */
 
 #include <array>    // for std::array
+#include <atomic>   // for std::atomic
 #include <cstdlib>  // for std::getenv
+#include <cstring>  // for std::memcpy
+#include <iomanip>  // for std::setw
+#include <map>      // for std::map
 #include <memory>   // for std::shared_ptr
+#include <mutex>    // for std::mutex
 #include <regex>    // for std::regex
+#include <sstream>  // for std::istringstream
 #include <thread>
+#include <unordered_map>  // for std::unordered_map
+
+#include <fcntl.h>     // for open
+#include <sys/mman.h>  // for mmap
+#include <sys/stat.h>  // for fstat
+#include <unistd.h>    // for close
 
 #include <boost/asio/ip/host_name.hpp>                        // for hostname
 #include <boost/interprocess/detail/os_thread_functions.hpp>  // for process / thread IDs
@@ -18,6 +30,7 @@
 #include <robowflex_library/io.h>
 #include <robowflex_library/io/bag.h>
 #include <robowflex_library/io/handler.h>
+#include <robowflex_library/io/xacro.h>
 #include <robowflex_library/log.h>
 #include <robowflex_library/macros.h>
 #include <robowflex_library/util.h>
@@ -83,6 +96,30 @@ namespace
         const std::string last = boost::filesystem::extension(path);
         return isSuffix(extension, last);
     }
+
+    std::mutex PATH_MUTEX;                                       ///< Mutex for the path caches.
+    std::unordered_map<std::string, std::string> PACKAGE_CACHE;  ///< Package locations, by name.
+    std::unordered_map<std::string, std::string> PATH_CACHE;     ///< Canonical paths, by requested path.
+
+    std::string getPackagePath(const std::string &package_name)
+    {
+        {
+            std::unique_lock<std::mutex> lock(PATH_MUTEX);
+            auto it = PACKAGE_CACHE.find(package_name);
+            if (it != PACKAGE_CACHE.end())
+                return it->second;
+        }
+
+        // Missing packages are not cached, as they may appear on the package path later.
+        const std::string package = ros::package::getPath(package_name);
+        if (not package.empty())
+        {
+            std::unique_lock<std::mutex> lock(PATH_MUTEX);
+            PACKAGE_CACHE.emplace(package_name, package);
+        }
+
+        return package;
+    }
 }  // namespace
 
 std::string IO::resolvePackage(const std::string &path)
@@ -98,7 +135,7 @@ std::string IO::resolvePackage(const std::string &path)
         boost::filesystem::path subpath(path.substr(prefix.length(), path.length() - 1));
         const std::string package_name = (*subpath.begin()).string();
 
-        const std::string package = ros::package::getPath(package_name);
+        const std::string package = getPackagePath(package_name);
         if (package.empty())
         {
             RBX_WARN("Package `%s` does not exist.", package_name);
@@ -136,6 +173,21 @@ std::set<std::string> IO::findPackageURIs(const std::string &string)
 
 std::string IO::resolvePath(const std::string &path)
 {
+    // Relative paths depend on the working directory, so only absolute paths and URIs are cached.
+    const bool cacheable = not path.empty() and (path[0] == '/' or isPrefix("package://", path));
+    if (cacheable)
+    {
+        std::unique_lock<std::mutex> lock(PATH_MUTEX);
+        auto it = PATH_CACHE.find(path);
+        if (it != PATH_CACHE.end())
+        {
+            if (boost::filesystem::exists(it->second))
+                return it->second;
+
+            PATH_CACHE.erase(it);
+        }
+    }
+
     boost::filesystem::path file = resolvePackage(path);
 
     if (!boost::filesystem::exists(file))
@@ -144,7 +196,21 @@ std::string IO::resolvePath(const std::string &path)
         return "";
     }
 
-    return boost::filesystem::canonical(boost::filesystem::absolute(file)).string();
+    const std::string resolved = boost::filesystem::canonical(boost::filesystem::absolute(file)).string();
+    if (cacheable)
+    {
+        std::unique_lock<std::mutex> lock(PATH_MUTEX);
+        PATH_CACHE[path] = resolved;
+    }
+
+    return resolved;
+}
+
+void IO::clearPathCache()
+{
+    std::unique_lock<std::mutex> lock(PATH_MUTEX);
+    PACKAGE_CACHE.clear();
+    PATH_CACHE.clear();
 }
 
 std::string IO::resolveParent(const std::string &path)
@@ -178,9 +244,78 @@ std::string IO::loadFileToString(const std::string &path)
     return std::string(bytes.data(), size);
 }
 
+IO::MappedFile::MappedFile(const std::string &path)
+{
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        RBX_ERROR("Failed to open `%s` for mapping!", path);
+        return;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) == 0)
+    {
+        size_ = info.st_size;
+
+        // Empty files cannot be mapped, but are trivially "open".
+        if (size_ == 0)
+            open_ = true;
+        else
+        {
+            void *data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED)
+            {
+                data_ = static_cast<const char *>(data);
+                open_ = true;
+            }
+        }
+    }
+
+    // The mapping stays valid after the descriptor is closed.
+    close(fd);
+
+    if (not open_)
+        RBX_ERROR("Failed to map `%s`!", path);
+}
+
+IO::MappedFile::~MappedFile()
+{
+    if (data_)
+        munmap(const_cast<char *>(data_), size_);
+}
+
+bool IO::MappedFile::isOpen() const
+{
+    return open_;
+}
+
+const char *IO::MappedFile::data() const
+{
+    return data_;
+}
+
+std::size_t IO::MappedFile::size() const
+{
+    return size_;
+}
+
+std::shared_ptr<const IO::MappedFile> IO::mapFile(const std::string &path)
+{
+    const std::string full_path = resolvePath(path);
+    if (full_path.empty())
+        return nullptr;
+
+    auto file = std::make_shared<const MappedFile>(full_path);
+    if (not file->isOpen())
+        return nullptr;
+
+    return file;
+}
+
 std::string IO::runCommand(const std::string &cmd)
 {
-    std::array<char, 128> buffer;
+    std::array<char, 4096> buffer;
     std::string result;
     std::shared_ptr<FILE> pipe(popen(cmd.c_str(), "r"), pclose);
     if (!pipe)
@@ -189,21 +324,127 @@ std::string IO::runCommand(const std::string &cmd)
         return "";
     }
 
-    while (!feof(pipe.get()))
-    {
-        if (fgets(buffer.data(), 128, pipe.get()) != nullptr)
-            result += buffer.data();
-    }
+    std::size_t n;
+    while ((n = fread(buffer.data(), 1, buffer.size(), pipe.get())) > 0)
+        result.append(buffer.data(), n);
 
     return result;
 }
 
+namespace
+{
+    /** \brief An expanded xacro file, with the modification times of every file it was expanded from.
+     */
+    struct XacroEntry
+    {
+        std::vector<std::pair<std::string, std::time_t>> files;  ///< Files read and their modification times.
+        std::string result;                                      ///< Expanded XML.
+    };
+
+    std::mutex XACRO_MUTEX;                         ///< Mutex for the xacro cache.
+    std::map<std::string, XacroEntry> XACRO_CACHE;  ///< Expanded xacro files, by path.
+
+    std::time_t getModificationTime(const std::string &file)
+    {
+        boost::system::error_code ec;
+        const auto time = boost::filesystem::last_write_time(file, ec);
+        return (ec) ? -1 : time;
+    }
+
+    /** \brief Get the cached expansion of a xacro file, if none of its files have changed since.
+     */
+    bool getCachedXacro(const std::string &path, XacroEntry &entry)
+    {
+        std::unique_lock<std::mutex> lock(XACRO_MUTEX);
+        auto it = XACRO_CACHE.find(path);
+        if (it == XACRO_CACHE.end())
+            return false;
+
+        for (const auto &file : it->second.files)
+            if (getModificationTime(file.first) != file.second)
+            {
+                XACRO_CACHE.erase(it);
+                return false;
+            }
+
+        entry = it->second;
+        return true;
+    }
+
+    /** \brief Expand a xacro file, natively if possible, and through the xacro tool otherwise.
+     */
+    XacroEntry expandXacro(const std::string &full_path)
+    {
+        XacroEntry entry;
+        if (getCachedXacro(full_path, entry))
+            return entry;
+
+        // Record modification times before reading, so changes made during the expansion are caught.
+        std::vector<std::string> files;
+        const std::time_t time = getModificationTime(full_path);
+
+        if (IO::expandXacro(full_path, entry.result, files))
+        {
+            for (const auto &file : files)
+                entry.files.emplace_back(file, getModificationTime(file));
+
+            if (not files.empty() and files[0] == full_path)
+                entry.files[0].second = time;
+        }
+        else
+        {
+            std::string cmd = "rosrun xacro xacro ";
+
+#if ROBOWFLEX_AT_LEAST_MELODIC
+#else
+            cmd += "--inorder ";
+#endif
+
+            cmd += full_path;
+            entry.result = IO::runCommand(cmd);
+
+            // Without the native expansion, only the top-level file is tracked.
+            entry.files.emplace_back(full_path, time);
+        }
+
+        if (not entry.result.empty())
+        {
+            std::unique_lock<std::mutex> lock(XACRO_MUTEX);
+            XACRO_CACHE[full_path] = entry;
+        }
+
+        return entry;
+    }
+}  // namespace
+
 std::string IO::loadXacroToString(const std::string &path)
 {
     const std::string full_path = resolvePath(path);
     if (full_path.empty())
         return "";
 
+    return ::expandXacro(full_path).result;
+}
+
+std::vector<std::string> IO::getXacroDependencies(const std::string &path)
+{
+    const std::string full_path = resolvePath(path);
+    if (full_path.empty())
+        return {};
+
+    // The native expansion already knows every file it read.
+    std::string result;
+    std::vector<std::string> files;
+    if (IO::expandXacro(full_path, result, files))
+    {
+        std::vector<std::string> dependencies;
+        for (const auto &file : files)
+            if (file != full_path)
+                dependencies.emplace_back(file);
+
+        return dependencies;
+    }
+
     std::string cmd = "rosrun xacro xacro ";
 
 #if ROBOWFLEX_AT_LEAST_MELODIC
@@ -211,8 +452,33 @@ std::string IO::loadXacroToString(const std::string &path)
     cmd += "--inorder ";
 #endif
 
-    cmd += full_path;
-    return runCommand(cmd);
+    cmd += "--deps " + full_path;
+
+    std::vector<std::string> dependencies;
+    std::istringstream ss(runCommand(cmd));
+    std::string file;
+    while (ss >> file)
+    {
+        const auto &resolved = resolvePath(file);
+        if (not resolved.empty() and resolved != full_path)
+            dependencies.emplace_back(resolved);
+    }
+
+    return dependencies;
+}
+
+std::string IO::hashString(const std::string &string)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (const auto &c : string)
+    {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ULL;
+    }
+
+    std::ostringstream ss;
+    ss << std::hex << std::setw(16) << std::setfill('0') << hash;
+    return ss.str();
 }
 
 std::string IO::loadXMLToString(const std::string &path)
@@ -281,6 +547,111 @@ bool IO::YAMLToFile(const YAML::Node &node, const std::string &file)
     return true;
 }
 
+namespace
+{
+    const char BINARY_MAGIC[8] = {'R', 'B', 'X', 'M', 'S', 'G', '\0', '\0'};  ///< Binary file magic.
+    const uint32_t BINARY_VERSION = 1;                                         ///< Binary file version.
+}  // namespace
+
+bool IO::isBinaryFile(const std::string &file)
+{
+    // Exact, as isExtension() also matches paths without an extension and extensions ending in "bin".
+    return boost::filesystem::extension(file) == ".bin";
+}
+
+bool IO::writeBinaryFile(const std::string &file, const std::string &md5,
+                         const std::vector<uint8_t> &data)
+{
+    std::ofstream out;
+    createFile(out, file);
+    if (not out)
+    {
+        RBX_ERROR("Failed to open `%s` for writing!", file);
+        return false;
+    }
+
+    const uint64_t size = data.size();
+    const uint32_t md5_size = md5.size();
+
+    out.write(BINARY_MAGIC, sizeof(BINARY_MAGIC));
+    out.write(reinterpret_cast<const char *>(&BINARY_VERSION), sizeof(BINARY_VERSION));
+    out.write(reinterpret_cast<const char *>(&md5_size), sizeof(md5_size));
+    out.write(md5.data(), md5_size);
+    out.write(reinterpret_cast<const char *>(&size), sizeof(size));
+    out.write(reinterpret_cast<const char *>(data.data()), size);
+
+    return static_cast<bool>(out);
+}
+
+bool IO::readBinaryFile(const std::string &file, const std::string &md5, std::vector<uint8_t> &data)
+{
+    const auto &mapped = mapFile(file);
+    if (not mapped)
+        return false;
+
+    const char *begin = mapped->data();
+    const char *end = begin + mapped->size();
+    const char *it = begin;
+
+    const auto read = [&](void *out, std::size_t n) {
+        if (static_cast<std::size_t>(end - it) < n)
+            return false;
+
+        std::memcpy(out, it, n);
+        it += n;
+        return true;
+    };
+
+    char magic[sizeof(BINARY_MAGIC)];
+    uint32_t version;
+    uint32_t md5_size;
+    if (not read(magic, sizeof(magic)) or std::memcmp(magic, BINARY_MAGIC, sizeof(magic)) != 0 or
+        not read(&version, sizeof(version)) or not read(&md5_size, sizeof(md5_size)))
+    {
+        RBX_ERROR("`%s` is not a binary message file!", file);
+        return false;
+    }
+
+    if (version != BINARY_VERSION)
+    {
+        RBX_ERROR("`%s` has unsupported binary version %d!", file, version);
+        return false;
+    }
+
+    std::string file_md5(md5_size, '\0');
+    uint64_t size;
+    if (not read(&file_md5[0], md5_size) or not read(&size, sizeof(size)) or
+        static_cast<uint64_t>(end - it) < size)
+    {
+        RBX_ERROR("`%s` is truncated!", file);
+        return false;
+    }
+
+    if (file_md5 != md5)
+    {
+        RBX_ERROR("`%s` contains a different message type (MD5 %s, expected %s)!", file, file_md5, md5);
+        return false;
+    }
+
+    data.assign(it, it + size);
+    return true;
+}
+
+std::string IO::getHash(const std::vector<uint8_t> &data)
+{
+    // 64-bit FNV-1a.
+    uint64_t hash = 14695981039346656037ULL;
+    for (const auto &byte : data)
+    {
+        hash ^= byte;
+        hash *= 1099511628211ULL;
+    }
+
+    std::stringstream ss;
+    ss << std::hex << std::setw(16) << std::setfill('0') << hash;
+    return ss.str();
+}
+
 std::string IO::generateUUID()
 {
     boost::uuids::random_generator gen;
@@ -509,20 +880,211 @@ namespace
     }
 }  // namespace
 
+namespace
+{
+    /** \brief If true, new handlers push their parameters to the ROS master. */
+    std::atomic<bool> PUSH_TO_MASTER(true);
+}  // namespace
+
 IO::Handler::Handler(const std::string &name)
-  : name_(name), namespace_("robowflex_" + UUID + "/" + name_), nh_(namespace_)
+  : name_(name)
+  , namespace_("robowflex_" + UUID + "/" + name_)
+  , nh_(namespace_)
+  , store_(std::make_shared<Store>())
+  , push_(PUSH_TO_MASTER)
 {
 }
 
 IO::Handler::Handler(const IO::Handler &handler, const std::string &name)
-  : name_(handler.getName()), namespace_(handler.getNamespace()), nh_(handler.getHandle(), name)
+  : name_(handler.getName())
+  , namespace_(handler.getNamespace())
+  , nh_(handler.getHandle(), name)
+  , store_(handler.store_)
+  , prefix_(handler.prefix_ + ((name.empty()) ? "" : name + "/"))
+  , push_(handler.push_)
 {
 }
 
 IO::Handler::~Handler()
 {
-    for (const auto &key : params_)
-        nh_.deleteParam(key);
+    {
+        std::unique_lock<std::mutex> lock(store_->mutex);
+        for (const auto &key : params_)
+            store_->values.erase(getStoreKey(key));
+    }
+
+    if (push_)
+        for (const auto &key : params_)
+            nh_.deleteParam(key);
+}
+
+void IO::Handler::setPushToMaster(bool push)
+{
+    PUSH_TO_MASTER = push;
+}
+
+bool IO::Handler::pushesToMaster() const
+{
+    return push_;
+}
+
+std::string IO::Handler::getStoreKey(const std::string &key) const
+{
+    return prefix_ + key;
+}
+
+void IO::Handler::setValue(const std::string &key, const XmlRpc::XmlRpcValue &value)
+{
+    std::unique_lock<std::mutex> lock(store_->mutex);
+    store_->values[getStoreKey(key)] = value;
+}
+
+bool IO::Handler::getValue(const std::string &key, XmlRpc::XmlRpcValue &value) const
+{
+    const std::string full = getStoreKey(key);
+
+    std::unique_lock<std::mutex> lock(store_->mutex);
+    const auto &values = store_->values;
+
+    auto it = values.find(full);
+    if (it != values.end())
+    {
+        value = it->second;
+        return true;
+    }
+
+    // Otherwise, return the namespace as a struct of its parameters, as the ROS master would.
+    const std::string ns = full + "/";
+    XmlRpc::XmlRpcValue tree;
+    for (it = values.lower_bound(ns); it != values.end(); ++it)
+    {
+        if (it->first.compare(0, ns.size(), ns) != 0)
+            break;
+
+        XmlRpc::XmlRpcValue *node = &tree;
+
+        std::size_t begin = ns.size();
+        for (std::size_t end = it->first.find('/', begin); end != std::string::npos;
+             begin = end + 1, end = it->first.find('/', begin))
+            node = &(*node)[it->first.substr(begin, end - begin)];
+
+        (*node)[it->first.substr(begin)] = it->second;
+    }
+
+    if (not tree.valid())
+        return false;
+
+    value = tree;
+    return true;
+}
+
+std::map<std::string, XmlRpc::XmlRpcValue> IO::Handler::getParams(const std::string &prefix) const
+{
+    const std::string ns = getStoreKey((prefix.empty()) ? "" : prefix + "/");
+
+    std::unique_lock<std::mutex> lock(store_->mutex);
+    const auto &values = store_->values;
+
+    std::map<std::string, XmlRpc::XmlRpcValue> params;
+    for (auto it = values.lower_bound(ns); it != values.end(); ++it)
+    {
+        if (it->first.compare(0, ns.size(), ns) != 0)
+            break;
+
+        params.emplace(it->first.substr(ns.size()), it->second);
+    }
+
+    return params;
+}
+
+XmlRpc::XmlRpcValue IO::Handler::toXmlRpc(const XmlRpc::XmlRpcValue &value)
+{
+    return value;
+}
+
+XmlRpc::XmlRpcValue IO::Handler::toXmlRpc(bool value)
+{
+    return XmlRpc::XmlRpcValue(value);
+}
+
+XmlRpc::XmlRpcValue IO::Handler::toXmlRpc(int value)
+{
+    return XmlRpc::XmlRpcValue(value);
+}
+
+XmlRpc::XmlRpcValue IO::Handler::toXmlRpc(double value)
+{
+    return XmlRpc::XmlRpcValue(value);
+}
+
+XmlRpc::XmlRpcValue IO::Handler::toXmlRpc(const std::string &value)
+{
+    return XmlRpc::XmlRpcValue(value);
+}
+
+XmlRpc::XmlRpcValue IO::Handler::toXmlRpc(const char *value)
+{
+    return XmlRpc::XmlRpcValue(std::string(value));
+}
+
+bool IO::Handler::fromXmlRpc(const XmlRpc::XmlRpcValue &stored, XmlRpc::XmlRpcValue &value)
+{
+    value = stored;
+    return true;
+}
+
+bool IO::Handler::fromXmlRpc(const XmlRpc::XmlRpcValue &stored, bool &value)
+{
+    if (stored.getType() != XmlRpc::XmlRpcValue::TypeBoolean)
+        return false;
+
+    XmlRpc::XmlRpcValue copy(stored);
+    value = bool(copy);
+    return true;
+}
+
+bool IO::Handler::fromXmlRpc(const XmlRpc::XmlRpcValue &stored, int &value)
+{
+    if (stored.getType() != XmlRpc::XmlRpcValue::TypeInt)
+        return false;
+
+    XmlRpc::XmlRpcValue copy(stored);
+    value = int(copy);
+    return true;
+}
+
+bool IO::Handler::fromXmlRpc(const XmlRpc::XmlRpcValue &stored, double &value)
+{
+    // As with the ROS master, integers are also read as doubles.
+    XmlRpc::XmlRpcValue copy(stored);
+    if (stored.getType() == XmlRpc::XmlRpcValue::TypeDouble)
+        value = double(copy);
+    else if (stored.getType() == XmlRpc::XmlRpcValue::TypeInt)
+        value = int(copy);
+    else
+        return false;
+
+    return true;
+}
+
+bool IO::Handler::fromXmlRpc(const XmlRpc::XmlRpcValue &stored, float &value)
+{
+    double read;
+    if (not fromXmlRpc(stored, read))
+        return false;
+
+    value = float(read);
+    return true;
+}
+
+bool IO::Handler::fromXmlRpc(const XmlRpc::XmlRpcValue &stored, std::string &value)
+{
+    if (stored.getType() != XmlRpc::XmlRpcValue::TypeString)
+        return false;
+
+    XmlRpc::XmlRpcValue copy(stored);
+    value = std::string(copy);
+    return true;
 }
 
 void IO::Handler::loadYAMLtoROS(const YAML::Node &node, const std::string &prefix)
@@ -550,7 +1112,8 @@ void IO::Handler::loadYAMLtoROS(const YAML::Node &node, const std::string &prefi
 
 bool IO::Handler::hasParam(const std::string &key) const
 {
-    return nh_.hasParam(key);
+    XmlRpc::XmlRpcValue value;
+    return getValue(key, value) or (push_ and nh_.hasParam(key));
 }
 
 const ros::NodeHandle &IO::Handler::getHandle() const
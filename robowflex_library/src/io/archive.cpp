@@ -0,0 +1,226 @@
+/* Author: Zachary Kingston */
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#include <robowflex_library/io/archive.h>
+#include <robowflex_library/log.h>
+
+using namespace robowflex;
+
+namespace
+{
+    const char ARCHIVE_MAGIC[8] = {'R', 'B', 'X', 'A', 'R', 'C', 'H', '\0'};  ///< Archive file magic.
+    const uint32_t ARCHIVE_VERSION = 1;                                        ///< Archive file version.
+}  // namespace
+
+///
+/// IO::Archive
+///
+
+IO::Archive::Archive(const std::string &file) : file_(file), mapped_(mapFile(file))
+{
+    if (not mapped_)
+        return;
+
+    const char *begin = mapped_->data();
+    const char *end = begin + mapped_->size();
+    const char *it = begin;
+
+    const auto read = [&](void *out, std::size_t n) {
+        if (static_cast<std::size_t>(end - it) < n)
+            return false;
+
+        std::memcpy(out, it, n);
+        it += n;
+        return true;
+    };
+
+    const auto read_string = [&](std::string &out) {
+        uint32_t size;
+        if (not read(&size, sizeof(size)) or static_cast<std::size_t>(end - it) < size)
+            return false;
+
+        out.assign(it, size);
+        it += size;
+        return true;
+    };
+
+    char magic[sizeof(ARCHIVE_MAGIC)];
+    uint32_t version;
+    uint64_t count;
+    if (not read(magic, sizeof(magic)) or std::memcmp(magic, ARCHIVE_MAGIC, sizeof(magic)) != 0 or
+        not read(&version, sizeof(version)) or not read(&count, sizeof(count)))
+    {
+        RBX_ERROR("`%s` is not an archive!", file);
+        mapped_.reset();
+        return;
+    }
+
+    if (version != ARCHIVE_VERSION)
+    {
+        RBX_ERROR("`%s` has unsupported archive version %d!", file, version);
+        mapped_.reset();
+        return;
+    }
+
+    names_.reserve(count);
+    for (uint64_t i = 0; i < count; ++i)
+    {
+        std::string name;
+        Entry entry;
+        if (not read_string(name) or not read_string(entry.md5) or
+            not read(&entry.offset, sizeof(entry.offset)) or not read(&entry.size, sizeof(entry.size)) or
+            entry.offset > mapped_->size() or entry.size > mapped_->size() - entry.offset)
+        {
+            RBX_ERROR("`%s` is truncated!", file);
+            names_.clear();
+            index_.clear();
+            mapped_.reset();
+            return;
+        }
+
+        if (index_.emplace(name, entry).second)
+            names_.emplace_back(name);
+    }
+}
+
+bool IO::Archive::isOpen() const
+{
+    return mapped_ != nullptr;
+}
+
+const std::vector<std::string> &IO::Archive::getNames() const
+{
+    return names_;
+}
+
+std::vector<std::string> IO::Archive::getNames(const std::string &prefix) const
+{
+    std::vector<std::string> names;
+    for (const auto &name : names_)
+        if (name.compare(0, prefix.size(), prefix) == 0)
+            names.emplace_back(name);
+
+    return names;
+}
+
+bool IO::Archive::hasEntry(const std::string &name) const
+{
+    return index_.find(name) != index_.end();
+}
+
+std::string IO::Archive::getMD5(const std::string &name) const
+{
+    auto it = index_.find(name);
+    if (it == index_.end())
+        return "";
+
+    return it->second.md5;
+}
+
+bool IO::Archive::getData(const std::string &name, const uint8_t *&data, std::size_t &size) const
+{
+    auto it = index_.find(name);
+    if (it == index_.end())
+    {
+        RBX_ERROR("`%s` has no entry `%s`!", file_, name);
+        return false;
+    }
+
+    data = reinterpret_cast<const uint8_t *>(mapped_->data()) + it->second.offset;
+    size = it->second.size;
+    return true;
+}
+
+bool IO::Archive::getFile(const std::string &name, std::string &contents) const
+{
+    const uint8_t *data;
+    std::size_t size;
+    if (not getData(name, data, size))
+        return false;
+
+    contents.assign(reinterpret_cast<const char *>(data), size);
+    return true;
+}
+
+bool IO::Archive::checkMD5(const std::string &name, const std::string &md5) const
+{
+    const auto &entry_md5 = getMD5(name);
+    if (entry_md5 == md5)
+        return true;
+
+    RBX_ERROR("Entry `%s` of `%s` is a different message type (MD5 %s, expected %s)!", name, file_,
+              entry_md5, md5);
+    return false;
+}
+
+///
+/// IO::ArchiveWriter
+///
+
+void IO::ArchiveWriter::addFile(const std::string &name, const std::string &contents)
+{
+    addData(name, "", std::vector<uint8_t>(contents.begin(), contents.end()));
+}
+
+void IO::ArchiveWriter::addData(const std::string &name, const std::string &md5, std::vector<uint8_t> data)
+{
+    auto it = std::find_if(entries_.begin(), entries_.end(),
+                           [&name](const Entry &entry) { return entry.name == name; });
+    if (it != entries_.end())
+    {
+        it->md5 = md5;
+        it->data = std::move(data);
+    }
+    else
+        entries_.push_back({name, md5, std::move(data)});
+}
+
+std::size_t IO::ArchiveWriter::getCount() const
+{
+    return entries_.size();
+}
+
+bool IO::ArchiveWriter::write(const std::string &file) const
+{
+    std::ofstream out;
+    createFile(out, file);
+    if (not out)
+    {
+        RBX_ERROR("Failed to open `%s` for writing!", file);
+        return false;
+    }
+
+    // The index is written first, so its size gives the offset of the first entry's data.
+    uint64_t offset = sizeof(ARCHIVE_MAGIC) + sizeof(ARCHIVE_VERSION) + sizeof(uint64_t);
+    for (const auto &entry : entries_)
+        offset += 2 * sizeof(uint32_t) + entry.name.size() + entry.md5.size() + 2 * sizeof(uint64_t);
+
+    const auto write_string = [&](const std::string &value) {
+        const uint32_t size = value.size();
+        out.write(reinterpret_cast<const char *>(&size), sizeof(size));
+        out.write(value.data(), size);
+    };
+
+    const uint64_t count = entries_.size();
+    out.write(ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC));
+    out.write(reinterpret_cast<const char *>(&ARCHIVE_VERSION), sizeof(ARCHIVE_VERSION));
+    out.write(reinterpret_cast<const char *>(&count), sizeof(count));
+
+    for (const auto &entry : entries_)
+    {
+        const uint64_t size = entry.data.size();
+        write_string(entry.name);
+        write_string(entry.md5);
+        out.write(reinterpret_cast<const char *>(&offset), sizeof(offset));
+        out.write(reinterpret_cast<const char *>(&size), sizeof(size));
+        offset += size;
+    }
+
+    for (const auto &entry : entries_)
+        out.write(reinterpret_cast<const char *>(entry.data.data()), entry.data.size());
+
+    return static_cast<bool>(out);
+}
@@ -1,6 +1,6 @@
 /* Author: Zachary Kingston */
 
-#include <sensor_msgs/JointState.h>
+#include <algorithm>
 
 #include <robowflex_library/io/broadcaster.h>
 #include <robowflex_library/log.h>
@@ -9,19 +9,45 @@
 
 using namespace robowflex;
 
-namespace
-{
-    void arrayToVector(double *array, unsigned int n, std::vector<double> &dst)
-    {
-        dst = std::vector<double>(array, array + n);
-    }
-}  // namespace
-
 IO::RobotBroadcaster::RobotBroadcaster(const RobotConstPtr &robot, const std::string &base_frame,
                                        const std::string &name)
   : robot_(robot), base_(base_frame), nh_("/" + name)
 {
     state_pub_ = nh_.advertise<sensor_msgs::JointState>("/joint_states", 1);
+    static_pub_ = nh_.advertise<tf2_msgs::TFMessage>("/tf_static", 1, true);
+
+    const auto &state = robot_->getScratchStateConst();
+    const auto &model = robot_->getModelConst();
+
+    // Links attached by fixed joints never move, so they are only sent on /tf_static.
+    for (const auto &link : model->getLinkModels())
+    {
+        const auto &parent = link->getParentLinkModel();
+        const auto &joint = link->getParentJointModel();
+
+        std::string source = (parent) ? parent->getName() : base_;
+        const std::string &target = link->getName();
+
+        if (joint->getType() == moveit::core::JointModel::FIXED)
+        {
+            RobotPose tf = link->getJointOriginTransform() * state->getJointTransform(joint);
+            fixed_.emplace_back(TF::transformEigenToMsg(source, target, tf));
+        }
+        else
+        {
+            links_.emplace_back(link);
+            transforms_.emplace_back(TF::transformEigenToMsg(source, target, RobotPose::Identity()));
+        }
+    }
+
+    poses_.resize(links_.size(), RobotPose::Identity());
+    changed_.reserve(links_.size());
+
+    unsigned int n = state->getVariableCount();
+    joint_msg_.name = state->getVariableNames();
+    joint_msg_.position.resize(n);
+    joint_msg_.velocity.resize(n);
+    joint_msg_.effort.resize(n);
 }
 
 IO::RobotBroadcaster::~RobotBroadcaster()
@@ -60,6 +86,7 @@ void IO::RobotBroadcaster::stop()
 void IO::RobotBroadcaster::addStaticTransform(const std::string &name, const std::string &base,
                                               const std::string &target, const RobotPose &tf)
 {
+    std::lock_guard<std::mutex> lock(static_mutex_);
     if (static_.find(name) == static_.end())
     {
         StaticTransform stf;
@@ -68,6 +95,7 @@ void IO::RobotBroadcaster::addStaticTransform(const std::string &name, const std
         stf.tf = tf;
 
         static_.emplace(name, stf);
+        static_changed_ = true;
     }
     else
         RBX_ERROR("Static transform %s already in map!", name);
@@ -75,49 +103,92 @@ void IO::RobotBroadcaster::addStaticTransform(const std::string &name, const std
 
 void IO::RobotBroadcaster::removeStaticTransform(const std::string &name)
 {
+    std::lock_guard<std::mutex> lock(static_mutex_);
     auto it = static_.find(name);
     if (it != static_.end())
+    {
         static_.erase(it);
+        static_changed_ = true;
+    }
     else
         RBX_ERROR("Static transform %s does not exist in map!", name);
 }
 
+void IO::RobotBroadcaster::setRefreshPeriod(double period)
+{
+    refresh_ = period;
+}
+
 void IO::RobotBroadcaster::update()
 {
+    updateStatic();
+
     const auto &state = robot_->getScratchStateConst();
-    const auto &model = robot_->getModelConst();
+    const auto now = ros::Time::now();
 
-    for (const auto &link : model->getLinkModels())
-    {
-        const auto &parent = link->getParentLinkModel();
+    const auto wall = ros::WallTime::now();
+    const bool refresh = (wall - last_refresh_).toSec() >= refresh_;
+    if (refresh)
+        last_refresh_ = wall;
 
+    changed_.clear();
+    for (std::size_t i = 0; i < links_.size(); ++i)
+    {
+        const auto &link = links_[i];
         RobotPose tf =
             link->getJointOriginTransform() * state->getJointTransform(link->getParentJointModel());
 
-        std::string source = (parent) ? parent->getName() : base_;
-        const std::string &target = link->getName();
+        if (not refresh and tf.matrix() == poses_[i].matrix())
+            continue;
+
+        poses_[i] = tf;
 
-        auto msg = TF::transformEigenToMsg(source, target, tf);
+        auto &msg = transforms_[i];
+        msg.header.stamp = now;
+        msg.transform.translation = TF::vectorEigenToMsg(tf.translation());
+        msg.transform.rotation = TF::quaternionEigenToMsg(TF::getPoseRotation(tf));
 
-        tf2br_.sendTransform(msg);
+        if (not refresh)
+            changed_.emplace_back(msg);
     }
 
+    if (refresh)
+        tf2br_.sendTransform(transforms_);
+    else if (not changed_.empty())
+        tf2br_.sendTransform(changed_);
+
+    unsigned int n = state->getVariableCount();
+    joint_msg_.header.stamp = now;
+
+    const double *positions = state->getVariablePositions();
+    const double *velocities = state->getVariableVelocities();
+    const double *efforts = state->getVariableEffort();
+
+    std::copy(positions, positions + n, joint_msg_.position.begin());
+    std::copy(velocities, velocities + n, joint_msg_.velocity.begin());
+    std::copy(efforts, efforts + n, joint_msg_.effort.begin());
+
+    state_pub_.publish(joint_msg_);
+}
+
+void IO::RobotBroadcaster::updateStatic()
+{
+    std::lock_guard<std::mutex> lock(static_mutex_);
+    if (not static_changed_)
+        return;
+
+    // The latched message replaces the last one, so it always holds every static transform.
+    static_msg_.transforms = fixed_;
     for (const auto &pair : static_)
     {
         const auto &stf = pair.second;
-        auto static_msg = TF::transformEigenToMsg(stf.base, stf.target, stf.tf);
-        tf2br_.sendTransform(static_msg);
+        static_msg_.transforms.emplace_back(TF::transformEigenToMsg(stf.base, stf.target, stf.tf));
     }
 
-    unsigned int n = state->getVariableCount();
-
-    sensor_msgs::JointState msg;
-    msg.header.stamp = ros::Time::now();
-    msg.name = state->getVariableNames();
-
-    arrayToVector(state->getVariablePositions(), n, msg.position);
-    arrayToVector(state->getVariableVelocities(), n, msg.velocity);
-    arrayToVector(state->getVariableEffort(), n, msg.effort);
+    const auto now = ros::Time::now();
+    for (auto &msg : static_msg_.transforms)
+        msg.header.stamp = now;
 
-    state_pub_.publish(msg);
+    static_pub_.publish(static_msg_);
+    static_changed_ = false;
 }
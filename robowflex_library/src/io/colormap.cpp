@@ -314,6 +314,58 @@ namespace
         g = map[size - 1].g;
         b = map[size - 1].b;
     }
+
+    /** \brief A colormap sampled at uniform intervals, for fast lookup of many scalars at once.
+     */
+    class ColormapTable
+    {
+    public:
+        /** \brief Number of samples in the table. Fine enough that interpolating between samples is
+         * indistinguishable from the colormap itself.
+         */
+        static const unsigned int SIZE = 1024;
+
+        /** \brief Constructor. Samples a colormap.
+         *  \param[in] size Number of entries in the colormap.
+         *  \param[in] entries Entries of the colormap.
+         */
+        ColormapTable(unsigned int size, const Entry entries[]) : table_(SIZE, 4)
+        {
+            for (unsigned int i = 0; i < SIZE; ++i)
+            {
+                double r, g, b;
+                colormap(double(i) / (SIZE - 1), r, g, b, size, entries);
+                table_.row(i) << r, g, b, 1.;
+            }
+        }
+
+        /** \brief Maps scalars through the table.
+         *  \param[in] s Scalars to map.
+         *  \param[out] colors Output colors.
+         */
+        void map(const Eigen::Ref<const Eigen::ArrayXd> &s, Eigen::ArrayX4f &colors) const
+        {
+            const Eigen::ArrayXf position = s.cast<float>().max(0.f).min(1.f) * float(SIZE - 1);
+            const Eigen::ArrayXi lower = position.cast<int>().min(int(SIZE) - 2);
+            const Eigen::ArrayXf t = position - lower.cast<float>();
+
+            // Gather the samples around each scalar, then interpolate whole columns at once.
+            Eigen::ArrayX4f low(s.size(), 4);
+            Eigen::ArrayX4f high(s.size(), 4);
+            for (Eigen::Index i = 0; i < s.size(); ++i)
+            {
+                low.row(i) = table_.row(lower[i]);
+                high.row(i) = table_.row(lower[i] + 1);
+            }
+
+            colors.resize(s.size(), 4);
+            for (unsigned int c = 0; c < 4; ++c)
+                colors.col(c) = low.col(c) + t * (high.col(c) - low.col(c));
+        }
+
+    private:
+        Eigen::Array<float, Eigen::Dynamic, 4, Eigen::RowMajor> table_;  ///< Sampled colors.
+    };
 }  // namespace
 
 void robowflex::color::viridis(double s, Eigen::Ref<Eigen::Vector4d> color)
@@ -353,3 +405,44 @@ void robowflex::color::toGrayscale(Eigen::Ref<Eigen::Vector4d> color)
     double v = 0.3 * color[0] + 0.59 * color[1] + 0.11 * color[2];
     grayscale(v, color);
 }
+
+void robowflex::color::viridis(const Eigen::Ref<const Eigen::ArrayXd> &s, Eigen::ArrayX4f &colors)
+{
+    static const ColormapTable table(32, VIRIDIS);
+    table.map(s, colors);
+}
+
+void robowflex::color::coolwarm(const Eigen::Ref<const Eigen::ArrayXd> &s, Eigen::ArrayX4f &colors)
+{
+    static const ColormapTable table(32, COOLWARM);
+    table.map(s, colors);
+}
+
+void robowflex::color::extKindlmann(const Eigen::Ref<const Eigen::ArrayXd> &s, Eigen::ArrayX4f &colors)
+{
+    static const ColormapTable table(32, EXT_KINDLMANN);
+    table.map(s, colors);
+}
+
+void robowflex::color::plasma(const Eigen::Ref<const Eigen::ArrayXd> &s, Eigen::ArrayX4f &colors)
+{
+    static const ColormapTable table(32, PLASMA);
+    table.map(s, colors);
+}
+
+void robowflex::color::turbo(const Eigen::Ref<const Eigen::ArrayXd> &s, Eigen::ArrayX4f &colors)
+{
+    static const ColormapTable table(256, TURBO);
+    table.map(s, colors);
+}
+
+void robowflex::color::grayscale(const Eigen::Ref<const Eigen::ArrayXd> &s, Eigen::ArrayX4f &colors)
+{
+    colors.resize(s.size(), 4);
+
+    const Eigen::ArrayXf v = s.cast<float>().max(0.f).min(1.f);
+    for (unsigned int c = 0; c < 3; ++c)
+        colors.col(c) = v;
+
+    colors.col(3).setOnes();
+}
@@ -1,5 +1,8 @@
 /* Author: Zachary Kingston */
 
+#include <algorithm>
+#include <cmath>
+
 #include <robowflex_library/util.h>
 #include <robowflex_library/log.h>
 #include <robowflex_library/io.h>
@@ -11,6 +14,66 @@ using namespace robowflex::IO;
 namespace bp = boost::process;
 #endif
 
+namespace
+{
+    /** \brief Statistics of a box in a box plot.
+     */
+    struct BoxStatistics
+    {
+        double low;                     ///< Lowest value within the whisker range.
+        double q1;                      ///< First quartile.
+        double median;                  ///< Median.
+        double q3;                      ///< Third quartile.
+        double high;                    ///< Highest value within the whisker range.
+        std::vector<double> outliers;  ///< Values outside the whisker range.
+    };
+
+    /** \brief Get a quantile of sorted values, linearly interpolating between values.
+     *  \param[in] sorted Sorted values.
+     *  \param[in] q Quantile in [0, 1].
+     *  \return The quantile.
+     */
+    double getQuantile(const std::vector<double> &sorted, double q)
+    {
+        const double position = q * (sorted.size() - 1);
+        const std::size_t lower = std::floor(position);
+        const std::size_t upper = std::ceil(position);
+
+        return sorted[lower] + (position - lower) * (sorted[upper] - sorted[lower]);
+    }
+
+    /** \brief Compute the statistics of a box, with whiskers at 1.5 times the interquartile range as in
+     * GNUPlot.
+     *  \param[in] values Values of the box. Must not be empty.
+     *  \return The statistics.
+     */
+    BoxStatistics computeBoxStatistics(std::vector<double> values)
+    {
+        std::sort(values.begin(), values.end());
+
+        BoxStatistics box;
+        box.q1 = getQuantile(values, 0.25);
+        box.median = getQuantile(values, 0.5);
+        box.q3 = getQuantile(values, 0.75);
+
+        const double range = 1.5 * (box.q3 - box.q1);
+        box.low = box.q1;
+        box.high = box.q3;
+        for (const auto &value : values)
+        {
+            if (value < box.q1 - range or value > box.q3 + range)
+                box.outliers.emplace_back(value);
+            else
+            {
+                box.low = std::min(box.low, value);
+                box.high = std::max(box.high, value);
+            }
+        }
+
+        return box;
+    }
+}  // namespace
+
 GNUPlotHelper::Instance::Instance()
 {
 #if IS_BOOST_164
@@ -42,6 +105,15 @@ void GNUPlotHelper::Instance::writeline(const std::string &line)
     flush();
 }
 
+void GNUPlotHelper::Instance::writeBinary(const void *data, std::size_t size)
+{
+#if IS_BOOST_164
+    input_.write(reinterpret_cast<const char *>(data), size);
+    if (debug_)
+        std::cout << "<" << size << " bytes of binary data>" << std::endl;
+#endif
+}
+
 void GNUPlotHelper::Instance::flush()
 {
 #if IS_BOOST_164
@@ -90,8 +162,14 @@ void GNUPlotHelper::timeseries(const TimeSeriesOptions &options)
     auto it1 = options.points.begin();
     for (std::size_t i = 0; i < n; ++i, ++it1)
     {
-        in->write(log::format("'%1%' using 1:2 with lines lw 2 title \"%2%\"",  //
-                              (i == 0) ? "-" : "",                              //
+        // Binary inline data is read by size, so each series has its own record length.
+        const std::string binary =
+            (options.binary) ?
+                log::format(" binary record=%1% format=\"%%float64%%float64\"", it1->second.size()) :
+                "";
+
+        in->write(log::format("'-'%1% using 1:2 with lines lw 2 title \"%2%\"",  //
+                              binary,                                            //
                               it1->first));
         if (i != n - 1)
             in->write(", ");
@@ -102,6 +180,20 @@ void GNUPlotHelper::timeseries(const TimeSeriesOptions &options)
     auto it2 = options.points.begin();
     for (std::size_t i = 0; i < n; ++i, ++it2)
     {
+        if (options.binary)
+        {
+            std::vector<double> data;
+            data.reserve(2 * it2->second.size());
+            for (const auto &point : it2->second)
+            {
+                data.emplace_back(point.first);
+                data.emplace_back(point.second);
+            }
+
+            in->writeBinary(data.data(), data.size() * sizeof(double));
+            continue;
+        }
+
         for (const auto &point : it2->second)
             in->writeline(log::format("%1%,%2%", point.first, point.second));
 
@@ -111,6 +203,12 @@ void GNUPlotHelper::timeseries(const TimeSeriesOptions &options)
 
 void GNUPlotHelper::boxplot(const BoxPlotOptions &options)
 {
+    if (options.aggregate)
+    {
+        boxplotAggregate(options);
+        return;
+    }
+
     configurePlot(options);
     auto in = getInstance(options.instance);
 
@@ -162,6 +260,69 @@ void GNUPlotHelper::boxplot(const BoxPlotOptions &options)
     }
 }
 
+void GNUPlotHelper::boxplotAggregate(const BoxPlotOptions &options)
+{
+    configurePlot(options);
+    auto in = getInstance(options.instance);
+
+    in->writeline("set datafile separator \",\"");
+
+    in->writeline("set style fill solid 0.5 border -1");
+    in->writeline("set boxwidth 0.5");
+    in->writeline("unset key");
+
+    auto n = options.values.size();
+
+    in->write("set xtics (");
+    auto it1 = options.values.begin();
+    for (std::size_t i = 0; i < n; ++i, ++it1)
+    {
+        in->write(log::format("\"%1%\" %2%", it1->first, i + 1));
+        if (i != n - 1)
+            in->write(", ");
+    }
+    in->writeline(") scale 0.0");
+    in->writeline(log::format("set xrange [0.5:%1%]", n + 0.5));
+
+    // Empty boxes are marked with a NaN median and skipped.
+    std::vector<BoxStatistics> boxes(n);
+    auto it2 = options.values.begin();
+    for (std::size_t i = 0; i < n; ++i, ++it2)
+        if (not it2->second.empty())
+            boxes[i] = computeBoxStatistics(it2->second);
+        else
+            boxes[i].median = constants::nan;
+
+    // Boxes and whiskers, then a line at each median, then outliers.
+    in->write("plot '-' using 1:3:2:6:5 with candlesticks whiskerbars lt 1, ");
+    in->write("'-' using 1:2:2:2:2 with candlesticks lt -1");
+    if (options.outliers)
+        in->write(", '-' using 1:2 with points pointtype 7 lt 1");
+    in->flush();
+
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        const auto &box = boxes[i];
+        if (std::isfinite(box.median))
+            in->writeline(log::format("%1%,%2%,%3%,%4%,%5%,%6%",  //
+                                      i + 1, box.low, box.q1, box.median, box.q3, box.high));
+    }
+    in->writeline("e");
+
+    for (std::size_t i = 0; i < n; ++i)
+        if (std::isfinite(boxes[i].median))
+            in->writeline(log::format("%1%,%2%", i + 1, boxes[i].median));
+    in->writeline("e");
+
+    if (options.outliers)
+    {
+        for (std::size_t i = 0; i < n; ++i)
+            for (const auto &value : boxes[i].outliers)
+                in->writeline(log::format("%1%,%2%", i + 1, value));
+        in->writeline("e");
+    }
+}
+
 std::shared_ptr<GNUPlotHelper::Instance> GNUPlotHelper::getInstance(const std::string &name)
 {
     if (instances_.find(name) == instances_.end())
@@ -197,7 +358,10 @@ void GNUPlotPlanDataSetOutputter::dump(const PlanDataSet &results)
             if (metric_ == "time")
                 values.emplace_back(run->time);
             else
-                values.emplace_back(boost::get<double>(run->metrics[metric_]));
+            {
+                const auto *metric = run->getMetric(metric_);
+                values.emplace_back((metric) ? boost::get<double>(*metric) : 0.);
+            }
         }
 
         bpo.values.emplace(name, values);
@@ -1,8 +1,13 @@
 /* Author: Zachary Kingston */
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
+#include <mutex>
 #include <numeric>
 
+#include <boost/filesystem.hpp>
+
 #include <robowflex_library/io.h>
 #include <robowflex_library/io/hdf5.h>
 #include <robowflex_library/macros.h>
@@ -10,12 +15,65 @@
 
 using namespace robowflex;
 
+namespace
+{
+    // The HDF5 library is not thread-safe unless built to be, and data is now read lazily from any thread.
+    std::mutex HDF5_MUTEX;
+
+    hsize_t getSize(const hsize_t *dims, int rank)
+    {
+        return std::accumulate(dims, dims + rank, hsize_t(1), std::multiplies<hsize_t>());
+    }
+
+    template <typename T>
+    H5T_class_t typeClass();
+
+    template <>
+    H5T_class_t typeClass<int>()
+    {
+        return H5T_INTEGER;
+    }
+
+    template <>
+    H5T_class_t typeClass<double>()
+    {
+        return H5T_FLOAT;
+    }
+
+    template <typename T>
+    const H5::PredType &nativeType();
+
+    template <>
+    const H5::PredType &nativeType<uint8_t>()
+    {
+        return H5::PredType::NATIVE_UINT8;
+    }
+
+    template <>
+    const H5::PredType &nativeType<int>()
+    {
+        return H5::PredType::NATIVE_INT;
+    }
+
+    template <>
+    const H5::PredType &nativeType<uint64_t>()
+    {
+        return H5::PredType::NATIVE_UINT64;
+    }
+
+    template <>
+    const H5::PredType &nativeType<double>()
+    {
+        return H5::PredType::NATIVE_DOUBLE;
+    }
+}  // namespace
+
 ///
 /// IO::HDF5Data
 ///
 
 template <typename T>
-IO::HDF5Data::HDF5Data(const T &location, const std::string &name)
+IO::HDF5Data::HDF5Data(const T &location, const std::string &name, const MappedFileConstPtr &mapping)
   : dataset_(location.openDataSet(name))
   , space_(dataset_.getSpace())
   , type_(dataset_.getTypeClass())
@@ -25,32 +83,122 @@ IO::HDF5Data::HDF5Data(const T &location, const std::string &name)
       space_.getSimpleExtentDims(dims);
       return dims;
   }())
-  , data_([&] {
-      const auto &properties = getDataProperties();
-      void *data = std::malloc(std::get<1>(properties) *  //
-                               std::accumulate(dims_, dims_ + rank_, 1, std::multiplies<hsize_t>()));
-
-      dataset_.read(data, std::get<0>(properties), space_, space_);
-      return data;
-  }())
+  , mapping_(mapping)
 {
+    // Mapped data needs no reading, so mark it as loaded. Otherwise, the mapping is not needed.
+    if (mapping_ and map())
+        std::call_once(once_, [] {});
+    else
+        mapping_.reset();
 }
 
-template IO::HDF5Data::HDF5Data(const H5::H5File &, const std::string &);
-template IO::HDF5Data::HDF5Data(const H5::Group &, const std::string &);
+template IO::HDF5Data::HDF5Data(const H5::H5File &, const std::string &, const MappedFileConstPtr &);
+template IO::HDF5Data::HDF5Data(const H5::Group &, const std::string &, const MappedFileConstPtr &);
 
 IO::HDF5Data::~HDF5Data()
 {
-    delete dims_;
+    delete[] dims_;
+
+    if (not owned_)
+        return;
 
     // clang-format off
     ROBOWFLEX_PUSH_DISABLE_GCC_WARNING(-Wcast-qual)
     // clang-format on
 
-    std::free((void *)data_);
+    std::free((void *)data_.load());
     ROBOWFLEX_POP_GCC
 }
 
+bool IO::HDF5Data::map()
+{
+    const auto &properties = getDataProperties();
+    if (std::get<1>(properties) == 0 or not mapping_->isOpen())
+        return false;
+
+    // Only contiguous data stored exactly as the native type can be used in place. Contiguous data is
+    // never filtered (e.g., compressed), and unallocated data has no offset.
+    if (dataset_.getCreatePlist().getLayout() != H5D_CONTIGUOUS)
+        return false;
+
+    if (not(dataset_.getDataType() == std::get<0>(properties)))
+        return false;
+
+    const haddr_t offset = dataset_.getOffset();
+    const hsize_t size = std::get<1>(properties) * getSize(dims_, rank_);
+
+    if (offset == HADDR_UNDEF or offset + size > mapping_->size())
+        return false;
+
+    data_ = mapping_->data() + offset;
+    return true;
+}
+
+void IO::HDF5Data::load() const
+{
+    std::call_once(once_, [&] {
+        const auto &properties = getDataProperties();
+        void *data = std::malloc(std::get<1>(properties) * getSize(dims_, rank_));
+
+        std::unique_lock<std::mutex> lock(HDF5_MUTEX);
+        dataset_.read(data, std::get<0>(properties), space_, space_);
+
+        // Published last, so a reader that sees the data also sees that it is owned.
+        owned_ = true;
+        data_ = data;
+    });
+}
+
+bool IO::HDF5Data::isLoaded() const
+{
+    return data_.load() != nullptr;
+}
+
+bool IO::HDF5Data::isMapped() const
+{
+    return isLoaded() and not owned_;
+}
+
+template <typename T>
+std::vector<T> IO::HDF5Data::read(hsize_t begin, hsize_t count) const
+{
+    if (type_ != typeClass<T>())
+        throw Exception(1, "Requested type does not match data type!");
+
+    if (rank_ == 0 or begin >= dims_[0])
+        return {};
+
+    count = std::min(count, dims_[0] - begin);
+
+    const hsize_t row = getSize(dims_ + 1, rank_ - 1);
+    std::vector<T> result(count * row);
+
+    if (const void *loaded = data_.load())
+    {
+        const T *data = reinterpret_cast<const T *>(loaded);
+        std::copy(data + begin * row, data + (begin + count) * row, result.begin());
+        return result;
+    }
+
+    // Select rows [begin, begin + count) of the file, and read them into a matching memory space.
+    std::vector<hsize_t> offset(rank_, 0);
+    std::vector<hsize_t> extent(dims_, dims_ + rank_);
+    offset[0] = begin;
+    extent[0] = count;
+
+    std::unique_lock<std::mutex> lock(HDF5_MUTEX);
+    H5::DataSpace file = dataset_.getSpace();
+    file.selectHyperslab(H5S_SELECT_SET, extent.data(), offset.data());
+
+    H5::DataSpace memory(rank_, extent.data());
+    dataset_.read(result.data(), std::get<0>(getDataProperties()), memory, file);
+
+    return result;
+}
+
+template std::vector<int> IO::HDF5Data::read(hsize_t begin, hsize_t count) const;
+template std::vector<double> IO::HDF5Data::read(hsize_t begin, hsize_t count) const;
+
 const std::vector<hsize_t> IO::HDF5Data::getDims() const
 {
     return std::vector<hsize_t>(dims_, dims_ + rank_);
@@ -58,7 +206,8 @@ const std::vector<hsize_t> IO::HDF5Data::getDims() const
 
 const void *IO::HDF5Data::getData() const
 {
-    return data_;
+    load();
+    return data_.load();
 }
 
 const std::string IO::HDF5Data::getStatus() const
@@ -101,7 +250,9 @@ const T &IO::HDF5Data::get(const std::vector<hsize_t> &index) const
     if (index.size() != (unsigned int)rank_)
         throw Exception(1, "Index size must be the same as data rank!");
 
-    const T *data = reinterpret_cast<const T *>(data_);
+    load();
+
+    const T *data = reinterpret_cast<const T *>(data_.load());
     unsigned int offset = 0;
 
     for (int i = 0; i < rank_; ++i)
@@ -140,8 +291,10 @@ std::tuple<H5::PredType, unsigned int, std::string> IO::HDF5Data::getDataPropert
 /// IO::HDF5File
 ///
 
-IO::HDF5File::HDF5File(const std::string &filename)
-  : file_(IO::resolvePath(filename), H5F_ACC_RDONLY), data_(NodeMap())
+IO::HDF5File::HDF5File(const std::string &filename, bool mapped)
+  : file_(IO::resolvePath(filename), H5F_ACC_RDONLY)
+  , mapping_((mapped) ? IO::mapFile(IO::resolvePath(filename)) : nullptr)
+  , data_(NodeMap())
 {
     for (const auto &obj : listObjects(file_))
         loadData(data_, file_, obj);
@@ -272,7 +425,7 @@ void IO::HDF5File::loadData(Node &node, const T &location, const std::string &na
         }
         case H5O_TYPE_DATASET:
         {
-            map[name] = std::make_shared<HDF5Data>(location, name);
+            map[name] = std::make_shared<HDF5Data>(location, name, mapping_);
             break;
         }
 
@@ -285,3 +438,133 @@ void IO::HDF5File::loadData(Node &node, const T &location, const std::string &na
 
 template void IO::HDF5File::loadData(Node &, const H5::H5File &, const std::string &);
 template void IO::HDF5File::loadData(Node &, const H5::Group &, const std::string &);
+
+///
+/// IO::HDF5Writer
+///
+
+IO::HDF5Writer::HDF5Writer(const std::string &filename, bool append)
+  : HDF5Writer(filename, append, Options())
+{
+}
+
+IO::HDF5Writer::HDF5Writer(const std::string &filename, bool append, const Options &options)
+  : options_(options), file_([&] {
+      const boost::filesystem::path path(IO::resolvePackage(filename));
+      const bool exists = boost::filesystem::exists(path);
+
+      if (not exists and path.has_parent_path())
+          boost::filesystem::create_directories(path.parent_path());
+
+      return H5::H5File(path.string(), (append and exists) ? H5F_ACC_RDWR : H5F_ACC_TRUNC);
+  }())
+{
+}
+
+bool IO::HDF5Writer::exists(const std::vector<std::string> &keys) const
+{
+    // Each parent needs to be checked, as H5Lexists fails on missing intermediate groups.
+    std::string path;
+    for (const auto &key : keys)
+    {
+        path += "/" + key;
+        if (H5Lexists(file_.getId(), path.c_str(), H5P_DEFAULT) <= 0)
+            return false;
+    }
+
+    return true;
+}
+
+H5::Group IO::HDF5Writer::getGroup(const std::vector<std::string> &keys)
+{
+    H5::Group group = file_.openGroup("/");
+    for (const auto &key : keys)
+    {
+        if (H5Lexists(group.getId(), key.c_str(), H5P_DEFAULT) > 0)
+            group = group.openGroup(key);
+        else
+            group = group.createGroup(key);
+    }
+
+    return group;
+}
+
+template <typename T>
+H5::DataSet IO::HDF5Writer::write(const std::vector<std::string> &keys, const T *data,
+                                  const std::vector<hsize_t> &dims)
+{
+    if (keys.empty())
+        throw Exception(1, "Cannot write a DataSet without a name!");
+
+    auto group = getGroup(std::vector<std::string>(keys.begin(), keys.end() - 1));
+
+    const hsize_t size = getSize(dims.data(), dims.size());
+    const H5::DataSpace space =
+        (dims.empty()) ? H5::DataSpace(H5S_SCALAR) : H5::DataSpace(dims.size(), dims.data());
+
+    // Chunks cannot be empty, so empty DataSets are left contiguous.
+    H5::DSetCreatPropList properties;
+    if (options_.compression > 0 and size > 0 and not dims.empty())
+    {
+        auto chunk = dims;
+        chunk[0] = std::min(chunk[0], std::max<hsize_t>(options_.chunk, 1));
+
+        properties.setChunk(chunk.size(), chunk.data());
+        properties.setShuffle();
+        properties.setDeflate(std::min(options_.compression, 9u));
+    }
+
+    auto dataset = group.createDataSet(keys.back(), nativeType<T>(), space, properties);
+    if (size > 0)
+        dataset.write(data, nativeType<T>());
+
+    return dataset;
+}
+
+template H5::DataSet IO::HDF5Writer::write(const std::vector<std::string> &, const uint8_t *,
+                                           const std::vector<hsize_t> &);
+template H5::DataSet IO::HDF5Writer::write(const std::vector<std::string> &, const int *,
+                                           const std::vector<hsize_t> &);
+template H5::DataSet IO::HDF5Writer::write(const std::vector<std::string> &, const uint64_t *,
+                                           const std::vector<hsize_t> &);
+template H5::DataSet IO::HDF5Writer::write(const std::vector<std::string> &, const double *,
+                                           const std::vector<hsize_t> &);
+
+H5::DataSet IO::HDF5Writer::write(const std::vector<std::string> &keys, const Eigen::MatrixXd &matrix)
+{
+    // Eigen defaults to column-major order, while HDF5 is row-major.
+    const Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> rows = matrix;
+    return write(keys, rows.data(), {(hsize_t)rows.rows(), (hsize_t)rows.cols()});
+}
+
+template <typename T>
+void IO::HDF5Writer::writeAttribute(H5::H5Object &object, const std::string &name, const T &value)
+{
+    auto attribute = object.createAttribute(name, nativeType<T>(), H5::DataSpace(H5S_SCALAR));
+    attribute.write(nativeType<T>(), &value);
+}
+
+template void IO::HDF5Writer::writeAttribute(H5::H5Object &, const std::string &, const uint8_t &);
+template void IO::HDF5Writer::writeAttribute(H5::H5Object &, const std::string &, const int &);
+template void IO::HDF5Writer::writeAttribute(H5::H5Object &, const std::string &, const uint64_t &);
+template void IO::HDF5Writer::writeAttribute(H5::H5Object &, const std::string &, const double &);
+
+void IO::HDF5Writer::writeAttribute(H5::H5Object &object, const std::string &name,
+                                    const std::vector<std::string> &values)
+{
+    std::vector<const char *> strings;
+    for (const auto &value : values)
+        strings.emplace_back(value.c_str());
+
+    hsize_t dims[1] = {values.size()};
+    H5::StrType type(H5::PredType::C_S1, H5T_VARIABLE);
+
+    auto attribute = object.createAttribute(name, type, H5::DataSpace(1, dims));
+    if (not values.empty())
+        attribute.write(type, strings.data());
+}
+
+void IO::HDF5Writer::flush()
+{
+    file_.flush(H5F_SCOPE_GLOBAL);
+}
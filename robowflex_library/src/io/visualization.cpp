@@ -5,6 +5,7 @@
 #include <moveit_msgs/DisplayRobotState.h>
 #include <moveit_msgs/DisplayTrajectory.h>
 #include <moveit_msgs/PlanningScene.h>
+#include <sensor_msgs/point_cloud2_iterator.h>
 #include <visualization_msgs/Marker.h>
 #include <visualization_msgs/MarkerArray.h>
 
@@ -47,11 +48,65 @@ IO::RVIZHelper::RVIZHelper(const RobotConstPtr &robot, const std::string &name)
     nh_.setParam(Robot::ROBOT_DESCRIPTION, description);
     nh_.setParam(Robot::ROBOT_DESCRIPTION + Robot::ROBOT_SEMANTIC, semantic);
 
-    trajectory_pub_ = nh_.advertise<moveit_msgs::DisplayTrajectory>("trajectory", 1);
-    state_pub_ = nh_.advertise<moveit_msgs::DisplayRobotState>("state", 1);
-    scene_pub_ = nh_.advertise<moveit_msgs::PlanningScene>("scene", 1);
-    pcd_pub_ = nh_.advertise<sensor_msgs::PointCloud2>("pcd", 1);
-    marker_pub_ = nh_.advertise<visualization_msgs::MarkerArray>("/visualization_marker_array", 100);
+    advertise();
+}
+
+void IO::RVIZHelper::setPublishMode(PublishMode mode)
+{
+    mode_ = mode;
+    advertise();
+}
+
+IO::RVIZHelper::PublishMode IO::RVIZHelper::getPublishMode() const
+{
+    return mode_;
+}
+
+void IO::RVIZHelper::setSceneDiffs(bool diffs)
+{
+    diffs_ = diffs;
+}
+
+void IO::RVIZHelper::advertise()
+{
+    const bool latch = mode_ == LATCH;
+
+    trajectory_pub_ = nh_.advertise<moveit_msgs::DisplayTrajectory>("trajectory", 1, latch);
+    state_pub_ = nh_.advertise<moveit_msgs::DisplayRobotState>("state", 1, latch);
+    pcd_pub_ = nh_.advertise<sensor_msgs::PointCloud2>("pcd", 1, latch);
+
+    // New subscribers have not seen earlier markers or scenes, so the next update of each is sent in full.
+    markers_full_ = true;
+    marker_pub_ = nh_.advertise<visualization_msgs::MarkerArray>(
+        "/visualization_marker_array", 100,
+        [this](const ros::SingleSubscriberPublisher &) { markers_full_ = true; },
+        ros::SubscriberStatusCallback(), ros::VoidConstPtr(), latch);
+    scene_full_ = true;
+    scene_pub_ = nh_.advertise<moveit_msgs::PlanningScene>(
+        "scene", 1, [this](const ros::SingleSubscriberPublisher &) { scene_full_ = true; },
+        ros::SubscriberStatusCallback(), ros::VoidConstPtr(), latch);
+}
+
+bool IO::RVIZHelper::isReady(const ros::Publisher &pub, const std::string &name) const
+{
+    switch (mode_)
+    {
+        case BLOCK:
+            if (pub.getNumSubscribers() < 1)
+            {
+                RBX_INFO("Waiting for %s subscribers...", name);
+
+                ros::WallDuration pause(0.1);
+                while (pub.getNumSubscribers() < 1)
+                    pause.sleep();
+            }
+            return true;
+        case DROP:
+            return pub.getNumSubscribers() > 0;
+        case LATCH:
+        default:
+            return true;
+    }
 }
 
 void IO::RVIZHelper::updateTrajectory(const planning_interface::MotionPlanResponse &response)
@@ -81,14 +136,8 @@ void IO::RVIZHelper::updateTrajectory(const moveit_msgs::RobotTrajectory &traj,
     out.trajectory.push_back(traj);
     moveit::core::robotStateToRobotStateMsg(start, out.trajectory_start);
 
-    if (trajectory_pub_.getNumSubscribers() < 1)
-    {
-        RBX_INFO("Waiting for Trajectory subscribers...");
-
-        ros::WallDuration pause(0.1);
-        while (trajectory_pub_.getNumSubscribers() < 1)
-            pause.sleep();
-    }
+    if (not isReady(trajectory_pub_, "Trajectory"))
+        return;
 
     trajectory_pub_.publish(out);
 }
@@ -112,14 +161,8 @@ void IO::RVIZHelper::updateTrajectories(const std::vector<robot_trajectory::Robo
         out.trajectory.push_back(msg);
     }
 
-    if (trajectory_pub_.getNumSubscribers() < 1)
-    {
-        RBX_INFO("Waiting for Trajectory subscribers...");
-
-        ros::WallDuration pause(0.1);
-        while (trajectory_pub_.getNumSubscribers() < 1)
-            pause.sleep();
-    }
+    if (not isReady(trajectory_pub_, "Trajectory"))
+        return;
 
     trajectory_pub_.publish(out);
 }
@@ -147,14 +190,8 @@ void IO::RVIZHelper::updateTrajectories(const std::vector<TrajectoryPtr> &trajec
 
 void IO::RVIZHelper::visualizeState(const robot_state::RobotStatePtr &state)
 {
-    if (state_pub_.getNumSubscribers() < 1)
-    {
-        RBX_INFO("Waiting for State subscribers...");
-
-        ros::WallDuration pause(0.1);
-        while (state_pub_.getNumSubscribers() < 1)
-            pause.sleep();
-    }
+    if (not isReady(state_pub_, "State"))
+        return;
 
     moveit_msgs::DisplayRobotState out;
     moveit::core::robotStateToRobotStateMsg(*state, out.state);
@@ -226,6 +263,47 @@ void IO::RVIZHelper::addTextMarker(const std::string &name, const std::string &t
     addMarker(marker, name);
 }
 
+void IO::RVIZHelper::addPointsMarker(const std::string &name,
+                                     const Eigen::Ref<const Eigen::Matrix3Xd> &points,
+                                     const Eigen::Ref<const Eigen::ArrayX4f> &colors, double scale,
+                                     bool spheres, const std::string &base_frame)
+{
+    if (points.cols() != colors.rows())
+        throw Exception(1, "Mismatch between points and colors sizes!");
+
+    // Update an existing marker of the same name in place, rather than adding another.
+    auto it = markers_.find(name);
+    if (it == markers_.end() or it->second.marker.action == visualization_msgs::Marker::DELETE)
+    {
+        visualization_msgs::Marker marker;
+        fillMarker(marker, base_frame, RobotPose::Identity(), color::WHITE, Eigen::Vector3d::Constant(scale));
+        it = markers_.emplace(name, ManagedMarker{marker, true});
+    }
+
+    auto &marker = it->second.marker;
+    marker.type = (spheres) ? visualization_msgs::Marker::SPHERE_LIST : visualization_msgs::Marker::POINTS;
+    marker.header.frame_id = base_frame;
+    marker.scale = TF::vectorEigenToMsg(Eigen::Vector3d::Constant(scale));
+    it->second.changed = true;
+
+    const std::size_t n = points.cols();
+    marker.points.resize(n);
+    marker.colors.resize(n);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        auto &point = marker.points[i];
+        point.x = points(0, i);
+        point.y = points(1, i);
+        point.z = points(2, i);
+
+        auto &mcolor = marker.colors[i];
+        mcolor.r = colors(i, 0);
+        mcolor.g = colors(i, 1);
+        mcolor.b = colors(i, 2);
+        mcolor.a = colors(i, 3);
+    }
+}
+
 void IO::RVIZHelper::addLineMarker(const std::string &name, const std::vector<Eigen::Vector3d> &points,
                                    const std::vector<Eigen::Vector4d> &colors, double scale)
 {
@@ -426,7 +504,10 @@ void IO::RVIZHelper::addGoalMarker(const std::string &name, const MotionRequestB
 void IO::RVIZHelper::removeAllMarkers()
 {
     for (auto &marker : markers_)
-        marker.second.action = visualization_msgs::Marker::DELETE;
+    {
+        marker.second.marker.action = visualization_msgs::Marker::DELETE;
+        marker.second.changed = true;
+    }
 }
 
 void IO::RVIZHelper::removeMarker(const std::string &name)
@@ -434,12 +515,15 @@ void IO::RVIZHelper::removeMarker(const std::string &name)
     auto markers = markers_.equal_range(name);
 
     for (auto it = markers.first; it != markers.second; ++it)
-        it->second.action = visualization_msgs::Marker::DELETE;
+    {
+        it->second.marker.action = visualization_msgs::Marker::DELETE;
+        it->second.changed = true;
+    }
 }
 
 void IO::RVIZHelper::addMarker(const visualization_msgs::Marker &marker, const std::string &name)
 {
-    markers_.emplace(name, marker);
+    markers_.emplace(name, ManagedMarker{marker, true});
 }
 
 void IO::RVIZHelper::addMarker(double x, double y, double z, const std::string &name)
@@ -471,34 +555,74 @@ void IO::RVIZHelper::removeScene()
 
 void IO::RVIZHelper::updateScene(const SceneConstPtr &scene)
 {
-    if (scene_pub_.getNumSubscribers() < 1)
-    {
-        RBX_INFO("Waiting for Scene subscribers...");
-
-        ros::WallDuration pause(0.1);
-        while (scene_pub_.getNumSubscribers() < 1)
-            pause.sleep();
-    }
+    if (not isReady(scene_pub_, "Scene"))
+        return;
 
     moveit_msgs::PlanningScene to_pub;
     if (scene != nullptr)
     {
-        to_pub = scene->getMessage();
-        to_pub.is_diff = true;
+        // Only send what changed if subscribers already have an earlier version of this scene.
+        const auto key = scene->getKey();
+        const bool full = scene_full_.exchange(false);
+        const bool same = key.first == scene_key_.first and key.second >= scene_key_.second;
+        const bool diff = diffs_ and not full and same and scene->getDiffMessage(scene_key_.second, to_pub);
+
+        if (not diff)
+        {
+            to_pub = scene->getMessage();
+            to_pub.is_diff = true;
+        }
+
+        scene_key_ = key;
     }
+    else
+        scene_key_ = ID::getNullKey();
 
     scene_pub_.publish(to_pub);
 }
 
 void IO::RVIZHelper::updatePCD(const sensor_msgs::PointCloud2 &msg)
 {
-    if (pcd_pub_.getNumSubscribers() < 1)
+    if (not isReady(pcd_pub_, "pcd"))
+        return;
+
+    pcd_pub_.publish(msg);
+}
+
+void IO::RVIZHelper::updatePCD(const Eigen::Ref<const Eigen::Matrix3Xd> &points,
+                               const Eigen::Ref<const Eigen::ArrayX4f> &colors, const std::string &frame)
+{
+    if (points.cols() != colors.rows())
     {
-        RBX_INFO("Waiting for pcd subscribers...");
+        RBX_ERROR("Got %d points but %d colors for pointcloud!", points.cols(), colors.rows());
+        return;
+    }
+
+    if (not isReady(pcd_pub_, "pcd"))
+        return;
+
+    sensor_msgs::PointCloud2 msg;
+    msg.header.stamp = ros::Time::now();
+    msg.header.frame_id = (frame.empty()) ? robot_->getModelConst()->getModelFrame() : frame;
+
+    sensor_msgs::PointCloud2Modifier modifier(msg);
+    modifier.setPointCloud2FieldsByString(2, "xyz", "rgb");
+    modifier.resize(points.cols());
 
-        ros::WallDuration pause(0.1);
-        while (pcd_pub_.getNumSubscribers() < 1)
-            pause.sleep();
+    // Colors are packed as bytes, so scale them once for all points.
+    const Eigen::Array<uint8_t, Eigen::Dynamic, 4> bytes =
+        (colors.max(0.f).min(1.f) * 255.f + 0.5f).cast<uint8_t>();
+
+    sensor_msgs::PointCloud2Iterator<float> x(msg, "x"), y(msg, "y"), z(msg, "z");
+    sensor_msgs::PointCloud2Iterator<uint8_t> r(msg, "r"), g(msg, "g"), b(msg, "b");
+    for (Eigen::Index i = 0; i < points.cols(); ++i, ++x, ++y, ++z, ++r, ++g, ++b)
+    {
+        *x = points(0, i);
+        *y = points(1, i);
+        *z = points(2, i);
+        *r = bytes(i, 0);
+        *g = bytes(i, 1);
+        *b = bytes(i, 2);
     }
 
     pcd_pub_.publish(msg);
@@ -506,31 +630,31 @@ void IO::RVIZHelper::updatePCD(const sensor_msgs::PointCloud2 &msg)
 
 void IO::RVIZHelper::updateMarkers()
 {
-    visualization_msgs::MarkerArray msg;
-
-    std::vector<std::string> remove;
-    for (auto &marker : markers_)
-    {
-        msg.markers.emplace_back(marker.second);
+    // Markers are left as they are until they are actually published.
+    if (not isReady(marker_pub_, "MarkerArray"))
+        return;
 
-        if (marker.second.action == visualization_msgs::Marker::ADD)
-            marker.second.action = visualization_msgs::Marker::MODIFY;
+    const bool full = markers_full_.exchange(false);
 
-        else if (marker.second.action == visualization_msgs::Marker::DELETE)
-            remove.push_back(marker.first);
-    }
+    // The message is reused, so its storage is only grown and never reallocated per update.
+    marker_msg_.markers.clear();
 
-    if (marker_pub_.getNumSubscribers() < 1)
+    for (auto it = markers_.begin(); it != markers_.end();)
     {
-        RBX_INFO("Waiting for MarkerArray subscribers...");
-
-        ros::WallDuration pause(0.1);
-        while (marker_pub_.getNumSubscribers() < 1)
-            pause.sleep();
+        auto &managed = it->second;
+        if (full or managed.changed)
+            marker_msg_.markers.emplace_back(managed.marker);
+
+        managed.changed = false;
+        if (managed.marker.action == visualization_msgs::Marker::ADD)
+            managed.marker.action = visualization_msgs::Marker::MODIFY;
+
+        if (managed.marker.action == visualization_msgs::Marker::DELETE)
+            it = markers_.erase(it);
+        else
+            ++it;
     }
 
-    marker_pub_.publish(msg);
-
-    for (auto &marker : remove)
-        markers_.erase(markers_.find(marker));
+    if (not marker_msg_.markers.empty())
+        marker_pub_.publish(marker_msg_);
 }
@@ -0,0 +1,1253 @@
+/* Author: Zachary Kingston */
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <sstream>
+
+#include <boost/filesystem.hpp>
+
+#include <ros/package.h>
+
+#include <tinyxml2.h>
+
+#include <robowflex_library/io.h>
+#include <robowflex_library/io/xacro.h>
+#include <robowflex_library/log.h>
+#include <robowflex_library/util.h>
+
+using namespace robowflex;
+
+namespace
+{
+    /** \brief Thrown for xacro features the native expansion does not support.
+     */
+    class Unsupported : public Exception
+    {
+    public:
+        Unsupported(const std::string &message) : Exception(1, message)
+        {
+        }
+    };
+
+    /** \brief Maximum depth of nested property evaluation, to catch recursive definitions.
+     */
+    const std::size_t MAX_DEPTH = 100;
+
+    /** \brief Remove leading and trailing whitespace, as Python's strip().
+     */
+    std::string strip(const std::string &text)
+    {
+        const auto begin = text.find_first_not_of(" \t\n\r\f\v");
+        if (begin == std::string::npos)
+            return "";
+
+        return text.substr(begin, text.find_last_not_of(" \t\n\r\f\v") - begin + 1);
+    }
+
+    /** \brief Split the parameters of a macro at whitespace, except within quotes, as xacro does for
+     *  defaults such as `xyz:='0 0 0'`. Quotes are kept, so defaults are still read as literals.
+     */
+    std::vector<std::string> splitParameters(const std::string &params)
+    {
+        std::vector<std::string> tokens;
+        std::string token;
+        char quote = 0;
+        for (const char c : params)
+        {
+            if (quote)
+            {
+                token += c;
+                if (c == quote)
+                    quote = 0;
+            }
+            else if (std::isspace(c))
+            {
+                if (not token.empty())
+                    tokens.emplace_back(token);
+                token.clear();
+            }
+            else
+            {
+                token += c;
+                if (c == '\'' or c == '"')
+                    quote = c;
+            }
+        }
+
+        if (quote)
+            throw Unsupported("Unterminated quote in parameters `" + params + "`");
+
+        if (not token.empty())
+            tokens.emplace_back(token);
+
+        return tokens;
+    }
+
+    /** \brief The value of a xacro expression.
+     */
+    struct Value
+    {
+        bool number{false};   ///< Whether the value is a number (or boolean).
+        bool integer{false};  ///< Whether a number is an integer.
+        bool boolean{false};  ///< Whether a number is a boolean.
+        double x{0.};         ///< Numeric value.
+        std::string s;        ///< String value.
+
+        static Value fromNumber(double x, bool integer = false)
+        {
+            Value v;
+            v.number = true;
+            v.integer = integer;
+            v.x = x;
+            return v;
+        }
+
+        static Value fromBool(bool b)
+        {
+            Value v = fromNumber(b, true);
+            v.boolean = true;
+            return v;
+        }
+
+        static Value fromString(const std::string &s)
+        {
+            Value v;
+            v.s = s;
+            return v;
+        }
+
+        /** \brief Parse text as Python's int() does, without underscores.
+         *  \param[in] text Text to parse.
+         *  \param[out] x Parsed value.
+         *  \return True if \a text is an integer.
+         */
+        static bool parseInteger(const std::string &text, double &x)
+        {
+            const auto &t = strip(text);
+            const std::size_t i = (not t.empty() and (t[0] == '+' or t[0] == '-')) ? 1 : 0;
+            if (i == t.size() or t.find_first_not_of("0123456789", i) != std::string::npos)
+                return false;
+
+            x = std::strtod(t.c_str(), nullptr);
+            return true;
+        }
+
+        /** \brief Parse text as Python's float() does, without underscores.
+         *  \param[in] text Text to parse.
+         *  \param[out] x Parsed value.
+         *  \return True if \a text is a number.
+         */
+        static bool parseFloat(const std::string &text, double &x)
+        {
+            const auto &t = strip(text);
+            std::size_t i = (not t.empty() and (t[0] == '+' or t[0] == '-')) ? 1 : 0;
+
+            std::string word = t.substr(i);
+            std::transform(word.begin(), word.end(), word.begin(), ::tolower);
+            if (word == "inf" or word == "infinity" or word == "nan")
+            {
+                x = std::strtod(t.c_str(), nullptr);
+                return true;
+            }
+
+            // Mantissa with at least one digit, then an optional exponent. Unlike strtod(), no hex.
+            const auto digits = [&] {
+                const std::size_t begin = i;
+                while (i < t.size() and std::isdigit(t[i]))
+                    ++i;
+                return i - begin;
+            };
+
+            std::size_t n = digits();
+            if (i < t.size() and t[i] == '.')
+            {
+                ++i;
+                n += digits();
+            }
+
+            if (n == 0)
+                return false;
+
+            if (i < t.size() and (t[i] == 'e' or t[i] == 'E'))
+            {
+                ++i;
+                if (i < t.size() and (t[i] == '+' or t[i] == '-'))
+                    ++i;
+                if (digits() == 0)
+                    return false;
+            }
+
+            if (i != t.size())
+                return false;
+
+            x = std::strtod(t.c_str(), nullptr);
+            return true;
+        }
+
+        /** \brief Interpret text as a literal, as xacro does for property values: single-quoted text is
+         *  unquoted, then integers, numbers and booleans are converted, and everything else is a string.
+         */
+        static Value fromLiteral(const std::string &text)
+        {
+            if (text.size() >= 2 and text.front() == '\'' and text.back() == '\'')
+                return fromString(text.substr(1, text.size() - 2));
+
+            // Python 3 would drop underscores in number literals, xacro keeps such text as a string.
+            if (text.find('_') != std::string::npos)
+                return fromString(text);
+
+            double x;
+            if (parseInteger(text, x))
+                return fromNumber(x, true);
+            if (parseFloat(text, x))
+                return fromNumber(x);
+
+            if (text == "True" or text == "true")
+                return fromBool(true);
+            if (text == "False" or text == "false")
+                return fromBool(false);
+
+            return fromString(text);
+        }
+
+        double toNumber() const
+        {
+            if (not number)
+                throw Unsupported("Expected a number, got `" + s + "`");
+
+            return x;
+        }
+
+        bool toBool() const
+        {
+            if (number)
+                return x != 0.;
+
+            if (s == "true" or s == "True")
+                return true;
+            if (s == "false" or s == "False")
+                return false;
+
+            // Anything else must be an integer, as for xacro's get_boolean_value().
+            double y;
+            if (parseInteger(s, y))
+                return y != 0.;
+
+            throw Unsupported("Expected a boolean, got `" + s + "`");
+        }
+
+        /** \brief Format the value as Python would print it.
+         */
+        std::string toString() const
+        {
+            if (not number)
+                return s;
+
+            if (boolean)
+                return (x != 0.) ? "True" : "False";
+
+            if (integer)
+                return std::to_string(static_cast<long long>(x));
+
+            if (std::isinf(x))
+                return (x > 0) ? "inf" : "-inf";
+            if (std::isnan(x))
+                return "nan";
+
+            // Shortest representation that round-trips, like Python's repr().
+            int precision = 1;
+            std::string scientific;
+            for (; precision <= 17; ++precision)
+            {
+                std::ostringstream ss;
+                ss << std::scientific << std::setprecision(precision - 1) << x;
+                scientific = ss.str();
+                if (std::strtod(scientific.c_str(), nullptr) == x)
+                    break;
+            }
+
+            // Python only uses scientific notation for exponents below -4 or from 16 on.
+            const int exponent = std::atoi(scientific.c_str() + scientific.find('e') + 1);
+            if (exponent < -4 or exponent >= 16)
+                return scientific;
+
+            std::ostringstream ss;
+            ss << std::fixed << std::setprecision(std::max(0, precision - 1 - exponent)) << x;
+
+            std::string result = ss.str();
+            if (result.find_first_of(".e") == std::string::npos)
+                result += ".0";
+
+            return result;
+        }
+    };
+
+    /** \brief Parser and evaluator for the subset of Python used in xacro `${}` expressions.
+     */
+    class Expression
+    {
+    public:
+        /** \brief Resolves a name to its value. */
+        using Lookup = std::function<Value(const std::string &)>;
+
+        Expression(const std::string &text, const Lookup &lookup) : text_(text), lookup_(lookup)
+        {
+        }
+
+        Value evaluate()
+        {
+            const auto v = parseOr();
+            skip();
+            if (i_ != text_.size())
+                throw Unsupported("Unexpected `" + text_.substr(i_) + "` in `" + text_ + "`");
+
+            return v;
+        }
+
+    private:
+        void skip()
+        {
+            while (i_ < text_.size() and std::isspace(text_[i_]))
+                ++i_;
+        }
+
+        /** \brief Consume a symbol if it is next. */
+        bool accept(const std::string &symbol)
+        {
+            skip();
+            if (text_.compare(i_, symbol.size(), symbol) != 0)
+                return false;
+
+            // Keywords must not be followed by identifier characters.
+            if (std::isalpha(symbol[0]) and i_ + symbol.size() < text_.size() and
+                (std::isalnum(text_[i_ + symbol.size()]) or text_[i_ + symbol.size()] == '_'))
+                return false;
+
+            i_ += symbol.size();
+            return true;
+        }
+
+        void expect(const std::string &symbol)
+        {
+            if (not accept(symbol))
+                throw Unsupported("Expected `" + symbol + "` in `" + text_ + "`");
+        }
+
+        Value parseOr()
+        {
+            auto v = parseAnd();
+            while (accept("or"))
+            {
+                const auto r = parseAnd();
+                v = (v.toBool()) ? v : r;
+            }
+
+            return v;
+        }
+
+        Value parseAnd()
+        {
+            auto v = parseNot();
+            while (accept("and"))
+            {
+                const auto r = parseNot();
+                v = (v.toBool()) ? r : v;
+            }
+
+            return v;
+        }
+
+        Value parseNot()
+        {
+            if (accept("not"))
+                return Value::fromBool(not parseNot().toBool());
+
+            return parseComparison();
+        }
+
+        Value parseComparison()
+        {
+            const auto a = parseSum();
+
+            // Longer operators first, so `<=` is not read as `<`.
+            for (const std::string op : {"==", "!=", "<=", ">=", "<", ">"})
+                if (accept(op))
+                {
+                    const auto b = parseSum();
+                    if (op == "==" or op == "!=")
+                    {
+                        // As in Python, strings never equal numbers.
+                        const bool equal = (a.number and b.number) ?
+                                               a.x == b.x :
+                                               (not a.number and not b.number and a.s == b.s);
+                        return Value::fromBool((op == "==") == equal);
+                    }
+
+                    const double x = a.toNumber();
+                    const double y = b.toNumber();
+                    if (op == "<")
+                        return Value::fromBool(x < y);
+                    if (op == ">")
+                        return Value::fromBool(x > y);
+                    if (op == "<=")
+                        return Value::fromBool(x <= y);
+                    return Value::fromBool(x >= y);
+                }
+
+            return a;
+        }
+
+        Value parseSum()
+        {
+            auto v = parseProduct();
+            while (true)
+            {
+                if (accept("+"))
+                {
+                    const auto r = parseProduct();
+                    if (not v.number and not r.number)
+                        v = Value::fromString(v.s + r.s);
+                    else
+                        v = Value::fromNumber(v.toNumber() + r.toNumber(), v.integer and r.integer);
+                }
+                else if (accept("-"))
+                {
+                    const auto r = parseProduct();
+                    v = Value::fromNumber(v.toNumber() - r.toNumber(), v.integer and r.integer);
+                }
+                else
+                    return v;
+            }
+        }
+
+        Value parseProduct()
+        {
+            auto v = parseUnary();
+            while (true)
+            {
+                if (accept("*"))
+                {
+                    const auto r = parseUnary();
+                    v = Value::fromNumber(v.toNumber() * r.toNumber(), v.integer and r.integer);
+                }
+                else if (accept("//"))
+                {
+                    const auto r = parseUnary();
+                    v = Value::fromNumber(std::floor(v.toNumber() / r.toNumber()), v.integer and r.integer);
+                }
+                else if (accept("/"))
+                {
+                    const auto r = parseUnary();
+                    v = Value::fromNumber(v.toNumber() / r.toNumber());
+                }
+                else if (accept("%"))
+                {
+                    const auto r = parseUnary();
+                    const double x = v.toNumber();
+                    const double y = r.toNumber();
+                    v = Value::fromNumber(x - y * std::floor(x / y), v.integer and r.integer);
+                }
+                else
+                    return v;
+            }
+        }
+
+        Value parseUnary()
+        {
+            if (accept("-"))
+            {
+                const auto v = parseUnary();
+                return Value::fromNumber(-v.toNumber(), v.integer);
+            }
+
+            if (accept("+"))
+                return Value::fromNumber(parseUnary().toNumber());
+
+            return parsePower();
+        }
+
+        Value parsePower()
+        {
+            const auto v = parsePrimary();
+            if (accept("**"))
+            {
+                const auto r = parseUnary();
+                const bool integer = v.integer and r.integer and r.x >= 0;
+                return Value::fromNumber(std::pow(v.toNumber(), r.toNumber()), integer);
+            }
+
+            return v;
+        }
+
+        Value parsePrimary()
+        {
+            skip();
+            if (i_ >= text_.size())
+                throw Unsupported("Unexpected end of `" + text_ + "`");
+
+            const char c = text_[i_];
+            if (accept("("))
+            {
+                const auto v = parseOr();
+                expect(")");
+                return v;
+            }
+
+            if (c == '\'' or c == '"')
+            {
+                const auto end = text_.find(c, i_ + 1);
+                if (end == std::string::npos)
+                    throw Unsupported("Unterminated string in `" + text_ + "`");
+
+                const auto v = Value::fromString(text_.substr(i_ + 1, end - i_ - 1));
+                i_ = end + 1;
+                return v;
+            }
+
+            if (std::isdigit(c) or c == '.')
+            {
+                const std::size_t begin = i_;
+                while (i_ < text_.size() and (std::isdigit(text_[i_]) or text_[i_] == '.'))
+                    ++i_;
+
+                if (i_ < text_.size() and (text_[i_] == 'e' or text_[i_] == 'E'))
+                {
+                    ++i_;
+                    if (i_ < text_.size() and (text_[i_] == '+' or text_[i_] == '-'))
+                        ++i_;
+                    while (i_ < text_.size() and std::isdigit(text_[i_]))
+                        ++i_;
+                }
+
+                const auto &literal = text_.substr(begin, i_ - begin);
+                double x;
+                if (Value::parseInteger(literal, x))
+                    return Value::fromNumber(x, true);
+                if (Value::parseFloat(literal, x))
+                    return Value::fromNumber(x);
+
+                throw Unsupported("Invalid number `" + literal + "` in `" + text_ + "`");
+            }
+
+            if (std::isalpha(c) or c == '_')
+            {
+                const std::size_t begin = i_;
+                while (i_ < text_.size() and
+                       (std::isalnum(text_[i_]) or text_[i_] == '_' or text_[i_] == '.'))
+                    ++i_;
+
+                std::string name = text_.substr(begin, i_ - begin);
+                if (name.compare(0, 5, "math.") == 0)
+                    name = name.substr(5);
+
+                if (accept("("))
+                {
+                    std::vector<Value> args;
+                    if (not accept(")"))
+                    {
+                        do
+                            args.emplace_back(parseOr());
+                        while (accept(","));
+                        expect(")");
+                    }
+
+                    return call(name, args);
+                }
+
+                return constant(name);
+            }
+
+            throw Unsupported("Unexpected `" + text_.substr(i_) + "` in `" + text_ + "`");
+        }
+
+        Value constant(const std::string &name)
+        {
+            if (name == "True")
+                return Value::fromBool(true);
+            if (name == "False")
+                return Value::fromBool(false);
+
+            return lookup_(name);
+        }
+
+        Value call(const std::string &name, const std::vector<Value> &args)
+        {
+            static const std::map<std::string, double (*)(double)> UNARY = {
+                {"sin", std::sin},   {"cos", std::cos},     {"tan", std::tan},   {"asin", std::asin},
+                {"acos", std::acos}, {"atan", std::atan},   {"sqrt", std::sqrt}, {"fabs", std::fabs},
+                {"exp", std::exp},   {"log", std::log},     {"floor", std::floor}, {"ceil", std::ceil},
+            };
+
+            const auto check = [&](std::size_t n) {
+                if (args.size() != n)
+                    throw Unsupported("Wrong number of arguments to `" + name + "` in `" + text_ + "`");
+            };
+
+            auto it = UNARY.find(name);
+            if (it != UNARY.end())
+            {
+                check(1);
+                return Value::fromNumber(it->second(args[0].toNumber()));
+            }
+
+            if (name == "radians")
+            {
+                check(1);
+                return Value::fromNumber(args[0].toNumber() * M_PI / 180.);
+            }
+            if (name == "degrees")
+            {
+                check(1);
+                return Value::fromNumber(args[0].toNumber() * 180. / M_PI);
+            }
+            if (name == "abs")
+            {
+                check(1);
+                return Value::fromNumber(std::fabs(args[0].toNumber()), args[0].integer);
+            }
+            if (name == "atan2" or name == "pow")
+            {
+                check(2);
+                const double x = args[0].toNumber();
+                const double y = args[1].toNumber();
+                return Value::fromNumber((name == "pow") ? std::pow(x, y) : std::atan2(x, y));
+            }
+            if (name == "min" or name == "max")
+            {
+                if (args.empty())
+                    check(1);
+
+                Value v = args[0];
+                for (const auto &arg : args)
+                    if ((name == "min") ? arg.toNumber() < v.toNumber() : arg.toNumber() > v.toNumber())
+                        v = arg;
+
+                return v;
+            }
+            if (name == "int")
+            {
+                check(1);
+                double x = args[0].x;
+                if (not args[0].number and not Value::parseInteger(args[0].s, x))
+                    throw Unsupported("Invalid integer `" + args[0].s + "` in `" + text_ + "`");
+
+                return Value::fromNumber(std::trunc(x), true);
+            }
+            if (name == "float")
+            {
+                check(1);
+                double x = args[0].x;
+                if (not args[0].number and not Value::parseFloat(args[0].s, x))
+                    throw Unsupported("Invalid number `" + args[0].s + "` in `" + text_ + "`");
+
+                return Value::fromNumber(x);
+            }
+            if (name == "str")
+            {
+                check(1);
+                return Value::fromString(args[0].toString());
+            }
+
+            throw Unsupported("Unsupported function `" + name + "` in `" + text_ + "`");
+        }
+
+        const std::string text_;  ///< Expression text.
+        const Lookup &lookup_;    ///< Name resolution.
+        std::size_t i_{0};        ///< Current position in the text.
+    };
+
+    /** \brief A xacro property.
+     */
+    struct Property
+    {
+        std::string text;                            ///< Unevaluated text of the property.
+        const tinyxml2::XMLElement *block{nullptr};  ///< Block of a block property or parameter.
+        bool evaluated{false};                       ///< Whether \a text is already evaluated.
+        bool literal{false};                         ///< Whether \a text is read as a literal first.
+    };
+
+    /** \brief A scope of properties. Lookups fall through to the parent scope.
+     */
+    struct Scope
+    {
+        const Scope *parent{nullptr};             ///< Enclosing scope.
+        std::map<std::string, Property> values;  ///< Properties defined in this scope.
+
+        /** \brief Find a property and the scope it is defined in. */
+        std::pair<const Property *, const Scope *> find(const std::string &name) const
+        {
+            for (const Scope *scope = this; scope; scope = scope->parent)
+            {
+                auto it = scope->values.find(name);
+                if (it != scope->values.end())
+                    return {&it->second, scope};
+            }
+
+            return {nullptr, nullptr};
+        }
+    };
+
+    /** \brief A xacro macro.
+     */
+    struct Macro
+    {
+        /** \brief A macro parameter. */
+        struct Parameter
+        {
+            std::string name;          ///< Name of the parameter.
+            bool block{false};         ///< Whether the parameter is a block (`*name`).
+            bool has_default{false};   ///< Whether the parameter has a default.
+            bool inherit{false};       ///< Whether the default is inherited from the caller's scope (`^`).
+            std::string default_text;  ///< Default value.
+        };
+
+        std::vector<Parameter> parameters;       ///< Parameters, in order.
+        const tinyxml2::XMLElement *body;        ///< Body of the macro.
+        std::string directory;                   ///< Directory of the file the macro was defined in.
+    };
+
+    /** \brief Native expansion of a xacro document.
+     */
+    class Expander
+    {
+    public:
+        Expander(std::vector<std::string> &files) : files_(files)
+        {
+        }
+
+        bool run(const std::string &path, std::string &result)
+        {
+            auto doc = load(path);
+            auto *root = doc->RootElement();
+            if (not root)
+                throw Unsupported("No root element in `" + path + "`");
+
+            Scope global;
+            directory_ = boost::filesystem::path(path).parent_path().string();
+            process(root, global, *doc);
+            evaluateAttributes(root, global);
+
+            root->DeleteAttribute("xmlns:xacro");
+
+            tinyxml2::XMLPrinter printer;
+            doc->Print(&printer);
+            result = printer.CStr();
+            return true;
+        }
+
+    private:
+        using Document = std::shared_ptr<tinyxml2::XMLDocument>;
+
+        /** \brief Load a document, and keep it alive for the rest of the expansion. */
+        Document load(const std::string &path)
+        {
+            auto doc = std::make_shared<tinyxml2::XMLDocument>();
+            doc->LoadFile(path.c_str());
+            if (doc->Error())
+                throw Unsupported("Failed to parse `" + path + "`");
+
+            files_.emplace_back(path);
+            documents_.emplace_back(doc);
+            return doc;
+        }
+
+        /** \brief Deep copy a node into a document. */
+        static tinyxml2::XMLNode *clone(const tinyxml2::XMLNode *node, tinyxml2::XMLDocument &doc)
+        {
+            auto *copy = node->ShallowClone(&doc);
+            for (const auto *child = node->FirstChild(); child; child = child->NextSibling())
+                copy->InsertEndChild(clone(child, doc));
+
+            return copy;
+        }
+
+        /** \brief Remove the `xacro:` prefix of a name, if it has one. */
+        static bool isXacro(const std::string &name, std::string &tag)
+        {
+            if (name.compare(0, 6, "xacro:") != 0)
+                return false;
+
+            tag = name.substr(6);
+            return true;
+        }
+
+        static std::string attribute(const tinyxml2::XMLElement *element, const std::string &name)
+        {
+            const char *value = element->Attribute(name.c_str());
+            if (not value)
+                throw Unsupported("Missing attribute `" + name + "` on `" + element->Name() + "`");
+
+            return value;
+        }
+
+        /** \brief Get the value of a property, evaluating its text. */
+        Value lookup(const std::string &name, const Scope &scope, std::size_t depth)
+        {
+            if (name == "pi")
+                return Value::fromNumber(M_PI);
+            if (name == "e")
+                return Value::fromNumber(M_E);
+
+            const auto &found = scope.find(name);
+            if (not found.first)
+                throw Unsupported("Undefined property `" + name + "`");
+
+            const auto &property = *found.first;
+            if (property.block)
+                throw Unsupported("Block property `" + name + "` used in an expression");
+
+            if (property.evaluated)
+                return Value::fromLiteral(property.text);
+
+            // Like xacro, property values are read as literals first, so `'text'` is unquoted.
+            std::string text = property.text;
+            if (property.literal)
+            {
+                const auto &literal = Value::fromLiteral(text);
+                if (literal.number)
+                    return literal;
+
+                text = literal.s;
+            }
+
+            // Properties are evaluated lazily in the scope they are defined in.
+            return evaluateValue(text, *found.second, depth + 1);
+        }
+
+        /** \brief Evaluate text, keeping the type of the value if the text is a single expression. */
+        Value evaluateValue(const std::string &text, const Scope &scope, std::size_t depth = 0)
+        {
+            if (depth > MAX_DEPTH)
+                throw Unsupported("Recursive property definition in `" + text + "`");
+
+            if (text.size() > 3 and text.compare(0, 2, "${") == 0 and text.find('}') == text.size() - 1)
+            {
+                const Expression::Lookup lookup = [&](const std::string &name) {
+                    return this->lookup(name, scope, depth);
+                };
+
+                const auto &v = Expression(text.substr(2, text.size() - 3), lookup).evaluate();
+                return (v.number) ? v : Value::fromLiteral(v.s);
+            }
+
+            return Value::fromLiteral(evaluate(text, scope, depth));
+        }
+
+        /** \brief Evaluate the `${}` expressions and `$()` substitutions in text. */
+        std::string evaluate(const std::string &text, const Scope &scope, std::size_t depth = 0)
+        {
+            std::string result;
+            std::size_t i = 0;
+            while (i < text.size())
+            {
+                const auto next = text.find('$', i);
+                if (next == std::string::npos or next + 1 >= text.size())
+                {
+                    result += text.substr(i);
+                    break;
+                }
+
+                result += text.substr(i, next - i);
+
+                const char c = text[next + 1];
+                if (c == '$')
+                {
+                    // `$$` escapes a dollar sign.
+                    result += '$';
+                    i = next + 2;
+                    continue;
+                }
+
+                if (c != '{' and c != '(')
+                {
+                    result += '$';
+                    i = next + 1;
+                    continue;
+                }
+
+                const auto end = text.find((c == '{') ? '}' : ')', next);
+                if (end == std::string::npos)
+                    throw Unsupported("Unterminated expression in `" + text + "`");
+
+                const auto inner = text.substr(next + 2, end - next - 2);
+                if (c == '{')
+                {
+                    const Expression::Lookup lookup = [&](const std::string &name) {
+                        return this->lookup(name, scope, depth);
+                    };
+
+                    result += Expression(inner, lookup).evaluate().toString();
+                }
+                else
+                    result += substitute(inner);
+
+                i = end + 1;
+            }
+
+            return result;
+        }
+
+        /** \brief Evaluate a `$()` substitution. */
+        std::string substitute(const std::string &text)
+        {
+            std::istringstream ss(text);
+            std::string command, argument, rest;
+            ss >> command >> argument;
+            std::getline(ss, rest);
+            rest.erase(0, rest.find_first_not_of(' '));
+
+            if (command == "find")
+            {
+                const auto &path = ros::package::getPath(argument);
+                if (path.empty())
+                    throw Unsupported("Package `" + argument + "` not found");
+
+                return path;
+            }
+
+            if (command == "arg")
+            {
+                auto it = args_.find(argument);
+                if (it == args_.end())
+                    throw Unsupported("Undefined arg `" + argument + "`");
+
+                return it->second;
+            }
+
+            if (command == "env" or command == "optenv")
+            {
+                const char *value = std::getenv(argument.c_str());
+                if (value)
+                    return value;
+                if (command == "optenv")
+                    return rest;
+
+                throw Unsupported("Undefined environment variable `" + argument + "`");
+            }
+
+            if (command == "dirname")
+                return directory_;
+
+            throw Unsupported("Unsupported substitution `$(" + text + ")`");
+        }
+
+        void evaluateAttributes(tinyxml2::XMLElement *element, const Scope &scope)
+        {
+            std::vector<std::pair<std::string, std::string>> attributes;
+            for (const auto *a = element->FirstAttribute(); a; a = a->Next())
+                attributes.emplace_back(a->Name(), a->Value());
+
+            for (const auto &a : attributes)
+                if (a.second.find('$') != std::string::npos)
+                    element->SetAttribute(a.first.c_str(), evaluate(a.second, scope).c_str());
+        }
+
+        /** \brief Replace \a node with all children of \a holder. */
+        static void replace(tinyxml2::XMLNode *parent, tinyxml2::XMLNode *node, tinyxml2::XMLNode *holder)
+        {
+            tinyxml2::XMLNode *anchor = node->PreviousSibling();
+            while (auto *child = holder->FirstChild())
+            {
+                if (anchor)
+                    parent->InsertAfterChild(anchor, child);
+                else
+                    parent->InsertFirstChild(child);
+
+                anchor = child;
+            }
+
+            parent->DeleteChild(node);
+        }
+
+        /** \brief Expand all xacro elements below \a node. */
+        void process(tinyxml2::XMLNode *node, Scope &scope, tinyxml2::XMLDocument &doc)
+        {
+            tinyxml2::XMLNode *child = node->FirstChild();
+            while (child)
+            {
+                tinyxml2::XMLNode *next = child->NextSibling();
+
+                if (auto *text = child->ToText())
+                {
+                    const std::string value = text->Value();
+                    if (value.find('$') != std::string::npos)
+                        text->SetValue(evaluate(value, scope).c_str());
+                }
+                else if (auto *element = child->ToElement())
+                    processElement(node, element, scope, doc);
+
+                child = next;
+            }
+        }
+
+        void processElement(tinyxml2::XMLNode *parent, tinyxml2::XMLElement *element, Scope &scope,
+                            tinyxml2::XMLDocument &doc)
+        {
+            std::string tag;
+            if (not isXacro(element->Name(), tag))
+            {
+                evaluateAttributes(element, scope);
+                process(element, scope, doc);
+                return;
+            }
+
+            if (tag == "property")
+            {
+                const auto &name = attribute(element, "name");
+                if (element->Attribute("scope") or element->Attribute("lazy_eval"))
+                    throw Unsupported("Unsupported property options on `" + name + "`");
+
+                Property property;
+                property.literal = true;
+                if (const char *value = element->Attribute("value"))
+                    property.text = value;
+                else if (const char *value = element->Attribute("default"))
+                {
+                    if (scope.find(name).first)
+                    {
+                        parent->DeleteChild(element);
+                        return;
+                    }
+
+                    property.text = value;
+                }
+                else
+                    property.block = element;
+
+                scope.values[name] = property;
+
+                // Block properties are kept alive in a detached holder, as their contents are used later.
+                if (property.block)
+                    detached(doc)->InsertEndChild(element);
+                else
+                    parent->DeleteChild(element);
+            }
+            else if (tag == "arg")
+            {
+                const auto &name = attribute(element, "name");
+                if (args_.find(name) == args_.end())
+                {
+                    const char *value = element->Attribute("default");
+                    args_[name] = (value) ? evaluate(value, scope) : "";
+                }
+
+                parent->DeleteChild(element);
+            }
+            else if (tag == "include")
+            {
+                if (element->Attribute("ns"))
+                    throw Unsupported("Namespaced includes are not supported");
+
+                auto filename = evaluate(attribute(element, "filename"), scope);
+                if (not boost::filesystem::path(filename).is_absolute())
+                    filename = (boost::filesystem::path(directory_) / filename).string();
+
+                const auto &path = IO::resolvePath(filename);
+                if (path.empty())
+                    throw Unsupported("Included file `" + filename + "` not found");
+
+                auto included = load(path);
+                auto *root = included->RootElement();
+
+                auto *holder = doc.NewElement("holder");
+                if (root)
+                    for (const auto *child = root->FirstChild(); child; child = child->NextSibling())
+                        holder->InsertEndChild(clone(child, doc));
+
+                const auto directory = directory_;
+                directory_ = boost::filesystem::path(path).parent_path().string();
+                process(holder, scope, doc);
+                directory_ = directory;
+
+                replace(parent, element, holder);
+            }
+            else if (tag == "macro")
+            {
+                const auto &name = attribute(element, "name");
+
+                Macro macro;
+                macro.directory = directory_;
+
+                const char *params = element->Attribute("params");
+                for (auto token : splitParameters((params) ? params : ""))
+                {
+                    Macro::Parameter parameter;
+                    if (token.compare(0, 2, "**") == 0)
+                        throw Unsupported("Multi-block parameters are not supported in macro `" + name + "`");
+
+                    if (token[0] == '*')
+                    {
+                        parameter.block = true;
+                        token = token.substr(1);
+                    }
+
+                    const auto split = token.find(":=");
+                    if (split != std::string::npos)
+                    {
+                        parameter.has_default = true;
+                        parameter.default_text = token.substr(split + 2);
+                        token = token.substr(0, split);
+
+                        if (not parameter.default_text.empty() and parameter.default_text[0] == '^')
+                        {
+                            parameter.inherit = true;
+                            parameter.has_default = parameter.default_text.size() > 1;
+                            parameter.default_text = parameter.default_text.substr(
+                                std::min<std::size_t>(2, parameter.default_text.size()));
+                        }
+                    }
+                    else if (token.find('=') != std::string::npos)
+                        throw Unsupported("Unsupported parameter `" + token + "` in macro `" + name + "`");
+
+                    parameter.name = token;
+                    macro.parameters.emplace_back(parameter);
+                }
+
+                // Keep the macro body alive in a detached holder.
+                macro.body = element;
+                detached(doc)->InsertEndChild(element);
+                macros_[name] = macro;
+            }
+            else if (tag == "if" or tag == "unless")
+            {
+                const bool value = evaluateValue(attribute(element, "value"), scope).toBool();
+                if (value == (tag == "if"))
+                {
+                    process(element, scope, doc);
+                    replace(parent, element, element);
+                }
+                else
+                    parent->DeleteChild(element);
+            }
+            else if (tag == "insert_block")
+            {
+                const auto &name = evaluate(attribute(element, "name"), scope);
+                const auto &found = scope.find(name);
+                if (not found.first or not found.first->block)
+                    throw Unsupported("Undefined block `" + name + "`");
+
+                const auto *block = found.first->block;
+                auto *holder = doc.NewElement("holder");
+
+                // Block parameters insert the element itself, block properties insert their contents.
+                std::string block_tag;
+                if (isXacro(block->Name(), block_tag) and block_tag == "property")
+                {
+                    for (const auto *child = block->FirstChild(); child; child = child->NextSibling())
+                        holder->InsertEndChild(clone(child, doc));
+                }
+                else
+                    holder->InsertEndChild(clone(block, doc));
+
+                process(holder, scope, doc);
+                replace(parent, element, holder);
+            }
+            else
+            {
+                auto it = macros_.find(tag);
+                if (it == macros_.end())
+                    throw Unsupported("Unsupported xacro element `" + tag + "`");
+
+                expand(parent, element, it->second, tag, scope, doc);
+            }
+        }
+
+        /** \brief Expand a macro call. */
+        void expand(tinyxml2::XMLNode *parent, tinyxml2::XMLElement *call, const Macro &macro,
+                    const std::string &name, Scope &scope, tinyxml2::XMLDocument &doc)
+        {
+            if (depth_ > MAX_DEPTH)
+                throw Unsupported("Recursive macro `" + name + "`");
+
+            Scope local;
+            local.parent = &scope;
+
+            // Block arguments are the call's child elements, in order.
+            const auto *block = call->FirstChildElement();
+            for (const auto &parameter : macro.parameters)
+            {
+                Property property;
+                property.evaluated = true;
+
+                if (parameter.block)
+                {
+                    if (not block)
+                        throw Unsupported("Missing block `" + parameter.name + "` for macro `" + name + "`");
+
+                    property.block = block;
+                    block = block->NextSiblingElement();
+                }
+                else if (const char *value = call->Attribute(parameter.name.c_str()))
+                    property.text = evaluate(value, scope);
+                else if (parameter.inherit and scope.find(parameter.name).first)
+                    property.text = lookup(parameter.name, scope, 0).toString();
+                else if (parameter.has_default)
+                {
+                    property.text = parameter.default_text;
+                    property.evaluated = false;
+                }
+                else
+                    throw Unsupported("Missing parameter `" + parameter.name + "` for macro `" + name + "`");
+
+                local.values[parameter.name] = property;
+            }
+
+            auto *holder = doc.NewElement("holder");
+            for (const auto *child = macro.body->FirstChild(); child; child = child->NextSibling())
+                holder->InsertEndChild(clone(child, doc));
+
+            const auto directory = directory_;
+            directory_ = macro.directory;
+            ++depth_;
+            process(holder, local, doc);
+            --depth_;
+            directory_ = directory;
+
+            // The call (and its block arguments) is only removed once the expansion is done.
+            replace(parent, call, holder);
+        }
+
+        /** \brief Get a detached node of a document, to keep nodes alive that are no longer in the tree. */
+        tinyxml2::XMLElement *detached(tinyxml2::XMLDocument &doc)
+        {
+            if (not detached_)
+                detached_ = doc.NewElement("detached");
+
+            return detached_;
+        }
+
+        std::vector<std::string> &files_;          ///< Files read.
+        std::vector<Document> documents_;          ///< Loaded documents.
+        std::map<std::string, Macro> macros_;      ///< Defined macros.
+        std::map<std::string, std::string> args_;  ///< Defined args.
+        tinyxml2::XMLElement *detached_{nullptr};  ///< Holder of nodes no longer in the tree.
+        std::string directory_;                    ///< Directory of the current file.
+        std::size_t depth_{0};                     ///< Macro expansion depth.
+    };
+}  // namespace
+
+bool IO::expandXacro(const std::string &path, std::string &result, std::vector<std::string> &files)
+{
+    files.clear();
+
+    const auto &full_path = resolvePath(path);
+    if (full_path.empty())
+        return false;
+
+    try
+    {
+        Expander expander(files);
+        return expander.run(full_path, result);
+    }
+    catch (const Unsupported &e)
+    {
+        RBX_DEBUG("Cannot expand `%s` natively: %s", full_path, e.what());
+        return false;
+    }
+}
@@ -1,16 +1,326 @@
 /* Author: Zachary Kingston */
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <unistd.h>
+
 #include <robowflex_library/log.h>
 
 using namespace robowflex;
 
 namespace
 {
+    /** \brief Output a message through rosconsole. */
+    void output(ros::console::Level level, const std::string &message)
+    {
+        switch (level)
+        {
+            case ros::console::levels::Debug:
+                ROS_DEBUG_STREAM(message);
+                break;
+            case ros::console::levels::Info:
+                ROS_INFO_STREAM(message);
+                break;
+            case ros::console::levels::Warn:
+                ROS_WARN_STREAM(message);
+                break;
+            case ros::console::levels::Error:
+                ROS_ERROR_STREAM(message);
+                break;
+            default:
+                ROS_FATAL_STREAM(message);
+                break;
+        }
+    }
+
+    /** \brief Messages pending output from a single thread. Only the owning thread pushes, and only one
+     *  flush at a time pops, so the buffer needs no lock.
+     */
+    class LogBuffer
+    {
+    public:
+        /** \brief A pending message. */
+        struct Message
+        {
+            std::size_t sequence;       ///< Order of the message among all threads.
+            ros::console::Level level;  ///< Level of the message.
+            std::string text;           ///< Formatted message.
+        };
+
+        LogBuffer(std::size_t capacity) : messages_(std::max<std::size_t>(1, capacity))
+        {
+        }
+
+        /** \brief Add a message. Returns false and counts the message as dropped if the buffer is full. */
+        bool push(Message &&message)
+        {
+            const std::size_t tail = tail_.load(std::memory_order_relaxed);
+            if (tail - head_.load(std::memory_order_acquire) == messages_.size())
+            {
+                dropped_++;
+                return false;
+            }
+
+            messages_[tail % messages_.size()] = std::move(message);
+            tail_.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        /** \brief Take the oldest message. Returns false if the buffer is empty. */
+        bool pop(Message &message)
+        {
+            const std::size_t head = head_.load(std::memory_order_relaxed);
+            if (head == tail_.load(std::memory_order_acquire))
+                return false;
+
+            message = std::move(messages_[head % messages_.size()]);
+            head_.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        /** \brief Get and reset the number of dropped messages. */
+        std::size_t takeDropped()
+        {
+            return dropped_.exchange(0);
+        }
+
+    private:
+        std::vector<Message> messages_;        ///< Ring of messages.
+        std::atomic<std::size_t> head_{0};     ///< Number of messages taken.
+        std::atomic<std::size_t> tail_{0};     ///< Number of messages added.
+        std::atomic<std::size_t> dropped_{0};  ///< Number of messages dropped since the last flush.
+    };
+
+    /** \brief Outputs asynchronous messages on a background thread.
+     */
+    class AsyncLogger
+    {
+    public:
+        static AsyncLogger &get()
+        {
+            static AsyncLogger logger;
+            return logger;
+        }
+
+        ~AsyncLogger()
+        {
+            stop();
+        }
+
+        void start(std::size_t capacity, double period)
+        {
+            std::unique_lock<std::mutex> lock(control_mutex_);
+            capacity_ = capacity;
+            period_ = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(std::max(period, 1e-3)));
+
+            if (thread_.joinable())
+                return;
+
+            // Start from the level of the ROS logger, which may have been set by configuration.
+            std::map<std::string, ros::console::levels::Level> loggers;
+            ros::console::get_loggers(loggers);
+
+            const auto it = loggers.find(ROSCONSOLE_DEFAULT_NAME);
+            if (it != loggers.end())
+                level = it->second;
+
+            active_ = true;
+            thread_ = std::thread([this] { run(); });
+            async = true;
+        }
+
+        void stop()
+        {
+            std::unique_lock<std::mutex> lock(control_mutex_);
+            if (not thread_.joinable())
+                return;
+
+            async = false;
+            {
+                std::unique_lock<std::mutex> active_lock(mutex_);
+                active_ = false;
+            }
+
+            cv_.notify_all();
+            thread_.join();
+            flush();
+        }
+
+        void push(ros::console::Level level, std::string &&text)
+        {
+            getBuffer().push({sequence_++, level, std::move(text)});
+        }
+
+        /** \brief Output pending messages of all threads, in the order they were logged. */
+        void flush()
+        {
+            std::unique_lock<std::mutex> lock(flush_mutex_);
+
+            std::vector<std::shared_ptr<LogBuffer>> buffers;
+            {
+                std::unique_lock<std::mutex> registry_lock(registry_mutex_);
+                buffers = buffers_;
+
+                // Buffers only held by the registry and the local copy belong to threads that have
+                // exited. They are still drained below through the copy before being released.
+                const auto is_orphan = [](const std::shared_ptr<LogBuffer> &buffer) {
+                    return buffer.use_count() == 2;
+                };
+                buffers_.erase(std::remove_if(buffers_.begin(), buffers_.end(), is_orphan), buffers_.end());
+            }
+
+            std::size_t dropped = 0;
+            std::vector<LogBuffer::Message> messages;
+
+            LogBuffer::Message message;
+            for (const auto &buffer : buffers)
+            {
+                while (buffer->pop(message))
+                    messages.emplace_back(std::move(message));
+
+                dropped += buffer->takeDropped();
+            }
+
+            std::sort(messages.begin(), messages.end(),
+                      [](const LogBuffer::Message &a, const LogBuffer::Message &b) {
+                          return a.sequence < b.sequence;
+                      });
+
+            for (const auto &pending : messages)
+                output(pending.level, pending.text);
+
+            if (dropped)
+                output(ros::console::levels::Warn,
+                       log::format("%1% log messages were dropped, consider a larger buffer", dropped));
+        }
+
+        std::atomic<bool> async{false};                      ///< If true, messages are asynchronous.
+        std::atomic<int> level{ros::console::levels::Info};  ///< Lowest level that is output.
+
+    private:
+        AsyncLogger() = default;
+
+        void run()
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (active_)
+            {
+                cv_.wait_for(lock, period_);
+
+                lock.unlock();
+                flush();
+                lock.lock();
+            }
+        }
+
+        LogBuffer &getBuffer()
+        {
+            thread_local std::shared_ptr<LogBuffer> buffer;
+            if (not buffer)
+            {
+                buffer = std::make_shared<LogBuffer>(capacity_);
+
+                std::unique_lock<std::mutex> lock(registry_mutex_);
+                buffers_.emplace_back(buffer);
+            }
+
+            return *buffer;
+        }
+
+        std::atomic<std::size_t> sequence_{0};     ///< Sequence number of the next message.
+        std::atomic<std::size_t> capacity_{1024};  ///< Capacity of new buffers.
+
+        /** \brief Time between flushes. */
+        std::chrono::steady_clock::duration period_{std::chrono::milliseconds(50)};
+
+        std::mutex registry_mutex_;                        ///< Mutex for the buffer registry.
+        std::vector<std::shared_ptr<LogBuffer>> buffers_;  ///< Buffers of all threads.
+
+        std::mutex control_mutex_;    ///< Serializes start() and stop().
+        std::mutex flush_mutex_;      ///< Serializes flushes.
+        std::mutex mutex_;            ///< Mutex for the flusher thread.
+        std::condition_variable cv_;  ///< Wakes the flusher thread.
+        bool active_{false};          ///< If false, the flusher thread stops.
+        std::thread thread_;          ///< Flusher thread.
+    };
+
     void setLoggerLevel(ros::console::Level level)
     {
+        AsyncLogger::get().level = level;
         if (ros::console::set_logger_level(ROSCONSOLE_DEFAULT_NAME, level))
             ros::console::notifyLoggerLevelsChanged();
     }
+
+    /** \brief Ring buffer of the spans of a single thread. The mutex is only contended while spans are
+     *  collected. */
+    struct TraceBuffer
+    {
+        std::mutex mutex;                     ///< Buffer mutex.
+        std::vector<log::trace::Span> spans;  ///< Recorded spans.
+        std::size_t next{0};                  ///< Index the next span is written to.
+        std::size_t thread;                   ///< Index of the owning thread.
+    };
+
+    /** \brief All trace buffers. Buffers are kept after their thread exits, so their spans can still be
+     *  exported. */
+    struct TraceRegistry
+    {
+        std::mutex mutex;                                   ///< Registry mutex.
+        std::vector<std::shared_ptr<TraceBuffer>> buffers;  ///< Buffers of all threads.
+        std::atomic<std::size_t> capacity{1 << 16};         ///< Spans kept per thread.
+    };
+
+    TraceRegistry &getTraceRegistry()
+    {
+        static TraceRegistry registry;
+        return registry;
+    }
+
+    TraceBuffer &getTraceBuffer()
+    {
+        thread_local std::shared_ptr<TraceBuffer> buffer;
+        if (not buffer)
+        {
+            auto &registry = getTraceRegistry();
+
+            buffer = std::make_shared<TraceBuffer>();
+            buffer->spans.reserve(std::max<std::size_t>(1, registry.capacity));
+
+            std::unique_lock<std::mutex> lock(registry.mutex);
+            buffer->thread = registry.buffers.size();
+            registry.buffers.emplace_back(buffer);
+        }
+
+        return *buffer;
+    }
+
+    /** \brief Escape \a value for a JSON string. */
+    std::string escapeJSON(const std::string &value)
+    {
+        std::string out;
+        for (const char c : value)
+        {
+            if (c == '"' or c == '\\')
+                out += '\\';
+
+            if ((unsigned char)c < 0x20)
+                out += ' ';
+            else
+                out += c;
+        }
+
+        return out;
+    }
 }  // namespace
 
 std::string log::formatRecurse(boost::format &f)
@@ -42,3 +352,154 @@ void log::showUpToDebug()
 {
     setLoggerLevel(ros::console::levels::Debug);
 }
+
+void log::setAsync(bool async, std::size_t capacity, double period)
+{
+    if (async)
+        AsyncLogger::get().start(capacity, period);
+    else
+        AsyncLogger::get().stop();
+}
+
+bool log::isAsync()
+{
+    return AsyncLogger::get().async.load(std::memory_order_relaxed);
+}
+
+bool log::isEnabled(ros::console::Level level)
+{
+    return level >= AsyncLogger::get().level.load(std::memory_order_relaxed);
+}
+
+void log::push(ros::console::Level level, std::string message)
+{
+    AsyncLogger::get().push(level, std::move(message));
+}
+
+void log::flush()
+{
+    AsyncLogger::get().flush();
+}
+
+///
+/// log::RateLimiter
+///
+
+log::RateLimiter::RateLimiter(double period)
+  : period_(std::chrono::duration_cast<std::chrono::nanoseconds>(  //
+                std::chrono::duration<double>(period))
+                .count())
+  , last_(std::numeric_limits<int64_t>::min())
+{
+}
+
+bool log::RateLimiter::allow(std::size_t &suppressed)
+{
+    const int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::steady_clock::now().time_since_epoch())
+                            .count();
+
+    // Only one of the threads that find the period elapsed gets to log.
+    int64_t last = last_.load(std::memory_order_relaxed);
+    if ((last != std::numeric_limits<int64_t>::min() and now - last < period_) or
+        not last_.compare_exchange_strong(last, now))
+    {
+        suppressed_++;
+        return false;
+    }
+
+    suppressed = suppressed_.exchange(0);
+    return true;
+}
+
+std::string log::RateLimiter::getSuffix(std::size_t suppressed)
+{
+    if (suppressed == 0)
+        return "";
+
+    return log::format(" (%1% similar messages suppressed)", suppressed);
+}
+
+///
+/// log::trace
+///
+
+void log::trace::record(const char *name, Clock::time_point start, Clock::time_point finish)
+{
+    auto &buffer = getTraceBuffer();
+    std::unique_lock<std::mutex> lock(buffer.mutex);
+
+    const Span span{name, start, finish, buffer.thread};
+    if (buffer.spans.size() < buffer.spans.capacity())
+        buffer.spans.emplace_back(span);
+    else
+        buffer.spans[buffer.next] = span;
+
+    buffer.next = (buffer.next + 1) % buffer.spans.capacity();
+}
+
+void log::trace::setCapacity(std::size_t capacity)
+{
+    getTraceRegistry().capacity = capacity;
+}
+
+std::vector<log::trace::Span> log::trace::getSpans()
+{
+    auto &registry = getTraceRegistry();
+    std::unique_lock<std::mutex> lock(registry.mutex);
+
+    std::vector<Span> spans;
+    for (const auto &buffer : registry.buffers)
+    {
+        std::unique_lock<std::mutex> buffer_lock(buffer->mutex);
+        spans.insert(spans.end(), buffer->spans.begin(), buffer->spans.end());
+    }
+
+    std::sort(spans.begin(), spans.end(), [](const Span &a, const Span &b) { return a.start < b.start; });
+    return spans;
+}
+
+void log::trace::clear()
+{
+    auto &registry = getTraceRegistry();
+    std::unique_lock<std::mutex> lock(registry.mutex);
+
+    for (const auto &buffer : registry.buffers)
+    {
+        std::unique_lock<std::mutex> buffer_lock(buffer->mutex);
+        buffer->spans.clear();
+        buffer->next = 0;
+    }
+}
+
+bool log::trace::exportChromeTrace(const std::string &filename)
+{
+    std::ofstream out(filename);
+    if (not out)
+    {
+        RBX_ERROR("Failed to open trace file `%s`", filename);
+        return false;
+    }
+
+    const auto &spans = getSpans();
+    const auto origin = (spans.empty()) ? Clock::time_point() : spans.front().start;
+    const auto micros = [&](Clock::duration duration) {
+        return std::chrono::duration<double, std::micro>(duration).count();
+    };
+
+    // Complete ("X") events, with times in microseconds from the first span.
+    const int pid = ::getpid();
+    out << std::fixed << std::setprecision(3);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    for (std::size_t i = 0; i < spans.size(); ++i)
+    {
+        const auto &span = spans[i];
+        out << ((i) ? ",\n" : "\n");
+        out << "{\"name\":\"" << escapeJSON(span.name) << "\",\"ph\":\"X\",";
+        out << "\"ts\":" << micros(span.start - origin) << ",\"dur\":" << micros(span.finish - span.start);
+        out << ",\"pid\":" << pid << ",\"tid\":" << span.thread << "}";
+    }
+
+    out << "\n]}\n";
+    return bool(out);
+}
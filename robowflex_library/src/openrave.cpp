@@ -1,6 +1,9 @@
 /* Author: Bryce Willey */
 
 #include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <map>
 #include <stack>
 
 #include <tinyxml2.h>
@@ -16,8 +19,10 @@
 #include <robowflex_library/constants.h>
 #include <robowflex_library/geometry.h>
 #include <robowflex_library/io.h>
+#include <robowflex_library/io/yaml.h>
 #include <robowflex_library/log.h>
 #include <robowflex_library/openrave.h>
+#include <robowflex_library/pool.h>
 #include <robowflex_library/tf.h>
 
 using namespace robowflex;
@@ -28,8 +33,9 @@ namespace
     struct SceneParsingContext
     {
         RobotPose robot_offset;
-        std::vector<moveit_msgs::CollisionObject> coll_objects;
         std::stack<std::string> directory_stack;
+        std::vector<std::string> files;  // Every file read, to validate cache entries.
+        std::map<std::string, std::vector<std::pair<std::size_t, std::size_t>>> meshes;  // Slots by file.
     };
 
     double toRadians(double v)
@@ -108,6 +114,7 @@ namespace
                 return false;
             }
 
+            load_struct.files.emplace_back(full_path);
             load_struct.directory_stack.push(IO::resolveParent(full_path));
             return parseKinbody(load_struct, getFirstChild(&doc, "KinBody"), tf * this_tf, planning_scene);
         }
@@ -149,8 +156,6 @@ namespace
                 if (geom_str == "trimesh")
                 {
                     // Set resource
-                    Eigen::Vector3d dimensions{1, 1, 1};
-
                     tinyxml2::XMLElement *data = getFirstChild(geom, "Data");
                     std::string resource_path;
                     if (data)
@@ -169,9 +174,12 @@ namespace
                             return false;
                         }
                     }
-                    auto mesh = Geometry::makeMesh(resource_path, dimensions);
 
-                    coll_obj.meshes.push_back(mesh->getMeshMsg());
+                    // Meshes are loaded once all bodies are parsed, so each file is only loaded once.
+                    const std::size_t object = planning_scene.world.collision_objects.size();
+                    load_struct.meshes[resource_path].emplace_back(object, coll_obj.meshes.size());
+
+                    coll_obj.meshes.emplace_back();
                     coll_obj.mesh_poses.push_back(pose_msg);
                 }
 
@@ -195,7 +203,6 @@ namespace
 
                 coll_obj.operation = moveit_msgs::CollisionObject::ADD;
 
-                load_struct.coll_objects.push_back(coll_obj);
                 planning_scene.world.collision_objects.push_back(coll_obj);
             }
         }
@@ -203,54 +210,187 @@ namespace
         load_struct.directory_stack.pop();
         return true;
     }
+
+    bool parseEnvironment(SceneParsingContext &load_struct, const std::string &file,
+                          moveit_msgs::PlanningScene &planning_scene)
+    {
+        // Hardcoded offset on WAM (see wam7.kinbody.xml)
+        RobotPose tf;
+        tf.translation() = Eigen::Vector3d(0.0, 0.0, -0.346);
+        tf.linear() = Eigen::Quaterniond::Identity().toRotationMatrix();
+        load_struct.robot_offset = tf;
+
+        tinyxml2::XMLDocument doc;
+        if (!doc.LoadFile(file.c_str()))
+        {
+            RBX_ERROR("Cannot load file %s", file);
+            return false;
+        }
+
+        load_struct.files.emplace_back(file);
+
+        auto *env = getFirstChild(&doc, "Environment");
+        auto *robot = getFirstChild(env, "Robot");
+        if (robot)
+            load_struct.robot_offset =
+                load_struct.robot_offset * TFfromXML(getFirstChild(robot, "Translation"),  //
+                                                     getFirstChild(robot, "RotationAxis"), nullptr);
+
+        auto *elem = getFirstChild(env);
+        if (not elem)
+        {
+            RBX_ERROR("There is no/an empty environment element in this openrave scene.");
+            return false;
+        }
+
+        for (; elem; elem = elem->NextSiblingElement())
+        {
+            const std::string p_key = std::string(elem->Value());
+            if (p_key == "KinBody")
+            {
+                if (!parseKinbody(load_struct, elem, load_struct.robot_offset.inverse(), planning_scene))
+                    return false;
+            }
+            else
+                RBX_INFO("Ignoring elements of value %s", p_key);
+        }
+
+        return true;
+    }
+
+    bool loadMeshes(SceneParsingContext &load_struct, const Pool &pool,
+                    moveit_msgs::PlanningScene &planning_scene)
+    {
+        std::vector<decltype(load_struct.meshes)::const_iterator> entries;
+        for (auto it = load_struct.meshes.begin(); it != load_struct.meshes.end(); ++it)
+        {
+            entries.emplace_back(it);
+            load_struct.files.emplace_back(IO::resolvePath(it->first));
+        }
+
+        // Each file fills its own mesh slots, so no slot is written by two threads.
+        std::atomic<bool> success{true};
+        pool.parallelFor(
+            0, entries.size(),
+            [&](std::size_t i) {
+                const auto &mesh = Geometry::makeMesh(entries[i]->first, Eigen::Vector3d::Ones());
+                if (not mesh->getShape())
+                {
+                    RBX_ERROR("Failed to load mesh %s", entries[i]->first);
+                    success = false;
+                    return;
+                }
+
+                const auto &msg = mesh->getMeshMsg();
+                for (const auto &slot : entries[i]->second)
+                    planning_scene.world.collision_objects[slot.first].meshes[slot.second] = msg;
+            },
+            1);
+
+        return success;
+    }
+
+    std::string getCacheEntry(const std::string &cache_directory, const std::string &file,
+                              const std::string &model_dir)
+    {
+        const auto &key = file + "\n" + model_dir + "\n" + IO::loadFileToString(file);
+        return cache_directory + "/openrave_" + IO::hashString(key);
+    }
+
+    bool loadCache(const std::string &entry, moveit_msgs::PlanningScene &planning_scene)
+    {
+        const auto &yaml = IO::loadFileToYAML(entry + ".yml");
+        if (not yaml.first)
+            return false;
+
+        try
+        {
+            const auto &inputs = yaml.second["inputs"];
+            if (not IO::isNode(inputs))
+                return false;
+
+            for (auto it = inputs.begin(); it != inputs.end(); ++it)
+            {
+                const auto &file = it->first.as<std::string>();
+                if (IO::hashString(IO::loadFileToString(file)) != it->second.as<std::string>())
+                {
+                    RBX_INFO("OpenRAVE scene cache `%s` is stale, `%s` has changed", entry, file);
+                    return false;
+                }
+            }
+        }
+        catch (const YAML::Exception &e)
+        {
+            RBX_WARN("Failed to parse OpenRAVE scene cache `%s`: %s", entry, e.what());
+            return false;
+        }
+
+        return IO::binaryFileToMessage(planning_scene, entry + ".bin");
+    }
+
+    void saveCache(const std::string &entry, const std::vector<std::string> &files,
+                   const moveit_msgs::PlanningScene &planning_scene)
+    {
+        YAML::Node node;
+        for (const auto &file : files)
+            node["inputs"][file] = IO::hashString(IO::loadFileToString(file));
+
+        // Write to temporary files first, so concurrent imports never read a partial entry. The inputs are
+        // written last, as an entry is only used once they exist.
+        const std::string temp = "." + std::to_string(IO::getProcessID());
+        const std::string scene = entry + ".bin";
+        const std::string inputs = entry + ".yml";
+        if (not IO::messageToBinaryFile(planning_scene, scene + temp) or
+            std::rename((scene + temp).c_str(), scene.c_str()) != 0 or  //
+            not IO::YAMLToFile(node, inputs + temp) or
+            std::rename((inputs + temp).c_str(), inputs.c_str()) != 0)
+        {
+            RBX_WARN("Failed to write OpenRAVE scene cache `%s`", entry);
+            IO::deleteFile(scene + temp);
+            IO::deleteFile(inputs + temp);
+        }
+    }
 }  // namespace
 
 bool openrave::fromXMLFile(moveit_msgs::PlanningScene &planning_scene, const std::string &file,
                            const std::string &model_dir)
 {
-    SceneParsingContext load_struct;
-    load_struct.directory_stack.push(model_dir);
-
-    // Hardcoded offset on WAM (see wam7.kinbody.xml)
-    RobotPose tf;
-    tf.translation() = Eigen::Vector3d(0.0, 0.0, -0.346);
-    tf.linear() = Eigen::Quaterniond::Identity().toRotationMatrix();
-    load_struct.robot_offset = tf;
+    return fromXMLFile(planning_scene, file, model_dir, Pool(0), "");
+}
 
-    tinyxml2::XMLDocument doc;
-    if (!doc.LoadFile(IO::resolvePath(file).c_str()))
+bool openrave::fromXMLFile(moveit_msgs::PlanningScene &planning_scene, const std::string &file,
+                           const std::string &model_dir, const Pool &pool, const std::string &cache_directory)
+{
+    const auto &path = IO::resolvePath(file);
+    if (path.empty())
     {
         RBX_ERROR("Cannot load file %s", file);
         return false;
     }
 
-    auto *env = getFirstChild(&doc, "Environment");
-    auto *robot = getFirstChild(env, "Robot");
-    if (robot)
-        load_struct.robot_offset =
-            load_struct.robot_offset * TFfromXML(getFirstChild(robot, "Translation"),  //
-                                                 getFirstChild(robot, "RotationAxis"), nullptr);
+    moveit_msgs::PlanningScene imported;
 
-    auto *elem = getFirstChild(env);
-    if (not elem)
-    {
-        RBX_ERROR("There is no/an empty environment element in this openrave scene.");
-        return false;
-    }
+    const std::string &entry =
+        (cache_directory.empty()) ? "" : getCacheEntry(cache_directory, path, model_dir);
+    if (not entry.empty() and loadCache(entry, imported))
+        RBX_INFO("Loaded OpenRAVE scene `%s` from cache `%s`", file, entry);
 
-    for (; elem; elem = elem->NextSiblingElement())
+    else
     {
-        const std::string p_key = std::string(elem->Value());
-        if (p_key == "KinBody")
-        {
-            if (!parseKinbody(load_struct, elem, load_struct.robot_offset.inverse(), planning_scene))
-                return false;
-        }
-        else
-            RBX_INFO("Ignoring elements of value %s", p_key);
+        SceneParsingContext load_struct;
+        load_struct.directory_stack.push(model_dir);
+
+        if (not parseEnvironment(load_struct, path, imported) or not loadMeshes(load_struct, pool, imported))
+            return false;
+
+        if (not entry.empty())
+            saveCache(entry, load_struct.files, imported);
     }
 
-    if (not load_struct.coll_objects.empty())
+    for (const auto &object : imported.world.collision_objects)
+        planning_scene.world.collision_objects.push_back(object);
+
+    if (not imported.world.collision_objects.empty())
         planning_scene.is_diff = true;
 
     return true;
@@ -1,8 +1,24 @@
 /* Author: Zachary Kingston */
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <limits>
+#include <mutex>
+#include <random>
+
+#include <boost/lexical_cast.hpp>
+
 #include <moveit/robot_state/conversions.h>
 
+#include <std_msgs/String.h>
+
+#include <robowflex_library/builder.h>
 #include <robowflex_library/io.h>
+#include <robowflex_library/io/bag.h>
+#include <robowflex_library/io/plugin.h>
 #include <robowflex_library/log.h>
 #include <robowflex_library/macros.h>
 #include <robowflex_library/planning.h>
@@ -38,6 +54,101 @@ const std::string &Planner::getName() const
     return name_;
 }
 
+namespace
+{
+    /** \brief A plan job that calls a function once it is done, or skipped because it was canceled.
+     */
+    class SerialPlanJob : public Pool::Job<planning_interface::MotionPlanResponse>
+    {
+    public:
+        SerialPlanJob(std::function<planning_interface::MotionPlanResponse()> &&function,
+                      std::function<void()> &&done)
+          : Pool::Job<planning_interface::MotionPlanResponse>(std::move(function)), done_(std::move(done))
+        {
+        }
+
+        void execute() override
+        {
+            Pool::Job<planning_interface::MotionPlanResponse>::execute();
+            done_();
+        }
+
+    protected:
+        void abandon() override
+        {
+            Pool::Job<planning_interface::MotionPlanResponse>::abandon();
+            done_();
+        }
+
+    private:
+        std::function<void()> done_;  ///< Called when the job is done or skipped.
+    };
+}  // namespace
+
+Planner::PlanJobPtr Planner::planAsync(const SceneConstPtr &scene,
+                                       const planning_interface::MotionPlanRequest &request)
+{
+    // Requests wait in this planner's own queue rather than on the executor, so a backlog of requests to
+    // one planner only ever occupies one executor thread.
+    auto job = std::make_shared<SerialPlanJob>(
+        make_function([this, scene, request] { return plan(scene, request); }), [this] { nextAsync(); });
+
+    {
+        std::unique_lock<std::mutex> lock(async_mutex_);
+        if (async_busy_)
+        {
+            async_queue_.emplace_back(job);
+            return job;
+        }
+
+        async_busy_ = true;
+    }
+
+    getExecutor().submitJob(job);
+    return job;
+}
+
+void Planner::nextAsync()
+{
+    std::shared_ptr<Pool::Joblet> next;
+    {
+        std::unique_lock<std::mutex> lock(async_mutex_);
+        if (async_queue_.empty())
+        {
+            async_busy_ = false;
+            return;
+        }
+
+        next = async_queue_.front();
+        async_queue_.pop_front();
+    }
+
+    getExecutor().submitJob(next);
+}
+
+bool Planner::terminate()
+{
+    return false;
+}
+
+Pool &Planner::getExecutor()
+{
+    static Pool executor(std::max(1u, std::thread::hardware_concurrency()), Pool::Scheduler::STEALING);
+    return executor;
+}
+
+planning_interface::MotionPlanResponse
+Planner::planAnytime(const SceneConstPtr &scene, const planning_interface::MotionPlanRequest &request,
+                     const SolutionCallback &callback)
+{
+    auto response = plan(scene, request);
+    if (callback and response.error_code_.val == moveit_msgs::MoveItErrorCodes::SUCCESS and
+        response.trajectory_)
+        callback(response, Trajectory(response.trajectory_).getLength());
+
+    return response;
+}
+
 void Planner::preRun(const SceneConstPtr & /*scene*/,
                      const planning_interface::MotionPlanRequest & /*request*/)
 {
@@ -50,6 +161,15 @@ std::map<std::string, Planner::ProgressProperty> Planner::getProgressProperties(
     return {};
 }
 
+std::map<std::string, double> Planner::getLastPlanMetrics() const
+{
+    return {};
+}
+
+void Planner::clearCaches()
+{
+}
+
 ///
 /// PoolPlanner
 ///
@@ -59,25 +179,68 @@ PoolPlanner::PoolPlanner(const RobotPtr &robot, unsigned int n, const std::strin
 {
 }
 
-std::shared_ptr<Pool::Job<planning_interface::MotionPlanResponse>>
-PoolPlanner::submit(const SceneConstPtr &scene, const planning_interface::MotionPlanRequest &request)
+PoolPlanner::PoolPlanner(const RobotPtr &robot, unsigned int n, const Pool::Affinity &affinity,
+                         const std::string &name)
+  : Planner(robot, name), pool_(n, Pool::Scheduler::SHARED, affinity)
 {
-    return pool_.submit(make_function([&] {
-        std::unique_lock<std::mutex> lock(mutex_);
-        cv_.wait(lock, [&] { return !planners_.empty(); });
+}
 
-        auto planner = planners_.front();
-        planners_.pop();
+bool PoolPlanner::initialize(const PlannerAllocator &allocator)
+{
+    const unsigned int n = pool_.getThreadCount();
 
-        lock.unlock();
+    // Each job builds the planner of the worker it runs on, unless another job already has, so planners
+    // are usually allocated by the thread that uses them.
+    std::mutex mutex;
+    std::vector<char> claimed(n, false);
+    std::vector<PlannerPtr> planners(n);
 
-        auto result = planner->plan(scene, request);
+    const auto build = [&] {
+        unsigned int index;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            index = pool_.getWorkerIndex();
+            if (claimed[index])
+                index = std::find(claimed.begin(), claimed.end(), false) - claimed.begin();
 
-        lock.lock();
-        planners_.emplace(planner);
-        cv_.notify_one();
+            claimed[index] = true;
+        }
+
+        planners[index] = allocator(index);
+        return planners[index] != nullptr;
+    };
+
+    std::vector<std::shared_ptr<Pool::Job<bool>>> jobs;
+    for (unsigned int i = 0; i < n; ++i)
+        jobs.emplace_back(pool_.submit(make_function(build)));
+
+    bool success = true;
+    for (const auto &job : jobs)
+        success &= job->get();
+
+    if (not success)
+        return false;
+
+    planners_ = std::move(planners);
+    return true;
+}
+
+std::shared_ptr<Pool::Job<planning_interface::MotionPlanResponse>>
+PoolPlanner::submit(const SceneConstPtr &scene, const planning_interface::MotionPlanRequest &request)
+{
+    return pool_.submit(make_function([this, scene, request] {
+        // Each worker uses its own planner, so no synchronization is needed.
+        const int index = pool_.getWorkerIndex();
+        if (index < 0 or static_cast<std::size_t>(index) >= planners_.size())
+        {
+            RBX_ERROR("No planner for this thread, was the pool planner initialized?");
+
+            planning_interface::MotionPlanResponse response;
+            response.error_code_.val = moveit_msgs::MoveItErrorCodes::FAILURE;
+            return response;
+        }
 
-        return result;
+        return planners_[index]->plan(scene, request);
     }));
 }
 
@@ -88,11 +251,540 @@ planning_interface::MotionPlanResponse PoolPlanner::plan(const SceneConstPtr &sc
     return job->get();
 }
 
+Planner::PlanJobPtr PoolPlanner::planAsync(const SceneConstPtr &scene,
+                                           const planning_interface::MotionPlanRequest &request)
+{
+    return submit(scene, request);
+}
+
+bool PoolPlanner::terminate()
+{
+    bool r = false;
+    for (const auto &planner : planners_)
+        r |= planner->terminate();
+
+    return r;
+}
+
+void PoolPlanner::clearCaches()
+{
+    for (const auto &planner : planners_)
+        planner->clearCaches();
+}
+
 std::vector<std::string> PoolPlanner::getPlannerConfigs() const
 {
+    if (planners_.empty())
+        return {};
+
     return planners_.front()->getPlannerConfigs();
 }
 
+///
+/// PortfolioPlanner
+///
+
+namespace
+{
+    /** \brief The shared state of the members racing in one PortfolioPlanner::plan(). */
+    struct Race
+    {
+        std::mutex mutex;                                               ///< Guards the race.
+        std::condition_variable cv;                                     ///< Notified when a member ends.
+        std::vector<planning_interface::MotionPlanResponse> responses;  ///< Responses, by member.
+        std::vector<std::size_t> finished;                              ///< Members in order of finishing.
+        std::atomic<bool> decided{false};  ///< Set once a result is chosen, later members do not plan.
+    };
+
+    /** \brief How long a decided race waits for its other members to stop, in seconds. */
+    const double STOP_TIMEOUT = 1.;
+
+    /** \brief How often members that have not stopped yet are terminated again, in seconds. */
+    const double STOP_INTERVAL = 0.01;
+
+    bool isSuccess(const planning_interface::MotionPlanResponse &response)
+    {
+        return response.error_code_.val == moveit_msgs::MoveItErrorCodes::SUCCESS and response.trajectory_;
+    }
+}  // namespace
+
+PortfolioPlanner::PortfolioPlanner(const RobotPtr &robot, unsigned int n, const std::string &name)
+  : Planner(robot, name), pool_(n)
+{
+}
+
+PortfolioPlanner::~PortfolioPlanner()
+{
+    waitForMembers();
+}
+
+void PortfolioPlanner::addPlanner(const PlannerPtr &planner, const std::string &config)
+{
+    members_.push_back({planner, config});
+}
+
+void PortfolioPlanner::setMode(Mode mode)
+{
+    mode_ = mode;
+}
+
+int PortfolioPlanner::getLastWinner() const
+{
+    return winner_;
+}
+
+planning_interface::MotionPlanRequest
+PortfolioPlanner::getMemberRequest(const Member &member, const planning_interface::MotionPlanRequest &request)
+{
+    auto member_request = request;
+    if (not member.config.empty())
+        member_request.planner_id = member.config;
+
+    return member_request;
+}
+
+void PortfolioPlanner::waitForMembers()
+{
+    for (const auto &job : jobs_)
+        job->wait();
+
+    jobs_.clear();
+}
+
+planning_interface::MotionPlanResponse
+PortfolioPlanner::plan(const SceneConstPtr &scene, const planning_interface::MotionPlanRequest &request)
+{
+    // Members still stopping from the last plan must not be used concurrently.
+    waitForMembers();
+    winner_ = -1;
+
+    planning_interface::MotionPlanResponse response;
+    if (members_.empty())
+    {
+        RBX_ERROR("PortfolioPlanner has no members to plan with!");
+        response.error_code_.val = moveit_msgs::MoveItErrorCodes::FAILURE;
+        return response;
+    }
+
+    // Shared with the member jobs, as members that are stopping outlive this call.
+    auto race = std::make_shared<Race>();
+    race->responses.resize(members_.size());
+
+    for (std::size_t i = 0; i < members_.size(); ++i)
+    {
+        const auto planner = members_[i].planner;
+        const auto member_request = getMemberRequest(members_[i], request);
+
+        jobs_.emplace_back(pool_.submit(make_function([race, planner, scene, member_request, i] {
+            // A member that starts once the race is decided would only be terminated.
+            planning_interface::MotionPlanResponse member_response;
+            if (race->decided)
+                member_response.error_code_.val = moveit_msgs::MoveItErrorCodes::PREEMPTED;
+            else
+                member_response = planner->plan(scene, member_request);
+
+            {
+                std::unique_lock<std::mutex> lock(race->mutex);
+                race->responses[i] = member_response;
+                race->finished.emplace_back(i);
+            }
+
+            race->cv.notify_all();
+            return member_response;
+        })));
+    }
+
+    const auto is_decided = [&] {
+        if (race->finished.size() == members_.size())
+            return true;
+
+        return mode_ == FIRST and std::any_of(race->finished.begin(), race->finished.end(),
+                                              [&](std::size_t i) { return isSuccess(race->responses[i]); });
+    };
+
+    std::unique_lock<std::mutex> lock(race->mutex);
+    if (request.allowed_planning_time > 0)
+    {
+        const auto budget = std::chrono::duration<double>(request.allowed_planning_time);
+        race->cv.wait_for(lock, budget, is_decided);
+    }
+    else
+        race->cv.wait(lock, is_decided);
+
+    // Stop the members that are not needed. Canceling first keeps queued members from starting.
+    race->decided = true;
+    lock.unlock();
+    for (const auto &job : jobs_)
+        job->cancel();
+
+    // A member that began before the race was decided but has not started solving yet misses terminate(),
+    // so terminate members again until all have stopped. Members still running after that are waited on
+    // before the next plan.
+    const auto until = std::chrono::steady_clock::now() + std::chrono::duration<double>(STOP_TIMEOUT);
+    for (bool stopped = false; not stopped and std::chrono::steady_clock::now() < until;)
+    {
+        stopped = true;
+        for (std::size_t i = 0; i < members_.size(); ++i)
+            if (not jobs_[i]->isDone())
+            {
+                members_[i].planner->terminate();
+                stopped = false;
+            }
+
+        if (not stopped)
+        {
+            std::unique_lock<std::mutex> stop_lock(race->mutex);
+            race->cv.wait_for(stop_lock, std::chrono::duration<double>(STOP_INTERVAL));
+        }
+    }
+    lock.lock();
+
+    // Over budget without a solution, so wait for the terminated members to give up what they have.
+    const auto has_success = [&] {
+        return std::any_of(race->finished.begin(), race->finished.end(),
+                           [&](std::size_t i) { return isSuccess(race->responses[i]); });
+    };
+
+    if (not has_success())
+    {
+        lock.unlock();
+        waitForMembers();
+        lock.lock();
+    }
+
+    double best = std::numeric_limits<double>::infinity();
+    for (const auto &i : race->finished)
+    {
+        const auto &member_response = race->responses[i];
+        if (not isSuccess(member_response))
+            continue;
+
+        if (mode_ == FIRST)
+        {
+            winner_ = i;
+            break;
+        }
+
+        const double length = Trajectory(member_response.trajectory_).getLength();
+        if (length < best)
+        {
+            best = length;
+            winner_ = i;
+        }
+    }
+
+    if (winner_ >= 0)
+        return race->responses[winner_];
+
+    if (not race->finished.empty())
+        return race->responses[race->finished.back()];
+
+    response.error_code_.val = moveit_msgs::MoveItErrorCodes::FAILURE;
+    return response;
+}
+
+bool PortfolioPlanner::terminate()
+{
+    bool r = false;
+    for (const auto &member : members_)
+        r |= member.planner->terminate();
+
+    return r;
+}
+
+void PortfolioPlanner::clearCaches()
+{
+    for (const auto &member : members_)
+        member.planner->clearCaches();
+}
+
+void PortfolioPlanner::preRun(const SceneConstPtr &scene,
+                              const planning_interface::MotionPlanRequest &request)
+{
+    for (const auto &member : members_)
+        member.planner->preRun(scene, getMemberRequest(member, request));
+}
+
+std::vector<std::string> PortfolioPlanner::getPlannerConfigs() const
+{
+    std::vector<std::string> configs;
+    for (const auto &member : members_)
+        if (not member.config.empty())
+            configs.emplace_back(member.config);
+
+    if (configs.empty() and not members_.empty())
+        return members_.front().planner->getPlannerConfigs();
+
+    return configs;
+}
+
+///
+/// CachingPlanner
+///
+
+namespace
+{
+    /** \brief Copy a response, including the waypoints of its trajectory, so the copy can be modified
+     *  without changing the original. */
+    planning_interface::MotionPlanResponse
+    copyResponse(const planning_interface::MotionPlanResponse &response)
+    {
+        planning_interface::MotionPlanResponse copy(response);
+        if (response.trajectory_)
+        {
+            const auto &original = *response.trajectory_;
+            copy.trajectory_ = std::make_shared<robot_trajectory::RobotTrajectory>(original.getRobotModel(),
+                                                                                   original.getGroupName());
+            for (std::size_t i = 0; i < original.getWayPointCount(); ++i)
+                copy.trajectory_->addSuffixWayPoint(original.getWayPoint(i),
+                                                    original.getWayPointDurationFromPrevious(i));
+        }
+
+        return copy;
+    }
+}  // namespace
+
+CachingPlanner::CachingPlanner(const PlannerPtr &planner, std::size_t capacity, bool persistent,
+                               const std::string &name)
+  : Planner(planner->getRobot(), name), planner_(planner), capacity_(capacity), persistent_(persistent)
+{
+}
+
+planning_interface::MotionPlanResponse
+CachingPlanner::plan(const SceneConstPtr &scene, const planning_interface::MotionPlanRequest &request)
+{
+    ros::WallTime start = ros::WallTime::now();
+    const std::string key = getKey(scene, request);
+
+    planning_interface::MotionPlanResponse response;
+    bool found = false;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto it = index_.find(key);
+        if (it != index_.end())
+        {
+            entries_.splice(entries_.begin(), entries_, it->second);
+            response = copyResponse(it->second->response);
+            found = true;
+        }
+    }
+
+    // The stored trajectory may have become invalid, e.g., if the scene was not identified by version.
+    if (found and Trajectory(response.trajectory_).isCollisionFree(scene))
+    {
+        response.planning_time_ = (ros::WallTime::now() - start).toSec();
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        ++hits_;
+        metrics_ = {{"cache_hit", 1.}, {"cache_hit_rate", double(hits_) / double(hits_ + misses_)}};
+        return response;
+    }
+
+    response = planner_->plan(scene, request);
+    const auto &metrics = planner_->getLastPlanMetrics();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (found)
+    {
+        auto it = index_.find(key);
+        if (it != index_.end())
+        {
+            entries_.erase(it->second);
+            index_.erase(it);
+        }
+    }
+
+    if (response.error_code_.val == moveit_msgs::MoveItErrorCodes::SUCCESS and response.trajectory_)
+        insert(key, copyResponse(response));
+
+    ++misses_;
+    metrics_ = metrics;
+    metrics_["cache_hit"] = 0.;
+    metrics_["cache_hit_rate"] = double(hits_) / double(hits_ + misses_);
+    return response;
+}
+
+bool CachingPlanner::terminate()
+{
+    return planner_->terminate();
+}
+
+void CachingPlanner::clearCaches()
+{
+    clear();
+    planner_->clearCaches();
+}
+
+std::vector<std::string> CachingPlanner::getPlannerConfigs() const
+{
+    return planner_->getPlannerConfigs();
+}
+
+std::map<std::string, Planner::ProgressProperty> CachingPlanner::getProgressProperties(
+    const SceneConstPtr &scene, const planning_interface::MotionPlanRequest &request) const
+{
+    return planner_->getProgressProperties(scene, request);
+}
+
+std::map<std::string, double> CachingPlanner::getLastPlanMetrics() const
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    return metrics_;
+}
+
+void CachingPlanner::preRun(const SceneConstPtr &scene, const planning_interface::MotionPlanRequest &request)
+{
+    planner_->preRun(scene, request);
+}
+
+void CachingPlanner::setCapacity(std::size_t capacity)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    capacity_ = capacity;
+    while (entries_.size() > capacity_)
+    {
+        index_.erase(entries_.back().key);
+        entries_.pop_back();
+    }
+}
+
+void CachingPlanner::clear()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    entries_.clear();
+    index_.clear();
+    hits_ = 0;
+    misses_ = 0;
+}
+
+std::size_t CachingPlanner::getHits() const
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    return hits_;
+}
+
+std::size_t CachingPlanner::getMisses() const
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    return misses_;
+}
+
+double CachingPlanner::getHitRate() const
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    const std::size_t total = hits_ + misses_;
+    return (total) ? double(hits_) / double(total) : 0.;
+}
+
+bool CachingPlanner::save(const std::string &filename) const
+{
+    if (not persistent_)
+    {
+        RBX_ERROR("Only persistent caches can be saved!");
+        return false;
+    }
+
+    IO::Bag bag(filename, IO::Bag::WRITE);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    // Save least recently used first, so loading restores the order.
+    for (auto it = entries_.rbegin(); it != entries_.rend(); ++it)
+    {
+        std_msgs::String key;
+        key.data = it->key;
+
+        moveit_msgs::MotionPlanResponse msg;
+        it->response.getMessage(msg);
+
+        if (not bag.addMessage("keys", key) or not bag.addMessage("responses", msg))
+            return false;
+    }
+
+    return true;
+}
+
+bool CachingPlanner::load(const std::string &filename)
+{
+    if (not persistent_)
+    {
+        RBX_ERROR("Only persistent caches can be loaded!");
+        return false;
+    }
+
+    IO::Bag bag(filename, IO::Bag::READ);
+    const auto &keys = bag.getMessages<std_msgs::String>({"keys"});
+    const auto &msgs = bag.getMessages<moveit_msgs::MotionPlanResponse>({"responses"});
+
+    if (keys.size() != msgs.size())
+    {
+        RBX_ERROR("Cache file `%s` has %d keys but %d responses!", filename, keys.size(), msgs.size());
+        return false;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (std::size_t i = 0; i < keys.size(); ++i)
+    {
+        const auto &msg = msgs[i];
+
+        auto state = robot_->leaseState();
+        moveit::core::robotStateMsgToRobotState(msg.trajectory_start, *state);
+
+        planning_interface::MotionPlanResponse response;
+        response.trajectory_ =
+            std::make_shared<robot_trajectory::RobotTrajectory>(robot_->getModelConst(), msg.group_name);
+        response.trajectory_->setRobotTrajectoryMsg(*state, msg.trajectory);
+        response.planning_time_ = msg.planning_time;
+        response.error_code_.val = msg.error_code.val;
+
+        insert(keys[i].data, response);
+    }
+
+    return true;
+}
+
+std::string CachingPlanner::getKey(const SceneConstPtr &scene,
+                                   const planning_interface::MotionPlanRequest &request)
+{
+    const auto &scene_id = scene->getKey();
+    const std::string scene_key = std::to_string(scene_id.first) + ":" + std::to_string(scene_id.second);
+
+    if (not persistent_)
+    {
+        // Requests owned by a builder are identified by its ID and version, which avoids serializing them.
+        ID::Key key;
+        const std::string request_hash = (MotionRequestBuilder::getFingerprint(request, key)) ?
+                                             std::to_string(key.first) + ":" + std::to_string(key.second) :
+                                             IO::getMessageHash(request);
+        return scene_key + "/" + request_hash;
+    }
+
+    // Scenes cache the hash of each version, so unchanged scenes are only hashed once.
+    return scene->getMessageHash() + "/" + IO::getMessageHash(request);
+}
+
+void CachingPlanner::insert(const std::string &key, const planning_interface::MotionPlanResponse &response)
+{
+    if (capacity_ == 0)
+        return;
+
+    auto it = index_.find(key);
+    if (it != index_.end())
+    {
+        entries_.erase(it->second);
+        index_.erase(it);
+    }
+
+    entries_.push_front({key, response});
+    index_[key] = entries_.begin();
+
+    while (entries_.size() > capacity_)
+    {
+        index_.erase(entries_.back().key);
+        entries_.pop_back();
+    }
+}
+
 ///
 /// SimpleCartesianPlanner
 ///
@@ -137,7 +829,7 @@ SimpleCartesianPlanner::plan(const SceneConstPtr &scene, const planning_interfac
     query.scene = scene;
 
     // Get starting state
-    auto state = robot_->allocState();
+    auto state = robot_->leaseState();
     moveit::core::robotStateMsgToRobotState(request.start_state, *state);
 
     return plan(*state, query);
@@ -146,6 +838,9 @@ SimpleCartesianPlanner::plan(const SceneConstPtr &scene, const planning_interfac
 planning_interface::MotionPlanResponse SimpleCartesianPlanner::plan(const robot_state::RobotState &start,
                                                                     const Robot::IKQuery &request)
 {
+    if (pool_)
+        return plan(start, request, *pool_);
+
     planning_interface::MotionPlanResponse response;
     if (request.tips.size() > 1)
     {
@@ -173,46 +868,284 @@ planning_interface::MotionPlanResponse SimpleCartesianPlanner::plan(const robot_
     const auto &jmg = model->getJointModelGroup(request.group);
     const auto &lm = model->getLinkModel(tip);
 
-    moveit::core::GroupStateValidityCallbackFn gsvcf;
-    if (request.scene)
-        gsvcf = request.scene->getGSVCF(false);
+    moveit::core::GroupStateValidityCallbackFn gsvcf;
+    if (request.scene)
+        gsvcf = request.scene->getGSVCF(false);
+
+    std::vector<robot_state::RobotStatePtr> traj;
+
+    double time = 0;
+    bool success = false;
+    ros::WallTime start_time = ros::WallTime::now();
+
+    for (std::size_t i = 0;                                             //
+         not success                                                    //
+         and ((request.attempts) ? i < request.attempts : true)         //
+         and ((request.timeout > 0.) ? time < request.timeout : true);  //
+         ++i)
+    {
+        RobotPose pose;
+        request.sampleRegion(pose, 0);
+
+        success = computeAttempt(start, jmg, lm, pose, gsvcf, traj);
+        time = (ros::WallTime::now() - start_time).toSec();
+    }
+
+    return getResponse(request.group, traj, success, time);
+}
+
+planning_interface::MotionPlanResponse SimpleCartesianPlanner::plan(const robot_state::RobotState &start,
+                                                                    const Robot::IKQuery &request,
+                                                                    const Pool &pool)
+{
+    planning_interface::MotionPlanResponse response;
+    if (request.tips.size() > 1)
+    {
+        RBX_ERROR("SimpleCartesianPlanner only supports queries with a single goal!");
+        response.error_code_.val = moveit_msgs::MoveItErrorCodes::INVALID_GOAL_CONSTRAINTS;
+        return response;
+    }
+
+    std::string tip = request.tips[0];
+    if (tip.empty())
+    {
+        const auto &tips = robot_->getSolverTipFrames(request.group);
+        if (tips.size() == 1)
+            tip = tips[0];
+        else
+        {
+            RBX_ERROR("Request needs tip frame name!");
+            response.error_code_.val = moveit_msgs::MoveItErrorCodes::INVALID_GOAL_CONSTRAINTS;
+            return response;
+        }
+    }
+
+    const auto &model = robot_->getModelConst();
+    const auto &jmg = model->getJointModelGroup(request.group);
+    const auto &lm = model->getLinkModel(tip);
+
+    // Validity checkers are safe to share between threads.
+    moveit::core::GroupStateValidityCallbackFn gsvcf;
+    if (request.scene)
+        gsvcf = request.scene->getValidityChecker(false)->getGSVCF();
+
+    // Without an attempt limit, run rounds of attempts until success or timeout.
+    const std::size_t round = (request.attempts) ? request.attempts : pool.getThreadCount();
+
+    std::vector<robot_state::RobotStatePtr> traj;
+
+    double time = 0;
+    bool success = false;
+    ros::WallTime start_time = ros::WallTime::now();
+
+    while (not success and ((request.timeout > 0.) ? time < request.timeout : true))
+    {
+        // Region samplers are not thread-safe, so sample all targets here.
+        std::vector<RobotPoseVector> targets;
+        request.sampleRegions(targets, round);
+
+        // Attempts with an index at or above the limit no longer matter and are skipped.
+        std::atomic<std::size_t> limit(round);
+        std::vector<std::vector<robot_state::RobotStatePtr>> trajs(round);
+
+        pool.parallelFor(
+            0, round,
+            [&](std::size_t i) {
+                if (i >= limit)
+                    return;
+
+                if (request.timeout > 0. and (ros::WallTime::now() - start_time).toSec() > request.timeout)
+                    return;
+
+                if (not computeAttempt(start, jmg, lm, targets[i][0], gsvcf, trajs[i]))
+                    return;
+
+                // Only earlier attempts can change the result now.
+                std::size_t current = limit;
+                while (i < current and not limit.compare_exchange_weak(current, i))
+                    ;
+            },
+            1);
+
+        time = (ros::WallTime::now() - start_time).toSec();
+
+        // On failure, keep the partial path of the last attempt, as the serial plan does.
+        success = limit < round;
+        traj = std::move(trajs[(success) ? limit.load() : round - 1]);
+
+        if (request.attempts)
+            break;
+    }
+
+    return getResponse(request.group, traj, success, time);
+}
+
+bool SimpleCartesianPlanner::computeAttempt(const robot_state::RobotState &start,
+                                            const robot_model::JointModelGroup *jmg,
+                                            const robot_model::LinkModel *lm, const RobotPose &pose,
+                                            const moveit::core::GroupStateValidityCallbackFn &gsvcf,
+                                            std::vector<robot_state::RobotStatePtr> &traj) const
+{
+    Robot::StateLease state(start.getRobotModel());
+    *state = start;
+
+    if (adaptive_)
+    {
+        traj.clear();
+        state->update();
+        traj.emplace_back(std::make_shared<robot_state::RobotState>(*state));
+
+        const RobotPose from_pose = state->getGlobalLinkTransform(lm);
+        const double distance = (pose.translation() - from_pose.translation()).norm();
+        const double angle = Eigen::Quaterniond(from_pose.rotation())  //
+                                 .angularDistance(Eigen::Quaterniond(pose.rotation()));
+
+        // Number of steps of the fixed step interpolation, split into segments of up to factor_ steps.
+        const double steps =
+            std::max({1., std::ceil(distance / max_step_pos_), std::ceil(angle / max_step_rot_)});
+        const std::size_t segments = std::ceil(steps / factor_);
+        const unsigned int depth = std::ceil(std::log2(std::min<double>(steps, factor_)));
+
+        RobotPose last_pose = from_pose;
+        for (std::size_t i = 1; i <= segments; ++i)
+        {
+            const double t = double(i) / segments;
+            RobotPose next_pose = pose;
+            next_pose.translation() =
+                from_pose.translation() + t * (pose.translation() - from_pose.translation());
+            next_pose.linear() = Eigen::Quaterniond(from_pose.rotation())
+                                     .slerp(t, Eigen::Quaterniond(pose.rotation()))
+                                     .toRotationMatrix();
+
+            if (not interpolateSegment(*traj.back(), last_pose, next_pose, jmg, lm, gsvcf, depth, traj))
+                return false;
+
+            last_pose = next_pose;
+        }
+
+        return true;
+    }
+
+    moveit::core::MaxEEFStep step(max_step_pos_, max_step_rot_);
+    moveit::core::JumpThreshold jump(jump_threshold_rev_, jump_threshold_pri_);
+
+#if ROBOWFLEX_HAS_CARTESIAN_INTERPOLATOR
+    double percentage =                                             //
+        moveit::core::CartesianInterpolator::computeCartesianPath(  //
+            &*state, jmg, traj, lm, pose, true, step, jump, gsvcf);
+#else
+    double percentage =               //
+        state->computeCartesianPath(  //
+            jmg, traj, lm, pose, true, step, jump, gsvcf);
+#endif
+
+    // Check if successful, output is percent of path computed.
+    return std::fabs(percentage - 1.) < constants::eps;
+}
+
+bool SimpleCartesianPlanner::interpolateSegment(const robot_state::RobotState &from,
+                                                const RobotPose &from_pose, const RobotPose &to_pose,
+                                                const robot_model::JointModelGroup *jmg,
+                                                const robot_model::LinkModel *lm,
+                                                const moveit::core::GroupStateValidityCallbackFn &gsvcf,
+                                                unsigned int depth,
+                                                std::vector<robot_state::RobotStatePtr> &traj) const
+{
+    // Solve IK for the end of the segment, seeded from its start.
+    auto to = std::make_shared<robot_state::RobotState>(from);
+#if ROBOWFLEX_AT_LEAST_MELODIC
+    const bool solved = to->setFromIK(jmg, to_pose, lm->getName(), 0., gsvcf);
+#else
+    const bool solved = to->setFromIK(jmg, to_pose, lm->getName(), 1, 0., gsvcf);
+#endif
+
+    if (solved)
+    {
+        to->update();
+        if (isSegmentValid(from, *to, from_pose, to_pose, jmg, lm, gsvcf))
+        {
+            traj.emplace_back(to);
+            return true;
+        }
+    }
+
+    // Segment is already at the maximum step size.
+    if (depth == 0)
+        return false;
 
-    std::vector<robot_state::RobotStatePtr> traj;
+    RobotPose mid_pose = to_pose;
+    mid_pose.translation() = (from_pose.translation() + to_pose.translation()) / 2.;
+    mid_pose.linear() = Eigen::Quaterniond(from_pose.rotation())
+                            .slerp(0.5, Eigen::Quaterniond(to_pose.rotation()))
+                            .toRotationMatrix();
 
-    moveit::core::MaxEEFStep step(max_step_pos_, max_step_rot_);
-    moveit::core::JumpThreshold jump(jump_threshold_rev_, jump_threshold_pri_);
+    if (not interpolateSegment(from, from_pose, mid_pose, jmg, lm, gsvcf, depth - 1, traj))
+        return false;
 
-    double time = 0;
-    bool success = false;
-    ros::WallTime start_time = ros::WallTime::now();
+    return interpolateSegment(*traj.back(), mid_pose, to_pose, jmg, lm, gsvcf, depth - 1, traj);
+}
 
-    for (std::size_t i = 0;                                             //
-         not success                                                    //
-         and ((request.attempts) ? i < request.attempts : true)         //
-         and ((request.timeout > 0.) ? time < request.timeout : true);  //
-         ++i)
+bool SimpleCartesianPlanner::isSegmentValid(const robot_state::RobotState &from,
+                                            const robot_state::RobotState &to, const RobotPose &from_pose,
+                                            const RobotPose &to_pose, const robot_model::JointModelGroup *jmg,
+                                            const robot_model::LinkModel *lm,
+                                            const moveit::core::GroupStateValidityCallbackFn &gsvcf) const
+{
+    // Check the jump threshold of each joint, as MoveIt's absolute jump threshold does.
+    for (const auto &joint : jmg->getActiveJointModels())
     {
-        auto state = start;
-
-        RobotPose pose;
-        request.sampleRegion(pose, 0);
+        const auto type = joint->getType();
+        const double threshold = (type == robot_model::JointModel::REVOLUTE)  ? jump_threshold_rev_ :
+                                 (type == robot_model::JointModel::PRISMATIC) ? jump_threshold_pri_ :
+                                                                                0.;
+        if (threshold > 0. and
+            joint->distance(from.getJointPositions(joint), to.getJointPositions(joint)) > threshold)
+            return false;
+    }
 
-#if ROBOWFLEX_HAS_CARTESIAN_INTERPOLATOR
-        double percentage =                                             //
-            moveit::core::CartesianInterpolator::computeCartesianPath(  //
-                &state, jmg, traj, lm, pose, true, step, jump, gsvcf);
-#else
-        double percentage =              //
-            state.computeCartesianPath(  //
-                jmg, traj, lm, pose, true, step, jump, gsvcf);
-#endif
+    // Check intermediate states at the resolution of the maximum step.
+    const double distance = (to_pose.translation() - from_pose.translation()).norm();
+    const Eigen::Quaterniond from_rotation(from_pose.rotation());
+    const Eigen::Quaterniond to_rotation(to_pose.rotation());
+    const double angle = from_rotation.angularDistance(to_rotation);
+    const std::size_t steps = std::max(std::ceil(distance / max_step_pos_), std::ceil(angle / max_step_rot_));
 
-        // Check if successful, output is percent of path computed.
-        success = std::fabs(percentage - 1.) < constants::eps;
-        time = (ros::WallTime::now() - start_time).toSec();
+    robot_state::RobotState state(from);
+    std::vector<double> values;
+    for (std::size_t i = 1; i < steps; ++i)
+    {
+        const double t = double(i) / steps;
+        from.interpolate(to, t, state, jmg);
+        state.update();
+
+        // The end-effector must stay within a step of the Cartesian line.
+        const RobotPose &pose = state.getGlobalLinkTransform(lm);
+        const Eigen::Vector3d line =
+            from_pose.translation() + t * (to_pose.translation() - from_pose.translation());
+        if ((pose.translation() - line).norm() > max_step_pos_ or
+            Eigen::Quaterniond(pose.rotation()).angularDistance(from_rotation.slerp(t, to_rotation)) >
+                max_step_rot_)
+            return false;
+
+        if (gsvcf)
+        {
+            state.copyJointGroupPositions(jmg, values);
+            if (not gsvcf(&state, jmg, values.data()))
+                return false;
+        }
     }
 
-    Trajectory output(robot_, request.group);
+    return true;
+}
+
+planning_interface::MotionPlanResponse
+SimpleCartesianPlanner::getResponse(const std::string &group,
+                                    const std::vector<robot_state::RobotStatePtr> &traj, bool success,
+                                    double time) const
+{
+    planning_interface::MotionPlanResponse response;
+
+    Trajectory output(robot_, group);
     for (const auto &state : traj)
         output.addSuffixWaypoint(*state);
 
@@ -241,6 +1174,17 @@ void SimpleCartesianPlanner::setJumpThreshold(double prismatic, double revolute)
     jump_threshold_rev_ = revolute;
 }
 
+void SimpleCartesianPlanner::setAdaptiveStep(bool adaptive, unsigned int factor)
+{
+    adaptive_ = adaptive;
+    factor_ = std::max(factor, 1u);
+}
+
+void SimpleCartesianPlanner::setPool(const PoolPtr &pool)
+{
+    pool_ = pool;
+}
+
 std::vector<std::string> SimpleCartesianPlanner::getPlannerConfigs() const
 {
     return std::vector<std::string>{"cartesian"};
@@ -258,12 +1202,237 @@ planning_interface::MotionPlanResponse
 PipelinePlanner::plan(const SceneConstPtr &scene, const planning_interface::MotionPlanRequest &request)
 {
     planning_interface::MotionPlanResponse response;
-    if (pipeline_)
+    metrics_.clear();
+
+    if (not pipeline_)
+        return response;
+
+    // Without the adapters, plan through the pipeline as is and forgo timing each stage.
+    if (not loadAdapters())
+    {
         pipeline_->generatePlan(scene->getSceneConst(), request, response);
+        return response;
+    }
+
+    const auto &ps = scene->getSceneConst();
+    std::vector<std::vector<std::size_t>> added(adapters_.size());
+    std::vector<double> times(adapters_.size() + 1, 0.);
+
+    bool solved = false;
+    try
+    {
+        solved = callStage(0, scene, ps, request, response, added, times);
+    }
+    catch (std::exception &e)
+    {
+        RBX_ERROR("Exception caught: `%s`", e.what());
+        response.error_code_.val = moveit_msgs::MoveItErrorCodes::FAILURE;
+        return response;
+    }
+
+    // Each stage's time includes the stages it calls, so subtract those.
+    for (std::size_t i = 0; i < adapters_.size(); ++i)
+        metrics_["pipeline_" + stages_[i] + "_time"] = times[i] - times[i + 1];
+    metrics_["pipeline_planner_time"] = times.back();
+
+    if (solved and response.trajectory_ and pipeline_->getCheckSolutionPaths())
+    {
+        ros::WallTime start = ros::WallTime::now();
+
+        // As in MoveIt, indices added by an adapter are shifted by the states added by later adapters.
+        std::vector<std::size_t> added_index;
+        for (std::size_t i = 0; i < added.size(); ++i)
+            for (auto index : added[i])
+            {
+                for (std::size_t j = i + 1; j < added.size(); ++j)
+                    for (auto other : added[j])
+                        if (other <= index)
+                            ++index;
+
+                added_index.emplace_back(index);
+            }
+
+        // Invalid states that were added by adapters are tolerated, as in MoveIt.
+        std::vector<std::size_t> index;
+        if (not ps->isPathValid(*response.trajectory_, request.path_constraints, request.group_name, false,
+                                &index))
+        {
+            const auto is_added = [&](std::size_t i) {
+                return std::find(added_index.begin(), added_index.end(), i) != added_index.end();
+            };
+
+            if (not std::all_of(index.begin(), index.end(), is_added))
+            {
+                RBX_ERROR("Computed path is not valid!");
+                response.error_code_.val = moveit_msgs::MoveItErrorCodes::INVALID_MOTION_PLAN;
+            }
+        }
+
+        metrics_["pipeline_check_time"] = (ros::WallTime::now() - start).toSec();
+    }
 
     return response;
 }
 
+bool PipelinePlanner::terminate()
+{
+    if (not pipeline_)
+        return false;
+
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (running_)
+            running_->terminate();
+    }
+
+    pipeline_->terminate();
+    return true;
+}
+
+void PipelinePlanner::clearCaches()
+{
+    clearContextCache();
+}
+
+void PipelinePlanner::setContextCacheCapacity(std::size_t capacity)
+{
+    capacity_ = capacity;
+    while (contexts_.size() > capacity_)
+        contexts_.pop_back();
+}
+
+void PipelinePlanner::clearContextCache()
+{
+    contexts_.clear();
+}
+
+std::map<std::string, double> PipelinePlanner::getLastPlanMetrics() const
+{
+    return metrics_;
+}
+
+bool PipelinePlanner::loadAdapters()
+{
+    if (loaded_ == pipeline_)
+        return not stages_.empty() or pipeline_->getAdapterPluginNames().empty();
+
+    // Contexts and adapters belong to the previous pipeline.
+    loaded_ = pipeline_;
+    adapters_.clear();
+    stages_.clear();
+    contexts_.clear();
+
+    std::vector<planning_request_adapter::PlanningRequestAdapterConstPtr> adapters;
+    std::vector<std::string> stages;
+    for (const auto &name : pipeline_->getAdapterPluginNames())
+    {
+        auto adapter = IO::PluginManager::load<planning_request_adapter::PlanningRequestAdapter>(  //
+            "moveit_core", name);
+        if (not adapter)
+        {
+            RBX_WARN("Failed to load adapter `%s`, stages of the pipeline will not be timed.", name);
+            return false;
+        }
+
+#if ROBOWFLEX_AT_LEAST_MELODIC
+        adapter->initialize(handler_.getHandle());
+#endif
+
+        adapters.emplace_back(adapter);
+        stages.emplace_back(name.substr(name.find_last_of('/') + 1));
+    }
+
+    adapters_ = adapters;
+    stages_ = stages;
+    return true;
+}
+
+bool PipelinePlanner::callStage(std::size_t index, const SceneConstPtr &scene,
+                                const planning_scene::PlanningSceneConstPtr &ps,
+                                const planning_interface::MotionPlanRequest &request,
+                                planning_interface::MotionPlanResponse &response,
+                                std::vector<std::vector<std::size_t>> &added, std::vector<double> &times)
+{
+    ros::WallTime start = ros::WallTime::now();
+
+    bool solved;
+    if (index < adapters_.size())
+    {
+        const auto next = [&, index](const planning_scene::PlanningSceneConstPtr &next_ps,
+                                     const planning_interface::MotionPlanRequest &next_request,
+                                     planning_interface::MotionPlanResponse &next_response) {
+            return callStage(index + 1, scene, next_ps, next_request, next_response, added, times);
+        };
+
+        solved = adapters_[index]->adaptAndPlan(next, ps, request, response, added[index]);
+    }
+    else
+        solved = solve(scene, ps, request, response);
+
+    times[index] += (ros::WallTime::now() - start).toSec();
+    return solved;
+}
+
+bool PipelinePlanner::solve(const SceneConstPtr &scene, const planning_scene::PlanningSceneConstPtr &ps,
+                            const planning_interface::MotionPlanRequest &request,
+                            planning_interface::MotionPlanResponse &response)
+{
+    // Contexts are only reused for the scene itself, not for scenes adapters derived from it.
+    const bool cacheable = capacity_ > 0 and ps == scene->getSceneConst();
+    const auto &scene_id = scene->getKey();
+
+    ID::Key key;
+    const std::string request_hash =
+        (not cacheable) ? "" :
+        (MotionRequestBuilder::getFingerprint(request, key)) ?
+                          std::to_string(key.first) + ":" + std::to_string(key.second) :
+                          IO::getMessageHash(request);
+
+    planning_interface::PlanningContextPtr context;
+    if (cacheable)
+    {
+        for (auto it = contexts_.begin(); it != contexts_.end(); ++it)
+            if (it->request == request_hash and compareIDs(it->scene, scene_id))
+            {
+                contexts_.splice(contexts_.begin(), contexts_, it);
+                // Reused as configured, as clear() would drop its start, goal and validity checker.
+                context = it->context;
+                break;
+            }
+    }
+
+    if (not context)
+    {
+        context = pipeline_->getPlannerManager()->getPlanningContext(ps, request, response.error_code_);
+        if (not context)
+        {
+            RBX_ERROR("Context was not set!");
+            return false;
+        }
+
+        if (cacheable)
+        {
+            contexts_.push_front({scene_id, request_hash, context});
+            if (contexts_.size() > capacity_)
+                contexts_.pop_back();
+        }
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        running_ = context;
+    }
+
+    const bool solved = context->solve(response);
+
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        running_.reset();
+    }
+
+    return solved;
+}
+
 ///
 /// OMPL
 ///
@@ -293,6 +1462,101 @@ bool OMPL::loadOMPLConfig(IO::Handler &handler, const std::string &config_file,
     return true;
 }
 
+namespace
+{
+    /** \brief Convert a scalar parameter to a string, as _MoveIt!_'s OMPL interface does. */
+    bool paramToString(const XmlRpc::XmlRpcValue &param, std::string &value)
+    {
+        XmlRpc::XmlRpcValue copy(param);
+        switch (param.getType())
+        {
+            case XmlRpc::XmlRpcValue::TypeString:
+                value = std::string(copy);
+                return true;
+            case XmlRpc::XmlRpcValue::TypeDouble:
+                value = boost::lexical_cast<std::string>(double(copy));
+                return true;
+            case XmlRpc::XmlRpcValue::TypeInt:
+                value = std::to_string(int(copy));
+                return true;
+            case XmlRpc::XmlRpcValue::TypeBoolean:
+                value = boost::lexical_cast<std::string>(bool(copy));
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    /** \brief Read the parameters of planner configuration \a planner for \a group into \a pc. */
+    bool loadPlannerConfiguration(const IO::Handler &handler, const std::string &group,
+                                  const std::string &planner,
+                                  const std::map<std::string, std::string> &params,
+                                  planning_interface::PlannerConfigurationSettings &pc)
+    {
+        XmlRpc::XmlRpcValue config;
+        if (planner.empty() or not handler.getParam("planner_configs/" + planner, config) or
+            config.getType() != XmlRpc::XmlRpcValue::TypeStruct)
+            return false;
+
+        pc.name = group + "[" + planner + "]";
+        pc.group = group;
+        pc.config = params;
+
+        for (auto it = config.begin(); it != config.end(); ++it)
+        {
+            std::string value;
+            if (paramToString(it->second, value))
+                pc.config[it->first] = value;
+        }
+
+        return true;
+    }
+}  // namespace
+
+planning_interface::PlannerConfigurationMap
+OMPL::getPlannerConfigurations(const IO::Handler &handler, const robot_model::RobotModelConstPtr &model)
+{
+    static const std::vector<std::string> GROUP_PARAMS = {
+        "projection_evaluator", "longest_valid_segment_fraction", "enforce_joint_model_state_space"};
+
+    planning_interface::PlannerConfigurationMap pconfig;
+    for (const auto &group : model->getJointModelGroupNames())
+    {
+        // Parameters of the group are inherited by each of its planner configurations.
+        std::map<std::string, std::string> params;
+        for (const auto &key : GROUP_PARAMS)
+        {
+            XmlRpc::XmlRpcValue param;
+            std::string value;
+            if (handler.getParam(group + "/" + key, param) and paramToString(param, value) and
+                not value.empty())
+                params[key] = value;
+        }
+
+        std::string default_planner;
+        handler.getParam(group + "/default_planner_config", default_planner);
+
+        planning_interface::PlannerConfigurationSettings default_pc;
+        if (not loadPlannerConfiguration(handler, group, default_planner, params, default_pc))
+            default_pc.config = params;
+
+        default_pc.name = group;
+        default_pc.group = group;
+        pconfig[default_pc.name] = default_pc;
+
+        std::vector<std::string> planners;
+        handler.getParam(group + "/planner_configs", planners);
+        for (const auto &planner : planners)
+        {
+            planning_interface::PlannerConfigurationSettings pc;
+            if (loadPlannerConfiguration(handler, group, planner, params, pc))
+                pconfig[pc.name] = pc;
+        }
+    }
+
+    return pconfig;
+}
+
 ///
 /// OMPL::Settings
 ///
@@ -368,8 +1632,17 @@ bool OMPL::OMPLPipelinePlanner::initialize(const std::string &config_file, const
     handler_.setParam("request_adapters", ss.str());
     settings.setParam(handler_);
 
-    pipeline_.reset(new planning_pipeline::PlanningPipeline(robot_->getModelConst(), handler_.getHandle(),
-                                                            "planning_plugin", "request_adapters"));
+    if (handler_.pushesToMaster())
+        pipeline_.reset(new planning_pipeline::PlanningPipeline(robot_->getModelConst(), handler_.getHandle(),
+                                                                "planning_plugin", "request_adapters"));
+    else
+    {
+        // Without the ROS master, plugins are named directly and configurations are given to the planner.
+        pipeline_.reset(new planning_pipeline::PlanningPipeline(robot_->getModelConst(), handler_.getHandle(),
+                                                                plugin, adapters));
+        pipeline_->getPlannerManager()->setPlannerConfigurations(
+            OMPL::getPlannerConfigurations(handler_, robot_->getModelConst()));
+    }
 
     return true;
 }
@@ -532,6 +1805,243 @@ std::vector<std::string> opt::CHOMPPipelinePlanner::getPlannerConfigs() const
     return configs_;
 }
 
+///
+/// opt::CHOMPWarmStartPlanner
+///
+
+const std::string opt::CHOMPWarmStartPlanner::DEFAULT_ADAPTER("chomp/OptimizerAdapter");
+
+namespace
+{
+    /** \brief Number of points CHOMP discretizes a trajectory into. CHOMP samples seeds by waypoint
+     *  rather than interpolating them, so sparser seeds are interpolated up to this. */
+    constexpr unsigned int CHOMP_WAYPOINTS = 101;
+
+    /** \brief Offsets each joint of the interior waypoints of a trajectory by a random amount, scaled by
+     *  a sine profile over the path so the trajectory stays smooth and keeps its endpoints. */
+    void perturbTrajectory(robot_trajectory::RobotTrajectory &trajectory, double noise, unsigned int seed)
+    {
+        const auto &jmg = trajectory.getGroup();
+        const std::size_t n = trajectory.getWayPointCount();
+        if (n < 3)
+            return;
+
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<double> offset(-noise, noise);
+
+        std::vector<double> offsets(jmg->getVariableCount());
+        for (auto &value : offsets)
+            value = offset(rng);
+
+        std::vector<double> values;
+        for (std::size_t i = 1; i < n - 1; ++i)
+        {
+            const double scale = std::sin(constants::pi * double(i) / double(n - 1));
+
+            auto &state = trajectory.getWayPointPtr(i);
+            state->copyJointGroupPositions(jmg, values);
+            for (std::size_t j = 0; j < values.size(); ++j)
+                values[j] += scale * offsets[j];
+
+            state->setJointGroupPositions(jmg, values);
+            state->enforceBounds(jmg);
+            state->update();
+        }
+    }
+}  // namespace
+
+opt::CHOMPWarmStartPlanner::CHOMPWarmStartPlanner(const RobotPtr &robot, unsigned int n,
+                                                  const std::string &name)
+  : Planner(robot, name), pool_(n), restarts_(n)
+{
+}
+
+bool opt::CHOMPWarmStartPlanner::initialize(const CHOMPSettings &settings, const std::string &adapter)
+{
+    // Seeds are passed to CHOMP as the trajectory of the stage before it.
+    CHOMPSettings seeded(settings);
+    seeded.trajectory_initialization_method = "fillTrajectory";
+    seeded.setParam(handler_);
+
+    adapter_name_ = adapter;
+    adapters_.clear();
+
+    auto loaded = IO::PluginManager::load<planning_request_adapter::PlanningRequestAdapter>(  //
+        "moveit_core", adapter_name_);
+    if (not loaded)
+    {
+        RBX_ERROR("Failed to load CHOMP optimizer adapter `%s`", adapter_name_);
+        return false;
+    }
+
+#if ROBOWFLEX_AT_LEAST_MELODIC
+    loaded->initialize(handler_.getHandle());
+#endif
+
+    adapters_.emplace_back(loaded);
+    return true;
+}
+
+void opt::CHOMPWarmStartPlanner::setSeed(const TrajectoryConstPtr &seed)
+{
+    seed_ = seed;
+}
+
+void opt::CHOMPWarmStartPlanner::setRestarts(std::size_t restarts, double noise, unsigned int seed)
+{
+    restarts_ = std::max<std::size_t>(restarts, 1);
+    noise_ = noise;
+    random_seed_ = seed;
+}
+
+planning_interface::MotionPlanResponse opt::CHOMPWarmStartPlanner::plan(
+    const SceneConstPtr &scene, const planning_interface::MotionPlanRequest &request)
+{
+    planning_interface::MotionPlanResponse response;
+    response.error_code_.val = moveit_msgs::MoveItErrorCodes::FAILURE;
+
+    if (adapters_.empty())
+    {
+        RBX_ERROR("CHOMPWarmStartPlanner is not initialized!");
+        return response;
+    }
+
+    const auto &seed = getSeedTrajectory(scene, request);
+    if (not seed)
+        return response;
+
+    // Load an adapter for each restart beyond those already loaded.
+    while (adapters_.size() < restarts_)
+    {
+        auto loaded = IO::PluginManager::load<planning_request_adapter::PlanningRequestAdapter>(  //
+            "moveit_core", adapter_name_);
+        if (not loaded)
+            break;
+
+#if ROBOWFLEX_AT_LEAST_MELODIC
+        loaded->initialize(handler_.getHandle());
+#endif
+
+        adapters_.emplace_back(loaded);
+    }
+
+    const std::size_t restarts = std::min(restarts_, adapters_.size());
+    std::vector<planning_interface::MotionPlanResponse> responses(restarts);
+    terminate_ = false;
+
+    const auto &ps = scene->getSceneConst();
+    ros::WallTime start = ros::WallTime::now();
+
+    const auto run = [&](std::size_t i) {
+        if (terminate_ or (ros::WallTime::now() - start).toSec() > request.allowed_planning_time)
+            return;
+
+        // Each restart optimizes its own copy of the seed.
+        auto restart = std::make_shared<robot_trajectory::RobotTrajectory>(robot_->getModelConst(),
+                                                                           request.group_name);
+        const auto &waypoints = seed->getTrajectoryConst();
+        for (std::size_t j = 0; j < waypoints->getWayPointCount(); ++j)
+            restart->addSuffixWayPoint(waypoints->getWayPoint(j),
+                                       waypoints->getWayPointDurationFromPrevious(j));
+
+        if (i > 0)
+            perturbTrajectory(*restart, noise_, random_seed_ + i);
+
+        const auto seeded = [&restart](const planning_scene::PlanningSceneConstPtr & /*ps*/,
+                                       const planning_interface::MotionPlanRequest & /*request*/,
+                                       planning_interface::MotionPlanResponse &seeded_response) {
+            seeded_response.trajectory_ = restart;
+            seeded_response.error_code_.val = moveit_msgs::MoveItErrorCodes::SUCCESS;
+            return true;
+        };
+
+        std::vector<std::size_t> added;
+        try
+        {
+            adapters_[i]->adaptAndPlan(seeded, ps, request, responses[i], added);
+        }
+        catch (std::exception &e)
+        {
+            RBX_ERROR("Exception caught in restart %1%: `%2%`", i, e.what());
+            responses[i].error_code_.val = moveit_msgs::MoveItErrorCodes::FAILURE;
+        }
+    };
+
+    pool_.parallelFor(0, restarts, run, 1);
+
+    // Pick the shortest solution, preferring earlier restarts on ties.
+    double best = constants::inf;
+    for (std::size_t i = 0; i < restarts; ++i)
+    {
+        if (not isSuccess(responses[i]))
+            continue;
+
+        const double length = Trajectory(responses[i].trajectory_).getLength();
+        if (length < best)
+        {
+            best = length;
+            response = responses[i];
+        }
+    }
+
+    response.planning_time_ = (ros::WallTime::now() - start).toSec();
+    return response;
+}
+
+bool opt::CHOMPWarmStartPlanner::terminate()
+{
+    terminate_ = true;
+    return true;
+}
+
+std::vector<std::string> opt::CHOMPWarmStartPlanner::getPlannerConfigs() const
+{
+    return {"chomp"};
+}
+
+TrajectoryPtr
+opt::CHOMPWarmStartPlanner::getSeedTrajectory(const SceneConstPtr &scene,
+                                              const planning_interface::MotionPlanRequest &request) const
+{
+    auto trajectory = std::make_shared<Trajectory>(robot_, request.group_name);
+
+    if (seed_)
+    {
+        const auto &waypoints = seed_->getTrajectoryConst();
+        for (std::size_t i = 0; i < waypoints->getWayPointCount(); ++i)
+            trajectory->addSuffixWaypoint(waypoints->getWayPoint(i));
+    }
+    else
+    {
+        if (request.goal_constraints.size() != 1 or request.goal_constraints[0].joint_constraints.empty())
+        {
+            RBX_ERROR("CHOMPWarmStartPlanner requires a seed or a single joint goal!");
+            return nullptr;
+        }
+
+        // Straight line in joint space from the start to the goal.
+        robot_state::RobotState state(scene->getCurrentStateConst());
+        moveit::core::robotStateMsgToRobotState(request.start_state, state);
+        state.update();
+        trajectory->addSuffixWaypoint(state);
+
+        for (const auto &constraint : request.goal_constraints[0].joint_constraints)
+            state.setVariablePosition(constraint.joint_name, constraint.position);
+
+        state.update();
+        trajectory->addSuffixWaypoint(state);
+    }
+
+    if (trajectory->getNumWaypoints() < 2)
+    {
+        RBX_ERROR("Seed trajectory needs at least two waypoints!");
+        return nullptr;
+    }
+
+    trajectory->interpolate(CHOMP_WAYPOINTS);
+    return trajectory;
+}
+
 ///
 /// opt::TrajOptPipelinePlanner
 ///
@@ -1,9 +1,167 @@
 /* Author: Zachary Kingston */
 
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <robowflex_library/log.h>
 #include <robowflex_library/pool.h>
 
 using namespace robowflex;
 
+constexpr std::size_t Pool::PRIORITIES;
+
+namespace
+{
+    thread_local const Pool *current_pool = nullptr;  ///< Pool that owns the current thread, if any.
+    thread_local unsigned int current_index = 0;      ///< Index of the current thread in its pool.
+
+    /** \brief Parse a Linux CPU list, e.g., `0-3,8,10-11`.
+     *  \param[in] list The list.
+     *  \return The CPUs in the list.
+     */
+    std::vector<unsigned int> parseCPUList(const std::string &list)
+    {
+        std::vector<unsigned int> cpus;
+        std::istringstream ss(list);
+        std::string range;
+        while (std::getline(ss, range, ','))
+        {
+            if (range.empty())
+                continue;
+
+            const auto dash = range.find('-');
+            const unsigned int first = std::stoul(range.substr(0, dash));
+            const unsigned int last =
+                (dash == std::string::npos) ? first : std::stoul(range.substr(dash + 1));
+            for (unsigned int cpu = first; cpu <= last; ++cpu)
+                cpus.emplace_back(cpu);
+        }
+
+        return cpus;
+    }
+
+    /** \brief Get the CPUs of each NUMA node from sysfs. Nodes are assumed to be numbered contiguously.
+     *  \return The CPUs of each node, or empty if the machine does not report NUMA nodes.
+     */
+    const std::vector<std::vector<unsigned int>> &getNodeCPUs()
+    {
+        static const auto nodes = [] {
+            std::vector<std::vector<unsigned int>> nodes;
+            while (true)
+            {
+                const auto path = "/sys/devices/system/node/node" + std::to_string(nodes.size());
+                std::ifstream file(path + "/cpulist");
+
+                std::string list;
+                if (not std::getline(file, list))
+                    break;
+
+                nodes.emplace_back(parseCPUList(list));
+            }
+
+            return nodes;
+        }();
+
+        return nodes;
+    }
+
+    /** \brief Get the CPUs the calling thread is allowed to run on, grouped by NUMA node. Nodes without
+     *  allowed CPUs are skipped.
+     *  \return The allowed CPUs of each node.
+     */
+    std::vector<std::vector<unsigned int>> getAllowedCPUs()
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (sched_getaffinity(0, sizeof(set), &set) != 0)
+            return {};
+
+        auto nodes = getNodeCPUs();
+        if (nodes.empty())
+        {
+            nodes.emplace_back();
+            for (unsigned int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+                nodes[0].emplace_back(cpu);
+        }
+
+        std::vector<std::vector<unsigned int>> allowed;
+        for (const auto &node : nodes)
+        {
+            std::vector<unsigned int> cpus;
+            for (const auto cpu : node)
+                if (cpu < CPU_SETSIZE and CPU_ISSET(cpu, &set))
+                    cpus.emplace_back(cpu);
+
+            if (not cpus.empty())
+                allowed.emplace_back(std::move(cpus));
+        }
+
+        return allowed;
+    }
+
+    /** \brief Assign CPUs to the workers of a pool.
+     *  \param[in] affinity Placement policy.
+     *  \param[in] n Number of workers.
+     *  \return The CPU of each worker, or -1 if it is not pinned.
+     */
+    std::vector<int> assignCPUs(const Pool::Affinity &affinity, unsigned int n)
+    {
+        using Policy = Pool::Affinity::Policy;
+
+        std::vector<int> cpus(n, -1);
+        if (affinity.policy == Policy::NONE)
+            return cpus;
+
+        if (affinity.policy == Policy::LIST)
+        {
+            for (const auto cpu : affinity.cpus)
+                if (cpu >= CPU_SETSIZE)
+                {
+                    RBX_WARN("CPU %1% for pool affinity is out of range, workers are not pinned", cpu);
+                    return cpus;
+                }
+
+            if (affinity.cpus.empty())
+                RBX_WARN("No CPUs given for pool affinity, workers are not pinned");
+            else
+                for (unsigned int i = 0; i < n; ++i)
+                    cpus[i] = affinity.cpus[i % affinity.cpus.size()];
+
+            return cpus;
+        }
+
+        const auto &nodes = getAllowedCPUs();
+        if (nodes.empty())
+        {
+            RBX_WARN("Could not get allowed CPUs for pool affinity, workers are not pinned");
+            return cpus;
+        }
+
+        if (affinity.policy == Policy::COMPACT)
+        {
+            std::vector<unsigned int> order;
+            for (const auto &node : nodes)
+                order.insert(order.end(), node.begin(), node.end());
+
+            for (unsigned int i = 0; i < n; ++i)
+                cpus[i] = order[i % order.size()];
+        }
+        else
+            for (unsigned int i = 0; i < n; ++i)
+            {
+                const auto &node = nodes[i % nodes.size()];
+                cpus[i] = node[(i / nodes.size()) % node.size()];
+            }
+
+        return cpus;
+    }
+}  // namespace
+
 ///
 /// Joblet
 ///
@@ -18,19 +176,127 @@ bool Pool::Joblet::isCancled() const
     return canceled;
 }
 
+bool Pool::Joblet::isExpired() const
+{
+    return expired;
+}
+
+Pool::Priority Pool::Joblet::getPriority() const
+{
+    return priority_;
+}
+
+///
+/// Batch
+///
+
+Pool::Batch::Batch(const std::function<void(std::size_t)> &function, std::size_t begin, std::size_t end,
+                   std::size_t grain)
+  : function_(function)
+  , begin_(begin)
+  , end_(std::max(begin, end))
+  , grain_(grain)
+  , chunks_((end_ - begin_ + grain_ - 1) / grain_)
+  , future_(promise_.get_future().share())
+{
+    if (chunks_ == 0)
+    {
+        released_ = true;
+        promise_.set_value();
+    }
+}
+
+void Pool::Batch::execute()
+{
+    std::size_t chunk;
+    while (not isCancled() and (chunk = next_++) < chunks_)
+    {
+        const std::size_t first = begin_ + chunk * grain_;
+        const std::size_t last = std::min(first + grain_, end_);
+
+        try
+        {
+            for (std::size_t i = first; i < last; ++i)
+                function_(i);
+        }
+        catch (...)
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (not exception_)
+                exception_ = std::current_exception();
+        }
+
+        // Last chunk to finish fulfills the promise.
+        if (++finished_ == chunks_ and not released_.exchange(true))
+        {
+            if (exception_)
+                promise_.set_exception(exception_);
+            else
+                promise_.set_value();
+        }
+    }
+}
+
+void Pool::Batch::abandon()
+{
+    if (not released_.exchange(true))
+        promise_.set_exception(std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)));
+}
+
+void Pool::Batch::get() const
+{
+    future_.get();
+}
+
+void Pool::Batch::wait() const
+{
+    future_.wait();
+}
+
+bool Pool::Batch::isDone() const
+{
+    return waitFor(0);
+}
+
+bool Pool::Batch::waitFor(double time) const
+{
+    return future_.wait_for(std::chrono::duration<double>(time)) == std::future_status::ready;
+}
+
+std::size_t Pool::Batch::getChunkCount() const
+{
+    return chunks_;
+}
+
 ///
 /// Pool
 ///
 
-Pool::Pool(unsigned int n) : active_(true)
+Pool::Pool(unsigned int n, Scheduler scheduler) : Pool(n, scheduler, Affinity())
 {
+}
+
+Pool::Pool(unsigned int n, Scheduler scheduler, const Affinity &affinity)
+  : scheduler_(scheduler), cpus_(assignCPUs(affinity, n)), active_(true)
+{
+    for (auto &depth : depth_)
+        depth = 0;
+
+    if (scheduler_ == Scheduler::STEALING)
+        for (unsigned int i = 0; i < n; ++i)
+            workers_.emplace_back(new Worker());
+
     for (unsigned int i = 0; i < n; ++i)
-        threads_.emplace_back(std::bind(&Pool::run, this));
+        threads_.emplace_back(std::bind(&Pool::run, this, i));
 }
 
 Pool::~Pool()
 {
-    active_ = false;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        active_ = false;
+    }
+
     cv_.notify_all();
 
     for (auto &thread : threads_)
@@ -42,23 +308,332 @@ unsigned int Pool::getThreadCount() const
     return threads_.size();
 }
 
-void Pool::run()
+Pool::Scheduler Pool::getScheduler() const
+{
+    return scheduler_;
+}
+
+int Pool::getWorkerCPU(unsigned int index) const
+{
+    return cpus_[index];
+}
+
+int Pool::getCurrentCPU()
+{
+    return sched_getcpu();
+}
+
+unsigned int Pool::getNode(unsigned int cpu)
 {
+    const auto &nodes = getNodeCPUs();
+    for (std::size_t i = 0; i < nodes.size(); ++i)
+        if (std::find(nodes[i].begin(), nodes[i].end(), cpu) != nodes[i].end())
+            return i;
+
+    return 0;
+}
+
+int Pool::getWorkerIndex() const
+{
+    return (current_pool == this) ? static_cast<int>(current_index) : -1;
+}
+
+Pool::Stats Pool::getStats() const
+{
+    Stats stats;
+    for (std::size_t i = 0; i < PRIORITIES; ++i)
+        stats.depth[i] = depth_[i];
+
+    stats.executed = executed_;
+    stats.dropped = dropped_;
+    stats.canceled = skipped_;
+
+    stats.average_wait = (stats.executed) ? 1e-9 * wait_total_ / stats.executed : 0.;
+    stats.max_wait = 1e-9 * wait_max_;
+
+    return stats;
+}
+
+void Pool::prepare(Joblet &job, const JobOptions &options) const
+{
+    job.priority_ = options.priority;
+    job.submitted_ = Clock::now();
+
+    if (options.deadline > 0.)
+        job.deadline_ = job.submitted_ + std::chrono::duration_cast<Clock::duration>(
+                                             std::chrono::duration<double>(options.deadline));
+}
+
+bool Pool::admit(Joblet &job)
+{
+    const auto now = Clock::now();
+    depth_[static_cast<std::size_t>(job.priority_)]--;
+
+    if (job.isCancled())
+    {
+        skipped_++;
+        job.abandon();
+        return false;
+    }
+
+    if (now > job.deadline_)
+    {
+        job.expired = true;
+        dropped_++;
+        job.abandon();
+        return false;
+    }
+
+    const uint64_t wait = std::chrono::duration_cast<std::chrono::nanoseconds>(now - job.submitted_).count();
+    wait_total_ += wait;
+
+    uint64_t max = wait_max_;
+    while (wait > max and not wait_max_.compare_exchange_weak(max, wait))
+        ;
+
+    executed_++;
+    return true;
+}
+
+void Pool::enqueue(const std::shared_ptr<Joblet> &job) const
+{
+    const std::size_t lane = static_cast<std::size_t>(job->priority_);
+    depth_[lane]++;
+
+    if (scheduler_ == Scheduler::SHARED or workers_.empty())
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        jobs_[lane].emplace(job);
+
+        cv_.notify_one();
+        return;
+    }
+
+    // Jobs submitted from within a worker go to the back of its own deque, otherwise distribute them.
+    const bool local = current_pool == this;
+    const unsigned int index = (local) ? current_index : next_++ % workers_.size();
+
+    pending_++;
+
+    {
+        auto &worker = *workers_[index];
+        std::unique_lock<std::mutex> lock(worker.mutex);
+        worker.jobs[lane].emplace_back(job);
+    }
+
+    notify();
+}
+
+void Pool::enqueue(const std::shared_ptr<Joblet> &job, std::size_t copies) const
+{
+    if (copies == 0)
+        return;
+
+    const std::size_t lane = static_cast<std::size_t>(job->priority_);
+    depth_[lane] += copies;
+
+    if (scheduler_ == Scheduler::SHARED or workers_.empty())
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (std::size_t i = 0; i < copies; ++i)
+            jobs_[lane].emplace(job);
+
+        if (copies == 1)
+            cv_.notify_one();
+        else
+            cv_.notify_all();
+
+        return;
+    }
+
+    // Spread copies over the worker deques, starting with the local worker if there is one.
+    const unsigned int start = (current_pool == this) ? current_index : next_++ % workers_.size();
+
+    pending_ += copies;
+
+    for (std::size_t i = 0; i < copies and i < workers_.size(); ++i)
+    {
+        const std::size_t n = copies / workers_.size() + ((i < copies % workers_.size()) ? 1 : 0);
+
+        auto &worker = *workers_[(start + i) % workers_.size()];
+        std::unique_lock<std::mutex> lock(worker.mutex);
+        for (std::size_t j = 0; j < n; ++j)
+            worker.jobs[lane].emplace_back(job);
+    }
+
+    if (sleeping_ > 0)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.notify_all();
+    }
+}
+
+std::size_t Pool::getGrain(std::size_t size, std::size_t grain) const
+{
+    if (grain > 0)
+        return grain;
+
+    // Aim for a few chunks per thread so uneven items still balance out.
+    const std::size_t target = 4 * std::max(1u, getThreadCount());
+    return std::max<std::size_t>(1, (size + target - 1) / target);
+}
+
+std::size_t Pool::getBatchCopies(const Batch &batch) const
+{
+    return std::min<std::size_t>(batch.getChunkCount(), getThreadCount());
+}
+
+void Pool::submitJob(const std::shared_ptr<Joblet> &job) const
+{
+    prepare(*job, JobOptions());
+    enqueue(job);
+}
+
+std::shared_ptr<Pool::Batch> Pool::submitFor(std::size_t begin, std::size_t end,
+                                             const std::function<void(std::size_t)> &function,
+                                             std::size_t grain) const
+{
+    const std::size_t size = (end > begin) ? end - begin : 0;
+
+    auto batch = std::make_shared<Batch>(function, begin, end, getGrain(size, grain));
+    prepare(*batch, JobOptions());
+    enqueue(batch, getBatchCopies(*batch));
+
+    return batch;
+}
+
+void Pool::parallelFor(std::size_t begin, std::size_t end, const std::function<void(std::size_t)> &function,
+                       std::size_t grain) const
+{
+    const std::size_t size = (end > begin) ? end - begin : 0;
+
+    auto batch = std::make_shared<Batch>(function, begin, end, getGrain(size, grain));
+    prepare(*batch, JobOptions());
+
+    // The calling thread takes part in the batch, so leave one chunk worth of work for it.
+    const std::size_t copies = getBatchCopies(*batch);
+    enqueue(batch, (copies > 0) ? copies - 1 : 0);
+
+    batch->execute();
+    batch->get();
+}
+
+void Pool::notify() const
+{
+    // Only take the lock if a worker might be waiting.
+    if (sleeping_ > 0)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.notify_one();
+    }
+}
+
+std::shared_ptr<Pool::Joblet> Pool::dequeueShared()
+{
+    const auto available = [&] {
+        for (const auto &lane : jobs_)
+            if (not lane.empty())
+                return true;
+
+        return false;
+    };
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [&] { return (active_ && available()) || !active_; });
+
+    if (!active_)
+        return nullptr;
+
+    for (auto &lane : jobs_)
+        if (not lane.empty())
+        {
+            auto job = lane.front();
+            lane.pop();
+
+            return job;
+        }
+
+    return nullptr;
+}
+
+std::shared_ptr<Pool::Joblet> Pool::tryTake(unsigned int index, std::size_t lane, bool owner)
+{
+    auto &worker = *workers_[index];
+    std::unique_lock<std::mutex> lock(worker.mutex);
+
+    auto &jobs = worker.jobs[lane];
+    if (jobs.empty())
+        return nullptr;
+
+    std::shared_ptr<Joblet> job;
+    if (owner)
+    {
+        job = std::move(jobs.back());
+        jobs.pop_back();
+    }
+    else
+    {
+        job = std::move(jobs.front());
+        jobs.pop_front();
+    }
+
+    pending_--;
+    return job;
+}
+
+std::shared_ptr<Pool::Joblet> Pool::dequeueStealing(unsigned int index)
+{
+    const std::size_t n = workers_.size();
     while (active_)
     {
+        // Higher priority lanes are drained across all workers before lower ones.
+        for (std::size_t lane = 0; lane < PRIORITIES; ++lane)
+        {
+            if (depth_[lane] == 0)
+                continue;
+
+            if (auto job = tryTake(index, lane, true))
+                return job;
+
+            for (std::size_t i = 1; i < n; ++i)
+                if (auto job = tryTake((index + i) % n, lane, false))
+                    return job;
+        }
+
+        // Nothing available, wait until something is submitted.
         std::unique_lock<std::mutex> lock(mutex_);
-        cv_.wait(lock, [&] { return (active_ && !jobs_.empty()) || !active_; });
+        sleeping_++;
+        cv_.wait(lock, [&] { return pending_ > 0 || !active_; });
+        sleeping_--;
+    }
 
-        if (!active_)
-            break;
+    return nullptr;
+}
 
-        auto job = jobs_.front();
-        jobs_.pop();
+void Pool::run(unsigned int index)
+{
+    current_pool = this;
+    current_index = index;
 
-        lock.unlock();
+    // Pin before running any jobs, so memory the worker touches is allocated on its node.
+    if (cpus_[index] >= 0)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpus_[index], &set);
+
+        if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+            RBX_WARN("Failed to pin pool worker %1% to CPU %2%", index, cpus_[index]);
+    }
+
+    while (active_)
+    {
+        auto job = (scheduler_ == Scheduler::STEALING) ? dequeueStealing(index) : dequeueShared();
+        if (not job)
+            break;
 
-        // Ignore canceled jobs.
-        if (!job->isCancled())
+        // Ignore canceled and expired jobs.
+        if (admit(*job))
             job->execute();
     }
 }
@@ -1,5 +1,8 @@
 /* Author: Constantinos Chamzas */
 
+#include <atomic>
+#include <cstdint>
+
 #include <robowflex_library/constants.h>
 #include <robowflex_library/random.h>
 
@@ -7,19 +10,87 @@ using namespace robowflex;
 
 namespace
 {
-    static std::mt19937 GENERATOR;                          ///< Random engine generator.
-    static std::uniform_real_distribution<> UNIDIST{0, 1};  ///< Uniform distribution.
-    static std::normal_distribution<> NORMALDIST{0, 1};     ///< Normal distribution.
+    static std::atomic<unsigned int> SEED{std::mt19937::default_seed};  ///< Master seed.
+    static std::atomic_size_t GENERATION{0};                            ///< Master seed changes.
+    static std::atomic_size_t STREAMS{0};                               ///< Next stream ID to give out.
+
+    /** \brief A thread's random stream.
+     */
+    struct Stream
+    {
+        /** \brief Constructor. Takes the next free stream ID.
+         */
+        Stream() : id(STREAMS++)
+        {
+            seed();
+        }
+
+        /** \brief Seed the generator from the master seed and the stream ID.
+         */
+        void seed()
+        {
+            generation = GENERATION;
+
+            const std::uint64_t id64 = id;
+            std::seed_seq sequence{SEED.load(), (unsigned int)(id64 & 0xFFFFFFFF),  //
+                                   (unsigned int)(id64 >> 32)};
+            generator.seed(sequence);
+            unidist.reset();
+            normaldist.reset();
+        }
+
+        std::size_t id;                                  ///< Stream ID.
+        std::size_t generation;                          ///< Master seed generation seeded from.
+        std::mt19937 generator;                          ///< Random engine generator.
+        std::uniform_real_distribution<> unidist{0, 1};  ///< Uniform distribution.
+        std::normal_distribution<> normaldist{0, 1};     ///< Normal distribution.
+    };
+
+    /** \brief Get the calling thread's stream, reseeding it if the master seed has changed.
+     *  \return The stream.
+     */
+    Stream &getThreadStream()
+    {
+        static thread_local Stream stream;
+        if (stream.generation != GENERATION)
+            stream.seed();
+
+        return stream;
+    }
 }  // namespace
 
 void RNG::setSeed(unsigned int seed)
 {
-    GENERATOR.seed(seed);
+    SEED = seed;
+    ++GENERATION;
+}
+
+unsigned int RNG::getSeed()
+{
+    return SEED;
+}
+
+void RNG::setStream(std::size_t stream)
+{
+    auto &s = getThreadStream();
+    s.id = stream;
+    s.seed();
+}
+
+std::size_t RNG::getStream()
+{
+    return getThreadStream().id;
+}
+
+std::mt19937 &RNG::getGenerator()
+{
+    return getThreadStream().generator;
 }
 
 double RNG::uniform01()
 {
-    return UNIDIST(GENERATOR);
+    auto &stream = getThreadStream();
+    return stream.unidist(stream.generator);
 }
 
 double RNG::uniformReal(double lower_bound, double upper_bound)
@@ -41,7 +112,8 @@ bool RNG::uniformBool()
 
 double RNG::gaussian01()
 {
-    return NORMALDIST(GENERATOR);
+    auto &stream = getThreadStream();
+    return stream.normaldist(stream.generator);
 }
 
 double RNG::gaussian(double mean, double stddev)
@@ -100,6 +172,18 @@ Eigen::Vector3d RNG::uniformVec(const Eigen::Vector3d &bounds)
     return uniformVec(-bounds, bounds);
 }
 
+void RNG::uniformVec(Eigen::Ref<Eigen::MatrixXd> samples, const Eigen::VectorXd &lbound,
+                     const Eigen::VectorXd &ubound)
+{
+    assert(lbound.size() == samples.rows() and ubound.size() == samples.rows());
+
+    auto &stream = getThreadStream();
+    const Eigen::VectorXd range = ubound - lbound;
+    for (Eigen::Index j = 0; j < samples.cols(); ++j)
+        for (Eigen::Index i = 0; i < samples.rows(); ++i)
+            samples(i, j) = range[i] * stream.unidist(stream.generator) + lbound[i];
+}
+
 Eigen::Vector3d RNG::gaussianVec(const Eigen::Vector3d &mean, const Eigen::Vector3d &stddev)
 {
     Eigen::Vector3d vec;
@@ -118,3 +202,14 @@ Eigen::Vector3d RNG::gaussianVec(const Eigen::Vector3d &stddev)
 
     return vec;
 }
+
+void RNG::gaussianVec(Eigen::Ref<Eigen::MatrixXd> samples, const Eigen::VectorXd &mean,
+                      const Eigen::VectorXd &stddev)
+{
+    assert(mean.size() == samples.rows() and stddev.size() == samples.rows());
+
+    auto &stream = getThreadStream();
+    for (Eigen::Index j = 0; j < samples.cols(); ++j)
+        for (Eigen::Index i = 0; i < samples.rows(); ++i)
+            samples(i, j) = stddev[i] * stream.normaldist(stream.generator) + mean[i];
+}
@@ -0,0 +1,344 @@
+/* Author: Zachary Kingston */
+
+#include <algorithm>
+#include <cmath>
+
+#include <robowflex_library/io/hdf5.h>
+#include <robowflex_library/log.h>
+#include <robowflex_library/pool.h>
+#include <robowflex_library/random.h>
+#include <robowflex_library/reachability.h>
+
+using namespace robowflex;
+
+namespace
+{
+    constexpr int FACE_BINS = 2;                      ///< Bins along each edge of a cube face.
+    constexpr int BINS = 6 * FACE_BINS * FACE_BINS;  ///< Total number of direction bins.
+
+    /** \brief Bin a direction onto the faces of a cube. */
+    int getBin(const Eigen::Vector3d &direction)
+    {
+        Eigen::Vector3d::Index axis;
+        const double major = direction.cwiseAbs().maxCoeff(&axis);
+        if (major <= 0.)
+            return 0;
+
+        const int face = 2 * axis + (direction[axis] < 0);
+        const double u = direction[(axis + 1) % 3] / major;
+        const double v = direction[(axis + 2) % 3] / major;
+
+        const auto cell = [](double x) { return std::min(FACE_BINS - 1, int((x + 1) / 2 * FACE_BINS)); };
+        return (face * FACE_BINS + cell(u)) * FACE_BINS + cell(v);
+    }
+
+    /** \brief Sample an orientation uniformly from SO(3). */
+    Eigen::Quaterniond sampleRotation()
+    {
+        Eigen::Vector4d q;
+        do
+            q = Eigen::Vector4d{RNG::gaussian01(), RNG::gaussian01(), RNG::gaussian01(), RNG::gaussian01()};
+        while (q.squaredNorm() < constants::eps);
+
+        q.normalize();
+        return Eigen::Quaterniond(q[0], q[1], q[2], q[3]);
+    }
+}  // namespace
+
+///
+/// ReachabilityMap
+///
+
+ReachabilityMap::ReachabilityMap(const RobotConstPtr &robot, const std::string &group)
+  : robot_(robot), group_(group)
+{
+    const auto *jmg = robot_->getModelConst()->getJointModelGroup(group_);
+    if (not jmg)
+        throw Exception(1, log::format("Group `%1%` does not exist in robot!", group_));
+
+    variables_ = jmg->getVariableCount();
+}
+
+bool ReachabilityMap::build(const Eigen::Vector3d &lower, const Eigen::Vector3d &upper, const Pool &pool)
+{
+    return build(lower, upper, pool, Options());
+}
+
+bool ReachabilityMap::build(const Eigen::Vector3d &lower, const Eigen::Vector3d &upper, const Pool &pool,
+                            const Options &options)
+{
+    if (options.resolution <= 0. or (upper - lower).minCoeff() <= 0.)
+    {
+        RBX_ERROR("Invalid bounds or resolution for reachability map");
+        return false;
+    }
+
+    lower_ = lower;
+    resolution_ = options.resolution;
+    for (std::size_t i = 0; i < 3; ++i)
+        dims_[i] = std::max(1, int(std::ceil((upper[i] - lower[i]) / resolution_)));
+
+    const std::size_t voxels = std::size_t(dims_[0]) * dims_[1] * dims_[2];
+    attempts_.assign(voxels * BINS, 0);
+    successes_.assign(voxels * BINS, 0);
+    seeds_.assign(voxels, {});
+
+    const auto *jmg = robot_->getModelConst()->getJointModelGroup(group_);
+    const std::size_t per = std::max<std::size_t>(1, options.orientations);
+    const std::size_t chunk = std::max<std::size_t>(1, options.batch / per);
+
+    RBX_INFO("Building reachability map of %1% voxels for `%2%`...", voxels, group_);
+
+    std::vector<Robot::IKQuery> queries;
+    std::vector<int> bins;
+    std::vector<robot_state::RobotStatePtr> states;
+    std::size_t solved = 0;
+
+    for (std::size_t begin = 0; begin < voxels; begin += chunk)
+    {
+        const std::size_t end = std::min(voxels, begin + chunk);
+
+        queries.clear();
+        bins.clear();
+        for (std::size_t voxel = begin; voxel < end; ++voxel)
+        {
+            const Eigen::Vector3d &center = getCenter(voxel);
+            for (std::size_t j = 0; j < per; ++j)
+            {
+                const Eigen::Quaterniond &orientation = sampleRotation();
+                bins.emplace_back(getBin(orientation * Eigen::Vector3d::UnitZ()));
+
+                queries.emplace_back(group_, center, orientation);
+                queries.back().attempts = 1;
+            }
+        }
+
+        states.clear();
+        solved += robot_->setFromIKBatch(queries, states, pool);
+
+        for (std::size_t k = 0; k < queries.size(); ++k)
+        {
+            const std::size_t voxel = begin + k / per;
+            const std::size_t index = voxel * BINS + bins[k];
+            attempts_[index]++;
+
+            if (not states[k])
+                continue;
+
+            successes_[index]++;
+
+            auto &seeds = seeds_[voxel];
+            if (seeds.size() < options.seeds * variables_)
+            {
+                std::vector<double> positions;
+                states[k]->copyJointGroupPositions(jmg, positions);
+                seeds.insert(seeds.end(), positions.begin(), positions.end());
+            }
+        }
+    }
+
+    RBX_INFO("Built reachability map, %1% of %2% IK queries solved", solved, voxels * per);
+    return true;
+}
+
+double ReachabilityMap::getDensity(const RobotPose &pose) const
+{
+    const long voxel = getVoxel(pose.translation());
+    if (voxel < 0)
+        return 0.;
+
+    const std::size_t offset = voxel * BINS;
+    const std::size_t index = offset + getBin(pose.linear().col(2));
+    if (attempts_[index] > 0)
+        return double(successes_[index]) / attempts_[index];
+
+    // No samples with this approach direction, so fall back to the voxel as a whole.
+    int attempts = 0;
+    int successes = 0;
+    for (std::size_t i = offset; i < offset + BINS; ++i)
+    {
+        attempts += attempts_[i];
+        successes += successes_[i];
+    }
+
+    return (attempts > 0) ? double(successes) / attempts : 0.;
+}
+
+bool ReachabilityMap::isLikelyReachable(const RobotPose &pose, double threshold) const
+{
+    return getDensity(pose) > threshold;
+}
+
+bool ReachabilityMap::getSeeds(const Eigen::Vector3d &position, std::vector<std::vector<double>> &seeds) const
+{
+    seeds.clear();
+
+    const long voxel = getVoxel(position);
+    if (voxel < 0)
+        return false;
+
+    const auto &stored = seeds_[voxel];
+    for (std::size_t i = 0; i + variables_ <= stored.size(); i += variables_)
+        seeds.emplace_back(stored.begin() + i, stored.begin() + i + variables_);
+
+    return not seeds.empty();
+}
+
+bool ReachabilityMap::setFromIK(const Robot::IKQuery &query, robot_state::RobotState &state) const
+{
+    std::vector<std::vector<double>> seeds;
+    if (query.group == group_ and not query.region_poses.empty() and
+        getSeeds(query.region_poses[0].translation(), seeds))
+    {
+        const auto *jmg = robot_->getModelConst()->getJointModelGroup(group_);
+
+        // Each seed gets a single attempt without random restarts.
+        Robot::IKQuery seeded(query);
+        seeded.attempts = 1;
+        seeded.random_restart = false;
+
+        robot_state::RobotState scratch(state);
+        for (const auto &seed : seeds)
+        {
+            scratch.setJointGroupPositions(jmg, seed);
+            if (robot_->setFromIK(seeded, scratch))
+            {
+                state = scratch;
+                return true;
+            }
+        }
+    }
+
+    return robot_->setFromIK(query, state);
+}
+
+bool ReachabilityMap::save(const std::string &filename) const
+{
+    try
+    {
+        IO::HDF5Writer writer(filename);
+
+        writer.write({"lower"}, std::vector<double>{lower_[0], lower_[1], lower_[2]});
+        writer.write({"resolution"}, std::vector<double>{resolution_});
+        writer.write({"dims"}, std::vector<int>{dims_[0], dims_[1], dims_[2]});
+
+        const hsize_t voxels = attempts_.size() / BINS;
+        writer.write({"attempts"}, attempts_.data(), {voxels, hsize_t(BINS)});
+        writer.write({"successes"}, successes_.data(), {voxels, hsize_t(BINS)});
+
+        // Seeds are stored as rows, along with the voxel each belongs to.
+        std::vector<int> seed_voxels;
+        std::vector<double> seeds;
+        for (std::size_t i = 0; i < seeds_.size(); ++i)
+        {
+            seeds.insert(seeds.end(), seeds_[i].begin(), seeds_[i].end());
+            seed_voxels.insert(seed_voxels.end(), seeds_[i].size() / variables_, int(i));
+        }
+
+        // Empty DataSets cannot be chunked, so seeds are omitted if there are none.
+        if (not seed_voxels.empty())
+        {
+            writer.write({"seed_voxels"}, seed_voxels);
+            auto dataset = writer.write({"seeds"}, seeds.data(), {seed_voxels.size(), hsize_t(variables_)});
+
+            const auto *jmg = robot_->getModelConst()->getJointModelGroup(group_);
+            IO::HDF5Writer::writeAttribute(dataset, "joints", jmg->getVariableNames());
+            IO::HDF5Writer::writeAttribute(dataset, "group", std::vector<std::string>{group_});
+        }
+
+        writer.flush();
+    }
+    catch (const H5::Exception &e)
+    {
+        RBX_ERROR("Failed to write reachability map to %1%: %2%", filename, e.getDetailMsg());
+        return false;
+    }
+
+    return true;
+}
+
+bool ReachabilityMap::load(const std::string &filename)
+{
+    try
+    {
+        IO::HDF5File file(filename);
+
+        for (const auto &key : {"lower", "resolution", "dims", "attempts", "successes"})
+            if (not file.getData({key}))
+            {
+                RBX_ERROR("Reachability map in %1% is missing `%2%`", filename, key);
+                return false;
+            }
+
+        const auto &lower = file.getData({"lower"})->read<double>(0, 3);
+        const auto &resolution = file.getData({"resolution"})->read<double>(0, 1);
+        const auto &dims = file.getData({"dims"})->read<int>(0, 3);
+
+        const auto &attempts = file.getData({"attempts"});
+        const auto &successes = file.getData({"successes"});
+        const auto &seeds = file.getData({"seeds"});
+        const auto &seed_voxels = file.getData({"seed_voxels"});
+
+        const std::size_t voxels = std::size_t(dims[0]) * dims[1] * dims[2];
+        if (attempts->getDims()[0] != voxels or attempts->getDims()[1] != hsize_t(BINS) or
+            (seeds and seeds->getDims()[1] != variables_))
+        {
+            RBX_ERROR("Reachability map in %1% does not match group `%2%`", filename, group_);
+            return false;
+        }
+
+        lower_ = Eigen::Vector3d{lower[0], lower[1], lower[2]};
+        resolution_ = resolution[0];
+        dims_ = {{dims[0], dims[1], dims[2]}};
+
+        attempts_ = attempts->read<int>(0, voxels);
+        successes_ = successes->read<int>(0, voxels);
+
+        seeds_.assign(voxels, {});
+        if (not seeds or not seed_voxels)
+            return true;
+
+        const std::size_t n = seeds->getDims()[0];
+        const auto &rows = seeds->read<double>(0, n);
+        const auto &owners = seed_voxels->read<int>(0, n);
+
+        for (std::size_t i = 0; i < n; ++i)
+            seeds_[owners[i]].insert(seeds_[owners[i]].end(),                //
+                                     rows.begin() + i * variables_,          //
+                                     rows.begin() + (i + 1) * variables_);
+    }
+    catch (const H5::Exception &e)
+    {
+        RBX_ERROR("Failed to read reachability map from %1%: %2%", filename, e.getDetailMsg());
+        return false;
+    }
+
+    return true;
+}
+
+long ReachabilityMap::getVoxel(const Eigen::Vector3d &position) const
+{
+    if (resolution_ <= 0.)
+        return -1;
+
+    long index = 0;
+    for (std::size_t i = 0; i < 3; ++i)
+    {
+        const double x = (position[i] - lower_[i]) / resolution_;
+        if (x < 0. or x >= dims_[i])
+            return -1;
+
+        index = index * dims_[i] + long(x);
+    }
+
+    return index;
+}
+
+Eigen::Vector3d ReachabilityMap::getCenter(std::size_t voxel) const
+{
+    const std::size_t z = voxel % dims_[2];
+    const std::size_t y = (voxel / dims_[2]) % dims_[1];
+    const std::size_t x = voxel / (std::size_t(dims_[1]) * dims_[2]);
+
+    return lower_ + resolution_ * (Eigen::Vector3d{double(x), double(y), double(z)}.array() + 0.5).matrix();
+}
@@ -1,16 +1,27 @@
 /* Author: Zachary Kingston */
 
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
 #include <deque>
+#include <map>
+#include <fstream>
+#include <mutex>
 #include <numeric>
+#include <thread>
 
 #include <moveit/robot_state/conversions.h>
 #include <moveit/robot_state/robot_state.h>
 
+#include <random_numbers/random_numbers.h>
+
 #include <robowflex_library/geometry.h>
+#include <robowflex_library/ik_cache.h>
 #include <robowflex_library/io.h>
 #include <robowflex_library/io/yaml.h>
 #include <robowflex_library/log.h>
 #include <robowflex_library/macros.h>
+#include <robowflex_library/pool.h>
 #include <robowflex_library/robot.h>
 #include <robowflex_library/scene.h>
 #include <robowflex_library/tf.h>
@@ -18,6 +29,39 @@
 
 using namespace robowflex;
 
+namespace
+{
+    /** \brief Wraps a solver allocator so that the first allocation returns an already initialized
+     * solver, rather than initializing a new one.
+     *  \param[in] allocator Allocator to use after the first allocation.
+     *  \param[in] solver Initialized solver to return first.
+     *  \return The wrapped allocator.
+     */
+    robot_model::SolverAllocatorFn reuseSolver(const robot_model::SolverAllocatorFn &allocator,
+                                               const kinematics::KinematicsBasePtr &solver)
+    {
+        auto first = std::make_shared<kinematics::KinematicsBasePtr>(solver);
+        auto mutex = std::make_shared<std::mutex>();
+
+        return [allocator, first, mutex](const robot_model::JointModelGroup *jmg) {
+            {
+                std::unique_lock<std::mutex> lock(*mutex);
+                if (*first)
+                {
+                    kinematics::KinematicsBasePtr reused = *first;
+                    first->reset();
+                    return reused;
+                }
+            }
+
+            return allocator(jmg);
+        };
+    }
+
+    const char TRANSFORMS_MAGIC[4] = {'R', 'B', 'X', 'T'};  ///< Magic of binary path transform files.
+    const uint32_t TRANSFORMS_VERSION = 1;                  ///< Version of binary path transform files.
+}  // namespace
+
 const std::string Robot::ROBOT_DESCRIPTION = "robot_description";
 const std::string Robot::ROBOT_SEMANTIC = "_semantic";
 const std::string Robot::ROBOT_PLANNING = "_planning";
@@ -56,6 +100,15 @@ bool Robot::initialize(const std::string &urdf_file, const std::string &srdf_fil
         return false;
     }
 
+    const std::vector<std::string> files = {urdf_file, srdf_file, limits_file, kinematics_file};
+    const std::string &entry = (cache_directory_.empty()) ? "" : getModelCacheFile(files);
+    if (not entry.empty() and loadModelCache(entry))
+    {
+        RBX_INFO("Loaded robot description from cache `%s`", entry);
+        initializeInternal();
+        return true;
+    }
+
     if (not loadURDFFile(urdf_file))
     {
         RBX_ERROR("Failed to load URDF!");
@@ -83,6 +136,10 @@ bool Robot::initialize(const std::string &urdf_file, const std::string &srdf_fil
         }
 
     initializeInternal();
+
+    if (not entry.empty())
+        saveModelCache(entry, files);
+
     return true;
 }
 
@@ -240,6 +297,97 @@ void Robot::setKinematicsPostProcessFunction(const PostProcessYAMLFunction &func
     kinematics_function_ = function;
 }
 
+void Robot::setModelCache(const std::string &directory, const std::string &tag)
+{
+    cache_directory_ = directory;
+    cache_tag_ = tag;
+}
+
+std::string Robot::getModelCacheFile(const std::vector<std::string> &files) const
+{
+    std::string key = cache_tag_;
+    for (const auto &file : files)
+        key += "\n" + ((file.empty()) ? "" : IO::resolvePath(file));
+
+    return IO::makeFilepath(IO::resolvePath(cache_directory_), name_ + "_" + IO::hashString(key) + ".yml");
+}
+
+bool Robot::loadModelCache(const std::string &entry)
+{
+    const auto &yaml = IO::loadFileToYAML(entry);
+    if (not yaml.first)
+        return false;
+
+    const auto &node = yaml.second;
+    try
+    {
+        if (not IO::isNode(node["urdf"]) or not IO::isNode(node["srdf"]) or not IO::isNode(node["inputs"]))
+            return false;
+
+        for (auto it = node["inputs"].begin(); it != node["inputs"].end(); ++it)
+        {
+            const auto &file = it->first.as<std::string>();
+            if (IO::hashString(IO::loadFileToString(file)) != it->second.as<std::string>())
+            {
+                RBX_INFO("Robot description cache `%s` is stale, `%s` has changed", entry, file);
+                return false;
+            }
+        }
+
+        urdf_ = node["urdf"].as<std::string>();
+        srdf_ = node["srdf"].as<std::string>();
+
+        if (IO::isNode(node["yaml"]))
+            for (auto it = node["yaml"].begin(); it != node["yaml"].end(); ++it)
+            {
+                const auto &name = it->first.as<std::string>();
+                handler_.loadYAMLtoROS(it->second, name);
+                yaml_[name] = it->second;
+            }
+    }
+    catch (const YAML::Exception &e)
+    {
+        RBX_WARN("Failed to parse robot description cache `%s`: %s", entry, e.what());
+        return false;
+    }
+
+    processed_ = true;
+    return true;
+}
+
+void Robot::saveModelCache(const std::string &entry, const std::vector<std::string> &files) const
+{
+    YAML::Node inputs;
+    for (const auto &file : files)
+    {
+        if (file.empty())
+            continue;
+
+        const auto &path = IO::resolvePath(file);
+        inputs[path] = IO::hashString(IO::loadFileToString(path));
+
+        const std::string xacro = ".xacro";
+        if (path.size() > xacro.size() and path.compare(path.size() - xacro.size(), xacro.size(), xacro) == 0)
+            for (const auto &dependency : IO::getXacroDependencies(path))
+                inputs[dependency] = IO::hashString(IO::loadFileToString(dependency));
+    }
+
+    YAML::Node node;
+    node["inputs"] = inputs;
+    node["urdf"] = urdf_;
+    node["srdf"] = srdf_;
+    for (const auto &yaml : yaml_)
+        node["yaml"][yaml.first] = yaml.second;
+
+    // Write to a temporary file first, so concurrent startups never read a partial entry.
+    const std::string temp = entry + "." + std::to_string(IO::getProcessID());
+    if (not IO::YAMLToFile(node, temp) or std::rename(temp.c_str(), entry.c_str()) != 0)
+    {
+        RBX_WARN("Failed to write robot description cache `%s`", entry);
+        IO::deleteFile(temp);
+    }
+}
+
 bool Robot::loadYAMLFile(const std::string &name, const std::string &file)
 {
     PostProcessYAMLFunction function;
@@ -266,9 +414,13 @@ bool Robot::loadYAMLFile(const std::string &name, const std::string &file,
         }
 
         handler_.loadYAMLtoROS(copy, name);
+        yaml_[name] = copy;
     }
     else
+    {
         handler_.loadYAMLtoROS(yaml.second, name);
+        yaml_[name] = yaml.second;
+    }
 
     return true;
 }
@@ -310,14 +462,14 @@ void Robot::initializeInternal(bool namespaced)
     const std::string &description = ((namespaced) ? handler_.getNamespace() : "") + "/" + ROBOT_DESCRIPTION;
 
     loadRobotModel(description);
-    if (urdf_function_)
+    if (urdf_function_ and not processed_)
         updateXMLString(urdf_, urdf_function_);
 
-    if (srdf_function_)
+    if (srdf_function_ and not processed_)
         updateXMLString(srdf_, srdf_function_);
 
     // If either function was called, reload robot.
-    if (urdf_function_ or srdf_function_)
+    if ((urdf_function_ or srdf_function_) and not processed_)
     {
         RBX_INFO("Reloading model after URDF/SRDF post-process function...");
         loadRobotModel(description);
@@ -342,14 +494,93 @@ void Robot::loadRobotModel(const std::string &description)
     kinematics_.reset(new kinematics_plugin_loader::KinematicsPluginLoader(description));
 
     model_ = loader_->getModel();
+
+    // The loader reads joint limits from the ROS master, so apply them from the in-process parameters.
+    if (model_ and not handler_.pushesToMaster())
+        loadInProcessJointLimits();
+}
+
+void Robot::loadInProcessJointLimits()
+{
+    const std::string prefix = ROBOT_DESCRIPTION + ROBOT_PLANNING + "/joint_limits/";
+    for (auto *joint : model_->getJointModels())
+    {
+        auto limits = joint->getVariableBoundsMsg();
+        for (auto &limit : limits)
+        {
+            const std::string key = prefix + limit.joint_name + "/";
+
+            bool has_limits;
+            double value;
+            if (handler_.getParam(key + "has_position_limits", has_limits))
+                limit.has_position_limits = has_limits;
+            if (limit.has_position_limits and handler_.getParam(key + "min_position", value))
+                limit.min_position = value;
+            if (limit.has_position_limits and handler_.getParam(key + "max_position", value))
+                limit.max_position = value;
+
+            if (handler_.getParam(key + "has_velocity_limits", has_limits))
+                limit.has_velocity_limits = has_limits;
+            if (limit.has_velocity_limits and handler_.getParam(key + "max_velocity", value))
+                limit.max_velocity = value;
+
+            if (handler_.getParam(key + "has_acceleration_limits", has_limits))
+                limit.has_acceleration_limits = has_limits;
+            if (limit.has_acceleration_limits and handler_.getParam(key + "max_acceleration", value))
+                limit.max_acceleration = value;
+        }
+
+        joint->setVariableBounds(limits);
+    }
+}
+
+void Robot::loadInProcessKinematics(std::vector<std::string> &groups, std::map<std::string, double> &timeout,
+                                    std::map<std::string, robot_model::SolverAllocatorFn> &allocators)
+{
+    const std::string prefix = ROBOT_DESCRIPTION + ROBOT_KINEMATICS + "/";
+    for (const auto &name : model_->getJointModelGroupNames())
+    {
+        std::string solver;
+        if (not handler_.getParam(prefix + name + "/kinematics_solver", solver))
+            continue;
+
+        double resolution = kinematics::KinematicsBase::DEFAULT_SEARCH_DISCRETIZATION;
+        double time = kinematics::KinematicsBase::DEFAULT_TIMEOUT;
+        int attempts = 3;
+        handler_.getParam(prefix + name + "/kinematics_solver_search_resolution", resolution);
+        handler_.getParam(prefix + name + "/kinematics_solver_timeout", time);
+        handler_.getParam(prefix + name + "/kinematics_solver_attempts", attempts);
+
+        // A loader with a default solver assigns it to every group, without reading the ROS master.
+        auto &loader = group_kinematics_[name];
+        loader = std::make_shared<kinematics_plugin_loader::KinematicsPluginLoader>(solver, time, attempts,
+                                                                                     resolution);
+
+        groups.emplace_back(name);
+        timeout[name] = time;
+        allocators[name] = loader->getLoaderFunction(loader_->getSRDF());
+    }
 }
 
 bool Robot::loadKinematics(const std::string &group_name, bool load_subgroups)
 {
-    // Needs to be called first to read the groups defined in the SRDF from the ROS params.
-    robot_model::SolverAllocatorFn allocator = kinematics_->getLoaderFunction(loader_->getSRDF());
+    std::vector<std::string> groups;
+    std::map<std::string, double> timeout;
+    std::map<std::string, robot_model::SolverAllocatorFn> allocators;
+
+    if (handler_.pushesToMaster())
+    {
+        // Needs to be called first to read the groups defined in the SRDF from the ROS params.
+        robot_model::SolverAllocatorFn allocator = kinematics_->getLoaderFunction(loader_->getSRDF());
+
+        groups = kinematics_->getKnownGroups();
+        timeout = kinematics_->getIKTimeout();
+        for (const auto &name : groups)
+            allocators[name] = allocator;
+    }
+    else
+        loadInProcessKinematics(groups, timeout, allocators);
 
-    const auto &groups = kinematics_->getKnownGroups();
     if (groups.empty())
     {
         RBX_ERROR("No kinematics plugins defined. Fill and load kinematics.yaml!");
@@ -375,12 +606,13 @@ bool Robot::loadKinematics(const std::string &group_name, bool load_subgroups)
     if (std::find(groups.begin(), groups.end(), group_name) != groups.end())
         load_names.emplace_back(group_name);
 
-    auto timeout = kinematics_->getIKTimeout();
-
+    // Check all groups first, so solvers are only initialized once everything is known to be loadable.
+    std::vector<std::string> pending;
     for (const auto &name : load_names)
     {
         // Check if kinematics have already been loaded for this group.
-        if (imap_.find(name) != imap_.end())
+        if (imap_.find(name) != imap_.end() or
+            std::find(pending.begin(), pending.end(), name) != pending.end())
             continue;
 
         if (!model_->hasJointModelGroup(name) ||
@@ -390,14 +622,46 @@ bool Robot::loadKinematics(const std::string &group_name, bool load_subgroups)
             return false;
         }
 
+        pending.emplace_back(name);
+    }
+
+    // Solver initialization (e.g., building chains from the URDF) dominates loading for robots with many
+    // groups. MoveIt's plugin loader holds its lock for the whole allocation, so only solvers of in-process
+    // groups, which each have their own loader, are initialized concurrently, on a pool bounded by the
+    // number of cores. Solvers sharing the loader of the ROS master are initialized one after another.
+    std::vector<kinematics::KinematicsBasePtr> solvers(pending.size());
+    if (not handler_.pushesToMaster() and pending.size() > 1)
+    {
+        Pool pool(std::min<unsigned int>(pending.size(), std::max(1u, std::thread::hardware_concurrency())));
+
+        std::vector<std::shared_ptr<Pool::Job<kinematics::KinematicsBasePtr>>> jobs;
+        for (const auto &name : pending)
+        {
+            const robot_model::JointModelGroup *jmg = model_->getJointModelGroup(name);
+            const auto &allocator = allocators[name];
+            jobs.emplace_back(pool.submit(make_function([allocator, jmg] { return allocator(jmg); })));
+        }
+
+        for (std::size_t i = 0; i < jobs.size(); ++i)
+            solvers[i] = jobs[i]->get();
+    }
+    else
+    {
+        for (std::size_t i = 0; i < pending.size(); ++i)
+            solvers[i] = allocators[pending[i]](model_->getJointModelGroup(pending[i]));
+    }
+
+    for (std::size_t i = 0; i < pending.size(); ++i)
+    {
+        const auto &name = pending[i];
         robot_model::JointModelGroup *jmg = model_->getJointModelGroup(name);
-        kinematics::KinematicsBasePtr solver = allocator(jmg);
+        const kinematics::KinematicsBasePtr &solver = solvers[i];
 
         if (solver)
         {
             std::string error_msg;
             if (solver->supportsGroup(jmg, &error_msg))
-                imap_[name] = allocator;
+                imap_[name] = reuseSolver(allocators[name], solver);
             else
             {
                 RBX_ERROR("Kinematics solver %s does not support joint group %s.  Error: %s",
@@ -419,6 +683,36 @@ bool Robot::loadKinematics(const std::string &group_name, bool load_subgroups)
     return true;
 }
 
+RobotPtr Robot::makeView(const std::string &name) const
+{
+    if (not loader_)
+    {
+        RBX_ERROR("Robot `%s` must be initialized before creating views!", name_);
+        return nullptr;
+    }
+
+    auto view = std::make_shared<Robot>(name);
+    view->urdf_ = urdf_;
+    view->srdf_ = srdf_;
+    view->processed_ = true;
+    view->yaml_ = yaml_;
+
+    view->loader_ = loader_;
+    view->model_ = model_;
+    view->imap_ = imap_;
+    view->kinematics_ = kinematics_;
+    view->ik_cache_ = ik_cache_;
+
+    // Only the parameter server contents are duplicated, the model itself is shared.
+    view->handler_.setParam(ROBOT_DESCRIPTION, urdf_);
+    view->handler_.setParam(ROBOT_DESCRIPTION + ROBOT_SEMANTIC, srdf_);
+    for (const auto &yaml : yaml_)
+        view->handler_.loadYAMLtoROS(yaml.second, yaml.first);
+
+    view->scratch_.reset(new robot_state::RobotState(*scratch_));
+    return view;
+}
+
 void Robot::setSRDFPostProcessAddPlanarJoint(const std::string &name)
 {
     setSRDFPostProcessFunction([&, name](tinyxml2::XMLDocument &doc) -> bool {
@@ -780,7 +1074,7 @@ void Robot::IKQuery::addClearanceMetric(double weight)
                           const kinematic_constraints::ConstraintEvaluationResult &result) {
         if (scene)
         {
-            double v = scene->distanceToCollision(state);
+            double v = scene->getClearance(state);
             return weight * v;
         }
 
@@ -813,6 +1107,33 @@ bool Robot::IKQuery::sampleRegions(RobotPoseVector &poses) const
     return sampled;
 }
 
+bool Robot::IKQuery::sampleRegions(std::vector<RobotPoseVector> &poses, std::size_t count) const
+{
+    const std::size_t n = regions.size();
+    poses.resize(count);
+    for (auto &pose : poses)
+        pose.resize(n);
+
+    bool sampled = true;
+    Eigen::Matrix4Xd quaternions(4, count);
+    Eigen::Matrix3Xd points(3, count);
+    for (std::size_t j = 0; j < n; ++j)
+    {
+        TF::sampleOrientations(orientations[j], tolerances[j], quaternions);
+        sampled &= regions[j]->sample(points);
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            auto &pose = poses[i][j];
+            pose = region_poses[j];
+            pose.translate(points.col(i));
+            pose.rotate(Eigen::Quaterniond(quaternions.col(i)));
+        }
+    }
+
+    return sampled;
+}
+
 void Robot::IKQuery::getMessage(const std::string &base_frame, moveit_msgs::Constraints &msg) const
 {
     const std::size_t n = regions.size();
@@ -831,8 +1152,33 @@ void Robot::IKQuery::getMessage(const std::string &base_frame, moveit_msgs::Cons
     }
 }
 
+namespace
+{
+    bool equalPoses(const RobotPoseVector &a, const RobotPoseVector &b)
+    {
+        return std::equal(a.begin(), a.end(), b.begin(), b.end(),
+                          [](const RobotPose &x, const RobotPose &y) { return x.matrix() == y.matrix(); });
+    }
+
+    bool equalOrientations(const std::vector<Eigen::Quaterniond> &a, const std::vector<Eigen::Quaterniond> &b)
+    {
+        return std::equal(a.begin(), a.end(), b.begin(), b.end(),
+                          [](const Eigen::Quaterniond &x, const Eigen::Quaterniond &y) {
+                              return x.coeffs() == y.coeffs();
+                          });
+    }
+}  // namespace
+
 kinematic_constraints::KinematicConstraintSetPtr Robot::IKQuery::getAsConstraints(const Robot &robot) const
 {
+    std::unique_lock<std::mutex> lock(cache_->mutex);
+
+    auto &cache = *cache_;
+    if (cache.constraints and cache.model == robot.getModelConst() and cache.tips == tips and
+        cache.regions == regions and cache.tolerances == tolerances and
+        equalPoses(cache.region_poses, region_poses) and equalOrientations(cache.orientations, orientations))
+        return cache.constraints;
+
     moveit_msgs::Constraints msg;
     const auto &root = robot.getModelConst()->getRootLink()->getName();
     getMessage(root, msg);
@@ -842,6 +1188,14 @@ kinematic_constraints::KinematicConstraintSetPtr Robot::IKQuery::getAsConstraint
 
     constraints->add(msg, none);
 
+    cache.model = robot.getModelConst();
+    cache.tips = tips;
+    cache.regions = regions;
+    cache.region_poses = region_poses;
+    cache.orientations = orientations;
+    cache.tolerances = tolerances;
+    cache.constraints = constraints;
+
     return constraints;
 }
 
@@ -860,8 +1214,53 @@ bool Robot::setFromIK(const IKQuery &query)
     return setFromIK(query, *scratch_);
 }
 
+namespace
+{
+    /** \brief Run a single attempt of an IK query, starting from \a state.
+     *  \return True if the attempt found a valid solution.
+     */
+    bool solveIKAttempt(const Robot::IKQuery &query, const robot_model::JointModelGroup *jmg,
+                        const moveit::core::GroupStateValidityCallbackFn &gsvcf,
+                        const kinematic_constraints::KinematicConstraintSetPtr &constraints,
+                        const RobotPoseVector &targets, robot_state::RobotState &state,
+                        kinematic_constraints::ConstraintEvaluationResult &result)
+    {
+#if ROBOWFLEX_AT_LEAST_MELODIC
+        // Multi-tip IK: Will delegate automatically to RobotState::setFromIKSubgroups() if the kinematics
+        // solver doesn't support multi-tip queries.
+        bool success = state.setFromIK(jmg, targets, query.tips, query.timeout, gsvcf, query.options);
+#else
+        // attempts was a prior field that was deprecated in melodic
+        bool success = state.setFromIK(jmg, targets, query.tips, 1, query.timeout, gsvcf, query.options);
+#endif
+
+        if (constraints)
+        {
+            state.update();
+            result = constraints->decide(state, query.verbose);
+        }
+
+        // Externally validate result
+        if (query.validate)
+        {
+            if (query.verbose)
+                RBX_INFO("Constraint Distance: %1%", result.distance);
+
+            bool no_collision = (query.scene) ? not query.scene->checkCollision(state).collision : true;
+
+            success =             //
+                no_collision and  //
+                ((query.valid_distance > 0.) ? result.distance <= query.valid_distance : result.satisfied);
+        }
+
+        return success;
+    }
+}  // namespace
+
 bool Robot::setFromIK(const IKQuery &query, robot_state::RobotState &state) const
 {
+    RBX_TRACE("Robot::setFromIK");
+
     // copy query for unconstness
     IKQuery query_copy(query);
 
@@ -871,16 +1270,31 @@ bool Robot::setFromIK(const IKQuery &query, robot_state::RobotState &state) cons
         query_copy.tips = getSolverTipFrames(query.group);
 
     const robot_model::JointModelGroup *jmg = model_->getJointModelGroup(query_copy.group);
-    const auto &gsvcf = (query_copy.scene) ? query_copy.scene->getGSVCF(query_copy.verbose) :
-                                             moveit::core::GroupStateValidityCallbackFn{};
+    const auto &gsvcf =
+        (query_copy.scene) ?
+            query_copy.scene->getValidityChecker(query_copy.verbose, query_copy.group_collision)->getGSVCF() :
+            moveit::core::GroupStateValidityCallbackFn{};
 
     bool evaluate = not query_copy.metrics.empty() or query_copy.validate;
     kinematic_constraints::ConstraintEvaluationResult result;
 
     const auto &constraints = (evaluate) ? query_copy.getAsConstraints(*this) : nullptr;
 
+    // Use a cached solution if one satisfies the query, otherwise seed the solver with one.
+    if (checkIKCache(query_copy, state, true))
+    {
+        state.update();
+        return true;
+    }
+
     // Best state if evaluating metrics.
-    auto best = (query_copy.metrics.empty()) ? nullptr : std::make_shared<robot_state::RobotState>(state);
+    StateLease best;
+    if (not query_copy.metrics.empty())
+    {
+        best = StateLease(model_);
+        *best = state;
+    }
+
     double best_value = constants::inf;
 
     bool success = false;
@@ -890,37 +1304,7 @@ bool Robot::setFromIK(const IKQuery &query, robot_state::RobotState &state) cons
         // Sample new target poses from regions.
         query_copy.sampleRegions(targets);
 
-#if ROBOWFLEX_AT_LEAST_MELODIC
-        // Multi-tip IK: Will delegate automatically to RobotState::setFromIKSubgroups() if the kinematics
-        // solver doesn't support multi-tip queries.
-        success =
-            state.setFromIK(jmg, targets, query_copy.tips, query_copy.timeout, gsvcf, query_copy.options);
-#else
-        // attempts was a prior field that was deprecated in melodic
-        success =
-            state.setFromIK(jmg, targets, query_copy.tips, 1, query_copy.timeout, gsvcf, query_copy.options);
-#endif
-
-        if (evaluate)
-        {
-            state.update();
-            result = constraints->decide(state, query_copy.verbose);
-        }
-
-        // Externally validate result
-        if (query_copy.validate)
-        {
-            if (query_copy.verbose)
-                RBX_INFO("Constraint Distance: %1%", result.distance);
-
-            bool no_collision =
-                (query_copy.scene) ? not query_copy.scene->checkCollision(state).collision : true;
-
-            success =             //
-                no_collision and  //
-                ((query_copy.valid_distance > 0.) ? result.distance <= query_copy.valid_distance :
-                                                    result.satisfied);
-        }
+        success = solveIKAttempt(query_copy, jmg, gsvcf, constraints, targets, state, result);
 
         // If success, evaluate state for metrics.
         if (success and not query_copy.metrics.empty())
@@ -954,9 +1338,242 @@ bool Robot::setFromIK(const IKQuery &query, robot_state::RobotState &state) cons
     }
 
     state.update();
+    if (success and ik_cache_)
+        ik_cache_->insert(query_copy, state);
+
     return success;
 }
 
+bool Robot::setFromIK(const IKQuery &query, robot_state::RobotState &state, const Pool &pool) const
+{
+    RBX_TRACE("Robot::setFromIK");
+
+    IKQuery query_copy(query);
+    if (query_copy.tips[0].empty())
+        query_copy.tips = getSolverTipFrames(query.group);
+
+    const robot_model::JointModelGroup *jmg = model_->getJointModelGroup(query_copy.group);
+    const auto &gsvcf =
+        (query_copy.scene) ?
+            query_copy.scene->getValidityChecker(query_copy.verbose, query_copy.group_collision)->getGSVCF() :
+            moveit::core::GroupStateValidityCallbackFn{};
+
+    const bool evaluate = not query_copy.metrics.empty() or query_copy.validate;
+    const auto &constraints = (evaluate) ? query_copy.getAsConstraints(*this) : nullptr;
+
+    // Use a cached solution if one satisfies the query, otherwise start attempts from one.
+    robot_state::RobotState start(state);
+    if (checkIKCache(query_copy, start, true))
+    {
+        state = start;
+        state.update();
+        return true;
+    }
+
+    // Region samplers are not thread-safe, so sample all targets here.
+    const std::size_t attempts = query_copy.attempts;
+    std::vector<RobotPoseVector> targets;
+    query_copy.sampleRegions(targets, attempts);
+
+    // Number of valid solutions after which to stop.
+    const std::size_t needed = (query_copy.metrics.empty()) ? 1 :
+                               (query_copy.solutions) ? query_copy.solutions :
+                                                        attempts;
+
+    // Attempts with an index at or above the limit no longer matter and are skipped.
+    std::atomic<std::size_t> limit(attempts);
+    std::mutex mutex;
+    std::map<std::size_t, std::pair<double, robot_state::RobotStatePtr>> found;
+
+    pool.parallelFor(
+        0, attempts,
+        [&](std::size_t i) {
+            if (i >= limit)
+                return;
+
+            auto attempt = std::make_shared<robot_state::RobotState>(start);
+            if (i > 0 and query_copy.random_restart)
+            {
+                random_numbers::RandomNumberGenerator rng(query_copy.seed + i);
+                attempt->setToRandomPositions(jmg, rng);
+            }
+
+            kinematic_constraints::ConstraintEvaluationResult result;
+            if (not solveIKAttempt(query_copy, jmg, gsvcf, constraints, targets[i], *attempt, result))
+                return;
+
+            const double value =
+                (query_copy.metrics.empty()) ? 0. : query_copy.getMetricValue(*attempt, result);
+
+            if (query_copy.verbose)
+                RBX_INFO("Attempt %1% State Metric Value: %2%", i, value);
+
+            std::unique_lock<std::mutex> lock(mutex);
+            found.emplace(i, std::make_pair(value, attempt));
+
+            // Once enough solutions are found, only earlier attempts can change the result.
+            if (found.size() >= needed)
+            {
+                auto it = found.begin();
+                std::advance(it, needed - 1);
+                limit = std::min<std::size_t>(limit, it->first + 1);
+            }
+        },
+        1);
+
+    // Pick the best solution of the attempts under the limit, preferring earlier attempts on ties.
+    robot_state::RobotStatePtr best;
+    double best_value = constants::inf;
+    for (const auto &solution : found)
+    {
+        if (solution.first >= limit)
+            break;
+
+        if (not best or solution.second.first < best_value)
+        {
+            best = solution.second.second;
+            best_value = solution.second.first;
+        }
+    }
+
+    if (best)
+    {
+        state = *best;
+        if (ik_cache_)
+            ik_cache_->insert(query_copy, state);
+    }
+
+    state.update();
+    return best != nullptr;
+}
+
+std::size_t Robot::setFromIKBatch(const std::vector<IKQuery> &queries,
+                                  std::vector<robot_state::RobotStatePtr> &states, const Pool &pool) const
+{
+    const std::size_t n = queries.size();
+    states.resize(n);
+
+    // Setup shared between queries: tip frames per group and validity callbacks per scene.
+    std::map<std::string, std::vector<std::string>> tips;
+    std::map<std::pair<const Scene *, bool>, moveit::core::GroupStateValidityCallbackFn> gsvcfs;
+
+    std::vector<IKQuery> copies(queries);
+    std::vector<std::vector<RobotPoseVector>> targets(n);
+    std::vector<bool> seeded(n);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        auto &query = copies[i];
+        if (query.tips[0].empty())
+        {
+            auto it = tips.find(query.group);
+            if (it == tips.end())
+                it = tips.emplace(query.group, getSolverTipFrames(query.group)).first;
+
+            query.tips = it->second;
+        }
+
+        const auto scene_key = std::make_pair(query.scene.get(), query.group_collision);
+        if (query.scene and gsvcfs.find(scene_key) == gsvcfs.end())
+            gsvcfs.emplace(scene_key,
+                           query.scene->getValidityChecker(query.verbose, query.group_collision)->getGSVCF());
+
+        // Region samplers are not thread-safe, so sample all targets here.
+        query.sampleRegions(targets[i], query.attempts);
+
+        seeded[i] = states[i] != nullptr;
+    }
+
+    const std::size_t chunks = std::min<std::size_t>(n, pool.getThreadCount() + 1);
+    std::atomic<std::size_t> solved(0);
+
+    pool.parallelFor(
+        0, chunks,
+        [&](std::size_t chunk) {
+            // Previous solutions in this chunk, with the position of their first target.
+            std::vector<std::pair<Eigen::Vector3d, robot_state::RobotStatePtr>> previous;
+
+            for (std::size_t i = chunk * n / chunks; i < (chunk + 1) * n / chunks; ++i)
+            {
+                const auto &query = copies[i];
+                const robot_model::JointModelGroup *jmg = model_->getJointModelGroup(query.group);
+                const auto &gsvcf = (query.scene) ?
+                                        gsvcfs.at(std::make_pair(query.scene.get(), query.group_collision)) :
+                                        moveit::core::GroupStateValidityCallbackFn{};
+
+                const bool evaluate = not query.metrics.empty() or query.validate;
+                const auto &constraints = (evaluate) ? query.getAsConstraints(*this) : nullptr;
+
+                const Eigen::Vector3d position = targets[i][0][0].translation();
+
+                // Seed from the nearest previous solution, or the scratch state if there is none.
+                robot_state::RobotStatePtr seed = (seeded[i]) ? states[i] : scratch_;
+                if (not seeded[i])
+                {
+                    double nearest = constants::inf;
+                    for (const auto &solution : previous)
+                    {
+                        const double d = (solution.first - position).squaredNorm();
+                        if (d < nearest)
+                        {
+                            nearest = d;
+                            seed = solution.second;
+                        }
+                    }
+                }
+
+                auto state = std::make_shared<robot_state::RobotState>(*seed);
+                auto best =
+                    (query.metrics.empty()) ? nullptr : std::make_shared<robot_state::RobotState>(*state);
+                double best_value = constants::inf;
+
+                random_numbers::RandomNumberGenerator rng(query.seed + i);
+                kinematic_constraints::ConstraintEvaluationResult result;
+
+                bool success = checkIKCache(query, *state, not seeded[i]);
+                for (std::size_t j = 0; j < query.attempts and not success; ++j)
+                {
+                    success = solveIKAttempt(query, jmg, gsvcf, constraints, targets[i][j], *state, result);
+
+                    if (success and not query.metrics.empty())
+                    {
+                        const double v = query.getMetricValue(*state, result);
+                        if (v < best_value)
+                        {
+                            best_value = v;
+                            *best = *state;
+                        }
+
+                        success = false;
+                    }
+
+                    if (query.random_restart and not success)
+                        state->setToRandomPositions(jmg, rng);
+                }
+
+                if (std::isfinite(best_value))
+                {
+                    state = best;
+                    success = true;
+                }
+
+                if (success)
+                {
+                    state->update();
+                    previous.emplace_back(position, state);
+                    ++solved;
+
+                    if (ik_cache_)
+                        ik_cache_->insert(query, *state);
+                }
+
+                states[i] = (success) ? state : nullptr;
+            }
+        },
+        1);
+
+    return solved;
+}
+
 bool Robot::validateIKQuery(const IKQuery &query, const robot_state::RobotState &state) const
 {
     const auto &constraints = query.getAsConstraints(*this);
@@ -984,11 +1601,21 @@ const RobotPose Robot::getRelativeLinkTF(const std::string &base, const std::str
     return base_tf.inverse() * target_tf;
 }
 
+void Robot::getLinkTFs(const std::string &group, const Eigen::Ref<const Eigen::MatrixXd> &positions,
+                       const std::vector<std::string> &links,
+                       std::vector<BatchFK::Transforms> &transforms) const
+{
+    BatchFK(*this, group, links).compute(positions, transforms);
+}
+
 bool Robot::toYAMLFile(const std::string &file) const
 {
     moveit_msgs::RobotState msg;
     moveit::core::robotStateToRobotStateMsg(*scratch_, msg);
 
+    if (IO::isBinaryFile(file))
+        return IO::messageToBinaryFile(msg, file);
+
     const auto &yaml = IO::toNode(msg);
     return IO::YAMLToFile(yaml, file);
 }
@@ -1003,6 +1630,107 @@ robot_model::RobotStatePtr Robot::allocState() const
     return state;
 }
 
+namespace
+{
+    /** \brief Maximum number of free states kept per robot model by each thread. */
+    constexpr std::size_t MAX_FREE_STATES = 8;
+
+    /** \brief The free states of \a model for the calling thread. Free states keep their model alive, so
+     * the model's address is a stable key. */
+    std::vector<robot_state::RobotStatePtr> &getFreeStates(const robot_model::RobotModel *model)
+    {
+        thread_local std::map<const robot_model::RobotModel *, std::vector<robot_state::RobotStatePtr>> free;
+        return free[model];
+    }
+}  // namespace
+
+Robot::StateLease::StateLease(const robot_model::RobotModelConstPtr &model)
+{
+    auto &free = getFreeStates(model.get());
+    if (free.empty())
+    {
+        state_.reset(new robot_state::RobotState(model));
+        state_->setToDefaultValues();
+    }
+    else
+    {
+        state_ = std::move(free.back());
+        free.pop_back();
+    }
+}
+
+Robot::StateLease::~StateLease()
+{
+    release();
+}
+
+Robot::StateLease::StateLease(StateLease &&other) noexcept : state_(std::move(other.state_))
+{
+}
+
+Robot::StateLease &Robot::StateLease::operator=(StateLease &&other) noexcept
+{
+    if (this != &other)
+    {
+        release();
+        state_ = std::move(other.state_);
+    }
+
+    return *this;
+}
+
+robot_state::RobotState &Robot::StateLease::operator*() const
+{
+    return *state_;
+}
+
+robot_state::RobotState *Robot::StateLease::operator->() const
+{
+    return state_.get();
+}
+
+const robot_state::RobotStatePtr &Robot::StateLease::get() const
+{
+    return state_;
+}
+
+Robot::StateLease::operator bool() const
+{
+    return (bool)state_;
+}
+
+void Robot::StateLease::release()
+{
+    if (not state_)
+        return;
+
+    // States that are still shared elsewhere are left to their other owners.
+    auto &free = getFreeStates(state_->getRobotModel().get());
+    if (state_.use_count() == 1 and free.size() < MAX_FREE_STATES)
+    {
+        state_->clearAttachedBodies();
+        free.emplace_back(std::move(state_));
+    }
+
+    state_.reset();
+}
+
+Robot::StateLease Robot::leaseState() const
+{
+    StateLease lease(getModelConst());
+    lease->setToDefaultValues();
+
+    return lease;
+}
+
+Robot::StateLease Robot::leaseScratchState() const
+{
+    StateLease lease(getModelConst());
+    *lease = *scratch_;
+
+    return lease;
+}
+
 std::vector<std::string> Robot::getSolverTipFrames(const std::string &group) const
 {
     const auto &jmg = model_->getJointModelGroup(group);
@@ -1023,6 +1751,63 @@ std::string Robot::getSolverBaseFrame(const std::string &group) const
     return "";
 }
 
+void Robot::setIKCache(const IKCachePtr &cache)
+{
+    ik_cache_ = cache;
+}
+
+const IKCachePtr &Robot::getIKCache() const
+{
+    return ik_cache_;
+}
+
+bool Robot::checkIKCache(const IKQuery &query, robot_state::RobotState &state, bool seed) const
+{
+    std::vector<std::vector<double>> seeds;
+    if (not ik_cache_ or not ik_cache_->lookup(query, seeds) or seeds.empty())
+        return false;
+
+    const robot_model::JointModelGroup *jmg = model_->getJointModelGroup(query.group);
+
+    // Queries with metrics search for the best solution, so cached solutions only seed the search.
+    if (not query.metrics.empty())
+    {
+        if (seed and seeds.front().size() == jmg->getVariableCount())
+            state.setJointGroupPositions(jmg, seeds.front());
+
+        return false;
+    }
+
+    const auto &constraints = query.getAsConstraints(*this);
+
+    robot_state::RobotState cached(state);
+    for (const auto &positions : seeds)
+    {
+        // Skip solutions loaded for a different model.
+        if (positions.size() != jmg->getVariableCount())
+            continue;
+
+        cached.setJointGroupPositions(jmg, positions);
+        cached.update();
+
+        const auto &result = constraints->decide(cached, query.verbose);
+        bool valid = (query.valid_distance > 0.) ? result.distance <= query.valid_distance : result.satisfied;
+        if (valid and query.scene)
+            valid = not query.scene->checkCollision(cached).collision;
+
+        if (valid)
+        {
+            state = cached;
+            return true;
+        }
+    }
+
+    if (seed and seeds.front().size() == jmg->getVariableCount())
+        state.setJointGroupPositions(jmg, seeds.front());
+
+    return false;
+}
+
 namespace
 {
     YAML::Node addLinkGeometry(const urdf::GeometrySharedPtr &geometry, bool resolve = true)
@@ -1221,6 +2006,12 @@ bool Robot::dumpTransforms(const std::string &filename) const
 bool Robot::dumpPathTransforms(const robot_trajectory::RobotTrajectory &path, const std::string &filename,
                                double fps, double threshold) const
 {
+    if (IO::isBinaryFile(filename))
+    {
+        Pool pool;
+        return dumpPathTransforms(path, filename, pool, fps, threshold);
+    }
+
     YAML::Node node, values;
     const double rate = 1.0 / fps;
 
@@ -1272,6 +2063,106 @@ bool Robot::dumpPathTransforms(const robot_trajectory::RobotTrajectory &path, co
     return IO::YAMLToFile(node, filename);
 }
 
+bool Robot::dumpPathTransforms(const robot_trajectory::RobotTrajectory &path, const std::string &filename,
+                               const Pool &pool, double fps, double threshold) const
+{
+    const double rate = 1.0 / fps;
+
+    // Find the total duration of the path.
+    const std::deque<double> &durations = path.getWayPointDurations();
+    double total_duration = std::accumulate(durations.begin(), durations.end(), 0.0);
+
+    // Frames are picked first, as the threshold depends on the previous frame output.
+    std::vector<double> times;
+    std::vector<float> delays;
+    {
+        robot_state::RobotStatePtr previous, state(new robot_state::RobotState(model_));
+        for (double duration = 0.0, delay = 0.0; duration <= total_duration; duration += rate, delay += rate)
+        {
+            if (threshold > 0.)
+            {
+                path.getStateAtDurationFromStart(duration, state);
+                if (previous && state->distance(*previous) < threshold)
+                    continue;
+
+                if (!previous)
+                    previous.reset(new robot_state::RobotState(model_));
+
+                *previous = *state;
+            }
+
+            times.emplace_back(duration);
+            delays.emplace_back(delay);
+            delay = 0;
+        }
+    }
+
+    const auto &links = model_->getLinkModels();
+    const std::size_t n = times.size();
+    const std::size_t m = links.size();
+    std::vector<float> data(n * m * 7);
+
+    // Forward kinematics of each frame is independent, so compute chunks of frames in parallel.
+    const std::size_t chunks = std::min<std::size_t>(n, pool.getThreadCount() + 1);
+    pool.parallelFor(
+        0, chunks,
+        [&](std::size_t chunk) {
+            robot_state::RobotStatePtr state(new robot_state::RobotState(model_));
+            for (std::size_t i = chunk * n / chunks; i < (chunk + 1) * n / chunks; ++i)
+            {
+                path.getStateAtDurationFromStart(times[i], state);
+                state->updateLinkTransforms();
+
+                float *frame = &data[i * m * 7];
+                for (std::size_t j = 0; j < m; ++j, frame += 7)
+                {
+                    const RobotPose &tf = state->getGlobalLinkTransform(links[j]);
+                    const Eigen::Vector3d &t = tf.translation();
+                    const Eigen::Quaterniond &q = TF::getPoseRotation(tf);
+
+                    frame[0] = t.x();
+                    frame[1] = t.y();
+                    frame[2] = t.z();
+                    frame[3] = q.x();
+                    frame[4] = q.y();
+                    frame[5] = q.z();
+                    frame[6] = q.w();
+                }
+            }
+        },
+        1);
+
+    std::ofstream out;
+    IO::createFile(out, filename);
+    if (not out)
+    {
+        RBX_ERROR("Failed to open `%s` for writing!", filename);
+        return false;
+    }
+
+    const uint32_t frames = n;
+    const uint32_t count = m;
+
+    out.write(TRANSFORMS_MAGIC, sizeof(TRANSFORMS_MAGIC));
+    out.write(reinterpret_cast<const char *>(&TRANSFORMS_VERSION), sizeof(TRANSFORMS_VERSION));
+    out.write(reinterpret_cast<const char *>(&frames), sizeof(frames));
+    out.write(reinterpret_cast<const char *>(&count), sizeof(count));
+    out.write(reinterpret_cast<const char *>(&fps), sizeof(fps));
+
+    for (const auto &link : links)
+    {
+        const std::string &name = link->getName();
+        const uint32_t size = name.size();
+        out.write(reinterpret_cast<const char *>(&size), sizeof(size));
+        out.write(name.data(), size);
+    }
+
+    out.write(reinterpret_cast<const char *>(delays.data()), delays.size() * sizeof(float));
+    out.write(reinterpret_cast<const char *>(data.data()), data.size() * sizeof(float));
+
+    return static_cast<bool>(out);
+}
+
 bool Robot::dumpToScene(const std::string &filename) const
 {
     YAML::Node node;
@@ -1,21 +1,38 @@
 /* Author: Zachary Kingston */
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <set>
+#include <thread>
 #include <type_traits>
+#include <unordered_map>
 
+#include <robowflex_library/distance_field.h>
 #include <robowflex_library/geometry.h>
 #include <robowflex_library/io.h>
 #include <robowflex_library/io/yaml.h>
 #include <robowflex_library/log.h>
 #include <robowflex_library/macros.h>
 #include <robowflex_library/openrave.h>
+#include <robowflex_library/pool.h>
+#include <robowflex_library/random.h>
 #include <robowflex_library/robot.h>
 #include <robowflex_library/scene.h>
+#include <robowflex_library/sphere_model.h>
 #include <robowflex_library/tf.h>
 #include <robowflex_library/util.h>
 
+#include <geometric_shapes/shape_operations.h>
+
 #include <moveit/collision_detection/collision_plugin.h>
 #include <moveit/robot_state/conversions.h>
 #include <pluginlib/class_loader.h>
+#include <sensor_msgs/point_cloud2_iterator.h>
 
 // Macro to check for function existence
 #include <boost/tti/has_member_function.hpp>
@@ -68,6 +85,17 @@ namespace robowflex
             return plugin;
         }
 
+        /** \brief Get the names of the declared collision detector plugins.
+         *  \return The plugin names.
+         */
+        std::vector<std::string> getDeclaredClasses() const
+        {
+            if (not loader_)
+                return {};
+
+            return loader_->getDeclaredClasses();
+        }
+
         /** \brief Loads a collision detector into a planning scene instance.
          *  \param[in] name the plugin name
          *  \param[in] scene the planning scene instance.
@@ -140,25 +168,282 @@ namespace
                      touch_links,  //
                      trajectory_msgs::JointTrajectory());
     }
+
+    const std::size_t MAX_CHANGES = 1024;  ///< Maximum number of changes kept in a scene's change log.
+    const std::size_t LEAF_SIZE = 4;       ///< Maximum number of objects in a leaf of the object index.
+
+    /** \brief Compute the bounding box of a set of shapes.
+     *  \param[in] shapes Shapes to bound.
+     *  \param[in] poses Global poses of the shapes.
+     *  \return The bounding box.
+     */
+    Eigen::AlignedBox3d computeShapesAABB(const std::vector<shapes::ShapeConstPtr> &shapes,
+                                          const RobotPoseVector &poses)
+    {
+        moveit::core::AABB aabb;
+        for (std::size_t i = 0; i < shapes.size(); ++i)
+            aabb.extendWithTransformedBox(poses[i], shapes::computeShapeExtents(shapes[i].get()));
+
+        return aabb;
+    }
+
+    /** \brief Compute the bounding box of a collision object.
+     *  \param[in] object Object to bound.
+     *  \return The bounding box.
+     */
+    Eigen::AlignedBox3d computeObjectAABB(const collision_detection::World::Object &object)
+    {
+#if ROBOWFLEX_MOVEIT_VERSION >= ROBOWFLEX_MOVEIT_VERSION_COMPUTE(1, 1, 6)
+        RobotPoseVector poses;
+        for (const auto &pose : object.shape_poses_)
+            poses.emplace_back(object.pose_ * pose);
+
+        return computeShapesAABB(object.shapes_, poses);
+#else
+        return computeShapesAABB(object.shapes_, object.shape_poses_);
+#endif
+    }
+
+    /** \brief Convert a point to an octomap point.
+     *  \param[in] point Point to convert.
+     *  \return The octomap point.
+     */
+    octomap::point3d toOcto(const Eigen::Vector3d &point)
+    {
+        return octomap::point3d(point[0], point[1], point[2]);
+    }
+
+    /** \brief Downsample a point cloud to the centroids of the points in each cell of a voxel grid. Points
+     * that are not finite are dropped.
+     *  \param[in] points Points to downsample.
+     *  \param[in] voxel Edge length of the cells.
+     *  \return The downsampled points.
+     */
+    Eigen::Matrix3Xd downsampleCloud(const Eigen::Ref<const Eigen::Matrix3Xd> &points, double voxel)
+    {
+        // Cells are keyed by 21 bits of each index, so grids wider than 2^21 cells alias.
+        const auto bits = [](double value) {
+            return static_cast<uint64_t>(static_cast<int64_t>(std::floor(value)) + (1 << 20)) & 0x1FFFFF;
+        };
+
+        std::unordered_map<uint64_t, std::pair<Eigen::Vector3d, std::size_t>> cells;
+        for (Eigen::Index i = 0; i < points.cols(); ++i)
+        {
+            const auto &point = points.col(i);
+            if (not point.allFinite())
+                continue;
+
+            const uint64_t key =
+                (bits(point[0] / voxel) << 42) | (bits(point[1] / voxel) << 21) | bits(point[2] / voxel);
+
+            auto it = cells.find(key);
+            if (it == cells.end())
+                cells.emplace(key, std::make_pair(Eigen::Vector3d(point), std::size_t(1)));
+            else
+            {
+                it->second.first += point;
+                ++it->second.second;
+            }
+        }
+
+        Eigen::Matrix3Xd downsampled(3, cells.size());
+        Eigen::Index i = 0;
+        for (const auto &cell : cells)
+            downsampled.col(i++) = cell.second.first / cell.second.second;
+
+        return downsampled;
+    }
 }  // namespace
 
+struct Scene::MessageCache
+{
+    std::mutex mutex;                                       ///< Cache mutex.
+    ID::Key key{ID::getNullKey()};                          ///< Key of the scene the message is of.
+    std::shared_ptr<const moveit_msgs::PlanningScene> msg;  ///< Message of the scene.
+    std::shared_ptr<const std::vector<uint8_t>> bytes;      ///< Serialization of \a msg, if made.
+    std::string hash;                                       ///< Hash of \a bytes, if made.
+};
+
+struct Scene::DistanceCache
+{
+    using ACMConstPtr = std::shared_ptr<const collision_detection::AllowedCollisionMatrix>;
+
+    std::mutex mutex;                            ///< Cache mutex.
+    ID::Key key{ID::getNullKey()};               ///< Key of the scene the ACMs were built for.
+    ACMConstPtr cleared;                         ///< ACM that disables all distances.
+    std::map<std::string, ACMConstPtr> objects;  ///< ACMs that only enable distance to an object.
+    std::map<std::string, ACMConstPtr> groups;   ///< ACMs for group-restricted collision checking.
+
+    /** \brief Link pairs moved by a group that are rigidly connected and never in collision. These only
+     * depend on the robot, so they are kept when the scene changes.
+     */
+    std::map<std::string, std::vector<std::pair<std::string, std::string>>> static_pairs;
+
+    /** \brief Drop cached ACMs if the scene has changed.
+     *  \param[in] current Key of the scene.
+     */
+    void refresh(const ID::Key &current)
+    {
+        if (compareIDs(current, key))
+            return;
+
+        key = current;
+        cleared.reset();
+        objects.clear();
+        groups.clear();
+    }
+
+    ID::Key field_key{ID::getNullKey()};  ///< Key of the scene the distance field was built for.
+    DistanceFieldPtr field;               ///< Signed distance field of the scene.
+};
+
+struct Scene::ObjectIndex
+{
+    /** \brief A node of the bounding volume hierarchy.
+     */
+    struct Node
+    {
+        Eigen::AlignedBox3d box;  ///< Box around all objects under the node.
+        std::size_t begin;        ///< First object under the node in the object order.
+        std::size_t end;          ///< One past the last object under the node in the object order.
+        std::size_t left{0};      ///< Index of the left child. Zero for leaves.
+        std::size_t right{0};     ///< Index of the right child. Zero for leaves.
+    };
+
+    std::mutex mutex;                                  ///< Index mutex.
+    bool valid{false};                                 ///< Whether the index has been built.
+    std::size_t version{0};                            ///< Version of the scene the index was built for.
+    std::map<std::string, Eigen::AlignedBox3d> boxes;  ///< Bounding box of each object.
+
+    std::vector<std::pair<std::string, Eigen::AlignedBox3d>> objects;  ///< Objects, in tree order.
+    std::vector<Node> nodes;                                           ///< Tree nodes. The first is the root.
+
+    /** \brief Rebuild the tree from the object bounding boxes.
+     */
+    void build()
+    {
+        objects.assign(boxes.begin(), boxes.end());
+        nodes.clear();
+
+        if (not objects.empty())
+            build(0, objects.size());
+    }
+
+    /** \brief Build a subtree over a range of objects, splitting at the median along the longest axis.
+     *  \param[in] begin First object of the range.
+     *  \param[in] end One past the last object of the range.
+     *  \return The index of the subtree's root.
+     */
+    std::size_t build(std::size_t begin, std::size_t end)
+    {
+        const std::size_t index = nodes.size();
+        nodes.emplace_back();
+
+        Eigen::AlignedBox3d box;
+        Eigen::AlignedBox3d centers;
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            box.extend(objects[i].second);
+            centers.extend(objects[i].second.center());
+        }
+
+        nodes[index].box = box;
+        nodes[index].begin = begin;
+        nodes[index].end = end;
+
+        if (end - begin <= LEAF_SIZE)
+            return index;
+
+        Eigen::Vector3d::Index axis;
+        centers.sizes().maxCoeff(&axis);
+
+        const std::size_t middle = begin + (end - begin) / 2;
+        std::nth_element(objects.begin() + begin, objects.begin() + middle, objects.begin() + end,
+                         [axis](const std::pair<std::string, Eigen::AlignedBox3d> &a,
+                                const std::pair<std::string, Eigen::AlignedBox3d> &b) {
+                             return a.second.center()[axis] < b.second.center()[axis];
+                         });
+
+        const std::size_t left = build(begin, middle);
+        const std::size_t right = build(middle, end);
+        nodes[index].left = left;
+        nodes[index].right = right;
+
+        return index;
+    }
+
+    /** \brief Find all objects whose boxes satisfy a predicate. The predicate must also hold for any box
+     * that contains a box it holds for, so subtrees can be pruned.
+     *  \param[in] predicate Predicate on boxes.
+     *  \return The names of the objects.
+     */
+    template <typename P>
+    std::vector<std::string> query(const P &predicate) const
+    {
+        std::vector<std::string> result;
+        if (nodes.empty())
+            return result;
+
+        std::vector<std::size_t> stack = {0};
+        while (not stack.empty())
+        {
+            const auto &node = nodes[stack.back()];
+            stack.pop_back();
+
+            if (not predicate(node.box))
+                continue;
+
+            if (node.left == 0)
+            {
+                for (std::size_t i = node.begin; i < node.end; ++i)
+                    if (predicate(objects[i].second))
+                        result.emplace_back(objects[i].first);
+            }
+            else
+            {
+                stack.emplace_back(node.left);
+                stack.emplace_back(node.right);
+            }
+        }
+
+        return result;
+    }
+};
+
 Scene::Scene(const RobotConstPtr &robot)
-  : loader_(new CollisionPluginLoader()), scene_(new planning_scene::PlanningScene(robot->getModelConst()))
+  : loader_(new CollisionPluginLoader())
+  , scene_(new planning_scene::PlanningScene(robot->getModelConst()))
+  , message_cache_(std::make_shared<MessageCache>())
+  , distance_cache_(std::make_shared<DistanceCache>())
+  , object_index_(std::make_shared<ObjectIndex>())
 {
 }
 
 Scene::Scene(const robot_model::RobotModelConstPtr &robot)
-  : loader_(new CollisionPluginLoader()), scene_(new planning_scene::PlanningScene(robot))
+  : loader_(new CollisionPluginLoader())
+  , scene_(new planning_scene::PlanningScene(robot))
+  , message_cache_(std::make_shared<MessageCache>())
+  , distance_cache_(std::make_shared<DistanceCache>())
+  , object_index_(std::make_shared<ObjectIndex>())
 {
 }
 
-Scene::Scene(const Scene &other) : loader_(new CollisionPluginLoader()), scene_(other.getSceneConst())
+Scene::Scene(const Scene &other)
+  : loader_(new CollisionPluginLoader())
+  , scene_(other.getSceneConst())
+  , message_cache_(std::make_shared<MessageCache>())
+  , distance_cache_(std::make_shared<DistanceCache>())
+  , object_index_(std::make_shared<ObjectIndex>())
+  , field_resolution_(other.field_resolution_)
+  , field_max_distance_(other.field_max_distance_)
+  , sphere_model_(other.sphere_model_)
 {
 }
 
 void Scene::operator=(const Scene &other)
 {
     incrementVersion();
+    resetChanges();
     scene_ = other.getSceneConst();
 }
 
@@ -170,6 +455,37 @@ ScenePtr Scene::deepCopy() const
     return scene;
 }
 
+ScenePtr Scene::snapshot() const
+{
+    auto scene = std::make_shared<Scene>(*this);
+    scene->scene_ = scene_->diff();
+
+    return scene;
+}
+
+bool Scene::isSnapshot() const
+{
+    return scene_->getParent() != nullptr;
+}
+
+moveit_msgs::PlanningScene Scene::getSnapshotDiff() const
+{
+    moveit_msgs::PlanningScene msg;
+    if (isSnapshot())
+        scene_->getPlanningSceneDiffMsg(msg);
+
+    return msg;
+}
+
+void Scene::decoupleSnapshot()
+{
+    if (isSnapshot())
+    {
+        incrementVersion();
+        scene_->decoupleParent();
+    }
+}
+
 const planning_scene::PlanningScenePtr &Scene::getSceneConst() const
 {
     return scene_;
@@ -178,19 +494,74 @@ const planning_scene::PlanningScenePtr &Scene::getSceneConst() const
 planning_scene::PlanningScenePtr &Scene::getScene()
 {
     incrementVersion();
+    resetChanges();
     return scene_;
 }
 
 moveit_msgs::PlanningScene Scene::getMessage() const
 {
-    moveit_msgs::PlanningScene msg;
-    scene_->getPlanningSceneMsg(msg);
-    return msg;
+    return *getMessageConst();
+}
+
+std::shared_ptr<const moveit_msgs::PlanningScene> Scene::getMessageConst() const
+{
+    std::unique_lock<std::mutex> lock(message_cache_->mutex);
+    updateMessageCache(false);
+
+    return message_cache_->msg;
+}
+
+std::shared_ptr<const std::vector<uint8_t>> Scene::getSerializedMessage() const
+{
+    std::unique_lock<std::mutex> lock(message_cache_->mutex);
+    updateMessageCache(true);
+
+    return message_cache_->bytes;
+}
+
+std::string Scene::getMessageHash() const
+{
+    std::unique_lock<std::mutex> lock(message_cache_->mutex);
+    updateMessageCache(true);
+
+    auto &cache = *message_cache_;
+    if (cache.hash.empty())
+        cache.hash = IO::getHash(*cache.bytes);
+
+    return cache.hash;
+}
+
+void Scene::updateMessageCache(bool serialize) const
+{
+    auto &cache = *message_cache_;
+
+    const auto &key = getKey();
+    if (not cache.msg or not compareIDs(cache.key, key))
+    {
+        auto msg = std::make_shared<moveit_msgs::PlanningScene>();
+        scene_->getPlanningSceneMsg(*msg);
+
+        cache.key = key;
+        cache.msg = msg;
+        cache.bytes.reset();
+        cache.hash.clear();
+    }
+
+    if (serialize and not cache.bytes)
+    {
+        const auto &msg = *cache.msg;
+        auto bytes = std::make_shared<std::vector<uint8_t>>(ros::serialization::serializationLength(msg));
+        ros::serialization::OStream stream(bytes->data(), bytes->size());
+        ros::serialization::serialize(stream, msg);
+
+        cache.bytes = bytes;
+    }
 }
 
 robot_state::RobotState &Scene::getCurrentState()
 {
     incrementVersion();
+    recordChange(Change::STATE);
     return scene_->getCurrentStateNonConst();
 }
 
@@ -202,6 +573,7 @@ const robot_state::RobotState &Scene::getCurrentStateConst() const
 collision_detection::AllowedCollisionMatrix &Scene::getACM()
 {
     incrementVersion();
+    recordChange(Change::ACM);
     return scene_->getAllowedCollisionMatrixNonConst();
 }
 
@@ -213,6 +585,7 @@ const collision_detection::AllowedCollisionMatrix &Scene::getACMConst() const
 void Scene::useMessage(const moveit_msgs::PlanningScene &msg, bool diff)
 {
     incrementVersion();
+    resetChanges();
 
     if (!diff)
         scene_->setPlanningSceneMsg(msg);
@@ -220,6 +593,276 @@ void Scene::useMessage(const moveit_msgs::PlanningScene &msg, bool diff)
         scene_->setPlanningSceneDiffMsg(msg);
 }
 
+bool Scene::integratePointCloud(const Eigen::Ref<const Eigen::Matrix3Xd> &points,
+                                const Eigen::Vector3d &origin)
+{
+    return integratePointCloud(points, origin, PointCloudOptions());
+}
+
+bool Scene::integratePointCloud(const Eigen::Ref<const Eigen::Matrix3Xd> &points,
+                                const Eigen::Vector3d &origin, const PointCloudOptions &options)
+{
+    const auto &name = planning_scene::PlanningScene::OCTOMAP_NS;
+    const auto &world = scene_->getWorldNonConst();
+
+    // Find the current octomap, and if anything else shares it.
+    std::shared_ptr<const octomap::OcTree> current;
+    RobotPose pose = RobotPose::Identity();
+    bool shared = false;
+    {
+        const auto &object = world->getObject(name);
+        if (object and object->shapes_.size() == 1 and object->shapes_[0]->type == shapes::OCTREE)
+        {
+            current = static_cast<const shapes::OcTree &>(*object->shapes_[0]).octree;
+#if ROBOWFLEX_MOVEIT_VERSION >= ROBOWFLEX_MOVEIT_VERSION_COMPUTE(1, 1, 6)
+            pose = object->pose_ * object->shape_poses_[0];
+#else
+            pose = object->shape_poses_[0];
+#endif
+            // The world holds one reference to the object, and this scope another.
+            shared = object.use_count() > 2;
+        }
+    }
+
+    if (not current and options.resolution <= 0)
+    {
+        RBX_ERROR("Octomap resolution must be positive!");
+        return false;
+    }
+
+    if (not octree_ or octree_ != current or shared)
+        octree_ = (current) ? std::make_shared<octomap::OcTree>(*current) :
+                              std::make_shared<octomap::OcTree>(options.resolution);
+
+    auto &tree = *octree_;
+    const double voxel = (options.voxel > 0) ? options.voxel : tree.getResolution();
+
+    // Rays are cast in the frame of the octomap.
+    const RobotPose inverse = pose.inverse();
+    const Eigen::Matrix3Xd cloud = downsampleCloud(inverse * points, voxel);
+    const octomap::point3d start = toOcto(inverse * origin);
+
+    unsigned int threads = (options.threads) ? options.threads : std::thread::hardware_concurrency();
+    threads = std::max(1u, threads);
+    const std::size_t batch = std::max<std::size_t>(1, options.batch);
+
+    // Each thread casts batches of rays and collects the cells they cross and end in.
+    std::vector<octomap::KeySet> free(threads);
+    std::vector<octomap::KeySet> occupied(threads);
+    std::atomic<std::size_t> next{0};
+    const auto cast = [&](unsigned int t) {
+        octomap::KeyRay ray;
+        const auto n = static_cast<std::size_t>(cloud.cols());
+        for (std::size_t b = next.fetch_add(batch); b < n; b = next.fetch_add(batch))
+            for (std::size_t i = b; i < std::min(b + batch, n); ++i)
+            {
+                octomap::point3d end = toOcto(cloud.col(i));
+                bool hit = true;
+
+                if (options.max_range >= 0 and (end - start).norm() > options.max_range)
+                {
+                    end = start + (end - start).normalized() * options.max_range;
+                    hit = false;
+                }
+
+                if (tree.computeRayKeys(start, end, ray))
+                    free[t].insert(ray.begin(), ray.end());
+
+                octomap::OcTreeKey key;
+                if (hit and tree.coordToKeyChecked(end, key))
+                    occupied[t].insert(key);
+            }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned int t = 1; t < threads; ++t)
+        workers.emplace_back(cast, t);
+
+    cast(0);
+    for (auto &worker : workers)
+        worker.join();
+
+    for (unsigned int t = 1; t < threads; ++t)
+    {
+        free[0].insert(free[t].begin(), free[t].end());
+        occupied[0].insert(occupied[t].begin(), occupied[t].end());
+    }
+
+    // Cells that any ray ends in are occupied, even if other rays cross them.
+    for (const auto &key : free[0])
+        if (occupied[0].find(key) == occupied[0].end())
+            tree.updateNode(key, false, true);
+
+    for (const auto &key : occupied[0])
+        tree.updateNode(key, true, true);
+
+    tree.updateInnerOccupancy();
+
+    // Only the octomap object is replaced, so the rest of the world is untouched.
+    incrementVersion();
+    if (world->removeObject(name))
+        recordChange(Change::REMOVED, name);
+
+    world->addToObject(name, std::make_shared<const shapes::OcTree>(octree_), pose);
+    recordChange(Change::ADDED, name);
+
+    return true;
+}
+
+bool Scene::integratePointCloud(const sensor_msgs::PointCloud2 &cloud, const RobotPose &sensor)
+{
+    return integratePointCloud(cloud, sensor, PointCloudOptions());
+}
+
+bool Scene::integratePointCloud(const sensor_msgs::PointCloud2 &cloud, const RobotPose &sensor,
+                                const PointCloudOptions &options)
+{
+    Eigen::Matrix3Xd points(3, cloud.width * cloud.height);
+    Eigen::Index n = 0;
+
+    try
+    {
+        sensor_msgs::PointCloud2ConstIterator<float> x(cloud, "x");
+        sensor_msgs::PointCloud2ConstIterator<float> y(cloud, "y");
+        sensor_msgs::PointCloud2ConstIterator<float> z(cloud, "z");
+
+        for (; x != x.end(); ++x, ++y, ++z)
+            if (std::isfinite(*x) and std::isfinite(*y) and std::isfinite(*z))
+                points.col(n++) = sensor * Eigen::Vector3d(*x, *y, *z);
+    }
+    catch (const std::runtime_error &e)
+    {
+        RBX_ERROR("Invalid point cloud: %s", e.what());
+        return false;
+    }
+
+    return integratePointCloud(points.leftCols(n), sensor.translation(), options);
+}
+
+bool Scene::getChanges(std::size_t version, std::vector<Change> &changes) const
+{
+    if (version < changes_start_)
+        return false;
+
+    changes.clear();
+    for (const auto &change : changes_)
+        if (change.version > version)
+            changes.emplace_back(change);
+
+    return true;
+}
+
+bool Scene::getDiffMessage(std::size_t version, moveit_msgs::PlanningScene &msg) const
+{
+    std::vector<Change> changes;
+    if (not getChanges(version, changes))
+        return false;
+
+    msg = moveit_msgs::PlanningScene();
+    msg.name = scene_->getName();
+    msg.is_diff = true;
+    msg.robot_state.is_diff = true;
+
+    bool state = false;
+    bool acm = false;
+    std::set<std::string> objects;
+    std::set<std::string> detached;
+    for (const auto &change : changes)
+    {
+        switch (change.type)
+        {
+            case Change::ADDED:
+            case Change::REMOVED:
+            case Change::MOVED:
+                objects.insert(change.name);
+                break;
+            case Change::DETACHED:
+                detached.insert(change.name);
+                // Detaching an object also puts it back into the world.
+                objects.insert(change.name);
+                state = true;
+                break;
+            case Change::ATTACHED:
+                detached.erase(change.name);
+                objects.insert(change.name);
+                state = true;
+                break;
+            case Change::STATE:
+                state = true;
+                break;
+            case Change::ACM:
+                acm = true;
+                break;
+        }
+    }
+
+    const auto &world = scene_->getWorld();
+    const auto &root = scene_->getRobotModel()->getRootLinkName();
+    for (const auto &name : objects)
+    {
+        moveit_msgs::CollisionObject co;
+        if (world->hasObject(name))
+        {
+#if ROBOWFLEX_AT_LEAST_MELODIC
+            if (not scene_->getCollisionObjectMsg(co, name))
+                return false;
+#else
+            return false;
+#endif
+        }
+        else
+        {
+            co.id = name;
+            co.header.frame_id = root;
+            co.operation = moveit_msgs::CollisionObject::REMOVE;
+        }
+
+        msg.world.collision_objects.emplace_back(co);
+    }
+
+    if (state)
+    {
+        moveit::core::robotStateToRobotStateMsg(scene_->getCurrentState(), msg.robot_state, true);
+        msg.robot_state.is_diff = true;
+
+        // A diff state keeps its attached objects unless they are explicitly removed.
+        for (const auto &name : detached)
+        {
+            if (scene_->getCurrentState().hasAttachedBody(name))
+                continue;
+
+            moveit_msgs::AttachedCollisionObject aco;
+            aco.object.id = name;
+            aco.object.operation = moveit_msgs::CollisionObject::REMOVE;
+            msg.robot_state.attached_collision_objects.emplace_back(aco);
+        }
+    }
+
+    if (acm)
+        scene_->getAllowedCollisionMatrix().getMessage(msg.allowed_collision_matrix);
+
+    fixCollisionObjectFrame(msg);
+    return true;
+}
+
+void Scene::recordChange(Change::Type type, const std::string &name)
+{
+    changes_.push_back(Change{type, name, getVersion()});
+
+    // Drop the oldest changes if the log grows too long.
+    while (changes_.size() > MAX_CHANGES)
+    {
+        changes_start_ = changes_.front().version;
+        changes_.pop_front();
+    }
+}
+
+void Scene::resetChanges()
+{
+    changes_.clear();
+    changes_start_ = getVersion();
+}
+
 void Scene::fixCollisionObjectFrame(moveit_msgs::PlanningScene &msg)
 {
     for (auto &co : msg.world.collision_objects)
@@ -236,12 +879,19 @@ void Scene::updateCollisionObject(const std::string &name, const GeometryConstPt
     if (world->hasObject(name))
     {
         if (!world->moveShapeInObject(name, geometry->getShape(), pose))
+        {
             world->removeObject(name);
+            recordChange(Change::REMOVED, name);
+        }
         else
+        {
+            recordChange(Change::MOVED, name);
             return;
+        }
     }
 
     world->addToObject(name, geometry->getShape(), pose);
+    recordChange(Change::ADDED, name);
 }
 
 std::vector<std::string> Scene::getCollisionObjects() const
@@ -256,7 +906,7 @@ GeometryPtr Scene::getObjectGeometry(const std::string &name) const
 
     const auto &obj = world->getObject(name);
     if (obj)
-        return std::make_shared<Geometry>(*obj->shapes_[0]);
+        return Geometry::makeShape(*obj->shapes_[0]);
 
     RBX_WARN("Object %s does not exist in scene!", name);
     return nullptr;
@@ -264,7 +914,10 @@ GeometryPtr Scene::getObjectGeometry(const std::string &name) const
 
 void Scene::removeCollisionObject(const std::string &name)
 {
-    scene_->getWorldNonConst()->removeObject(name);
+    incrementVersion();
+
+    if (scene_->getWorldNonConst()->removeObject(name))
+        recordChange(Change::REMOVED, name);
 }
 
 RobotPose Scene::getObjectPose(const std::string &name) const
@@ -313,7 +966,9 @@ bool Scene::moveObjectGlobal(const std::string &name, const RobotPose &transform
     const auto &world = scene_->getWorldNonConst();
     success = world->moveObject(name, transform);
 #endif
-    if (not success)
+    if (success)
+        recordChange(Change::MOVED, name);
+    else
         RBX_ERROR("Failed to move object %s", name);
 
     return success;
@@ -351,6 +1006,94 @@ bool Scene::setCollisionDetector(const std::string &detector_name) const
     return success;
 }
 
+std::vector<std::string> Scene::getCollisionDetectors() const
+{
+    return loader_->getDeclaredClasses();
+}
+
+std::vector<Scene::DetectorTiming>
+Scene::benchmarkCollisionDetectors(std::size_t n_states, const std::vector<double> &percentiles, bool select,
+                                   const std::vector<std::string> &detectors) const
+{
+    using Clock = std::chrono::steady_clock;
+
+    const auto &names = (detectors.empty()) ? getCollisionDetectors() : detectors;
+    const std::string active = scene_->getActiveCollisionDetectorName();
+
+    random_numbers::RandomNumberGenerator rng(RNG::getSeed());
+    std::vector<robot_state::RobotState> states(n_states, getCurrentStateConst());
+    for (auto &state : states)
+    {
+        state.setToRandomPositions(rng);
+        state.update(true);
+    }
+
+    // Nearest-rank percentile of a sorted set of times.
+    const auto &percentile = [](const std::vector<double> &times, double p) {
+        if (times.empty())
+            return 0.;
+
+        const auto i = static_cast<std::size_t>(std::lround(p * (times.size() - 1)));
+        return times[std::min(i, times.size() - 1)];
+    };
+
+    std::vector<DetectorTiming> timings;
+    for (const auto &name : names)
+    {
+        if (not loader_->activate(name, scene_, true))
+        {
+            RBX_WARN("Was not able to load collision detector plugin '%s'", name);
+            continue;
+        }
+
+        std::vector<double> check(n_states);
+        std::vector<double> distance(n_states);
+        for (std::size_t i = 0; i < n_states; ++i)
+        {
+            const auto c = Clock::now();
+            checkCollision(states[i]);
+            const auto d = Clock::now();
+            distanceToCollision(states[i]);
+            const auto e = Clock::now();
+
+            check[i] = std::chrono::duration<double>(d - c).count();
+            distance[i] = std::chrono::duration<double>(e - d).count();
+        }
+
+        DetectorTiming timing;
+        timing.detector = name;
+        timing.total = std::accumulate(check.begin(), check.end(), 0.) +
+                       std::accumulate(distance.begin(), distance.end(), 0.);
+
+        std::sort(check.begin(), check.end());
+        std::sort(distance.begin(), distance.end());
+        for (const auto &p : percentiles)
+        {
+            timing.check.emplace_back(percentile(check, p));
+            timing.distance.emplace_back(percentile(distance, p));
+        }
+
+        RBX_INFO("Collision detector %s: %d states in %f seconds (median check %f, median distance %f)",
+                 name, n_states, timing.total, percentile(check, 0.5), percentile(distance, 0.5));
+
+        timings.emplace_back(timing);
+    }
+
+    std::string use = active;
+    if (select and not timings.empty())
+    {
+        const auto &best = std::min_element(
+            timings.begin(), timings.end(),
+            [](const DetectorTiming &a, const DetectorTiming &b) { return a.total < b.total; });
+        use = best->detector;
+    }
+
+    if (scene_->getActiveCollisionDetectorName() != use)
+        setCollisionDetector(use);
+
+    return timings;
+}
+
 bool Scene::attachObjectToState(robot_state::RobotState &state, const std::string &name) const
 {
     const auto &robot = state.getRobotModel();
@@ -410,6 +1153,7 @@ bool Scene::attachObject(robot_state::RobotState &state, const std::string &name
     if (attachObjectToState(state, name))
     {
         removeCollisionObject(name);
+        recordChange(Change::ATTACHED, name);
         return true;
     }
 
@@ -422,6 +1166,7 @@ bool Scene::attachObject(robot_state::RobotState &state, const std::string &name
     if (attachObjectToState(state, name, ee_link, touch_links))
     {
         removeCollisionObject(name);
+        recordChange(Change::ATTACHED, name);
         return true;
     }
 
@@ -454,29 +1199,330 @@ bool Scene::detachObject(robot_state::RobotState &state, const std::string &name
 
     world->addToObject(name, body->getShapes(), body->getGlobalCollisionBodyTransforms());
 
+    recordChange(Change::ADDED, name);
+
     if (not state.clearAttachedBody(name))
     {
         RBX_ERROR("Could not detach object `%s`", name);
         return false;
     }
 
+    recordChange(Change::DETACHED, name);
     return true;
 }
 
+Eigen::AlignedBox3d Scene::getObjectAABB(const std::string &name) const
+{
+    const auto &obj = scene_->getWorld()->getObject(name);
+    if (not obj)
+    {
+        RBX_WARN("Object %s does not exist in scene!", name);
+        return Eigen::AlignedBox3d();
+    }
+
+    return computeObjectAABB(*obj);
+}
+
+std::vector<std::string> Scene::getObjectsInBox(const Eigen::AlignedBox3d &box) const
+{
+    std::unique_lock<std::mutex> lock(object_index_->mutex);
+    updateObjectIndex();
+
+    return object_index_->query([&box](const Eigen::AlignedBox3d &other) { return box.intersects(other); });
+}
+
+std::vector<std::string> Scene::getObjectsInRadius(const Eigen::Vector3d &center, double radius) const
+{
+    std::unique_lock<std::mutex> lock(object_index_->mutex);
+    updateObjectIndex();
+
+    const double r2 = radius * radius;
+    return object_index_->query([&center, r2](const Eigen::AlignedBox3d &other) {
+        return other.squaredExteriorDistance(center) <= r2;
+    });
+}
+
+std::vector<std::string> Scene::getObjectsNearLink(const robot_state::RobotState &state,
+                                                   const std::string &link, double radius) const
+{
+    const auto &model = state.getRobotModel()->getLinkModel(link);
+    if (not model or model->getShapes().empty())
+    {
+        RBX_ERROR("Link `%s` has no collision geometry", link);
+        return {};
+    }
+
+    const auto &origins = model->getCollisionOriginTransforms();
+    const auto &pose = state.getGlobalLinkTransform(model);
+
+    RobotPoseVector poses(origins.size());
+    for (std::size_t i = 0; i < origins.size(); ++i)
+        poses[i] = pose * origins[i];
+
+    const auto &box = computeShapesAABB(model->getShapes(), poses);
+
+    std::unique_lock<std::mutex> lock(object_index_->mutex);
+    updateObjectIndex();
+
+    const double r2 = radius * radius;
+    return object_index_->query([&box, r2](const Eigen::AlignedBox3d &other) {
+        return other.squaredExteriorDistance(box) <= r2;
+    });
+}
+
+ScenePtr Scene::crop(const Eigen::AlignedBox3d &box) const
+{
+    return cropToObjects(getObjectsInBox(box));
+}
+
+ScenePtr Scene::cropToWorkspace(const moveit_msgs::WorkspaceParameters &workspace, double padding) const
+{
+    const Eigen::Vector3d min(workspace.min_corner.x, workspace.min_corner.y, workspace.min_corner.z);
+    const Eigen::Vector3d max(workspace.max_corner.x, workspace.max_corner.y, workspace.max_corner.z);
+    const Eigen::AlignedBox3d local(min, max);
+
+    Eigen::AlignedBox3d box;
+    const auto &frame = workspace.header.frame_id;
+    if (frame.empty() or frame == scene_->getPlanningFrame())
+        box = local;
+    else
+    {
+        const auto &pose = getFramePose(frame);
+        for (std::size_t i = 0; i < 8; ++i)
+            box.extend(pose * local.corner(static_cast<Eigen::AlignedBox3d::CornerType>(i)));
+    }
+
+    box.min() -= Eigen::Vector3d::Constant(padding);
+    box.max() += Eigen::Vector3d::Constant(padding);
+
+    return crop(box);
+}
+
+ScenePtr Scene::cropToObjects(const std::vector<std::string> &objects) const
+{
+    auto scene = snapshot();
+
+    const std::set<std::string> keep(objects.begin(), objects.end());
+    for (const auto &name : getCollisionObjects())
+        if (keep.find(name) == keep.end())
+            scene->removeCollisionObject(name);
+
+    return scene;
+}
+
+void Scene::updateObjectIndex() const
+{
+    auto &index = *object_index_;
+    if (index.valid and index.version == getVersion())
+        return;
+
+    const auto &world = scene_->getWorld();
+
+    std::vector<Change> changes;
+    if (index.valid and getChanges(index.version, changes))
+    {
+        // Only refresh the boxes of objects that have changed.
+        bool changed = false;
+        for (const auto &change : changes)
+        {
+            if (change.name.empty())
+                continue;
+
+            changed = true;
+            const auto &obj = world->getObject(change.name);
+            if (obj)
+                index.boxes[change.name] = computeObjectAABB(*obj);
+            else
+                index.boxes.erase(change.name);
+        }
+
+        index.version = getVersion();
+        if (not changed)
+            return;
+    }
+    else
+    {
+        index.boxes.clear();
+        for (const auto &name : world->getObjectIds())
+            index.boxes.emplace(name, computeObjectAABB(*world->getObject(name)));
+
+        index.valid = true;
+        index.version = getVersion();
+    }
+
+    index.build();
+}
+
 collision_detection::CollisionResult Scene::checkCollision(
     const robot_state::RobotState &state, const collision_detection::CollisionRequest &request) const
 {
+    RBX_TRACE("Scene::checkCollision");
+
     collision_detection::CollisionResult result;
     scene_->checkCollision(request, result, state);
 
     return result;
 }
 
+collision_detection::CollisionResult
+Scene::checkGroupCollision(const robot_state::RobotState &state, const std::string &group,
+                           const collision_detection::CollisionRequest &request) const
+{
+    collision_detection::CollisionRequest group_request = request;
+    group_request.group_name = group;
+
+    collision_detection::CollisionResult result;
+    scene_->checkCollision(group_request, result, state, *getGroupACM(group));
+
+    return result;
+}
+
+std::shared_ptr<const collision_detection::AllowedCollisionMatrix>
+Scene::getGroupACM(const std::string &group) const
+{
+    std::unique_lock<std::mutex> lock(distance_cache_->mutex);
+
+    auto &cache = *distance_cache_;
+    cache.refresh(getKey());
+
+    auto it = cache.groups.find(group);
+    if (it != cache.groups.end())
+        return it->second;
+
+    const auto &model = scene_->getRobotModel();
+    const auto &jmg = model->getJointModelGroup(group);
+
+    auto sit = cache.static_pairs.find(group);
+    if (jmg and sit == cache.static_pairs.end())
+    {
+        // Find the rigid body each moved link belongs to, by walking up fixed joints.
+        std::map<const robot_model::LinkModel *, const robot_model::LinkModel *> bodies;
+        for (const auto &link : jmg->getUpdatedLinkModelsWithGeometry())
+        {
+            auto body = link;
+            while (body->getParentLinkModel() and
+                   body->getParentJointModel()->getType() == robot_model::JointModel::FIXED)
+                body = body->getParentLinkModel();
+
+            bodies.emplace(link, body);
+        }
+
+        // Find the pairs in collision in the default state, as those are always in collision. Nothing is
+        // allowed here, so the pairs do not depend on the scene's current allowed collision matrix.
+        robot_state::RobotState state(model);
+        state.setToDefaultValues();
+        state.update(true);
+
+        collision_detection::CollisionRequest request;
+        request.contacts = true;
+        request.max_contacts = bodies.size() * bodies.size();
+        request.max_contacts_per_pair = 1;
+
+        collision_detection::CollisionResult result;
+        scene_->checkSelfCollision(request, result, state, collision_detection::AllowedCollisionMatrix());
+
+        std::vector<std::pair<std::string, std::string>> pairs;
+        for (auto a = bodies.begin(); a != bodies.end(); ++a)
+            for (auto b = std::next(a); b != bodies.end(); ++b)
+            {
+                if (a->second != b->second)
+                    continue;
+
+                const auto &one = a->first->getName();
+                const auto &two = b->first->getName();
+                if (result.contacts.count(std::make_pair(one, two)) or
+                    result.contacts.count(std::make_pair(two, one)))
+                    continue;
+
+                pairs.emplace_back(one, two);
+            }
+
+        sit = cache.static_pairs.emplace(group, pairs).first;
+    }
+
+    auto acm =
+        std::make_shared<collision_detection::AllowedCollisionMatrix>(scene_->getAllowedCollisionMatrix());
+    if (jmg)
+        for (const auto &pair : sit->second)
+            acm->setEntry(pair.first, pair.second, true);
+    else
+        RBX_WARN("Group `%s` does not exist, checking the whole robot.", group);
+
+    cache.groups.emplace(group, acm);
+    return acm;
+}
+
 double Scene::distanceToCollision(const robot_state::RobotState &state) const
 {
     return scene_->distanceToCollision(state);
 }
 
+void Scene::useDistanceField(double resolution, double max_distance)
+{
+    std::unique_lock<std::mutex> lock(distance_cache_->mutex);
+    field_resolution_ = resolution;
+    field_max_distance_ = max_distance;
+
+    distance_cache_->field_key = ID::getNullKey();
+    distance_cache_->field.reset();
+}
+
+void Scene::useSphereModel(const SphereModelConstPtr &model)
+{
+    if (model and model->getRobotModel() != scene_->getRobotModel())
+        throw Exception(1, "Sphere model is for a different robot than the scene!");
+
+    sphere_model_ = model;
+}
+
+const SphereModelConstPtr &Scene::getSphereModel() const
+{
+    return sphere_model_;
+}
+
+DistanceFieldConstPtr Scene::getDistanceField() const
+{
+    std::unique_lock<std::mutex> lock(distance_cache_->mutex);
+    if (field_resolution_ <= 0.)
+        return nullptr;
+
+    const auto &key = getKey();
+    if (not distance_cache_->field or not compareIDs(distance_cache_->field_key, key))
+    {
+        distance_cache_->field =
+            std::make_shared<DistanceField>(*this, field_resolution_, field_max_distance_);
+        distance_cache_->field_key = key;
+    }
+
+    return distance_cache_->field;
+}
+
+double Scene::getClearance(const robot_state::RobotState &state) const
+{
+    if (const auto &field = getDistanceField())
+        return (sphere_model_) ? sphere_model_->getDistance(*field, state) : field->getDistance(state);
+
+    return distanceToCollision(state);
+}
+
+std::vector<double> Scene::getClearances(const std::vector<robot_state::RobotStateConstPtr> &states,
+                                         const Pool &pool) const
+{
+    const auto &field = getDistanceField();
+
+    std::vector<double> clearances(states.size());
+    pool.parallelFor(0, states.size(), [&](std::size_t i) {
+        if (not field)
+            clearances[i] = distanceToCollision(*states[i]);
+        else if (sphere_model_)
+            clearances[i] = sphere_model_->getDistance(*field, *states[i]);
+        else
+            clearances[i] = field->getDistance(*states[i]);
+    });
+
+    return clearances;
+}
+
 double Scene::distanceACM(const robot_state::RobotState &state,
                           const collision_detection::AllowedCollisionMatrix &acm) const
 {
@@ -514,6 +1560,47 @@ void Scene::clearACM(collision_detection::AllowedCollisionMatrix &acm) const
             acm.setEntry(link, obj, true);
 }
 
+std::shared_ptr<const collision_detection::AllowedCollisionMatrix> Scene::getClearedACM() const
+{
+    auto &cache = *distance_cache_;
+    cache.refresh(getKey());
+
+    if (not cache.cleared)
+    {
+        // Default entries allow everything with O(links + objects) entries, rather than setting every pair
+        // as in clearACM().
+        auto acm = std::make_shared<collision_detection::AllowedCollisionMatrix>();
+        for (const auto &link : getCurrentStateConst().getRobotModel()->getLinkModelNames())
+            acm->setDefaultEntry(link, true);
+
+        for (const auto &obj : getCollisionObjects())
+            acm->setDefaultEntry(obj, true);
+
+        cache.cleared = acm;
+    }
+
+    return cache.cleared;
+}
+
+std::shared_ptr<const collision_detection::AllowedCollisionMatrix>
+Scene::getObjectACM(const std::string &object) const
+{
+    const auto &cleared = getClearedACM();
+
+    auto &cache = *distance_cache_;
+    auto it = cache.objects.find(object);
+    if (it != cache.objects.end())
+        return it->second;
+
+    // Enable collision to the object of interest
+    auto acm = std::make_shared<collision_detection::AllowedCollisionMatrix>(*cleared);
+    for (const auto &link : getCurrentStateConst().getRobotModel()->getLinkModelNames())
+        acm->setEntry(link, object, false);
+
+    cache.objects.emplace(object, acm);
+    return acm;
+}
+
 double Scene::distanceToObject(const robot_state::RobotState &state, const std::string &object) const
 {
     if (not hasObject(object))
@@ -522,14 +1609,39 @@ double Scene::distanceToObject(const robot_state::RobotState &state, const std::
         return std::numeric_limits<double>::quiet_NaN();
     }
 
-    collision_detection::AllowedCollisionMatrix acm;
-    clearACM(acm);
+    std::shared_ptr<const collision_detection::AllowedCollisionMatrix> acm;
+    {
+        std::unique_lock<std::mutex> lock(distance_cache_->mutex);
+        acm = getObjectACM(object);
+    }
 
-    // Enable collision to the object of interest
-    for (const auto &link : getCurrentStateConst().getRobotModel()->getLinkModelNames())
-        acm.setEntry(link, object, false);
+    return distanceACM(state, *acm);
+}
+
+std::vector<double>
+Scene::distanceToObjects(const std::vector<std::pair<robot_state::RobotStateConstPtr, std::string>> &queries,
+                         const Pool &pool) const
+{
+    const std::size_t n = queries.size();
+    std::vector<std::shared_ptr<const collision_detection::AllowedCollisionMatrix>> acms(n);
+    {
+        std::unique_lock<std::mutex> lock(distance_cache_->mutex);
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            if (hasObject(queries[i].second))
+                acms[i] = getObjectACM(queries[i].second);
+            else
+                RBX_ERROR("World does not have object `%s`", queries[i].second);
+        }
+    }
+
+    std::vector<double> distances(n, std::numeric_limits<double>::quiet_NaN());
+    pool.parallelFor(0, n, [&](std::size_t i) {
+        if (acms[i])
+            distances[i] = distanceACM(*queries[i].first, *acms[i]);
+    });
 
-    return distanceACM(state, acm);
+    return distances;
 }
 
 double Scene::distanceBetweenObjects(const std::string &one, const std::string &two) const
@@ -549,41 +1661,111 @@ double Scene::distanceBetweenObjects(const std::string &one, const std::string &
         return std::numeric_limits<double>::quiet_NaN();
     }
 
-    robot_state::RobotState copy = getCurrentStateConst();
-    attachObjectToState(copy, one);
+    Robot::StateLease copy(scene_->getRobotModel());
+    *copy = getCurrentStateConst();
+    attachObjectToState(*copy, one);
 
     collision_detection::AllowedCollisionMatrix acm;
     clearACM(acm);
     acm.setEntry(one, one, true);
     acm.setEntry(one, two, false);
 
-    return distanceACM(copy, acm);
+    return distanceACM(*copy, acm);
+}
+
+std::vector<double>
+Scene::distancesBetweenObjects(const std::vector<std::pair<std::string, std::string>> &pairs,
+                               const Pool &pool) const
+{
+    const std::size_t n = pairs.size();
+    std::vector<double> distances(n, std::numeric_limits<double>::quiet_NaN());
+
+    std::shared_ptr<const collision_detection::AllowedCollisionMatrix> cleared;
+    {
+        std::unique_lock<std::mutex> lock(distance_cache_->mutex);
+        cleared = getClearedACM();
+    }
+
+    // Attach each first object to its own copy of the current state, once, and build each pair's ACM.
+    std::map<std::string, robot_state::RobotStatePtr> attached;
+    std::vector<std::shared_ptr<collision_detection::AllowedCollisionMatrix>> acms(n);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        const auto &one = pairs[i].first;
+        const auto &two = pairs[i].second;
+
+        if (one == two)  // Early terminate if they are the same
+        {
+            distances[i] = 0.;
+            continue;
+        }
+
+        if (not hasObject(one) or not hasObject(two))
+        {
+            RBX_ERROR("World does not have object `%s`", (hasObject(one)) ? two : one);
+            continue;
+        }
+
+        auto &state = attached[one];
+        if (not state)
+        {
+            state = std::make_shared<robot_state::RobotState>(getCurrentStateConst());
+            attachObjectToState(*state, one);
+        }
+
+        acms[i] = std::make_shared<collision_detection::AllowedCollisionMatrix>(*cleared);
+        acms[i]->setEntry(one, two, false);
+    }
+
+    pool.parallelFor(0, n, [&](std::size_t i) {
+        if (acms[i])
+            distances[i] = distanceACM(*attached.at(pairs[i].first), *acms[i]);
+    });
+
+    return distances;
 }
 
 moveit::core::GroupStateValidityCallbackFn Scene::getGSVCF(bool verbose) const
 {
-    return [this, verbose](robot_state::RobotState *state,            //
-                           const moveit::core::JointModelGroup *jmg,  //
-                           const double *values)                      //
+    return StateValidityChecker(*this, verbose).getGSVCF();
+}
+
+StateValidityCheckerPtr Scene::getValidityChecker(bool verbose, bool group_only) const
+{
+    return std::make_shared<StateValidityChecker>(*this, verbose, group_only);
+}
+
+std::vector<bool> Scene::areValid(const std::vector<robot_state::RobotStateConstPtr> &states,
+                                  const Pool &pool, const std::string &group) const
+{
+    const moveit::core::JointModelGroup *jmg = nullptr;
+    if (not group.empty())
     {
-        state->setJointGroupPositions(jmg, values);
-        state->updateCollisionBodyTransforms();
+        const auto &model = scene_->getRobotModel();
+        if (not model->hasJointModelGroup(group))
+        {
+            RBX_ERROR("Robot does not have group `%s`", group);
+            return std::vector<bool>(states.size(), false);
+        }
 
-        collision_detection::CollisionRequest request;
-        request.verbose = verbose;
+        jmg = model->getJointModelGroup(group);
+    }
 
-        auto result = this->checkCollision(*state, request);
-        return not result.collision;
-    };
+    // Results are written as chars, as threads cannot write neighbouring elements of a bit vector.
+    const StateValidityChecker checker(*this);
+    std::vector<char> valid(states.size(), false);
+    pool.parallelFor(0, states.size(), [&](std::size_t i) { valid[i] = checker.isValid(*states[i], jmg); });
+
+    return std::vector<bool>(valid.begin(), valid.end());
 }
 
-bool Scene::toYAMLFile(const std::string &file) const
+bool Scene::toYAMLFile(const std::string &file, bool octomap_sidecar) const
 {
-    moveit_msgs::PlanningScene msg;
-    scene_->getPlanningSceneMsg(msg);
+    if (IO::isBinaryFile(file))
+        return IO::writeBinaryFile(file, ros::message_traits::md5sum<moveit_msgs::PlanningScene>(),
+                                   *getSerializedMessage());
 
-    YAML::Node node = IO::toNode(msg);
-    return IO::YAMLToFile(node, file);
+    return IO::toYAMLFile(*getMessageConst(), file, octomap_sidecar);
 }
 
 bool Scene::fromYAMLFile(const std::string &file)
@@ -620,3 +1802,95 @@ bool Scene::fromOpenRAVEXMLFile(const std::string &file, std::string models_dir)
     scene_->usePlanningSceneMsg(msg);
     return true;
 }
+
+bool Scene::fromOpenRAVEXMLFile(const std::string &file, const Pool &pool, const std::string &cache_directory,
+                                std::string models_dir)
+{
+    if (models_dir.empty())
+        models_dir = IO::resolveParent(file);
+
+    moveit_msgs::PlanningScene msg;
+    if (not openrave::fromXMLFile(msg, file, models_dir, pool, cache_directory))
+        return false;
+
+    scene_->usePlanningSceneMsg(msg);
+    return true;
+}
+
+///
+/// StateValidityChecker
+///
+
+StateValidityChecker::StateValidityChecker(const Scene &scene, bool verbose, bool group_only)
+  : scene_(&scene), verbose_(verbose), group_only_(group_only), spheres_(scene.getSphereModel())
+{
+}
+
+bool StateValidityChecker::isValid(const robot_state::RobotState &state,
+                                   const moveit::core::JointModelGroup *jmg) const
+{
+    return check(state, jmg);
+}
+
+bool StateValidityChecker::operator()(robot_state::RobotState *state,
+                                      const moveit::core::JointModelGroup *jmg, const double *values) const
+{
+    state->setJointGroupPositions(jmg, values);
+    state->updateCollisionBodyTransforms();
+
+    return check(*state, (group_only_) ? jmg : nullptr);
+}
+
+moveit::core::GroupStateValidityCallbackFn StateValidityChecker::getGSVCF() const
+{
+    const auto checker = *this;
+    return [checker](robot_state::RobotState *state,            //
+                     const moveit::core::JointModelGroup *jmg,  //
+                     const double *values)                      //
+    { return checker(state, jmg, values); };
+}
+
+bool StateValidityChecker::check(const robot_state::RobotState &state,
+                                 const moveit::core::JointModelGroup *jmg) const
+{
+    // Reused between checks on each thread, rather than constructed for every check.
+    thread_local collision_detection::CollisionRequest request;
+    thread_local collision_detection::CollisionResult result;
+
+    request.verbose = verbose_;
+    result.clear();
+
+    const auto &scene = scene_->getSceneConst();
+
+    // If the robot is certainly clear of the world, only collisions with itself remain. The distance field
+    // is fetched for every check, as the scene may have changed since the checker was made (e.g., in a
+    // planning context kept across object changes). It is cached per version of the scene.
+    if (spheres_ and spheres_->isClear(*scene_, state, jmg))
+    {
+        if (jmg)
+        {
+            request.group_name = jmg->getName();
+            scene->checkSelfCollision(request, result, state, *scene_->getGroupACM(request.group_name));
+        }
+        else
+        {
+            request.group_name.clear();
+            scene->checkSelfCollision(request, result, state);
+        }
+
+        return not result.collision;
+    }
+
+    if (jmg)
+    {
+        request.group_name = jmg->getName();
+        scene->checkCollision(request, result, state, *scene_->getGroupACM(request.group_name));
+    }
+    else
+    {
+        request.group_name.clear();
+        scene->checkCollision(request, result, state);
+    }
+
+    return not result.collision;
+}
@@ -0,0 +1,299 @@
+/* Author: Zachary Kingston */
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <geometric_shapes/shape_operations.h>
+
+#include <robowflex_library/distance_field.h>
+#include <robowflex_library/log.h>
+#include <robowflex_library/scene.h>
+#include <robowflex_library/sphere_model.h>
+#include <robowflex_library/util.h>
+
+using namespace robowflex;
+
+namespace
+{
+    /** \brief Get the number of cells of a grid along an axis.
+     *  \param[in] size Length of the axis.
+     *  \param[in] resolution Maximum edge length of the cells.
+     *  \return The number of cells.
+     */
+    int getCellCount(double size, double resolution)
+    {
+        return std::max(1, static_cast<int>(std::ceil(size / resolution)));
+    }
+
+    /** \brief Add the spheres circumscribing the marked cells of a grid.
+     *  \param[in] lower Lower corner of the grid.
+     *  \param[in] cell Edge lengths of a cell.
+     *  \param[in] dims Number of cells along each axis.
+     *  \param[in] marked Which cells to add, in x-major order. If empty, adds every cell.
+     *  \param[in] padding Padding added to the radius of every sphere.
+     *  \param[out] spheres Spheres to add to.
+     */
+    void addCellSpheres(const Eigen::Vector3d &lower, const Eigen::Vector3d &cell, const Eigen::Array3i &dims,
+                        const std::vector<char> &marked, double padding,
+                        std::vector<SphereModel::Sphere> &spheres)
+    {
+        const double radius = cell.norm() / 2 + padding;
+        for (int i = 0; i < dims[0]; ++i)
+            for (int j = 0; j < dims[1]; ++j)
+                for (int k = 0; k < dims[2]; ++k)
+                {
+                    if (not marked.empty() and not marked[(i * dims[1] + j) * dims[2] + k])
+                        continue;
+
+                    const Eigen::Vector3d index(i + 0.5, j + 0.5, k + 0.5);
+                    spheres.push_back({lower + index.cwiseProduct(cell), radius});
+                }
+    }
+
+    /** \brief Add spheres covering the triangles of a mesh.
+     *  \param[in] mesh Mesh to cover.
+     *  \param[in] options Options for generating spheres.
+     *  \param[out] spheres Spheres to add to.
+     */
+    void coverMesh(const shapes::Mesh &mesh, const SphereModel::Options &options,
+                   std::vector<SphereModel::Sphere> &spheres)
+    {
+        if (mesh.vertex_count == 0 or mesh.triangle_count == 0)
+            return;
+
+        Eigen::Map<const Eigen::Matrix3Xd> vertices(mesh.vertices, 3, mesh.vertex_count);
+        const Eigen::Vector3d lower = vertices.rowwise().minCoeff();
+        const Eigen::Vector3d size = vertices.rowwise().maxCoeff() - lower;
+
+        Eigen::Array3i dims;
+        Eigen::Vector3d cell;
+        for (int a = 0; a < 3; ++a)
+        {
+            dims[a] = getCellCount(size[a], options.resolution);
+            cell[a] = std::max(size[a], 1e-9) / dims[a];
+        }
+
+        const auto index = [&](const Eigen::Vector3d &point, int a) {
+            return std::min(dims[a] - 1, std::max(0, static_cast<int>((point[a] - lower[a]) / cell[a])));
+        };
+
+        // Mark every cell that the bounding box of a triangle overlaps.
+        std::vector<char> marked(dims.prod(), false);
+        for (unsigned int t = 0; t < mesh.triangle_count; ++t)
+        {
+            Eigen::Vector3d tmin = vertices.col(mesh.triangles[3 * t]);
+            Eigen::Vector3d tmax = tmin;
+            for (int v = 1; v < 3; ++v)
+            {
+                tmin = tmin.cwiseMin(vertices.col(mesh.triangles[3 * t + v]));
+                tmax = tmax.cwiseMax(vertices.col(mesh.triangles[3 * t + v]));
+            }
+
+            for (int i = index(tmin, 0); i <= index(tmax, 0); ++i)
+                for (int j = index(tmin, 1); j <= index(tmax, 1); ++j)
+                    for (int k = index(tmin, 2); k <= index(tmax, 2); ++k)
+                        marked[(i * dims[1] + j) * dims[2] + k] = true;
+        }
+
+        addCellSpheres(lower, cell, dims, marked, options.padding, spheres);
+    }
+}  // namespace
+
+///
+/// SphereModel
+///
+
+SphereModel::SphereModel(const robot_model::RobotModelConstPtr &model) : SphereModel(model, Options())
+{
+}
+
+SphereModel::SphereModel(const robot_model::RobotModelConstPtr &model, const Options &options)
+  : model_(model), options_(options), links_(model->getLinkModelCount())
+{
+    if (options_.resolution <= 0)
+        throw Exception(1, log::format("Sphere resolution must be positive, got %1%!", options_.resolution));
+
+    for (const auto *link : model_->getLinkModelsWithCollisionGeometry())
+    {
+        auto &spheres = links_[link->getLinkIndex()];
+
+        const auto &shapes = link->getShapes();
+        const auto &origins = link->getCollisionOriginTransforms();
+        for (std::size_t i = 0; i < shapes.size(); ++i)
+            for (const auto &sphere : coverShape(*shapes[i], options_))
+                spheres.push_back({origins[i] * sphere.center, sphere.radius});
+
+        count_ += spheres.size();
+    }
+}
+
+const robot_model::RobotModelConstPtr &SphereModel::getRobotModel() const
+{
+    return model_;
+}
+
+const std::vector<SphereModel::Sphere> &SphereModel::getSpheres(const robot_model::LinkModel *link) const
+{
+    return links_[link->getLinkIndex()];
+}
+
+std::size_t SphereModel::getSphereCount() const
+{
+    return count_;
+}
+
+std::vector<SphereModel::Sphere> SphereModel::getSpheres(const robot_state::RobotState &state,
+                                                         const moveit::core::JointModelGroup *jmg) const
+{
+    const auto &links = (jmg) ? jmg->getUpdatedLinkModelsWithGeometry() :
+                                model_->getLinkModelsWithCollisionGeometry();
+
+    std::vector<Sphere> spheres;
+    for (const auto *link : links)
+    {
+        const auto &pose = state.getGlobalLinkTransform(link);
+        for (const auto &sphere : links_[link->getLinkIndex()])
+            spheres.push_back({pose * sphere.center, sphere.radius});
+    }
+
+    std::vector<const robot_state::AttachedBody *> bodies;
+    state.getAttachedBodies(bodies);
+    for (const auto *body : bodies)
+    {
+        if (jmg and not jmg->isLinkUpdated(body->getAttachedLinkName()))
+            continue;
+
+        const auto &shapes = body->getShapes();
+        const auto &poses = body->getGlobalCollisionBodyTransforms();
+        for (std::size_t i = 0; i < shapes.size(); ++i)
+            for (const auto &sphere : getAttachedSpheres(shapes[i]))
+                spheres.push_back({poses[i] * sphere.center, sphere.radius});
+    }
+
+    return spheres;
+}
+
+bool SphereModel::isClear(const Scene &scene, const robot_state::RobotState &state,
+                          const moveit::core::JointModelGroup *jmg) const
+{
+    return isClear(scene, scene.getDistanceField().get(), state, jmg);
+}
+
+bool SphereModel::isClear(const Scene &scene, const DistanceField *field,
+                          const robot_state::RobotState &state,
+                          const moveit::core::JointModelGroup *jmg) const
+{
+    const auto &spheres = getSpheres(state, jmg);
+    if (spheres.empty())
+        return true;
+
+    // The distance field does not include octomaps, so it can only be used without one.
+    if (field and not scene.hasObject(planning_scene::PlanningScene::OCTOMAP_NS))
+    {
+        const double margin = field->getResolution();
+        for (const auto &sphere : spheres)
+            if (field->getDistance(sphere.center) <= sphere.radius + margin)
+                return false;
+
+        return true;
+    }
+
+    // Check the bounds of all spheres first, as most states are far from most objects.
+    Eigen::AlignedBox3d box;
+    for (const auto &sphere : spheres)
+    {
+        box.extend(sphere.center - Eigen::Vector3d::Constant(sphere.radius));
+        box.extend(sphere.center + Eigen::Vector3d::Constant(sphere.radius));
+    }
+
+    if (scene.getObjectsInBox(box).empty())
+        return true;
+
+    for (const auto &sphere : spheres)
+        if (not scene.getObjectsInRadius(sphere.center, sphere.radius).empty())
+            return false;
+
+    return true;
+}
+
+double SphereModel::getDistance(const DistanceField &field, const robot_state::RobotState &state,
+                                const moveit::core::JointModelGroup *jmg) const
+{
+    double distance = field.getMaxDistance();
+    for (const auto &sphere : getSpheres(state, jmg))
+        distance = std::min(distance, field.getDistance(sphere.center) - sphere.radius);
+
+    return distance;
+}
+
+std::vector<SphereModel::Sphere> SphereModel::coverShape(const shapes::Shape &shape, const Options &options)
+{
+    std::vector<Sphere> spheres;
+    switch (shape.type)
+    {
+        case shapes::SPHERE:
+        {
+            const auto &sphere = static_cast<const shapes::Sphere &>(shape);
+            spheres.push_back({Eigen::Vector3d::Zero(), sphere.radius + options.padding});
+            break;
+        }
+
+        case shapes::BOX:
+        {
+            const auto &box = static_cast<const shapes::Box &>(shape);
+            const Eigen::Vector3d size(box.size[0], box.size[1], box.size[2]);
+
+            Eigen::Array3i dims;
+            for (int a = 0; a < 3; ++a)
+                dims[a] = getCellCount(size[a], options.resolution);
+
+            const Eigen::Vector3d cell = size.array() / dims.cast<double>();
+            addCellSpheres(-size / 2, cell, dims, {}, options.padding, spheres);
+            break;
+        }
+
+        case shapes::CYLINDER:
+        {
+            const auto &cylinder = static_cast<const shapes::Cylinder &>(shape);
+            const int n = getCellCount(cylinder.length, options.resolution);
+            const double half = cylinder.length / (2 * n);
+            const double radius = std::hypot(cylinder.radius, half) + options.padding;
+
+            for (int i = 0; i < n; ++i)
+                spheres.push_back({Eigen::Vector3d(0, 0, -cylinder.length / 2 + (2 * i + 1) * half), radius});
+            break;
+        }
+
+        case shapes::MESH:
+            coverMesh(static_cast<const shapes::Mesh &>(shape), options, spheres);
+            break;
+
+        case shapes::PLANE:
+            // Planes are unbounded, so any check with objects in the scene fails.
+            spheres.push_back({Eigen::Vector3d::Zero(), std::numeric_limits<double>::infinity()});
+            break;
+
+        default:
+        {
+            Sphere sphere;
+            shapes::computeShapeBoundingSphere(&shape, sphere.center, sphere.radius);
+            sphere.radius += options.padding;
+            spheres.emplace_back(sphere);
+            break;
+        }
+    }
+
+    return spheres;
+}
+
+const std::vector<SphereModel::Sphere> &
+SphereModel::getAttachedSpheres(const shapes::ShapeConstPtr &shape) const
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto it = attached_.find(shape);
+    if (it == attached_.end())
+        it = attached_.emplace(shape, coverShape(*shape, options_)).first;
+
+    return it->second;
+}
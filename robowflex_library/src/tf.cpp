@@ -259,6 +259,93 @@ RobotPose TF::samplePoseGaussian(const Eigen::Vector3d &pos_stddev, const Eigen:
     return sampled;
 }
 
+namespace
+{
+    /** \brief Convert XYZ Euler angles to quaternions.
+     *  \param[in] angles XYZ Euler angles, one set per column.
+     *  \param[out] quaternions Quaternion coefficients (x, y, z, w), one per column.
+     */
+    void eulerToQuaternions(const Eigen::Ref<const Eigen::Matrix3Xd> &angles,
+                            Eigen::Ref<Eigen::Matrix4Xd> quaternions)
+    {
+        const Eigen::Array3Xd half = 0.5 * angles.array();
+        const Eigen::Array3Xd c = half.cos();
+        const Eigen::Array3Xd s = half.sin();
+
+        // Expanded product of the X, Y, and Z axis rotation quaternions.
+        quaternions.row(0) = s.row(0) * c.row(1) * c.row(2) + c.row(0) * s.row(1) * s.row(2);
+        quaternions.row(1) = c.row(0) * s.row(1) * c.row(2) - s.row(0) * c.row(1) * s.row(2);
+        quaternions.row(2) = c.row(0) * c.row(1) * s.row(2) + s.row(0) * s.row(1) * c.row(2);
+        quaternions.row(3) = c.row(0) * c.row(1) * c.row(2) - s.row(0) * s.row(1) * s.row(2);
+    }
+
+    /** \brief Sample XYZ Euler angles uniformly over rotations within \a bounds. Batch version of
+     * RNG::uniformRPY().
+     *  \param[in] bounds Roll, pitch, and yaw bounds.
+     *  \param[out] angles Sampled angles, one set per column.
+     */
+    void sampleUniformRPY(const Eigen::Vector3d &bounds, Eigen::Ref<Eigen::Matrix3Xd> angles)
+    {
+        const Eigen::Vector3d lower(std::max(-constants::pi, -bounds[0]),             //
+                                    std::cos(std::max(-constants::half_pi, -bounds[1]) + constants::half_pi),
+                                    std::max(-constants::pi, -bounds[2]));
+        const Eigen::Vector3d upper(std::min(constants::pi, bounds[0]),               //
+                                    std::cos(std::min(constants::half_pi, bounds[1]) + constants::half_pi),
+                                    std::min(constants::pi, bounds[2]));
+
+        RNG::uniformVec(angles, lower, upper);
+        angles.row(1) = angles.row(1).array().acos() - constants::half_pi;
+    }
+}  // namespace
+
+void TF::sampleOrientations(const Eigen::Quaterniond &orientation, const Eigen::Vector3d &tolerances,
+                            Eigen::Ref<Eigen::Matrix4Xd> quaternions)
+{
+    Eigen::Matrix3Xd angles(3, quaternions.cols());
+    RNG::uniformVec(angles, -tolerances, tolerances);
+    eulerToQuaternions(angles, quaternions);
+
+    // Left multiply all samples by orientation.
+    const double x = orientation.x(), y = orientation.y(), z = orientation.z(), w = orientation.w();
+    const Eigen::Matrix4Xd q = quaternions;
+    quaternions.row(0) = w * q.row(0) + x * q.row(3) + y * q.row(2) - z * q.row(1);
+    quaternions.row(1) = w * q.row(1) - x * q.row(2) + y * q.row(3) + z * q.row(0);
+    quaternions.row(2) = w * q.row(2) + x * q.row(1) - y * q.row(0) + z * q.row(3);
+    quaternions.row(3) = w * q.row(3) - x * q.row(0) - y * q.row(1) - z * q.row(2);
+}
+
+void TF::sampleOrientationsUniform(const Eigen::Vector3d &tolerances,
+                                   Eigen::Ref<Eigen::Matrix4Xd> quaternions)
+{
+    Eigen::Matrix3Xd angles(3, quaternions.cols());
+    sampleUniformRPY(tolerances, angles);
+    eulerToQuaternions(angles, quaternions);
+}
+
+void TF::samplePositionsUniform(const Eigen::Vector3d &bounds, Eigen::Ref<Eigen::Matrix3Xd> positions)
+{
+    RNG::uniformVec(positions, -bounds, bounds);
+}
+
+void TF::samplePositionsGaussian(const Eigen::Vector3d &stddev, Eigen::Ref<Eigen::Matrix3Xd> positions)
+{
+    RNG::gaussianVec(positions, Eigen::Vector3d::Zero(), stddev);
+}
+
+void TF::samplePosesUniform(const Eigen::Vector3d &pos_bounds, const Eigen::Vector3d &orn_bounds,
+                            Eigen::Ref<Eigen::Matrix3Xd> positions, Eigen::Ref<Eigen::Matrix4Xd> quaternions)
+{
+    samplePositionsUniform(pos_bounds, positions);
+    sampleOrientationsUniform(orn_bounds, quaternions);
+}
+
+void TF::samplePosesGaussian(const Eigen::Vector3d &pos_stddev, const Eigen::Vector3d &orn_bounds,
+                             Eigen::Ref<Eigen::Matrix3Xd> positions, Eigen::Ref<Eigen::Matrix4Xd> quaternions)
+{
+    samplePositionsGaussian(pos_stddev, positions);
+    sampleOrientationsUniform(orn_bounds, quaternions);
+}
+
 geometry_msgs::TransformStamped TF::transformEigenToMsg(const std::string &source, const std::string &target,
                                                         const RobotPose &tf)
 {
@@ -1,13 +1,22 @@
 /* Author: Constantinos Chamzas, Zachary Kingston */
 
+#include <algorithm>
+#include <random>
+
 #include <robowflex_library/trajectory.h>
 
 #include <moveit/trajectory_processing/iterative_time_parameterization.h>
 
+#include <robowflex_library/macros.h>
+#if ROBOWFLEX_MOVEIT_VERSION >= ROBOWFLEX_MOVEIT_VERSION_COMPUTE(1, 0, 0)
+#include <moveit/trajectory_processing/time_optimal_trajectory_generation.h>
+#endif
+
 #include <robowflex_library/constants.h>
 #include <robowflex_library/io.h>
 #include <robowflex_library/io/yaml.h>
 #include <robowflex_library/log.h>
+#include <robowflex_library/pool.h>
 #include <robowflex_library/robot.h>
 #include <robowflex_library/scene.h>
 #include <robowflex_library/util.h>
@@ -15,31 +24,50 @@
 
 using namespace robowflex;
 
+/** \cond IGNORE */
+struct Trajectory::JointMatrix
+{
+    std::mutex mutex;                     ///< Guards the cache.
+    std::atomic<std::size_t> version{1};  ///< Incremented on every modification of the trajectory.
+    std::size_t cached{0};                ///< Version of the trajectory the cache was computed for.
+    const void *source{nullptr};          ///< Trajectory the cache was computed for.
+    Eigen::MatrixXd matrix;               ///< Cached joint positions.
+};
+/** \endcond */
+
 Trajectory::Trajectory(const RobotConstPtr &robot, const std::string &group)
   : trajectory_(new robot_trajectory::RobotTrajectory(robot->getModelConst(), group))
+  , matrix_(std::make_shared<JointMatrix>())
 {
 }
 
 Trajectory::Trajectory(const robot_trajectory::RobotTrajectory &trajectory)
-  : trajectory_(new robot_trajectory::RobotTrajectory(trajectory))
+  : trajectory_(new robot_trajectory::RobotTrajectory(trajectory)), matrix_(std::make_shared<JointMatrix>())
 {
 }
 
 Trajectory::Trajectory(robot_trajectory::RobotTrajectoryPtr trajectory)
-  : trajectory_(new robot_trajectory::RobotTrajectory(*trajectory))
+  : trajectory_(new robot_trajectory::RobotTrajectory(*trajectory)), matrix_(std::make_shared<JointMatrix>())
 {
 }
 
+void Trajectory::invalidate()
+{
+    matrix_->version++;
+}
+
 void Trajectory::useMessage(const robot_state::RobotState &reference_state,
                             const moveit_msgs::RobotTrajectory &msg)
 {
     trajectory_->setRobotTrajectoryMsg(reference_state, msg);
+    invalidate();
 }
 
 void Trajectory::useMessage(const robot_state::RobotState &reference_state,
                             const trajectory_msgs::JointTrajectory &msg)
 {
     trajectory_->setRobotTrajectoryMsg(reference_state, msg);
+    invalidate();
 }
 
 bool Trajectory::toYAMLFile(const std::string &filename) const
@@ -47,6 +75,9 @@ bool Trajectory::toYAMLFile(const std::string &filename) const
     moveit_msgs::RobotTrajectory msg;
     trajectory_->getRobotTrajectoryMsg(msg);
 
+    if (IO::isBinaryFile(filename))
+        return IO::messageToBinaryFile(msg, filename);
+
     YAML::Node node = robowflex::IO::toNode(msg);
     return robowflex::IO::YAMLToFile(node, filename);
 }
@@ -54,7 +85,9 @@ bool Trajectory::toYAMLFile(const std::string &filename) const
 bool Trajectory::fromYAMLFile(const robot_state::RobotState &reference_state, const std::string &filename)
 {
     moveit_msgs::RobotTrajectory msg;
-    if (!IO::YAMLFileToMessage(msg, filename))
+    const bool loaded = (IO::isBinaryFile(filename)) ? IO::binaryFileToMessage(msg, filename) :
+                                                       IO::YAMLFileToMessage(msg, filename);
+    if (!loaded)
         return false;
 
     useMessage(reference_state, msg);
@@ -64,6 +97,7 @@ bool Trajectory::fromYAMLFile(const robot_state::RobotState &reference_state, co
 void Trajectory::addSuffixWaypoint(const robot_state::RobotState &state, double dt)
 {
     trajectory_->addSuffixWayPoint(state, dt);
+    invalidate();
 }
 
 const robot_trajectory::RobotTrajectoryPtr &Trajectory::getTrajectoryConst() const
@@ -73,6 +107,7 @@ const robot_trajectory::RobotTrajectoryPtr &Trajectory::getTrajectoryConst() con
 
 robot_trajectory::RobotTrajectoryPtr &Trajectory::getTrajectory()
 {
+    invalidate();
     return trajectory_;
 }
 
@@ -90,8 +125,16 @@ std::size_t Trajectory::getNumWaypoints() const
 
 bool Trajectory::computeTimeParameterization(double max_velocity, double max_acceleration)
 {
-    trajectory_processing::IterativeParabolicTimeParameterization parameterizer;
-    return parameterizer.computeTimeStamps(*trajectory_, max_velocity, max_acceleration);
+    return computeTimeParameterization(TimeParameterization::ITERATIVE_PARABOLIC, max_velocity,
+                                       max_acceleration);
+}
+
+bool Trajectory::computeTimeParameterization(TimeParameterization method, double max_velocity,
+                                             double max_acceleration)
+{
+    // Some methods resample the path.
+    invalidate();
+    return computeTimeParameterization(*trajectory_, method, max_velocity, max_acceleration);
 }
 
 bool Trajectory::computeTimeParameterization(robot_trajectory::RobotTrajectory &trajectory,
@@ -101,6 +144,106 @@ bool Trajectory::computeTimeParameterization(robot_trajectory::RobotTrajectory &
     return parameterizer.computeTimeStamps(trajectory, max_velocity, max_acceleration);
 }
 
+namespace
+{
+    /** \brief Gives each segment of \a trajectory the duration of a rest-to-rest trapezoidal velocity
+     *  profile for the slowest joint, with all waypoints at rest. */
+    bool computeTrapezoidalTimeStamps(robot_trajectory::RobotTrajectory &trajectory, double max_velocity,
+                                      double max_acceleration)
+    {
+        if (max_velocity <= 0. or max_acceleration <= 0.)
+            return false;
+
+        const auto &model = trajectory.getRobotModel();
+        const auto *group = trajectory.getGroup();
+        const auto &joints = (group) ? group->getActiveJointModels() : model->getActiveJointModels();
+
+        // Velocity and acceleration limits per variable, defaulting to 1 if unbounded.
+        const auto limit = [](bool bounded, double lower, double upper) {
+            return (bounded) ? std::min(std::fabs(lower), std::fabs(upper)) : 1.;
+        };
+
+        std::vector<std::tuple<int, double, double>> limits;
+        for (const auto *joint : joints)
+        {
+            for (std::size_t i = 0; i < joint->getVariableCount(); ++i)
+            {
+                const auto &b = joint->getVariableBounds()[i];
+                const double v = limit(b.velocity_bounded_, b.min_velocity_, b.max_velocity_);
+                const double a = limit(b.acceleration_bounded_, b.min_acceleration_, b.max_acceleration_);
+
+                limits.emplace_back(joint->getFirstVariableIndex() + i,  //
+                                    v * max_velocity, a * max_acceleration);
+            }
+        }
+
+        const std::size_t n = trajectory.getWayPointCount();
+        for (std::size_t k = 0; k < n; ++k)
+        {
+            auto &state = trajectory.getWayPointNonConst(k);
+            state.zeroVelocities();
+            state.zeroAccelerations();
+
+            if (k == 0)
+            {
+                trajectory.setWayPointDurationFromPrevious(k, 0.);
+                continue;
+            }
+
+            const auto &previous = trajectory.getWayPoint(k - 1);
+
+            double duration = 0.;
+            for (const auto &limit : limits)
+            {
+                const int index = std::get<0>(limit);
+                const double v = std::get<1>(limit);
+                const double a = std::get<2>(limit);
+                if (v <= 0. or a <= 0.)
+                    continue;
+
+                const double d =
+                    std::fabs(state.getVariablePosition(index) - previous.getVariablePosition(index));
+
+                // Time to accelerate to and decelerate from full speed, or a triangular profile if the joint
+                // never reaches full speed.
+                const double t = (d > v * v / a) ? d / v + v / a : 2. * std::sqrt(d / a);
+                duration = std::max(duration, t);
+            }
+
+            trajectory.setWayPointDurationFromPrevious(k, duration);
+        }
+
+        return true;
+    }
+}  // namespace
+
+bool Trajectory::computeTimeParameterization(robot_trajectory::RobotTrajectory &trajectory,
+                                             TimeParameterization method, double max_velocity,
+                                             double max_acceleration)
+{
+    switch (method)
+    {
+        case TimeParameterization::ITERATIVE_PARABOLIC:
+        {
+            trajectory_processing::IterativeParabolicTimeParameterization parameterizer;
+            return parameterizer.computeTimeStamps(trajectory, max_velocity, max_acceleration);
+        }
+        case TimeParameterization::TIME_OPTIMAL:
+        {
+#if ROBOWFLEX_MOVEIT_VERSION >= ROBOWFLEX_MOVEIT_VERSION_COMPUTE(1, 0, 0)
+            trajectory_processing::TimeOptimalTrajectoryGeneration parameterizer;
+            return parameterizer.computeTimeStamps(trajectory, max_velocity, max_acceleration);
+#else
+            throw Exception(1, "Time-optimal time parameterization requires MoveIt 1.0.0 or later!");
+#endif
+        }
+        case TimeParameterization::TRAPEZOIDAL:
+            return computeTrapezoidalTimeStamps(trajectory, max_velocity, max_acceleration);
+        default:
+            return false;
+    }
+}
+
 void Trajectory::interpolate(unsigned int count)
 {
 #if ROBOWFLEX_AT_LEAST_KINETIC
@@ -131,11 +274,10 @@ void Trajectory::interpolate(unsigned int count)
         {
             ns -= 2;  // subtract endpoints
 
-            // compute intermediate states
+            // compute intermediate states, into a state that is copied on insertion
+            Robot::StateLease s1(trajectory_->getRobotModel());
             for (int j = 1; j < ns; j++)
             {
-                // The state to be inserted
-                auto s1 = std::make_shared<robot_state::RobotState>(trajectory_->getRobotModel());
                 double dt = double(j) / double(ns);
 
                 s0->interpolate(*s2, dt, *s1);
@@ -148,30 +290,82 @@ void Trajectory::interpolate(unsigned int count)
     }
 
     RBX_INFO("Added %d extra states in the trajectory", added);
+    invalidate();
     return;
 
 #endif
     throw Exception(1, "Not Implemented");
 }
 
+namespace
+{
+    /** \brief Get the single variable joints of a trajectory, in the order used by its messages. */
+    std::vector<const robot_model::JointModel *> getTrajectoryJoints(
+        const robot_trajectory::RobotTrajectory &trajectory)
+    {
+        const auto *group = trajectory.getGroup();
+        const auto &joints = (group) ? group->getActiveJointModels() :  //
+                                 trajectory.getRobotModel()->getActiveJointModels();
+
+        std::vector<const robot_model::JointModel *> single;
+        for (const auto *joint : joints)
+            if (joint->getVariableCount() == 1)
+                single.emplace_back(joint);
+
+        return single;
+    }
+}  // namespace
+
 std::vector<std::vector<double>> Trajectory::vectorize() const
 {
-    std::vector<std::vector<double>> traj_vec;
-    const auto &msg = getMessage();
-    for (const auto &p : msg.joint_trajectory.points)
-        traj_vec.emplace_back(p.positions);
+    const auto &matrix = getJointMatrix();
+
+    std::vector<std::vector<double>> traj_vec(matrix.rows(), std::vector<double>(matrix.cols()));
+    for (Eigen::Index i = 0; i < matrix.rows(); ++i)
+        Eigen::Map<Eigen::RowVectorXd>(traj_vec[i].data(), matrix.cols()) = matrix.row(i);
 
     return traj_vec;
 }
 
 std::vector<std::string> Trajectory::getJointNames() const
 {
-    return getMessage().joint_trajectory.joint_names;
+    std::vector<std::string> names;
+    for (const auto *joint : getTrajectoryJoints(*trajectory_))
+        names.emplace_back(joint->getName());
+
+    return names;
+}
+
+const Eigen::MatrixXd &Trajectory::getJointMatrix() const
+{
+    std::unique_lock<std::mutex> lock(matrix_->mutex);
+
+    const std::size_t version = matrix_->version;
+    if (matrix_->cached == version and matrix_->source == trajectory_.get())
+        return matrix_->matrix;
+
+    const auto &joints = getTrajectoryJoints(*trajectory_);
+    const std::size_t n = trajectory_->getWayPointCount();
+
+    auto &matrix = matrix_->matrix;
+    matrix.resize(n, joints.size());
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        const auto &state = trajectory_->getWayPoint(i);
+        for (std::size_t j = 0; j < joints.size(); ++j)
+            matrix(i, j) = state.getVariablePosition(joints[j]->getFirstVariableIndex());
+    }
+
+    matrix_->cached = version;
+    matrix_->source = trajectory_.get();
+
+    return matrix;
 }
 
 Trajectory &Trajectory::append(const Trajectory &source, double dt, size_t start_index, size_t end_index)
 {
     trajectory_->append(*source.getTrajectoryConst(), dt, start_index, end_index);
+    invalidate();
     return *this;
 }
 
@@ -193,9 +387,39 @@ double Trajectory::getLength(const PathMetric &metric) const
     return length;
 }
 
+namespace
+{
+    /** \brief Get the group to restrict collision checking of a waypoint to. Waypoints that only differ from
+     * the first waypoint in the joints of the trajectory's group only need the group's moved links
+     * checked, provided the first waypoint is checked in full.
+     *  \param[in] trajectory Trajectory to check.
+     *  \param[in] k Index of the waypoint.
+     *  \return The group to restrict checking to, or nullptr to check the whole robot.
+     */
+    const moveit::core::JointModelGroup *getCheckGroup(const robot_trajectory::RobotTrajectory &trajectory,
+                                                       std::size_t k)
+    {
+        const auto *jmg = trajectory.getGroup();
+        if (not jmg or k == 0)
+            return nullptr;
+
+        const auto &first = trajectory.getWayPoint(0);
+        const auto &state = trajectory.getWayPoint(k);
+        const auto &group = jmg->getVariableIndexList();
+
+        for (std::size_t i = 0; i < first.getVariableCount(); ++i)
+            if (first.getVariablePosition(i) != state.getVariablePosition(i) and
+                std::find(group.begin(), group.end(), static_cast<int>(i)) == group.end())
+                return nullptr;
+
+        return jmg;
+    }
+}  // namespace
+
 bool Trajectory::isCollisionFree(const SceneConstPtr &scene) const
 {
     bool correct = true;
+    const StateValidityChecker checker(*scene);
 
     for (std::size_t k = 0; k < trajectory_->getWayPointCount(); ++k)
     {
@@ -203,8 +427,7 @@ bool Trajectory::isCollisionFree(const SceneConstPtr &scene) const
         if (!s->satisfiesBounds())
             return false;
 
-        const auto result = scene->checkCollision(*s);
-        if (result.collision)
+        if (not checker.isValid(*s, getCheckGroup(*trajectory_, k)))
             return false;
     }
 
@@ -220,7 +443,7 @@ std::tuple<double, double, double> Trajectory::getClearance(const SceneConstPtr
     for (std::size_t k = 0; k < trajectory_->getWayPointCount(); ++k)
     {
         const auto &s = trajectory_->getWayPointPtr(k);
-        double clearance = scene->distanceToCollision(*s);
+        double clearance = scene->getClearance(*s);
         if (clearance > 0.0)
         {
             average += clearance;
@@ -234,6 +457,369 @@ std::tuple<double, double, double> Trajectory::getClearance(const SceneConstPtr
     return std::make_tuple(average, minimum, maximum);
 }
 
+namespace
+{
+    /** \brief Per-thread copies of robot states, so threads of a pool do not share waypoint states.
+     */
+    class ThreadStates
+    {
+    public:
+        ThreadStates(const Pool &pool) : pool_(pool), states_(pool.getThreadCount() + 1)
+        {
+        }
+
+        /** \brief Get a copy of \a state owned by the calling thread. */
+        const robot_state::RobotState &get(const robot_state::RobotState &state)
+        {
+            auto &copy = slot(state);
+            copy = state;
+            copy.update();
+
+            return copy;
+        }
+
+        /** \brief Get a state owned by the calling thread, interpolated between \a from and \a to. */
+        const robot_state::RobotState &interpolate(const robot_state::RobotState &from,
+                                                   const robot_state::RobotState &to, double t)
+        {
+            auto &copy = slot(from);
+            from.interpolate(to, t, copy);
+            copy.update();
+
+            return copy;
+        }
+
+    private:
+        /** \brief Get the state of the calling thread, allocated as a copy of \a state if needed. */
+        robot_state::RobotState &slot(const robot_state::RobotState &state)
+        {
+            // Threads outside of the pool use the last slot. Only the caller of parallelFor() is outside.
+            const int index = pool_.getWorkerIndex();
+            auto &copy = states_[(index < 0) ? pool_.getThreadCount() : index];
+
+            if (not copy)
+                copy.reset(new robot_state::RobotState(state));
+
+            return *copy;
+        }
+
+        const Pool &pool_;                                             ///< Pool of threads.
+        std::vector<std::unique_ptr<robot_state::RobotState>> states_;  ///< State copy per thread.
+    };
+}  // namespace
+
+bool Trajectory::isCollisionFree(const SceneConstPtr &scene, const Pool &pool) const
+{
+    ThreadStates states(pool);
+    std::atomic<bool> correct(true);
+    const StateValidityChecker checker(*scene);
+
+    pool.parallelFor(0, trajectory_->getWayPointCount(), [&](std::size_t k) {
+        // Skip remaining waypoints once an invalid one is found.
+        if (not correct)
+            return;
+
+        const auto &s = states.get(trajectory_->getWayPoint(k));
+        if (not s.satisfiesBounds() or not checker.isValid(s, getCheckGroup(*trajectory_, k)))
+            correct = false;
+    });
+
+    return correct;
+}
+
+bool Trajectory::isCollisionFreeContinuous(const SceneConstPtr &scene, double tolerance) const
+{
+    const std::size_t n = trajectory_->getWayPointCount();
+    if (n == 0)
+        return true;
+
+    const auto &model = trajectory_->getRobotModel();
+    const double extent = model->getMaximumExtent();
+
+    Robot::StateLease lease(model);
+    auto &state = *lease;
+    const StateValidityChecker checker(*scene);
+    const auto valid = [&](const robot_state::RobotState &s) {
+        return s.satisfiesBounds() and checker.isValid(s);
+    };
+
+    if (n == 1)
+        return valid(trajectory_->getWayPoint(0));
+
+    for (std::size_t k = 0; k + 1 < n; ++k)
+    {
+        const auto &a = trajectory_->getWayPoint(k);
+        const auto &b = trajectory_->getWayPoint(k + 1);
+
+        // Upper bound on how far any point on the robot moves over the whole segment.
+        double bound = 0;
+        for (const auto *joint : model->getJointModels())
+        {
+            if (joint->getVariableCount() == 0)
+                continue;
+
+            const double distance = joint->distance(a.getJointPositions(joint), b.getJointPositions(joint));
+            switch (joint->getType())
+            {
+                case robot_model::JointModel::PRISMATIC:
+                    bound += distance;
+                    break;
+                case robot_model::JointModel::REVOLUTE:
+                    bound += extent * distance;
+                    break;
+                default:
+                    bound += std::max(1., extent) * distance;
+                    break;
+            }
+        }
+
+        double t = 0.;
+        while (true)
+        {
+            a.interpolate(b, t, state);
+            state.update();
+
+            if (not valid(state))
+                return false;
+
+            if (t >= 1.)
+                break;
+
+            const double clearance = scene->getClearance(state);
+            if (clearance < tolerance)
+                return false;
+
+            t = (bound > 0.) ? std::min(1., t + clearance / bound) : 1.;
+        }
+    }
+
+    return true;
+}
+
+double Trajectory::shortcut(const SceneConstPtr &scene, const Pool &pool, const ShortcutOptions &options)
+{
+    const auto start = IO::getDate();
+    const auto distance = [](const robot_state::RobotState &a, const robot_state::RobotState &b) {
+        return a.distance(b);
+    };
+
+    const double initial = getLength();
+    const std::size_t candidates = (options.candidates) ? options.candidates : pool.getThreadCount() + 1;
+
+    std::mt19937 rng(options.seed);
+    ThreadStates states(pool);
+    const StateValidityChecker checker(*scene);
+
+    // A candidate shortcut from waypoint i to j, and how much it shortens the path by.
+    struct Shortcut
+    {
+        std::size_t i, j;
+        double saving;
+        bool valid;
+    };
+
+    for (std::size_t iteration = 0; iteration < options.iterations; ++iteration)
+    {
+        const std::size_t n = trajectory_->getWayPointCount();
+        if (n < 3 or IO::getSeconds(start, IO::getDate()) > options.time)
+            break;
+
+        std::vector<Shortcut> shortcuts;
+        std::uniform_int_distribution<std::size_t> uniform(0, n - 1);
+        for (std::size_t k = 0; k < candidates; ++k)
+        {
+            std::size_t i = uniform(rng);
+            std::size_t j = uniform(rng);
+            if (i > j)
+                std::swap(i, j);
+
+            if (j - i > 1)
+                shortcuts.push_back({i, j, 0., false});
+        }
+
+        // Evaluate all candidate shortcuts in parallel.
+        pool.parallelFor(0, shortcuts.size(), [&](std::size_t k) {
+            auto &shortcut = shortcuts[k];
+            const auto &a = trajectory_->getWayPoint(shortcut.i);
+            const auto &b = trajectory_->getWayPoint(shortcut.j);
+
+            double original = 0.;
+            for (std::size_t m = shortcut.i + 1; m <= shortcut.j; ++m)
+                original += distance(trajectory_->getWayPoint(m - 1), trajectory_->getWayPoint(m));
+
+            const double direct = distance(a, b);
+            shortcut.saving = original - direct;
+            if (shortcut.saving <= 0.)
+                return;
+
+            const std::size_t steps = std::ceil(direct / options.resolution);
+            for (std::size_t m = 1; m < steps; ++m)
+            {
+                const auto &s = states.interpolate(a, b, double(m) / double(steps));
+                if (not s.satisfiesBounds() or not checker.isValid(s))
+                    return;
+            }
+
+            shortcut.valid = true;
+        });
+
+        // Apply the best non-overlapping valid shortcuts.
+        std::sort(shortcuts.begin(), shortcuts.end(),
+                  [](const Shortcut &a, const Shortcut &b) { return a.saving > b.saving; });
+
+        std::vector<bool> removed(n, false);
+        std::vector<bool> used(n, false);
+        for (const auto &shortcut : shortcuts)
+        {
+            if (not shortcut.valid)
+                continue;
+
+            bool overlap = false;
+            for (std::size_t m = shortcut.i; m <= shortcut.j and not overlap; ++m)
+                overlap = used[m];
+
+            if (overlap)
+                continue;
+
+            for (std::size_t m = shortcut.i; m <= shortcut.j; ++m)
+                used[m] = true;
+
+            for (std::size_t m = shortcut.i + 1; m < shortcut.j; ++m)
+                removed[m] = true;
+        }
+
+        if (std::find(removed.begin(), removed.end(), true) == removed.end())
+            continue;
+
+        std::vector<robot_state::RobotStatePtr> kept;
+        for (std::size_t m = 0; m < n; ++m)
+            if (not removed[m])
+                kept.emplace_back(trajectory_->getWayPointPtr(m));
+
+        trajectory_->clear();
+        for (const auto &state : kept)
+            trajectory_->addSuffixWayPoint(state, 0.);
+
+        invalidate();
+    }
+
+    return initial - getLength();
+}
+
+double Trajectory::shortcut(const SceneConstPtr &scene, const Pool &pool)
+{
+    return shortcut(scene, pool, ShortcutOptions());
+}
+
+std::tuple<double, double, double> Trajectory::getClearance(const SceneConstPtr &scene,
+                                                            const Pool &pool) const
+{
+    const std::size_t n = trajectory_->getWayPointCount();
+
+    ThreadStates states(pool);
+    std::vector<double> clearances(n);
+
+    pool.parallelFor(0, n, [&](std::size_t k) {
+        clearances[k] = scene->getClearance(states.get(trajectory_->getWayPoint(k)));
+    });
+
+    double minimum = std::numeric_limits<double>::max();
+    double maximum = 0;
+    double average = 0;
+
+    for (const double clearance : clearances)
+    {
+        if (clearance > 0.0)
+        {
+            average += clearance;
+            maximum = (maximum > clearance) ? maximum : clearance;
+            minimum = (minimum < clearance) ? minimum : clearance;
+        }
+    }
+
+    average /= n;
+
+    return std::make_tuple(average, minimum, maximum);
+}
+
+Trajectory::Metrics Trajectory::computeMetrics(uint32_t mask, const SceneConstPtr &scene,
+                                               const PathMetric &metric) const
+{
+    Metrics result;
+
+    const std::size_t n = trajectory_->getWayPointCount();
+    const bool length = mask & LENGTH;
+    const bool smoothness = (mask & SMOOTHNESS) and n > 2;
+    bool correct = mask & CORRECT;
+    const bool clearance = mask & CLEARANCE;
+
+    if ((correct or clearance) and not scene)
+        throw Exception(1, "Scene required to compute collision metrics!");
+
+    auto distance =
+        (metric) ? metric : [](const robot_state::RobotState &a, const robot_state::RobotState &b) {
+            return a.distance(b);
+        };
+
+    const StateValidityCheckerPtr checker = (correct) ? scene->getValidityChecker() : nullptr;
+
+    double a = 0.;  // Length of the previous segment.
+    for (std::size_t k = 0; k < n; ++k)
+    {
+        const auto &s = trajectory_->getWayPoint(k);
+
+        // Only collision check until the first invalid waypoint.
+        if (correct and (not s.satisfiesBounds() or not checker->isValid(s)))
+        {
+            result.correct = false;
+            correct = false;
+        }
+
+        if (clearance)
+        {
+            const double c = scene->getClearance(s);
+            if (c > 0.0)
+            {
+                result.clearance += c;
+                result.max_clearance = std::max(result.max_clearance, c);
+                result.min_clearance = std::min(result.min_clearance, c);
+            }
+        }
+
+        if (k == 0 or not(length or smoothness))
+            continue;
+
+        const double b = distance(trajectory_->getWayPoint(k - 1), s);
+        result.length += b;
+
+        // See getSmoothness().
+        if (smoothness and k > 1)
+        {
+            const double cdist = distance(trajectory_->getWayPoint(k - 2), s);
+            const double acos_value = (a * a + b * b - cdist * cdist) / (2.0 * a * b);
+            if (acos_value > -1.0 && acos_value < 1.0)
+            {
+                const double angle = (constants::pi - acos(acos_value));
+                const double u = 2.0 * angle;
+                result.smoothness += u * u;
+            }
+        }
+
+        a = b;
+    }
+
+    if (not length)
+        result.length = 0.;
+
+    if (smoothness)
+        result.smoothness /= n;
+
+    if (clearance)
+        result.clearance /= n;
+
+    return result;
+}
+
 double Trajectory::getSmoothness(const PathMetric &metric) const
 {
     double smoothness = 0.0;
@@ -295,3 +881,146 @@ std::map<std::string, double> Trajectory::getFinalPositions() const
 
     return map;
 }
+
+///
+/// ResampledTrajectory
+///
+
+ResampledTrajectory::ResampledTrajectory(const Trajectory &trajectory, unsigned int count)
+  : source_(trajectory.getTrajectoryConst())
+{
+    const std::size_t n = source_->getWayPointCount();
+    if (n == 0)
+        return;
+
+    // Same number of states per segment as Trajectory::interpolate().
+    const double total_length = trajectory.getLength();
+    const bool resample = count >= n and n >= 2 and total_length > 0.;
+
+    offsets_.emplace_back(0);
+    for (std::size_t k = 0; k + 1 < n; ++k)
+    {
+        int ns = 1;
+        if (resample)
+        {
+            const double segment_length = source_->getWayPoint(k).distance(source_->getWayPoint(k + 1));
+            ns = (int)floor(0.5 + (double)count * segment_length / total_length) + 1;
+        }
+
+        offsets_.emplace_back(offsets_.back() + ((ns > 2) ? ns - 2 : 1));
+    }
+}
+
+std::size_t ResampledTrajectory::getNumWaypoints() const
+{
+    return (offsets_.empty()) ? 0 : offsets_.back() + 1;
+}
+
+std::pair<std::size_t, double> ResampledTrajectory::getSegment(std::size_t index) const
+{
+    const std::size_t k = std::upper_bound(offsets_.begin(), offsets_.end(), index) - offsets_.begin() - 1;
+    if (k + 1 == offsets_.size())
+        return {k, 0.};
+
+    return {k, double(index - offsets_[k]) / double(offsets_[k + 1] - offsets_[k])};
+}
+
+void ResampledTrajectory::getWayPoint(std::size_t index, robot_state::RobotState &state) const
+{
+    const auto &segment = getSegment(index);
+    const auto &from = source_->getWayPoint(segment.first);
+
+    if (segment.second > 0.)
+        from.interpolate(source_->getWayPoint(segment.first + 1), segment.second, state);
+    else
+        state = from;
+
+    state.update();
+}
+
+bool ResampledTrajectory::forEachWayPoint(const WayPointCallback &callback) const
+{
+    if (offsets_.empty())
+        return true;
+
+    Robot::StateLease state(source_->getRobotModel());
+    for (std::size_t i = 0; i < getNumWaypoints(); ++i)
+    {
+        getWayPoint(i, *state);
+        if (not callback(i, *state))
+            return false;
+    }
+
+    return true;
+}
+
+double ResampledTrajectory::getLength(const PathMetric &metric) const
+{
+    if (offsets_.empty())
+        return 0.;
+
+    double length = 0.0;
+    Robot::StateLease previous(source_->getRobotModel());
+    forEachWayPoint([&](std::size_t i, const robot_state::RobotState &state) {
+        if (i > 0)
+            length += (metric) ? metric(*previous, state) : previous->distance(state);
+
+        *previous = state;
+        return true;
+    });
+
+    return length;
+}
+
+bool ResampledTrajectory::isCollisionFree(const SceneConstPtr &scene) const
+{
+    const StateValidityChecker checker(*scene);
+
+    // Interpolated states only differ from the first waypoint in the group if both ends of their segment
+    // do, so they can be checked the same way as the waypoints of the source.
+    std::vector<const moveit::core::JointModelGroup *> groups;
+    for (std::size_t k = 0; k < source_->getWayPointCount(); ++k)
+        groups.emplace_back(getCheckGroup(*source_, k));
+
+    return forEachWayPoint([&](std::size_t i, const robot_state::RobotState &state) {
+        const auto &segment = getSegment(i);
+        const auto *group = groups[segment.first];
+        if (segment.second > 0.)
+            group = (segment.first == 0 or group) ? groups[segment.first + 1] : nullptr;
+
+        return state.satisfiesBounds() and checker.isValid(state, group);
+    });
+}
+
+Eigen::MatrixXd ResampledTrajectory::getJointMatrix() const
+{
+    const auto &joints = getTrajectoryJoints(*source_);
+
+    Eigen::MatrixXd matrix(getNumWaypoints(), joints.size());
+    forEachWayPoint([&](std::size_t i, const robot_state::RobotState &state) {
+        for (std::size_t j = 0; j < joints.size(); ++j)
+            matrix(i, j) = state.getVariablePosition(joints[j]->getFirstVariableIndex());
+
+        return true;
+    });
+
+    return matrix;
+}
+
+TrajectoryPtr ResampledTrajectory::toTrajectory() const
+{
+    const auto &model = source_->getRobotModel();
+    auto trajectory = std::make_shared<robot_trajectory::RobotTrajectory>(model, source_->getGroupName());
+
+    // As in Trajectory::interpolate(), interpolated states have their parameter as their duration.
+    forEachWayPoint([&](std::size_t i, const robot_state::RobotState &state) {
+        const auto &segment = getSegment(i);
+        const double dt = (segment.second > 0.) ? segment.second :
+                                                  source_->getWayPointDurationFromPrevious(segment.first);
+
+        trajectory->addSuffixWayPoint(state, dt);
+        return true;
+    });
+
+    return std::make_shared<Trajectory>(trajectory);
+}
@@ -3,9 +3,11 @@
 #include <cstdint>
 
 #include <algorithm>
+#include <fstream>
 #include <string>
 
 #include <boost/algorithm/hex.hpp>
+#include <boost/filesystem.hpp>
 #include <boost/iostreams/device/back_inserter.hpp>
 #include <boost/iostreams/filter/zlib.hpp>
 #include <boost/iostreams/filtering_stream.hpp>
@@ -14,6 +16,7 @@
 #include <robowflex_library/io.h>
 #include <robowflex_library/tf.h>
 #include <robowflex_library/io/yaml.h>
+#include <robowflex_library/log.h>
 #include <robowflex_library/macros.h>
 #include <robowflex_library/yaml.h>
 
@@ -133,40 +136,127 @@ namespace
                && c.visibility_constraints.empty();
     }
 
-    static std::string compressHex(const std::vector<int8_t> &v)
+    static std::vector<char> compress(const char *data, std::size_t size)
     {
-        std::vector<char> compress;
+        std::vector<char> compressed;
+        compressed.reserve(size / 4);
         {
             boost::iostreams::filtering_ostream fos;
             fos.push(boost::iostreams::zlib_compressor());
-            fos.push(boost::iostreams::back_inserter(compress));
+            fos.push(boost::iostreams::back_inserter(compressed));
+            fos.write(data, size);
+        }
+
+        return compressed;
+    }
 
-            for (const auto &i : v)
-                fos << i;
+    static std::vector<int8_t> decompress(const char *data, std::size_t size)
+    {
+        std::vector<int8_t> decompressed;
+        decompressed.reserve(4 * size);
+        {
+            boost::iostreams::filtering_ostream fos;
+            fos.push(boost::iostreams::zlib_decompressor());
+            fos.push(boost::iostreams::back_inserter(decompressed));
+            fos.write(data, size);
         }
 
+        return decompressed;
+    }
+
+    static std::string compressHex(const std::vector<int8_t> &v)
+    {
+        const auto &compressed = compress(reinterpret_cast<const char *>(v.data()), v.size());
+
         std::string result;
-        boost::algorithm::hex(compress.begin(), compress.end(), std::back_inserter(result));
+        result.reserve(2 * compressed.size());
+        boost::algorithm::hex(compressed.begin(), compressed.end(), std::back_inserter(result));
 
         return result;
     }
 
     static std::vector<int8_t> decompressHex(const std::string &hex)
     {
-        std::vector<int8_t> unhexed;
+        std::vector<char> unhexed;
+        unhexed.reserve(hex.size() / 2);
         boost::algorithm::unhex(hex, std::back_inserter(unhexed));
 
-        std::vector<char> decompress;
+        return decompress(unhexed.data(), unhexed.size());
+    }
+
+    /** \brief Where octomap data is written to and read from when using sidecar files. Set for the
+     * duration of a single file's encoding or decoding on the current thread.
+     */
+    struct SidecarContext
+    {
+        bool write{false};      ///< If true, octomap data is written to sidecar files when encoding.
+        std::string directory;  ///< Directory of the YAML file, which sidecar paths are relative to.
+        std::string stem;       ///< Stem of the YAML file, used to name sidecar files.
+        std::size_t count{0};   ///< Number of sidecar files written so far.
+    };
+
+    thread_local SidecarContext SIDECAR;
+
+    /** \brief Sets the sidecar context for the current thread, and restores the previous one on destruction.
+     */
+    class SidecarScope
+    {
+    public:
+        SidecarScope(const std::string &file, bool write) : previous_(SIDECAR)
         {
-            boost::iostreams::filtering_ostream fos;
-            fos.push(boost::iostreams::zlib_decompressor());
-            fos.push(boost::iostreams::back_inserter(decompress));
+            const boost::filesystem::path path(file);
+
+            SIDECAR = SidecarContext();
+            SIDECAR.write = write;
+            SIDECAR.directory = path.parent_path().string();
+            SIDECAR.stem = path.stem().string();
+        }
+
+        ~SidecarScope()
+        {
+            SIDECAR = previous_;
+        }
+
+    private:
+        SidecarContext previous_;
+    };
+
+    /** \brief Write compressed octomap data to a new sidecar file.
+     *  \return The name of the sidecar file, relative to the YAML file, or "" on failure.
+     */
+    static std::string writeSidecar(const std::vector<int8_t> &v)
+    {
+        const auto &compressed = compress(reinterpret_cast<const char *>(v.data()), v.size());
+        const std::string name = SIDECAR.stem + ".octomap." + std::to_string(SIDECAR.count++) + ".z";
 
-            for (const auto &i : unhexed)
-                fos << i;
+        std::ofstream out;
+        IO::createFile(out, (boost::filesystem::path(SIDECAR.directory) / name).string());
+        out.write(compressed.data(), compressed.size());
+        if (not out)
+        {
+            RBX_ERROR("Failed to write octomap sidecar `%s`, storing data inline", name);
+            return "";
         }
 
-        return std::vector<int8_t>(decompress.begin(), decompress.end());
+        return name;
+    }
+
+    /** \brief Read octomap data from a sidecar file.
+     */
+    static std::vector<int8_t> readSidecar(const std::string &name)
+    {
+        boost::filesystem::path path(name);
+        if (path.is_relative() and not SIDECAR.directory.empty())
+            path = boost::filesystem::path(SIDECAR.directory) / path;
+
+        const auto &file = IO::mapFile(path.string());
+        if (not file)
+        {
+            RBX_ERROR("Failed to read octomap sidecar `%s`", path.string());
+            return {};
+        }
+
+        return decompress(file->data(), file->size());
     }
 }  // namespace
 
@@ -1165,7 +1255,12 @@ namespace YAML
         node["binary"] = boolToString(rhs.binary);
         node["id"] = rhs.id;
         node["resolution"] = rhs.resolution;
-        node["data"] = compressHex(rhs.data);
+
+        const std::string &file = (SIDECAR.write) ? writeSidecar(rhs.data) : "";
+        if (not file.empty())
+            node["file"] = file;
+        else
+            node["data"] = compressHex(rhs.data);
 
         return node;
     }
@@ -1188,7 +1283,10 @@ namespace YAML
         if (IO::isNode(node["resolution"]))
             rhs.resolution = node["resolution"].as<double>();
 
-        if (IO::isNode(node["data"]))
+        if (IO::isNode(node["file"]))
+            rhs.data = readSidecar(node["file"].as<std::string>());
+
+        else if (IO::isNode(node["data"]))
         {
             // Load old octomap formats / direct YAML output
             if (node["data"].IsSequence())
@@ -1913,16 +2011,38 @@ namespace robowflex
 
         bool fromYAMLFile(moveit_msgs::PlanningScene &msg, const std::string &file)
         {
+            if (IO::isBinaryFile(file))
+                return IO::binaryFileToMessage(msg, file);
+
+            // Sidecar files are relative to the scene file.
+            SidecarScope scope(IO::resolvePath(file), false);
             return IO::YAMLFileToMessage(msg, file);
         }
 
+        bool toYAMLFile(const moveit_msgs::PlanningScene &msg, const std::string &file, bool sidecar)
+        {
+            YAML::Node node;
+            {
+                SidecarScope scope(file, sidecar);
+                node = toNode(msg);
+            }
+
+            return IO::YAMLToFile(node, file);
+        }
+
         bool fromYAMLFile(moveit_msgs::MotionPlanRequest &msg, const std::string &file)
         {
+            if (IO::isBinaryFile(file))
+                return IO::binaryFileToMessage(msg, file);
+
             return IO::YAMLFileToMessage(msg, file);
         }
 
         bool fromYAMLFile(moveit_msgs::RobotState &msg, const std::string &file)
         {
+            if (IO::isBinaryFile(file))
+                return IO::binaryFileToMessage(msg, file);
+
             return IO::YAMLFileToMessage(msg, file);
         }
     }  // namespace IO
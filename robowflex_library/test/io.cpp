@@ -0,0 +1,43 @@
+/* Author: Zachary Kingston */
+
+#include <gtest/gtest.h>
+
+#include <ros/package.h>
+
+#include <robowflex_library/io.h>
+
+using namespace robowflex;
+
+TEST(IO, resolvePackage)
+{
+    const std::string uri = "package://robowflex_library/package.xml";
+    const std::string expected = ros::package::getPath("robowflex_library") + "/package.xml";
+
+    IO::clearPathCache();
+
+    // Resolved once with the package location uncached, and once cached.
+    ASSERT_EQ(expected, IO::resolvePackage(uri));
+    ASSERT_EQ(expected, IO::resolvePackage(uri));
+
+    ASSERT_FALSE(IO::resolvePath(uri).empty());
+    ASSERT_EQ(IO::resolvePath(uri), IO::resolvePath(uri));
+
+    ASSERT_TRUE(IO::resolvePackage("package://robowflex_library_does_not_exist/package.xml").empty());
+}
+
+TEST(IO, isBinaryFile)
+{
+    ASSERT_TRUE(IO::isBinaryFile("scene.bin"));
+    ASSERT_TRUE(IO::isBinaryFile("/tmp/scenes/scene.bin"));
+
+    ASSERT_FALSE(IO::isBinaryFile("scene"));
+    ASSERT_FALSE(IO::isBinaryFile("scene.yaml"));
+    ASSERT_FALSE(IO::isBinaryFile("scene.robin"));
+    ASSERT_FALSE(IO::isBinaryFile("/tmp/scenes.bin/scene"));
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,141 @@
+/* Author: Zachary Kingston */
+
+#include <gtest/gtest.h>
+
+#include <robowflex_library/pool.h>
+
+using namespace robowflex;
+
+namespace
+{
+    void submitMany(Pool::Scheduler scheduler)
+    {
+        Pool pool(4, scheduler);
+
+        std::vector<std::shared_ptr<Pool::Job<int>>> jobs;
+        for (int i = 0; i < 1000; ++i)
+            jobs.emplace_back(pool.submit(make_function([i] { return 2 * i; })));
+
+        for (int i = 0; i < 1000; ++i)
+            ASSERT_EQ(2 * i, jobs[i]->get());
+    }
+}  // namespace
+
+TEST(Pool, shared)
+{
+    submitMany(Pool::Scheduler::SHARED);
+}
+
+TEST(Pool, stealing)
+{
+    submitMany(Pool::Scheduler::STEALING);
+}
+
+TEST(Pool, stealingNested)
+{
+    Pool pool(2, Pool::Scheduler::STEALING);
+
+    auto outer = pool.submit(make_function([&pool] {
+        auto inner = pool.submit(make_function([] { return 1; }));
+        return inner->get() + 1;
+    }));
+
+    ASSERT_EQ(2, outer->get());
+}
+
+TEST(Pool, parallelFor)
+{
+    Pool pool(4, Pool::Scheduler::STEALING);
+
+    std::vector<int> values(1000, 0);
+    pool.parallelFor(0, values.size(), [&](std::size_t i) { values[i] = i; }, 7);
+
+    for (std::size_t i = 0; i < values.size(); ++i)
+        ASSERT_EQ(i, values[i]);
+}
+
+TEST(Pool, batchWaitStats)
+{
+    Pool pool(4);
+
+    std::vector<int> values(1000, 0);
+    pool.parallelFor(0, values.size(), [&](std::size_t i) { values[i] = i; });
+    pool.submitFor(0, values.size(), [&](std::size_t i) { values[i] = 2 * i; })->get();
+
+    // Batches are timed from their submission, not from the epoch of the clock.
+    const auto &stats = pool.getStats();
+    ASSERT_LT(stats.max_wait, 10.);
+    ASSERT_LT(stats.average_wait, 10.);
+}
+
+TEST(Pool, submitBatch)
+{
+    Pool pool(4);
+
+    std::vector<double> inputs{1., 2., 3., 4., 5.};
+    auto batch = pool.submitBatch(inputs, [](double x) { return 2. * x; });
+
+    const auto &results = batch->get();
+    ASSERT_EQ(inputs.size(), results.size());
+    for (std::size_t i = 0; i < inputs.size(); ++i)
+        ASSERT_EQ(2. * inputs[i], results[i]);
+}
+
+TEST(Pool, deadline)
+{
+    Pool pool(1);
+
+    // Block the only worker so the next job misses its deadline.
+    std::promise<void> gate;
+    auto future = gate.get_future().share();
+    auto blocker = pool.submit(make_function([future] { future.wait(); }));
+
+    Pool::JobOptions options;
+    options.deadline = 0.01;
+    auto late = pool.submit(options, make_function([] { return 1; }));
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    gate.set_value();
+
+    ASSERT_THROW(late->get(), std::future_error);
+    ASSERT_TRUE(late->isExpired());
+    ASSERT_EQ(1, pool.getStats().dropped);
+}
+
+TEST(Pool, priority)
+{
+    for (auto scheduler : {Pool::Scheduler::SHARED, Pool::Scheduler::STEALING})
+    {
+        Pool pool(1, scheduler);
+
+        std::promise<void> gate;
+        auto future = gate.get_future().share();
+        auto blocker = pool.submit(make_function([future] { future.wait(); }));
+
+        std::mutex mutex;
+        std::vector<int> order;
+        const auto record = [&](int i) {
+            std::unique_lock<std::mutex> lock(mutex);
+            order.push_back(i);
+        };
+
+        Pool::JobOptions low, high;
+        low.priority = Pool::Priority::LOW;
+        high.priority = Pool::Priority::HIGH;
+
+        auto a = pool.submit(low, make_function([&] { record(0); }));
+        auto b = pool.submit(high, make_function([&] { record(1); }));
+
+        gate.set_value();
+        a->wait();
+        b->wait();
+
+        ASSERT_EQ((std::vector<int>{1, 0}), order);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
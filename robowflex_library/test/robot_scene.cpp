@@ -2,11 +2,14 @@
 
 #include <gtest/gtest.h>
 
+#include <robowflex_library/builder.h>
 #include <robowflex_library/detail/ur5.h>
 #include <robowflex_library/geometry.h>
+#include <robowflex_library/planning.h>
 #include <robowflex_library/robot.h>
 #include <robowflex_library/scene.h>
 #include <robowflex_library/tf.h>
+#include <robowflex_library/trajectory.h>
 #include <robowflex_library/util.h>
 
 using namespace robowflex;
@@ -64,6 +67,39 @@ TEST(Scene, detatchObject)
     ASSERT_NEAR(diff.norm(), 0., 0.005);
 }
 
+TEST(PipelinePlanner, planTwice)
+{
+    auto ur5 = getUR5Robot();
+    auto scene = std::make_shared<Scene>(ur5);
+
+    auto planner = std::make_shared<OMPL::UR5OMPLPipelinePlanner>(ur5);
+    ASSERT_TRUE(planner->initialize());
+
+    MotionRequestBuilder request(planner, "manipulator");
+    request.setStartConfiguration({0.0677, -0.8235, 0.9860, -0.1624, 0.0678, 0.0});
+
+    RobotPose pose = RobotPose::Identity();
+    pose.translate(Eigen::Vector3d{-0.268, -0.826, 1.313});
+    request.setGoalRegion("ee_link", "world", pose, Geometry::makeSphere(0.1),  //
+                          Eigen::Quaterniond{0, 0, 1, 0}, {0.01, 0.01, 0.01});
+
+    // The second plan reuses the planning context cached by the first, which must still have its goal and
+    // state validity checker.
+    for (std::size_t i = 0; i < 2; ++i)
+    {
+        SCOPED_TRACE(i);
+
+        const auto &response = planner->plan(scene, request.getRequest());
+        ASSERT_EQ(response.error_code_.val, moveit_msgs::MoveItErrorCodes::SUCCESS);
+        ASSERT_TRUE(response.trajectory_);
+
+        const auto &last = response.trajectory_->getLastWayPoint();
+        const auto &ee = last.getGlobalLinkTransform("ee_link");
+        EXPECT_LE((ee.translation() - pose.translation()).norm(), 0.1 + 1e-3);
+        EXPECT_TRUE(Trajectory(response.trajectory_).isCollisionFree(scene));
+    }
+}
+
 int main(int argc, char **argv)
 {
     // Startup ROS
@@ -0,0 +1,251 @@
+/* Author: Zachary Kingston */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+#include <gtest/gtest.h>
+
+#include <tinyxml2.h>
+
+#include <robowflex_library/io.h>
+#include <robowflex_library/io/xacro.h>
+#include <robowflex_library/macros.h>
+
+using namespace robowflex;
+
+namespace
+{
+    /** \brief Robot descriptions bundled with robowflex_resources, expanded by the robot helpers.
+     */
+    const std::vector<std::string> ROBOTS = {
+        "package://robowflex_resources/ur/robots/ur5_robotiq_robot_limited.urdf.xacro",
+        "package://robowflex_resources/ur/config/ur5/ur5_robotiq85.srdf.xacro",
+        "package://robowflex_resources/cob/robots/cob4-8.urdf.xacro",
+    };
+
+    std::string writeXacro(const std::string &text)
+    {
+        std::ofstream out;
+        const auto &file = IO::createTempFile(out);
+        out << text;
+        out.close();
+
+        return file;
+    }
+
+    /** \brief Expand a file with the xacro tool. Empty if the tool is not available.
+     */
+    std::string runXacro(const std::string &file)
+    {
+        std::string cmd = "rosrun xacro xacro ";
+
+#if ROBOWFLEX_AT_LEAST_MELODIC
+#else
+        cmd += "--inorder ";
+#endif
+
+        return IO::runCommand(cmd + file + " 2> /dev/null");
+    }
+
+    std::vector<std::string> split(const std::string &text)
+    {
+        std::istringstream ss(text);
+        std::vector<std::string> tokens;
+        std::string token;
+        while (ss >> token)
+            tokens.emplace_back(token);
+
+        return tokens;
+    }
+
+    /** \brief Compare attribute values, with numbers compared up to the precision Python 2 prints.
+     */
+    bool sameValue(const std::string &a, const std::string &b)
+    {
+        const auto &ta = split(a);
+        const auto &tb = split(b);
+        if (ta.size() != tb.size())
+            return false;
+
+        for (std::size_t i = 0; i < ta.size(); ++i)
+        {
+            char *ea = nullptr;
+            char *eb = nullptr;
+            const double x = std::strtod(ta[i].c_str(), &ea);
+            const double y = std::strtod(tb[i].c_str(), &eb);
+
+            if (*ea == 0 and *eb == 0)
+            {
+                if (std::fabs(x - y) > 1e-9 * std::max(1., std::fabs(x)))
+                    return false;
+            }
+            else if (ta[i] != tb[i])
+                return false;
+        }
+
+        return true;
+    }
+
+    /** \brief Compare two expanded documents, ignoring comments, whitespace and attribute order.
+     */
+    void expectSameXML(const tinyxml2::XMLElement *a, const tinyxml2::XMLElement *b)
+    {
+        ASSERT_STREQ(a->Name(), b->Name());
+
+        std::map<std::string, std::string> aa, ba;
+        for (const auto *attribute = a->FirstAttribute(); attribute; attribute = attribute->Next())
+            aa[attribute->Name()] = attribute->Value();
+        for (const auto *attribute = b->FirstAttribute(); attribute; attribute = attribute->Next())
+            ba[attribute->Name()] = attribute->Value();
+
+        // xacro namespace declarations are dropped by the xacro tool, but they are harmless.
+        aa.erase("xmlns:xacro");
+        ba.erase("xmlns:xacro");
+
+        ASSERT_EQ(aa.size(), ba.size()) << "on <" << a->Name() << ">";
+        for (const auto &attribute : aa)
+        {
+            auto it = ba.find(attribute.first);
+            ASSERT_TRUE(it != ba.end()) << "missing `" << attribute.first << "` on <" << a->Name() << ">";
+            EXPECT_TRUE(sameValue(attribute.second, it->second))
+                << "`" << attribute.first << "` on <" << a->Name() << ">: `" << attribute.second
+                << "` != `" << it->second << "`";
+        }
+
+        const auto text = [](const tinyxml2::XMLElement *element) {
+            const char *value = element->GetText();
+            return split((value) ? value : "");
+        };
+        EXPECT_EQ(text(a), text(b)) << "text of <" << a->Name() << ">";
+
+        const auto *ca = a->FirstChildElement();
+        const auto *cb = b->FirstChildElement();
+        for (; ca and cb; ca = ca->NextSiblingElement(), cb = cb->NextSiblingElement())
+            expectSameXML(ca, cb);
+
+        EXPECT_EQ(ca, nullptr) << "extra children in <" << a->Name() << ">";
+        EXPECT_EQ(cb, nullptr) << "missing children in <" << a->Name() << ">";
+    }
+
+    void expectSameXML(const std::string &a, const std::string &b)
+    {
+        tinyxml2::XMLDocument da, db;
+        ASSERT_EQ(da.Parse(a.c_str()), tinyxml2::XML_SUCCESS) << a;
+        ASSERT_EQ(db.Parse(b.c_str()), tinyxml2::XML_SUCCESS) << b;
+        ASSERT_NE(da.RootElement(), nullptr);
+        ASSERT_NE(db.RootElement(), nullptr);
+
+        expectSameXML(da.RootElement(), db.RootElement());
+    }
+}  // namespace
+
+TEST(Xacro, literals)
+{
+    const std::string xacro = R"(<?xml version="1.0"?>
+<robot name="test" xmlns:xacro="http://www.ros.org/wiki/xacro">
+  <xacro:property name="name" value="'panda'"/>
+  <xacro:property name="scale" value="0.5"/>
+  <xacro:property name="count" value="'5'"/>
+  <xacro:macro name="box" params="prefix:='' xyz:='0 0 0' size:=1">
+    <link name="${prefix}${name}_link">
+      <visual>
+        <origin xyz="${xyz}"/>
+        <geometry><box size="${size * scale} 1 1"/></geometry>
+      </visual>
+    </link>
+  </xacro:macro>
+  <xacro:box/>
+  <xacro:box prefix="left_" xyz="1 2 3" size="2"/>
+  <xacro:box prefix="''" size="${count * 2}"/>
+  <link name="values_${'1' == 1}_${1 == 1.0}_${int('5') + 1}_${float('2') / 4}_${1.5e3}"/>
+</robot>
+)";
+
+    // As expanded by xacro.
+    const std::string expected = R"(<?xml version="1.0"?>
+<robot name="test">
+  <link name="panda_link">
+    <visual>
+      <origin xyz="0 0 0"/>
+      <geometry><box size="0.5 1 1"/></geometry>
+    </visual>
+  </link>
+  <link name="left_panda_link">
+    <visual>
+      <origin xyz="1 2 3"/>
+      <geometry><box size="1.0 1 1"/></geometry>
+    </visual>
+  </link>
+  <link name="panda_link">
+    <visual>
+      <origin xyz="0 0 0"/>
+      <geometry><box size="5.0 1 1"/></geometry>
+    </visual>
+  </link>
+  <link name="values_False_True_6_0.5_1500.0"/>
+</robot>
+)";
+
+    const auto &file = writeXacro(xacro);
+
+    std::string result;
+    std::vector<std::string> files;
+    ASSERT_TRUE(IO::expandXacro(file, result, files));
+    expectSameXML(result, expected);
+
+    const auto &reference = runXacro(file);
+    if (not reference.empty())
+        expectSameXML(result, reference);
+
+    IO::deleteFile(file);
+}
+
+TEST(Xacro, invalidConversions)
+{
+    // Both are errors in xacro, so the native expansion must defer to it.
+    for (const std::string expression : {"${int('5.5')}", "${float('0x10')}"})
+    {
+        const auto &file = writeXacro(R"(<robot name="test" xmlns:xacro="http://www.ros.org/wiki/xacro">)"
+                                      "<link name=\"" +
+                                      expression + "\"/></robot>");
+
+        std::string result;
+        std::vector<std::string> files;
+        EXPECT_FALSE(IO::expandXacro(file, result, files)) << expression;
+
+        IO::deleteFile(file);
+    }
+}
+
+TEST(Xacro, robots)
+{
+    for (const auto &robot : ROBOTS)
+    {
+        const auto &file = IO::resolvePath(robot);
+        if (file.empty())
+            continue;
+
+        // Robots using features the native expansion does not support fall back to the xacro tool.
+        std::string result;
+        std::vector<std::string> files;
+        if (not IO::expandXacro(file, result, files))
+            continue;
+
+        const auto &reference = runXacro(file);
+        if (reference.empty())
+            continue;
+
+        SCOPED_TRACE(robot);
+        expectSameXML(result, reference);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,110 @@
+/* Author: Zachary Kingston */
+
+#ifndef ROBOWFLEX_MOVEGROUP_REPLAY_
+#define ROBOWFLEX_MOVEGROUP_REPLAY_
+
+#include <string>
+#include <vector>
+
+#include <robowflex_library/benchmarking.h>
+#include <robowflex_library/class_forward.h>
+#include <robowflex_library/pool.h>
+
+#include <robowflex_movegroup/services.h>
+
+namespace robowflex
+{
+    namespace movegroup
+    {
+        /** \cond IGNORE */
+        ROBOWFLEX_CLASS_FORWARD(Replay);
+        /** \endcond */
+
+        /** \class robowflex::movegroup::ReplayPtr
+            \brief A shared pointer wrapper for robowflex::movegroup::Replay. */
+
+        /** \class robowflex::movegroup::ReplayConstPtr
+            \brief A const shared pointer wrapper for robowflex::movegroup::Replay. */
+
+        /** \brief Replays move group actions recorded by robowflex::movegroup::ActionRecorder (or saved with
+         *  MoveGroupHelper::Action::toYAMLFile()) as a benchmark.
+         *
+         *  Each recorded action becomes a query of a robowflex::Experiment, named after its file, that is
+         *  planned with any robowflex::Planner. The results can then be compared against the originally
+         *  recorded planning time and success, e.g., to regression test planners against real traffic.
+         */
+        class Replay
+        {
+        public:
+            /** \brief A recorded action, as loaded for replay.
+             */
+            struct Entry
+            {
+                std::string name;                ///< Name of the query, the action's file stem.
+                MoveGroupHelper::Action action;  ///< The action, with its full scene.
+            };
+
+            /** \brief Comparison of replayed results of a query to its recording.
+             */
+            struct Comparison
+            {
+                std::string name;          ///< Name of the query.
+                bool recorded_success;     ///< Recorded planning success.
+                double recorded_time;      ///< Recorded planning time.
+                std::size_t runs{0};       ///< Number of replayed runs.
+                std::size_t successes{0};  ///< Number of successful replayed runs.
+                double mean_time{0};       ///< Mean replayed planning time.
+                double speedup{0};         ///< Recorded time over mean replayed time.
+            };
+
+            /** \brief Constructor.
+             *  \param[in] planner Planner to replay actions with. Scenes are created for its robot.
+             */
+            Replay(const PlannerPtr &planner);
+
+            /** \brief Loads recorded actions in parallel. Base scene files written by ActionRecorder are
+             *  skipped, and actions that fail to load are reported and skipped.
+             *  \param[in] pattern Either a directory or a glob of action files, see Dataset::findFiles().
+             *  \param[in] pool Pool to load actions on.
+             *  \return The number of actions loaded.
+             */
+            std::size_t load(const std::string &pattern, const Pool &pool);
+
+            /** \brief Loads the scene of a single recorded action.
+             *  \param[in] filename File of the action.
+             *  \param[out] entry The loaded action.
+             *  \return True on success, false on failure.
+             */
+            bool loadEntry(const std::string &filename, Entry &entry) const;
+
+            /** \brief Get the loaded actions.
+             *  \return The loaded actions.
+             */
+            const std::vector<Entry> &getEntries() const;
+
+            /** \brief Adds a query to \a experiment for each loaded action.
+             *  \param[in] experiment Experiment to add queries to.
+             */
+            void addToExperiment(Experiment &experiment) const;
+
+            /** \brief Compares the results of running an experiment with the loaded actions against the
+             *  recorded results.
+             *  \param[in] dataset Results of the experiment.
+             *  \return A comparison for each loaded action with results.
+             */
+            std::vector<Comparison> compare(const PlanDataSet &dataset) const;
+
+            /** \brief Logs a summary of comparisons, with the queries whose replayed success differs from
+             *  the recording.
+             *  \param[in] comparisons Comparisons to summarize.
+             */
+            static void logComparison(const std::vector<Comparison> &comparisons);
+
+        private:
+            PlannerPtr planner_;          ///< Planner to replay with.
+            std::vector<Entry> entries_;  ///< Loaded actions.
+        };
+    }  // namespace movegroup
+}  // namespace robowflex
+
+#endif
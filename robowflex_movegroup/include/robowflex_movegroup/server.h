@@ -0,0 +1,175 @@
+/* Author: Zachary Kingston */
+
+#ifndef ROBOWFLEX_MOVEGROUP_SERVER_
+#define ROBOWFLEX_MOVEGROUP_SERVER_
+
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <ros/callback_queue.h>
+#include <ros/node_handle.h>
+#include <ros/spinner.h>
+
+#include <moveit_msgs/GetMotionPlan.h>
+#include <moveit_msgs/PlanningScene.h>
+
+#include <robowflex_library/class_forward.h>
+#include <robowflex_library/planning.h>
+#include <robowflex_library/robot.h>
+#include <robowflex_library/scene.h>
+
+namespace robowflex
+{
+    namespace movegroup
+    {
+        /** \brief A long-running planning service that keeps a warm scene and planner.
+         *
+         *  Requests are served over a `moveit_msgs/GetMotionPlan` service, `<name>/plan`, whose callbacks
+         *  run on a spinner of their own so concurrent calls are queued together. The scene is updated from
+         *  `moveit_msgs/PlanningScene` messages on `<name>/scene` (diffs if `is_diff` is set) or with
+         *  updateScene(). Each request is planned in a snapshot of the scene as it was when the request
+         *  arrived, and snapshots are only copied when the scene changes. Queued requests that share a
+         *  snapshot are dispatched together as a batch with Planner::planAsync(), so a PoolPlanner or
+         *  PortfolioPlanner serves them in parallel, and the next batch is dispatched once all requests of
+         *  the last are served. The queue depth, batch sizes, and latency percentiles are published as a
+         *  `diagnostic_msgs/DiagnosticArray` on `<name>/statistics`.
+         */
+        class PlanningServer
+        {
+        public:
+            /** \brief Options for the server.
+             */
+            struct Options
+            {
+                std::string name{"planning_server"};  ///< Namespace of the service and topics.
+                unsigned int threads{4};              ///< Threads receiving service calls.
+                std::size_t max_batch{16};            ///< Most requests dispatched in one batch.
+                double batch_wait{0.002};             ///< Seconds to wait for more requests for a batch.
+                std::size_t latency_window{1000};     ///< Number of recent latencies kept for percentiles.
+                double statistics_rate{1.};           ///< Rate statistics are published at, 0 to disable.
+            };
+
+            /** \brief Statistics of the server.
+             */
+            struct Statistics
+            {
+                std::size_t queue_depth{0};  ///< Requests waiting to be dispatched.
+                std::size_t served{0};       ///< Requests served in total.
+                std::size_t batches{0};      ///< Batches dispatched in total.
+                double mean_batch{0.};       ///< Mean number of requests per batch.
+                double latency_p50{0.};      ///< Median seconds from arrival to response, over the window.
+                double latency_p90{0.};      ///< 90th percentile latency, in seconds.
+                double latency_p99{0.};      ///< 99th percentile latency, in seconds.
+            };
+
+            /** \brief Constructor. Advertises the service and starts serving, with the default options.
+             *  \param[in] scene Scene to plan in, kept and updated by the server.
+             *  \param[in] planner Planner to service requests with, already initialized.
+             */
+            PlanningServer(const ScenePtr &scene, const PlannerPtr &planner);
+
+            /** \brief Constructor. Advertises the service and starts serving.
+             *  \param[in] scene Scene to plan in, kept and updated by the server.
+             *  \param[in] planner Planner to service requests with, already initialized.
+             *  \param[in] options Options for the server.
+             */
+            PlanningServer(const ScenePtr &scene, const PlannerPtr &planner, const Options &options);
+
+            /** \brief Destructor. Stops accepting requests, and finishes those already queued.
+             */
+            ~PlanningServer();
+
+            // non-copyable
+            PlanningServer(PlanningServer const &) = delete;
+            void operator=(PlanningServer const &) = delete;
+
+            /** \brief Update the scene requests are planned in. Requests already queued keep the scene they
+             *  arrived with.
+             *  \param[in] msg Scene message.
+             *  \param[in] diff If true, \a msg is applied as a diff.
+             */
+            void updateScene(const moveit_msgs::PlanningScene &msg, bool diff = false);
+
+            /** \brief Queue a request in the current scene, as the service does.
+             *  \param[in] request Motion plan request to service.
+             *  \return A future of the response.
+             */
+            std::future<planning_interface::MotionPlanResponse>
+            submit(const planning_interface::MotionPlanRequest &request);
+
+            /** \brief Get the current statistics of the server.
+             *  \return The statistics.
+             */
+            Statistics getStatistics() const;
+
+        private:
+            /** \brief A queued request.
+             */
+            struct Entry
+            {
+                SceneConstPtr scene;                                           ///< Snapshot to plan in.
+                planning_interface::MotionPlanRequest request;                 ///< Request to service.
+                std::promise<planning_interface::MotionPlanResponse> promise;  ///< Promise of the response.
+                ros::WallTime arrival;                                         ///< Time of arrival.
+            };
+
+            /** \brief Callback function for the planning service.
+             *  \param[in] request Service request.
+             *  \param[out] response Service response.
+             *  \return True, as failures are reported in the response's error code.
+             */
+            bool planCallback(moveit_msgs::GetMotionPlan::Request &request,
+                              moveit_msgs::GetMotionPlan::Response &response);
+
+            /** \brief Callback function for scene updates.
+             *  \param[in] msg Scene message.
+             */
+            void sceneCallback(const moveit_msgs::PlanningScene &msg);
+
+            /** \brief Callback function for publishing statistics.
+             */
+            void statisticsCallback(const ros::WallTimerEvent &);
+
+            /** \brief Main loop of the dispatcher thread.
+             */
+            void run();
+
+            /** \brief Records the latency of a served request. Must be called with \a mutex_ held.
+             *  \param[in] latency Seconds from arrival to response.
+             */
+            void addLatency(double latency);
+
+            const Options options_;  ///< Options for the server.
+            PlannerPtr planner_;     ///< Planner servicing requests.
+
+            std::mutex scene_mutex_;        ///< Mutex for the scene and snapshot.
+            ScenePtr scene_;                ///< Scene kept up to date.
+            SceneConstPtr snapshot_;        ///< Copy of the scene handed to requests.
+            std::size_t snapshot_version_;  ///< Version of \a scene_ that \a snapshot_ copies.
+
+            mutable std::mutex mutex_;                  ///< Queue and statistics mutex.
+            std::condition_variable queued_;            ///< Notified on new requests.
+            std::deque<std::shared_ptr<Entry>> queue_;  ///< Queued requests.
+            bool stop_{false};                          ///< Stop the dispatcher thread?
+            std::size_t dispatched_{0};                 ///< Requests dispatched.
+            std::size_t served_{0};                     ///< Requests served.
+            std::size_t batches_{0};                    ///< Batches dispatched.
+            std::deque<double> latencies_;              ///< Recent latencies.
+            std::thread thread_;                        ///< Dispatcher thread.
+
+            ros::NodeHandle nh_;               ///< Node handle, on \a callbacks_.
+            ros::CallbackQueue callbacks_;     ///< Queue of the service and topic callbacks.
+            ros::AsyncSpinner spinner_;        ///< Spinner for \a callbacks_.
+            ros::ServiceServer service_;       ///< Planning service.
+            ros::Subscriber scene_sub_;        ///< Scene update subscriber.
+            ros::Publisher statistics_pub_;    ///< Statistics publisher.
+            ros::WallTimer statistics_timer_;  ///< Timer for publishing statistics.
+        };
+    }  // namespace movegroup
+}  // namespace robowflex
+
+#endif
@@ -3,6 +3,13 @@
 #ifndef ROBOWFLEX_MOVEGROUP_SERVICES_
 #define ROBOWFLEX_MOVEGROUP_SERVICES_
 
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <ros/message_event.h>
 #include <ros/node_handle.h>
 
 #include <moveit_msgs/MoveGroupActionGoal.h>
@@ -11,11 +18,19 @@
 
 #include <actionlib/client/simple_action_client.h>
 
+#include <robowflex_library/class_forward.h>
 #include <robowflex_library/robot.h>
 #include <robowflex_library/scene.h>
 
 namespace robowflex
 {
+    /** \cond IGNORE */
+    namespace IO
+    {
+        class Bag;
+    }
+    /** \endcond */
+
     /** \brief Move group interaction related classes and features.
      */
     namespace movegroup
@@ -33,12 +48,16 @@ namespace robowflex
             {
                 std::string id;                           ///< Goal ID.
                 ScenePtr scene;                           ///< Scene used for planning.
+                moveit_msgs::PlanningScene base;          ///< Scene pulled from move group for the goal.
+                moveit_msgs::PlanningScene scene_diff;    ///< Scene diff of the goal, applied to \a base.
+                std::string scene_file;                   ///< File \a base was loaded from, if saved apart.
                 moveit_msgs::MotionPlanRequest request;   ///< Motion planning request.
                 bool success;                             ///< Planning success.
                 double time;                              ///< Planning time.
                 moveit_msgs::RobotTrajectory trajectory;  ///< Planned trajectory on success.
 
-                /** \brief Load a recorded action from a YAML file.
+                /** \brief Load a recorded action from a YAML file. The scene is loaded into \a base and
+                 *  \a scene_diff as messages, \a scene is not set as there is no robot to create it for.
                  *  \param[in] filename Filename to load from.
                  *  \return True on success, false on failure.
                  */
@@ -49,10 +68,98 @@ namespace robowflex
                  *  \return True on success, false on failure.
                  */
                 bool toYAMLFile(const std::string &filename);
+
+                /** \brief Save a recorded action to a YAML file, with only its scene diff and a reference to
+                 *  a separately saved base scene, rather than the full scene. The robot state of the base
+                 *  scene is still saved with the action, as it usually changes between actions.
+                 *  \param[in] filename Filename to save as.
+                 *  \param[in] scene_file File the base scene of the action is saved in.
+                 *  \return True on success, false on failure.
+                 */
+                bool toYAMLFile(const std::string &filename, const std::string &scene_file) const;
             };
 
             typedef std::function<void(Action &)> ResultCallback;
 
+            /** \cond IGNORE */
+            ROBOWFLEX_CLASS_FORWARD(Execution);
+            /** \endcond */
+
+            /** \brief A handle to a trajectory queued for execution by executeTrajectoryAsync().
+             */
+            class Execution
+            {
+            public:
+                /** \brief Status of an execution.
+                 */
+                enum Status
+                {
+                    QUEUED,     ///< Waiting for earlier executions to finish.
+                    ACTIVE,     ///< Being executed by move group.
+                    SUCCEEDED,  ///< Executed successfully.
+                    FAILED,     ///< Execution failed.
+                    CANCELED    ///< Canceled before or during execution.
+                };
+
+                /** \brief Constructor.
+                 *  \param[in] helper Helper executing the trajectory.
+                 *  \param[in] goal Goal to send to move group.
+                 *  \param[in] duration Duration of the trajectory.
+                 */
+                Execution(MoveGroupHelper &helper, const moveit_msgs::ExecuteTrajectoryGoal &goal,
+                          double duration);
+
+                /** \brief Get the status of the execution.
+                 *  \return The status.
+                 */
+                Status getStatus() const;
+
+                /** \brief Returns true if the execution is finished (succeeded, failed, or canceled).
+                 *  \return True if finished, false otherwise.
+                 */
+                bool isDone() const;
+
+                /** \brief Get the progress of the execution, as the fraction of the trajectory's duration
+                 *  that has elapsed since it started executing.
+                 *  \return The progress, in [0, 1].
+                 */
+                double getProgress() const;
+
+                /** \brief Blocks until the execution is finished.
+                 *  \return True if the trajectory was executed successfully, false otherwise.
+                 */
+                bool wait() const;
+
+                /** \brief Cancels the execution. Queued executions are skipped, and an active execution is
+                 *  preempted.
+                 */
+                void cancel();
+
+            private:
+                friend class MoveGroupHelper;
+
+                /** \brief Changes the status of the execution, if it is currently \a from.
+                 *  \param[in] from Status the execution must have.
+                 *  \param[in] to Status to change to.
+                 *  \return True if the status was changed, false otherwise.
+                 */
+                bool transition(Status from, Status to);
+
+                /** \brief Finishes the execution with a status, unless it is already finished.
+                 *  \param[in] status Final status.
+                 */
+                void finish(Status status);
+
+                MoveGroupHelper &helper_;                        ///< Helper executing the trajectory.
+                const moveit_msgs::ExecuteTrajectoryGoal goal_;  ///< Goal to send to move group.
+                const double duration_;                          ///< Duration of the trajectory.
+
+                mutable std::mutex mutex_;              ///< Status mutex.
+                mutable std::condition_variable done_;  ///< Notified when finished.
+                Status status_{QUEUED};                 ///< Status of the execution.
+                ros::WallTime start_;                   ///< Time execution started.
+            };
+
             /** \brief Constructor. Sets up service clients.
              *  \param[in] move_group Name of the move group namespace.
              */
@@ -74,6 +181,20 @@ namespace robowflex
              */
             bool executeTrajectory(const robot_trajectory::RobotTrajectory &path);
 
+            /** \brief Queues a planned trajectory for execution through move group, and returns
+             *  immediately. Trajectories are executed in the order they are queued, and the goal for each is
+             *  prepared when queued, so the next trajectory is sent as soon as the previous one finishes.
+             *  Do not mix with executeTrajectory() while executions are queued.
+             *  \param[in] path Path to execute.
+             *  \return A handle to the execution, or nullptr if the path cannot be executed.
+             */
+            ExecutionPtr executeTrajectoryAsync(const robot_trajectory::RobotTrajectory &path);
+
+            /** \brief Blocks until all queued executions are finished.
+             *  \return True if all executions succeeded, false otherwise.
+             */
+            bool waitForExecutions();
+
             /** \brief Pulls the current robot state from move group.
              *  \param[out] robot Robot whose state to set.
              *  \return True on success, false on failure.
@@ -86,6 +207,36 @@ namespace robowflex
              */
             bool pullScene(ScenePtr scene);
 
+            /** \brief Pulls only some components of the current planning scene from move group, and merges
+             *  them into \a scene as a diff. If world object names are pulled, objects that are no longer in
+             *  move group's scene are removed from \a scene. Objects are only added or updated if their
+             *  geometry (moveit_msgs::PlanningSceneComponents::WORLD_OBJECT_GEOMETRY) is pulled as well.
+             *  \param[out] scene Scene to update with the components observed by move group.
+             *  \param[in] components Bitmask of moveit_msgs::PlanningSceneComponents to pull.
+             *  \return True on success, false on failure.
+             */
+            bool pullScene(ScenePtr scene, uint32_t components);
+
+            /** \brief Keeps \a scene in sync with move group, by pulling the full scene (with object
+             *  geometry) once and then applying the scene diffs move group publishes as its monitored scene
+             *  changes. Diffs received before the pull was requested are dropped, as the pull includes them.
+             *  Diffs are applied from the ROS spinner while holding getSyncMutex(), which should be locked
+             *  when reading \a scene from other threads. While syncing, intercepted goals use \a scene
+             *  instead of pulling the scene from move group.
+             *  \param[in] scene Scene to keep in sync.
+             *  \return True on success, false if the initial pull failed.
+             */
+            bool syncScene(const ScenePtr &scene);
+
+            /** \brief Stops keeping a scene in sync, see syncScene().
+             */
+            void stopSyncScene();
+
+            /** \brief Get the mutex held while a synced scene is updated, see syncScene().
+             *  \return The mutex.
+             */
+            std::mutex &getSyncMutex();
+
             /** \brief Pushes the current planning scene to move group.
              *  \param[in] scene Scene to use to set move group's current scene.
              *  \return True on success, false on failure.
@@ -98,6 +249,26 @@ namespace robowflex
             bool clearOctomap();
 
         private:
+            /** \brief Creates the goal to execute a trajectory through move group.
+             *  \param[in] path Path to execute.
+             *  \param[out] goal The goal.
+             *  \param[out] duration Duration of the trajectory.
+             *  \return True on success, false if the path is not time parameterized.
+             */
+            static bool makeExecuteGoal(const robot_trajectory::RobotTrajectory &path,
+                                        moveit_msgs::ExecuteTrajectoryGoal &goal, double &duration);
+
+            /** \brief Sends the next queued execution to move group, if there is one. Must be called with
+             *  \a execution_mutex_ held.
+             */
+            void executeNext();
+
+            /** \brief Pulls the current planning scene from move group as a message.
+             *  \param[out] msg Message to set to the current scene observed by move group.
+             *  \return True on success, false on failure.
+             */
+            bool pullSceneMessage(moveit_msgs::PlanningScene &msg);
+
             /** \brief Callback function for a move group goal.
              *  \param[in] msg Goal message.
              */
@@ -108,6 +279,14 @@ namespace robowflex
              */
             void moveGroupResultCallback(const moveit_msgs::MoveGroupActionResult &msg);
 
+            /** \brief Callback function for a monitored scene update from move group. Updates received
+             *  before the full scene was pulled are already part of it, and are dropped.
+             *  \param[in] event Scene message, usually a diff, with the time it was received.
+             */
+            void sceneCallback(const ros::MessageEvent<const moveit_msgs::PlanningScene> &event);
+
+            const std::string move_group_;  ///< Name of the move group namespace.
+
             ros::NodeHandle nh_;          ///< Node handle.
             ros::Subscriber goal_sub_;    ///< Move group goal subscriber.
             ros::Subscriber result_sub_;  ///< Move group result subscriber.
@@ -120,6 +299,15 @@ namespace robowflex
 
             ResultCallback callback_;  ///< Callback function for move group results.
 
+            std::mutex execution_mutex_;           ///< Mutex for executions.
+            std::deque<ExecutionPtr> executions_;  ///< Queued executions.
+            ExecutionPtr executing_;               ///< Active execution, if any.
+
+            ros::Subscriber scene_sub_;  ///< Monitored scene subscriber, while syncing.
+            ScenePtr synced_;            ///< Scene kept in sync, if any.
+            ros::Time sync_time_;        ///< When the full scene was pulled, older diffs are dropped.
+            std::mutex sync_mutex_;      ///< Mutex for updating \a synced_ and \a sync_time_.
+
             std::map<std::string, Action> requests_;  ///< Move group requests
 
             RobotPtr robot_;  ///< Robot on the parameter server used by move group.
@@ -129,6 +317,92 @@ namespace robowflex
             static const std::string APPLY_SCENE;    ///< Name of apply scene service.
             static const std::string CLEAR_OCTOMAP;  ///< Name of clear octomap service.
             static const std::string EXECUTE;        ///< Name of execute trajectory service.
+            static const std::string MONITORED;      ///< Name of monitored scene topic.
+        };
+
+        /** \brief Records actions intercepted by a robowflex::movegroup::MoveGroupHelper on a background
+         *  thread, so the subscriber callback only queues them and is never blocked by serialization.
+         *  The base scene pulled from move group is only saved when it changes, and each action stores the
+         *  scene diff of its goal on top of the last saved base scene.
+         */
+        class ActionRecorder
+        {
+        public:
+            /** \brief Formats to record in.
+             */
+            enum Format
+            {
+                YAML,  ///< One YAML file per action, and one YAML file per distinct base scene.
+                BAG    ///< A single rosbag, with `scene`, `goal`, and `result` topics.
+            };
+
+            /** \brief Constructor. Starts the writer thread.
+             *  \param[in] path Directory to write files to for YAML, or the bag file for BAG.
+             *  \param[in] format Format to record in.
+             */
+            ActionRecorder(const std::string &path, Format format = YAML);
+
+            /** \brief Destructor. Writes all queued actions, then stops the writer thread.
+             */
+            ~ActionRecorder();
+
+            // non-copyable
+            ActionRecorder(ActionRecorder const &) = delete;
+            void operator=(ActionRecorder const &) = delete;
+
+            /** \brief Queues an action to be written. Returns immediately.
+             *  \param[in] action Action to record.
+             */
+            void record(const MoveGroupHelper::Action &action);
+
+            /** \brief Get a callback that records actions, for MoveGroupHelper::setResultCallback().
+             *  The recorder must outlive the helper the callback is given to.
+             *  \return The callback.
+             */
+            MoveGroupHelper::ResultCallback getCallback();
+
+            /** \brief Blocks until all queued actions are written.
+             */
+            void flush();
+
+            /** \brief Get the number of actions written so far.
+             *  \return The number of actions written.
+             */
+            std::size_t getRecorded() const;
+
+        private:
+            /** \brief Main loop of the writer thread.
+             */
+            void run();
+
+            /** \brief Writes an action.
+             *  \param[in] time Time the action was queued at.
+             *  \param[in] action Action to write.
+             */
+            void write(const ros::Time &time, const MoveGroupHelper::Action &action);
+
+            /** \brief Saves the base scene of \a action, if it is different from the last one saved.
+             *  \param[in] action Action to save the base scene of.
+             *  \return True if the base scene was saved, false if it was unchanged or failed to save.
+             */
+            bool writeScene(const MoveGroupHelper::Action &action);
+
+            const std::string path_;  ///< Directory or bag file to write to.
+            const Format format_;     ///< Format to record in.
+
+            std::unique_ptr<IO::Bag> bag_;     ///< Bag to record to, for BAG.
+            std::vector<uint8_t> last_scene_;  ///< Serialized last saved base scene.
+            std::string scene_file_;           ///< File of the last saved base scene, for YAML.
+            std::size_t scenes_{0};            ///< Number of base scenes saved.
+
+            mutable std::mutex mutex_;                                         ///< Queue mutex.
+            std::condition_variable queued_;                                   ///< Notified on new actions.
+            std::condition_variable written_;                                  ///< Notified when written.
+            std::deque<std::pair<ros::Time, MoveGroupHelper::Action>> queue_;  ///< Queued actions.
+            std::size_t recorded_{0};                                          ///< Number of actions written.
+            bool writing_{false};                                              ///< Writing an action?
+            bool stop_{false};                                                 ///< Stop the writer thread?
+            std::thread thread_;                                               ///< Writer thread.
         };
     }  // namespace movegroup
 }  // namespace robowflex
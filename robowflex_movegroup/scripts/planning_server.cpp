@@ -0,0 +1,51 @@
+/* Author: Zachary Kingston */
+
+#include <thread>
+
+#include <robowflex_library/log.h>
+#include <robowflex_library/planning.h>
+#include <robowflex_library/robot.h>
+#include <robowflex_library/scene.h>
+#include <robowflex_library/util.h>
+
+#include <robowflex_movegroup/server.h>
+
+using namespace robowflex;
+
+/* \file planning_server.cpp
+ * An example script that shows how to use PlanningServer. The robot is loaded
+ * from the parameter server, and a pool of OMPL planners, configured from the
+ * YAML file given as the first argument, services requests sent to the
+ * `planning_server/plan` service. Scene updates are read from the
+ * `planning_server/scene` topic, and statistics are published to
+ * `planning_server/statistics`.
+ *
+ * Usage: planning_server <ompl_planning.yaml> [threads]
+ */
+
+int main(int argc, char **argv)
+{
+    // Startup ROS
+    ROS ros(argc, argv, "planning_server");
+
+    const auto &args = ros.getArgs();
+    if (args.size() < 2)
+    {
+        RBX_ERROR("Usage: %s <ompl_planning.yaml> [threads]", args[0]);
+        return 1;
+    }
+
+    // Load the robot move group uses.
+    auto robot = std::make_shared<ParamRobot>();
+    auto scene = std::make_shared<Scene>(robot);
+
+    // Create a pool of planners, one per thread.
+    const unsigned int threads = (args.size() > 2) ? std::stoi(args[2]) : std::thread::hardware_concurrency();
+    auto planner = std::make_shared<PoolPlanner>(robot, threads);
+    if (not planner->initialize<OMPL::OMPLPipelinePlanner>(args[1]))
+        return 1;
+
+    // Serve requests until killed.
+    movegroup::PlanningServer server(scene, planner);
+    ros.wait();
+}
@@ -1,8 +1,5 @@
 /* Author: Zachary Kingston */
 
-#include <boost/date_time.hpp>
-
-#include <robowflex_library/log.h>
 #include <robowflex_library/util.h>
 
 #include <robowflex_movegroup/services.h>
@@ -10,24 +7,14 @@
 using namespace robowflex;
 
 /* \file tapedeck.cpp
- * An example script that shows how to use MoveGroupHelper. Here, a callback is
- * installed so that every motion plan issued to MoveGroup is saved to disk as a
- * YAML file. This is useful for collecting and replaying motion planning
- * requests that are done over the course of an experiment.
+ * An example script that shows how to use MoveGroupHelper. Here, an
+ * ActionRecorder is installed so that every motion plan issued to MoveGroup is
+ * saved to disk as a YAML file, on a background thread so no requests are
+ * dropped. Base scenes are only saved when they change. This is useful for
+ * collecting and replaying motion planning requests that are done over the
+ * course of an experiment.
  */
 
-// Output a captured action to a YAML file.
-void callback(movegroup::MoveGroupHelper::Action &action)
-{
-    ros::Time time = ros::Time::now();
-
-    // Save the requests to a folder in the home directory.
-    const std::string filename = "~/robowflex_tapedeck/" + to_iso_string(time.toBoost()) + ".yml";
-    action.toYAMLFile(filename);
-
-    RBX_INFO("Wrote YAML for Request ID `%s` to file `%s`", action.id, filename);
-}
-
 int main(int argc, char **argv)
 {
     // Startup ROS
@@ -36,8 +23,11 @@ int main(int argc, char **argv)
     // Create helper
     movegroup::MoveGroupHelper helper;
 
+    // Save the requests to a folder in the home directory.
+    movegroup::ActionRecorder recorder("~/robowflex_tapedeck/");
+
     // Setup callback function
-    helper.setResultCallback(callback);
+    helper.setResultCallback(recorder.getCallback());
 
     // Wait until killed
     ros.wait();
@@ -0,0 +1,176 @@
+/* Author: Zachary Kingston */
+
+#include <boost/filesystem.hpp>
+
+#include <robowflex_library/dataset.h>
+#include <robowflex_library/io.h>
+#include <robowflex_library/log.h>
+#include <robowflex_library/planning.h>
+#include <robowflex_library/scene.h>
+#include <robowflex_library/util.h>
+
+#include <robowflex_movegroup/replay.h>
+
+using namespace robowflex;
+using namespace robowflex::movegroup;
+
+namespace
+{
+    bool hasSuffix(const std::string &string, const std::string &suffix)
+    {
+        return string.size() >= suffix.size() and
+               string.compare(string.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+}  // namespace
+
+///
+/// Replay
+///
+
+Replay::Replay(const PlannerPtr &planner) : planner_(planner)
+{
+}
+
+std::size_t Replay::load(const std::string &pattern, const Pool &pool)
+{
+    // Only action files, not the base scenes and octomap sidecars written alongside them.
+    std::vector<std::string> files;
+    for (const auto &file : Dataset::findFiles(pattern))
+        if ((hasSuffix(file, ".yml") or hasSuffix(file, ".yaml")) and not hasSuffix(file, "_scene.yml"))
+            files.emplace_back(file);
+
+    std::vector<Entry> entries(files.size());
+    std::vector<char> loaded(files.size(), false);
+
+    // Each file is large enough to be its own chunk.
+    pool.parallelFor(0, files.size(), [&](std::size_t i) { loaded[i] = loadEntry(files[i], entries[i]); }, 1);
+
+    std::size_t n = 0;
+    for (std::size_t i = 0; i < files.size(); ++i)
+        if (loaded[i])
+        {
+            entries_.emplace_back(std::move(entries[i]));
+            ++n;
+        }
+
+    return n;
+}
+
+bool Replay::loadEntry(const std::string &filename, Entry &entry) const
+{
+    auto &action = entry.action;
+    if (not action.fromYAMLFile(filename))
+    {
+        RBX_ERROR("Failed to read file: %s for action", filename);
+        return false;
+    }
+
+    const boost::filesystem::path path(filename);
+    entry.name = path.stem().string();
+
+    auto scene = std::make_shared<Scene>(planner_->getRobot());
+    if (not action.scene_file.empty())
+    {
+        // If the recording was moved, the base scene is next to the action.
+        std::string scene_file = action.scene_file;
+        const auto moved = path.parent_path() / boost::filesystem::path(scene_file).filename();
+        const bool exists = boost::filesystem::exists(IO::resolvePackage(scene_file));
+        if (not exists and boost::filesystem::exists(moved))
+            scene_file = moved.string();
+
+        if (not scene->fromYAMLFile(scene_file))
+        {
+            RBX_ERROR("Failed to read file: %s for base scene of action %s", scene_file, filename);
+            return false;
+        }
+
+        // The robot state is recorded with each action, not with the base scene.
+        moveit_msgs::PlanningScene state;
+        state.is_diff = true;
+        state.robot_state = action.base.robot_state;
+        scene->useMessage(state, true);
+    }
+    else
+        scene->useMessage(action.base);
+
+    scene->useMessage(action.scene_diff, true);
+    action.scene = scene;
+
+    return true;
+}
+
+const std::vector<Replay::Entry> &Replay::getEntries() const
+{
+    return entries_;
+}
+
+void Replay::addToExperiment(Experiment &experiment) const
+{
+    for (const auto &entry : entries_)
+        experiment.addQuery(entry.name, entry.action.scene, planner_, entry.action.request);
+}
+
+std::vector<Replay::Comparison> Replay::compare(const PlanDataSet &dataset) const
+{
+    std::vector<Comparison> comparisons;
+    for (const auto &entry : entries_)
+    {
+        auto it = dataset.data.find(entry.name);
+        if (it == dataset.data.end() or it->second.empty())
+            continue;
+
+        Comparison comparison;
+        comparison.name = entry.name;
+        comparison.recorded_success = entry.action.success;
+        comparison.recorded_time = entry.action.time;
+
+        for (const auto &run : it->second)
+        {
+            ++comparison.runs;
+            comparison.successes += run->success;
+            comparison.mean_time += run->time;
+        }
+
+        comparison.mean_time /= comparison.runs;
+        if (comparison.mean_time > 0)
+            comparison.speedup = comparison.recorded_time / comparison.mean_time;
+
+        comparisons.emplace_back(comparison);
+    }
+
+    return comparisons;
+}
+
+void Replay::logComparison(const std::vector<Comparison> &comparisons)
+{
+    if (comparisons.empty())
+    {
+        RBX_WARN("No replayed actions to compare!");
+        return;
+    }
+
+    std::size_t recorded = 0;
+    double replayed = 0;
+    double recorded_time = 0;
+    double replayed_time = 0;
+
+    for (const auto &comparison : comparisons)
+    {
+        recorded += comparison.recorded_success;
+        replayed += (double)comparison.successes / comparison.runs;
+        recorded_time += comparison.recorded_time;
+        replayed_time += comparison.mean_time;
+
+        // Flag queries that were reliably solved before and not now, or the other way around.
+        const bool solved = comparison.successes * 2 > comparison.runs;
+        if (solved != comparison.recorded_success)
+            RBX_WARN("Action %s: recorded %s in %.3fs, replayed %d/%d successes in %.3fs mean",
+                     comparison.name, (comparison.recorded_success) ? "success" : "failure",
+                     comparison.recorded_time, comparison.successes, comparison.runs, comparison.mean_time);
+    }
+
+    const double n = comparisons.size();
+    RBX_INFO("Replayed %d actions: success rate %.3f recorded, %.3f replayed", comparisons.size(),
+             recorded / n, replayed / n);
+    RBX_INFO("Mean planning time %.3fs recorded, %.3fs replayed", recorded_time / n, replayed_time / n);
+}
@@ -0,0 +1,243 @@
+/* Author: Zachary Kingston */
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include <diagnostic_msgs/DiagnosticArray.h>
+
+#include <robowflex_library/log.h>
+
+#include <robowflex_movegroup/server.h>
+
+using namespace robowflex;
+using namespace robowflex::movegroup;
+
+///
+/// PlanningServer
+///
+
+PlanningServer::PlanningServer(const ScenePtr &scene, const PlannerPtr &planner)
+  : PlanningServer(scene, planner, Options())
+{
+}
+
+PlanningServer::PlanningServer(const ScenePtr &scene, const PlannerPtr &planner, const Options &options)
+  : options_(options)
+  , planner_(planner)
+  , scene_(scene)
+  , snapshot_(scene->deepCopy())
+  , snapshot_version_(scene->getVersion())
+  , nh_(options.name)
+  , spinner_(options.threads, &callbacks_)
+{
+    nh_.setCallbackQueue(&callbacks_);
+
+    thread_ = std::thread(&PlanningServer::run, this);
+
+    service_ = nh_.advertiseService("plan", &PlanningServer::planCallback, this);
+    scene_sub_ = nh_.subscribe("scene", 10, &PlanningServer::sceneCallback, this);
+    statistics_pub_ = nh_.advertise<diagnostic_msgs::DiagnosticArray>("statistics", 1);
+    if (options_.statistics_rate > 0)
+        statistics_timer_ = nh_.createWallTimer(ros::WallDuration(1. / options_.statistics_rate),
+                                                &PlanningServer::statisticsCallback, this);
+
+    spinner_.start();
+    RBX_INFO("Planning server `%s` is ready", nh_.getNamespace());
+}
+
+PlanningServer::~PlanningServer()
+{
+    // Callbacks waiting on their responses are served before the dispatcher stops.
+    statistics_timer_.stop();
+    service_.shutdown();
+    scene_sub_.shutdown();
+    spinner_.stop();
+
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+
+    queued_.notify_all();
+    thread_.join();
+}
+
+void PlanningServer::updateScene(const moveit_msgs::PlanningScene &msg, bool diff)
+{
+    std::unique_lock<std::mutex> lock(scene_mutex_);
+    scene_->useMessage(msg, diff);
+}
+
+std::future<planning_interface::MotionPlanResponse>
+PlanningServer::submit(const planning_interface::MotionPlanRequest &request)
+{
+    auto entry = std::make_shared<Entry>();
+    entry->request = request;
+    entry->arrival = ros::WallTime::now();
+
+    // Requests share a snapshot until the scene changes, so they can be batched together.
+    {
+        std::unique_lock<std::mutex> lock(scene_mutex_);
+        if (scene_->getVersion() != snapshot_version_)
+        {
+            snapshot_ = scene_->deepCopy();
+            snapshot_version_ = scene_->getVersion();
+        }
+
+        entry->scene = snapshot_;
+    }
+
+    auto future = entry->promise.get_future();
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        queue_.emplace_back(entry);
+    }
+
+    queued_.notify_one();
+    return future;
+}
+
+PlanningServer::Statistics PlanningServer::getStatistics() const
+{
+    Statistics statistics;
+    std::vector<double> latencies;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        statistics.queue_depth = queue_.size();
+        statistics.served = served_;
+        statistics.batches = batches_;
+        statistics.mean_batch = (batches_) ? double(dispatched_) / batches_ : 0.;
+        latencies.assign(latencies_.begin(), latencies_.end());
+    }
+
+    if (latencies.empty())
+        return statistics;
+
+    std::sort(latencies.begin(), latencies.end());
+    const auto &at = [&](double p) {
+        return latencies[static_cast<std::size_t>(p * (latencies.size() - 1) + 0.5)];
+    };
+
+    statistics.latency_p50 = at(0.5);
+    statistics.latency_p90 = at(0.9);
+    statistics.latency_p99 = at(0.99);
+    return statistics;
+}
+
+bool PlanningServer::planCallback(moveit_msgs::GetMotionPlan::Request &request,
+                                  moveit_msgs::GetMotionPlan::Response &response)
+{
+    auto future = submit(request.motion_plan_request);
+
+    try
+    {
+        future.get().getMessage(response.motion_plan_response);
+    }
+    catch (const std::exception &e)
+    {
+        RBX_ERROR("Planning request failed: %s", e.what());
+        response.motion_plan_response.error_code.val = moveit_msgs::MoveItErrorCodes::FAILURE;
+    }
+
+    return true;
+}
+
+void PlanningServer::sceneCallback(const moveit_msgs::PlanningScene &msg)
+{
+    updateScene(msg, msg.is_diff);
+}
+
+void PlanningServer::statisticsCallback(const ros::WallTimerEvent &)
+{
+    const auto &statistics = getStatistics();
+
+    diagnostic_msgs::DiagnosticStatus status;
+    status.level = diagnostic_msgs::DiagnosticStatus::OK;
+    status.name = nh_.getNamespace();
+    status.message = log::format("%1% queued", statistics.queue_depth);
+
+    const auto &add = [&](const std::string &key, const std::string &value) {
+        diagnostic_msgs::KeyValue pair;
+        pair.key = key;
+        pair.value = value;
+        status.values.emplace_back(pair);
+    };
+
+    add("queue_depth", std::to_string(statistics.queue_depth));
+    add("served", std::to_string(statistics.served));
+    add("batches", std::to_string(statistics.batches));
+    add("mean_batch", std::to_string(statistics.mean_batch));
+    add("latency_p50", std::to_string(statistics.latency_p50));
+    add("latency_p90", std::to_string(statistics.latency_p90));
+    add("latency_p99", std::to_string(statistics.latency_p99));
+
+    diagnostic_msgs::DiagnosticArray msg;
+    msg.header.stamp = ros::Time::now();
+    msg.status.emplace_back(status);
+    statistics_pub_.publish(msg);
+}
+
+void PlanningServer::run()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true)
+    {
+        queued_.wait(lock, [&] { return stop_ or not queue_.empty(); });
+
+        // Queued requests are still served when stopping.
+        if (queue_.empty())
+            break;
+
+        // Give concurrent callers a moment to join the batch.
+        if (not stop_ and queue_.size() < options_.max_batch and options_.batch_wait > 0)
+            queued_.wait_for(lock, std::chrono::duration<double>(options_.batch_wait),
+                             [&] { return stop_ or queue_.size() >= options_.max_batch; });
+
+        // A batch is the longest run of queued requests in the same snapshot.
+        std::vector<std::shared_ptr<Entry>> batch;
+        const SceneConstPtr scene = queue_.front()->scene;
+        while (not queue_.empty() and batch.size() < std::max<std::size_t>(options_.max_batch, 1) and
+               queue_.front()->scene == scene)
+        {
+            batch.emplace_back(queue_.front());
+            queue_.pop_front();
+        }
+
+        ++batches_;
+        dispatched_ += batch.size();
+        lock.unlock();
+
+        std::vector<Planner::PlanJobPtr> jobs;
+        jobs.reserve(batch.size());
+        for (const auto &entry : batch)
+            jobs.emplace_back(planner_->planAsync(entry->scene, entry->request));
+
+        std::vector<double> latencies;
+        for (std::size_t i = 0; i < batch.size(); ++i)
+        {
+            try
+            {
+                auto response = jobs[i]->get();
+                latencies.emplace_back((ros::WallTime::now() - batch[i]->arrival).toSec());
+                batch[i]->promise.set_value(std::move(response));
+            }
+            catch (...)
+            {
+                batch[i]->promise.set_exception(std::current_exception());
+            }
+        }
+
+        lock.lock();
+        served_ += batch.size();
+        for (const auto &latency : latencies)
+            addLatency(latency);
+    }
+}
+
+void PlanningServer::addLatency(double latency)
+{
+    latencies_.emplace_back(latency);
+    while (latencies_.size() > options_.latency_window)
+        latencies_.pop_front();
+}
@@ -1,5 +1,10 @@
 /* Author: Zachary Kingston */
 
+#include <set>
+
+#include <boost/date_time.hpp>
+#include <boost/filesystem.hpp>
+
 #include <moveit_msgs/ApplyPlanningScene.h>
 #include <moveit_msgs/ExecuteTrajectoryGoal.h>
 #include <moveit_msgs/ExecuteTrajectoryResult.h>
@@ -7,6 +12,7 @@
 #include <std_srvs/Empty.h>
 
 #include <robowflex_library/io.h>
+#include <robowflex_library/io/bag.h>
 #include <robowflex_library/io/yaml.h>
 #include <robowflex_library/log.h>
 #include <robowflex_library/trajectory.h>
@@ -40,6 +46,19 @@ bool MoveGroupHelper::Action::fromYAMLFile(const std::string &filename)
     if (IO::isNode(file.second["trajectory"]))
         trajectory = file.second["trajectory"].as<moveit_msgs::RobotTrajectory>();
 
+    if (IO::isNode(file.second["scene_file"]))
+        scene_file = file.second["scene_file"].as<std::string>();
+
+    if (IO::isNode(file.second["scene_diff"]))
+        scene_diff = file.second["scene_diff"].as<moveit_msgs::PlanningScene>();
+
+    // Actions saved with toYAMLFile(filename) contain the full scene.
+    if (IO::isNode(file.second["scene"]))
+        base = file.second["scene"].as<moveit_msgs::PlanningScene>();
+
+    if (IO::isNode(file.second["robot_state"]))
+        base.robot_state = file.second["robot_state"].as<moveit_msgs::RobotState>();
+
     return true;
 }
 
@@ -49,10 +68,24 @@ bool MoveGroupHelper::Action::toYAMLFile(const std::string &filename)
 
     node["id"] = id;
 
-    moveit_msgs::PlanningScene scene_msg;
-    scene->getSceneConst()->getPlanningSceneMsg(scene_msg);
-    node["scene"] = IO::toNode(scene_msg);
+    node["scene"] = IO::toNode(*scene->getMessageConst());
+
+    node["request"] = IO::toNode(request);
+    node["success"] = success ? "true" : "false";
+    node["time"] = time;
+    node["trajectory"] = IO::toNode(trajectory);
+
+    return IO::YAMLToFile(node, filename);
+}
+
+bool MoveGroupHelper::Action::toYAMLFile(const std::string &filename, const std::string &scene_file) const
+{
+    YAML::Node node;
 
+    node["id"] = id;
+    node["scene_file"] = scene_file;
+    node["scene_diff"] = IO::toNode(scene_diff);
+    node["robot_state"] = IO::toNode(base.robot_state);
     node["request"] = IO::toNode(request);
     node["success"] = success ? "true" : "false";
     node["time"] = time;
@@ -61,6 +94,83 @@ bool MoveGroupHelper::Action::toYAMLFile(const std::string &filename)
     return IO::YAMLToFile(node, filename);
 }
 
+///
+/// MoveGroupHelper::Execution
+///
+
+MoveGroupHelper::Execution::Execution(MoveGroupHelper &helper, const moveit_msgs::ExecuteTrajectoryGoal &goal,
+                                      double duration)
+  : helper_(helper), goal_(goal), duration_(duration)
+{
+}
+
+MoveGroupHelper::Execution::Status MoveGroupHelper::Execution::getStatus() const
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    return status_;
+}
+
+bool MoveGroupHelper::Execution::isDone() const
+{
+    const auto status = getStatus();
+    return status != QUEUED and status != ACTIVE;
+}
+
+double MoveGroupHelper::Execution::getProgress() const
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    switch (status_)
+    {
+        case QUEUED:
+            return 0.;
+        case ACTIVE:
+            return std::min(1., (ros::WallTime::now() - start_).toSec() / duration_);
+        case SUCCEEDED:
+            return 1.;
+        default:
+            return std::min(1., (start_.isZero()) ? 0. : (ros::WallTime::now() - start_).toSec() / duration_);
+    }
+}
+
+bool MoveGroupHelper::Execution::wait() const
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [&] { return status_ != QUEUED and status_ != ACTIVE; });
+    return status_ == SUCCEEDED;
+}
+
+void MoveGroupHelper::Execution::cancel()
+{
+    if (transition(QUEUED, CANCELED))
+        return;
+
+    std::unique_lock<std::mutex> lock(helper_.execution_mutex_);
+    if (helper_.executing_.get() == this)
+        helper_.eac_.cancelGoal();
+}
+
+bool MoveGroupHelper::Execution::transition(Status from, Status to)
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (status_ != from)
+            return false;
+
+        status_ = to;
+        if (to == ACTIVE)
+            start_ = ros::WallTime::now();
+    }
+
+    done_.notify_all();
+    return true;
+}
+
+void MoveGroupHelper::Execution::finish(Status status)
+{
+    if (not transition(QUEUED, status))
+        transition(ACTIVE, status);
+}
+
 ///
 /// MoveGroupHelper
 ///
@@ -70,9 +180,11 @@ const std::string MoveGroupHelper::GET_SCENE{"get_planning_scene"};
 const std::string MoveGroupHelper::APPLY_SCENE{"apply_planning_scene"};
 const std::string MoveGroupHelper::CLEAR_OCTOMAP{"clear_octomap"};
 const std::string MoveGroupHelper::EXECUTE{"/execute_trajectory"};
+const std::string MoveGroupHelper::MONITORED{"monitored_planning_scene"};
 
 MoveGroupHelper::MoveGroupHelper(const std::string &move_group)
-  : nh_("/")
+  : move_group_(move_group)
+  , nh_("/")
   , goal_sub_(nh_.subscribe(move_group + "/goal", 10, &MoveGroupHelper::moveGroupGoalCallback, this))
   , result_sub_(nh_.subscribe(move_group + "/result", 10, &MoveGroupHelper::moveGroupResultCallback, this))
   , gpsc_(nh_.serviceClient<moveit_msgs::GetPlanningScene>(GET_SCENE, true))
@@ -97,8 +209,23 @@ MoveGroupHelper::MoveGroupHelper(const std::string &move_group)
 
 MoveGroupHelper::~MoveGroupHelper()
 {
+    {
+        std::unique_lock<std::mutex> lock(execution_mutex_);
+        for (const auto &execution : executions_)
+            execution->finish(Execution::CANCELED);
+
+        executions_.clear();
+        if (executing_)
+        {
+            eac_.cancelGoal();
+            executing_->finish(Execution::CANCELED);
+            executing_.reset();
+        }
+    }
+
     goal_sub_.shutdown();
     result_sub_.shutdown();
+    scene_sub_.shutdown();
     gpsc_.shutdown();
     apsc_.shutdown();
     co_.shutdown();
@@ -109,21 +236,17 @@ void MoveGroupHelper::setResultCallback(const ResultCallback &callback)
     callback_ = callback;
 }
 
-bool MoveGroupHelper::executeTrajectory(const robot_trajectory::RobotTrajectory &path)
+bool MoveGroupHelper::makeExecuteGoal(const robot_trajectory::RobotTrajectory &path,
+                                      moveit_msgs::ExecuteTrajectoryGoal &goal, double &duration)
 {
-    if (!eac_.isServerConnected())
-        return false;
-
-    moveit_msgs::ExecuteTrajectoryGoal goal;
-
     // Check if a Trajectory is time parameterized, with some goofiness for indigo.
 #if ROBOWFLEX_AT_LEAST_KINETIC
-    double value = path.getWayPointDurationFromStart(path.getWayPointCount());
+    duration = path.getWayPointDurationFromStart(path.getWayPointCount());
 #else
-    double value = path.getWaypointDurationFromStart(path.getWayPointCount());
+    duration = path.getWaypointDurationFromStart(path.getWayPointCount());
 #endif
 
-    if (value == 0)
+    if (duration == 0)
     {
         RBX_ERROR("Trajectory is not parameterized and cannot be executed!  did you use "
                   "Trajectory::computeTimeParameterization?");
@@ -131,6 +254,18 @@ bool MoveGroupHelper::executeTrajectory(const robot_trajectory::RobotTrajectory
     }
 
     path.getRobotTrajectoryMsg(goal.trajectory);
+    return true;
+}
+
+bool MoveGroupHelper::executeTrajectory(const robot_trajectory::RobotTrajectory &path)
+{
+    if (!eac_.isServerConnected())
+        return false;
+
+    moveit_msgs::ExecuteTrajectoryGoal goal;
+    double duration;
+    if (not makeExecuteGoal(path, goal, duration))
+        return false;
 
     eac_.sendGoal(goal);
     if (!eac_.waitForResult())
@@ -139,6 +274,80 @@ bool MoveGroupHelper::executeTrajectory(const robot_trajectory::RobotTrajectory
     return eac_.getState() == actionlib::SimpleClientGoalState::SUCCEEDED;
 }
 
+MoveGroupHelper::ExecutionPtr
+MoveGroupHelper::executeTrajectoryAsync(const robot_trajectory::RobotTrajectory &path)
+{
+    if (!eac_.isServerConnected())
+        return nullptr;
+
+    // The goal message is built now, while earlier trajectories are executing.
+    moveit_msgs::ExecuteTrajectoryGoal goal;
+    double duration;
+    if (not makeExecuteGoal(path, goal, duration))
+        return nullptr;
+
+    auto execution = std::make_shared<Execution>(*this, goal, duration);
+
+    std::unique_lock<std::mutex> lock(execution_mutex_);
+    executions_.emplace_back(execution);
+    if (not executing_)
+        executeNext();
+
+    return execution;
+}
+
+bool MoveGroupHelper::waitForExecutions()
+{
+    std::vector<ExecutionPtr> executions;
+    {
+        std::unique_lock<std::mutex> lock(execution_mutex_);
+        if (executing_)
+            executions.emplace_back(executing_);
+
+        executions.insert(executions.end(), executions_.begin(), executions_.end());
+    }
+
+    bool success = true;
+    for (const auto &execution : executions)
+        success &= execution->wait();
+
+    return success;
+}
+
+void MoveGroupHelper::executeNext()
+{
+    executing_.reset();
+    while (not executions_.empty())
+    {
+        auto next = executions_.front();
+        executions_.pop_front();
+
+        // Skip executions canceled while queued.
+        if (not next->transition(Execution::QUEUED, Execution::ACTIVE))
+            continue;
+
+        executing_ = next;
+
+        // The next goal is sent from the done callback, so there is no delay between executions.
+        eac_.sendGoal(next->goal_, [this, next](const actionlib::SimpleClientGoalState &state,
+                                                const moveit_msgs::ExecuteTrajectoryResultConstPtr &) {
+            std::unique_lock<std::mutex> lock(execution_mutex_);
+            if (state == actionlib::SimpleClientGoalState::SUCCEEDED)
+                next->finish(Execution::SUCCEEDED);
+            else if (state == actionlib::SimpleClientGoalState::PREEMPTED or
+                     state == actionlib::SimpleClientGoalState::RECALLED)
+                next->finish(Execution::CANCELED);
+            else
+                next->finish(Execution::FAILED);
+
+            if (executing_ == next)
+                executeNext();
+        });
+
+        return;
+    }
+}
+
 bool MoveGroupHelper::pullState(RobotPtr robot)
 {
     moveit_msgs::GetPlanningScene::Request request;
@@ -156,6 +365,90 @@ bool MoveGroupHelper::pullState(RobotPtr robot)
 }
 
 bool MoveGroupHelper::pullScene(ScenePtr scene)
+{
+    moveit_msgs::PlanningScene msg;
+    if (not pullSceneMessage(msg))
+        return false;
+
+    scene->useMessage(msg);
+    return true;
+}
+
+bool MoveGroupHelper::pullScene(ScenePtr scene, uint32_t components)
+{
+    moveit_msgs::GetPlanningScene::Request request;
+    moveit_msgs::GetPlanningScene::Response response;
+    request.components.components = components;
+
+    if (not gpsc_.call(request, response))
+        return false;
+
+    // Diffs only add objects, so remove the objects move group no longer has.
+    if (components & moveit_msgs::PlanningSceneComponents::WORLD_OBJECT_NAMES)
+    {
+        std::set<std::string> names;
+        for (const auto &object : response.scene.world.collision_objects)
+            names.emplace(object.id);
+
+        for (const auto &name : scene->getCollisionObjects())
+            if (names.find(name) == names.end())
+                scene->removeCollisionObject(name);
+    }
+
+    // Objects pulled by name only have no shapes, and cannot be added to the scene.
+    if (not(components & moveit_msgs::PlanningSceneComponents::WORLD_OBJECT_GEOMETRY))
+        response.scene.world.collision_objects.clear();
+
+    response.scene.is_diff = true;
+    scene->useMessage(response.scene, true);
+    return true;
+}
+
+bool MoveGroupHelper::syncScene(const ScenePtr &scene)
+{
+    stopSyncScene();
+
+    // Subscribe first so no diffs are missed while pulling. Diffs received meanwhile wait for the lock.
+    // Those received before the pull was requested are part of the pulled scene and are dropped, the rest
+    // are applied on top of it.
+    {
+        std::unique_lock<std::mutex> lock(sync_mutex_);
+        synced_ = scene;
+        scene_sub_ = nh_.subscribe(move_group_ + "/" + MONITORED, 10, &MoveGroupHelper::sceneCallback, this);
+        sync_time_ = ros::Time::now();
+
+        if (pullScene(scene))
+            return true;
+    }
+
+    stopSyncScene();
+    return false;
+}
+
+void MoveGroupHelper::stopSyncScene()
+{
+    scene_sub_.shutdown();
+
+    std::unique_lock<std::mutex> lock(sync_mutex_);
+    synced_.reset();
+}
+
+std::mutex &MoveGroupHelper::getSyncMutex()
+{
+    return sync_mutex_;
+}
+
+void MoveGroupHelper::sceneCallback(const ros::MessageEvent<const moveit_msgs::PlanningScene> &event)
+{
+    std::unique_lock<std::mutex> lock(sync_mutex_);
+    if (not synced_ or event.getReceiptTime() < sync_time_)
+        return;
+
+    const auto &msg = *event.getConstMessage();
+    synced_->useMessage(msg, msg.is_diff);
+}
+
+bool MoveGroupHelper::pullSceneMessage(moveit_msgs::PlanningScene &msg)
 {
     moveit_msgs::GetPlanningScene::Request request;
     moveit_msgs::GetPlanningScene::Response response;
@@ -172,7 +465,7 @@ bool MoveGroupHelper::pullScene(ScenePtr scene)
 
     if (gpsc_.call(request, response))
     {
-        scene->useMessage(response.scene);
+        msg = std::move(response.scene);
         return true;
     }
 
@@ -202,9 +495,25 @@ void MoveGroupHelper::moveGroupGoalCallback(const moveit_msgs::MoveGroupActionGo
     RBX_DEBUG("Intercepted request goal ID: `%s`", id);
 
     Action action;
+
+    // A synced scene is already up to date, so there is no need to pull the scene from move group.
+    bool synced = false;
+    {
+        std::unique_lock<std::mutex> lock(sync_mutex_);
+        if (synced_)
+        {
+            action.base = synced_->getMessage();
+            synced = true;
+        }
+    }
+
+    if (not synced)
+        pullSceneMessage(action.base);
+    action.scene_diff = msg.goal.planning_options.planning_scene_diff;
+
     action.scene.reset(new Scene(robot_));
-    pullScene(action.scene);
-    action.scene->useMessage(msg.goal.planning_options.planning_scene_diff);
+    action.scene->useMessage(action.base);
+    action.scene->useMessage(action.scene_diff);
     action.request = msg.goal.request;
 
     requests_.emplace(id, action);
@@ -234,3 +543,162 @@ void MoveGroupHelper::moveGroupResultCallback(const moveit_msgs::MoveGroupAction
 
     requests_.erase(request);
 }
+
+///
+/// ActionRecorder
+///
+
+ActionRecorder::ActionRecorder(const std::string &path, Format format) : path_(path), format_(format)
+{
+    if (format_ == BAG)
+    {
+        const boost::filesystem::path file(IO::resolvePackage(path_));
+        if (file.has_parent_path())
+            boost::filesystem::create_directories(file.parent_path());
+
+        bag_.reset(new IO::Bag(file.string()));
+    }
+
+    thread_ = std::thread(&ActionRecorder::run, this);
+}
+
+ActionRecorder::~ActionRecorder()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+
+    queued_.notify_all();
+    thread_.join();
+}
+
+void ActionRecorder::record(const MoveGroupHelper::Action &action)
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        queue_.emplace_back(ros::Time::now(), action);
+    }
+
+    queued_.notify_one();
+}
+
+MoveGroupHelper::ResultCallback ActionRecorder::getCallback()
+{
+    return [this](MoveGroupHelper::Action &action) { record(action); };
+}
+
+void ActionRecorder::flush()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    written_.wait(lock, [&] { return queue_.empty() and not writing_; });
+}
+
+std::size_t ActionRecorder::getRecorded() const
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    return recorded_;
+}
+
+void ActionRecorder::run()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true)
+    {
+        queued_.wait(lock, [&] { return stop_ or not queue_.empty(); });
+
+        // Queued actions are still written when stopping.
+        if (queue_.empty())
+            break;
+
+        auto entry = std::move(queue_.front());
+        queue_.pop_front();
+        writing_ = true;
+
+        lock.unlock();
+        write(entry.first, entry.second);
+        lock.lock();
+
+        writing_ = false;
+        ++recorded_;
+        written_.notify_all();
+    }
+}
+
+void ActionRecorder::write(const ros::Time &time, const MoveGroupHelper::Action &action)
+{
+    writeScene(action);
+
+    if (format_ == YAML)
+    {
+        const auto filename =
+            (boost::filesystem::path(path_) / (to_iso_string(time.toBoost()) + ".yml")).string();
+
+        if (scene_file_.empty())
+            RBX_WARN("No base scene saved for Request ID `%s`", action.id);
+
+        if (action.toYAMLFile(filename, scene_file_))
+            RBX_DEBUG("Wrote YAML for Request ID `%s` to file `%s`", action.id, filename);
+        else
+            RBX_ERROR("Failed to write YAML for Request ID `%s` to file `%s`", action.id, filename);
+    }
+    else
+    {
+        // Stored as the action messages move group uses, so bags can be replayed directly.
+        moveit_msgs::MoveGroupActionGoal goal;
+        goal.header.stamp = time;
+        goal.goal_id.id = action.id;
+        goal.goal.request = action.request;
+        goal.goal.planning_options.planning_scene_diff = action.scene_diff;
+
+        moveit_msgs::MoveGroupActionResult result;
+        result.header.stamp = time;
+        result.status.goal_id.id = action.id;
+        result.result.error_code.val = (action.success) ? moveit_msgs::MoveItErrorCodes::SUCCESS :
+                                                          moveit_msgs::MoveItErrorCodes::FAILURE;
+        result.result.planning_time = action.time;
+        result.result.trajectory_start = action.base.robot_state;
+        result.result.planned_trajectory = action.trajectory;
+
+        bag_->addMessage("goal", goal);
+        bag_->addMessage("result", result);
+        RBX_DEBUG("Wrote Request ID `%s` to bag `%s`", action.id, path_);
+    }
+}
+
+bool ActionRecorder::writeScene(const MoveGroupHelper::Action &action)
+{
+    // The robot state is saved with each action, so it is ignored when comparing base scenes.
+    moveit_msgs::PlanningScene scene = action.base;
+    scene.robot_state = moveit_msgs::RobotState();
+
+    std::vector<uint8_t> bytes(ros::serialization::serializationLength(scene));
+    ros::serialization::OStream stream(bytes.data(), bytes.size());
+    ros::serialization::serialize(stream, scene);
+
+    if (bytes == last_scene_)
+        return false;
+
+    if (format_ == YAML)
+    {
+        const auto filename = (boost::filesystem::path(path_) /
+                               (to_iso_string(ros::Time::now().toBoost()) + "_scene.yml"))
+                                  .string();
+
+        // Octomaps are written to sidecar files, which are much faster to read and write.
+        if (not IO::toYAMLFile(action.base, filename, true))
+        {
+            RBX_ERROR("Failed to write base scene to file `%s`", filename);
+            return false;
+        }
+
+        scene_file_ = filename;
+    }
+    else
+        bag_->addMessage("scene", action.base);
+
+    last_scene_ = std::move(bytes);
+    ++scenes_;
+
+    return true;
+}
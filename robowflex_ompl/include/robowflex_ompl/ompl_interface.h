@@ -8,7 +8,11 @@
 #include <robowflex_library/class_forward.h>
 #include <robowflex_library/planning.h>
 
+#include <atomic>
 #include <functional>
+#include <list>
+#include <map>
+#include <mutex>
 
 namespace robowflex
 {
@@ -34,6 +38,28 @@ namespace robowflex
         class OMPLInterfacePlanner : public Planner
         {
         public:
+            /** \brief How the OMPL problem of a planning context is set up.
+             */
+            enum SetupMode
+            {
+                MOVEIT,  ///< Use \a MoveIt!'s state validity checker, which checks the full planning scene.
+                NATIVE   ///< Check states directly from their joint vectors with a group-restricted collision
+                         ///< check. Requests with path constraints still use \a MoveIt!'s checker.
+            };
+
+            /** \brief Options for approximating the constraint manifolds of path constraints.
+             */
+            struct ConstraintApproximationOptions
+            {
+                std::string parameterization{"JointModel"};  ///< State space parameterization of contexts.
+                unsigned int samples{10000};                  ///< Number of constrained states to sample.
+                unsigned int edges_per_sample{0};             ///< Roadmap edges per state, 0 for none.
+                double max_edge_length{0.2};                  ///< Longest roadmap edge.
+                bool explicit_motions{false};                 ///< Store the states along roadmap edges.
+                double explicit_points_resolution{0.05};      ///< Resolution of the stored edge states.
+                unsigned int max_explicit_points{200};        ///< Most stored states per edge.
+            };
+
             /** \brief Constructor.
              *  \param[in] robot The robot to plan for.
              *  \param[in] name Optional namespace for planner.
@@ -60,6 +86,29 @@ namespace robowflex
             planning_interface::MotionPlanResponse
             plan(const SceneConstPtr &scene, const planning_interface::MotionPlanRequest &request) override;
 
+            /** \brief Plan a motion given a \a request and a \a scene, reporting the intermediate solutions
+             *  of the OMPL planner as they are found. Only optimizing planners report intermediate
+             *  solutions. The final, simplified solution is reported last if it is cheaper. Costs are those
+             *  of the optimization objective of the problem, or path length if there is none.
+             *  \param[in] scene A planning scene for the same \a robot_ to compute the plan in.
+             *  \param[in] request The motion planning request to solve.
+             *  \param[in] callback Function to call with each improving solution.
+             *  \return The final motion planning response generated by the planner.
+             */
+            planning_interface::MotionPlanResponse
+            planAnytime(const SceneConstPtr &scene, const planning_interface::MotionPlanRequest &request,
+                        const SolutionCallback &callback) override;
+
+            /** \brief Terminates the solve of the current planning context, if any.
+             *  \return True if the context accepted the termination request.
+             */
+            bool terminate() override;
+
+            /** \brief Clear all cached planning contexts and constraint approximations, see
+             *  clearContextCache() and clearConstraintApproximations().
+             */
+            void clearCaches() override;
+
             /** \brief Returns the planning context used for this motion planning request.
              *  \param[in] scene A planning scene for the same \a robot_ to compute the plan in.
              *  \param[in] request The motion planning request to solve.
@@ -73,7 +122,9 @@ namespace robowflex
              */
             ompl::geometric::SimpleSetupPtr getLastSimpleSetup() const;
 
-            /** \brief Refreshes the internal planning context.
+            /** \brief Refreshes the internal planning context. Contexts are cached by scene, request, and
+             *  planner configuration, so alternating between scenes or requests reuses their contexts, up to
+             *  the capacity set by setContextCacheCapacity().
              *  \param[in] scene A planning scene for the same \a robot_ to compute the plan in.
              *  \param[in] request The motion planning request to solve.
              *  \param[in] force If true, forces a refresh of the context.
@@ -82,6 +133,97 @@ namespace robowflex
                                 const planning_interface::MotionPlanRequest &request,  //
                                 bool force = false) const;
 
+            /** \brief Sets the number of planning contexts to cache. Least recently used contexts are
+             *  evicted first. If 0, contexts are never reused.
+             *  \param[in] capacity Number of contexts to cache.
+             */
+            void setContextCacheCapacity(std::size_t capacity);
+
+            /** \brief Removes all cached planning contexts, and resets the hit and miss counts.
+             */
+            void clearContextCache();
+
+            /** \brief Get the number of times a cached context was reused by refreshContext().
+             *  \return The number of cache hits.
+             */
+            std::size_t getContextCacheHits() const;
+
+            /** \brief Get the number of times refreshContext() created a new context.
+             *  \return The number of cache misses.
+             */
+            std::size_t getContextCacheMisses() const;
+
+            /** \brief Sets how the OMPL problem of new planning contexts is set up. Clears the context cache.
+             *  \param[in] mode The setup mode to use.
+             */
+            void setSetupMode(SetupMode mode);
+
+            /** \brief Sets whether to keep the planner instance and its data (e.g., a PRM roadmap) across
+             *  planning calls. The planner is kept as long as the scene key and the request's group and
+             *  planner configuration are unchanged, and so is reused across different start and goal.
+             *  Reuse relies on \a MoveIt!'s `multi_query_planning_enabled` planner option, which is set
+             *  on all configurations; on versions without it, planner data is cleared before each solve.
+             *  Must be called after initialize().
+             *  \param[in] reuse Whether to reuse planner data.
+             */
+            void setPlannerDataReuse(bool reuse);
+
+            /** \brief Saves the data of the planner currently kept for reuse to disk.
+             *  \param[in] filename File to save planner data to.
+             *  \return True on success, false if no planner is kept or it could not be saved.
+             */
+            bool savePlannerData(const std::string &filename) const;
+
+            /** \brief Loads planner data from disk, to be used by the next planner created for a group and
+             *  planner configuration when planner data reuse is enabled. Supported for PRM, PRM*, LazyPRM,
+             *  and LazyPRM*.
+             *  \param[in] filename File to load planner data from, as written by savePlannerData().
+             *  \param[in] group Planning group of the requests to use the data for.
+             *  \param[in] planner_config Planner configuration of the requests to use the data for.
+             */
+            void loadPlannerData(const std::string &filename, const std::string &group,
+                                 const std::string &planner_config);
+
+            /** \brief Sets whether to approximate the constraint manifolds of requests with path
+             *  constraints, and reuse the approximations across planning calls. An approximation is a
+             *  database of states sampled on the manifold (and optionally a roadmap connecting them) built
+             *  with \a MoveIt!'s constraints library, which planners then sample from instead of sampling
+             *  and projecting from scratch. Approximations are keyed by a fingerprint of the path constraints
+             *  and the scene's content hash, so repeated constrained motions in the same scene, e.g.,
+             *  carrying a tray, only pay for the approximation once. Must be called after initialize().
+             *  \param[in] approximate Whether to approximate constraint manifolds.
+             *  \param[in] options Options for building approximations.
+             */
+            void setConstraintApproximation(bool approximate, const ConstraintApproximationOptions &options);
+
+            /** \brief Sets whether to approximate the constraint manifolds of requests with path
+             *  constraints, with the default options. See setConstraintApproximation().
+             *  \param[in] approximate Whether to approximate constraint manifolds.
+             */
+            void setConstraintApproximation(bool approximate);
+
+            /** \brief Saves all constraint approximations to a directory.
+             *  \param[in] path Directory to save approximations to.
+             */
+            void saveConstraintApproximations(const std::string &path) const;
+
+            /** \brief Loads constraint approximations from a directory, as written by
+             *  saveConstraintApproximations(). Used by requests with the same path constraints in a scene
+             *  with the same content.
+             *  \param[in] path Directory to load approximations from.
+             */
+            void loadConstraintApproximations(const std::string &path);
+
+            /** \brief Removes all constraint approximations.
+             */
+            void clearConstraintApproximations();
+
+            /** \brief Get the progress properties of the planner, plus the context cache hits, misses,
+             *  and hit rate.
+             *  \param[in] scene A planning scene for the same \a robot_ to compute the plan in.
+             *  \param[in] request The motion planning request to solve.
+             *  \return The progress properties.
+             */
             std::map<std::string, Planner::ProgressProperty>
             getProgressProperties(const SceneConstPtr &scene,
                                   const planning_interface::MotionPlanRequest &request) const override;
@@ -118,13 +260,63 @@ namespace robowflex
         private:
             std::unique_ptr<ompl_interface::OMPLInterface> interface_{nullptr};  ///< Planning interface.
             std::vector<std::string> configs_;                                   ///< Planning configurations.
-            bool hybridize_;    ///< Whether or not planner should hybridize solutions.
-            bool interpolate_;  ///< Whether or not planner should interpolate solutions.
+            bool hybridize_;          ///< Whether or not planner should hybridize solutions.
+            bool interpolate_;        ///< Whether or not planner should interpolate solutions.
+            SetupMode mode_{MOVEIT};  ///< How the OMPL problem is set up.
+
+            /** \brief A cached planning context.
+             */
+            struct CachedContext
+            {
+                ID::Key scene;                                         ///< Key of the scene last used.
+                std::string request;                                   ///< Fingerprint of the request.
+                std::string config;                                    ///< Group and planner of the request.
+                ompl_interface::ModelBasedPlanningContextPtr context;  ///< The context.
+            };
+
+            std::size_t capacity_{4};                     ///< Number of contexts to cache.
+            mutable std::list<CachedContext> contexts_;   ///< Cached contexts, most recently used first.
+            mutable std::atomic<std::size_t> hits_{0};    ///< Number of cache hits.
+            mutable std::atomic<std::size_t> misses_{0};  ///< Number of cache misses.
+
+            /** \brief Names the path constraints of a request by their approximation key, building the
+             *  approximation first if there is none.
+             *  \param[in] scene The planning scene being planned on.
+             *  \param[in] request The request to plan a path for.
+             *  \param[out] approximated Copy of \a request with the path constraints named.
+             *  \return True if \a approximated should be planned for, false if \a request has no path
+             *  constraints or no approximation could be built.
+             */
+            bool approximateConstraints(const SceneConstPtr &scene,
+                                        const planning_interface::MotionPlanRequest &request,
+                                        planning_interface::MotionPlanRequest &approximated);
+
+            bool approximate_{false};                       ///< Whether to approximate constraints.
+            ConstraintApproximationOptions approximation_;  ///< Options for building approximations.
+
+            /** \brief Keeps the planner used for planning, and the data inside it, across planning calls.
+             *  \param[in] scene The planning scene being planned on.
+             *  \param[in] request The request to plan a path for.
+             */
+            void reusePlanner(const SceneConstPtr &scene,
+                              const planning_interface::MotionPlanRequest &request);
+
+            /** \brief A planner kept for reuse.
+             */
+            struct KeptPlanner
+            {
+                ID::Key scene;                                         ///< Key of the scene planned in.
+                std::string config;  ///< Group, planner, setup mode, and path constraints of the request.
+                ompl_interface::ModelBasedPlanningContextPtr context;  ///< Context the planner was made in.
+                ompl::base::PlannerPtr planner;                        ///< The planner.
+            };
 
-            mutable ID::Key last_scene_id_{ID::getNullKey()};  ///< ID of last scene.
-            mutable std::string last_request_hash_;            ///< Hash of last request.
+            bool reuse_{false};                         ///< Whether to reuse planner data.
+            KeptPlanner kept_;                          ///< Planner kept for reuse.
+            std::map<std::string, std::string> files_;  ///< Planner data to load, by group and planner.
 
             mutable ompl_interface::ModelBasedPlanningContextPtr context_;  ///< Last context.
+            mutable std::mutex context_mutex_;  ///< Guards writes of context_ against terminate().
             mutable ompl::geometric::SimpleSetupPtr ss_;  ///< Last OMPL simple setup used for
                                                           ///< planning.
 
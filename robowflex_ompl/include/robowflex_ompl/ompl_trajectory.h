@@ -3,6 +3,8 @@
 #ifndef ROBOWFLEX_OMPL_TRAJECTORY
 #define ROBOWFLEX_OMPL_TRAJECTORY
 
+#include <vector>
+
 #include <robowflex_library/class_forward.h>
 
 // Moveit
@@ -33,6 +35,10 @@ namespace robowflex
             \brief A const shared pointer wrapper for robowflex::OMPL::OMPLTrajectory. */
 
         /** \brief OMPLTrajectory provides OMPL path utilities to the Trajectory class.
+         *
+         *  Conversions copy joint vectors directly between waypoints and OMPL states, and reuse the states
+         * already held by their output, so converting repeatedly into the same path or trajectory does not
+         * allocate per waypoint.
          */
         class OMPLTrajectory : public Trajectory
         {
@@ -54,12 +60,23 @@ namespace robowflex
              */
             ompl::geometric::PathGeometric toOMPLPath(const ompl::geometric::SimpleSetupPtr &ss);
 
-            /** \brief Sets the trajectory from an OMPL Path and a reference state.
+            /** \brief Converts to an OMPL Path in place, reusing the states already allocated in \a path.
+             * States are only allocated if \a path has fewer states than the trajectory has waypoints.
+             *  \param[in,out] path Path to write to. Its space information must be for a
+             * ompl_interface::ModelBasedStateSpace of the trajectory's group.
+             */
+            void toOMPLPath(ompl::geometric::PathGeometric &path) const;
+
+            /** \brief Sets the trajectory from an OMPL Path and a reference state. Waypoint states from
+             * previous conversions are reused if no one else holds them.
              *  \param[in] reference_state A full state that contains the values for all the joints.
              *  \param[in] path The geometric OMPL path to convert.
              */
             void fromOMPLPath(const robot_state::RobotState &reference_state,
                               const ompl::geometric::PathGeometric &path);
+
+        private:
+            std::vector<robot_state::RobotStatePtr> buffer_;  ///< Waypoint states to reuse.
         };
     }  // namespace OMPL
 }  // namespace robowflex
@@ -69,6 +69,11 @@ int main(int argc, char **argv)
     auto planner = std::make_shared<OMPL::OMPLInterfacePlanner>(fetch, "default");
     planner->initialize("package://robowflex_resources/fetch/config/ompl_planning.yaml");
 
+    // Create the same planner, checking states natively instead of through MoveIt.
+    auto native = std::make_shared<OMPL::OMPLInterfacePlanner>(fetch, "native");
+    native->initialize("package://robowflex_resources/fetch/config/ompl_planning.yaml");
+    native->setSetupMode(OMPL::OMPLInterfacePlanner::NATIVE);
+
     // Create a motion planning request with a pose goal.
     auto request = std::make_shared<MotionRequestBuilder>(planner, GROUP);
     fetch->setGroupState(GROUP, {0.05, 1.32, 1.40, -0.2, 1.72, 0.0, 1.66, 0.0});  // Stow
@@ -91,6 +96,7 @@ int main(int argc, char **argv)
     profiler.addMetricCallback("num_vertices", getNumVerticesCallback());
 
     experiment.addQuery("rrtstar", scene, planner, request);
+    experiment.addQuery("rrtstar_native", scene, native, request);
 
     // Note: Only 1 thread can be used when profiling the OMPL planners, as planning contexts under the hood
     // are reused between queries.
@@ -1,5 +1,22 @@
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <mutex>
+
+#include <boost/filesystem.hpp>
+
+#include <moveit/kinematic_constraints/utils.h>
+#include <moveit/ompl_interface/detail/constraints_library.h>
 #include <moveit/ompl_interface/model_based_planning_context.h>
+#include <moveit/ompl_interface/parameterization/model_based_state_space.h>
+
+#include <ompl/base/PlannerDataStorage.h>
+#include <ompl/geometric/planners/prm/LazyPRM.h>
+#include <ompl/geometric/planners/prm/LazyPRMstar.h>
+#include <ompl/geometric/planners/prm/PRM.h>
+#include <ompl/geometric/planners/prm/PRMstar.h>
 
+#include <robowflex_library/builder.h>
 #include <robowflex_library/macros.h>
 #include <robowflex_library/log.h>
 #include <robowflex_library/io.h>
@@ -21,7 +38,13 @@ bool OMPL::OMPLInterfacePlanner::initialize(const std::string &config_file, cons
     if (!loadOMPLConfig(handler_, config_file, configs_))
         return false;
 
-    interface_.reset(new ompl_interface::OMPLInterface(robot_->getModel(), handler_.getHandle()));
+    // Without the ROS master, planner configurations are read from the in-process parameters.
+    if (handler_.pushesToMaster())
+        interface_.reset(new ompl_interface::OMPLInterface(robot_->getModel(), handler_.getHandle()));
+    else
+        interface_.reset(new ompl_interface::OMPLInterface(
+            robot_->getModel(), OMPL::getPlannerConfigurations(handler_, robot_->getModelConst()),
+            handler_.getHandle()));
 
     settings.setParam(handler_);
 
@@ -53,26 +76,122 @@ ompl_interface::ModelBasedPlanningContextPtr OMPL::OMPLInterfacePlanner::getPlan
 void OMPL::OMPLInterfacePlanner::preRun(const SceneConstPtr &scene,
                                         const planning_interface::MotionPlanRequest &request)
 {
-    refreshContext(scene, request, true);
+    // Constraint approximations are built here when possible, so their cost is not counted as planning time.
+    planning_interface::MotionPlanRequest approximated;
+    const bool use = approximate_ and approximateConstraints(scene, request, approximated);
+
+    refreshContext(scene, (use) ? approximated : request, true);
 }
 
 planning_interface::MotionPlanResponse OMPL::OMPLInterfacePlanner::plan(
     const SceneConstPtr &scene, const planning_interface::MotionPlanRequest &request)
+{
+    return planAnytime(scene, request, SolutionCallback());
+}
+
+planning_interface::MotionPlanResponse OMPL::OMPLInterfacePlanner::planAnytime(
+    const SceneConstPtr &scene, const planning_interface::MotionPlanRequest &request,
+    const SolutionCallback &callback)
 {
     planning_interface::MotionPlanResponse response;
     response.error_code_.val = moveit_msgs::MoveItErrorCodes::SUCCESS;
 
-    refreshContext(scene, request);
+    // Contexts find the approximation of the path constraints in the constraints library by their name.
+    planning_interface::MotionPlanRequest approximated;
+    const bool use = approximate_ and approximateConstraints(scene, request, approximated);
+    const auto &planned = (use) ? approximated : request;
+
+    refreshContext(scene, planned);
     if (not ss_)
         return response;
 
+    if (reuse_)
+        reusePlanner(scene, planned);
+
     if (pre_plan_callback_)
-        pre_plan_callback_(context_, scene, request);
+        pre_plan_callback_(context_, scene, planned);
+
+    if (not callback)
+    {
+        context_->solve(response);
+        return response;
+    }
+
+    const auto &pdef = ss_->getProblemDefinition();
+    const auto &space = context_->getOMPLStateSpace();
+    const auto &start_state = context_->getCompleteInitialRobotState();
+    const auto start = std::chrono::steady_clock::now();
+
+    // Planner threads may report solutions at once, so only pass on those cheaper than the last.
+    std::mutex mutex;
+    double best = std::numeric_limits<double>::infinity();
+
+    const auto report = [&](const robot_trajectory::RobotTrajectoryPtr &trajectory, double cost) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (cost >= best)
+            return;
+
+        best = cost;
+
+        planning_interface::MotionPlanResponse solution;
+        solution.trajectory_ = trajectory;
+        solution.planning_time_ =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        solution.error_code_.val = moveit_msgs::MoveItErrorCodes::SUCCESS;
+        callback(solution, cost);
+    };
+
+    pdef->setIntermediateSolutionCallback([&](const ompl::base::Planner * /*planner*/,
+                                              const std::vector<const ompl::base::State *> &states,
+                                              const ompl::base::Cost cost) {
+        auto trajectory = std::make_shared<robot_trajectory::RobotTrajectory>(robot_->getModelConst(),
+                                                                              planned.group_name);
+
+        robot_state::RobotState state(start_state);
+        for (const auto *ompl_state : states)
+        {
+            space->copyToRobotState(state, ompl_state);
+            state.update();
+            trajectory->addSuffixWayPoint(state, 0.);
+        }
+
+        report(trajectory, cost.value());
+    });
 
     context_->solve(response);
+    pdef->setIntermediateSolutionCallback(ompl::base::ReportIntermediateSolutionFn());
+
+    if (response.error_code_.val == moveit_msgs::MoveItErrorCodes::SUCCESS and response.trajectory_)
+    {
+        const auto &path = ss_->getSolutionPath();
+        const auto &objective = pdef->getOptimizationObjective();
+        report(response.trajectory_, (objective) ? path.cost(objective).value() : path.length());
+    }
+
     return response;
 }
 
+bool OMPL::OMPLInterfacePlanner::terminate()
+{
+    // Called from other threads while planning refreshes the context, so only a snapshot is used.
+    ompl_interface::ModelBasedPlanningContextPtr context;
+    {
+        std::unique_lock<std::mutex> lock(context_mutex_);
+        context = context_;
+    }
+
+    if (not context)
+        return false;
+
+    return context->terminate();
+}
+
+void OMPL::OMPLInterfacePlanner::clearCaches()
+{
+    clearContextCache();
+    clearConstraintApproximations();
+}
+
 std::map<std::string, Planner::ProgressProperty> OMPL::OMPLInterfacePlanner::getProgressProperties(
     const SceneConstPtr &scene, const planning_interface::MotionPlanRequest &request) const
 {
@@ -82,39 +201,156 @@ std::map<std::string, Planner::ProgressProperty> OMPL::OMPLInterfacePlanner::get
 
     const auto &planner = ss_->getPlanner();
 
+    std::map<std::string, Planner::ProgressProperty> ret;
 #if ROBOWFLEX_AT_LEAST_KINETIC
-    return planner->getPlannerProgressProperties();
+    ret = planner->getPlannerProgressProperties();
 
     // As in Indigo they are boost::function
 #else
-    std::map<std::string, Planner::ProgressProperty> ret;
     for (const auto &pair : planner->getPlannerProgressProperties())
     {
         auto function = pair.second;
         ret[pair.first] = [function] { return function(); };
     }
+#endif
+
+    ret["context cache hits INTEGER"] = [this] { return std::to_string(hits_.load()); };
+    ret["context cache misses INTEGER"] = [this] { return std::to_string(misses_.load()); };
+    ret["context cache hit rate REAL"] = [this] {
+        const double hits = hits_.load();
+        const double total = hits + misses_.load();
+        return std::to_string((total > 0) ? hits / total : 0.);
+    };
 
     return ret;
-#endif
 }
 
+namespace
+{
+    /** \brief Returns true if a context created for the scene with \a key can be used with \a scene.
+     *  The context refers to the scene's planning scene directly, so moving, adding, or removing
+     *  collision objects does not require a new context. */
+    bool isCompatibleScene(const Scene &scene, const ID::Key &key)
+    {
+        const auto &scene_id = scene.getKey();
+        if (compareIDs(scene_id, key))
+            return true;
+
+        if (scene_id.first != key.first)
+            return false;
+
+        std::vector<Scene::Change> changes;
+        if (not scene.getChanges(key.second, changes))
+            return false;
+
+        return std::all_of(changes.begin(), changes.end(), [](const Scene::Change &change) {
+            return change.type == Scene::Change::ADDED or change.type == Scene::Change::REMOVED or
+                   change.type == Scene::Change::MOVED;
+        });
+    }
+}  // namespace
+
+namespace
+{
+    /** \brief A state validity checker that checks states of a model-based state space directly from
+     *  their contiguous joint vectors, with a collision check restricted to the links moved by a group.
+     *  Joints outside the group are taken from the start state of the request, as in MoveIt!. Each
+     *  planning thread keeps its own scratch robot state, so checks do not allocate. */
+    class NativeValidityChecker : public ompl::base::StateValidityChecker
+    {
+    public:
+        NativeValidityChecker(const ompl::base::SpaceInformationPtr &si, const SceneConstPtr &scene,
+                              const moveit::core::JointModelGroup *jmg, const robot_state::RobotState &start)
+          : ompl::base::StateValidityChecker(si)
+          , scene_(scene)
+          , checker_(*scene, false, true)
+          , jmg_(jmg)
+          , start_(start)
+          , id_(++NEXT_ID)
+        {
+        }
+
+        bool isValid(const ompl::base::State *state) const override
+        {
+            if (not si_->satisfiesBounds(state))
+                return false;
+
+            // Scratch state of this thread, recreated when last used by another checker.
+            thread_local std::size_t owner = 0;
+            thread_local robot_state::RobotStatePtr scratch;
+            if (owner != id_)
+            {
+                scratch = std::make_shared<robot_state::RobotState>(start_);
+                owner = id_;
+            }
+
+            const auto *values = state->as<ompl_interface::ModelBasedStateSpace::StateType>()->values;
+            return checker_(scratch.get(), jmg_, values);
+        }
+
+    private:
+        static std::atomic<std::size_t> NEXT_ID;  ///< Identifier of the next checker.
+
+        SceneConstPtr scene_;                       ///< Scene to check against.
+        robowflex::StateValidityChecker checker_;   ///< Group-restricted collision checker.
+        const moveit::core::JointModelGroup *jmg_;  ///< Group planned for.
+        const robot_state::RobotState start_;       ///< State of the joints outside the group.
+        const std::size_t id_;                      ///< Identifier of this checker.
+    };
+
+    std::atomic<std::size_t> NativeValidityChecker::NEXT_ID{0};
+}  // namespace
+
 void OMPL::OMPLInterfacePlanner::refreshContext(const SceneConstPtr &scene,
                                                 const planning_interface::MotionPlanRequest &request,
                                                 bool force) const
 {
+    RBX_TRACE("OMPLInterfacePlanner::refreshContext");
+
     const auto &scene_id = scene->getKey();
-    const auto &request_hash = IO::getMessageMD5(request);
 
-    bool same_scene = compareIDs(scene_id, last_scene_id_);
-    bool same_request = request_hash == last_request_hash_;
+    // Requests owned by a builder are identified by its ID and version, which avoids serializing them.
+    ID::Key key;
+    const std::string request_hash = (MotionRequestBuilder::getFingerprint(request, key)) ?
+                                         std::to_string(key.first) + ":" + std::to_string(key.second) :
+                                         IO::getMessageHash(request);
+    const std::string config = request.group_name + "/" + request.planner_id;
 
-    if (not force and ss_ and same_scene and same_request)
+    for (auto it = contexts_.begin(); it != contexts_.end(); ++it)
     {
-        RBX_INFO("Reusing Cached Context!");
+        if (it->request != request_hash or it->config != config or not isCompatibleScene(*scene, it->scene))
+            continue;
+
+        // A forced refresh replaces the cached context.
+        if (force)
+        {
+            contexts_.erase(it);
+            break;
+        }
+
+        it->scene = scene_id;
+        contexts_.splice(contexts_.begin(), contexts_, it);
+
+        {
+            std::unique_lock<std::mutex> lock(context_mutex_);
+            context_ = it->context;
+        }
+
+        ss_ = context_->getOMPLSimpleSetup();
+        ++hits_;
+
+        RBX_INFO_THROTTLE(10., "Reusing Cached Context!");
         return;
     }
 
-    context_ = getPlanningContext(scene, request);
+    ++misses_;
+
+    {
+        auto context = getPlanningContext(scene, request);
+        std::unique_lock<std::mutex> lock(context_mutex_);
+        context_ = std::move(context);
+    }
+
     if (not context_)
     {
         RBX_ERROR("Context was not set!");
@@ -129,12 +365,296 @@ void OMPL::OMPLInterfacePlanner::refreshContext(const SceneConstPtr &scene,
 
     ss_ = context_->getOMPLSimpleSetup();
 
-    last_scene_id_ = scene_id;
-    last_request_hash_ = request_hash;
+    if (mode_ == NATIVE and kinematic_constraints::isEmpty(request.path_constraints))
+    {
+        const auto &si = ss_->getSpaceInformation();
+        const auto &jmg = context_->getJointModelGroup();
+        const auto &start = context_->getCompleteInitialRobotState();
+        ss_->setStateValidityChecker(std::make_shared<NativeValidityChecker>(si, scene, jmg, start));
+    }
+
+    if (capacity_ > 0)
+    {
+        contexts_.push_front({scene_id, request_hash, config, context_});
+        if (contexts_.size() > capacity_)
+            contexts_.pop_back();
+    }
 
     RBX_INFO("Refreshed Context!");
 }
 
+void OMPL::OMPLInterfacePlanner::setSetupMode(SetupMode mode)
+{
+    mode_ = mode;
+
+    // Cached contexts were set up with the old mode.
+    clearContextCache();
+}
+
+void OMPL::OMPLInterfacePlanner::setContextCacheCapacity(std::size_t capacity)
+{
+    capacity_ = capacity;
+    while (contexts_.size() > capacity_)
+        contexts_.pop_back();
+}
+
+void OMPL::OMPLInterfacePlanner::clearContextCache()
+{
+    contexts_.clear();
+    hits_ = 0;
+    misses_ = 0;
+}
+
+std::size_t OMPL::OMPLInterfacePlanner::getContextCacheHits() const
+{
+    return hits_;
+}
+
+std::size_t OMPL::OMPLInterfacePlanner::getContextCacheMisses() const
+{
+    return misses_;
+}
+
+namespace
+{
+    /** \brief Creates a planner of the same type and parameters as \a planner from planner data.
+     *  Returns nullptr if the type of \a planner cannot be created from planner data. */
+    ompl::base::PlannerPtr makePlannerFromData(const ompl::base::PlannerPtr &planner,
+                                               const ompl::base::PlannerData &data)
+    {
+        ompl::base::PlannerPtr made;
+        if (std::dynamic_pointer_cast<ompl::geometric::PRMstar>(planner))
+            made = std::make_shared<ompl::geometric::PRM>(data, true);
+        else if (std::dynamic_pointer_cast<ompl::geometric::PRM>(planner))
+            made = std::make_shared<ompl::geometric::PRM>(data, false);
+        else if (std::dynamic_pointer_cast<ompl::geometric::LazyPRMstar>(planner))
+            made = std::make_shared<ompl::geometric::LazyPRM>(data, true);
+        else if (std::dynamic_pointer_cast<ompl::geometric::LazyPRM>(planner))
+            made = std::make_shared<ompl::geometric::LazyPRM>(data, false);
+        else
+            return nullptr;
+
+        for (const auto &pair : planner->params().getParams())
+            made->params().setParam(pair.first, pair.second->getValue());
+
+        return made;
+    }
+}  // namespace
+
+void OMPL::OMPLInterfacePlanner::setPlannerDataReuse(bool reuse)
+{
+    if (not interface_)
+    {
+        RBX_ERROR("Interface is not initialized before call to OMPLInterfacePlanner::setPlannerDataReuse.");
+        return;
+    }
+
+    auto &pcm = interface_->getPlanningContextManager();
+    auto configs = pcm.getPlannerConfigurations();
+    for (auto &pair : configs)
+    {
+        if (reuse)
+            pair.second.config["multi_query_planning_enabled"] = "true";
+        else
+            pair.second.config.erase("multi_query_planning_enabled");
+    }
+
+    pcm.setPlannerConfigurations(configs);
+
+    // Cached contexts were configured with the old setting.
+    reuse_ = reuse;
+    kept_ = KeptPlanner();
+    clearContextCache();
+}
+
+bool OMPL::OMPLInterfacePlanner::savePlannerData(const std::string &filename) const
+{
+    if (not kept_.planner)
+    {
+        RBX_ERROR("No planner is kept to save planner data of!");
+        return false;
+    }
+
+    ompl::base::PlannerData data(kept_.planner->getSpaceInformation());
+    kept_.planner->getPlannerData(data);
+
+    ompl::base::PlannerDataStorage storage;
+    if (not storage.store(data, filename.c_str()))
+    {
+        RBX_ERROR("Failed to save planner data to `%s`", filename);
+        return false;
+    }
+
+    return true;
+}
+
+void OMPL::OMPLInterfacePlanner::loadPlannerData(const std::string &filename, const std::string &group,
+                                                 const std::string &planner_config)
+{
+    files_[group + "/" + planner_config] = filename;
+}
+
+void OMPL::OMPLInterfacePlanner::reusePlanner(const SceneConstPtr &scene,
+                                              const planning_interface::MotionPlanRequest &request)
+{
+    const auto &scene_id = scene->getKey();
+    const std::string planner_config = request.group_name + "/" + request.planner_id;
+
+    // Planner data is only valid for the problem it was built for, so the kept planner is also keyed by
+    // the setup mode and the path constraints (which are named by their approximation, if approximated).
+    std::string config = planner_config + ((mode_ == NATIVE) ? "/native" : "/moveit");
+    if (not kinematic_constraints::isEmpty(request.path_constraints))
+        config += "/" + IO::getMessageHash(request.path_constraints);
+
+    // A kept planner built on another space cannot be used, e.g., if the context was recreated.
+    if (kept_.planner and kept_.planner->getSpaceInformation() != ss_->getSpaceInformation())
+    {
+        RBX_INFO("Dropping Kept Planner, as its space information has changed!");
+        kept_ = KeptPlanner();
+    }
+
+    if (kept_.planner and kept_.config == config and compareIDs(scene_id, kept_.scene))
+    {
+        // The kept planner still checks validity through its own context, which is kept alive with it.
+        if (ss_->getPlanner() != kept_.planner)
+            ss_->setPlanner(kept_.planner);
+
+        RBX_INFO("Reusing Kept Planner!");
+        return;
+    }
+
+    kept_ = {scene_id, config, context_, ss_->getPlanner()};
+
+    auto it = files_.find(planner_config);
+    if (it == files_.end() or not kept_.planner)
+        return;
+
+    const std::string filename = it->second;
+    files_.erase(it);
+
+    ompl::base::PlannerData data(ss_->getSpaceInformation());
+    ompl::base::PlannerDataStorage storage;
+    if (not storage.load(filename.c_str(), data))
+    {
+        RBX_ERROR("Failed to load planner data from `%s`", filename);
+        return;
+    }
+
+    auto planner = makePlannerFromData(kept_.planner, data);
+    if (not planner)
+    {
+        RBX_ERROR("Planner `%s` cannot be created from planner data!", kept_.planner->getName());
+        return;
+    }
+
+    kept_.planner = planner;
+    ss_->setPlanner(kept_.planner);
+
+    RBX_INFO("Loaded planner data from `%s` with %d vertices", filename, data.numVertices());
+}
+
+void OMPL::OMPLInterfacePlanner::setConstraintApproximation(bool approximate)
+{
+    setConstraintApproximation(approximate, ConstraintApproximationOptions());
+}
+
+void OMPL::OMPLInterfacePlanner::setConstraintApproximation(bool approximate,
+                                                            const ConstraintApproximationOptions &options)
+{
+    if (not interface_)
+    {
+        RBX_ERROR("Interface is not initialized before call to "
+                  "OMPLInterfacePlanner::setConstraintApproximation.");
+        return;
+    }
+
+    approximate_ = approximate;
+    approximation_ = options;
+    interface_->useConstraintsApproximations(approximate);
+
+    // Cached contexts were configured with the old setting.
+    clearContextCache();
+}
+
+void OMPL::OMPLInterfacePlanner::saveConstraintApproximations(const std::string &path) const
+{
+    if (not interface_)
+        return;
+
+    // The directory must exist to be resolved, as it is when loading.
+    const auto &directory = IO::resolvePackage(path);
+    if (not directory.empty())
+        boost::filesystem::create_directories(directory);
+
+    const auto &resolved = IO::resolvePath(path);
+    if (resolved.empty())
+    {
+        RBX_ERROR("Cannot save constraint approximations to `%s`", path);
+        return;
+    }
+
+    interface_->getConstraintsLibrary()->saveConstraintApproximations(resolved);
+}
+
+void OMPL::OMPLInterfacePlanner::loadConstraintApproximations(const std::string &path)
+{
+    if (not interface_)
+        return;
+
+    interface_->getConstraintsLibrary()->loadConstraintApproximations(IO::resolvePath(path));
+}
+
+void OMPL::OMPLInterfacePlanner::clearConstraintApproximations()
+{
+    if (not interface_)
+        return;
+
+    interface_->getConstraintsLibrary()->clearConstraintApproximations();
+}
+
+bool OMPL::OMPLInterfacePlanner::approximateConstraints(const SceneConstPtr &scene,
+                                                        const planning_interface::MotionPlanRequest &request,
+                                                        planning_interface::MotionPlanRequest &approximated)
+{
+    if (kinematic_constraints::isEmpty(request.path_constraints))
+        return false;
+
+    // The key is content-based, so approximations saved by another process are found again.
+    moveit_msgs::Constraints constraints = request.path_constraints;
+    constraints.name.clear();
+
+    const std::string hash = IO::getMessageHash(constraints);
+    constraints.name = request.group_name + "_" + hash + "_" + scene->getMessageHash();
+
+    const auto &library = interface_->getConstraintsLibrary();
+    if (not library->getConstraintApproximation(constraints))
+    {
+        ompl_interface::ConstraintApproximationConstructionOptions options;
+        options.state_space_parameterization = approximation_.parameterization;
+        options.samples = approximation_.samples;
+        options.edges_per_sample = approximation_.edges_per_sample;
+        options.max_edge_length = approximation_.max_edge_length;
+        options.explicit_motions = approximation_.explicit_motions;
+        options.explicit_points_resolution = approximation_.explicit_points_resolution;
+        options.max_explicit_points = approximation_.max_explicit_points;
+
+        const auto &result = library->addConstraintApproximation(constraints, request.group_name,
+                                                                 scene->getSceneConst(), options);
+        if (not result.approx)
+        {
+            RBX_WARN("Failed to approximate path constraints for group `%s`", request.group_name);
+            return false;
+        }
+
+        RBX_INFO("Approximated path constraints with %d milestones in %.3fs", result.milestones,
+                 result.state_sampling_time + result.state_connection_time);
+    }
+
+    approximated = request;
+    approximated.path_constraints.name = constraints.name;
+    return true;
+}
+
 ompl::geometric::SimpleSetupPtr OMPL::OMPLInterfacePlanner::getLastSimpleSetup() const
 {
     return ss_;
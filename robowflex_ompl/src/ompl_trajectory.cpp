@@ -1,5 +1,7 @@
 /* Author: Constantinos Chamzas */
 
+#include <algorithm>
+
 #include <robowflex_library/robot.h>
 #include <robowflex_library/scene.h>
 #include <robowflex_library/trajectory.h>
@@ -22,17 +24,33 @@ OMPL::OMPLTrajectory::OMPLTrajectory(robot_trajectory::RobotTrajectory &trajecto
 ompl::geometric::PathGeometric OMPL::OMPLTrajectory::toOMPLPath(const ompl::geometric::SimpleSetupPtr &ss)
 {
     auto path = ompl::geometric::PathGeometric(ss->getSpaceInformation());
-    auto *tstate = ss->getSpaceInformation()->allocState();
-    auto traj_msg = getMessage();
+    toOMPLPath(path);
 
-    // transform to Path geometric
-    for (const auto &state_vec : traj_msg.joint_trajectory.points)
-        for (unsigned int j = 0; j < state_vec.positions.size(); j++)
-            tstate->as<ompl_interface::ModelBasedStateSpace::StateType>()->values[j] = state_vec.positions[j];
+    return path;
+}
 
-    path.append(tstate);
+void OMPL::OMPLTrajectory::toOMPLPath(ompl::geometric::PathGeometric &path) const
+{
+    const auto &jmg = trajectory_->getGroup();
+    if (not jmg)
+        throw Exception(1, "Trajectory has no group to convert to an OMPL path!");
 
-    return path;
+    const auto &si = path.getSpaceInformation();
+    auto &states = path.getStates();
+
+    const std::size_t n = trajectory_->getWayPointCount();
+    for (std::size_t i = n; i < states.size(); ++i)
+        si->freeState(states[i]);
+
+    const std::size_t reused = std::min(n, states.size());
+    states.resize(n);
+    for (std::size_t i = reused; i < n; ++i)
+        states[i] = si->allocState();
+
+    // The values of a model-based state are the group's variables, in the group's order.
+    for (std::size_t i = 0; i < n; ++i)
+        trajectory_->getWayPoint(i).copyJointGroupPositions(
+            jmg, states[i]->as<ompl_interface::ModelBasedStateSpace::StateType>()->values);
 }
 
 void OMPL::OMPLTrajectory::fromOMPLPath(const robot_state::RobotState &reference_state,
@@ -44,10 +62,20 @@ void OMPL::OMPLTrajectory::fromOMPLPath(const robot_state::RobotState &reference
     if (not mbss)
         throw Exception(1, "Failed to extract StateSpace from provided OMPL path!");
 
-    moveit::core::RobotState ks = reference_state;
+    trajectory_->clear();
     for (std::size_t i = 0; i < path.getStateCount(); ++i)
     {
-        mbss->copyToRobotState(ks, path.getState(i));
-        trajectory_->addSuffixWayPoint(ks, 0.0);
+        // Buffered states still held elsewhere (e.g., by a copy of the old trajectory) are replaced.
+        if (i >= buffer_.size())
+            buffer_.emplace_back(std::make_shared<robot_state::RobotState>(reference_state));
+        else if (buffer_[i].use_count() > 1)
+            buffer_[i] = std::make_shared<robot_state::RobotState>(reference_state);
+        else
+            buffer_[i]->setVariablePositions(reference_state.getVariablePositions());
+
+        mbss->copyToRobotState(*buffer_[i], path.getState(i));
+        trajectory_->addSuffixWayPoint(buffer_[i], 0.0);
     }
+
+    invalidate();
 }
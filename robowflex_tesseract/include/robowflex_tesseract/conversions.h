@@ -3,6 +3,9 @@
 #ifndef ROBOWFLEX_TESSERACT_CONVERSIONS_
 #define ROBOWFLEX_TESSERACT_CONVERSIONS_
 
+#include <map>
+
+#include <robowflex_library/id.h>
 #include <robowflex_library/scene.h>
 #include <robowflex_library/robot.h>
 #include <robowflex_library/class_forward.h>
@@ -17,6 +20,18 @@ namespace robowflex
 
     namespace hypercube
     {
+        /** \brief Cache of the scene objects added to a KDL environment by sceneToTesseractEnv().
+         *  Collision world objects are replaced whenever they change, so the world object pointer
+         *  identifies the version of an object.
+         */
+        struct SceneConversionCache
+        {
+            ID::Key scene{ID::getNullKey()};          ///< Key of the last scene converted.
+            tesseract::tesseract_ros::KDLEnvPtr env;  ///< Environment the objects were added to.
+            std::map<std::string, collision_detection::World::ObjectConstPtr> objects;  ///< Converted
+                                                                                         ///< objects.
+        };
+
         /** \brief Add scene collision objects to a (previously initialized) KDL environment.
          *  \param[in] scene Scene to load.
          *  \param[out] env KDL environment to add scene objects to.
@@ -25,6 +40,18 @@ namespace robowflex
         bool sceneToTesseractEnv(const robowflex::SceneConstPtr &scene,
                                  tesseract::tesseract_ros::KDLEnvPtr env);
 
+        /** \brief Update the scene collision objects in a (previously initialized) KDL environment, only
+         * converting objects that changed since the last call with \a cache. If the scene has not changed,
+         * no objects are converted. Attached bodies not added through \a cache (e.g., by
+         * addAttachedBodiesToTesseractEnv()) are removed.
+         *  \param[in] scene Scene to load.
+         *  \param[out] env KDL environment to add scene objects to.
+         *  \param[in,out] cache Objects already converted into \a env.
+         *  \return True if the KDL environment was correctly loaded from scene.
+         */
+        bool sceneToTesseractEnv(const robowflex::SceneConstPtr &scene,
+                                 tesseract::tesseract_ros::KDLEnvPtr env, SceneConversionCache &cache);
+
         /** \brief Add bodies attached to the robot scratch state to the KDL environment.
          *  \param[in] state Robot state with objects attached.
          *  \param[out] env KDL environment to add the attached objects.
@@ -33,6 +60,25 @@ namespace robowflex
         bool addAttachedBodiesToTesseractEnv(const robot_state::RobotStatePtr &state,
                                              tesseract::tesseract_ros::KDLEnvPtr env);
 
+        /** \brief Indices of the robot variables of the joints of a manipulator and of a KDL environment,
+         *  to convert states and trajectories without looking up joint names.
+         */
+        struct JointIndexMap
+        {
+            std::vector<int> manip;  ///< Robot variable index of each manipulator joint.
+            std::vector<int> env;    ///< Robot variable index of each environment joint, or -1 if none.
+        };
+
+        /** \brief Compute the joint index map of a manipulator. The map is valid for any environment
+         *  loaded from the same URDF and SRDF as \a env.
+         *  \param[in] model Robot model of the states to convert.
+         *  \param[in] manip Name of manipulator.
+         *  \param[in] env KDL environment with the robot (and manipulator) information already loaded.
+         *  \return The joint index map.
+         */
+        JointIndexMap getJointIndexMap(const robot_model::RobotModelConstPtr &model, const std::string &manip,
+                                       const tesseract::tesseract_ros::KDLEnvPtr &env);
+
         /** \brief Transform a \a robot_state to a vector representing joint values for the manipulator (in
          * the order given by \a manip_joint_names).
          *  \param[in] robot_state Robot state to be transformed.
@@ -54,6 +100,17 @@ namespace robowflex
                                     const std::string &manip, const tesseract::tesseract_ros::KDLEnvPtr &env,
                                     robot_state::RobotStatePtr robot_state);
 
+        /** \brief Transform a tesseract \a waypoint (manip state) to robot \a state using a precomputed
+         * joint index map. Joint values for non-manip joints are taken from \a env.
+         *  \param[in] manip_state Tesseract manipulator state to be transformed.
+         *  \param[in] map Joint index map of the manipulator, from getJointIndexMap().
+         *  \param[in] env KDL environment with the robot (and manipulator) information already loaded.
+         *  \param[out] robot_state Robot state representing \a manip_state.
+         */
+        void manipStateToRobotState(const Eigen::Ref<const Eigen::VectorXd> &manip_state,
+                                    const JointIndexMap &map, const tesseract::tesseract_ros::KDLEnvPtr &env,
+                                    robot_state::RobotStatePtr robot_state);
+
         /** \brief Transform a tesseract trajectory to a robot \a trajectory.
          *  \param[in] tesseract_traj Tesseract trajectory to transform.
          *  \param[in] robot Robot \a tesseract_traj belongs to.
@@ -67,6 +124,21 @@ namespace robowflex
                                            const tesseract::tesseract_ros::KDLEnvPtr &env,
                                            robot_trajectory::RobotTrajectoryPtr trajectory);
 
+        /** \brief Transform a tesseract trajectory to a robot \a trajectory using a precomputed joint index
+         * map. The values of all waypoints are scattered into one matrix at once, and joint values for
+         * non-manip joints are taken from \a env.
+         *  \param[in] tesseract_traj Tesseract trajectory to transform.
+         *  \param[in] ref_state Reference state of variables that are in neither the manipulator nor \a env.
+         *  \param[in] map Joint index map of the manipulator, from getJointIndexMap().
+         *  \param[in] env KDL environment with the robot (and manipulator) information already loaded.
+         *  \param[out] trajectory Robot trajectory corresponding to \a tesseract_traj.
+         */
+        void manipTesseractTrajToRobotTraj(const tesseract::TrajArray &tesseract_traj,
+                                           const robot_state::RobotStatePtr &ref_state,
+                                           const JointIndexMap &map,
+                                           const tesseract::tesseract_ros::KDLEnvPtr &env,
+                                           robot_trajectory::RobotTrajectoryPtr trajectory);
+
         /** \brief Transform a \a robot_trajectory to a tesseract manipulator \a trajectory.
          *  \param[in] robot_traj Robot Trajectory to transform.
          *  \param[in] manip Name of manipulator in KDL env.
@@ -78,6 +150,15 @@ namespace robowflex
                                            const tesseract::tesseract_ros::KDLEnvPtr &env,
                                            tesseract::TrajArray &trajectory);
 
+        /** \brief Transform a \a robot_trajectory to a tesseract manipulator \a trajectory using a
+         * precomputed joint index map, gathering the manipulator's columns of all waypoints at once.
+         *  \param[in] robot_traj Robot Trajectory to transform.
+         *  \param[in] map Joint index map of the manipulator, from getJointIndexMap().
+         *  \param[out] trajectory Tesseract trajectory array corresponding to \a robot_trajectory.
+         */
+        void robotTrajToManipTesseractTraj(const robot_trajectory::RobotTrajectoryPtr &robot_traj,
+                                           const JointIndexMap &map, tesseract::TrajArray &trajectory);
+
     }  // namespace hypercube
 }  // namespace robowflex
 
@@ -8,6 +8,7 @@
 #include <robowflex_library/planning.h>
 #include <tesseract_planning/trajopt/trajopt_planner.h>
 #include <tesseract_ros/kdl/kdl_env.h>
+#include <robowflex_tesseract/conversions.h>
 
 namespace robowflex
 {
@@ -20,6 +21,7 @@ namespace robowflex
 
     /** \cond IGNORE */
     ROBOWFLEX_CLASS_FORWARD(TrajOptPlanner);
+    ROBOWFLEX_CLASS_FORWARD(TrajOptPoolPlanner);
     /** \endcond */
 
     /** \class robowflex::TrajOptPlannerPtr
@@ -28,6 +30,12 @@ namespace robowflex
     /** \class robowflex::TrajOptPlannerConstPtr
         \brief A const shared pointer wrapper for robowflex::TrajOptPlanner. */
 
+    /** \class robowflex::TrajOptPoolPlannerPtr
+        \brief A shared pointer wrapper for robowflex::TrajOptPoolPlanner. */
+
+    /** \class robowflex::TrajOptPoolPlannerConstPtr
+        \brief A const shared pointer wrapper for robowflex::TrajOptPoolPlanner. */
+
     /** \brief Robowflex Tesseract TrajOpt Planner.
      */
     class TrajOptPlanner : public Planner
@@ -42,6 +50,11 @@ namespace robowflex
                                             ///< or not.
             double noise_init_traj{0.09};   ///< Max and (negative) min amount of uniform noise added to each
                                             ///< joint value for all waypoints of an initial trajectory.
+            unsigned int seed{0};           ///< Seed of the noise of the first restart, incremented for each
+                                            ///< following restart.
+            unsigned int num_threads{1};    ///< Number of threads to run restarts on in parallel, each with
+                                            ///< its own optimizer and environment. Only used when
+                                            ///< return_first_sol is false.
             bool verbose{true};             ///< Verbosity.
             bool return_first_sol{true};    ///< Whether the planner runs only once or not. This has higher
                                             ///< piority than return_until_timeout. Choosing false will set
@@ -95,6 +108,54 @@ namespace robowflex
          */
         typedef std::pair<bool, bool> PlannerResult;
 
+        /** \cond IGNORE */
+        ROBOWFLEX_CLASS_FORWARD(Library);
+        /** \endcond */
+
+        /** \brief A library of past solutions, indexed by their start and goal manipulator joint values,
+         *  to warm start the optimization of similar requests.
+         */
+        class Library
+        {
+        public:
+            /** \brief Add a solution to the library.
+             *  \param[in] start Start manipulator joint values of the solution.
+             *  \param[in] goal Goal manipulator joint values of the solution.
+             *  \param[in] trajectory The solution, in Tesseract format.
+             */
+            void add(const Eigen::Ref<const Eigen::VectorXd> &start,
+                     const Eigen::Ref<const Eigen::VectorXd> &goal, const trajopt::TrajArray &trajectory);
+
+            /** \brief Get seeds for a request from the \a k solutions whose start and goal are nearest to
+             *  the request's. Each seed is resampled to \a rows waypoints, and its waypoints are shifted so
+             *  that it starts at \a start and ends at \a goal.
+             *  \param[in] start Start manipulator joint values of the request.
+             *  \param[in] goal Goal manipulator joint values of the request.
+             *  \param[in] k Maximum number of seeds.
+             *  \param[in] rows Number of waypoints of each seed.
+             *  \return The seeds, nearest first.
+             */
+            std::vector<trajopt::TrajArray> getSeeds(const Eigen::Ref<const Eigen::VectorXd> &start,
+                                                     const Eigen::Ref<const Eigen::VectorXd> &goal,
+                                                     std::size_t k, int rows) const;
+
+            /** \brief Get the number of solutions in the library.
+             *  \return The number of solutions.
+             */
+            std::size_t size() const;
+
+        private:
+            /** \brief A solution in the library.
+             */
+            struct Entry
+            {
+                Eigen::VectorXd key;            ///< Start and goal joint values, concatenated.
+                trajopt::TrajArray trajectory;  ///< The solution.
+            };
+
+            std::vector<Entry> entries_;  ///< Solutions in the library.
+        };
+
         /** \brief Constructor.
          *  \param[in] robot Robot to plan for.
          *  \param[in] group_name Name of the (joint) group to plan for.
@@ -118,6 +179,15 @@ namespace robowflex
          */
         bool initialize(const std::string &base_link, const std::string &tip_link);
 
+        /** \brief Initialize planner from an initialized \a prototype for the same robot and group. The
+         *  prototype's manipulator, SRDF, and settings (options, collision checking, initialization, and
+         *  fixed joints) are reused, so the SRDF is not rebuilt and only a new environment is loaded. The
+         *  new planner has its own environment and scene cache, so the two can plan concurrently.
+         *  \param[in] prototype Planner to copy.
+         *  \return True if initialization succeded.
+         */
+        bool initialize(const TrajOptPlanner &prototype);
+
         /** \name Set and get TrajOpt parameters
             \{*/
 
@@ -131,6 +201,21 @@ namespace robowflex
          */
         void setInitialTrajectory(const trajopt::TrajArray &init_trajectory);
 
+        /** \brief Set a library of past solutions to seed the optimization with. When planning between
+         *  two joint states, the first restarts are initialized with the seeds of the \a k nearest
+         *  solutions in the library (see Library::getSeeds()) instead of the init type, and later restarts
+         *  fall back to the init type.
+         *  \param[in] library Library to use. If null, no library is used.
+         *  \param[in] k Number of seeds to use.
+         *  \param[in] learn Whether to add collision-free solutions to the library.
+         */
+        void setLibrary(const LibraryPtr &library, std::size_t k = 1, bool learn = true);
+
+        /** \brief Get the library of past solutions used to seed the optimization.
+         *  \return The library, or null if none is used.
+         */
+        const LibraryPtr &getLibrary() const;
+
         /** \brief Set type of initialization to use for the trajectory optimization.
          *  Current options are:
          *  STATIONARY
@@ -167,11 +252,17 @@ namespace robowflex
          */
         const std::vector<std::string> &getManipulatorJoints() const;
 
-        /** \brief Get the time spent by the planner the last time it was called.
+        /** \brief Get the wall-clock time spent by the planner the last time it was called.
          *  \return Planning time.
          */
         double getPlanningTime() const;
 
+        /** \brief Get the CPU time spent optimizing the last time the planner was called, summed over
+         *  all restart threads.
+         *  \return Planning CPU time.
+         */
+        double getPlanningCPUTime() const;
+
         /** \brief Constrain certain joints during optimization to their initial value.
          *  \param[in] joints Vector of joints to freeze.
          */
@@ -190,6 +281,18 @@ namespace robowflex
         planning_interface::MotionPlanResponse
         plan(const SceneConstPtr &scene, const planning_interface::MotionPlanRequest &request) override;
 
+        /** \brief Plan a motion given a \a request and a \a scene, reporting each restart that improves on
+         *  the best collision-free solution so far. Costs are the total costs of the optimization problem.
+         *  Only one solution is found if \a options.return_first_sol is set.
+         *  \param[in] scene A planning scene to compute the plan in.
+         *  \param[in] request The motion planning request to solve.
+         *  \param[in] callback Function to call with each improving solution.
+         *  \return The motion planning response generated by the planner.
+         */
+        planning_interface::MotionPlanResponse
+        planAnytime(const SceneConstPtr &scene, const planning_interface::MotionPlanRequest &request,
+                    const SolutionCallback &callback) override;
+
         /** \brief Plan a motion using a \a scene from \a start_state to a \a goal_state.
          *  \param[in] scene Scene to plan for.
          *  \param[in] start_state Start state for the robot.
@@ -262,6 +365,36 @@ namespace robowflex
         /** \} */
 
     protected:
+        /** \brief Load a new KDL environment from the robot's URDF and \a srdf_.
+         *  \return The environment, or nullptr on failure.
+         */
+        tesseract::tesseract_ros::KDLEnvPtr createEnvironment() const;
+
+        /** \brief Finish initialization once \a env_ is loaded: check the manipulator and reset the state
+         *  built for the previous environment.
+         *  \return True if initialization succeded.
+         */
+        bool finishInitialization();
+
+        /** \brief Get a TrajOpt problem construction info object with default values, velocity cost,
+         *  collision avoidance, and initialization. These are built once into a template, which is
+         *  reused until the options they depend on or the fixed joints change, so only the start and goal
+         *  terms need to be added for each request.
+         *  \return Problem construction info for a new request.
+         */
+        std::shared_ptr<trajopt::ProblemConstructionInfo> getProblemConstructionInfo();
+
+        /** \brief Check if the problem template was built with the current options and fixed joints.
+         *  \return True if the template can be reused, false otherwise.
+         */
+        bool isTemplateCurrent() const;
+
+        /** \brief Set the initialization of the trajectory optimization from the current init type and
+         *  initial trajectory.
+         *  \param[out] pci Pointer to problem construction info with initialization set.
+         */
+        void problemInitialization(std::shared_ptr<trajopt::ProblemConstructionInfo> pci) const;
+
         /** \brief Create a TrajOpt problem construction info object with default values.
          *  \param[out] pci Pointer to problem construction info initialized.
          */
@@ -343,6 +476,45 @@ namespace robowflex
         PlannerResult solve(const SceneConstPtr &scene,
                             const std::shared_ptr<trajopt::ProblemConstructionInfo> &pci);
 
+        /** \brief Run restarts in parallel on \a options.num_threads threads, each optimizing its own copy
+         *  of the problem in its own copy of the environment from a differently seeded initial trajectory.
+         *  \param[in] scene Scene to plan for.
+         *  \param[in] pci Pointer to problem construction info initialized.
+         *  \param[out] best_cost Cost of the best collision-free solution.
+         *  \param[out] status Status of the last restart to finish.
+         *  \return Planner result with convergence and collision status.
+         */
+        PlannerResult solveParallel(const SceneConstPtr &scene,
+                                    const std::shared_ptr<trajopt::ProblemConstructionInfo> &pci,
+                                    double &best_cost, sco::OptStatus &status);
+
+        /** \brief Convert an optimized trajectory into a robot trajectory, and check it for collisions.
+         *  \param[in] scene Scene to check for collisions in.
+         *  \param[in] env Environment the trajectory was optimized in.
+         *  \param[in] tesseract_trajectory Trajectory to convert.
+         *  \param[in,out] trajectory Buffer to convert into. Its waypoints are reused if it was converted
+         *  into earlier in the same solve with the same number of waypoints, otherwise it is replaced.
+         *  \return True if the trajectory is collision-free.
+         */
+        bool getSolution(const SceneConstPtr &scene, const tesseract::tesseract_ros::KDLEnvPtr &env,
+                         const trajopt::TrajArray &tesseract_trajectory,
+                         robot_trajectory::RobotTrajectoryPtr &trajectory) const;
+
+        /** \brief Get the initial trajectory of a restart, which is either the seed from the library with
+         *  the same index or the (perturbed, if needed) initial trajectory of the problem.
+         *  \param[in] prob Problem being optimized.
+         *  \param[in] restart Index of the restart.
+         *  \return The initial trajectory.
+         */
+        trajopt::TrajArray getRestartTrajectory(const trajopt::TrajOptProbPtr &prob,
+                                                std::size_t restart) const;
+
+        /** \brief Report the current solution to the callback of the anytime plan in progress, if any.
+         *  \param[in] cost Cost of the solution.
+         *  \param[in] time Time since the start of the solve.
+         */
+        void reportSolution(double cost, double time) const;
+
         /** \brief Get parameters of the SQP.
          *  \return SQP parameters.
          */
@@ -353,6 +525,8 @@ namespace robowflex
         trajopt::TrajArray tesseract_trajectory_;          ///< Last successful trajectory generated by the
                                                            ///< planner in Tesseract format.
         tesseract::tesseract_ros::KDLEnvPtr env_;          ///< KDL environment.
+        hypercube::SceneConversionCache scene_cache_;      ///< Scene objects already converted into \a env_.
+        hypercube::JointIndexMap joint_map_;               ///< Joint index map of \a manip_.
         std::string group_;                                ///< Name of group to plan for.
         std::string manip_;                          ///< Name of manipulator chain to check for collisions.
         bool cont_cc_{true};                         ///< Use continuous collision checking.
@@ -363,9 +537,88 @@ namespace robowflex
                                                                                   ///< trajectory.
         trajopt::TrajArray initial_trajectory_;  ///< Initial trajectory (if any).
         double time_{0.0};                       ///< Time taken by the optimizer the last time it was called.
+        double cpu_time_{0.0};                   ///< CPU time taken by the optimizer the last time it was
+                                                 ///< called.
         std::vector<int> fixed_joints_;  ///< List of joints that need to be fixed, indexed in the order they
                                          ///< appear in the manipulator.
         robot_state::RobotStatePtr ref_state_;  ///< Reference state to build moveit trajectory waypoints.
+
+        std::shared_ptr<trajopt::ProblemConstructionInfo> pci_template_;  ///< Problem shared by requests.
+        Options template_options_;                ///< Options \a pci_template_ was built with.
+        std::vector<int> template_fixed_joints_;  ///< Fixed joints \a pci_template_ was built with.
+
+        /** \brief A copy of the environment for a restart thread.
+         */
+        struct RestartEnvironment
+        {
+            tesseract::tesseract_ros::KDLEnvPtr env;  ///< KDL environment.
+            hypercube::SceneConversionCache cache;    ///< Scene objects already converted into \a env.
+        };
+
+        srdf::ModelConstSharedPtr srdf_;                ///< SRDF the environments are loaded with.
+        std::unique_ptr<Pool> restart_pool_;            ///< Threads to run restarts on.
+        std::vector<RestartEnvironment> restart_envs_;  ///< Environment for each restart thread.
+
+        LibraryPtr library_;                     ///< Library of past solutions.
+        std::size_t library_k_{1};               ///< Number of seeds to get from the library.
+        bool library_learn_{true};               ///< Whether to add solutions to the library.
+        std::vector<trajopt::TrajArray> seeds_;  ///< Seeds of the current solve.
+
+        SolutionCallback solution_callback_;  ///< Callback of the anytime plan in progress, if any.
+    };
+
+    /** \brief A thread pool of TrajOpt planners. One prototype planner is initialized as usual, and the
+     *  planners of the other worker threads are initialized from it concurrently with
+     *  TrajOptPlanner::initialize(const TrajOptPlanner &), sharing the robot's URDF and the prototype's
+     *  SRDF. Each planner keeps its own environment and scene cache, which it updates while planning.
+     */
+    class TrajOptPoolPlanner : public PoolPlanner
+    {
+    public:
+        /** \brief Constructor.
+         *  \param[in] robot Robot to plan for.
+         *  \param[in] group_name Name of the (joint) group to plan for.
+         *  \param[in] n The number of threads to use. By default uses maximum available on the machine.
+         *  \param[in] name Name of planner.
+         */
+        TrajOptPoolPlanner(const RobotPtr &robot, const std::string &group_name,
+                           unsigned int n = std::thread::hardware_concurrency(),
+                           const std::string &name = "trajopt");
+
+        /** \brief Initialize the pool. See TrajOptPlanner::initialize(const std::string &).
+         *  \param[in] manip Name of chain group with all the links of the manipulator.
+         *  \return True if initialization succeded.
+         */
+        bool initialize(const std::string &manip);
+
+        /** \brief Initialize the pool. See TrajOptPlanner::initialize(const std::string &, const
+         *  std::string &).
+         *  \param[in] base_link Base link of the manipulator.
+         *  \param[in] tip_link Tip link of the manipulator.
+         *  \return True if initialization succeded.
+         */
+        bool initialize(const std::string &base_link, const std::string &tip_link);
+
+        /** \brief Get the prototype planner. Its options and settings are copied to the other planners
+         *  when the pool is initialized, so set them before calling initialize().
+         *  \return The prototype planner.
+         */
+        const TrajOptPlannerPtr &getPrototype() const;
+
+        /** \brief Get the planners of the pool, indexed by worker thread. Empty until initialized.
+         *  \return The planners.
+         */
+        const std::vector<TrajOptPlannerPtr> &getPlanners() const;
+
+    private:
+        /** \brief Initialize the planners of the other worker threads from the initialized prototype.
+         *  \return True if initialization succeded.
+         */
+        bool initializeFromPrototype();
+
+        std::string group_;                        ///< Name of group to plan for.
+        TrajOptPlannerPtr prototype_;              ///< Planner the others are initialized from.
+        std::vector<TrajOptPlannerPtr> planners_;  ///< Planners, indexed by worker thread.
     };
 }  // namespace robowflex
 
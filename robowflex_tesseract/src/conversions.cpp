@@ -4,7 +4,9 @@
 #include <moveit/robot_state/conversions.h>
 
 // Robowflex
+#include <robowflex_library/geometry.h>
 #include <robowflex_library/log.h>
+#include <robowflex_library/macros.h>
 
 // Tesseract
 #include <tesseract_ros/ros_tesseract_utils.h>
@@ -14,6 +16,64 @@
 
 using namespace robowflex;
 
+namespace
+{
+    /** \brief Build a Tesseract attachable object from a collision world object. The object's shapes are
+     * shared, not copied.
+     *  \param[in] object Collision world object to convert.
+     *  \return The attachable object.
+     */
+    tesseract::AttachableObjectPtr
+    worldObjectToAttachableObject(const collision_detection::World::Object &object)
+    {
+        auto ao = std::make_shared<tesseract::AttachableObject>();
+        ao->name = object.id_;
+
+        for (std::size_t i = 0; i < object.shapes_.size(); ++i)
+        {
+            const auto &shape = object.shapes_[i];
+
+            // Meshes are checked as their convex hulls, so the cached hull is given instead of the mesh.
+            shapes::ShapeConstPtr collision = shape;
+            if (shape->type == shapes::MESH)
+                if (auto hull = Geometry::getConvexHull(static_cast<const shapes::Mesh &>(*shape)))
+                    collision = hull;
+
+#if ROBOWFLEX_MOVEIT_VERSION >= ROBOWFLEX_MOVEIT_VERSION_COMPUTE(1, 1, 6)
+            const Eigen::Isometry3d pose = object.pose_ * object.shape_poses_[i];
+#else
+            const Eigen::Isometry3d pose = object.shape_poses_[i];
+#endif
+
+            ao->visual.shapes.emplace_back(shape);
+            ao->visual.shape_poses.emplace_back(pose);
+            ao->collision.shapes.emplace_back(collision);
+            ao->collision.shape_poses.emplace_back(pose);
+            ao->collision.collision_object_types.emplace_back(
+                (shape->type == shapes::MESH) ? tesseract::CollisionObjectType::ConvexHull :
+                                                tesseract::CollisionObjectType::UseShapeType);
+        }
+
+        return ao;
+    }
+
+    /** \brief Add a collision world object to a KDL environment, attached to the root link.
+     *  \param[in] object Collision world object to add.
+     *  \param[out] env KDL environment to add the object to.
+     */
+    void addWorldObject(const collision_detection::World::Object &object,
+                        const tesseract::tesseract_ros::KDLEnvPtr &env)
+    {
+        env->addAttachableObject(worldObjectToAttachableObject(object));
+
+        tesseract::AttachedBodyInfo attached_body_info;
+        attached_body_info.object_name = object.id_;
+        attached_body_info.parent_link_name = env->getRootLinkName();
+        attached_body_info.transform = Eigen::Isometry3d::Identity();
+        env->attachBody(attached_body_info);
+    }
+}  // namespace
+
 bool hypercube::sceneToTesseractEnv(const robowflex::SceneConstPtr &scene,
                                     tesseract::tesseract_ros::KDLEnvPtr env)
 {
@@ -23,93 +83,10 @@ bool hypercube::sceneToTesseractEnv(const robowflex::SceneConstPtr &scene,
         env->clearAttachableObjects();
         env->clearAttachedBodies();
 
-        // Loop over collision objects in the scene.
-        const auto &scene_msg = scene->getMessage();
-        for (const auto &collision_object : scene_msg.world.collision_objects)
-        {
-            // Add collision and visual objects
-            tesseract_msgs::AttachableObject obj;
-            obj.name = collision_object.id;
-            obj.operation = tesseract_msgs::AttachableObject::ADD;
-
-            for (const shape_msgs::SolidPrimitive &primitive : collision_object.primitives)
-            {
-                obj.visual.primitives.emplace_back(primitive);
-                obj.collision.primitives.emplace_back(primitive);
-                std_msgs::Int32 cot;
-                cot.data = tesseract::CollisionObjectType::UseShapeType;
-                obj.collision.primitive_collision_object_types.emplace_back(cot);
-            }
-
-            for (const shape_msgs::Mesh &mesh : collision_object.meshes)
-            {
-                obj.visual.meshes.emplace_back(mesh);
-                obj.collision.meshes.emplace_back(mesh);
-                std_msgs::Int32 cot;
-                cot.data = tesseract::CollisionObjectType::ConvexHull;
-                obj.collision.mesh_collision_object_types.emplace_back(cot);
-            }
-
-            for (const shape_msgs::Plane &plane : collision_object.planes)
-            {
-                obj.visual.planes.emplace_back(plane);
-                obj.collision.planes.emplace_back(plane);
-            }
-
-            for (const geometry_msgs::Pose &pose : collision_object.primitive_poses)
-            {
-                obj.visual.primitive_poses.emplace_back(pose);
-                obj.collision.primitive_poses.emplace_back(pose);
-            }
-
-            for (const geometry_msgs::Pose &pose : collision_object.mesh_poses)
-            {
-                obj.visual.mesh_poses.emplace_back(pose);
-                obj.collision.mesh_poses.emplace_back(pose);
-            }
-
-            for (const geometry_msgs::Pose &pose : collision_object.plane_poses)
-            {
-                obj.visual.plane_poses.emplace_back(pose);
-                obj.collision.plane_poses.emplace_back(pose);
-            }
-
-            // Add collision object as attachable object.
-            auto ao = std::make_shared<tesseract::AttachableObject>();
-            tesseract::tesseract_ros::attachableObjectMsgToAttachableObject(ao, obj);
-            env->addAttachableObject(ao);
-
-            // Attach the object to the environment (to a parent frame).
-            tesseract::AttachedBodyInfo attached_body_info;
-            attached_body_info.object_name = collision_object.id;
-            attached_body_info.parent_link_name = env->getRootLinkName();
-            attached_body_info.transform = Eigen::Isometry3d::Identity();
-            env->attachBody(attached_body_info);
-        }
-
-        // Add octomap information.
-        if (scene_msg.world.octomap.octomap.data.size() > 0)
-        {
-            const std::string &name = "octomap";
-            tesseract_msgs::AttachableObject obj;
-            obj.name = name;
-            obj.operation = tesseract_msgs::AttachableObject::ADD;
-            obj.collision.octomaps.emplace_back(scene_msg.world.octomap.octomap);
-            obj.collision.octomap_poses.emplace_back(scene_msg.world.octomap.origin);
-            std_msgs::Int32 cot;
-            cot.data = tesseract::CollisionObjectType::UseShapeType;
-            obj.collision.octomap_collision_object_types.emplace_back(cot);
-
-            auto ao = std::make_shared<tesseract::AttachableObject>();
-            tesseract::tesseract_ros::attachableObjectMsgToAttachableObject(ao, obj);
-            env->addAttachableObject(ao);
-
-            tesseract::AttachedBodyInfo attached_body_info;
-            attached_body_info.object_name = name;
-            attached_body_info.parent_link_name = scene_msg.world.octomap.header.frame_id;
-            attached_body_info.transform = Eigen::Isometry3d::Identity();
-            env->attachBody(attached_body_info);
-        }
+        // Add collision objects (including the octomap, if any) directly from the collision world.
+        const auto &world = scene->getSceneConst()->getWorld();
+        for (const auto &object : *world)
+            addWorldObject(*object.second, env);
 
         return true;
     }
@@ -119,6 +96,66 @@ bool hypercube::sceneToTesseractEnv(const robowflex::SceneConstPtr &scene,
     return false;
 }
 
+bool hypercube::sceneToTesseractEnv(const robowflex::SceneConstPtr &scene,
+                                    tesseract::tesseract_ros::KDLEnvPtr env, SceneConversionCache &cache)
+{
+    if (not env->checkInitialized())
+    {
+        RBX_ERROR("Tesseract environment not initialized");
+        return false;
+    }
+
+    if (cache.env != env)
+    {
+        env->clearAttachableObjects();
+        env->clearAttachedBodies();
+
+        cache.scene = ID::getNullKey();
+        cache.env = env;
+        cache.objects.clear();
+    }
+
+    // Remove bodies that were not added from the scene.
+    std::vector<std::string> foreign;
+    for (const auto &body : env->getAttachedBodies())
+        if (cache.objects.find(body.first) == cache.objects.end())
+            foreign.emplace_back(body.first);
+
+    for (const auto &name : foreign)
+    {
+        env->detachBody(name);
+        env->removeAttachableObject(name);
+    }
+
+    const auto &key = scene->getKey();
+    if (compareIDs(key, cache.scene))
+        return true;
+
+    const auto &world = scene->getSceneConst()->getWorld();
+
+    // Remove objects that are gone or have changed.
+    for (auto it = cache.objects.begin(); it != cache.objects.end();)
+    {
+        const auto &object = world->getObject(it->first);
+        if (object != it->second)
+        {
+            env->detachBody(it->first);
+            env->removeAttachableObject(it->first);
+            it = cache.objects.erase(it);
+        }
+        else
+            ++it;
+    }
+
+    // Add objects that are new or have changed.
+    for (const auto &object : *world)
+        if (cache.objects.emplace(object.first, object.second).second)
+            addWorldObject(*object.second, env);
+
+    cache.scene = key;
+    return true;
+}
+
 bool hypercube::addAttachedBodiesToTesseractEnv(const robot_state::RobotStatePtr &state,
                                                 tesseract::tesseract_ros::KDLEnvPtr env)
 {
@@ -175,6 +212,24 @@ bool hypercube::addAttachedBodiesToTesseractEnv(const robot_state::RobotStatePtr
     return true;
 }
 
+hypercube::JointIndexMap hypercube::getJointIndexMap(const robot_model::RobotModelConstPtr &model,
+                                                    const std::string &manip,
+                                                    const tesseract::tesseract_ros::KDLEnvPtr &env)
+{
+    const auto index = [&model](const std::string &name) {
+        return (model->hasJointModel(name)) ? model->getJointModel(name)->getFirstVariableIndex() : -1;
+    };
+
+    JointIndexMap map;
+    for (const auto &name : env->getManipulator(manip)->getJointNames())
+        map.manip.emplace_back(model->getVariableIndex(name));
+
+    for (const auto &name : env->getJointNames())
+        map.env.emplace_back(index(name));
+
+    return map;
+}
+
 void hypercube::robotStateToManipState(const robot_state::RobotStatePtr &robot_state,
                                        const std::vector<std::string> &manip_joint_names,
                                        std::vector<double> &manip_joint_values)
@@ -201,15 +256,29 @@ void hypercube::manipStateToRobotState(const Eigen::Ref<const Eigen::VectorXd> &
                                        const tesseract::tesseract_ros::KDLEnvPtr &env,
                                        robot_state::RobotStatePtr robot_state)
 {
+    manipStateToRobotState(manip_state, getJointIndexMap(robot_state->getRobotModel(), manip, env), env,
+                           robot_state);
+}
+
+void hypercube::manipStateToRobotState(const Eigen::Ref<const Eigen::VectorXd> &manip_state,
+                                       const JointIndexMap &map,
+                                       const tesseract::tesseract_ros::KDLEnvPtr &env,
+                                       robot_state::RobotStatePtr robot_state)
+{
+    std::vector<double> values(robot_state->getVariablePositions(),
+                               robot_state->getVariablePositions() + robot_state->getVariableCount());
+
     // Initialize it with the env state (includes both group and non-group joints).
     const auto &joint_values = env->getCurrentJointValues();
-    std::vector<double> tmp_current_values(joint_values.data(), joint_values.data() + joint_values.size());
-    robot_state->setVariablePositions(env->getJointNames(), tmp_current_values);
+    for (std::size_t j = 0; j < map.env.size(); ++j)
+        if (map.env[j] >= 0)
+            values[map.env[j]] = joint_values[j];
 
     // Set (only) group joints from tesseract waypoint.
-    const auto &joint_manip_names = env->getManipulator(manip)->getJointNames();
-    std::vector<double> tmp_group_values(manip_state.data(), manip_state.data() + manip_state.size());
-    robot_state->setVariablePositions(joint_manip_names, tmp_group_values);
+    for (std::size_t j = 0; j < map.manip.size(); ++j)
+        values[map.manip[j]] = manip_state[j];
+
+    robot_state->setVariablePositions(values);
 }
 
 void hypercube::manipTesseractTrajToRobotTraj(const tesseract::TrajArray &tesseract_traj,
@@ -217,17 +286,40 @@ void hypercube::manipTesseractTrajToRobotTraj(const tesseract::TrajArray &tesser
                                               const std::string &manip,
                                               const tesseract::tesseract_ros::KDLEnvPtr &env,
                                               robot_trajectory::RobotTrajectoryPtr trajectory)
+{
+    manipTesseractTrajToRobotTraj(tesseract_traj, ref_state,
+                                  getJointIndexMap(ref_state->getRobotModel(), manip, env), env, trajectory);
+}
+
+void hypercube::manipTesseractTrajToRobotTraj(const tesseract::TrajArray &tesseract_traj,
+                                              const robot_state::RobotStatePtr &ref_state,
+                                              const JointIndexMap &map,
+                                              const tesseract::tesseract_ros::KDLEnvPtr &env,
+                                              robot_trajectory::RobotTrajectoryPtr trajectory)
 {
     const robot_state::RobotState &copy = *ref_state;
     trajectory->clear();
 
+    // Robot variables of every waypoint, one row each, initialized with the reference and env state.
+    using RowMatrix = Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+    const auto count = static_cast<Eigen::Index>(copy.getVariableCount());
+    Eigen::Map<const Eigen::RowVectorXd> reference(copy.getVariablePositions(), count);
+    RowMatrix values = reference.replicate(tesseract_traj.rows(), 1);
+
+    const auto &joint_values = env->getCurrentJointValues();
+    for (std::size_t j = 0; j < map.env.size(); ++j)
+        if (map.env[j] >= 0)
+            values.col(map.env[j]).setConstant(joint_values[j]);
+
+    // Scatter the manipulator's columns of all waypoints at once.
+    for (std::size_t j = 0; j < map.manip.size(); ++j)
+        values.col(map.manip[j]) = tesseract_traj.col(j);
+
     for (int i = 0; i < tesseract_traj.rows(); i++)
     {
         // Create a tmp state for every waypoint.
         auto tmp_state = std::make_shared<robot_state::RobotState>(copy);
-
-        // Transform tesseract manip ith waypoint to robot state.
-        manipStateToRobotState(tesseract_traj.row(i), manip, env, tmp_state);
+        tmp_state->setVariablePositions(values.row(i).data());
 
         // Add waypoint to trajectory.
         trajectory->addSuffixWayPoint(tmp_state, 0.0);
@@ -239,17 +331,21 @@ void hypercube::robotTrajToManipTesseractTraj(const robot_trajectory::RobotTraje
                                               const tesseract::tesseract_ros::KDLEnvPtr &env,
                                               tesseract::TrajArray &trajectory)
 {
-    trajectory.resize(0, 0);
-    trajectory.resize(robot_traj->getWayPointCount(), robot_traj->getGroup()->getVariableCount());
+    robotTrajToManipTesseractTraj(robot_traj, getJointIndexMap(robot_traj->getRobotModel(), manip, env),
+                                  trajectory);
+}
 
-    for (unsigned int i = 0; i < robot_traj->getWayPointCount(); ++i)
-    {
-        // Transform each traj waypoint to tesseract manip state.
-        std::vector<double> manip_joint_values;
-        robotStateToManipState(robot_traj->getWayPointPtr(i), env->getManipulator(manip)->getJointNames(),
-                               manip_joint_values);
+void hypercube::robotTrajToManipTesseractTraj(const robot_trajectory::RobotTrajectoryPtr &robot_traj,
+                                              const JointIndexMap &map, tesseract::TrajArray &trajectory)
+{
+    const auto rows = robot_traj->getWayPointCount();
+    trajectory.resize(rows, map.manip.size());
 
-        // Push manip state to manip tesseract trajectory .
-        trajectory.row(i) = Eigen::VectorXd::Map(manip_joint_values.data(), manip_joint_values.size());
+    // Gather the manipulator's variables of each waypoint into its row.
+    for (std::size_t i = 0; i < rows; ++i)
+    {
+        const double *values = robot_traj->getWayPoint(i).getVariablePositions();
+        for (std::size_t j = 0; j < map.manip.size(); ++j)
+            trajectory(i, j) = values[map.manip[j]];
     }
 }
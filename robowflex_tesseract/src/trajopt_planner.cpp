@@ -1,5 +1,11 @@
 /* Author: Carlos Quintero Pena */
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <random>
+
 // MoveIt
 #include <moveit/robot_state/conversions.h>
 #include <moveit_msgs/MoveItErrorCodes.h>
@@ -32,25 +38,10 @@ bool TrajOptPlanner::initialize(const std::string &manip)
     manip_ = manip;
 
     // Start KDL environment with the robot information.
-    env_ = std::make_shared<tesseract::tesseract_ros::KDLEnv>();
-
-    if (!env_->init(robot_->getURDF(), robot_->getSRDF()))
-    {
-        RBX_ERROR("Error loading robot %s", robot_->getName());
-        return false;
-    }
+    srdf_ = robot_->getSRDF();
+    env_ = createEnvironment();
 
-    // Check if manipulator was correctly loaded.
-    if (!env_->hasManipulator(manip_))
-    {
-        RBX_ERROR("No manipulator found in KDL environment");
-        return false;
-    }
-
-    // Initialize trajectory.
-    trajectory_ = std::make_shared<robot_trajectory::RobotTrajectory>(robot_->getModelConst(), group_);
-
-    return true;
+    return finishInitialization();
 }
 
 bool TrajOptPlanner::initialize(const std::string &base_link, const std::string &tip_link)
@@ -58,9 +49,6 @@ bool TrajOptPlanner::initialize(const std::string &base_link, const std::string
     // Save manipulator name.
     manip_ = "manipulator";
 
-    // Start KDL environment with the robot information.
-    env_ = std::make_shared<tesseract::tesseract_ros::KDLEnv>();
-
     if (!robot_->getModelConst()->hasLinkModel(base_link))
     {
         RBX_ERROR("%s does not exist in robot description", base_link);
@@ -92,12 +80,58 @@ bool TrajOptPlanner::initialize(const std::string &base_link, const std::string
     srdf.reset(new srdf::Model());
     srdf->initXml(*(robot_->getURDF()), &srdf_doc);
 
-    if (!env_->init(robot_->getURDF(), srdf))
+    // Start KDL environment with the robot information.
+    srdf_ = srdf;
+    env_ = createEnvironment();
+
+    return finishInitialization();
+}
+
+bool TrajOptPlanner::initialize(const TrajOptPlanner &prototype)
+{
+    if (!prototype.env_)
     {
-        RBX_ERROR("Error loading robot %s", robot_->getName());
+        RBX_ERROR("Prototype planner is not initialized");
+        return false;
+    }
+
+    if (prototype.robot_->getModelConst() != robot_->getModelConst() or prototype.group_ != group_)
+    {
+        RBX_ERROR("Prototype planner is for a different robot or group");
         return false;
     }
 
+    manip_ = prototype.manip_;
+    options = prototype.options;
+    cont_cc_ = prototype.cont_cc_;
+    init_type_ = prototype.init_type_;
+    initial_trajectory_ = prototype.initial_trajectory_;
+    fixed_joints_ = prototype.fixed_joints_;
+
+    // The prototype's SRDF already has the manipulator, so only the environment is loaded.
+    srdf_ = prototype.srdf_;
+    env_ = createEnvironment();
+
+    return finishInitialization();
+}
+
+tesseract::tesseract_ros::KDLEnvPtr TrajOptPlanner::createEnvironment() const
+{
+    auto env = std::make_shared<tesseract::tesseract_ros::KDLEnv>();
+    if (!env->init(robot_->getURDF(), srdf_))
+    {
+        RBX_ERROR("Error loading robot %s", robot_->getName());
+        return nullptr;
+    }
+
+    return env;
+}
+
+bool TrajOptPlanner::finishInitialization()
+{
+    if (!env_)
+        return false;
+
     // Check if manipulator was correctly loaded.
     if (!env_->hasManipulator(manip_))
     {
@@ -105,15 +139,20 @@ bool TrajOptPlanner::initialize(const std::string &base_link, const std::string
         return false;
     }
 
+    // Restart environments are loaded from the same URDF and SRDF, so they share the joint index map.
+    joint_map_ = hypercube::getJointIndexMap(robot_->getModelConst(), manip_, env_);
+
     // Initialize trajectory.
     trajectory_ = std::make_shared<robot_trajectory::RobotTrajectory>(robot_->getModelConst(), group_);
+    pci_template_.reset();
+    restart_envs_.clear();
 
     return true;
 }
 
 void TrajOptPlanner::setInitialTrajectory(const robot_trajectory::RobotTrajectoryPtr &init_trajectory)
 {
-    hypercube::robotTrajToManipTesseractTraj(init_trajectory, manip_, env_, initial_trajectory_);
+    hypercube::robotTrajToManipTesseractTraj(init_trajectory, joint_map_, initial_trajectory_);
     init_type_ = InitInfo::Type::GIVEN_TRAJ;
 }
 
@@ -123,6 +162,18 @@ void TrajOptPlanner::setInitialTrajectory(const TrajArray &init_trajectory)
     init_type_ = InitInfo::Type::GIVEN_TRAJ;
 }
 
+void TrajOptPlanner::setLibrary(const LibraryPtr &library, std::size_t k, bool learn)
+{
+    library_ = library;
+    library_k_ = k;
+    library_learn_ = learn;
+}
+
+const TrajOptPlanner::LibraryPtr &TrajOptPlanner::getLibrary() const
+{
+    return library_;
+}
+
 void TrajOptPlanner::setInitType(const InitInfo::Type &init_type)
 {
     if (init_type != InitInfo::Type::GIVEN_TRAJ)
@@ -170,6 +221,11 @@ double TrajOptPlanner::getPlanningTime() const
     return time_;
 }
 
+double TrajOptPlanner::getPlanningCPUTime() const
+{
+    return cpu_time_;
+}
+
 void TrajOptPlanner::fixJoints(const std::vector<std::string> &joints)
 {
     if (!env_->hasManipulator(manip_))
@@ -246,34 +302,57 @@ TrajOptPlanner::plan(const SceneConstPtr &scene, const planning_interface::Motio
     return res;
 }
 
+planning_interface::MotionPlanResponse
+TrajOptPlanner::planAnytime(const SceneConstPtr &scene, const planning_interface::MotionPlanRequest &request,
+                            const SolutionCallback &callback)
+{
+    solution_callback_ = callback;
+    auto res = plan(scene, request);
+    solution_callback_ = nullptr;
+
+    return res;
+}
+
 TrajOptPlanner::PlannerResult TrajOptPlanner::plan(const SceneConstPtr &scene,
                                                    const robot_state::RobotStatePtr &start_state,
                                                    const robot_state::RobotStatePtr &goal_state)
 {
     // Create the tesseract environment from the scene.
-    if (hypercube::sceneToTesseractEnv(scene, env_))
+    if (hypercube::sceneToTesseractEnv(scene, env_, scene_cache_))
     {
         // Attach bodies to KDL env.
         hypercube::addAttachedBodiesToTesseractEnv(ref_state_, env_);
 
-        // Fill in the problem construction info and initialization.
-        auto pci = std::make_shared<ProblemConstructionInfo>(env_);
-        problemConstructionInfo(pci);
-
-        // Add velocity cost.
-        addVelocityCost(pci);
+        // Get the problem construction info with velocity and collision costs, and initialization.
+        options.default_safety_margin_coeffs = options.joint_state_safety_margin_coeffs;
+        auto pci = getProblemConstructionInfo();
 
         // Add start state.
         addStartState(start_state, pci);
 
-        // Add collision costs to all waypoints in the trajectory.
-        options.default_safety_margin_coeffs = options.joint_state_safety_margin_coeffs;
-        addCollisionAvoidance(pci);
-
         // Add goal state.
         addGoalState(goal_state, pci);
 
-        return solve(scene, pci);
+        if (!library_)
+            return solve(scene, pci);
+
+        // Seed the first restarts with the nearest solutions in the library.
+        const auto &manip_joint_names = env_->getManipulator(manip_)->getJointNames();
+        std::vector<double> start_values, goal_values;
+        hypercube::robotStateToManipState(start_state, manip_joint_names, start_values);
+        hypercube::robotStateToManipState(goal_state, manip_joint_names, goal_values);
+
+        const Eigen::Map<const Eigen::VectorXd> start(start_values.data(), start_values.size());
+        const Eigen::Map<const Eigen::VectorXd> goal(goal_values.data(), goal_values.size());
+        seeds_ = library_->getSeeds(start, goal, library_k_, options.num_waypoints);
+
+        auto result = solve(scene, pci);
+        seeds_.clear();
+
+        if (result.second and library_learn_)
+            library_->add(start, goal, tesseract_trajectory_);
+
+        return result;
     }
 
     return PlannerResult(false, false);
@@ -302,24 +381,17 @@ TrajOptPlanner::PlannerResult TrajOptPlanner::plan(const SceneConstPtr &scene,
     ref_state_ = std::make_shared<robot_state::RobotState>(*start_state);
 
     // Create the tesseract environment from the scene.
-    if (hypercube::sceneToTesseractEnv(scene, env_))
+    if (hypercube::sceneToTesseractEnv(scene, env_, scene_cache_))
     {
         // Attach bodies to KDL env.
         hypercube::addAttachedBodiesToTesseractEnv(ref_state_, env_);
 
-        // Fill in the problem construction info and initialization.
-        auto pci = std::make_shared<ProblemConstructionInfo>(env_);
-        problemConstructionInfo(pci);
-
-        // Add velocity cost.
-        addVelocityCost(pci);
+        // Get the problem construction info with velocity and collision costs, and initialization.
+        auto pci = getProblemConstructionInfo();
 
         // Add start state
         addStartState(start_state, pci);
 
-        // Add collision costs to all waypoints in the trajectory.
-        addCollisionAvoidance(pci);
-
         // Add goal pose for link.
         addGoalPose(goal_pose, link, pci);
 
@@ -349,21 +421,14 @@ TrajOptPlanner::PlannerResult TrajOptPlanner::plan(const SceneConstPtr &scene,
     }
 
     // Create the tesseract environment from the scene.
-    if (hypercube::sceneToTesseractEnv(scene, env_))
+    if (hypercube::sceneToTesseractEnv(scene, env_, scene_cache_))
     {
-        // Fill in the problem construction info and initialization.
-        auto pci = std::make_shared<ProblemConstructionInfo>(env_);
-        problemConstructionInfo(pci);
-
-        // Add velocity cost.
-        addVelocityCost(pci);
+        // Get the problem construction info with velocity and collision costs, and initialization.
+        auto pci = getProblemConstructionInfo();
 
         // Add start state
         addStartState(start_state, pci);
 
-        // Add collision costs to all waypoints in the trajectory.
-        addCollisionAvoidance(pci);
-
         // Add goal pose for link.
         addGoalPose(goal_pose, link, pci);
 
@@ -394,21 +459,14 @@ TrajOptPlanner::PlannerResult TrajOptPlanner::plan(const SceneConstPtr &scene, c
     }
 
     // Create the tesseract environment from the scene.
-    if (hypercube::sceneToTesseractEnv(scene, env_))
+    if (hypercube::sceneToTesseractEnv(scene, env_, scene_cache_))
     {
-        // Fill in the problem construction info and initialization
-        auto pci = std::make_shared<ProblemConstructionInfo>(env_);
-        problemConstructionInfo(pci);
-
-        // Add velocity cost.
-        addVelocityCost(pci);
+        // Get the problem construction info with velocity and collision costs, and initialization.
+        auto pci = getProblemConstructionInfo();
 
         // Add start_pose for start_link.
         addStartPose(start_pose, start_link, pci);
 
-        // Add collision costs to all waypoints in the trajectory.
-        addCollisionAvoidance(pci);
-
         // Add goal_pose for goal_link.
         addGoalPose(goal_pose, goal_link, pci);
 
@@ -442,6 +500,54 @@ void TrajOptPlanner::setWriteFile(bool file_write_cb, const std::string &file_pa
         stream_ptr_->open(file_path_, std::ofstream::out | std::ofstream::trunc);
 }
 
+std::shared_ptr<ProblemConstructionInfo> TrajOptPlanner::getProblemConstructionInfo()
+{
+    // Only the start, goal, and initialization change between requests with the same options.
+    if (not pci_template_ or not isTemplateCurrent())
+    {
+        pci_template_ = std::make_shared<ProblemConstructionInfo>(env_);
+        problemConstructionInfo(pci_template_);
+        addVelocityCost(pci_template_);
+        addCollisionAvoidance(pci_template_);
+
+        template_options_ = options;
+        template_fixed_joints_ = fixed_joints_;
+    }
+
+    // Terms are shared with the template, as they are not modified once added.
+    auto pci = std::make_shared<ProblemConstructionInfo>(*pci_template_);
+    problemInitialization(pci);
+
+    return pci;
+}
+
+bool TrajOptPlanner::isTemplateCurrent() const
+{
+    const auto &a = template_options_;
+    const auto &b = options;
+
+    return a.backend_optimizer == b.backend_optimizer and a.num_waypoints == b.num_waypoints and
+           a.dt_lower_lim == b.dt_lower_lim and a.dt_upper_lim == b.dt_upper_lim and
+           a.start_fixed == b.start_fixed and a.use_time == b.use_time and
+           a.joint_vel_coeffs == b.joint_vel_coeffs and a.use_cont_col_avoid == b.use_cont_col_avoid and
+           a.collision_gap == b.collision_gap and a.default_safety_margin == b.default_safety_margin and
+           a.default_safety_margin_coeffs == b.default_safety_margin_coeffs and
+           template_fixed_joints_ == fixed_joints_;
+}
+
+void TrajOptPlanner::problemInitialization(std::shared_ptr<ProblemConstructionInfo> pci) const
+{
+    pci->init_info.type = init_type_;
+    pci->init_info.dt = options.init_info_dt;
+    if (init_type_ == InitInfo::Type::GIVEN_TRAJ)
+        pci->init_info.data = initial_trajectory_;
+    else
+        pci->init_info.data = TrajArray();
+
+    if (options.verbose)
+        RBX_INFO("TrajOpt initialization: %d", init_type_);
+}
+
 void TrajOptPlanner::problemConstructionInfo(std::shared_ptr<ProblemConstructionInfo> pci) const
 {
     pci->basic_info.convex_solver = options.backend_optimizer;
@@ -453,13 +559,7 @@ void TrajOptPlanner::problemConstructionInfo(std::shared_ptr<ProblemConstruction
     pci->basic_info.start_fixed = options.start_fixed;
     pci->basic_info.dofs_fixed = fixed_joints_;
     pci->basic_info.use_time = options.use_time;
-    pci->init_info.type = init_type_;
-    pci->init_info.dt = options.init_info_dt;
-    if (init_type_ == InitInfo::Type::GIVEN_TRAJ)
-        pci->init_info.data = initial_trajectory_;
-
-    if (options.verbose)
-        RBX_INFO("TrajOpt initialization: %d", init_type_);
+    problemInitialization(pci);
 }
 
 void TrajOptPlanner::addVelocityCost(std::shared_ptr<trajopt::ProblemConstructionInfo> pci) const
@@ -585,105 +685,140 @@ void TrajOptPlanner::addGoalPose(const RobotPose &goal_pose, const std::string &
     pci->cnt_infos.push_back(pose_constraint);
 }
 
-TrajOptPlanner::PlannerResult TrajOptPlanner::solve(const SceneConstPtr &scene,
-                                                    const std::shared_ptr<ProblemConstructionInfo> &pci)
+namespace
 {
-    PlannerResult planner_result(false, false);
+    /** \brief Add seeded uniform noise to all waypoints of a trajectory but start and goal.
+     *  \param[in,out] trajectory Trajectory to perturb.
+     *  \param[in] noise Max and (negative) min amount of noise added to each joint value.
+     *  \param[in] seed Seed of the noise. */
+    void perturbTrajectory(TrajArray &trajectory, double noise, std::size_t seed)
+    {
+        std::mt19937 generator(seed);
+        std::uniform_real_distribution<double> distribution(-noise, noise);
 
-    // Create optimizer and populate parameters.
-    TrajOptProbPtr prob = ConstructProblem(*pci);
-    sco::BasicTrustRegionSQP opt(prob);
-    opt.setParameters(getTrustRegionSQPParameters());
+        for (long int i = 1; i < trajectory.rows() - 1; ++i)
+            for (long int j = 0; j < trajectory.cols(); ++j)
+                trajectory(i, j) += distribution(generator);
+    }
 
-    // Add write file callback.
-    if (file_write_cb_)
+    double secondsSince(const std::chrono::steady_clock::time_point &start)
     {
-        if (!stream_ptr_->is_open())
-            stream_ptr_->open(file_path_, std::ofstream::out | std::ofstream::trunc);
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}  // namespace
 
-        opt.addCallback(WriteCallback(stream_ptr_, prob));
+bool TrajOptPlanner::getSolution(const SceneConstPtr &scene, const tesseract::tesseract_ros::KDLEnvPtr &env,
+                                 const TrajArray &tesseract_trajectory,
+                                 robot_trajectory::RobotTrajectoryPtr &trajectory) const
+{
+    // Waypoints of a buffer from the same solve already have the reference state, so only the manipulator
+    // joints need to be set.
+    const auto rows = static_cast<std::size_t>(tesseract_trajectory.rows());
+    if (trajectory and trajectory->getWayPointCount() == rows)
+    {
+        for (std::size_t i = 0; i < rows; ++i)
+            hypercube::manipStateToRobotState(tesseract_trajectory.row(i), joint_map_, env,
+                                              trajectory->getWayPointPtr(i));
     }
+    else
+    {
+        trajectory = std::make_shared<robot_trajectory::RobotTrajectory>(robot_->getModelConst(), group_);
+        hypercube::manipTesseractTrajToRobotTraj(tesseract_trajectory, ref_state_, joint_map_, env,
+                                                 trajectory);
+    }
+
+    return Trajectory(trajectory).isCollisionFree(scene);
+}
+
+TrajOptPlanner::PlannerResult TrajOptPlanner::solve(const SceneConstPtr &scene,
+                                                    const std::shared_ptr<ProblemConstructionInfo> &pci)
+{
+    RBX_TRACE("TrajOptPlanner::solve");
 
     // If the planner needs to run more than once, add noise to the initial trajectory.
     if (!options.return_first_sol)
         options.perturb_init_traj = true;
 
-    // Initialize.
-    double total_time = 0.0;
+    // Open the write file, which the restarts share.
+    if (file_write_cb_ and !stream_ptr_->is_open())
+        stream_ptr_->open(file_path_, std::ofstream::out | std::ofstream::trunc);
+
+    PlannerResult planner_result(false, false);
     double best_cost = std::numeric_limits<double>::infinity();
+    sco::OptStatus status = sco::OptStatus::INVALID;
 
-    while (true)
+    if (!options.return_first_sol and options.num_threads > 1)
+        planner_result = solveParallel(scene, pci, best_cost, status);
+    else
     {
-        // Perturb initial trajectory if needed.
-        auto init_trajectory = prob->GetInitTraj();
-        if (options.perturb_init_traj)
-        {
-            // Perturb all waypoints but start and goal.
-            int rows = options.num_waypoints - 2;
-            int cols = pci->kin->numJoints();
-            double noise = options.noise_init_traj;
-
-            init_trajectory.block(1, 0, rows, cols) += (Eigen::MatrixXd::Constant(rows, cols, -noise) +
-                                                        2 * noise *
-                                                            (Eigen::MatrixXd::Random(rows, cols) * 0.5 +
-                                                             Eigen::MatrixXd::Constant(rows, cols, 0.5)));
-        }
+        // Create optimizer and populate parameters.
+        TrajOptProbPtr prob = ConstructProblem(*pci);
+        sco::BasicTrustRegionSQP opt(prob);
+        opt.setParameters(getTrustRegionSQPParameters());
 
-        opt.initialize(trajToDblVec(init_trajectory));
+        // Add write file callback.
+        if (file_write_cb_)
+            opt.addCallback(WriteCallback(stream_ptr_, prob));
 
-        // Optimize.
-        ros::Time tStart = ros::Time::now();
-        opt.optimize();
+        // Initialize.
+        double total_time = 0.0;
+        std::size_t restart = 0;
+        robot_trajectory::RobotTrajectoryPtr buffer;
 
-        // Measure and print time.
-        double time = (ros::Time::now() - tStart).toSec();
-        total_time += time;
-        time_ = total_time;
-
-        if (opt.results().status == sco::OptStatus::OPT_CONVERGED)
+        while (true)
         {
-            // Optimization problem converged.
-            planner_result.first = true;
-
-            // Check for collisions.
-            auto tss_current_traj = getTraj(opt.x(), prob->GetVars());
-            auto current_traj =
-                std::make_shared<robot_trajectory::RobotTrajectory>(robot_->getModelConst(), group_);
-            hypercube::manipTesseractTrajToRobotTraj(tss_current_traj, ref_state_, manip_, env_,
-                                                     current_traj);
-            auto const &ct = std::make_shared<Trajectory>(current_traj);
-            bool is_ct_collision_free = ct->isCollisionFree(scene);
-
-            // If trajectory is better than current, update the trajectory and cost.
-            if ((opt.results().total_cost < best_cost) and is_ct_collision_free)
-            {
-                // Update best cost.
-                best_cost = opt.results().total_cost;
+            // Perturb initial trajectory if needed.
+            opt.initialize(trajToDblVec(getRestartTrajectory(prob, restart++)));
 
-                // Clear current trajectory.
-                trajectory_->clear();
+            // Optimize.
+            const auto start = std::chrono::steady_clock::now();
+            opt.optimize();
 
-                // Update trajectory.
-                tesseract_trajectory_ = tss_current_traj;
-                trajectory_ = current_traj;
+            // Measure and print time.
+            total_time += secondsSince(start);
+            time_ = total_time;
+            cpu_time_ = total_time;
+            status = opt.results().status;
 
-                // Solution is collision-free.
-                planner_result.second = true;
+            if (status == sco::OptStatus::OPT_CONVERGED)
+            {
+                // Optimization problem converged.
+                planner_result.first = true;
+
+                // Only check for collisions if the trajectory is better than current.
+                if (opt.results().total_cost < best_cost)
+                {
+                    auto tss_current_traj = getTraj(opt.x(), prob->GetVars());
+                    if (getSolution(scene, env_, tss_current_traj, buffer))
+                    {
+                        // Update best cost.
+                        best_cost = opt.results().total_cost;
+
+                        // Update trajectory. The buffer now belongs to the result.
+                        tesseract_trajectory_ = tss_current_traj;
+                        trajectory_ = buffer;
+                        buffer = nullptr;
+
+                        // Solution is collision-free.
+                        planner_result.second = true;
+                        reportSolution(best_cost, total_time);
+                    }
+                }
             }
-        }
 
-        if (options.return_first_sol or
-            (options.return_after_timeout and (total_time >= options.max_planning_time)) or
-            (!options.return_after_timeout and
-             (planner_result.second or (total_time >= options.max_planning_time))))
-            break;
+            if (options.return_first_sol or
+                (options.return_after_timeout and (total_time >= options.max_planning_time)) or
+                (!options.return_after_timeout and
+                 (planner_result.second or (total_time >= options.max_planning_time))))
+                break;
+        }
     }
 
     // Print status
     if (options.verbose)
     {
-        RBX_INFO("OPTIMIZATION STATUS: %s", sco::statusToString(opt.results().status));
-        RBX_INFO("TOTAL PLANNING TIME: %.3f", time_);
+        RBX_INFO("OPTIMIZATION STATUS: %s", sco::statusToString(status));
+        RBX_INFO("TOTAL PLANNING TIME: %.3f (CPU %.3f)", time_, cpu_time_);
         RBX_INFO("COST: %.3f", best_cost);
         RBX_INFO("COLLISION STATUS: %s", (planner_result.second) ? "COLLISION FREE" : "IN COLLISION");
 
@@ -698,6 +833,147 @@ TrajOptPlanner::PlannerResult TrajOptPlanner::solve(const SceneConstPtr &scene,
     return planner_result;
 }
 
+TrajOptPlanner::PlannerResult
+TrajOptPlanner::solveParallel(const SceneConstPtr &scene, const std::shared_ptr<ProblemConstructionInfo> &pci,
+                              double &best_cost, sco::OptStatus &status)
+{
+    const unsigned int n = options.num_threads;
+    if (not restart_pool_ or restart_pool_->getThreadCount() != n)
+        restart_pool_.reset(new Pool(n));
+
+    // Each thread optimizes in its own copy of the environment, as the optimizer updates its state.
+    while (restart_envs_.size() < n)
+    {
+        RestartEnvironment clone;
+        clone.env = createEnvironment();
+        if (!clone.env)
+            return PlannerResult(false, false);
+
+        restart_envs_.emplace_back(std::move(clone));
+    }
+
+    PlannerResult planner_result(false, false);
+    std::mutex mutex;
+    std::atomic<bool> done{false};
+    std::atomic<std::size_t> restart{0};
+    double cpu_time = 0.0;
+
+    const auto state = env_->getState()->joints;
+    const auto start = std::chrono::steady_clock::now();
+
+    // Each thread runs restarts until done, with the next seed.
+    const auto run = [&](std::size_t i) {
+        auto &clone = restart_envs_[i];
+
+        // Sync the copy with the planning environment.
+        if (!hypercube::sceneToTesseractEnv(scene, clone.env, clone.cache))
+            return;
+
+        if (ref_state_)
+            hypercube::addAttachedBodiesToTesseractEnv(ref_state_, clone.env);
+
+        clone.env->setState(state);
+
+        auto clone_pci = std::make_shared<ProblemConstructionInfo>(*pci);
+        clone_pci->env = clone.env;
+        clone_pci->kin = clone.env->getManipulator(manip_);
+
+        TrajOptProbPtr prob = ConstructProblem(*clone_pci);
+        sco::BasicTrustRegionSQP opt(prob);
+        opt.setParameters(getTrustRegionSQPParameters());
+
+        // Only the first thread writes, as the file is not thread-safe.
+        if (file_write_cb_ and i == 0)
+            opt.addCallback(WriteCallback(stream_ptr_, prob));
+
+        robot_trajectory::RobotTrajectoryPtr buffer;
+        while (!done)
+        {
+            opt.initialize(trajToDblVec(getRestartTrajectory(prob, restart++)));
+
+            const auto begin = std::chrono::steady_clock::now();
+            opt.optimize();
+            const double time = secondsSince(begin);
+
+            const bool converged = opt.results().status == sco::OptStatus::OPT_CONVERGED;
+
+            // Only check for collisions if the trajectory is better than the best of all threads so far.
+            const double cost = opt.results().total_cost;
+            bool better = false;
+            if (converged)
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                better = cost < best_cost;
+            }
+
+            TrajArray tss_current_traj;
+            bool is_ct_collision_free = false;
+            if (better)
+            {
+                tss_current_traj = getTraj(opt.x(), prob->GetVars());
+                is_ct_collision_free = getSolution(scene, clone.env, tss_current_traj, buffer);
+            }
+
+            std::unique_lock<std::mutex> lock(mutex);
+            cpu_time += time;
+            status = opt.results().status;
+
+            if (converged)
+            {
+                planner_result.first = true;
+
+                // Share the best collision-free solution of all threads.
+                if (is_ct_collision_free and (cost < best_cost))
+                {
+                    best_cost = cost;
+                    tesseract_trajectory_ = tss_current_traj;
+                    trajectory_ = buffer;
+                    buffer = nullptr;
+                    planner_result.second = true;
+                    reportSolution(best_cost, secondsSince(start));
+                }
+            }
+
+            const double elapsed = secondsSince(start);
+            if ((options.return_after_timeout and (elapsed >= options.max_planning_time)) or
+                (!options.return_after_timeout and
+                 (planner_result.second or (elapsed >= options.max_planning_time))))
+                done = true;
+        }
+    };
+
+    restart_pool_->parallelFor(0, n, run, 1);
+
+    time_ = secondsSince(start);
+    cpu_time_ = cpu_time;
+
+    return planner_result;
+}
+
+void TrajOptPlanner::reportSolution(double cost, double time) const
+{
+    if (not solution_callback_)
+        return;
+
+    planning_interface::MotionPlanResponse solution;
+    solution.trajectory_ = trajectory_;
+    solution.planning_time_ = time;
+    solution.error_code_.val = moveit_msgs::MoveItErrorCodes::SUCCESS;
+    solution_callback_(solution, cost);
+}
+
+TrajArray TrajOptPlanner::getRestartTrajectory(const TrajOptProbPtr &prob, std::size_t restart) const
+{
+    if (restart < seeds_.size())
+        return seeds_[restart];
+
+    auto init_trajectory = prob->GetInitTraj();
+    if (options.perturb_init_traj)
+        perturbTrajectory(init_trajectory, options.noise_init_traj, options.seed + restart);
+
+    return init_trajectory;
+}
+
 sco::BasicTrustRegionSQPParameters TrajOptPlanner::getTrustRegionSQPParameters() const
 {
     sco::BasicTrustRegionSQPParameters params;
@@ -717,3 +993,131 @@ sco::BasicTrustRegionSQPParameters TrajOptPlanner::getTrustRegionSQPParameters()
 
     return params;
 }
+
+///
+/// TrajOptPlanner::Library
+///
+
+void TrajOptPlanner::Library::add(const Eigen::Ref<const Eigen::VectorXd> &start,
+                                  const Eigen::Ref<const Eigen::VectorXd> &goal, const TrajArray &trajectory)
+{
+    Entry entry;
+    entry.key.resize(start.size() + goal.size());
+    entry.key << start, goal;
+    entry.trajectory = trajectory;
+
+    entries_.emplace_back(std::move(entry));
+}
+
+std::vector<TrajArray> TrajOptPlanner::Library::getSeeds(const Eigen::Ref<const Eigen::VectorXd> &start,
+                                                         const Eigen::Ref<const Eigen::VectorXd> &goal,
+                                                         std::size_t k, int rows) const
+{
+    Eigen::VectorXd key(start.size() + goal.size());
+    key << start, goal;
+
+    // Entries of other manipulators or with too few waypoints cannot be used.
+    std::vector<std::pair<double, std::size_t>> nearest;
+    for (std::size_t i = 0; i < entries_.size(); ++i)
+    {
+        const auto &entry = entries_[i];
+        if (entry.key.size() == key.size() and entry.trajectory.rows() > 1 and
+            entry.trajectory.cols() == start.size())
+            nearest.emplace_back((entry.key - key).squaredNorm(), i);
+    }
+
+    k = std::min(k, nearest.size());
+    std::partial_sort(nearest.begin(), nearest.begin() + k, nearest.end());
+
+    std::vector<TrajArray> seeds;
+    for (std::size_t i = 0; i < k; ++i)
+    {
+        const auto &trajectory = entries_[nearest[i].second].trajectory;
+        const long int last = trajectory.rows() - 1;
+
+        TrajArray seed(rows, trajectory.cols());
+        for (int j = 0; j < rows; ++j)
+        {
+            // Resample by linear interpolation between the nearest waypoints.
+            const double t = (rows > 1) ? static_cast<double>(j) / (rows - 1) : 0.;
+            const double u = t * last;
+            const long int a = std::min(static_cast<long int>(u), last - 1);
+            const double s = u - a;
+            seed.row(j) = (1. - s) * trajectory.row(a) + s * trajectory.row(a + 1);
+
+            // Shift the waypoint to match the request's start and goal.
+            seed.row(j) += ((1. - t) * (start - trajectory.row(0).transpose()) +
+                            t * (goal - trajectory.row(last).transpose()))
+                               .transpose();
+        }
+
+        seeds.emplace_back(std::move(seed));
+    }
+
+    return seeds;
+}
+
+std::size_t TrajOptPlanner::Library::size() const
+{
+    return entries_.size();
+}
+
+///
+/// TrajOptPoolPlanner
+///
+
+TrajOptPoolPlanner::TrajOptPoolPlanner(const RobotPtr &robot, const std::string &group_name, unsigned int n,
+                                       const std::string &name)
+  : PoolPlanner(robot, n, name)
+  , group_(group_name)
+  , prototype_(std::make_shared<TrajOptPlanner>(robot, group_name, name))
+{
+}
+
+bool TrajOptPoolPlanner::initialize(const std::string &manip)
+{
+    return prototype_->initialize(manip) and initializeFromPrototype();
+}
+
+bool TrajOptPoolPlanner::initialize(const std::string &base_link, const std::string &tip_link)
+{
+    return prototype_->initialize(base_link, tip_link) and initializeFromPrototype();
+}
+
+const TrajOptPlannerPtr &TrajOptPoolPlanner::getPrototype() const
+{
+    return prototype_;
+}
+
+const std::vector<TrajOptPlannerPtr> &TrajOptPoolPlanner::getPlanners() const
+{
+    return planners_;
+}
+
+bool TrajOptPoolPlanner::initializeFromPrototype()
+{
+    std::vector<TrajOptPlannerPtr> planners;
+    std::mutex mutex;
+    const bool r = PoolPlanner::initialize([&](unsigned int index) -> PlannerPtr {
+        // The first worker plans with the prototype itself.
+        auto planner = prototype_;
+        if (index > 0)
+        {
+            planner = std::make_shared<TrajOptPlanner>(robot_, group_, name_);
+            if (!planner->initialize(*prototype_))
+                return nullptr;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (planners.size() <= index)
+            planners.resize(index + 1);
+        planners[index] = planner;
+
+        return planner;
+    });
+
+    if (r)
+        planners_ = std::move(planners);
+
+    return r;
+}
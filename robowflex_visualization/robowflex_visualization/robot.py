@@ -6,11 +6,44 @@
 import subprocess
 import math
 import mathutils
+import struct
+import numpy
 from urdf_parser_py import urdf as URDF
 
 import robowflex_visualization as rv
 
 
+## @brief Reads a binary file of link transforms through a path, as output by
+#         robowflex::Robot::dumpPathTransforms() on a `.bin` file.
+#
+#  @param transforms_file File to read.
+#  @return A tuple of the fps of the path, the list of link names, an array of
+#          the time since the previous frame of each frame, and an array of
+#          shape frames x links x 7 of link poses as `x y z qx qy qz qw`.
+#
+def read_transforms(transforms_file):
+    with open(rv.utils.resolve_path(transforms_file), 'rb') as f:
+        data = f.read()
+
+    magic, version, frames, links, fps = struct.unpack_from('<4sIIId', data, 0)
+    if magic != b'RBXT' or version != 1:
+        raise ValueError("Invalid transforms file: {}".format(transforms_file))
+
+    offset = struct.calcsize('<4sIIId')
+    names = []
+    for _ in range(links):
+        size, = struct.unpack_from('<I', data, offset)
+        offset += 4
+        names.append(data[offset:offset + size].decode())
+        offset += size
+
+    delays = numpy.frombuffer(data, '<f4', frames, offset)
+    offset += 4 * frames
+
+    transforms = numpy.frombuffer(data, '<f4', frames * links * 7, offset)
+    return fps, names, delays, transforms.reshape((frames, links, 7))
+
+
 ## @brief Controllable URDF described robot.
 #  This class loads a URDF from the package resource URI under a Blender
 #  collection.
@@ -60,14 +93,18 @@ def load_urdf(self, urdf, load = True):
         dae_output = os.path.join("/tmp",
                                   os.path.basename(self.urdf_path) + ".dae")
 
+        # Outputs are written to a temporary file and moved into place, so that
+        # several Blender processes can load the same robot at once.
+        xml_temp = "{}.{}".format(xml_output, os.getpid())
         subprocess.check_output([
             "rosrun",
             "xacro",
             "xacro",
             self.urdf_path,
             "-o",
-            xml_output,
+            xml_temp,
         ])
+        os.replace(xml_temp, xml_output)
 
         self.urdf_xml = open(xml_output, 'r').read()
         self.robot = URDF.Robot.from_xml_string(self.urdf_xml)
@@ -75,13 +112,15 @@ def load_urdf(self, urdf, load = True):
         if load:
             # Don't regenerate URDF COLLADA if it already exists.
             if not os.path.exists(dae_output):
+                dae_temp = "{}.{}.dae".format(dae_output[:-4], os.getpid())
                 subprocess.check_output([
                     "rosrun",
                     "collada_urdf",
                     "urdf_to_collada",
                     xml_output,
-                    dae_output,
+                    dae_temp,
                 ])
+                os.replace(dae_temp, dae_output)
 
             # Import and move into new collection.
             bpy.ops.wm.collada_import(filepath = dae_output)
@@ -275,6 +314,74 @@ def animate_path(self,
 
         return math.ceil(last_frame)
 
+    ## @brief Adds keyframes to animate link transforms through a path, as
+    #         output by robowflex::Robot::dumpPathTransforms() on a `.bin`
+    #         file.
+    #
+    #  @param transforms_file Binary file of link transforms.
+    #  @param fps Frames-per-second to animate the path at. If None, uses the
+    #             fps of the file.
+    #  @param start Frame to begin the animation at.
+    #  @param interpolate If true, interpolates quaternion from previous state.
+    #
+    def animate_transforms(self,
+                           transforms_file,
+                           fps = None,
+                           start = 30,
+                           interpolate = True):
+        file_fps, names, delays, transforms = read_transforms(transforms_file)
+        if fps is None:
+            fps = file_fps
+
+        parents = {}
+        for joint in self.robot.joints:
+            parents[joint.child] = joint.parent
+
+        # Blender objects of links are placed at the link's visual origin.
+        origins = {}
+        for name in names:
+            link_xml = self.get_link_xml(name)
+            origin = mathutils.Matrix.Identity(4)
+            if link_xml and link_xml.visual:
+                origin = rv.utils.get_tf_origin_xml(link_xml.visual)
+            origins[name] = origin
+
+        animated = [(j, name, self.get_link(name))
+                    for j, name in enumerate(names)]
+        animated = [(j, name, link) for j, name, link in animated if link]
+        for _, _, link in animated:
+            link.rotation_mode = "QUATERNION"
+
+        time = 0.
+        for i in range(transforms.shape[0]):
+            time += float(delays[i])
+            frame = start + time * fps
+
+            world = {}
+            for j, name in enumerate(names):
+                x, y, z, qx, qy, qz, qw = transforms[i, j].tolist()
+                tf = mathutils.Quaternion([qw, qx, qy, qz]).to_matrix()
+                tf.resize_4x4()
+                tf = mathutils.Matrix.Translation([x, y, z]) @ tf
+                world[name] = tf @ origins[name]
+
+            for j, name, link in animated:
+                local = world[name]
+                if name in parents and parents[name] in world:
+                    local = world[parents[name]].inverted() @ local
+
+                prior = link.rotation_quaternion.copy()
+                link.location = local.to_translation()
+                link.rotation_quaternion = local.to_quaternion()
+                if interpolate and i > 0:
+                    link.rotation_quaternion.make_compatible(prior)
+
+                link.keyframe_insert(data_path = "location", frame = frame)
+                link.keyframe_insert(data_path = "rotation_quaternion",
+                                     frame = frame)
+
+        return math.ceil(start + time * fps)
+
     ## @brief Sets the robot's state from a file with a moveit_msgs::RobotState
     #
     #  @param state_file File containing the state.
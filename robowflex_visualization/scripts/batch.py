@@ -0,0 +1,169 @@
+"""Render many scenes and trajectories headless, spread across Blender processes.
+
+   Run with the system Python to launch the batch:
+        `python3 batch.py manifest.yml -j 4`
+
+   The manifest is a YAML file listing the robots used and the jobs to render:
+        robots:
+          Fetch: package://robowflex_resources/fetch/robots/fetch.urdf
+        jobs:
+          - robot: Fetch
+            scene: package://robowflex_library/yaml/test_fetch.yml
+            trajectory: package://robowflex_visualization/yaml/fetch_pick.yml
+            output: /tmp/renders/fetch_pick.png
+            fps: 15          # Optional, frames-per-second of the animation.
+            animate: false   # Optional, render all frames instead of the last.
+
+   Trajectories are either YAML moveit_msgs::RobotTrajectory files, or `.bin`
+   files from robowflex::Robot::dumpPathTransforms(). Jobs are sorted by robot
+   and split into contiguous chunks, one per Blender process, so each process
+   loads the meshes of a robot once and reuses them for all of its jobs.
+
+   Each Blender process runs this script again as a worker, with
+        `blender -b robowflex.blend --python batch.py -- worker manifest.yml i n`
+"""
+
+import argparse
+import os
+import subprocess
+import sys
+
+import yaml
+
+WORKER = "worker"
+
+
+def get_jobs(manifest):
+    """Get the jobs of a manifest, sorted by robot.
+    """
+    return sorted(manifest["jobs"], key = lambda job: job["robot"])
+
+
+def get_chunk(jobs, index, count):
+    """Get the contiguous chunk of jobs for a worker.
+    """
+    return jobs[index * len(jobs) // count:(index + 1) * len(jobs) // count]
+
+
+def launch(args):
+    """Launch Blender worker processes for a manifest and wait for them.
+    """
+    with open(args.manifest, 'r') as f:
+        manifest = yaml.safe_load(f)
+
+    jobs = get_jobs(manifest)
+    count = max(1, min(args.jobs, len(jobs)))
+
+    directory = os.path.dirname(os.path.abspath(__file__))
+    blend = args.blend or os.path.join(directory, "..", "robowflex.blend")
+
+    processes = []
+    for index in range(count):
+        command = [
+            args.blender,
+            "--background",
+            blend,
+            "--python-exit-code",
+            "1",
+            "--python",
+            os.path.abspath(__file__),
+            "--",
+            WORKER,
+            os.path.abspath(args.manifest),
+            str(index),
+            str(count),
+        ]
+
+        log = open("{}.{}.log".format(args.manifest, index), 'w')
+        processes.append((subprocess.Popen(command, stdout = log, stderr = log), log))
+
+    failed = 0
+    for index, (process, log) in enumerate(processes):
+        if process.wait() != 0:
+            print("Worker {} failed, see {}".format(index, log.name))
+            failed += 1
+
+        log.close()
+
+    print("Rendered {} jobs on {} workers, {} failed.".format(
+        len(jobs), count, failed))
+    return failed == 0
+
+
+def work(manifest_file, index, count):
+    """Render a chunk of jobs of a manifest within Blender.
+    """
+    import bpy
+
+    # Set up paths the same way as the interactive script.
+    sys.path.append(os.path.dirname(os.path.abspath(__file__)))
+    import blender
+    blender.initialize_path()
+    blender.initialize_robowflex_path()
+
+    import robowflex_visualization as rv
+
+    with open(manifest_file, 'r') as f:
+        manifest = yaml.safe_load(f)
+
+    robots = {}
+    for job in get_chunk(get_jobs(manifest), index, count):
+        name = job["robot"]
+
+        # Robots are loaded once, and hidden when not used by a job.
+        if name not in robots:
+            robots[name] = rv.robot.Robot(name, manifest["robots"][name])
+
+        for other, robot in robots.items():
+            robot.collection.hide_render = other != name
+
+        robot = robots[name]
+        robot.clear_animation_data()
+
+        rv.utils.remove_collection("Scene")
+        if "scene" in job:
+            rv.scene.Scene("Scene", job["scene"])
+
+        fps = job.get("fps", 30)
+        start = 1
+        if job["trajectory"].endswith(".bin"):
+            end = robot.animate_transforms(job["trajectory"], fps, start)
+        else:
+            end = robot.animate_path(job["trajectory"], fps, start)
+
+        scene = bpy.context.scene
+        scene.render.fps = int(fps)
+        scene.render.filepath = job["output"]
+
+        if job.get("animate", False):
+            scene.frame_start = start
+            scene.frame_end = max(start, end)
+            bpy.ops.render.render(animation = True)
+        else:
+            scene.frame_set(max(start, end))
+            bpy.ops.render.render(write_still = True)
+
+        print("Rendered {}".format(job["output"]))
+
+
+if __name__ == '__main__':
+    argv = sys.argv[sys.argv.index("--") + 1:] if "--" in sys.argv else []
+    if argv and argv[0] == WORKER:
+        work(argv[1], int(argv[2]), int(argv[3]))
+
+    else:
+        parser = argparse.ArgumentParser(description = __doc__.split("\n")[0])
+        parser.add_argument("manifest", help = "YAML manifest of jobs.")
+        parser.add_argument("-j",
+                            "--jobs",
+                            type = int,
+                            default = os.cpu_count(),
+                            help = "Number of Blender processes to use.")
+        parser.add_argument("--blender",
+                            default = "blender",
+                            help = "Blender executable.")
+        parser.add_argument("--blend",
+                            default = "",
+                            help = "Blender file to render in.")
+
+        sys.exit(0 if launch(parser.parse_args()) else 1)